@@ -0,0 +1,82 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef NVC_ALLOC_H
+#define NVC_ALLOC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// note: every allocation made by the compiler goes through one of these so
+// that callers can plug in their own pool allocators. all three callbacks
+// receive ctx as their first argument
+typedef struct {
+    void* (*alloc)(void* ctx, size_t size);
+    // note: realloc(ctx, NULL, size) must behave like alloc(ctx, size)
+    void* (*realloc)(void* ctx, void* ptr, size_t size);
+    // note: free(ctx, NULL) must be a no-op
+    void (*free)(void* ctx, void* ptr);
+    void* ctx;
+} nvc_allocator_t;
+
+// note: libc backed allocator, this is never NULL and must not be modified
+nvc_allocator_t* nvc_default_allocator(void);
+
+// helpers, these all accept a NULL allocator which means the default one
+void* nvc_alloc(nvc_allocator_t* allocator, size_t size);
+// note: zero initialised and checks n * size for overflow
+void* nvc_calloc(nvc_allocator_t* allocator, size_t n, size_t size);
+// note: unlike libc realloc, ptr is left untouched when NULL is returned
+void* nvc_realloc(nvc_allocator_t* allocator, void* ptr, size_t size);
+void nvc_free(nvc_allocator_t* allocator, void* ptr);
+// note: copies at most n chars and always null terminates
+char* nvc_strndup(nvc_allocator_t* allocator, const char* str, size_t n);
+
+// arena allocator: allocations are bump allocated from blocks taken from the
+// backing allocator, free is a no-op and everything is released at once with
+// nvc_arena_reset/nvc_arena_destroy
+typedef struct nvc_arena_block_s nvc_arena_block_t;
+
+typedef struct {
+    nvc_allocator_t allocator;  // hand &arena->allocator to the compiler
+    nvc_allocator_t* backing;
+    nvc_arena_block_t* head;
+    size_t block_size;
+    size_t bytes_used;  // total bytes handed out since the last reset
+} nvc_arena_t;
+
+// note: block_size of 0 selects a sensible default
+void nvc_arena_init(nvc_arena_t* arena,
+                    nvc_allocator_t* backing,
+                    size_t block_size);
+nvc_allocator_t* nvc_arena_allocator(nvc_arena_t* arena);
+// note: keeps the most recent block around so the arena can be reused without
+// going back to the backing allocator
+void nvc_arena_reset(nvc_arena_t* arena);
+void nvc_arena_destroy(nvc_arena_t* arena);
+
+// counting/tracking allocator: wraps another allocator and records allocation
+// volume, it can also be told to fail after a number of allocations to
+// exercise out of memory paths
+typedef struct {
+    nvc_allocator_t allocator;  // hand &counter->allocator to the compiler
+    nvc_allocator_t* backing;
+    size_t n_allocs, n_reallocs, n_frees, n_failed;
+    size_t bytes_allocated;  // total bytes requested over the lifetime
+    size_t bytes_live;       // bytes currently allocated
+    size_t bytes_peak;       // high water mark of bytes_live
+    // note: when non-zero every allocation after the fail_after-th one fails
+    size_t fail_after;
+} nvc_counting_allocator_t;
+
+void nvc_counting_allocator_init(nvc_counting_allocator_t* counter,
+                                 nvc_allocator_t* backing);
+nvc_allocator_t* nvc_counting_allocator(nvc_counting_allocator_t* counter);
+
+#endif  // NVC_ALLOC_H
+
+#ifdef __cplusplus
+}
+#endif
@@ -5,6 +5,9 @@ extern "C" {
 #ifndef NVC_AST_H
 #define NVC_AST_H
 
+#include <stdbool.h>
+
+#include <nvc_alloc.h>
 #include <nvc_lexer.h>
 
 typedef enum {
@@ -12,14 +15,30 @@ typedef enum {
     NVC_AST_NODE_INT_LIT = 0,
     NVC_AST_NODE_FP_LIT = 1,
     NVC_AST_NODE_STRING_LIT = 2,
+    NVC_AST_NODE_ARRAY_LIT = 3,
+    NVC_AST_NODE_BIG_LIT = 4,  // an int literal past INT64_MAX
     // decls
     NVC_AST_NODE_LET_DECL = 10,
     NVC_AST_NODE_FUN_DECL = 11,
     NVC_AST_NODE_TYPE_DECL = 12,
+    NVC_AST_NODE_IMPORT_DECL = 13,
     // operator chain
     NVC_AST_NODE_OP_CHAIN = 20,
+    // postfix operators
+    NVC_AST_NODE_INDEX = 21,
+    NVC_AST_NODE_CALL = 22,
+    NVC_AST_NODE_FIELD = 23,
+    // loops
+    NVC_AST_NODE_FOR = 24,
+    NVC_AST_NODE_WHILE = 25,
+    // references
+    NVC_AST_NODE_SYMBOL_REF = 30,
 } nvc_ast_node_kind_t;
 
+// note: declaration index of a symbol that has not been resolved (yet), see
+// nvc_sema.h
+#define NVC_DECL_UNRESOLVED UINT32_MAX
+
 typedef enum {
     NVC_BIN_OP_UNKNOWN = -1,
 
@@ -53,11 +72,15 @@ typedef struct {
     char* symbol;  // this will be freed when the owning nvc_token_stream_t is
                    // freed
     nvc_ast_node_t* rhs;  // this must be freed after use
+    uint32_t decl;        // index into nvc_sema_t.decls once resolved
 } nvc_ast_let_decl_t;
 
 typedef struct {
     char* param_name;  // both of these fields are freed when the owning
     char* type_name;   // nvc_token_stream_t is freed
+    uint32_t decl;     // index into nvc_sema_t.decls once resolved
+    uint32_t type_decl;  // index into nvc_sema_t.decls of the type once
+                         // resolved, NVC_DECL_UNRESOLVED for builtin types
 } nvc_fun_param_decl_t;
 
 typedef struct {
@@ -72,19 +95,42 @@ typedef struct {
     nvc_ast_node_t** body;  // this and the pointers pointed to must be freed
                             // after use UNLESS it is NULL
     uint32_t body_size;
+    nvc_tok_t* body_tokens;  // with lazy_bodies the tokens of the body after
+    uint32_t n_body_tokens;  // its opening paren up to and including the
+                             // closing one, not owned. NULL once the body is
+                             // parsed, see nvc_parse_fun_body
+    uint32_t decl;  // index into nvc_sema_t.decls once resolved
+    uint32_t return_type_decl;  // like nvc_fun_param_decl_t.type_decl
+    uint32_t scope;  // amount of decls visible at the declaration, set by
+                     // nvc_resolve to resolve a lazy body later
 } nvc_ast_fun_decl_t;
 
 typedef struct {
     char* member_name;  // both of these fields are freed when the owning
     char* type_name;    // nvc_token_stream_t is freed
+    uint32_t length;    // element count of an array member (type_name[n]),
+                        // 0 otherwise
+    uint32_t decl;  // index into nvc_sema_t.decls of the member type once
+                    // resolved, NVC_DECL_UNRESOLVED for builtin types
 } nvc_type_member_decl_t;
 
 typedef struct {
-    char* type_name;
-    nvc_type_member_decl_t** members;
+    char* type_name;  // freed when the owning nvc_token_stream_t is freed
+    nvc_type_member_decl_t** members;  // this and the pointers it points to
+                                       // MUST be freed, in source order
     uint32_t n_members;
+    bool fixed_layout;  // type [fixed], the members are stored in source
+                        // order instead of being reordered, see nvc_layout.h
+    uint32_t decl;      // index into nvc_sema_t.decls once resolved
 } nvc_ast_type_decl_t;
 
+typedef struct {
+    char* module;    // this MUST be freed, dotted module name (e.g. a.b is
+                     // the file a/b.nv next to the importing module)
+    uint32_t index;  // position among the import decls of the tree, the
+                     // imports passed to nvc_resolve are in this order
+} nvc_ast_import_decl_t;
+
 typedef enum {
     NVC_CHAIN_ELEM_UNARY_OP = 0,
     NVC_CHAIN_ELEM_BINARY_OP = 1,
@@ -106,36 +152,181 @@ typedef struct {
     uint32_t n_elems;
 } nvc_ast_op_chain_t;
 
+typedef struct {
+    nvc_ast_node_t** elems;  // this and the pointers it points to MUST be
+                             // freed, the elements in source order
+    uint32_t n_elems;
+} nvc_ast_array_lit_t;
+
+typedef struct {
+    nvc_ast_node_t* base;   // both of these MUST be freed, base[index]
+    nvc_ast_node_t* index;
+} nvc_ast_index_t;
+
+typedef struct {
+    nvc_ast_node_t* callee;  // these MUST be freed, callee(args...), the
+    nvc_ast_node_t** args;   // callee is always a symbol ref
+    uint32_t n_args;
+} nvc_ast_call_t;
+
+typedef struct {
+    nvc_ast_node_t* base;  // this MUST be freed, base.field
+    char* field;  // this will be freed when the owning nvc_token_stream_t is
+                  // freed
+} nvc_ast_field_t;
+
+// for <counter> in <start> to <end> with <acc> = <init> do '(' <body> ')'
+// while <cond> with <acc> = <init> do '(' <body> ')'
+// a loop is an expression: acc starts at init and becomes the value of the
+// body after each iteration, the loop evaluates to the last one. a for loop
+// counts the int counter from start up to end (excluded), a while loop runs
+// as long as cond is true. counter and acc are only visible in cond and body
+typedef struct {
+    char* counter;  // for loops only, NULL for while. both names are freed
+    char* acc;      // when the owning nvc_token_stream_t is freed
+    nvc_ast_node_t* start;  // for loops only, evaluated once before the
+    nvc_ast_node_t* end;    // first iteration
+    nvc_ast_node_t* cond;   // while loops only, evaluated before every
+                            // iteration
+    nvc_ast_node_t* init;   // all of these MUST be freed (unless NULL)
+    nvc_ast_node_t* body;
+    uint32_t counter_decl;  // indices into nvc_sema_t.decls once resolved
+    uint32_t acc_decl;
+} nvc_ast_loop_t;
+
+typedef struct {
+    char* symbol;  // this will be freed when the owning nvc_token_stream_t is
+                   // freed
+    uint32_t decl;  // index into nvc_sema_t.decls, NVC_DECL_UNRESOLVED until
+                    // nvc_resolve has run
+} nvc_ast_symbol_ref_t;
+
 struct nvc_ast_node_s {
     nvc_ast_node_kind_t kind;
+    nvc_buffer_location_t buf_loc;  // location of the token the node was
+                                    // created from (for errors/warnings)
+    uint32_t shared;  // amount of extra owners of a hash consed node, freeing
+                      // only decrements this until it is 0
+    bool interned;    // true when the node is hash consed (immutable)
+    uint8_t width;    // nvc_number_width_t of int and fp literals
     union {
         // literals
         nvc_int i;      // note: this cannot (and will not) be negative
         nvc_fp fp;      // note: this cannot (and will not) be negative
+        const nvc_bigint_t* big;  // this will be freed when the owning
+                                  // nvc_free_token_stream freed
         char* str_lit;  // this will be freed when the owning
                         // nvc_free_token_stream freed
+        nvc_ast_array_lit_t array_lit;
 
         // operator chain
         nvc_ast_op_chain_t op_chain;
+        nvc_ast_index_t index;
+        nvc_ast_call_t call;
+        nvc_ast_field_t field;
+
+        // loops
+        nvc_ast_loop_t loop;
+
+        // references
+        nvc_ast_symbol_ref_t symbol_ref;
 
         // declarations
         nvc_ast_let_decl_t let_decl;
         nvc_ast_fun_decl_t fun_decl;
         nvc_ast_type_decl_t type_decl;
+        nvc_ast_import_decl_t import_decl;
     };
 };
 
 typedef struct {
+    nvc_allocator_t* allocator;  // every node of the tree is allocated with
+                                 // this
     nvc_ast_node_t**
         nodes;  // this and the pointers it points to must be freed after use
     uint32_t size;
+    uint32_t n_shared;   // amount of nodes that were hash consed away
+    uint32_t n_imports;  // amount of import decls in nodes
+    nvc_arena_t* arenas;  // when not NULL the nodes were allocated from these
+                          // (one per parser thread) and are released with
+                          // them instead of one by one, see nvc_free_ast
+    uint32_t n_arenas;
 } nvc_ast_t;
 
-void nvc_print_ast(nvc_ast_t* ast);
+// fewest tokens each thread of a parallel parse gets, smaller streams are
+// parsed on fewer threads
+#define NVC_PARSE_MIN_TOKENS_PER_JOB 16384
+
+typedef struct {
+    // share structurally identical literals and pure op chains over them
+    // instead of allocating a node for each occurrence, the tree becomes a
+    // DAG so equal subexpressions are pointer equal
+    bool hash_cons;
+    // lex on a second thread and feed the tokens to the parser as they are
+    // produced (see nvc_lex_and_parse_pipelined), the token stream is not
+    // kept. the allocator must be thread safe
+    bool pipeline;
+    // only find the end of fun bodies with a bracket matching scan and keep
+    // their tokens, the body is parsed when it is needed (see
+    // nvc_parse_fun_body). the token stream must outlive the tree, ignored
+    // by nvc_parse_incremental since it does not keep the tokens
+    bool lazy_bodies;
+    // parse ranges of top level declarations on up to this many threads,
+    // each into its own arena (see nvc_parse). 0 and 1 parse on the calling
+    // thread, ignored when pipelined
+    uint32_t n_jobs;
+} nvc_parse_options_t;
+
+// note: true for reserved words (let, fun, type, import, for, while). in, to,
+// with and do only have a meaning inside a loop and are not reserved
+bool nvc_is_keyword(const char* symbol);
+
+void nvc_print_ast(FILE* out, nvc_ast_t* ast);
 
 void nvc_free_ast(nvc_ast_t* ast);
 
-nvc_ast_t* nvc_parse(nvc_token_stream_t* stream);
+// note: allocator may be NULL to use nvc_default_allocator, errors are
+// reported to diags (or stderr when NULL), options may be NULL for defaults.
+// after a syntax error the parser resynchronises at the next top level
+// declaration so the returned tree only lacks the declarations that failed,
+// NULL is only returned when out of memory.
+// with options->n_jobs > 1 a large stream is cut at top level declaration
+// boundaries into one range per thread, the ranges are parsed concurrently
+// and their nodes and diagnostics are concatenated in source order. the tree
+// is the same as a sequential parse except that hash consing only shares
+// nodes within a range and, past the error limit, later ranges still count
+// their errors as suppressed. the allocator must then be thread safe and
+// diags must not be NULL (or the parse is sequential)
+nvc_ast_t* nvc_parse(nvc_allocator_t* allocator,
+                     nvc_diagnostics_t* diags,
+                     nvc_token_stream_t* stream,
+                     const nvc_parse_options_t* options);
+
+// parses the body of a fun decl that was skipped with lazy_bodies, does
+// nothing if it is parsed already. the nodes are allocated like the rest of
+// the tree, the body is not hash consed. syntax errors are reported to diags
+// (or stderr when NULL) and leave the body empty, it is not parsed again.
+// returns false on a syntax error or when out of memory
+bool nvc_parse_fun_body(nvc_ast_t* ast,
+                        nvc_diagnostics_t* diags,
+                        nvc_ast_node_t* fun);
+
+// pulls up to max tokens into toks and returns how many were written, 0 only
+// at the end of input
+typedef uint32_t (*nvc_token_source_t)(void* source,
+                                       nvc_tok_t* toks,
+                                       uint32_t max);
+
+// same as nvc_parse but pulls tokens from a source as they are needed. only
+// the tokens of the declaration being parsed are kept, so the whole token
+// stream never exists at once
+// note: token strings are not freed by the parser, the nodes keep pointing
+// to them so the source must keep them alive as long as the returned tree
+nvc_ast_t* nvc_parse_incremental(nvc_allocator_t* allocator,
+                                 nvc_diagnostics_t* diags,
+                                 nvc_token_source_t next,
+                                 void* source,
+                                 const nvc_parse_options_t* options);
 
 #endif  // NVC_AST_H
 
@@ -0,0 +1,45 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef NVC_BATCH_H
+#define NVC_BATCH_H
+
+#include <stdio.h>
+
+#include <nvc_alloc.h>
+#include <nvc_compiler.h>
+
+// requests in flight per worker thread, bounds the memory of a batch no
+// matter how much input is queued up on stdin
+#define NVC_BATCH_WINDOW_PER_JOB 8
+
+// compiles requests read from in and writes one result per request to out,
+// both newline delimited JSON (one object per line). a request is
+//   {"id": 1, "name": "snippet.nv", "source": "let a = 1", "outputs": ["ir"]}
+// where id is any JSON value and is echoed back as is, name (optional) is the
+// buffer name of its diagnostics and outputs (optional) selects any of
+// "tokens", "ast" and "ir" to be included in the result. a result is
+//   {"id": 1, "ok": true, "errors": 0, "warnings": 0, "diagnostics": [],
+//    "ir": "..."}
+// where each diagnostic has a severity, a message and, if it has a location,
+// a line and a column. a request that is not valid JSON gets
+//   {"id": null, "ok": false, "error": "..."}
+// blank lines are skipped. requests are compiled in parallel on options'
+// n_jobs threads (see nvc_compile_buffer, imports are not resolved) but the
+// results are written in the order of the requests, each as soon as it and
+// every request before it is done. every thread reuses one context and one
+// arena for all of its requests
+// note: allocator may be NULL to use nvc_default_allocator, options may be
+// NULL for defaults. returns non-zero if any request failed or in could not
+// be read
+int nvc_batch(nvc_allocator_t* allocator,
+              FILE* in,
+              FILE* out,
+              const nvc_compile_options_t* options);
+
+#endif  // NVC_BATCH_H
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,139 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef NVC_BIGINT_H
+#define NVC_BIGINT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// ints are exact. the ones in [NVC_SMALL_INT_MIN, NVC_SMALL_INT_MAX] are
+// small and stay inline (a constant in the IR, a tagged word at run time,
+// see nvc_rt.h), arithmetic on them checks for overflow with the compiler
+// builtins and only falls back to the arbitrary precision ints below when
+// the result is not small. both the constant folding and the runtime use
+// them, they never allocate, callers size the results with the limb counts
+// given for every operation
+#define NVC_SMALL_INT_MIN (-((int64_t)1 << 62))
+#define NVC_SMALL_INT_MAX (((int64_t)1 << 62) - 1)
+
+static inline bool nvc_is_small_int(int64_t value) {
+    return value >= NVC_SMALL_INT_MIN && value <= NVC_SMALL_INT_MAX;
+}
+
+// note: false when the result is not small, *out is unspecified then
+static inline bool nvc_small_add(int64_t lhs, int64_t rhs, int64_t* out) {
+    return !__builtin_add_overflow(lhs, rhs, out) && nvc_is_small_int(*out);
+}
+
+static inline bool nvc_small_sub(int64_t lhs, int64_t rhs, int64_t* out) {
+    return !__builtin_sub_overflow(lhs, rhs, out) && nvc_is_small_int(*out);
+}
+
+static inline bool nvc_small_mul(int64_t lhs, int64_t rhs, int64_t* out) {
+    return !__builtin_mul_overflow(lhs, rhs, out) && nvc_is_small_int(*out);
+}
+
+// note: exponent is not negative
+static inline bool nvc_small_pow(int64_t base, int64_t exponent, int64_t* out) {
+    int64_t result = 1, factor = base;
+    for (; exponent; exponent >>= 1) {
+        if ((exponent & 1) && !nvc_small_mul(result, factor, &result))
+            return false;
+        if (exponent > 1 && !nvc_small_mul(factor, factor, &factor))
+            return false;
+    }
+    *out = result;
+    return true;
+}
+
+// sign and magnitude, the magnitude has its least significant limb first
+// and no leading zero limbs so equal values have equal limbs (and zero has
+// none). the limbs follow the header, which is also how an int constant
+// that is not small is laid out in an object
+typedef struct {
+    uint32_t n_limbs;
+    uint32_t negative;  // 0 or 1, 0 for zero
+    uint64_t limbs[];
+} nvc_bigint_t;
+
+// bytes of an int with n_limbs limbs
+#define NVC_BIGINT_SIZE(n_limbs) \
+    (sizeof(nvc_bigint_t) + (size_t)(n_limbs) * sizeof(uint64_t))
+
+// note: the results of the folding and the runtime are capped at this,
+// larger powers are left to run time or trap there
+#define NVC_BIGINT_MAX_LIMBS ((uint32_t)1 << 16)
+
+// room for an int that fits in an int64_t, for converting operands
+typedef union {
+    nvc_bigint_t value;
+    uint64_t storage[2];
+} nvc_bigint_i64_t;
+
+// out needs 1 limb
+void nvc_bigint_set_i64(nvc_bigint_t* out, int64_t value);
+// false when value does not fit
+bool nvc_bigint_get_i64(const nvc_bigint_t* value, int64_t* out);
+// the low 64 bits of value in two's complement, how ints wrap to i64s
+static inline int64_t nvc_bigint_wrap_i64(const nvc_bigint_t* value) {
+    uint64_t low = value->n_limbs ? value->limbs[0] : 0;
+    return (int64_t)(value->negative ? 0 - low : low);
+}
+
+// <0, 0 or >0 like strcmp
+int nvc_bigint_compare(const nvc_bigint_t* lhs, const nvc_bigint_t* rhs);
+// about the nearest double, inf past its range
+double nvc_bigint_to_fp(const nvc_bigint_t* value);
+
+// out needs the limbs of the larger operand + 1 and may be an operand
+void nvc_bigint_add(nvc_bigint_t* out,
+                    const nvc_bigint_t* lhs,
+                    const nvc_bigint_t* rhs);
+void nvc_bigint_sub(nvc_bigint_t* out,
+                    const nvc_bigint_t* lhs,
+                    const nvc_bigint_t* rhs);
+// out needs the limbs of both operands and must not be one of them
+void nvc_bigint_mul(nvc_bigint_t* out,
+                    const nvc_bigint_t* lhs,
+                    const nvc_bigint_t* rhs);
+// truncates like int division, rhs is not zero. quotient needs the limbs of
+// lhs and remainder the limbs of rhs + 1, neither may be an operand
+void nvc_bigint_div(nvc_bigint_t* quotient,
+                    nvc_bigint_t* remainder,
+                    const nvc_bigint_t* lhs,
+                    const nvc_bigint_t* rhs);
+// out needs the limbs of value and may be value
+void nvc_bigint_neg(nvc_bigint_t* out, const nvc_bigint_t* value);
+// ~value, that is -value - 1, out needs the limbs of value + 1 and may be
+// value
+void nvc_bigint_not(nvc_bigint_t* out, const nvc_bigint_t* value);
+
+// limbs of base ^ exponent, UINT64_MAX when that does not fit a uint64_t
+uint64_t nvc_bigint_pow_limbs(const nvc_bigint_t* base, uint64_t exponent);
+// out and scratch need nvc_bigint_pow_limbs limbs
+void nvc_bigint_pow(nvc_bigint_t* out,
+                    nvc_bigint_t* scratch,
+                    const nvc_bigint_t* base,
+                    uint64_t exponent);
+
+// limbs of the digits of a literal in radix 2, 10 or 16
+uint32_t nvc_bigint_parse_limbs(size_t n_digits, uint32_t radix);
+// note: digits are only digits of radix, without a 0x/0b prefix
+void nvc_bigint_parse(nvc_bigint_t* out,
+                      const char* digits,
+                      size_t n_digits,
+                      uint32_t radix);
+// room for the decimal form of value with its sign and terminator
+size_t nvc_bigint_str_size(const nvc_bigint_t* value);
+// writes the decimal form of value to str, which has nvc_bigint_str_size
+// chars
+void nvc_bigint_to_str(const nvc_bigint_t* value, char* str);
+
+#endif  // NVC_BIGINT_H
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,140 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef NVC_BUILD_H
+#define NVC_BUILD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <nvc_alloc.h>
+#include <nvc_ast.h>
+#include <nvc_context.h>
+#include <nvc_reader.h>
+#include <nvc_source.h>
+#include <nvc_symtab.h>
+
+#define NVC_MODULE_NONE UINT32_MAX
+
+// what a nvc_module_cache_t keeps of a module between builds
+typedef struct nvc_cached_module_s nvc_cached_module_t;
+struct nvc_cached_module_s {
+    char* key;   // owned, like nvc_module_t.key
+    char* path;  // owned, the bufname of the results
+    char* buf;   // owned, the source the results were made from
+    long bufsz;
+    nvc_context_t* ctx;  // owned, tokens, AST, sema and diagnostics
+    uint64_t size;     // of the file when it was read, it is read and
+    int64_t mtime_ns;  // parsed again once either changed
+    bool parsed;  // ctx holds the results of parsing buf
+    bool stale;   // read and parsed again by the next build
+    uint64_t resolved;  // generation of the build that resolved it last
+    nvc_cached_module_t** imports;  // what it was resolved against, NULL
+    uint32_t n_imports;             // for an import that was not found
+};
+
+// modules kept in memory between the builds of a long running process (see
+// nvc_watch): a build reuses the tokens and AST of every module whose file
+// did not change instead of reading and parsing it again, and its sema too
+// unless a module it imports was resolved again since. modules are found by
+// their key, so a module imported by several roots is parsed once. with
+// parse_options.lazy_bodies only the source is reused
+// note: used by one build at a time and always with the same options, the
+// results of a build point into it
+typedef struct {
+    nvc_allocator_t* allocator;
+    nvc_cached_module_t** modules;
+    uint32_t n_modules, capacity;
+    nvc_symtab_t by_key;  // key -> index into modules
+    uint64_t generation;  // of the last build
+} nvc_module_cache_t;
+
+// note: allocator may be NULL to use nvc_default_allocator, it must be the
+// allocator of the builds using the cache. returns false when out of memory
+bool nvc_module_cache_init(nvc_module_cache_t* cache,
+                           nvc_allocator_t* allocator);
+void nvc_module_cache_free(nvc_module_cache_t* cache);
+
+// the module at key (a canonical path) is read and parsed again by the next
+// build that imports it, for a change the file times may not show
+void nvc_module_cache_invalidate(nvc_module_cache_t* cache, const char* key);
+
+typedef struct {
+    nvc_parse_options_t parse_options;
+    uint32_t max_errors;  // per module, 0 means no limit
+    uint32_t n_jobs;      // worker threads, 0 uses one per online cpu
+    uint32_t opt_level;   // 0 skips the IR passes
+    nvc_perf_profile_t* profile;  // not owned, every phase of every module
+                                  // is measured into it, NULL disables it
+    nvc_reader_backend_t reader;  // how sources are read, see nvc_reader.h
+    nvc_module_cache_t* cache;  // not owned, modules are reused from and
+                                // kept in it, NULL builds everything
+} nvc_build_options_t;
+
+typedef struct {
+    nvc_ast_node_t* node;  // the import decl
+    uint32_t module;       // index into nvc_build_t.modules or
+                           // NVC_MODULE_NONE when the module is not found or
+                           // the import closes a cycle
+} nvc_module_import_t;
+
+typedef struct {
+    char* path;  // owned, the path the module was found at (the bufname of
+                 // its diagnostics)
+    char* key;   // owned, canonical path identifying the module
+    char* buf;   // owned, source code, NULL if it could not be read
+    long bufsz;
+    nvc_context_t* ctx;  // tokens, AST, sema and diagnostics of the module
+    nvc_module_import_t* imports;  // indexed like the import decls
+    uint32_t n_imports;
+    // not owned, with a cache path, buf and ctx belong to this entry
+    nvc_cached_module_t* cached;
+    bool reused;  // the results of a previous build were reused, the module
+                  // was not read nor parsed
+    // the diagnostics of the previous build of a reused module, they are
+    // kept when it does not have to be resolved again
+    nvc_diagnostics_t previous;
+
+    // scheduling state, only used while building
+    uint32_t* dependents;  // modules importing this one
+    uint32_t n_dependents, dependents_capacity;
+    uint32_t n_pending;  // imports that are not resolved yet
+    bool loaded;  // buf was read by the reader, status tells why not if NULL
+    nvc_source_status_t status;
+} nvc_module_t;
+
+// result of building a module and everything it imports
+typedef struct {
+    nvc_allocator_t* allocator;
+    nvc_module_t** modules;  // modules[0] is the root, then discovery order
+    uint32_t n_modules, capacity;
+    uint32_t* order;  // module indices, every module after its imports
+    uint32_t n_errors;  // sum over the diagnostics of every module
+} nvc_build_t;
+
+// builds root_path and every module it imports directly or indirectly.
+// `import a.b` in dir/x.nv names the module dir/a/b.nv. the source of a
+// module is submitted to a nvc_reader_t as soon as it is discovered, so the
+// reads of the imports of a module overlap, and the module is lexed and
+// parsed in parallel with the others once its read completed. then import
+// cycles are reported and names are resolved in parallel in dependency
+// order: a module is resolved as soon as every module it imports is, against
+// their exported symbol tables which are shared read-only from then on.
+// note: allocator may be NULL to use nvc_default_allocator, with more than
+// one job or a reader it is used from several threads at once so must be
+// thread safe (the default allocator is, arenas and counting allocators are
+// not).
+// options may be NULL for defaults. errors are reported to the diagnostics
+// of the module they belong to, returns NULL only when out of memory
+nvc_build_t* nvc_build(nvc_allocator_t* allocator,
+                       const char* root_path,
+                       const nvc_build_options_t* options);
+
+void nvc_free_build(nvc_build_t* build);
+
+#endif  // NVC_BUILD_H
+
+#ifdef __cplusplus
+}
+#endif
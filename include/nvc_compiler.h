@@ -5,10 +5,32 @@ extern "C" {
 #ifndef NVC_COMPILER_H
 #define NVC_COMPILER_H
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 
-int nvc_compile(char* filename);
+#include <nvc_alloc.h>
+#include <nvc_ast.h>
+#include <nvc_reader.h>
+
+typedef struct {
+    nvc_parse_options_t parse;
+    uint32_t max_errors;  // per module, 0 means no limit
+    uint32_t n_jobs;      // 0 uses one per online cpu
+    uint32_t opt_level;   // 0 skips the IR passes
+    bool perf_counters;   // print hardware counters per phase, see nvc_perf.h
+    nvc_reader_backend_t reader;  // how sources are read, see nvc_reader.h
+    const char* object_path;  // when set the root module is compiled to an
+                              // x86-64 ELF object written there instead of
+                              // printing it, see nvc_x86_64.h
+} nvc_compile_options_t;
+
+// compiles filename and every module it imports, see nvc_build
+// note: allocator may be NULL to use nvc_default_allocator, options may be
+// NULL for defaults
+int nvc_compile(nvc_allocator_t* allocator,
+                char* filename,
+                const nvc_compile_options_t* options);
 
 #endif  // NVC_COMPILER_H
 
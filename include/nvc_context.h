@@ -0,0 +1,80 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef NVC_CONTEXT_H
+#define NVC_CONTEXT_H
+
+#include <nvc_alloc.h>
+#include <nvc_ast.h>
+#include <nvc_ir.h>
+#include <nvc_lexer.h>
+#include <nvc_output.h>
+#include <nvc_perf.h>
+#include <nvc_sema.h>
+
+// note: a context owns everything produced by compiling one buffer. contexts
+// share no state so one context per thread can be used concurrently, and a
+// context can be reset and reused to avoid reallocating between compiles
+typedef struct {
+    nvc_allocator_t* allocator;
+    nvc_parse_options_t parse_options;  // set before compiling, zeroed by
+                                        // nvc_context_create
+    uint32_t opt_level;  // set before compiling, 0 skips the IR passes
+    nvc_perf_profile_t* profile;  // not owned, set before compiling to
+                                  // measure every phase, NULL disables it
+    nvc_diagnostics_t diagnostics;  // everything reported while compiling,
+                                    // set diagnostics.max_errors to limit
+                                    // how many errors are collected
+    nvc_diagnostics_t parsed;  // what lexing and parsing reported, resolving
+                               // again starts over from these
+    bool resolved;  // nvc_context_resolve ran since the last parse
+    nvc_token_stream_t* tokens;     // NULL if out of memory or pipelined
+    nvc_arena_t strings;  // token strings when parse_options.pipeline is set
+    nvc_ast_t* ast;                 // NULL if out of memory
+    nvc_sema_t* sema;               // NULL if there is no ast
+    nvc_ir_module_t* ir;  // NULL if any error was reported
+} nvc_context_t;
+
+// note: allocator may be NULL to use nvc_default_allocator
+nvc_context_t* nvc_context_create(nvc_allocator_t* allocator);
+
+// note: frees the results of the previous compile, keeps the context usable
+void nvc_context_reset(nvc_context_t* ctx);
+
+void nvc_context_destroy(nvc_context_t* ctx);
+
+// compile an in-memory buffer, results are stored in ctx
+// note: buf must be null terminated at buf[bufsz], and both buf and bufname
+// are referenced (not copied) by the results so must outlive them. imports
+// are not resolved, see nvc_build.h to compile modules that import others
+// returns 0 on success and non-zero if any error was reported
+int nvc_compile_buffer(nvc_context_t* ctx,
+                       char* bufname,
+                       char* buf,
+                       long bufsz);
+
+// the two halves of nvc_compile_buffer for callers that need the imports of
+// the tree before resolving it. nvc_context_parse lexes and parses (same
+// requirements on buf and bufname as nvc_compile_buffer), then
+// nvc_context_resolve resolves names against the imported modules (see
+// nvc_resolve), lowers the tree to IR and optimizes it unless opt_level is 0
+// (see nvc_lower_ast and nvc_optimize_ir) and sorts the diagnostics.
+// nvc_context_resolve can run again on the same tree when the imported
+// modules changed, it replaces what the previous run reported. with
+// parse_options.lazy_bodies the tree must be parsed again first since the
+// bodies it parsed are no longer lazy
+// both return 0 on success and non-zero if any error was reported
+int nvc_context_parse(nvc_context_t* ctx,
+                      char* bufname,
+                      char* buf,
+                      long bufsz);
+int nvc_context_resolve(nvc_context_t* ctx,
+                        const nvc_sema_t* const* imports,
+                        uint32_t n_imports);
+
+#endif  // NVC_CONTEXT_H
+
+#ifdef __cplusplus
+}
+#endif
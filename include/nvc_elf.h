@@ -0,0 +1,106 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef NVC_ELF_H
+#define NVC_ELF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <nvc_alloc.h>
+#include <nvc_symtab.h>
+
+// the sections an object can put code and data in
+typedef enum {
+    NVC_ELF_TEXT = 0,
+    NVC_ELF_RODATA = 1,
+    NVC_ELF_BSS = 2,  // only has a size, no contents
+    NVC_ELF_N_SECTIONS = 3,
+} nvc_elf_section_t;
+
+// note: every section has a local section symbol with the same index, data
+// in a section is referenced through it plus an addend
+#define NVC_ELF_SECTION_SYMBOL(section) ((uint32_t)(section) + 1)
+
+#define NVC_ELF_UNDEFINED UINT32_MAX
+
+typedef struct {
+    char* name;        // owned
+    uint32_t section;  // nvc_elf_section_t or NVC_ELF_UNDEFINED
+    uint64_t value, size;
+    bool function;
+} nvc_elf_symbol_t;
+
+typedef struct {
+    uint64_t offset;  // into .text
+    uint32_t symbol;
+    uint32_t type;  // R_X86_64_*
+    int64_t addend;
+} nvc_elf_reloc_t;
+
+typedef struct {
+    uint8_t* data;  // NULL for .bss
+    uint64_t size, capacity;
+    uint64_t align;
+} nvc_elf_buf_t;
+
+// relocatable x86-64 ELF64 object under construction: code and data are
+// appended to the sections, symbols and relocations are collected and
+// nvc_elf_write lays it all out. the object has .text, .rodata, .bss,
+// .rela.text, .symtab, .strtab, .shstrtab and an empty .note.GNU-stack so
+// the stack is not executable
+// note: every symbol besides the section symbols is global, functions or
+// objects when defined and untyped when undefined
+typedef struct {
+    nvc_allocator_t* allocator;
+    nvc_elf_buf_t sections[NVC_ELF_N_SECTIONS];
+    nvc_elf_symbol_t* symbols;  // index 0 and the section symbols are not
+                                // stored, symbol i is symbols[i - 4]
+    uint32_t n_symbols, symbols_capacity;
+    nvc_symtab_t names;  // symbol name -> symbol index
+    nvc_elf_reloc_t* relocs;
+    uint32_t n_relocs, relocs_capacity;
+    bool out_of_memory;  // sticky, checked by nvc_elf_write
+} nvc_elf_object_t;
+
+// note: allocator may be NULL to use nvc_default_allocator
+void nvc_elf_init(nvc_elf_object_t* obj, nvc_allocator_t* allocator);
+void nvc_elf_free(nvc_elf_object_t* obj);
+
+// appends size bytes (zeros when data is NULL) after padding the section to
+// align, returns their offset. for .bss only the size grows
+uint64_t nvc_elf_append(nvc_elf_object_t* obj,
+                        nvc_elf_section_t section,
+                        const void* data,
+                        uint64_t size,
+                        uint64_t align);
+
+// the index of the symbol called name, it is added as undefined when there
+// is none yet. defining sets where it is, a symbol is defined at most once
+uint32_t nvc_elf_symbol(nvc_elf_object_t* obj, const char* name);
+void nvc_elf_define(nvc_elf_object_t* obj,
+                    uint32_t symbol,
+                    nvc_elf_section_t section,
+                    uint64_t value,
+                    uint64_t size,
+                    bool function);
+
+// records that the 4 bytes at offset in .text are patched by the linker
+void nvc_elf_reloc(nvc_elf_object_t* obj,
+                   uint64_t offset,
+                   uint32_t symbol,
+                   uint32_t type,
+                   int64_t addend);
+
+// writes the object, returns false on a write error or when something ran
+// out of memory before
+bool nvc_elf_write(nvc_elf_object_t* obj, FILE* out);
+
+#endif  // NVC_ELF_H
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,43 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef NVC_FMT_H
+#define NVC_FMT_H
+
+#include <stdbool.h>
+
+#include <nvc_alloc.h>
+
+typedef struct {
+    bool check;  // only list the files that are not formatted, nothing is
+                 // rewritten
+    // remembers the size, modification time and hash of every file found
+    // formatted so the next run skips it without formatting it again, NULL
+    // for no cache
+    const char* cache_path;
+} nvc_fmt_options_t;
+
+// formats every .nv file under paths (files or directories, searched
+// recursively) with nvc_format and lists the ones that changed. a file is
+// rewritten atomically: the result goes to a temporary file next to it that
+// is renamed over it, and only when its contents differ, which is found out
+// while formatting by comparing against the source as the output comes in.
+// the source is mapped rather than read into memory and the temporary file
+// is synced before the rename, so formatting takes the same memory for any
+// size of file and a crash never leaves a file half written.
+// with a cache a file whose size and modification time are unchanged is not
+// even read, one whose contents hash the same is not formatted
+// note: allocator may be NULL to use nvc_default_allocator, options may be
+// NULL for defaults. compressed sources are not formatted. returns non-zero
+// if a file could not be formatted or, with check, is not formatted
+int nvc_fmt(nvc_allocator_t* allocator,
+            char** paths,
+            int n_paths,
+            const nvc_fmt_options_t* options);
+
+#endif  // NVC_FMT_H
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,55 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef NVC_FORMAT_H
+#define NVC_FORMAT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <nvc_alloc.h>
+#include <nvc_output.h>
+
+// the output is collected in one buffer of this size and handed to the
+// writer whenever it is full, tokens are lexed NVC_FORMAT_BATCH at a time,
+// so formatting takes the same memory for any size of source
+#define NVC_FORMAT_BUFFER_SIZE (64 * 1024)
+#define NVC_FORMAT_BATCH 256
+// spaces per bracket level
+#define NVC_FORMAT_INDENT 4
+
+// receives the formatted source in order, returns false to stop formatting
+typedef bool (*nvc_format_write_t)(void* ctx, const char* data, size_t size);
+
+// re-emits the source in buf from its tokens in the canonical layout:
+// - every let, fun, type and import starts a line, other line breaks of the
+//   source are kept and runs of blank lines become one
+// - lines are indented by NVC_FORMAT_INDENT per open bracket, lines that
+//   continue a top level declaration by one more level
+// - binary operators, = and -> are surrounded by single spaces, commas and
+//   colons are followed by one, brackets, dots, calls, indexing and unary
+//   operators are not spaced
+// - comments, string literals and number literals are copied verbatim,
+//   comments stay on their own line or at the end of the line they were on
+// - no trailing whitespace and a single newline at the end
+// the tokens of the result are exactly the tokens of the source. a source
+// the lexer reports errors for (to diags, which may not be NULL) is not
+// formatted since what the lexer skipped would be lost, the output written
+// before the error is incomplete then.
+// note: allocator may be NULL to use nvc_default_allocator, buf has the
+// requirements of nvc_lexical_analysis. returns false on errors, when out of
+// memory (reported to diags) or when write returned false
+bool nvc_format(nvc_allocator_t* allocator,
+                nvc_diagnostics_t* diags,
+                char* bufname,
+                char* buf,
+                long bufsz,
+                nvc_format_write_t write,
+                void* ctx);
+
+#endif  // NVC_FORMAT_H
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,45 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef NVC_HASH_H
+#define NVC_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define NVC_HASH_SEED 0xcbf29ce484222325ULL
+
+// FNV-1a, small and fast enough for the short keys the compiler hashes
+static inline uint64_t nvc_hash_bytes(const void* data,
+                                      size_t len,
+                                      uint64_t seed) {
+    const unsigned char* bytes = data;
+    uint64_t hash = seed;
+    for (size_t i = 0; i < len; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static inline uint64_t nvc_hash_str(const char* str) {
+    uint64_t hash = NVC_HASH_SEED;
+    for (; *str; ++str) {
+        hash ^= (unsigned char)*str;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// note: combines an extra word into a hash (boost hash_combine style)
+static inline uint64_t nvc_hash_combine(uint64_t hash, uint64_t value) {
+    value *= 0x9e3779b97f4a7c15ULL;
+    return hash ^ (value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2));
+}
+
+#endif  // NVC_HASH_H
+
+#ifdef __cplusplus
+}
+#endif
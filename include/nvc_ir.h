@@ -0,0 +1,334 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef NVC_IR_H
+#define NVC_IR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <nvc_alloc.h>
+#include <nvc_ast.h>
+#include <nvc_bigint.h>
+#include <nvc_layout.h>
+#include <nvc_output.h>
+#include <nvc_sema.h>
+
+// note: a value is the index of the instruction defining it in
+// nvc_ir_function_t.insts, every instruction defines exactly one value (void
+// for the ones that are only executed for their effect)
+typedef uint32_t nvc_ir_value_t;
+
+#define NVC_IR_NONE UINT32_MAX
+
+// note: array values have the type of their elements and a non zero
+// nvc_ir_inst_t.length, their length is always known at compile time. record
+// values have NVC_IR_TYPE_RECORD and their type decl's layout.
+// int constants are NVC_IR_CONST while they are small and NVC_IR_BIG
+// otherwise, so the passes that fold constants never see an int that does
+// not fit an nvc_int. the elements of constant int arrays are always small.
+// i32, i64 and f32 are the fixed width numbers of nvc_number.h, f64 is
+// another name of fp
+typedef enum {
+    NVC_IR_TYPE_VOID = 0,
+    NVC_IR_TYPE_BOOL = 1,
+    NVC_IR_TYPE_INT = 2,  // exact, see nvc_bigint.h
+    NVC_IR_TYPE_FP = 3,   // nvc_fp
+    NVC_IR_TYPE_STR = 4,
+    NVC_IR_TYPE_RECORD = 5,  // a value of a type decl, see nvc_ir_inst_t.layout
+    NVC_IR_TYPE_I32 = 6,
+    NVC_IR_TYPE_I64 = 7,
+    NVC_IR_TYPE_F32 = 8,
+} nvc_ir_type_t;
+
+typedef enum {
+    NVC_IR_NOP = 0,  // removed instruction, defines nothing
+
+    // values
+    NVC_IR_CONST = 1,   // constant of the instruction type
+    NVC_IR_IMPORT = 2,  // value of a declaration exported by another module
+    NVC_IR_COPY = 3,    // operand 0, what a let lowers to
+    NVC_IR_PHI = 4,     // one operand per predecessor, in predecessor order
+    NVC_IR_PARAM = 5,   // value of parameter param, in the entry block
+    NVC_IR_BIG = 6,     // int constant big, which is never small
+
+    // arithmetic, both operands (and the result) have the instruction type
+    NVC_IR_ADD = 10,
+    NVC_IR_SUB = 11,
+    NVC_IR_MUL = 12,
+    NVC_IR_DIV = 13,  // ints truncate, division by zero traps
+    NVC_IR_POW = 14,  // ints need a non negative exponent
+    NVC_IR_NEG = 15,  // -operand 0
+    NVC_IR_NOT = 16,  // ~operand 0, bitwise for ints and logical for bools
+
+    // comparisons of two numbers of the same type, the result is a bool
+    NVC_IR_LT = 20,
+    NVC_IR_LE = 21,
+    NVC_IR_GT = 22,
+    NVC_IR_GE = 23,
+
+    // conversions
+    NVC_IR_ITOF = 30,     // int -> fp
+    NVC_IR_CONVERT = 31,  // operand 0 to the instruction type, between the
+                          // fixed width numbers and from and to ints and
+                          // fps (see nvc_number.h) but never fp -> int.
+                          // ints wrap to a fixed width int and fps truncate
+                          // to one
+
+    // arrays, arithmetic, comparisons, NEG, NOT, ITOF and CONVERT also work
+    // element by element on arrays of the same length
+    NVC_IR_ARRAY = 32,  // one operand per element
+    NVC_IR_SPLAT = 33,  // every element is operand 0
+    NVC_IR_INDEX = 34,  // element operand 1 of array operand 0, traps when
+                        // out of bounds
+
+    // records, see nvc_layout.h
+    NVC_IR_RECORD = 35,  // one operand per field, in declaration order
+    NVC_IR_FIELD = 36,   // field number field of record operand 0
+
+    // effects
+    NVC_IR_EXPORT = 40,  // publishes operand 0 to importers under name
+    NVC_IR_CALL = 41,    // calls function callee with one operand per
+                         // parameter, its result has the return type
+
+    // terminators, the last instruction of every block
+    NVC_IR_RET = 50,      // return operand 0 or nothing when NVC_IR_NONE
+    NVC_IR_BR = 51,       // jump to targets[0]
+    NVC_IR_COND_BR = 52,  // jump to targets[0] if operand 0 else targets[1]
+} nvc_ir_op_t;
+
+typedef struct {
+    nvc_ir_op_t op;
+    nvc_ir_type_t type;
+    uint32_t block;  // owning block, NVC_IR_NONE for NVC_IR_NOP
+    uint32_t length;  // element count of array values, 0 for scalars
+    uint32_t n_operands;
+    union {
+        nvc_ir_value_t ops[2];  // used when n_operands <= 2
+        nvc_ir_value_t* many;   // phis and arrays with more operands, owned
+    };
+    union {
+        // NVC_IR_CONST
+        nvc_int i;
+        nvc_fp fp;
+        bool b;
+        char* str;  // not owned, points into the token strings
+        // NVC_IR_BIG, not owned, points into the tokens or was allocated
+        // with nvc_ir_alloc_big
+        const nvc_bigint_t* big;
+        // NVC_IR_CONST arrays, see nvc_ir_alloc_elems, the elements have
+        // their native widths
+        nvc_int* ints;  // also i64
+        nvc_fp* fps;
+        int32_t* i32s;
+        float* f32s;
+        uint8_t* bools;
+        // NVC_IR_IMPORT
+        struct {
+            const nvc_sema_t* module;
+            uint32_t decl;  // index into module->decls
+        } import;
+        // NVC_IR_BR, NVC_IR_COND_BR
+        uint32_t targets[2];
+        // NVC_IR_FIELD, index into the fields of the record layout
+        uint32_t field;
+        // NVC_IR_PARAM, index into the parameters of the function
+        uint32_t param;
+        // NVC_IR_CALL, index into nvc_ir_module_t.functions
+        uint32_t callee;
+    };
+    const nvc_type_layout_t* layout;  // of record values, NULL otherwise
+    const char* name;  // not owned, the let or param it came from, the
+                       // exported name or the callee, NULL for temporaries
+    nvc_buffer_location_t buf_loc;
+} nvc_ir_inst_t;
+
+typedef struct {
+    nvc_ir_value_t* insts;  // in execution order, phis first and the
+                            // terminator last
+    uint32_t n_insts, capacity;
+    uint32_t* preds;  // indices into nvc_ir_function_t.blocks
+    uint32_t n_preds, preds_capacity;
+    bool removed;  // unreachable, kept so block indices stay stable
+} nvc_ir_block_t;
+
+// a parameter of a function, kept when its NVC_IR_PARAM is removed as unused
+typedef struct {
+    nvc_ir_type_t type;
+    const nvc_type_layout_t* layout;  // of records, NULL otherwise
+    nvc_ir_value_t value;  // its NVC_IR_PARAM in the entry block
+} nvc_ir_param_t;
+
+typedef struct {
+    nvc_allocator_t* allocator;
+    const char* name;
+    nvc_ir_inst_t* insts;  // every value ever defined, see nvc_ir_value_t
+    uint32_t n_insts, insts_capacity;
+    nvc_ir_block_t* blocks;  // blocks[0] is the entry
+    uint32_t n_blocks, blocks_capacity;
+    void** elems;  // elements of constant arrays and the ints of
+                   // NVC_IR_BIG, freed with the function
+    uint32_t n_elems, elems_capacity;
+    nvc_ir_param_t* params;  // in declaration order
+    uint32_t n_params;
+    nvc_ir_type_t ret_type;  // of the value returned, void for the module
+    uint32_t ret_length;     // initialiser (and while the return type of a
+    const nvc_type_layout_t* ret_layout;  // function is not known yet)
+} nvc_ir_function_t;
+
+typedef struct {
+    nvc_allocator_t* allocator;
+    nvc_ir_function_t** functions;  // functions[0] initialises the module,
+                                    // the others are the called fun decls
+    uint32_t n_functions, capacity;
+} nvc_ir_module_t;
+
+static inline nvc_ir_value_t* nvc_ir_operands(nvc_ir_inst_t* inst) {
+    return inst->n_operands > 2 ? inst->many : inst->ops;
+}
+
+static inline bool nvc_ir_is_terminator(nvc_ir_op_t op) {
+    return op == NVC_IR_RET || op == NVC_IR_BR || op == NVC_IR_COND_BR;
+}
+
+// bytes per element of an array of type
+static inline size_t nvc_ir_elem_size(nvc_ir_type_t type) {
+    switch (type) {
+        case NVC_IR_TYPE_INT:
+        case NVC_IR_TYPE_I64: return sizeof(nvc_int);
+        case NVC_IR_TYPE_FP: return sizeof(nvc_fp);
+        case NVC_IR_TYPE_I32: return sizeof(int32_t);
+        case NVC_IR_TYPE_F32: return sizeof(float);
+        case NVC_IR_TYPE_BOOL: return sizeof(uint8_t);
+        default: return 0;
+    }
+}
+
+static inline bool nvc_ir_is_numeric(nvc_ir_type_t type) {
+    return type == NVC_IR_TYPE_INT || type == NVC_IR_TYPE_FP ||
+           type >= NVC_IR_TYPE_I32;
+}
+
+// ints of any width, their constants are in nvc_ir_inst_t.i
+static inline bool nvc_ir_is_integral(nvc_ir_type_t type) {
+    return type == NVC_IR_TYPE_INT || type == NVC_IR_TYPE_I32 ||
+           type == NVC_IR_TYPE_I64;
+}
+
+// i32, i64 and f32
+static inline bool nvc_ir_is_fixed(nvc_ir_type_t type) {
+    return type >= NVC_IR_TYPE_I32;
+}
+
+// element k of the constant array inst as the scalar constant c of its type
+static inline void nvc_ir_get_elem(const nvc_ir_inst_t* inst,
+                                   uint32_t k,
+                                   nvc_ir_inst_t* c) {
+    switch (inst->type) {
+        case NVC_IR_TYPE_INT:
+        case NVC_IR_TYPE_I64: c->i = inst->ints[k]; break;
+        case NVC_IR_TYPE_I32: c->i = inst->i32s[k]; break;
+        case NVC_IR_TYPE_FP: c->fp = inst->fps[k]; break;
+        case NVC_IR_TYPE_F32: c->fp = inst->f32s[k]; break;
+        default: c->b = inst->bools[k]; break;
+    }
+}
+
+// stores the scalar constant c as element k of elems of type
+static inline void nvc_ir_set_elem(void* elems,
+                                   nvc_ir_type_t type,
+                                   uint32_t k,
+                                   const nvc_ir_inst_t* c) {
+    switch (type) {
+        case NVC_IR_TYPE_INT:
+        case NVC_IR_TYPE_I64: ((nvc_int*)elems)[k] = c->i; break;
+        case NVC_IR_TYPE_I32: ((int32_t*)elems)[k] = (int32_t)c->i; break;
+        case NVC_IR_TYPE_FP: ((nvc_fp*)elems)[k] = c->fp; break;
+        case NVC_IR_TYPE_F32: ((float*)elems)[k] = (float)c->fp; break;
+        default: ((uint8_t*)elems)[k] = c->b; break;
+    }
+}
+
+// true for instructions that can be removed when their value is unused and
+// merged with an identical one (no effects, can not trap)
+bool nvc_ir_is_pure(const nvc_ir_function_t* fun, const nvc_ir_inst_t* inst);
+
+// true for pure instructions that can also run when their value is not
+// needed (hoisted out of a loop that may not run): pure ones that can not
+// make an int past NVC_BIGINT_MAX_LIMBS limbs
+bool nvc_ir_is_speculatable(const nvc_ir_function_t* fun,
+                            const nvc_ir_inst_t* inst);
+
+const char* nvc_ir_type_to_str(nvc_ir_type_t type);
+const char* nvc_ir_op_to_str(nvc_ir_op_t op);
+
+// builder helpers, all of them return NVC_IR_NONE (or false) when out of
+// memory
+// note: they may grow insts so pointers into it are invalidated
+uint32_t nvc_ir_add_block(nvc_ir_function_t* fun);
+nvc_ir_value_t nvc_ir_append(nvc_ir_function_t* fun,
+                             uint32_t block,
+                             nvc_ir_op_t op,
+                             nvc_ir_type_t type,
+                             nvc_ir_value_t lhs,
+                             nvc_ir_value_t rhs);
+bool nvc_ir_add_edge(nvc_ir_function_t* fun, uint32_t from, uint32_t to);
+// storage for the elements of a constant array owned by fun, it lives until
+// fun is freed so instructions can share it
+void* nvc_ir_alloc_elems(nvc_ir_function_t* fun,
+                         nvc_ir_type_t type,
+                         uint32_t length);
+// storage for an int of n_limbs limbs owned by fun, like nvc_ir_alloc_elems
+nvc_bigint_t* nvc_ir_alloc_big(nvc_ir_function_t* fun, uint32_t n_limbs);
+
+// turns inst into a copy of value, its users see value from then on
+void nvc_ir_replace_with_copy(nvc_ir_function_t* fun,
+                              nvc_ir_value_t inst,
+                              nvc_ir_value_t value);
+
+// lowers a resolved tree to SSA form, the top level code becomes the
+// module initialiser. exported lets are kept alive by NVC_IR_EXPORT, every
+// other let is only alive while something uses it. operator chains are
+// lowered with the usual precedence (comparisons < + - < * / < ^, ^ is
+// right associative and unary operators bind tightest), mixed int and fp
+// operands are converted to fp and type errors are reported to diags.
+// operators between an array and a scalar apply the scalar to every element,
+// array literals of small literals become a single constant, int literals
+// that are not small become NVC_IR_BIG. a loop gets a
+// header block with a phi for its counter and accumulator, a body block
+// jumping back to the header and an exit block the rest of the code goes on
+// in, the loop value is the accumulator phi.
+// a fun decl becomes a function of the module the first time it is called,
+// its parameters have their declared types (builtin or record) and its body
+// evaluates to the value of its last expression or let, converted to the
+// declared return type. without one the return type is the type of the body,
+// so a function can only call itself when it declares it. a body can use its
+// parameters, its own lets, other functions and imported values but not the
+// lets of the module, which only the initialiser has.
+// the type (and length) of every let is stored in its sema decl, imported
+// values take the type stored by the exporting module so imports must be
+// lowered first
+// note: the module points into ast and sema (and the semas of the imports)
+// which must outlive it. returns NULL when out of memory
+nvc_ir_module_t* nvc_lower_ast(nvc_allocator_t* allocator,
+                               nvc_diagnostics_t* diags,
+                               nvc_ast_t* ast,
+                               nvc_sema_t* sema);
+
+void nvc_free_ir(nvc_ir_module_t* module);
+
+void nvc_print_ir(FILE* out, nvc_ir_module_t* module);
+
+// checks the invariants the passes rely on (operands are defined values,
+// blocks end with exactly one terminator, edges match the terminators),
+// problems are reported to diags. returns true if fun is well formed
+bool nvc_ir_verify(nvc_ir_function_t* fun, nvc_diagnostics_t* diags);
+
+#endif  // NVC_IR_H
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,80 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef NVC_LAYOUT_H
+#define NVC_LAYOUT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <nvc_alloc.h>
+#include <nvc_output.h>
+#include <nvc_sema.h>
+
+// largest record, larger ones are reported so offsets stay well within the
+// 32 bit displacements of the backends
+#define NVC_LAYOUT_MAX_SIZE (UINT32_C(1) << 30)
+
+// where a field of a record lives, the sizes are the ones the backends store
+// values with (see nvc_rt.h): 8 bytes for ints, i64s, fps and strings (a
+// pointer), 4 for i32s and f32s, 1 byte for bools, arrays and records hold
+// their elements and fields inline
+typedef struct {
+    const char* name;  // not owned, points into the token stream
+    uint32_t type;     // nvc_ir_type_t of the field
+    uint32_t length;   // element count of an array field, 0 for scalars
+    const nvc_type_layout_t* record;  // layout of a record field, else NULL
+    uint32_t size, align;
+    uint32_t offset;  // from the start of the record
+} nvc_field_layout_t;
+
+struct nvc_type_layout_s {
+    const char* name;  // not owned, points into the token stream
+    nvc_field_layout_t* fields;  // owned, in declaration order (the order of
+                                 // the constructor arguments)
+    uint32_t* order;  // owned, indices into fields by increasing offset
+    uint32_t n_fields;
+    uint32_t size;  // a multiple of align, the stride of consecutive records
+    uint32_t align;
+    uint32_t padding;      // bytes of size no field uses
+    uint32_t fixed_size;   // size with the fields in declaration order
+    bool fixed;            // type [fixed], the fields are not reordered
+};
+
+// true when name is a builtin type a field can have (int, fp, bool, str and
+// the fixed width i32, i64, f32 and f64, which is fp), its nvc_ir_type_t is
+// stored in type
+bool nvc_builtin_type(const char* name, uint32_t* type);
+
+// assigns an offset to every field of layout (their size and align must be
+// set) and computes size, align, padding and fixed_size. unless the layout
+// is fixed the fields are stored by decreasing alignment, declaration order
+// among equal ones: every size is a multiple of its alignment so no padding
+// is needed between them and only the end is padded up to the alignment,
+// which is the smallest size possible. fixed layouts keep the declaration
+// order and pad each field up to its alignment like a C struct. returns
+// false when the record would be larger than NVC_LAYOUT_MAX_SIZE
+bool nvc_layout_fields(nvc_type_layout_t* layout);
+
+// computes the layout of every type decl of sema from its members, the
+// member types are resolved already (see nvc_resolve) and imported types
+// have their layouts. a type that contains itself or is too large is
+// reported to diags and gets no layout, nor does any type containing it.
+// returns false when out of memory
+bool nvc_layout_types(nvc_sema_t* sema, nvc_diagnostics_t* diags);
+
+void nvc_free_layout(nvc_allocator_t* allocator, nvc_type_layout_t* layout);
+
+// prints the size and the fields of layout by offset, padding included
+void nvc_print_layout(FILE* out, const nvc_type_layout_t* layout);
+
+// prints the layout of every type decl of sema, nothing when it has none
+void nvc_print_layouts(FILE* out, const nvc_sema_t* sema);
+
+#endif  // NVC_LAYOUT_H
+
+#ifdef __cplusplus
+}
+#endif
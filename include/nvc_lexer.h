@@ -5,15 +5,16 @@ extern "C" {
 #ifndef NVC_LEXER_H
 #define NVC_LEXER_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 
+#include <nvc_alloc.h>
+#include <nvc_bigint.h>
+#include <nvc_number.h>
 #include <nvc_output.h>
 
-typedef int64_t nvc_int;
-typedef long double nvc_fp;
-
 typedef enum {
     NVC_OP_UNKNOWN = -1,
 
@@ -59,34 +60,95 @@ typedef enum {
     NVC_TOK_SYMBOL = 3,
     // operators
     NVC_TOK_OP = 4,
+    // comments, only when nvc_lexer_t.comments is set
+    NVC_TOK_COMMENT = 5,
+    // int literals past INT64_MAX
+    NVC_TOK_BIG_LIT = 6,
 } nvc_tok_kind_t;
 
 typedef struct {
     nvc_tok_kind_t kind;
+    uint8_t width;  // nvc_number_width_t of int and fp literals
     nvc_buffer_location_t buf_loc;
     union {
         nvc_int int_lit;  // note: this cannot (and will not) be negative
         nvc_fp fp_lit;    // note: this cannot (and will not) be negative
+        nvc_bigint_t* big_lit;  // this must be freed after use, it is never
+                                // negative either
         nvc_operator_kind_t op_kind;
         char* symbol;   // this must be freed after use and will never be NULL
         char* str_lit;  // this must be freed after use UNLESS NULL because
                         // of empty string lit
+        char* comment;  // not owned, points at the opening # in the buffer,
+                        // the comment runs up to the next #
     };
 } nvc_tok_t;
 
 typedef struct {
+    nvc_allocator_t* allocator;  // the allocator the stream (and the strings
+                                 // in its tokens) was allocated with
     nvc_tok_t* tokens;  // this will be automatically freed when
                         // nvc_free_token_stream on this
     uint32_t size;
 } nvc_token_stream_t;
 
+// incremental lexer state, see nvc_lexer_next
+typedef struct {
+    nvc_allocator_t* allocator;  // token strings are allocated with this
+    nvc_diagnostics_t* diags;
+    char* bufname;
+    char* buf;
+    char* buf_curr;
+    char* buf_end;
+    char* line_start_ptr;
+    uint32_t line_num;
+    uint32_t flags;  // inside a comment or string literal
+    nvc_buffer_location_t open_loc;  // where the open comment/string began
+    char* open_ptr;  // the # of the open comment, for comment tokens
+    bool done;    // the whole buffer was lexed
+    bool failed;  // out of memory (reported to diags), lexing stopped
+    bool ascii;   // no byte >= 0x80 in buf, columns are byte offsets
+    // also emit comments as NVC_TOK_COMMENT tokens located at their opening
+    // #, for tools that reproduce the source (the parser does not take them)
+    bool comments;
+    // columns count code points, this is the last one computed so the next
+    // one on the same line continues counting from there
+    char* col_line;
+    char* col_ptr;
+    uint32_t col;
+} nvc_lexer_t;
+
 char* nvc_op_to_str(nvc_operator_kind_t op);
 
 void nvc_free_token_stream(nvc_token_stream_t* stream);
 
-char* nvc_token_to_str(nvc_tok_t* token);
-
-nvc_token_stream_t* nvc_lexical_analysis(char* bufname, char* buf, long bufsz);
+// note: return value must be freed with allocator
+char* nvc_token_to_str(nvc_allocator_t* allocator, nvc_tok_t* token);
+
+// note: allocator may be NULL to use nvc_default_allocator, errors are
+// reported to diags (or stderr when NULL) and the offending chars skipped so
+// NULL is only returned when out of memory. buf must be null terminated at
+// buf[bufsz] and must outlive the returned stream as tokens point into it
+nvc_token_stream_t* nvc_lexical_analysis(nvc_allocator_t* allocator,
+                                         nvc_diagnostics_t* diags,
+                                         char* bufname,
+                                         char* buf,
+                                         long bufsz);
+
+// note: same requirements as nvc_lexical_analysis, allocator may not be NULL.
+// buf is validated as UTF-8 here, invalid sequences are reported to diags and
+// skipped by the lexer
+void nvc_lexer_init(nvc_lexer_t* lexer,
+                    nvc_allocator_t* allocator,
+                    nvc_diagnostics_t* diags,
+                    char* bufname,
+                    char* buf,
+                    long bufsz);
+
+// lexes the next (at most) max tokens into toks and returns how many were
+// written, the strings of the tokens are owned by the caller afterwards.
+// returns less than max only once lexer->done or lexer->failed is set
+uint32_t nvc_lexer_next(nvc_lexer_t* lexer, nvc_tok_t* toks, uint32_t max);
 
 #endif  // NVC_LEXER_H
 
@@ -0,0 +1,126 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef NVC_NUMBER_H
+#define NVC_NUMBER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int64_t nvc_int;
+// note: a double so fp values take 8 bytes and the SSE registers everywhere,
+// from the tokens to the code of the backends
+typedef double nvc_fp;
+
+typedef enum {
+    NVC_NUMBER_NONE = 0,  // not a number literal
+    NVC_NUMBER_INT = 1,
+    NVC_NUMBER_FP = 2,
+} nvc_number_kind_t;
+
+typedef enum {
+    NVC_NUMBER_OK = 0,
+    NVC_NUMBER_OVERFLOW = 1,   // value saturated to the largest representable
+    NVC_NUMBER_MALFORMED = 2,  // e.g. 0x without digits or 1e without exponent
+} nvc_number_status_t;
+
+// the width a suffix gives a number literal, see nvc_scan_number
+typedef enum {
+    NVC_WIDTH_NONE = 0,  // no suffix, the literal takes the width of what it
+                         // is used with (see nvc_lower_ast)
+    NVC_WIDTH_I32 = 1,
+    NVC_WIDTH_I64 = 2,
+    NVC_WIDTH_F32 = 3,
+    NVC_WIDTH_F64 = 4,  // the same as fp
+} nvc_number_width_t;
+
+typedef struct {
+    nvc_number_kind_t kind;
+    nvc_number_status_t status;
+    nvc_number_width_t width;
+    union {
+        nvc_int i;  // note: this cannot (and will not) be negative
+        nvc_fp fp;  // note: this cannot (and will not) be negative
+    };
+} nvc_number_t;
+
+// scans a single number literal starting at str in one pass and returns the
+// number of chars consumed, 0 if str does not start a number literal
+// supported forms:
+//  decimal ints    123
+//  hex/binary ints 0x7f 0b101
+//  decimals        1.5 .5 2. 1e10 1.5e-3 2E+4
+// any of them may end in a width suffix i32, i64, f32 or f64 (2i32, 0xffi64,
+// 1.5f32, 3f64). an f suffix makes a decimal int an fp, an i suffix on an fp
+// is malformed and an int past the range of its suffix overflows. f32
+// literals are rounded to the nearest float once, from the digits
+// note: never reads at or past end
+size_t nvc_scan_number(const char* str, const char* end, nvc_number_t* out);
+
+// the suffix of width, "" for NVC_WIDTH_NONE
+const char* nvc_width_to_str(nvc_number_width_t width);
+
+// the fixed width numbers: i32 and i64 wrap around like two's complement
+// (an i32 is kept sign extended in an nvc_int) and f32 results are rounded
+// to float (an f32 is kept in an nvc_fp). the constant folding and the
+// runtime share the helpers below so they agree with each other and with
+// the instructions the backends use
+static inline nvc_int nvc_wrap_i32(nvc_int value) {
+    return (int32_t)(uint32_t)(uint64_t)value;
+}
+
+static inline nvc_int nvc_wrap_add(nvc_int lhs, nvc_int rhs) {
+    return (nvc_int)((uint64_t)lhs + (uint64_t)rhs);
+}
+
+static inline nvc_int nvc_wrap_sub(nvc_int lhs, nvc_int rhs) {
+    return (nvc_int)((uint64_t)lhs - (uint64_t)rhs);
+}
+
+static inline nvc_int nvc_wrap_mul(nvc_int lhs, nvc_int rhs) {
+    return (nvc_int)((uint64_t)lhs * (uint64_t)rhs);
+}
+
+// note: rhs is not zero, the smallest value divided by -1 wraps to itself
+static inline nvc_int nvc_wrap_div(nvc_int lhs, nvc_int rhs) {
+    return rhs == -1 ? nvc_wrap_sub(0, lhs) : lhs / rhs;
+}
+
+// note: exponent is not negative
+static inline nvc_int nvc_wrap_pow(nvc_int base, nvc_int exponent) {
+    nvc_int result = 1;
+    for (; exponent; exponent >>= 1) {
+        if (exponent & 1) result = nvc_wrap_mul(result, base);
+        base = nvc_wrap_mul(base, base);
+    }
+    return result;
+}
+
+static inline nvc_fp nvc_round_f32(nvc_fp value) {
+    return (float)value;
+}
+
+// note: rounds once like cvtsi2ss, not through a double
+static inline nvc_fp nvc_int_to_f32(nvc_int value) {
+    return (float)value;
+}
+
+// truncates like cvttsd2si: nan and values out of range become the
+// smallest value of the width
+static inline nvc_int nvc_fp_to_i64(nvc_fp value) {
+    if (!(value >= -9223372036854775808.0 && value < 9223372036854775808.0))
+        return INT64_MIN;
+    return (nvc_int)value;
+}
+
+static inline nvc_int nvc_fp_to_i32(nvc_fp value) {
+    if (!(value > -2147483649.0 && value < 2147483648.0)) return INT32_MIN;
+    return (nvc_int)value;
+}
+
+#endif  // NVC_NUMBER_H
+
+#ifdef __cplusplus
+}
+#endif
@@ -5,7 +5,12 @@ extern "C" {
 #ifndef NVC_OUTPUT_H
 #define NVC_OUTPUT_H
 
+#include <stdarg.h>
+#include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
+
+#include <nvc_alloc.h>
 
 // note: this structure is purely used for reporting errors/warnings
 typedef struct {
@@ -18,6 +23,77 @@ typedef struct {
 
 void nvc_print_buffer_message(const char* msg, nvc_buffer_location_t loc);
 
+typedef enum {
+    NVC_SEVERITY_NOTE = 0,
+    NVC_SEVERITY_WARNING = 1,
+    NVC_SEVERITY_ERROR = 2,
+} nvc_severity_t;
+
+typedef struct {
+    nvc_severity_t severity;
+    bool has_loc;               // false for errors without a source location
+    nvc_buffer_location_t loc;  // only valid when has_loc
+    char* msg;  // owned by the nvc_diagnostics_t this was reported to
+} nvc_diagnostic_t;
+
+// note: buffered sink that the lexer and parser report into instead of
+// printing, the caller decides when and where to emit. notes belong to the
+// error/warning reported before them and stay attached to it
+typedef struct {
+    nvc_allocator_t* allocator;
+    nvc_diagnostic_t* diags;
+    uint32_t size, capacity;
+    uint32_t n_errors, n_warnings;
+    // errors past this are counted in n_suppressed but not stored, 0 means
+    // no limit
+    uint32_t max_errors;
+    uint32_t n_suppressed;
+    bool suppressing;  // drop the notes of a suppressed diagnostic
+} nvc_diagnostics_t;
+
+void nvc_diagnostics_init(nvc_diagnostics_t* diags, nvc_allocator_t* allocator);
+// note: drops all reported diagnostics but keeps the storage
+void nvc_diagnostics_clear(nvc_diagnostics_t* diags);
+void nvc_diagnostics_free(nvc_diagnostics_t* diags);
+
+// true once max_errors errors have been reported, passes may stop early
+bool nvc_diagnostics_full(const nvc_diagnostics_t* diags);
+
+// moves every diagnostic of src to the end of dst as if it was reported to
+// dst (so the error limit of dst applies), src is left empty. both must use
+// the same allocator since the messages change owner
+// note: used to combine sinks that were filled on different threads
+void nvc_diagnostics_merge(nvc_diagnostics_t* dst, nvc_diagnostics_t* src);
+
+// appends a copy of every diagnostic of src to dst, src is unchanged.
+// returns false when out of memory, dst then holds part of them
+bool nvc_diagnostics_copy(nvc_diagnostics_t* dst, const nvc_diagnostics_t* src);
+
+// sorts the diagnostics by location (keeping notes with their diagnostic)
+// and drops duplicates, call once all passes have reported
+void nvc_diagnostics_finish(nvc_diagnostics_t* diags);
+
+// note: when diags is NULL the diagnostic is printed to stderr immediately,
+// loc may be NULL
+void nvc_report(nvc_diagnostics_t* diags,
+                nvc_severity_t severity,
+                const nvc_buffer_location_t* loc,
+                const char* fmt,
+                ...) __attribute__((format(printf, 4, 5)));
+void nvc_vreport(nvc_diagnostics_t* diags,
+                 nvc_severity_t severity,
+                 const nvc_buffer_location_t* loc,
+                 const char* fmt,
+                 va_list args);
+
+const char* nvc_severity_to_str(nvc_severity_t severity);
+
+void nvc_print_diagnostic(FILE* out, const nvc_diagnostic_t* diag);
+
+// note: prints a summary line after the diagnostics when there were any
+// errors or warnings
+void nvc_print_diagnostics(FILE* out, const nvc_diagnostics_t* diags);
+
 #endif  // NVC_OUTPUT_H
 
 #ifdef __cplusplus
@@ -0,0 +1,123 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef NVC_PASSES_H
+#define NVC_PASSES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <nvc_alloc.h>
+#include <nvc_ir.h>
+#include <nvc_output.h>
+
+// rounds over the whole pipeline before the pass manager gives up on
+// reaching a fixed point
+#define NVC_PASS_MAX_ROUNDS 8
+
+// loops running at most this many times are unrolled completely, as long
+// as that copies at most NVC_UNROLL_MAX_INSTS instructions
+#define NVC_UNROLL_MAX_TRIPS 16
+#define NVC_UNROLL_MAX_INSTS 256
+
+// a call is inlined when the body of its callee is at most
+// NVC_INLINE_THRESHOLD instructions larger than the call it replaces
+// (NVC_INLINE_CALL_COST plus one per argument), every constant argument
+// allows NVC_INLINE_CONST_ARG_BONUS more since it lets part of the body
+// fold. callers are not grown beyond NVC_INLINE_MAX_INSTS instructions
+#define NVC_INLINE_THRESHOLD 8
+#define NVC_INLINE_CALL_COST 4
+#define NVC_INLINE_CONST_ARG_BONUS 8
+#define NVC_INLINE_MAX_INSTS 4096
+
+typedef enum {
+    NVC_PASS_UNCHANGED = 0,
+    NVC_PASS_CHANGED = 1,
+    NVC_PASS_OUT_OF_MEMORY = 2,
+} nvc_pass_result_t;
+
+typedef nvc_pass_result_t (*nvc_pass_fn_t)(nvc_ir_function_t* fun);
+
+typedef struct {
+    const char* name;
+    nvc_pass_fn_t run;
+    uint32_t n_changed;  // functions the pass changed, for statistics
+} nvc_pass_t;
+
+// runs a pipeline of passes over every function of a module, the pipeline
+// is repeated until no pass changes anything (passes enable each other, e.g.
+// simplification exposes copies and copy propagation exposes dead code)
+typedef struct {
+    nvc_allocator_t* allocator;
+    nvc_pass_t* passes;
+    uint32_t n_passes, capacity;
+    bool verify;  // run nvc_ir_verify after every pass
+} nvc_pass_manager_t;
+
+// note: allocator may be NULL to use nvc_default_allocator
+void nvc_pass_manager_init(nvc_pass_manager_t* pm, nvc_allocator_t* allocator);
+void nvc_pass_manager_free(nvc_pass_manager_t* pm);
+// returns false when out of memory
+bool nvc_pass_manager_add(nvc_pass_manager_t* pm,
+                          const char* name,
+                          nvc_pass_fn_t run);
+// adds simplify, copy-prop, gvn, unroll, licm, strength-reduce and dce in
+// that order
+bool nvc_pass_manager_add_defaults(nvc_pass_manager_t* pm);
+// note: problems found by verify and running out of memory are reported to
+// diags, returns false if either happened
+bool nvc_pass_manager_run(nvc_pass_manager_t* pm,
+                          nvc_diagnostics_t* diags,
+                          nvc_ir_module_t* module);
+
+// runs the default pipeline over module, then inlines calls with
+// nvc_pass_inline and runs the pipeline again if anything was
+bool nvc_optimize_ir(nvc_allocator_t* allocator,
+                     nvc_diagnostics_t* diags,
+                     nvc_ir_module_t* module);
+
+// algebraic simplification and constant folding: folds operations on
+// constants, removes identities (x+0, x*1, x/1, x^1, --x), rewrites
+// x^2 to x*x and x^0 to 1, and moves constants to the right of commutative
+// operations. only rewrites that are exact for fp are applied to fp.
+// branches on constants become jumps, phis of a single value become copies
+// and a block only reached by a jump is merged into the block jumping
+nvc_pass_result_t nvc_pass_simplify(nvc_ir_function_t* fun);
+// replaces every use of a copy with the value it copies
+nvc_pass_result_t nvc_pass_copy_propagation(nvc_ir_function_t* fun);
+// global value numbering: a pure instruction computing the same value as
+// one dominating it becomes a copy of it
+nvc_pass_result_t nvc_pass_gvn(nvc_ir_function_t* fun);
+// removes unreachable blocks and pure instructions whose value is unused
+// (which includes lets nothing reads)
+nvc_pass_result_t nvc_pass_dce(nvc_ir_function_t* fun);
+
+// the loop passes work on loops with a single entry from a preheader and a
+// single back edge, which is how nvc_lower_ast lowers for and while
+
+// loop invariant code motion: pure instructions whose operands are all
+// computed before a loop move to its preheader
+nvc_pass_result_t nvc_pass_licm(nvc_ir_function_t* fun);
+// an int multiplication of an induction variable (a header phi the loop
+// adds an invariant step to) by an invariant becomes a new induction
+// variable the loop adds step times the invariant to
+nvc_pass_result_t nvc_pass_strength_reduction(nvc_ir_function_t* fun);
+// full unrolling of loops of a header and a latch whose condition compares
+// an induction variable with constant start and step against a constant,
+// see NVC_UNROLL_MAX_TRIPS. the iterations are copied to the preheader and
+// the header runs once with the final values
+nvc_pass_result_t nvc_pass_unroll(nvc_ir_function_t* fun);
+
+// replaces the calls of non recursive functions with a copy of the body of
+// the callee where the cost model finds it worth it (see
+// NVC_INLINE_THRESHOLD), callees before their callers. a module pass since
+// it reads the callees, the functions that are no longer called stay in the
+// module
+nvc_pass_result_t nvc_pass_inline(nvc_ir_module_t* module);
+
+#endif  // NVC_PASSES_H
+
+#ifdef __cplusplus
+}
+#endif
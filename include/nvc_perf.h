@@ -0,0 +1,95 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef NVC_PERF_H
+#define NVC_PERF_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// per phase profiling with the hardware counters of linux perf_event_open.
+// the counters follow the thread that opened them, so a phase is measured on
+// the thread running it and phases running in parallel on different threads
+// (e.g. the modules of a build) are measured independently and summed.
+// counters that can not be opened (not linux, a container without access,
+// perf_event_paranoid too high, a pmu without that event) are reported as
+// unavailable and the wall clock time is still measured
+
+typedef enum {
+    NVC_PERF_CYCLES = 0,
+    NVC_PERF_INSTRUCTIONS = 1,
+    NVC_PERF_BRANCH_MISSES = 2,
+    NVC_PERF_L1D_MISSES = 3,  // l1 data cache read misses
+    NVC_PERF_LLC_MISSES = 4,  // last level cache read misses
+    NVC_PERF_PAGE_FAULTS = 5,
+    NVC_PERF_N_COUNTERS = 6,
+} nvc_perf_counter_t;
+
+typedef enum {
+    NVC_PHASE_READ = 0,  // reading (and decompressing) the source
+    NVC_PHASE_LEX = 1,
+    NVC_PHASE_PARSE = 2,  // when pipelined this includes waiting for tokens
+    NVC_PHASE_RESOLVE = 3,
+    NVC_PHASE_LOWER = 4,
+    NVC_PHASE_OPTIMIZE = 5,
+    NVC_PHASE_N = 6,
+} nvc_phase_t;
+
+typedef struct {
+    uint64_t ns;  // wall clock
+    uint64_t counts[NVC_PERF_N_COUNTERS];
+    uint32_t n_spans;
+    uint32_t missing;  // bit per counter that was unavailable in any span
+} nvc_perf_phase_t;
+
+// note: shared by every thread of a build, the totals are guarded by lock
+typedef struct {
+    pthread_mutex_t lock;
+    nvc_perf_phase_t phases[NVC_PHASE_N];
+    uint64_t n_bytes;   // source bytes read
+    uint64_t n_tokens;  // tokens lexed
+    int error;  // errno of the first counter that could not be opened
+} nvc_perf_profile_t;
+
+// one measurement of a phase on the calling thread
+typedef struct {
+    nvc_perf_profile_t* profile;  // NULL when not profiling
+    nvc_phase_t phase;
+    uint64_t start_ns;
+    uint64_t start[NVC_PERF_N_COUNTERS];
+    uint64_t start_enabled[NVC_PERF_N_COUNTERS];
+    uint64_t start_running[NVC_PERF_N_COUNTERS];
+    uint32_t missing;
+} nvc_perf_span_t;
+
+void nvc_perf_profile_init(nvc_perf_profile_t* profile);
+void nvc_perf_profile_free(nvc_perf_profile_t* profile);
+
+// starts measuring phase on the calling thread, a NULL profile makes this
+// and nvc_perf_end do nothing. the counters of a thread are opened on its
+// first span and closed when it exits
+void nvc_perf_begin(nvc_perf_span_t* span,
+                    nvc_perf_profile_t* profile,
+                    nvc_phase_t phase);
+// adds what happened since nvc_perf_begin to the profile, must be called on
+// the thread that began the span
+void nvc_perf_end(nvc_perf_span_t* span);
+
+// note: profile may be NULL
+void nvc_perf_add_bytes(nvc_perf_profile_t* profile, uint64_t n);
+void nvc_perf_add_tokens(nvc_perf_profile_t* profile, uint64_t n);
+
+const char* nvc_phase_to_str(nvc_phase_t phase);
+const char* nvc_perf_counter_to_str(nvc_perf_counter_t counter);
+
+// prints a table of every measured phase with IPC and cycles per source byte
+// and per token
+void nvc_perf_print(FILE* fp, const nvc_perf_profile_t* profile);
+
+#endif  // NVC_PERF_H
+
+#ifdef __cplusplus
+}
+#endif
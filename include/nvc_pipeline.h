@@ -0,0 +1,89 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef NVC_PIPELINE_H
+#define NVC_PIPELINE_H
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <nvc_alloc.h>
+#include <nvc_ast.h>
+#include <nvc_lexer.h>
+#include <nvc_output.h>
+#include <nvc_perf.h>
+
+// tokens in flight between the lexer and the parser, bounds the memory the
+// pipeline needs no matter how large the input is
+#define NVC_TOKEN_RING_CAPACITY 1024
+// the lexer publishes tokens in batches of at most this many so the indices
+// shared between the threads are touched once per batch, not per token
+#define NVC_TOKEN_RING_BATCH 64
+
+// lock-free single producer single consumer ring of tokens. the producer
+// only writes tail and the consumer only writes head, each on its own cache
+// line. a full ring makes the producer wait (back-pressure) and an empty one
+// makes the consumer wait
+typedef struct {
+    nvc_allocator_t* allocator;
+    nvc_tok_t* slots;
+    uint32_t capacity;  // always a power of two
+    alignas(64) atomic_uint head;  // next slot to consume
+    alignas(64) atomic_uint tail;  // next slot to produce
+    atomic_bool closed;     // set by the producer after its last commit
+    atomic_bool cancelled;  // set by the consumer when it stops early
+} nvc_token_ring_t;
+
+// note: capacity is rounded up to a power of two
+bool nvc_token_ring_init(nvc_token_ring_t* ring,
+                         nvc_allocator_t* allocator,
+                         uint32_t capacity);
+void nvc_token_ring_free(nvc_token_ring_t* ring);
+
+// producer: waits for free slots and returns the contiguous run of them
+// (at most max) in *n, returns NULL once the consumer cancelled
+nvc_tok_t* nvc_token_ring_reserve(nvc_token_ring_t* ring,
+                                  uint32_t max,
+                                  uint32_t* n);
+// producer: publishes the first n reserved slots
+void nvc_token_ring_commit(nvc_token_ring_t* ring, uint32_t n);
+// producer: no more tokens will be committed
+void nvc_token_ring_close(nvc_token_ring_t* ring);
+
+// consumer: waits for tokens and copies up to max of them to toks, returns 0
+// once the ring is closed and empty
+uint32_t nvc_token_ring_pop(nvc_token_ring_t* ring,
+                            nvc_tok_t* toks,
+                            uint32_t max);
+// consumer: no more tokens will be popped, makes the producer stop
+void nvc_token_ring_cancel(nvc_token_ring_t* ring);
+
+// lexes on a second thread while parsing on the calling one, tokens flow
+// through a nvc_token_ring_t so lexing and parsing overlap and only a
+// bounded amount of tokens exists at any time (see nvc_parse_incremental).
+// token strings are allocated from strings and the tree points into it, so
+// it must outlive the returned tree. diagnostics of both phases end up in
+// diags. falls back to lexing on the calling thread when no thread can be
+// started. with a profile (may be NULL) the lexer thread is measured as the
+// lex phase and the calling thread as the parse phase, without a thread both
+// are counted as parsing
+// note: allocator and the backing allocator of strings are used from both
+// threads and must be thread safe (the default allocator is). returns NULL
+// only when out of memory
+nvc_ast_t* nvc_lex_and_parse_pipelined(nvc_allocator_t* allocator,
+                                       nvc_diagnostics_t* diags,
+                                       nvc_arena_t* strings,
+                                       char* bufname,
+                                       char* buf,
+                                       long bufsz,
+                                       const nvc_parse_options_t* options,
+                                       nvc_perf_profile_t* profile);
+
+#endif  // NVC_PIPELINE_H
+
+#ifdef __cplusplus
+}
+#endif
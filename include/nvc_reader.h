@@ -0,0 +1,108 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef NVC_READER_H
+#define NVC_READER_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <nvc_alloc.h>
+#include <nvc_perf.h>
+#include <nvc_source.h>
+
+// files in flight at once with io_uring, each needs at most two entries of
+// the submission queue at a time
+#define NVC_READER_URING_FILES 64
+// threads of the fallback backend, more than there are cpus since they
+// mostly wait for the file system
+#define NVC_READER_N_THREADS 8
+
+typedef enum {
+    NVC_READER_AUTO = 0,     // io_uring when the kernel allows it, otherwise
+                             // threads
+    NVC_READER_URING = 1,    // io_uring only
+    NVC_READER_THREADS = 2,  // a pool of threads calling open, fstat, pread
+    NVC_READER_SYNC = 3,     // no reader, files are read by whoever needs
+                             // them (not handled by nvc_reader_start)
+} nvc_reader_backend_t;
+
+// called once per submitted file from a thread of the reader with what
+// nvc_read_source_file would have returned for it. buf is owned by the
+// callee, NULL when the file could not be read (the reason is in status)
+typedef void (*nvc_reader_done_t)(void* ctx,
+                                  void* file,
+                                  char* buf,
+                                  long bufsz,
+                                  nvc_source_status_t status);
+
+typedef struct nvc_read_s nvc_read_t;
+
+// reads source files in the background: opens, stats and reads of every
+// submitted file are issued together so the latency of one file hides
+// behind the others, which is what matters on network file systems. with
+// io_uring a single thread submits them in batches through the raw system
+// calls (no liburing) and reaps the completions, without it a pool of
+// threads reads one file each at a time. a file is handed to the callback
+// as soon as its last read completes, in no particular order
+typedef struct {
+    nvc_allocator_t* allocator;
+    nvc_reader_backend_t backend;  // the one running, never AUTO
+    nvc_reader_done_t done;
+    void* ctx;
+    // every file is measured as a NVC_PHASE_READ span from its open up to
+    // the decoded buffer, NULL when not profiling
+    // note: with io_uring the spans of the files in flight together overlap
+    // on the ring thread, so their times add up like those of parallel jobs
+    nvc_perf_profile_t* profile;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;  // threads backend: signalled on submit and stop
+    nvc_read_t* queue;    // submitted and not started yet, oldest first
+    nvc_read_t* queue_tail;
+    bool stop;
+    pthread_t* threads;
+    uint32_t n_threads;
+
+    // io_uring backend, the queues are shared with the kernel
+    int ring_fd;
+    int event_fd;  // written on submit and stop to wake the ring thread
+    void* sq_ring;
+    void* cq_ring;  // the same mapping as sq_ring when the kernel allows
+    size_t sq_ring_size, cq_ring_size;
+    void* sqes;
+    size_t sqes_size;
+    uint32_t *sq_tail, *sq_array, sq_mask;
+    uint32_t *cq_head, *cq_tail, cq_mask;
+    void* cqes;
+} nvc_reader_t;
+
+// starts a reader with backend (AUTO, URING or THREADS), done is called
+// with ctx for every submitted file. profile may be NULL.
+// note: allocator may be NULL to use nvc_default_allocator, it is used from
+// the reader threads and must be thread safe. returns false when the
+// backend can not be started (no io_uring or no thread)
+bool nvc_reader_start(nvc_reader_t* reader,
+                      nvc_allocator_t* allocator,
+                      nvc_reader_backend_t backend,
+                      nvc_reader_done_t done,
+                      void* ctx,
+                      nvc_perf_profile_t* profile);
+
+// queues path to be read, file is passed to the callback as is. path must
+// stay valid until the callback ran. returns false when out of memory, the
+// callback is not called for the file then
+bool nvc_reader_submit(nvc_reader_t* reader, const char* path, void* file);
+
+// waits for every submitted file and stops the threads
+void nvc_reader_stop(nvc_reader_t* reader);
+
+const char* nvc_reader_backend_to_str(nvc_reader_backend_t backend);
+
+#endif  // NVC_READER_H
+
+#ifdef __cplusplus
+}
+#endif
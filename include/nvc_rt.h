@@ -0,0 +1,134 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef NVC_RT_H
+#define NVC_RT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// runtime of the objects written by nvc -c (see nvc_x86_64.h), linked as
+// libnvcrt.a. a module m compiled to an object defines
+//   m:init  initialises the module once, after the modules it imports
+//   m.<x>   the value of every exported let x, 8 bytes for scalars (ints
+//           as an nvc_rt_int_t, fps as doubles, bools as 0 or 1, strings as
+//           a pointer to a null terminated string, i64s as themselves, i32s
+//           sign extended and f32s as a float in the low 4 bytes with the
+//           others 0), the elements for arrays and the fields
+//           at their offsets in the layout for records (see nvc_layout.h,
+//           bools take a single byte there and i32s and f32s 4)
+//   m:fun.<f>  every fun f the initialiser calls, called with rdi pointing
+//           to the arguments, 8 bytes each (like the values above, arrays
+//           and records as a pointer to them), and rsi to a buffer for an
+//           array or record result. the result is returned in rax, for
+//           arrays and records as the pointer to the buffer
+// the names can not clash with C symbols, C code reaches them with an asm
+// label. the runtime main runs main:init, so the module in main.nv is the
+// entry point of a program
+// note: the values below are part of the calling convention of the objects,
+// changing them requires recompiling every object
+
+// why a program stopped, passed to nvc_rt_trap
+typedef enum {
+    NVC_RT_TRAP_DIV_BY_ZERO = 1,
+    NVC_RT_TRAP_OVERFLOW = 2,  // an int past NVC_BIGINT_MAX_LIMBS limbs
+    NVC_RT_TRAP_NEGATIVE_EXPONENT = 3,  // int ^ negative int
+    NVC_RT_TRAP_OUT_OF_BOUNDS = 4,
+    NVC_RT_TRAP_OUT_OF_MEMORY = 5,
+} nvc_rt_trap_t;
+
+// an int is a tagged word: a small int v (see nvc_bigint.h) is v << 1 and
+// any other int is the address of its nvc_bigint_t with the low bit set, so
+// the code of an object adds, subtracts, multiplies and compares small ints
+// inline and only calls the functions below when a tag is set or the
+// result overflows. the ints that are not small are allocated when they are
+// made and never freed, the ones of constants live in the object
+typedef uint64_t nvc_rt_int_t;
+
+// element type of the array helpers
+typedef enum {
+    NVC_RT_INT = 0,   // nvc_rt_int_t
+    NVC_RT_FP = 1,    // double
+    NVC_RT_BOOL = 2,  // uint8_t, 0 or 1
+    NVC_RT_I32 = 3,   // int32_t
+    NVC_RT_I64 = 4,   // int64_t
+    NVC_RT_F32 = 5,   // float
+} nvc_rt_type_t;
+
+// element-wise operations of the array helpers
+typedef enum {
+    NVC_RT_ADD = 0,
+    NVC_RT_SUB = 1,
+    NVC_RT_MUL = 2,
+    NVC_RT_DIV = 3,
+    NVC_RT_POW = 4,
+    NVC_RT_LT = 5,  // comparisons write bools
+    NVC_RT_LE = 6,
+    NVC_RT_GT = 7,
+    NVC_RT_GE = 8,
+    NVC_RT_NEG = 9,
+    NVC_RT_NOT = 10,   // bitwise for ints and logical for bools
+    NVC_RT_ITOF = 11,  // int -> fp
+} nvc_rt_op_t;
+
+// prints why the program stopped to stderr and exits with status 1
+_Noreturn void nvc_rt_trap(uint32_t trap);
+
+// exact int arithmetic, division and power trap like the IR says (see
+// nvc_ir.h)
+nvc_rt_int_t nvc_rt_int_add(nvc_rt_int_t lhs, nvc_rt_int_t rhs);
+nvc_rt_int_t nvc_rt_int_sub(nvc_rt_int_t lhs, nvc_rt_int_t rhs);
+nvc_rt_int_t nvc_rt_int_mul(nvc_rt_int_t lhs, nvc_rt_int_t rhs);
+nvc_rt_int_t nvc_rt_int_div(nvc_rt_int_t lhs, nvc_rt_int_t rhs);
+nvc_rt_int_t nvc_rt_int_pow(nvc_rt_int_t base, nvc_rt_int_t exponent);
+nvc_rt_int_t nvc_rt_int_neg(nvc_rt_int_t value);
+nvc_rt_int_t nvc_rt_int_not(nvc_rt_int_t value);
+// -1, 0 or 1 when lhs is less than, equal to or greater than rhs
+int nvc_rt_int_compare(nvc_rt_int_t lhs, nvc_rt_int_t rhs);
+// the nearest double
+double nvc_rt_int_to_fp(nvc_rt_int_t value);
+// the low 64 bits in two's complement, for the conversion to i64 and i32
+int64_t nvc_rt_int_wrap_i64(nvc_rt_int_t value);
+double nvc_rt_pow_fp(double base, double exponent);
+
+// the fixed width operations without an instruction, they wrap around like
+// nvc_number.h says and trap like the int ones. i32s use the i64 ones and
+// wrap the result
+int64_t nvc_rt_div_i64(int64_t lhs, int64_t rhs);
+int64_t nvc_rt_pow_i64(int64_t base, int64_t exponent);
+float nvc_rt_pow_f32(float base, float exponent);
+
+// for C code reading and passing ints: false when value does not fit an
+// int64_t, the decimal form (with malloc, NULL when out of memory)
+nvc_rt_int_t nvc_rt_int_from_i64(int64_t value);
+bool nvc_rt_int_to_i64(nvc_rt_int_t value, int64_t* out);
+char* nvc_rt_int_to_str(nvc_rt_int_t value);
+
+// dst[k] = lhs[k] op rhs[k] for k < n, type is the type of the operands
+void nvc_rt_vec_binary(uint32_t op,
+                       uint32_t type,
+                       void* dst,
+                       const void* lhs,
+                       const void* rhs,
+                       uint64_t n);
+// dst[k] = op src[k] for k < n, type is the type of the operand
+void nvc_rt_vec_unary(uint32_t op,
+                      uint32_t type,
+                      void* dst,
+                      const void* src,
+                      uint64_t n);
+// every element of dst becomes the scalar whose bits are value
+void nvc_rt_vec_splat(uint32_t type, void* dst, uint64_t value, uint64_t n);
+// dst[k] = src[k] converted like NVC_IR_CONVERT (see nvc_ir.h) for k < n
+void nvc_rt_vec_convert(uint32_t to,
+                        uint32_t from,
+                        void* dst,
+                        const void* src,
+                        uint64_t n);
+
+#endif  // NVC_RT_H
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,86 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef NVC_SEMA_H
+#define NVC_SEMA_H
+
+#include <nvc_ast.h>
+#include <nvc_output.h>
+#include <nvc_symtab.h>
+
+typedef enum {
+    NVC_DECL_LET = 0,
+    NVC_DECL_FUN = 1,
+    NVC_DECL_PARAM = 2,
+    NVC_DECL_IMPORT = 3,  // a declaration of another module
+    NVC_DECL_TYPE = 4,
+    NVC_DECL_LOOP = 5,  // the counter or the accumulator of a loop
+} nvc_decl_kind_t;
+
+typedef struct nvc_sema_s nvc_sema_t;
+typedef struct nvc_type_layout_s nvc_type_layout_t;  // see nvc_layout.h
+
+typedef struct {
+    nvc_decl_kind_t kind;
+    char* name;  // not owned, points into the token stream
+    nvc_ast_node_t* node;  // the let/fun/type decl node, for params the
+                           // fun decl node the param belongs to, for loop
+                           // names the loop node, for imports
+                           // the import decl node the symbol was found
+                           // through
+    uint32_t param_index;  // only valid for NVC_DECL_PARAM, for NVC_DECL_LOOP
+                           // 0 for the counter and 1 for the accumulator
+    const nvc_sema_t* module;  // only valid for NVC_DECL_IMPORT, the sema
+    uint32_t module_decl;      // of the imported module and the index of
+                               // the declaration in its decls
+    uint32_t scope_depth;  // 0 is the top level scope
+    uint32_t n_refs;       // amount of symbol references resolved to this
+    uint32_t value_type;   // nvc_ir_type_t of a let once nvc_lower_ast ran,
+                           // before the sema is shared with importers
+    uint32_t value_length;  // element count when the let is an array
+    const nvc_type_layout_t* value_layout;  // type of the let when it is a
+                                            // record
+    nvc_type_layout_t* layout;  // only valid for NVC_DECL_TYPE, owned. NULL
+                                // when the type is invalid
+    nvc_buffer_location_t buf_loc;
+} nvc_decl_t;
+
+// result of name resolution, every symbol reference in the AST holds an
+// index into decls once nvc_resolve has run
+struct nvc_sema_s {
+    nvc_allocator_t* allocator;
+    nvc_decl_t* decls;
+    uint32_t n_decls, capacity;
+    nvc_symtab_t exports;  // top level let/fun/type name -> index into
+                           // decls. never modified after nvc_resolve
+                           // returns so importers on any thread may look
+                           // names up
+};
+
+// resolves every symbol reference in ast to its let/fun/param/type/loop
+// declaration or to an exported declaration of an imported module, the
+// member types of type decls and the types in fun signatures included, then
+// computes the layout of every type (see nvc_layout_types). imports[i] is
+// the sema of the module named by the import decl with index i, NULL when
+// that module is unavailable (it failed to build or imports == NULL). names
+// that are not found while an unavailable import is visible are not reported
+// since they may come from it. undefined symbols are reported as errors and
+// shadowing as warnings to diags. a lazily parsed fun body (see
+// lazy_bodies) is only parsed and resolved once something resolved
+// references the function, so the errors in the bodies of unreferenced
+// functions are never reported
+// note: returns NULL only when out of memory, check diags for errors
+nvc_sema_t* nvc_resolve(nvc_allocator_t* allocator,
+                        nvc_diagnostics_t* diags,
+                        nvc_ast_t* ast,
+                        const nvc_sema_t* const* imports,
+                        uint32_t n_imports);
+
+void nvc_free_sema(nvc_sema_t* sema);
+
+#endif  // NVC_SEMA_H
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,73 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef NVC_SIMD_H
+#define NVC_SIMD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// element-wise kernels over arrays of 64 bit ints, doubles and bools (one
+// byte each, 0 or 1). every kernel has a scalar version and on x86 SSE2, AVX
+// and AVX2 ones, the best one the cpu supports is picked on first use.
+// dst may be a or b, any other overlap is undefined
+
+typedef enum {
+    NVC_SIMD_SCALAR = 0,
+    NVC_SIMD_SSE2 = 1,
+    NVC_SIMD_AVX = 2,
+    NVC_SIMD_AVX2 = 3,
+} nvc_simd_level_t;
+
+typedef enum {
+    NVC_SIMD_ADD = 0,
+    NVC_SIMD_SUB = 1,
+    NVC_SIMD_MUL = 2,
+    NVC_SIMD_DIV = 3,  // fp only, int division traps so it is left to the
+                       // caller
+    NVC_SIMD_LT = 4,
+    NVC_SIMD_LE = 5,
+    NVC_SIMD_GT = 6,
+    NVC_SIMD_GE = 7,
+} nvc_simd_op_t;
+
+// the level the kernels run at, detected on the first call
+nvc_simd_level_t nvc_simd_level(void);
+// caps the level from then on (e.g. to compare against the scalar kernels),
+// levels above what the cpu supports are ignored. returns the new level
+nvc_simd_level_t nvc_simd_limit(nvc_simd_level_t level);
+const char* nvc_simd_level_to_str(nvc_simd_level_t level);
+
+// dst[i] = a[i] op b[i] for add, sub, mul and div
+void nvc_simd_f64(nvc_simd_op_t op,
+                  double* dst,
+                  const double* a,
+                  const double* b,
+                  size_t n);
+// dst[i] = a[i] op b[i] for add, sub and mul, wrapping around on overflow
+void nvc_simd_i64(nvc_simd_op_t op,
+                  int64_t* dst,
+                  const int64_t* a,
+                  const int64_t* b,
+                  size_t n);
+// dst[i] = a[i] op b[i] for lt, le, gt and ge
+void nvc_simd_f64_compare(nvc_simd_op_t op,
+                          uint8_t* dst,
+                          const double* a,
+                          const double* b,
+                          size_t n);
+void nvc_simd_i64_compare(nvc_simd_op_t op,
+                          uint8_t* dst,
+                          const int64_t* a,
+                          const int64_t* b,
+                          size_t n);
+
+// length of the longest prefix of s[0..n) without a byte >= 0x80
+size_t nvc_simd_ascii_prefix(const char* s, size_t n);
+
+#endif  // NVC_SIMD_H
+
+#ifdef __cplusplus
+}
+#endif
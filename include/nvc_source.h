@@ -0,0 +1,62 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef NVC_SOURCE_H
+#define NVC_SOURCE_H
+
+#include <stddef.h>
+
+#include <nvc_alloc.h>
+
+// compressed input is read and decompressed this many bytes at a time, only
+// one such chunk of compressed data is held in memory
+#define NVC_SOURCE_CHUNK (64 * 1024)
+
+typedef enum {
+    NVC_SOURCE_PLAIN = 0,
+    NVC_SOURCE_GZIP = 1,  // .nv.gz, needs zlib
+    NVC_SOURCE_ZSTD = 2,  // .nv.zst, needs libzstd
+} nvc_source_format_t;
+
+typedef enum {
+    NVC_SOURCE_OK = 0,
+    NVC_SOURCE_UNREADABLE = 1,     // can not be opened or read
+    NVC_SOURCE_OUT_OF_MEMORY = 2,
+    NVC_SOURCE_CORRUPT = 3,        // damaged or cut off compressed data
+    NVC_SOURCE_UNSUPPORTED = 4,    // compressed in a format this build lacks
+} nvc_source_status_t;
+
+// detects the format from the first n bytes of a file (the magic bytes),
+// anything that is not compressed is a plain source
+nvc_source_format_t nvc_source_detect(const unsigned char* head, size_t n);
+const char* nvc_source_format_to_str(nvc_source_format_t format);
+const char* nvc_source_status_to_str(nvc_source_status_t status);
+
+// reads a whole source file into a null terminated buffer allocated with
+// allocator, compressed files are detected by their magic bytes and
+// decompressed while they are read. returns NULL (and sets *filesize to 0) if
+// the file can not be read, the reason is stored in *status (may be NULL)
+// note: *filesize is the size of the decompressed source
+char* nvc_read_source_file(nvc_allocator_t* allocator,
+                           const char* filename,
+                           long* filesize,
+                           nvc_source_status_t* status);
+
+// turns the raw contents of a source file, read by other means (see
+// nvc_reader.h), into a source like nvc_read_source_file does: raw is size
+// bytes allocated with allocator with room for one more. a plain source is
+// null terminated and returned in place, a compressed one is decompressed
+// into a new buffer and raw is freed. returns NULL (and sets *filesize to 0)
+// on failure with the reason in *status (may be NULL), raw is freed then too
+char* nvc_decode_source(nvc_allocator_t* allocator,
+                        char* raw,
+                        size_t size,
+                        long* filesize,
+                        nvc_source_status_t* status);
+
+#endif  // NVC_SOURCE_H
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,65 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef NVC_SYMTAB_H
+#define NVC_SYMTAB_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <nvc_alloc.h>
+
+#define NVC_SYMTAB_NONE UINT32_MAX
+
+typedef struct {
+    const char* key;  // NULL for an empty slot, not owned
+    uint32_t hash;
+    uint32_t value;  // NVC_SYMTAB_NONE when the key is not bound in any
+                     // visible scope
+} nvc_symtab_slot_t;
+
+typedef struct {
+    const char* key;
+    uint32_t hash;
+    uint32_t prev_value;
+} nvc_symtab_undo_t;
+
+// scoped symbol table: a single open addressing (linear probing) table maps
+// every symbol to its innermost visible binding. binding in a scope records
+// the binding it hides in an undo log so popping a scope only touches the
+// symbols that scope declared, pushing a scope is O(1)
+// note: a key keeps its slot once inserted (unbinding leaves the key with
+// NVC_SYMTAB_NONE) so no tombstones are needed
+typedef struct {
+    nvc_allocator_t* allocator;
+    nvc_symtab_slot_t* slots;
+    uint32_t capacity;  // always a power of two
+    uint32_t n_keys;
+    nvc_symtab_undo_t* undo;
+    uint32_t undo_size, undo_capacity;
+    uint32_t* scope_marks;  // undo_size at the time each scope was pushed
+    uint32_t depth, marks_capacity;
+} nvc_symtab_t;
+
+// note: expected_keys is a sizing hint and may be 0
+bool nvc_symtab_init(nvc_symtab_t* table,
+                     nvc_allocator_t* allocator,
+                     uint32_t expected_keys);
+void nvc_symtab_free(nvc_symtab_t* table);
+
+// returns the innermost visible binding of key or NVC_SYMTAB_NONE
+uint32_t nvc_symtab_lookup(const nvc_symtab_t* table, const char* key);
+
+// binds key to value in the current scope, hiding any outer binding until the
+// scope is popped. returns false when out of memory
+bool nvc_symtab_bind(nvc_symtab_t* table, const char* key, uint32_t value);
+
+bool nvc_symtab_push_scope(nvc_symtab_t* table);
+void nvc_symtab_pop_scope(nvc_symtab_t* table);
+
+#endif  // NVC_SYMTAB_H
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,43 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef NVC_UTF8_H
+#define NVC_UTF8_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// largest number of bytes one code point is encoded in
+#define NVC_UTF8_MAX_LEN 4
+
+// decodes the code point at s into *cp, returns its length in bytes or 0 if
+// s does not start with a valid sequence (stray continuation byte, overlong
+// encoding, surrogate, above U+10FFFF or cut off by end)
+size_t nvc_utf8_decode(const char* s, const char* end, uint32_t* cp);
+
+// writes the UTF-8 encoding of cp (at most NVC_UTF8_MAX_LEN bytes) to dst
+// and returns its length, 0 for surrogates and values above U+10FFFF
+size_t nvc_utf8_encode(uint32_t cp, char* dst);
+
+// returns the first byte of an invalid sequence in [begin, end) or end when
+// it is all valid. *ascii is cleared if a byte >= 0x80 is found before that
+// note: ASCII runs are skipped with nvc_simd_ascii_prefix, only the other
+// bytes are decoded
+const char* nvc_utf8_validate(const char* begin, const char* end, bool* ascii);
+
+// number of code points in [begin, end), which must be valid UTF-8
+uint32_t nvc_utf8_length(const char* begin, const char* end);
+
+// whether a non-ASCII code point may start or continue an identifier. this
+// follows XID_Start/XID_Continue for the letters, marks and digits of the
+// common scripts, not the full Unicode tables
+bool nvc_xid_start(uint32_t cp);
+bool nvc_xid_continue(uint32_t cp);
+
+#endif  // NVC_UTF8_H
+
+#ifdef __cplusplus
+}
+#endif
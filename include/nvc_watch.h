@@ -0,0 +1,37 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef NVC_WATCH_H
+#define NVC_WATCH_H
+
+#include <nvc_alloc.h>
+#include <nvc_compiler.h>
+
+// quiet period after the last change before recompiling, editors usually
+// write a file in several steps (truncate, write, rename...)
+#define NVC_WATCH_DEBOUNCE_MS 50
+
+// compiles every .nv file under paths (files or directories, searched
+// recursively) and then recompiles files as they change until interrupted.
+// every file is built with the modules it imports (see nvc_build). each file
+// keeps its buffer and build in memory so a change only recompiles the
+// files it touched and the watched files that import them, a save that did
+// not change the contents recompiles nothing and a new file recompiles the
+// files that did not find an import. the builds share a module cache: a
+// module that did not change keeps its tokens, tree and sema, and is only
+// resolved again when a module it imports changed. results are printed as
+// each file finishes
+// note: allocator may be NULL to use nvc_default_allocator, options may be
+// NULL for defaults. only supported on linux (inotify), elsewhere it reports
+// an error and returns non-zero. returns non-zero if watching failed
+int nvc_watch(nvc_allocator_t* allocator,
+              char** paths,
+              int n_paths,
+              const nvc_compile_options_t* options);
+
+#endif  // NVC_WATCH_H
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,60 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef NVC_X86_64_H
+#define NVC_X86_64_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <nvc_alloc.h>
+#include <nvc_elf.h>
+#include <nvc_ir.h>
+#include <nvc_output.h>
+#include <nvc_sema.h>
+
+// a module imported by the one being compiled: the sema its import
+// instructions point to and the name its object defines its symbols under
+typedef struct {
+    const nvc_sema_t* sema;
+    const char* name;
+} nvc_object_import_t;
+
+// generates x86-64 code (System V ABI) for module into obj, see nvc_rt.h
+// for the symbols it defines and uses. name is the module name, imports
+// lists every module it imports in import order, their initialisers run
+// before its own. every value lives in a stack slot of its function,
+// scalar fps and f32s are computed with SSE, fp, string and big int
+// constants go to .rodata and the exported values to .bss. ints are tagged
+// words (see nvc_rt.h), their arithmetic and comparisons are inline while
+// they stay small and call into the runtime otherwise, like int division
+// and power and the element-wise array operations. i32s and i64s are plain
+// words that wrap inline. only the functions the initialiser still calls
+// after inlining are compiled.
+// note: problems are reported to diags. returns false if anything was
+// reported or ran out of memory
+bool nvc_gen_x86_64(nvc_elf_object_t* obj,
+                    nvc_diagnostics_t* diags,
+                    nvc_ir_module_t* module,
+                    const char* name,
+                    const nvc_object_import_t* imports,
+                    uint32_t n_imports);
+
+// nvc_gen_x86_64 into a new object written to path
+// note: allocator may be NULL to use nvc_default_allocator. errors are
+// reported to diags, returns false if there were any
+bool nvc_write_object(nvc_allocator_t* allocator,
+                      nvc_diagnostics_t* diags,
+                      const char* path,
+                      nvc_ir_module_t* module,
+                      const char* name,
+                      const nvc_object_import_t* imports,
+                      uint32_t n_imports);
+
+#endif  // NVC_X86_64_H
+
+#ifdef __cplusplus
+}
+#endif
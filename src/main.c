@@ -2,15 +2,122 @@
 extern "C" {
 #endif
 
+#include <nvc_batch.h>
 #include <nvc_compiler.h>
+#include <nvc_fmt.h>
+#include <nvc_watch.h>
+
+#include <string.h>
+
+// nvc fmt [--check] [--cache <file>] <paths...>
+static int nvc_fmt_main(int argc, char** argv) {
+    nvc_fmt_options_t options = {0};
+    int n_paths = 0;
+    for (int i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "--check") == 0) {
+            options.check = true;
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            options.cache_path = argv[++i];
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            fprintf(stderr, "Unknown option: %s.\n", argv[i]);
+            return 1;
+        } else {
+            argv[2 + n_paths++] = argv[i];
+        }
+    }
+    if (n_paths == 0) {
+        fprintf(stderr,
+                "Invalid syntax. %s fmt [--check] [--cache <file>] "
+                "<paths...>\n",
+                argv[0]);
+        return 1;
+    }
+    return nvc_fmt(nvc_default_allocator(), argv + 2, n_paths, &options);
+}
 
 int main(int argc, char** argv) {
-    if (argc != 2) {
-        fprintf(stderr, "Invalid syntax. %s <filename>", argv[0]);
+    if (argc > 1 && strcmp(argv[1], "fmt") == 0)
+        return nvc_fmt_main(argc, argv);
+
+    nvc_compile_options_t options = {.opt_level = 1};
+    bool watch = false;
+    bool batch = false;
+    bool object = false;
+    // note: positional args are compacted to the front of argv
+    int n_paths = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--hash-cons") == 0) {
+            options.parse.hash_cons = true;
+        } else if (strcmp(argv[i], "--lazy-bodies") == 0) {
+            options.parse.lazy_bodies = true;
+        } else if (strcmp(argv[i], "--pipeline") == 0) {
+            options.parse.pipeline = true;
+        } else if (strcmp(argv[i], "--max-errors") == 0 && i + 1 < argc) {
+            options.max_errors = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if ((strcmp(argv[i], "-j") == 0 ||
+                    strcmp(argv[i], "--jobs") == 0) &&
+                   i + 1 < argc) {
+            options.n_jobs = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--parse-jobs") == 0 && i + 1 < argc) {
+            options.parse.n_jobs = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strncmp(argv[i], "-O", 2) == 0 && argv[i][2] != '\0') {
+            options.opt_level = (uint32_t)strtoul(argv[i] + 2, NULL, 10);
+        } else if (strcmp(argv[i], "--perf-counters") == 0) {
+            options.perf_counters = true;
+        } else if (strcmp(argv[i], "--reader") == 0 && i + 1 < argc) {
+            const char* name = argv[++i];
+            int reader = -1;
+            for (int b = NVC_READER_AUTO; b <= NVC_READER_SYNC; ++b) {
+                if (strcmp(name, nvc_reader_backend_to_str(b)) == 0)
+                    reader = b;
+            }
+            if (reader < 0) {
+                fprintf(stderr, "Unknown reader: %s.\n", name);
+                return 1;
+            }
+            options.reader = (nvc_reader_backend_t)reader;
+        } else if (strcmp(argv[i], "--watch") == 0) {
+            watch = true;
+        } else if (strcmp(argv[i], "-c") == 0) {
+            object = true;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            options.object_path = argv[++i];
+        } else if (strcmp(argv[i], "--batch") == 0) {
+            batch = true;
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            fprintf(stderr, "Unknown option: %s.\n", argv[i]);
+            return 1;
+        } else {
+            argv[1 + n_paths++] = argv[i];
+        }
+    }
+
+    if (batch ? watch || object || n_paths != 0
+              : n_paths == 0 || (!watch && n_paths != 1) ||
+                    (object && (watch || !options.object_path))) {
+        fprintf(stderr,
+                "Invalid syntax. %s [--hash-cons] [--lazy-bodies] [--pipeline] "
+                "[-O<level>] [--max-errors <n>] [-j <jobs>] "
+                "[--parse-jobs <n>] [--perf-counters] "
+                "[--reader <auto|io_uring|threads|sync>] <filename>\n"
+                "               %s [--hash-cons] [--pipeline] [-O<level>] "
+                "[--max-errors <n>] [-j <jobs>] -c -o <object> <filename>\n"
+                "               %s [--hash-cons] [--pipeline] [-O<level>] "
+                "[--max-errors <n>] --watch <paths...>\n"
+                "               %s [--hash-cons] [--pipeline] [-O<level>] "
+                "[--max-errors <n>] [-j <jobs>] [--perf-counters] --batch\n"
+                "               %s fmt [--check] [--cache <file>] "
+                "<paths...>\n",
+                argv[0], argv[0], argv[0], argv[0], argv[0]);
         return 1;
     }
 
-    return nvc_compile(argv[1]);
+    if (batch)
+        return nvc_batch(nvc_default_allocator(), stdin, stdout, &options);
+    if (watch)
+        return nvc_watch(nvc_default_allocator(), argv + 1, n_paths, &options);
+    return nvc_compile(nvc_default_allocator(), argv[1], &options);
 }
 
 #ifdef __cplusplus
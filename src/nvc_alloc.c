@@ -0,0 +1,264 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nvc_alloc.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+// note: every allocation that needs to remember its size (arena realloc,
+// counting) is prefixed with a header of this size so the user pointer keeps
+// the maximum fundamental alignment
+#define NVC_ALLOC_HEADER_SIZE (sizeof(max_align_t))
+#define NVC_ALLOC_ALIGN(n) \
+    (((n) + sizeof(max_align_t) - 1) & ~(sizeof(max_align_t) - 1))
+
+static void* nvc_libc_alloc(void* ctx, size_t size) {
+    (void)ctx;
+    return malloc(size);
+}
+
+static void* nvc_libc_realloc(void* ctx, void* ptr, size_t size) {
+    (void)ctx;
+    return realloc(ptr, size);
+}
+
+static void nvc_libc_free(void* ctx, void* ptr) {
+    (void)ctx;
+    free(ptr);
+}
+
+static nvc_allocator_t nvc_libc_allocator = {
+    .alloc = nvc_libc_alloc,
+    .realloc = nvc_libc_realloc,
+    .free = nvc_libc_free,
+    .ctx = NULL,
+};
+
+nvc_allocator_t* nvc_default_allocator(void) {
+    return &nvc_libc_allocator;
+}
+
+void* nvc_alloc(nvc_allocator_t* allocator, size_t size) {
+    if (!allocator) allocator = &nvc_libc_allocator;
+    // note: never hand out zero sized allocations, they are implementation
+    // defined in libc and would be ambiguous with out of memory
+    return allocator->alloc(allocator->ctx, size ? size : 1);
+}
+
+void* nvc_calloc(nvc_allocator_t* allocator, size_t n, size_t size) {
+    if (size && n > SIZE_MAX / size) return NULL;
+    void* ptr = nvc_alloc(allocator, n * size);
+    if (ptr) memset(ptr, 0, n * size);
+    return ptr;
+}
+
+void* nvc_realloc(nvc_allocator_t* allocator, void* ptr, size_t size) {
+    if (!allocator) allocator = &nvc_libc_allocator;
+    return allocator->realloc(allocator->ctx, ptr, size ? size : 1);
+}
+
+void nvc_free(nvc_allocator_t* allocator, void* ptr) {
+    if (!ptr) return;
+    if (!allocator) allocator = &nvc_libc_allocator;
+    allocator->free(allocator->ctx, ptr);
+}
+
+char* nvc_strndup(nvc_allocator_t* allocator, const char* str, size_t n) {
+    size_t len = strnlen(str, n);
+    char* cpy = nvc_alloc(allocator, len + 1);
+    if (!cpy) return NULL;
+    memcpy(cpy, str, len);
+    cpy[len] = '\0';
+    return cpy;
+}
+
+// ----- arena
+
+struct nvc_arena_block_s {
+    nvc_arena_block_t* prev;
+    size_t size;  // usable bytes in data
+    size_t used;
+    max_align_t data[];
+};
+
+static nvc_arena_block_t* nvc_arena_new_block(nvc_arena_t* arena,
+                                              size_t min_size) {
+    size_t size = arena->block_size;
+    if (size < min_size) size = min_size;
+    nvc_arena_block_t* block =
+        nvc_alloc(arena->backing, sizeof(nvc_arena_block_t) + size);
+    if (!block) return NULL;
+    block->prev = arena->head;
+    block->size = size;
+    block->used = 0;
+    arena->head = block;
+    return block;
+}
+
+static void* nvc_arena_alloc(void* ctx, size_t size) {
+    nvc_arena_t* arena = ctx;
+    size_t needed = NVC_ALLOC_HEADER_SIZE + NVC_ALLOC_ALIGN(size);
+    nvc_arena_block_t* block = arena->head;
+    if (!block || block->size - block->used < needed) {
+        block = nvc_arena_new_block(arena, needed);
+        if (!block) return NULL;
+    }
+    char* base = (char*)block->data + block->used;
+    *(size_t*)base = size;
+    block->used += needed;
+    arena->bytes_used += needed;
+    return base + NVC_ALLOC_HEADER_SIZE;
+}
+
+static void* nvc_arena_realloc(void* ctx, void* ptr, size_t size) {
+    nvc_arena_t* arena = ctx;
+    if (!ptr) return nvc_arena_alloc(ctx, size);
+    char* base = (char*)ptr - NVC_ALLOC_HEADER_SIZE;
+    size_t old_size = *(size_t*)base;
+    size_t old_needed = NVC_ALLOC_HEADER_SIZE + NVC_ALLOC_ALIGN(old_size);
+    size_t new_needed = NVC_ALLOC_HEADER_SIZE + NVC_ALLOC_ALIGN(size);
+    nvc_arena_block_t* block = arena->head;
+    // grow or shrink in place when ptr is the last allocation of the block
+    if (block && base + old_needed == (char*)block->data + block->used &&
+        block->used - old_needed + new_needed <= block->size) {
+        block->used = block->used - old_needed + new_needed;
+        arena->bytes_used = arena->bytes_used - old_needed + new_needed;
+        *(size_t*)base = size;
+        return ptr;
+    }
+    if (size <= old_size) {
+        *(size_t*)base = size;
+        return ptr;
+    }
+    void* new_ptr = nvc_arena_alloc(ctx, size);
+    if (!new_ptr) return NULL;
+    memcpy(new_ptr, ptr, old_size);
+    return new_ptr;
+}
+
+static void nvc_arena_free(void* ctx, void* ptr) {
+    // note: memory is only released on reset/destroy
+    (void)ctx;
+    (void)ptr;
+}
+
+void nvc_arena_init(nvc_arena_t* arena,
+                    nvc_allocator_t* backing,
+                    size_t block_size) {
+    arena->allocator.alloc = nvc_arena_alloc;
+    arena->allocator.realloc = nvc_arena_realloc;
+    arena->allocator.free = nvc_arena_free;
+    arena->allocator.ctx = arena;
+    arena->backing = backing ? backing : &nvc_libc_allocator;
+    arena->head = NULL;
+    arena->block_size = block_size ? block_size : 1 << 16;
+    arena->bytes_used = 0;
+}
+
+nvc_allocator_t* nvc_arena_allocator(nvc_arena_t* arena) {
+    return &arena->allocator;
+}
+
+void nvc_arena_reset(nvc_arena_t* arena) {
+    nvc_arena_block_t* block = arena->head;
+    if (!block) return;
+    // keep the newest block, release the rest
+    nvc_arena_block_t* prev = block->prev;
+    while (prev) {
+        nvc_arena_block_t* next = prev->prev;
+        nvc_free(arena->backing, prev);
+        prev = next;
+    }
+    block->prev = NULL;
+    block->used = 0;
+    arena->bytes_used = 0;
+}
+
+void nvc_arena_destroy(nvc_arena_t* arena) {
+    nvc_arena_block_t* block = arena->head;
+    while (block) {
+        nvc_arena_block_t* prev = block->prev;
+        nvc_free(arena->backing, block);
+        block = prev;
+    }
+    arena->head = NULL;
+    arena->bytes_used = 0;
+}
+
+// ----- counting
+
+static bool nvc_counting_should_fail(nvc_counting_allocator_t* counter) {
+    if (counter->fail_after &&
+        counter->n_allocs + counter->n_reallocs >= counter->fail_after) {
+        ++counter->n_failed;
+        return true;
+    }
+    return false;
+}
+
+static void* nvc_counting_alloc(void* ctx, size_t size) {
+    nvc_counting_allocator_t* counter = ctx;
+    if (nvc_counting_should_fail(counter)) return NULL;
+    char* base = nvc_alloc(counter->backing, NVC_ALLOC_HEADER_SIZE + size);
+    if (!base) {
+        ++counter->n_failed;
+        return NULL;
+    }
+    *(size_t*)base = size;
+    ++counter->n_allocs;
+    counter->bytes_allocated += size;
+    counter->bytes_live += size;
+    if (counter->bytes_live > counter->bytes_peak)
+        counter->bytes_peak = counter->bytes_live;
+    return base + NVC_ALLOC_HEADER_SIZE;
+}
+
+static void* nvc_counting_realloc(void* ctx, void* ptr, size_t size) {
+    nvc_counting_allocator_t* counter = ctx;
+    if (!ptr) return nvc_counting_alloc(ctx, size);
+    if (nvc_counting_should_fail(counter)) return NULL;
+    char* base = (char*)ptr - NVC_ALLOC_HEADER_SIZE;
+    size_t old_size = *(size_t*)base;
+    char* new_base =
+        nvc_realloc(counter->backing, base, NVC_ALLOC_HEADER_SIZE + size);
+    if (!new_base) {
+        ++counter->n_failed;
+        return NULL;
+    }
+    *(size_t*)new_base = size;
+    ++counter->n_reallocs;
+    if (size > old_size) counter->bytes_allocated += size - old_size;
+    counter->bytes_live = counter->bytes_live - old_size + size;
+    if (counter->bytes_live > counter->bytes_peak)
+        counter->bytes_peak = counter->bytes_live;
+    return new_base + NVC_ALLOC_HEADER_SIZE;
+}
+
+static void nvc_counting_free(void* ctx, void* ptr) {
+    nvc_counting_allocator_t* counter = ctx;
+    if (!ptr) return;
+    char* base = (char*)ptr - NVC_ALLOC_HEADER_SIZE;
+    ++counter->n_frees;
+    counter->bytes_live -= *(size_t*)base;
+    nvc_free(counter->backing, base);
+}
+
+void nvc_counting_allocator_init(nvc_counting_allocator_t* counter,
+                                 nvc_allocator_t* backing) {
+    memset(counter, 0, sizeof(nvc_counting_allocator_t));
+    counter->allocator.alloc = nvc_counting_alloc;
+    counter->allocator.realloc = nvc_counting_realloc;
+    counter->allocator.free = nvc_counting_free;
+    counter->allocator.ctx = counter;
+    counter->backing = backing ? backing : &nvc_libc_allocator;
+}
+
+nvc_allocator_t* nvc_counting_allocator(nvc_counting_allocator_t* counter) {
+    return &counter->allocator;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -4,113 +4,271 @@ extern "C" {
 
 #include <nvc_ast.h>
 
+#include <nvc_alloc.h>
+#include <nvc_hash.h>
 #include <nvc_output.h>
 
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-static void nvc_free_ptr_array(void** ptr_array, uint32_t len) {
+static void nvc_free_ptr_array(nvc_allocator_t* allocator,
+                               void** ptr_array,
+                               uint32_t len) {
     if (ptr_array) {
         for (uint32_t i = 0; i < len; ++i) {
-            free(ptr_array[i]);
+            nvc_free(allocator, ptr_array[i]);
         }
-        free(ptr_array);
+        nvc_free(allocator, ptr_array);
     }
 }
 
-static void nvc_free_nodes_recursive(nvc_ast_node_t* node) {
+static void nvc_free_nodes_recursive(nvc_allocator_t* allocator,
+                                     nvc_ast_node_t* node) {
     if (node) {
+        // hash consed nodes are only freed by their last owner
+        if (node->shared) {
+            --node->shared;
+            return;
+        }
         // TODO: dont forget to free anything added here
         switch (node->kind) {
             case NVC_AST_NODE_FUN_DECL:
-                nvc_free_ptr_array(node->fun_decl.body,
-                                   node->fun_decl.body_size);
-                nvc_free_ptr_array(node->fun_decl.params,
+                for (uint32_t i = 0; i < node->fun_decl.body_size; ++i) {
+                    nvc_free_nodes_recursive(allocator,
+                                             node->fun_decl.body[i]);
+                }
+                nvc_free(allocator, node->fun_decl.body);
+                nvc_free_ptr_array(allocator, (void**)node->fun_decl.params,
                                    node->fun_decl.n_params);
                 break;
             case NVC_AST_NODE_LET_DECL:
-                nvc_free_nodes_recursive(node->let_decl.rhs);
+                nvc_free_nodes_recursive(allocator, node->let_decl.rhs);
                 break;
             case NVC_AST_NODE_TYPE_DECL:
-                nvc_free_ptr_array(node->type_decl.members,
+                nvc_free_ptr_array(allocator, (void**)node->type_decl.members,
                                    node->type_decl.n_members);
                 break;
+            case NVC_AST_NODE_IMPORT_DECL:
+                nvc_free(allocator, node->import_decl.module);
+                break;
             case NVC_AST_NODE_OP_CHAIN:
                 for (uint32_t i = 0; i < node->op_chain.n_elems; ++i) {
                     nvc_ast_chain_elem_t* elem = node->op_chain.elems[i];
                     if (elem->kind == NVC_CHAIN_ELEM_NODE)
-                        nvc_free_nodes_recursive(elem->node);
+                        nvc_free_nodes_recursive(allocator, elem->node);
                 }
-                nvc_free_ptr_array(node->op_chain.elems,
+                nvc_free_ptr_array(allocator, (void**)node->op_chain.elems,
                                    node->op_chain.n_elems);
                 break;
+            case NVC_AST_NODE_ARRAY_LIT:
+                for (uint32_t i = 0; i < node->array_lit.n_elems; ++i) {
+                    nvc_free_nodes_recursive(allocator,
+                                             node->array_lit.elems[i]);
+                }
+                nvc_free(allocator, node->array_lit.elems);
+                break;
+            case NVC_AST_NODE_INDEX:
+                nvc_free_nodes_recursive(allocator, node->index.base);
+                nvc_free_nodes_recursive(allocator, node->index.index);
+                break;
+            case NVC_AST_NODE_CALL:
+                nvc_free_nodes_recursive(allocator, node->call.callee);
+                for (uint32_t i = 0; i < node->call.n_args; ++i) {
+                    nvc_free_nodes_recursive(allocator, node->call.args[i]);
+                }
+                nvc_free(allocator, node->call.args);
+                break;
+            case NVC_AST_NODE_FIELD:
+                nvc_free_nodes_recursive(allocator, node->field.base);
+                break;
+            case NVC_AST_NODE_FOR:
+            case NVC_AST_NODE_WHILE:
+                nvc_free_nodes_recursive(allocator, node->loop.start);
+                nvc_free_nodes_recursive(allocator, node->loop.end);
+                nvc_free_nodes_recursive(allocator, node->loop.cond);
+                nvc_free_nodes_recursive(allocator, node->loop.init);
+                nvc_free_nodes_recursive(allocator, node->loop.body);
+                break;
             default: break;
         }
 
-        free(node);
+        nvc_free(allocator, node);
     }
 }
 
-static void nvc_free_nodes(nvc_ast_node_t** nodes, size_t size) {
+static void nvc_free_nodes(nvc_allocator_t* allocator,
+                           nvc_ast_node_t** nodes,
+                           size_t size) {
     if (nodes) {
         for (size_t i = 0; i < size; ++i) {
-            nvc_free_nodes_recursive(nodes[i]);
+            nvc_free_nodes_recursive(allocator, nodes[i]);
         }
 
-        free(nodes);
+        nvc_free(allocator, nodes);
     }
 }
 
-static void nvc_print_ast_recursive(nvc_ast_node_t* node) {
+static void nvc_print_ast_recursive(FILE* out, nvc_ast_node_t* node) {
     switch (node->kind) {
         case NVC_AST_NODE_LET_DECL:
-            fprintf(stdout, "let(%s, ", node->let_decl.symbol);
-            nvc_print_ast_recursive(node->let_decl.rhs);
-            fputc(')', stdout);
+            fprintf(out, "let(%s, ", node->let_decl.symbol);
+            nvc_print_ast_recursive(out, node->let_decl.rhs);
+            fputc(')', out);
             break;
         case NVC_AST_NODE_FUN_DECL:
-            fprintf(stdout, "fun %s(", node->fun_decl.fun_name);
+            fprintf(out, "fun %s(", node->fun_decl.fun_name);
             for (uint32_t i = 0; i < node->fun_decl.n_params; ++i) {
-                fprintf(stdout, "%s: %s,", node->fun_decl.params[i]->param_name,
+                fprintf(out, "%s: %s,", node->fun_decl.params[i]->param_name,
                         node->fun_decl.params[i]->type_name);
             }
-            fprintf(stdout, ") -> %s(", node->fun_decl.return_type_name);
+            fputc(')', out);
+            if (node->fun_decl.return_type_name)
+                fprintf(out, " -> %s", node->fun_decl.return_type_name);
+            fputc('(', out);
+            // note: a lazy body is only shown by its size until it is parsed
+            if (node->fun_decl.body_tokens)
+                fprintf(out, "<%u tokens>", node->fun_decl.n_body_tokens - 1);
             // TODO: print body pretty
             for (size_t i = 0; i < node->fun_decl.body_size; ++i) {
-                nvc_print_ast_recursive(node->fun_decl.body[i]);
+                if (i) fputs(", ", out);
+                nvc_print_ast_recursive(out, node->fun_decl.body[i]);
             }
-            fputc(')', stdout);
+            fputc(')', out);
             break;
         case NVC_AST_NODE_TYPE_DECL:
-            fprintf(stdout, "type %s(", node->type_decl.type_name);
-            // TODO: print type nodes
+            fprintf(out, "type %s%s(",
+                    node->type_decl.fixed_layout ? "[fixed] " : "",
+                    node->type_decl.type_name);
             for (uint32_t i = 0; i < node->type_decl.n_members; ++i) {
+                nvc_type_member_decl_t* member = node->type_decl.members[i];
+                fprintf(out, "%s: %s", member->member_name, member->type_name);
+                if (member->length) fprintf(out, "[%u]", member->length);
+                fputc(',', out);
             }
+            fputc(')', out);
+            break;
+        case NVC_AST_NODE_IMPORT_DECL:
+            fprintf(out, "import(%s)", node->import_decl.module);
             break;
         case NVC_AST_NODE_STRING_LIT:
-            fprintf(stdout, "'%s'", node->str_lit);
+            fprintf(out, "'%s'", node->str_lit);
+            break;
+        case NVC_AST_NODE_ARRAY_LIT:
+            fputc('[', out);
+            for (uint32_t i = 0; i < node->array_lit.n_elems; ++i) {
+                if (i) fputs(", ", out);
+                nvc_print_ast_recursive(out, node->array_lit.elems[i]);
+            }
+            fputc(']', out);
+            break;
+        case NVC_AST_NODE_INDEX:
+            nvc_print_ast_recursive(out, node->index.base);
+            fputc('[', out);
+            nvc_print_ast_recursive(out, node->index.index);
+            fputc(']', out);
+            break;
+        case NVC_AST_NODE_CALL:
+            nvc_print_ast_recursive(out, node->call.callee);
+            fputc('(', out);
+            for (uint32_t i = 0; i < node->call.n_args; ++i) {
+                if (i) fputs(", ", out);
+                nvc_print_ast_recursive(out, node->call.args[i]);
+            }
+            fputc(')', out);
+            break;
+        case NVC_AST_NODE_FIELD:
+            nvc_print_ast_recursive(out, node->field.base);
+            fprintf(out, ".%s", node->field.field);
+            break;
+        case NVC_AST_NODE_FOR:
+            fprintf(out, "for(%s in ", node->loop.counter);
+            nvc_print_ast_recursive(out, node->loop.start);
+            fputs(" to ", out);
+            nvc_print_ast_recursive(out, node->loop.end);
+            fprintf(out, ", %s = ", node->loop.acc);
+            nvc_print_ast_recursive(out, node->loop.init);
+            fputs(", ", out);
+            nvc_print_ast_recursive(out, node->loop.body);
+            fputc(')', out);
+            break;
+        case NVC_AST_NODE_WHILE:
+            fputs("while(", out);
+            nvc_print_ast_recursive(out, node->loop.cond);
+            fprintf(out, ", %s = ", node->loop.acc);
+            nvc_print_ast_recursive(out, node->loop.init);
+            fputs(", ", out);
+            nvc_print_ast_recursive(out, node->loop.body);
+            fputc(')', out);
             break;
         case NVC_AST_NODE_OP_CHAIN:
-            // TODO: print op chains
+            fputc('(', out);
+            for (uint32_t i = 0; i < node->op_chain.n_elems; ++i) {
+                nvc_ast_chain_elem_t* elem = node->op_chain.elems[i];
+                switch (elem->kind) {
+                    case NVC_CHAIN_ELEM_UNARY_OP:
+                        // note: the indices match nvc_operator_kind_t
+                        fputs(nvc_op_to_str(
+                                  (nvc_operator_kind_t)elem->unary_op_kind),
+                              out);
+                        break;
+                    case NVC_CHAIN_ELEM_BINARY_OP:
+                        fprintf(out, " %s ",
+                                nvc_op_to_str(
+                                    (nvc_operator_kind_t)elem->binary_op_kind));
+                        break;
+                    case NVC_CHAIN_ELEM_NODE:
+                        nvc_print_ast_recursive(out, elem->node);
+                        break;
+                }
+            }
+            fputc(')', out);
+            break;
+        case NVC_AST_NODE_SYMBOL_REF:
+            if (node->symbol_ref.decl == NVC_DECL_UNRESOLVED)
+                fprintf(out, "ref(%s)", node->symbol_ref.symbol);
+            else
+                fprintf(out, "ref(%s#%u)", node->symbol_ref.symbol,
+                        node->symbol_ref.decl);
             break;
-        case NVC_AST_NODE_INT_LIT: fprintf(stdout, "%ld", node->i); break;
-        case NVC_AST_NODE_FP_LIT: fprintf(stdout, "%.2Lf", node->fp); break;
+        case NVC_AST_NODE_INT_LIT:
+            fprintf(out, "%ld%s", node->i, nvc_width_to_str(node->width));
+            break;
+        case NVC_AST_NODE_FP_LIT:
+            fprintf(out, "%.2f%s", node->fp, nvc_width_to_str(node->width));
+            break;
+        case NVC_AST_NODE_BIG_LIT: {
+            char* str = nvc_alloc(NULL, nvc_bigint_str_size(node->big));
+            if (str) nvc_bigint_to_str(node->big, str);
+            fputs(str ? str : "<int>", out);
+            nvc_free(NULL, str);
+            break;
+        }
     }
 }
 
-void nvc_print_ast(nvc_ast_t* ast) {
+void nvc_print_ast(FILE* out, nvc_ast_t* ast) {
     for (size_t i = 0; i < ast->size; ++i) {
-        nvc_print_ast_recursive(ast->nodes[i]);
-        fputc('\n', stdout);
+        nvc_print_ast_recursive(out, ast->nodes[i]);
+        fputc('\n', out);
     }
 }
 
 void nvc_free_ast(nvc_ast_t* ast) {
     if (ast) {
-        nvc_free_nodes(ast->nodes, ast->size);
-        free(ast);
+        nvc_allocator_t* allocator = ast->allocator;
+        if (ast->arenas) {
+            // note: no need to walk the nodes, they all live in the arenas
+            for (uint32_t i = 0; i < ast->n_arenas; ++i)
+                nvc_arena_destroy(ast->arenas + i);
+            nvc_free(allocator, ast->arenas);
+            nvc_free(allocator, ast->nodes);
+        } else {
+            nvc_free_nodes(allocator, ast->nodes, ast->size);
+        }
+        nvc_free(allocator, ast);
     }
 }
 
@@ -138,120 +296,1173 @@ static nvc_unary_op_kind_t nvc_map_unary_op(nvc_operator_kind_t op) {
     }
 }
 
-// note: this is just SHIT
-static bool nvc_chainable_tokens(nvc_tok_t* lhs, nvc_tok_t* rhs) {
-    // TODO: this is hardcoded asf :sadge: this will make it difficult to have
-    // operator overloads in future
+bool nvc_is_keyword(const char* symbol) {
+    // TODO: maybe use strncmp but this should always be null terminated
+    return strncmp(symbol, "let\0", 4) == 0 ||
+           strncmp(symbol, "fun\0", 4) == 0 ||
+           strncmp(symbol, "type\0", 5) == 0 ||
+           strncmp(symbol, "import\0", 7) == 0 ||
+           strncmp(symbol, "for\0", 4) == 0 ||
+           strncmp(symbol, "while\0", 6) == 0;
+}
+
+// note: open addressing set of hash consed nodes, only alive during a parse
+typedef struct {
+    nvc_ast_node_t** slots;
+    uint64_t* hashes;
+    uint32_t capacity;  // always a power of two
+    uint32_t size;
+} nvc_hash_cons_table_t;
+
+// note: state shared by every recursive call of a single nvc_parse
+typedef struct {
+    nvc_allocator_t* allocator;
+    nvc_diagnostics_t* diags;
+    nvc_parse_options_t options;
+    nvc_hash_cons_table_t hash_cons;
+    uint32_t n_shared;   // amount of nodes replaced by an existing one
+    uint32_t n_imports;  // amount of import decls parsed so far
+} nvc_parser_t;
+
+static uint64_t nvc_hash_node(nvc_ast_node_t* node) {
+    uint64_t hash = nvc_hash_combine(NVC_HASH_SEED, node->kind);
+    switch (node->kind) {
+        case NVC_AST_NODE_INT_LIT:
+            hash = nvc_hash_combine(hash, node->width);
+            return nvc_hash_combine(hash, (uint64_t)node->i);
+        case NVC_AST_NODE_BIG_LIT:
+            return nvc_hash_bytes(node->big->limbs,
+                                  node->big->n_limbs * sizeof(uint64_t), hash);
+        case NVC_AST_NODE_FP_LIT: {
+            uint64_t bits;
+            memcpy(&bits, &node->fp, sizeof(uint64_t));
+            hash = nvc_hash_combine(hash, node->width);
+            return nvc_hash_combine(hash, bits);
+        }
+        case NVC_AST_NODE_STRING_LIT:
+            return node->str_lit ? nvc_hash_combine(
+                                       hash, nvc_hash_str(node->str_lit))
+                                 : hash;
+        case NVC_AST_NODE_OP_CHAIN:
+            for (uint32_t i = 0; i < node->op_chain.n_elems; ++i) {
+                nvc_ast_chain_elem_t* elem = node->op_chain.elems[i];
+                hash = nvc_hash_combine(hash, elem->kind);
+                switch (elem->kind) {
+                    case NVC_CHAIN_ELEM_UNARY_OP:
+                        hash = nvc_hash_combine(hash, elem->unary_op_kind);
+                        break;
+                    case NVC_CHAIN_ELEM_BINARY_OP:
+                        hash = nvc_hash_combine(hash, elem->binary_op_kind);
+                        break;
+                    case NVC_CHAIN_ELEM_NODE:
+                        // note: children are hash consed already so their
+                        // identity is their structure
+                        hash = nvc_hash_combine(hash, (uintptr_t)elem->node);
+                        break;
+                }
+            }
+            return hash;
+        case NVC_AST_NODE_ARRAY_LIT:
+            for (uint32_t i = 0; i < node->array_lit.n_elems; ++i) {
+                hash = nvc_hash_combine(hash,
+                                        (uintptr_t)node->array_lit.elems[i]);
+            }
+            return nvc_hash_combine(hash, node->array_lit.n_elems);
+        case NVC_AST_NODE_INDEX:
+            hash = nvc_hash_combine(hash, (uintptr_t)node->index.base);
+            return nvc_hash_combine(hash, (uintptr_t)node->index.index);
+        default: return hash;
+    }
+}
+
+static bool nvc_nodes_equal(nvc_ast_node_t* lhs, nvc_ast_node_t* rhs) {
+    if (lhs->kind != rhs->kind) return false;
     switch (lhs->kind) {
-        case NVC_TOK_SYMBOL:
-        case NVC_TOK_FP_LIT:
+        case NVC_AST_NODE_INT_LIT:
+            return lhs->i == rhs->i && lhs->width == rhs->width;
+        case NVC_AST_NODE_BIG_LIT:
+            return nvc_bigint_compare(lhs->big, rhs->big) == 0;
+        case NVC_AST_NODE_FP_LIT:
+            return lhs->fp == rhs->fp && lhs->width == rhs->width;
+        case NVC_AST_NODE_STRING_LIT:
+            if (!lhs->str_lit || !rhs->str_lit)
+                return lhs->str_lit == rhs->str_lit;
+            return strcmp(lhs->str_lit, rhs->str_lit) == 0;
+        case NVC_AST_NODE_OP_CHAIN:
+            if (lhs->op_chain.n_elems != rhs->op_chain.n_elems) return false;
+            for (uint32_t i = 0; i < lhs->op_chain.n_elems; ++i) {
+                nvc_ast_chain_elem_t* l = lhs->op_chain.elems[i];
+                nvc_ast_chain_elem_t* r = rhs->op_chain.elems[i];
+                if (l->kind != r->kind) return false;
+                switch (l->kind) {
+                    case NVC_CHAIN_ELEM_UNARY_OP:
+                        if (l->unary_op_kind != r->unary_op_kind) return false;
+                        break;
+                    case NVC_CHAIN_ELEM_BINARY_OP:
+                        if (l->binary_op_kind != r->binary_op_kind)
+                            return false;
+                        break;
+                    case NVC_CHAIN_ELEM_NODE:
+                        if (l->node != r->node) return false;
+                        break;
+                }
+            }
+            return true;
+        case NVC_AST_NODE_ARRAY_LIT:
+            if (lhs->array_lit.n_elems != rhs->array_lit.n_elems) return false;
+            for (uint32_t i = 0; i < lhs->array_lit.n_elems; ++i) {
+                if (lhs->array_lit.elems[i] != rhs->array_lit.elems[i])
+                    return false;
+            }
+            return true;
+        case NVC_AST_NODE_INDEX:
+            return lhs->index.base == rhs->index.base &&
+                   lhs->index.index == rhs->index.index;
+        default: return false;
+    }
+}
+
+// note: literals are immutable and op chains, array literals and indexing
+// over interned nodes only are pure, anything containing a symbol reference
+// is left alone because name resolution writes into it
+static bool nvc_is_hash_consable(nvc_ast_node_t* node) {
+    switch (node->kind) {
+        case NVC_AST_NODE_INT_LIT:
+        case NVC_AST_NODE_FP_LIT:
+        case NVC_AST_NODE_BIG_LIT:
+        case NVC_AST_NODE_STRING_LIT: return true;
+        case NVC_AST_NODE_OP_CHAIN:
+            for (uint32_t i = 0; i < node->op_chain.n_elems; ++i) {
+                nvc_ast_chain_elem_t* elem = node->op_chain.elems[i];
+                if (elem->kind == NVC_CHAIN_ELEM_NODE && !elem->node->interned)
+                    return false;
+            }
+            return true;
+        case NVC_AST_NODE_ARRAY_LIT:
+            for (uint32_t i = 0; i < node->array_lit.n_elems; ++i) {
+                if (!node->array_lit.elems[i]->interned) return false;
+            }
+            return true;
+        case NVC_AST_NODE_INDEX:
+            return node->index.base->interned && node->index.index->interned;
+        default: return false;
+    }
+}
+
+static bool nvc_hash_cons_grow(nvc_parser_t* parser) {
+    nvc_hash_cons_table_t* table = &parser->hash_cons;
+    uint32_t capacity = table->capacity ? table->capacity * 2 : 64;
+    nvc_ast_node_t** slots =
+        nvc_calloc(parser->allocator, capacity, sizeof(nvc_ast_node_t*));
+    uint64_t* hashes =
+        nvc_alloc(parser->allocator, capacity * sizeof(uint64_t));
+    if (!slots || !hashes) {
+        nvc_free(parser->allocator, slots);
+        nvc_free(parser->allocator, hashes);
+        return false;
+    }
+    for (uint32_t i = 0; i < table->capacity; ++i) {
+        if (!table->slots[i]) continue;
+        uint32_t j = table->hashes[i] & (capacity - 1);
+        while (slots[j]) j = (j + 1) & (capacity - 1);
+        slots[j] = table->slots[i];
+        hashes[j] = table->hashes[i];
+    }
+    nvc_free(parser->allocator, table->slots);
+    nvc_free(parser->allocator, table->hashes);
+    table->slots = slots;
+    table->hashes = hashes;
+    table->capacity = capacity;
+    return true;
+}
+
+// returns the canonical node structurally equal to node, node itself is
+// freed when an existing one is returned
+// note: a shared node keeps the location of its first occurrence, the
+// lowering reports problems with it at the node that uses it instead
+static nvc_ast_node_t* nvc_hash_cons(nvc_parser_t* parser,
+                                     nvc_ast_node_t* node) {
+    if (!parser->options.hash_cons || !nvc_is_hash_consable(node)) return node;
+    nvc_hash_cons_table_t* table = &parser->hash_cons;
+    // keep the load factor at or below 1/2
+    if ((table->size + 1) * 2 > table->capacity && !nvc_hash_cons_grow(parser))
+        // note: out of memory here only costs sharing, not correctness
+        return node;
+
+    uint64_t hash = nvc_hash_node(node);
+    uint32_t mask = table->capacity - 1;
+    uint32_t i = hash & mask;
+    for (; table->slots[i]; i = (i + 1) & mask) {
+        if (table->hashes[i] == hash &&
+            nvc_nodes_equal(table->slots[i], node)) {
+            nvc_ast_node_t* existing = table->slots[i];
+            nvc_free_nodes_recursive(parser->allocator, node);
+            ++existing->shared;
+            ++parser->n_shared;
+            return existing;
+        }
+    }
+    table->slots[i] = node;
+    table->hashes[i] = hash;
+    ++table->size;
+    node->interned = true;
+    return node;
+}
+
+static nvc_ast_node_t* nvc_parse_recursive(nvc_parser_t* parser,
+                                           nvc_token_stream_t stream,
+                                           uint32_t* eaten,
+                                           int depth);
+
+static nvc_ast_node_t* nvc_parse_expr(nvc_parser_t* parser,
+                                      nvc_token_stream_t stream,
+                                      uint32_t* eaten,
+                                      int depth);
+
+static nvc_ast_node_t* nvc_new_node(nvc_parser_t* parser,
+                                    nvc_ast_node_kind_t kind,
+                                    nvc_tok_t* token) {
+    nvc_ast_node_t* node =
+        nvc_calloc(parser->allocator, 1, sizeof(nvc_ast_node_t));
+    if (!node) {
+        nvc_report(parser->diags, NVC_SEVERITY_ERROR, &token->buf_loc,
+                   "out of memory");
+        return NULL;
+    }
+    node->kind = kind;
+    node->buf_loc = token->buf_loc;
+    return node;
+}
+
+// note: growable array of chain elements used while scanning an op chain
+typedef struct {
+    nvc_ast_chain_elem_t** elems;
+    uint32_t n_elems, capacity;
+} nvc_chain_builder_t;
+
+static void nvc_free_chain_builder(nvc_allocator_t* allocator,
+                                   nvc_chain_builder_t* builder) {
+    for (uint32_t i = 0; i < builder->n_elems; ++i) {
+        nvc_ast_chain_elem_t* elem = builder->elems[i];
+        if (elem->kind == NVC_CHAIN_ELEM_NODE)
+            nvc_free_nodes_recursive(allocator, elem->node);
+    }
+    nvc_free_ptr_array(allocator, (void**)builder->elems, builder->n_elems);
+}
+
+static nvc_ast_chain_elem_t* nvc_push_chain_elem(nvc_parser_t* parser,
+                                                 nvc_chain_builder_t* builder,
+                                                 nvc_chain_elem_kind_t kind) {
+    // dynamic allocation
+    if (builder->n_elems >= builder->capacity) {
+        uint32_t capacity = builder->capacity ? builder->capacity * 2 : 4;
+        nvc_ast_chain_elem_t** grown =
+            nvc_realloc(parser->allocator, builder->elems,
+                        capacity * sizeof(nvc_ast_chain_elem_t*));
+        if (!grown) goto out_of_memory;
+        builder->elems = grown;
+        builder->capacity = capacity;
+    }
+    nvc_ast_chain_elem_t* elem =
+        nvc_calloc(parser->allocator, 1, sizeof(nvc_ast_chain_elem_t));
+    if (!elem) goto out_of_memory;
+    elem->kind = kind;
+    builder->elems[builder->n_elems++] = elem;
+    return elem;
+out_of_memory:
+    nvc_report(parser->diags, NVC_SEVERITY_ERROR, NULL, "out of memory");
+    return NULL;
+}
+
+// reports an error unless the token at pos is the operator op
+static bool nvc_expect_op(nvc_parser_t* parser,
+                          nvc_token_stream_t stream,
+                          uint32_t pos,
+                          nvc_operator_kind_t op) {
+    if (pos < stream.size && stream.tokens[pos].kind == NVC_TOK_OP &&
+        stream.tokens[pos].op_kind == op)
+        return true;
+    nvc_tok_t* at = stream.tokens + (pos < stream.size ? pos : stream.size - 1);
+    nvc_report(parser->diags, NVC_SEVERITY_ERROR, &at->buf_loc,
+               pos < stream.size ? "unexpected token"
+                                 : "unexpected end of input");
+    nvc_report(parser->diags, NVC_SEVERITY_NOTE, NULL, "expected op(%s)",
+               nvc_op_to_str(op));
+    return false;
+}
+
+// reports an error unless the token at pos is a symbol that is not a keyword
+static bool nvc_expect_name(nvc_parser_t* parser,
+                            nvc_token_stream_t stream,
+                            uint32_t pos,
+                            const char* what) {
+    if (pos < stream.size && stream.tokens[pos].kind == NVC_TOK_SYMBOL &&
+        !nvc_is_keyword(stream.tokens[pos].symbol))
+        return true;
+    nvc_tok_t* at = stream.tokens + (pos < stream.size ? pos : stream.size - 1);
+    nvc_report(parser->diags, NVC_SEVERITY_ERROR, &at->buf_loc,
+               pos < stream.size ? "unexpected token"
+                                 : "unexpected end of input");
+    nvc_report(parser->diags, NVC_SEVERITY_NOTE, NULL, "expected symbol(<%s>)",
+               what);
+    return false;
+}
+
+static bool nvc_at_op(nvc_token_stream_t stream,
+                      uint32_t pos,
+                      nvc_operator_kind_t op) {
+    return pos < stream.size && stream.tokens[pos].kind == NVC_TOK_OP &&
+           stream.tokens[pos].op_kind == op;
+}
+
+// parses the expression starting at *pos up to the operator closing it
+static nvc_ast_node_t* nvc_parse_enclosed(nvc_parser_t* parser,
+                                          nvc_token_stream_t stream,
+                                          uint32_t* pos,
+                                          nvc_operator_kind_t close,
+                                          int depth) {
+    if (*pos >= stream.size) {
+        nvc_expect_op(parser, stream, *pos, close);
+        return NULL;
+    }
+    nvc_token_stream_t inner = {
+        .tokens = stream.tokens + *pos,
+        .size = stream.size - *pos,
+    };
+    uint32_t eaten = 0;
+    nvc_ast_node_t* node = nvc_parse_expr(parser, inner, &eaten, depth + 1);
+    *pos += eaten;
+    return node;
+}
+
+// [expr (',' expr)* [',']] close starting at *pos, the expressions are
+// appended to *elems. on failure the expressions parsed so far stay in
+// *elems for the caller to free
+static bool nvc_parse_list(nvc_parser_t* parser,
+                           nvc_token_stream_t stream,
+                           uint32_t* pos,
+                           nvc_operator_kind_t close,
+                           nvc_ast_node_t*** elems,
+                           uint32_t* n_elems,
+                           int depth) {
+    uint32_t capacity = 0;
+    while (!nvc_at_op(stream, *pos, close)) {
+        nvc_ast_node_t* elem =
+            nvc_parse_enclosed(parser, stream, pos, close, depth);
+        if (!elem) return false;
+        // dynamic allocation
+        if (*n_elems >= capacity) {
+            capacity = capacity ? capacity * 2 : 4;
+            nvc_ast_node_t** grown = nvc_realloc(
+                parser->allocator, *elems, capacity * sizeof(nvc_ast_node_t*));
+            if (!grown) {
+                nvc_report(parser->diags, NVC_SEVERITY_ERROR, &elem->buf_loc,
+                           "out of memory");
+                nvc_free_nodes_recursive(parser->allocator, elem);
+                return false;
+            }
+            *elems = grown;
+        }
+        (*elems)[(*n_elems)++] = elem;
+        if (!nvc_at_op(stream, *pos, NVC_OP_COMMA)) break;
+        ++*pos;
+    }
+    if (!nvc_expect_op(parser, stream, *pos, close)) return false;
+    ++*pos;
+    // shrink elems to save memory
+    // note: a failed shrink is harmless, keep the original buffer
+    if (*n_elems) {
+        nvc_ast_node_t** shrunk = nvc_realloc(
+            parser->allocator, *elems, *n_elems * sizeof(nvc_ast_node_t*));
+        if (shrunk) *elems = shrunk;
+    }
+    return true;
+}
+
+// '[' [expr (',' expr)* [',']] ']' starting at *pos
+static nvc_ast_node_t* nvc_parse_array(nvc_parser_t* parser,
+                                       nvc_token_stream_t stream,
+                                       uint32_t* pos,
+                                       int depth) {
+    nvc_ast_node_t* node =
+        nvc_new_node(parser, NVC_AST_NODE_ARRAY_LIT, stream.tokens + *pos);
+    if (!node) return NULL;
+    ++*pos;
+    if (!nvc_parse_list(parser, stream, pos, NVC_OP_RBRACKET,
+                        &node->array_lit.elems, &node->array_lit.n_elems,
+                        depth)) {
+        nvc_free_nodes_recursive(parser->allocator, node);
+        return NULL;
+    }
+    return nvc_hash_cons(parser, node);
+}
+
+// base '[' expr ']' with the '[' at *pos, base is freed on failure
+static nvc_ast_node_t* nvc_parse_index(nvc_parser_t* parser,
+                                       nvc_token_stream_t stream,
+                                       uint32_t* pos,
+                                       nvc_ast_node_t* base,
+                                       int depth) {
+    nvc_tok_t* open = stream.tokens + *pos;
+    ++*pos;
+    nvc_ast_node_t* index =
+        nvc_parse_enclosed(parser, stream, pos, NVC_OP_RBRACKET, depth);
+    if (!index) goto error;
+    if (!nvc_expect_op(parser, stream, *pos, NVC_OP_RBRACKET)) goto error;
+    ++*pos;
+    nvc_ast_node_t* node = nvc_new_node(parser, NVC_AST_NODE_INDEX, open);
+    if (!node) goto error;
+    node->index.base = base;
+    node->index.index = index;
+    return nvc_hash_cons(parser, node);
+error:
+    nvc_free_nodes_recursive(parser->allocator, base);
+    nvc_free_nodes_recursive(parser->allocator, index);
+    return NULL;
+}
+
+// callee '(' [expr (',' expr)* [',']] ')' with the '(' at *pos, callee is
+// freed on failure
+static nvc_ast_node_t* nvc_parse_call(nvc_parser_t* parser,
+                                      nvc_token_stream_t stream,
+                                      uint32_t* pos,
+                                      nvc_ast_node_t* callee,
+                                      int depth) {
+    nvc_ast_node_t* node =
+        nvc_new_node(parser, NVC_AST_NODE_CALL, stream.tokens + *pos);
+    if (!node) {
+        nvc_free_nodes_recursive(parser->allocator, callee);
+        return NULL;
+    }
+    node->call.callee = callee;
+    ++*pos;
+    if (!nvc_parse_list(parser, stream, pos, NVC_OP_RPAREN, &node->call.args,
+                        &node->call.n_args, depth)) {
+        nvc_free_nodes_recursive(parser->allocator, node);
+        return NULL;
+    }
+    return node;
+}
+
+// base '.' <field> with the '.' at *pos, base is freed on failure
+static nvc_ast_node_t* nvc_parse_field(nvc_parser_t* parser,
+                                       nvc_token_stream_t stream,
+                                       uint32_t* pos,
+                                       nvc_ast_node_t* base) {
+    if (!nvc_expect_name(parser, stream, *pos + 1, "field_name")) {
+        nvc_free_nodes_recursive(parser->allocator, base);
+        return NULL;
+    }
+    nvc_ast_node_t* node =
+        nvc_new_node(parser, NVC_AST_NODE_FIELD, stream.tokens + *pos + 1);
+    if (!node) {
+        nvc_free_nodes_recursive(parser->allocator, base);
+        return NULL;
+    }
+    node->field.base = base;
+    node->field.field = stream.tokens[*pos + 1].symbol;
+    *pos += 2;
+    return node;
+}
+
+// reports an error unless the token at pos is the symbol word, for the words
+// that are only meaningful at one place (e.g. the in of a for loop)
+static bool nvc_expect_word(nvc_parser_t* parser,
+                            nvc_token_stream_t stream,
+                            uint32_t pos,
+                            const char* word) {
+    if (pos < stream.size && stream.tokens[pos].kind == NVC_TOK_SYMBOL &&
+        strcmp(stream.tokens[pos].symbol, word) == 0)
+        return true;
+    nvc_tok_t* at = stream.tokens + (pos < stream.size ? pos : stream.size - 1);
+    nvc_report(parser->diags, NVC_SEVERITY_ERROR, &at->buf_loc,
+               pos < stream.size ? "unexpected token"
+                                 : "unexpected end of input");
+    nvc_report(parser->diags, NVC_SEVERITY_NOTE, NULL, "expected symbol(%s)",
+               word);
+    return false;
+}
+
+// parses the expression of a loop clause starting at *pos, it ends at the
+// first token that can not continue it (the next word of the loop)
+static nvc_ast_node_t* nvc_parse_clause(nvc_parser_t* parser,
+                                        nvc_token_stream_t stream,
+                                        uint32_t* pos,
+                                        int depth) {
+    if (*pos >= stream.size) {
+        nvc_report(parser->diags, NVC_SEVERITY_ERROR,
+                   &stream.tokens[stream.size - 1].buf_loc,
+                   "unexpected end of input");
+        nvc_report(parser->diags, NVC_SEVERITY_NOTE, NULL, "expected operand");
+        return NULL;
+    }
+    nvc_token_stream_t inner = {
+        .tokens = stream.tokens + *pos,
+        .size = stream.size - *pos,
+    };
+    uint32_t eaten = 0;
+    nvc_ast_node_t* node = nvc_parse_expr(parser, inner, &eaten, depth + 1);
+    *pos += eaten;
+    return node;
+}
+
+// for <counter> in <expr> to <expr> with <acc> = <expr> do '(' expr ')' or
+// while <expr> with <acc> = <expr> do '(' expr ')' with the keyword at *pos
+static nvc_ast_node_t* nvc_parse_loop(nvc_parser_t* parser,
+                                      nvc_token_stream_t stream,
+                                      uint32_t* pos,
+                                      int depth) {
+    nvc_tok_t* keyword = stream.tokens + *pos;
+    bool is_for = strncmp(keyword->symbol, "for\0", 4) == 0;
+    nvc_ast_node_t* node = nvc_new_node(
+        parser, is_for ? NVC_AST_NODE_FOR : NVC_AST_NODE_WHILE, keyword);
+    if (!node) return NULL;
+    nvc_ast_loop_t* loop = &node->loop;
+    loop->counter_decl = NVC_DECL_UNRESOLVED;
+    loop->acc_decl = NVC_DECL_UNRESOLVED;
+    ++*pos;
+    if (is_for) {
+        if (!nvc_expect_name(parser, stream, *pos, "counter")) goto error;
+        loop->counter = stream.tokens[(*pos)++].symbol;
+        if (!nvc_expect_word(parser, stream, (*pos)++, "in")) goto error;
+        loop->start = nvc_parse_clause(parser, stream, pos, depth);
+        if (!loop->start) goto error;
+        if (!nvc_expect_word(parser, stream, (*pos)++, "to")) goto error;
+        loop->end = nvc_parse_clause(parser, stream, pos, depth);
+        if (!loop->end) goto error;
+    } else {
+        loop->cond = nvc_parse_clause(parser, stream, pos, depth);
+        if (!loop->cond) goto error;
+    }
+    if (!nvc_expect_word(parser, stream, (*pos)++, "with") ||
+        !nvc_expect_name(parser, stream, *pos, "accumulator"))
+        goto error;
+    loop->acc = stream.tokens[(*pos)++].symbol;
+    if (!nvc_expect_op(parser, stream, (*pos)++, NVC_OP_EQ)) goto error;
+    loop->init = nvc_parse_clause(parser, stream, pos, depth);
+    if (!loop->init) goto error;
+    if (!nvc_expect_word(parser, stream, (*pos)++, "do") ||
+        !nvc_expect_op(parser, stream, (*pos)++, NVC_OP_LPAREN))
+        goto error;
+    loop->body =
+        nvc_parse_enclosed(parser, stream, pos, NVC_OP_RPAREN, depth);
+    if (!loop->body) goto error;
+    if (!nvc_expect_op(parser, stream, *pos, NVC_OP_RPAREN)) goto error;
+    ++*pos;
+    return node;
+error:
+    nvc_free_nodes_recursive(parser->allocator, node);
+    return NULL;
+}
+
+// parses [unary ops] (literal | symbol | '(' expr ')' | array | loop)
+// ('[' expr ']' | '(' args ')' | '.' field)* starting at *pos
+static bool nvc_parse_operand(nvc_parser_t* parser,
+                              nvc_token_stream_t stream,
+                              uint32_t* pos,
+                              nvc_chain_builder_t* builder,
+                              int depth) {
+    nvc_diagnostics_t* diags = parser->diags;
+
+    // prefix unary operators
+    while (*pos < stream.size && stream.tokens[*pos].kind == NVC_TOK_OP) {
+        nvc_tok_t* tok = stream.tokens + *pos;
+        nvc_unary_op_kind_t unary_op = nvc_map_unary_op(tok->op_kind);
+        if (unary_op == NVC_UN_OP_UNKNOWN) break;
+        nvc_ast_chain_elem_t* elem =
+            nvc_push_chain_elem(parser, builder, NVC_CHAIN_ELEM_UNARY_OP);
+        if (!elem) return false;
+        elem->unary_op_kind = unary_op;
+        ++*pos;
+    }
+
+    if (*pos >= stream.size) {
+        nvc_tok_t* last = stream.tokens + stream.size - 1;
+        nvc_report(diags, NVC_SEVERITY_ERROR, &last->buf_loc,
+                   "unexpected end of input");
+        nvc_report(diags, NVC_SEVERITY_NOTE, NULL, "expected operand");
+        return false;
+    }
+
+    nvc_tok_t* tok = stream.tokens + *pos;
+    nvc_ast_node_t* node = NULL;
+    switch (tok->kind) {
         case NVC_TOK_INT_LIT:
-            // rhs must be a binary operator when the lhs is an int literal,
-            // float literal, or symbol
-            return rhs->kind == NVC_TOK_OP &&
-                   nvc_map_binary_op(rhs->op_kind) != NVC_BIN_OP_UNKNOWN;
-        case NVC_TOK_STR_LIT: break;  // TODO: string operators?
-        case NVC_TOK_OP:
-            // lhs must be a binary operator (or unary operator) and the rhs
-            // must be an int literal, float literal, or symbol
-            return (nvc_map_binary_op(lhs->op_kind) != NVC_BIN_OP_UNKNOWN ||
-                    nvc_map_unary_op(lhs->op_kind) != NVC_UN_OP_UNKNOWN) &&
-                   (rhs->kind == NVC_TOK_FP_LIT ||
-                    rhs->kind == NVC_TOK_INT_LIT ||
-                    rhs->kind == NVC_TOK_SYMBOL ||
-                    // note: unary op can be rhs
-                    (rhs->kind == NVC_TOK_OP &&
-                     nvc_map_unary_op(rhs->op_kind) != NVC_UN_OP_UNKNOWN));
+            node = nvc_new_node(parser, NVC_AST_NODE_INT_LIT, tok);
+            if (!node) return false;
+            node->i = tok->int_lit;
+            node->width = tok->width;
+            node = nvc_hash_cons(parser, node);
+            ++*pos;
+            break;
+        case NVC_TOK_BIG_LIT:
+            node = nvc_new_node(parser, NVC_AST_NODE_BIG_LIT, tok);
+            if (!node) return false;
+            node->big = tok->big_lit;
+            node = nvc_hash_cons(parser, node);
+            ++*pos;
+            break;
+        case NVC_TOK_FP_LIT:
+            node = nvc_new_node(parser, NVC_AST_NODE_FP_LIT, tok);
+            if (!node) return false;
+            node->fp = tok->fp_lit;
+            node->width = tok->width;
+            node = nvc_hash_cons(parser, node);
+            ++*pos;
+            break;
+        case NVC_TOK_STR_LIT:
+            node = nvc_new_node(parser, NVC_AST_NODE_STRING_LIT, tok);
+            if (!node) return false;
+            node->str_lit = tok->str_lit;
+            node = nvc_hash_cons(parser, node);
+            ++*pos;
+            break;
+        case NVC_TOK_SYMBOL:
+            if (strncmp(tok->symbol, "for\0", 4) == 0 ||
+                strncmp(tok->symbol, "while\0", 6) == 0) {
+                node = nvc_parse_loop(parser, stream, pos, depth);
+                if (!node) return false;
+                break;
+            }
+            // note: keywords are reserved and can not be referenced
+            if (nvc_is_keyword(tok->symbol)) {
+                nvc_report(diags, NVC_SEVERITY_ERROR, &tok->buf_loc,
+                           "unexpected keyword '%s'", tok->symbol);
+                nvc_report(diags, NVC_SEVERITY_NOTE, NULL, "expected operand");
+                return false;
+            }
+            node = nvc_new_node(parser, NVC_AST_NODE_SYMBOL_REF, tok);
+            if (!node) return false;
+            node->symbol_ref.symbol = tok->symbol;
+            node->symbol_ref.decl = NVC_DECL_UNRESOLVED;
+            ++*pos;
+            break;
+        case NVC_TOK_OP: {
+            if (tok->op_kind == NVC_OP_LBRACKET) {
+                node = nvc_parse_array(parser, stream, pos, depth);
+                if (!node) return false;
+                break;
+            }
+            if (tok->op_kind != NVC_OP_LPAREN) {
+                nvc_report(diags, NVC_SEVERITY_ERROR, &tok->buf_loc,
+                           "syntax error: illegal operator: %s",
+                           nvc_op_to_str(tok->op_kind));
+                nvc_report(diags, NVC_SEVERITY_NOTE, NULL, "expected operand");
+                return false;
+            }
+            // parenthesised sub expression
+            nvc_token_stream_t inner = {
+                .tokens = tok + 1,
+                .size = stream.size - *pos - 1,
+            };
+            if (inner.size == 0) {
+                nvc_report(diags, NVC_SEVERITY_ERROR, &tok->buf_loc,
+                           "unexpected end of input");
+                nvc_report(diags, NVC_SEVERITY_NOTE, NULL, "expected op(%s)",
+                           nvc_op_to_str(NVC_OP_RPAREN));
+                return false;
+            }
+            uint32_t inner_eaten = 0;
+            node = nvc_parse_expr(parser, inner, &inner_eaten, depth + 1);
+            if (!node) return false;
+            *pos += 1 + inner_eaten;
+            if (*pos >= stream.size ||
+                stream.tokens[*pos].kind != NVC_TOK_OP ||
+                stream.tokens[*pos].op_kind != NVC_OP_RPAREN) {
+                nvc_tok_t* at = stream.tokens +
+                                (*pos < stream.size ? *pos : stream.size - 1);
+                nvc_report(diags, NVC_SEVERITY_ERROR, &at->buf_loc,
+                           "unexpected token");
+                nvc_report(diags, NVC_SEVERITY_NOTE, NULL, "expected op(%s)",
+                           nvc_op_to_str(NVC_OP_RPAREN));
+                nvc_free_nodes_recursive(parser->allocator, node);
+                return false;
+            }
+            ++*pos;
+            break;
+        }
+        case NVC_TOK_COMMENT:
+            // note: only the formatter lexes comments into tokens, the
+            // parser never sees them
+            nvc_report(diags, NVC_SEVERITY_ERROR, &tok->buf_loc,
+                       "unexpected comment");
+            nvc_report(diags, NVC_SEVERITY_NOTE, NULL, "expected operand");
+            return false;
+    }
+
+    // postfix indexing, calls and field accesses bind tighter than the
+    // prefix operators
+    // note: only a symbol can be called, so a parenthesised expression after
+    // anything else is not an argument list
+    for (;;) {
+        if (nvc_at_op(stream, *pos, NVC_OP_LBRACKET))
+            node = nvc_parse_index(parser, stream, pos, node, depth);
+        else if (nvc_at_op(stream, *pos, NVC_OP_LPAREN) &&
+                 node->kind == NVC_AST_NODE_SYMBOL_REF)
+            node = nvc_parse_call(parser, stream, pos, node, depth);
+        else if (nvc_at_op(stream, *pos, NVC_OP_DOT))
+            node = nvc_parse_field(parser, stream, pos, node);
+        else
+            break;
+        if (!node) return false;
+    }
+
+    nvc_ast_chain_elem_t* elem =
+        nvc_push_chain_elem(parser, builder, NVC_CHAIN_ELEM_NODE);
+    if (!elem) {
+        nvc_free_nodes_recursive(parser->allocator, node);
+        return false;
+    }
+    elem->node = node;
+    return true;
+}
+
+// parses an operator chain: operand (binary_op operand)*
+// note: the chain is kept flat, precedence is applied by whoever evaluates it
+static nvc_ast_node_t* nvc_parse_expr(nvc_parser_t* parser,
+                                      nvc_token_stream_t stream,
+                                      uint32_t* eaten,
+                                      int depth) {
+    nvc_allocator_t* allocator = parser->allocator;
+    nvc_chain_builder_t builder = {0};
+    uint32_t pos = 0;
+
+    if (!nvc_parse_operand(parser, stream, &pos, &builder, depth)) goto error;
+    while (pos < stream.size && stream.tokens[pos].kind == NVC_TOK_OP) {
+        nvc_binary_op_kind_t binary_op =
+            nvc_map_binary_op(stream.tokens[pos].op_kind);
+        if (binary_op == NVC_BIN_OP_UNKNOWN) break;
+        nvc_ast_chain_elem_t* elem =
+            nvc_push_chain_elem(parser, &builder, NVC_CHAIN_ELEM_BINARY_OP);
+        if (!elem) goto error;
+        elem->binary_op_kind = binary_op;
+        ++pos;
+        if (!nvc_parse_operand(parser, stream, &pos, &builder, depth))
+            goto error;
+    }
+
+    *eaten = pos;
+
+    // a single operand does not need a chain
+    if (builder.n_elems == 1) {
+        nvc_ast_node_t* node = builder.elems[0]->node;
+        nvc_free_ptr_array(allocator, (void**)builder.elems, 1);
+        return node;
+    }
+
+    nvc_ast_node_t* chain =
+        nvc_new_node(parser, NVC_AST_NODE_OP_CHAIN, stream.tokens);
+    if (!chain) goto error;
+    // shrink elems to save memory
+    // note: a failed shrink is harmless, keep the original buffer
+    nvc_ast_chain_elem_t** shrunk =
+        nvc_realloc(allocator, builder.elems,
+                    builder.n_elems * sizeof(nvc_ast_chain_elem_t*));
+    if (shrunk) builder.elems = shrunk;
+    chain->op_chain.elems = builder.elems;
+    chain->op_chain.n_elems = builder.n_elems;
+    return nvc_hash_cons(parser, chain);
+error:
+    nvc_free_chain_builder(allocator, &builder);
+    *eaten = 0;
+    return NULL;
+}
+
+// import <name>(.<name>)*
+static nvc_ast_node_t* nvc_parse_import(nvc_parser_t* parser,
+                                        nvc_token_stream_t stream,
+                                        uint32_t* eaten,
+                                        int depth) {
+    nvc_diagnostics_t* diags = parser->diags;
+    if (depth != 0) {
+        nvc_report(diags, NVC_SEVERITY_ERROR, &stream.tokens->buf_loc,
+                   "import is only allowed at the top level");
+        goto error;
+    }
+
+    // the module name is every symbol joined by dots
+    uint32_t pos = 1;
+    size_t len = 0;
+    for (;;) {
+        nvc_tok_t* tok = stream.tokens + pos;
+        if (pos >= stream.size || tok->kind != NVC_TOK_SYMBOL ||
+            nvc_is_keyword(tok->symbol)) {
+            nvc_tok_t* at = pos < stream.size ? tok : stream.tokens + pos - 1;
+            nvc_report(diags, NVC_SEVERITY_ERROR, &at->buf_loc,
+                       pos < stream.size ? "unexpected token"
+                                         : "unexpected end of input");
+            nvc_report(diags, NVC_SEVERITY_NOTE, NULL,
+                       "expected symbol(<module_name>)");
+            goto error;
+        }
+        len += strlen(tok->symbol) + 1;
+        ++pos;
+        if (pos >= stream.size || stream.tokens[pos].kind != NVC_TOK_OP ||
+            stream.tokens[pos].op_kind != NVC_OP_DOT)
+            break;
+        ++pos;
+    }
+
+    char* module = nvc_alloc(parser->allocator, len);
+    if (!module) {
+        nvc_report(diags, NVC_SEVERITY_ERROR, &stream.tokens->buf_loc,
+                   "out of memory");
+        goto error;
     }
+    char* dst = module;
+    for (uint32_t i = 1; i < pos; i += 2) {
+        size_t part_len = strlen(stream.tokens[i].symbol);
+        memcpy(dst, stream.tokens[i].symbol, part_len);
+        dst += part_len;
+        *dst++ = i + 2 < pos ? '.' : '\0';
+    }
+
+    nvc_ast_node_t* node =
+        nvc_new_node(parser, NVC_AST_NODE_IMPORT_DECL, stream.tokens);
+    if (!node) {
+        nvc_free(parser->allocator, module);
+        goto error;
+    }
+    node->import_decl.module = module;
+    node->import_decl.index = parser->n_imports++;
+    *eaten = pos;
+    return node;
+error:
+    *eaten = 0;
+    return NULL;
+}
+
+// note: tokens that start a top level declaration. a declaration never
+// consumes one of these (they are never an operand) so parsing only needs
+// the tokens up to the next boundary.
+// let can appear nested (function bodies), fun, type and import can not so
+// they always start a new declaration. for and while start an expression
+static bool nvc_is_decl_boundary(const nvc_tok_t* tok, int32_t depth) {
+    if (tok->kind != NVC_TOK_SYMBOL) return false;
+    if (strncmp(tok->symbol, "let\0", 4) == 0) return depth <= 0;
+    return strncmp(tok->symbol, "fun\0", 4) == 0 ||
+           strncmp(tok->symbol, "type\0", 5) == 0 ||
+           strncmp(tok->symbol, "import\0", 7) == 0;
+}
 
+// parses the declarations and expressions of a fun body into fun up to and
+// including the closing paren, stream starts after the opening one. on
+// failure the body is left empty
+static bool nvc_parse_body(nvc_parser_t* parser,
+                           nvc_token_stream_t stream,
+                           nvc_ast_fun_decl_t* fun,
+                           uint32_t* eaten) {
+    uint32_t pos = 0, capacity = 0;
+    while (!nvc_at_op(stream, pos, NVC_OP_RPAREN)) {
+        // note: the start of the next top level declaration means the
+        // closing paren is missing
+        if (pos >= stream.size ||
+            nvc_is_decl_boundary(stream.tokens + pos, 1)) {
+            nvc_expect_op(parser, stream, pos, NVC_OP_RPAREN);
+            goto error;
+        }
+        nvc_token_stream_t rem_stream = {
+            .tokens = stream.tokens + pos,
+            .size = stream.size - pos,
+        };
+        uint32_t recursive_eaten = 0;
+        nvc_ast_node_t* node =
+            nvc_parse_recursive(parser, rem_stream, &recursive_eaten, 1);
+        if (!node) goto error;
+        pos += recursive_eaten;
+        // dynamic allocation
+        if (fun->body_size >= capacity) {
+            capacity = capacity ? capacity * 2 : 4;
+            nvc_ast_node_t** grown =
+                nvc_realloc(parser->allocator, fun->body,
+                            capacity * sizeof(nvc_ast_node_t*));
+            if (!grown) {
+                nvc_free_nodes_recursive(parser->allocator, node);
+                nvc_report(parser->diags, NVC_SEVERITY_ERROR,
+                           &stream.tokens[pos - 1].buf_loc, "out of memory");
+                goto error;
+            }
+            fun->body = grown;
+        }
+        fun->body[fun->body_size++] = node;
+    }
+    *eaten = pos + 1;
+    return true;
+error:
+    nvc_free_nodes(parser->allocator, fun->body, fun->body_size);
+    fun->body = NULL;
+    fun->body_size = 0;
+    *eaten = 0;
     return false;
 }
 
-// static nvc_ast_op_chain_t nvc_scan_op_chain(nvc_token_stream_t stream,
-//                                             uint32_t* eaten) {}
-//
-// static nvc_ast_op_chain_t* nvc_scan_chain(nvc_token_stream_t stream) {
-//     // create chain from token stream
-//
-//     nvc_tok_t* ptr = stream.tokens;
-//     while (ptr && ++ptr && nvc_chainable_tokens(ptr - 1, ptr))
-//         ;
-//     return ptr - stream.tokens;
-// }
-
-// static nvc_ast_node_t* nvc_int_lit_node(nvc_tok_t* token) {
-//     nvc_ast_node_t* node = malloc(sizeof(nvc_ast_node_t));
-//     node->kind = NVC_AST_NODE_INT_LIT;
-//     node->i = token->int_lit;
-//     return node;
-// }
-//
-// static nvc_ast_node_t* nvc_fp_lit_node(nvc_tok_t* token) {
-//     nvc_ast_node_t* node = malloc(sizeof(nvc_ast_node_t));
-//     node->kind = NVC_AST_NODE_FP_LIT;
-//     node->fp = token->fp_lit;
-//     return node;
-// }
-//
-// static nvc_ast_node_t* nvc_str_lit_node(nvc_tok_t* token) {
-//     nvc_ast_node_t* node = malloc(sizeof(nvc_ast_node_t));
-//     node->kind = NVC_AST_NODE_STRING_LIT;
-//     node->str_lit = token->str_lit;
-//     return node;
-// }
-
-static nvc_ast_node_t* nvc_parse_recursive(nvc_token_stream_t stream,
-                                           uint32_t* eaten,
-                                           int depth) {
-    fprintf(stdout, "recursively parsing stream: %d %d\n", stream.size, depth);
+// finds the paren closing the one before stream with a bracket matching scan
+// and returns how many tokens are up to and including it, 0 after reporting
+// an error. a keyword that starts a top level declaration ends the scan
+// since it can not be part of a body
+static uint32_t nvc_skip_body(nvc_parser_t* parser, nvc_token_stream_t stream) {
+    int32_t depth = 1;
+    uint32_t pos = 0;
+    for (; pos < stream.size; ++pos) {
+        nvc_tok_t* tok = stream.tokens + pos;
+        if (tok->kind == NVC_TOK_OP) {
+            if (tok->op_kind == NVC_OP_LPAREN ||
+                tok->op_kind == NVC_OP_LBRACKET)
+                ++depth;
+            else if (tok->op_kind == NVC_OP_RPAREN ||
+                     tok->op_kind == NVC_OP_RBRACKET)
+                --depth;
+            if (depth == 0) return pos + 1;
+        } else if (nvc_is_decl_boundary(tok, depth)) {
+            break;
+        }
+    }
+    nvc_expect_op(parser, stream, pos, NVC_OP_RPAREN);
+    return 0;
+}
 
-    // empty stream fail case
-    if (stream.size <= 0) {
-        fprintf(stderr, "recursive call on empty stream: depth=%d\n", depth);
+// fun <name> '(' [<param> ':' <type> (',' <param> ':' <type>)* [',']] ')'
+// ['->' <type>] '(' <body> ')'
+static nvc_ast_node_t* nvc_parse_fun(nvc_parser_t* parser,
+                                     nvc_token_stream_t stream,
+                                     uint32_t* eaten,
+                                     int depth) {
+    nvc_ast_node_t* node = NULL;
+    if (depth != 0) {
+        nvc_report(parser->diags, NVC_SEVERITY_ERROR, &stream.tokens->buf_loc,
+                   "fun is only allowed at the top level");
+        goto error;
+    }
+    uint32_t pos = 1;
+    if (!nvc_expect_name(parser, stream, pos, "fun_name")) goto error;
+    node = nvc_new_node(parser, NVC_AST_NODE_FUN_DECL, stream.tokens + pos);
+    if (!node) goto error;
+    nvc_ast_fun_decl_t* fun = &node->fun_decl;
+    fun->fun_name = stream.tokens[pos++].symbol;
+    fun->decl = NVC_DECL_UNRESOLVED;
+    fun->return_type_decl = NVC_DECL_UNRESOLVED;
+
+    if (!nvc_expect_op(parser, stream, pos++, NVC_OP_LPAREN)) goto error;
+    uint32_t capacity = 0;
+    while (!nvc_at_op(stream, pos, NVC_OP_RPAREN)) {
+        if (!nvc_expect_name(parser, stream, pos, "param_name") ||
+            !nvc_expect_op(parser, stream, pos + 1,
+                           NVC_OP_TYPE_ANNOTATION) ||
+            !nvc_expect_name(parser, stream, pos + 2, "type_name"))
+            goto error;
+        // dynamic allocation
+        if (fun->n_params >= capacity) {
+            capacity = capacity ? capacity * 2 : 4;
+            nvc_fun_param_decl_t** grown =
+                nvc_realloc(parser->allocator, fun->params,
+                            capacity * sizeof(nvc_fun_param_decl_t*));
+            if (!grown) goto out_of_memory;
+            fun->params = grown;
+        }
+        nvc_fun_param_decl_t* param =
+            nvc_calloc(parser->allocator, 1, sizeof(nvc_fun_param_decl_t));
+        if (!param) goto out_of_memory;
+        param->param_name = stream.tokens[pos].symbol;
+        param->type_name = stream.tokens[pos + 2].symbol;
+        param->decl = NVC_DECL_UNRESOLVED;
+        param->type_decl = NVC_DECL_UNRESOLVED;
+        fun->params[fun->n_params++] = param;
+        pos += 3;
+        if (!nvc_at_op(stream, pos, NVC_OP_COMMA)) break;
+        ++pos;
+    }
+    if (!nvc_expect_op(parser, stream, pos++, NVC_OP_RPAREN)) goto error;
+    if (nvc_at_op(stream, pos, NVC_OP_RET_DECL)) {
+        if (!nvc_expect_name(parser, stream, ++pos, "type_name")) goto error;
+        fun->return_type_name = stream.tokens[pos++].symbol;
+    }
+    if (!nvc_expect_op(parser, stream, pos++, NVC_OP_LPAREN)) goto error;
+
+    nvc_token_stream_t body_stream = {
+        .tokens = stream.tokens + pos,
+        .size = stream.size - pos,
+    };
+    if (body_stream.size == 0) {
+        nvc_expect_op(parser, stream, pos, NVC_OP_RPAREN);
+        goto error;
+    }
+    uint32_t body_eaten = 0;
+    if (parser->options.lazy_bodies) {
+        body_eaten = nvc_skip_body(parser, body_stream);
+        if (!body_eaten) goto error;
+        fun->body_tokens = body_stream.tokens;
+        fun->n_body_tokens = body_eaten;
+    } else if (!nvc_parse_body(parser, body_stream, fun, &body_eaten)) {
+        goto error;
+    }
+    *eaten = pos + body_eaten;
+    return node;
+out_of_memory:
+    nvc_report(parser->diags, NVC_SEVERITY_ERROR, &node->buf_loc,
+               "out of memory");
+error:
+    nvc_free_nodes_recursive(parser->allocator, node);
+    *eaten = 0;
+    return NULL;
+}
+
+// type ['[' <attribute> (',' <attribute>)* ']'] <name> '(' <member> ':'
+// <type> ['[' <length> ']'] (',' <member> ':' <type> ['[' <length> ']'])*
+// [','] ')', the only attribute is fixed
+static nvc_ast_node_t* nvc_parse_type(nvc_parser_t* parser,
+                                      nvc_token_stream_t stream,
+                                      uint32_t* eaten,
+                                      int depth) {
+    nvc_diagnostics_t* diags = parser->diags;
+    nvc_ast_node_t* node = NULL;
+    if (depth != 0) {
+        nvc_report(diags, NVC_SEVERITY_ERROR, &stream.tokens->buf_loc,
+                   "type is only allowed at the top level");
         goto error;
     }
+    uint32_t pos = 1;
+    bool fixed_layout = false;
+    if (nvc_at_op(stream, pos, NVC_OP_LBRACKET)) {
+        ++pos;
+        for (;;) {
+            if (!nvc_expect_name(parser, stream, pos, "attribute")) goto error;
+            nvc_tok_t* attribute = stream.tokens + pos++;
+            if (strcmp(attribute->symbol, "fixed") != 0) {
+                nvc_report(diags, NVC_SEVERITY_ERROR, &attribute->buf_loc,
+                           "unknown type attribute '%s'", attribute->symbol);
+                nvc_report(diags, NVC_SEVERITY_NOTE, NULL,
+                           "expected fixed");
+                goto error;
+            }
+            fixed_layout = true;
+            if (!nvc_at_op(stream, pos, NVC_OP_COMMA)) break;
+            ++pos;
+        }
+        if (!nvc_expect_op(parser, stream, pos++, NVC_OP_RBRACKET)) goto error;
+    }
+    if (!nvc_expect_name(parser, stream, pos, "type_name")) goto error;
+    node = nvc_new_node(parser, NVC_AST_NODE_TYPE_DECL, stream.tokens + pos);
+    if (!node) goto error;
+    nvc_ast_type_decl_t* type = &node->type_decl;
+    type->type_name = stream.tokens[pos++].symbol;
+    type->fixed_layout = fixed_layout;
+    type->decl = NVC_DECL_UNRESOLVED;
 
-    // parse single elem token stream but only for literals and fail first
-    if (stream.size == 1) {
-        switch (stream.tokens->kind) {
-            case NVC_TOK_INT_LIT: goto parse_int_token;
-            case NVC_TOK_FP_LIT: goto parse_fp_token;
-            case NVC_TOK_STR_LIT: goto parse_str_token;
-            case NVC_TOK_OP: {
-                // this is illegal, there are no 0-ary operations
-                char* tokstr = nvc_token_to_str(stream.tokens);
-                fprintf(stderr,
-                        "syntax error: single token stream with only operator "
-                        "token: %s.\n",
-                        tokstr);
-                free(tokstr);
+    if (!nvc_expect_op(parser, stream, pos++, NVC_OP_LPAREN)) goto error;
+    uint32_t capacity = 0;
+    while (!nvc_at_op(stream, pos, NVC_OP_RPAREN)) {
+        if (!nvc_expect_name(parser, stream, pos, "member_name") ||
+            !nvc_expect_op(parser, stream, pos + 1,
+                           NVC_OP_TYPE_ANNOTATION) ||
+            !nvc_expect_name(parser, stream, pos + 2, "type_name"))
+            goto error;
+        uint32_t length = 0;
+        nvc_tok_t* member_tok = stream.tokens + pos;
+        char* type_name = stream.tokens[pos + 2].symbol;
+        pos += 3;
+        if (nvc_at_op(stream, pos, NVC_OP_LBRACKET)) {
+            nvc_tok_t* tok = stream.tokens + pos + 1;
+            if (pos + 1 >= stream.size || tok->kind != NVC_TOK_INT_LIT ||
+                tok->int_lit <= 0 || tok->int_lit > UINT32_MAX) {
+                nvc_tok_t* at = pos + 1 < stream.size ? tok : tok - 1;
+                nvc_report(diags, NVC_SEVERITY_ERROR, &at->buf_loc,
+                           pos + 1 < stream.size ? "unexpected token"
+                                                 : "unexpected end of input");
+                nvc_report(diags, NVC_SEVERITY_NOTE, NULL,
+                           "expected the array length (a positive int)");
                 goto error;
             }
+            length = (uint32_t)tok->int_lit;
+            if (!nvc_expect_op(parser, stream, pos + 2, NVC_OP_RBRACKET))
+                goto error;
+            pos += 3;
+        }
+        // dynamic allocation
+        if (type->n_members >= capacity) {
+            capacity = capacity ? capacity * 2 : 4;
+            nvc_type_member_decl_t** grown =
+                nvc_realloc(parser->allocator, type->members,
+                            capacity * sizeof(nvc_type_member_decl_t*));
+            if (!grown) goto out_of_memory;
+            type->members = grown;
         }
+        nvc_type_member_decl_t* member =
+            nvc_calloc(parser->allocator, 1, sizeof(nvc_type_member_decl_t));
+        if (!member) goto out_of_memory;
+        member->member_name = member_tok->symbol;
+        member->type_name = type_name;
+        member->length = length;
+        member->decl = NVC_DECL_UNRESOLVED;
+        type->members[type->n_members++] = member;
+        if (!nvc_at_op(stream, pos, NVC_OP_COMMA)) break;
+        ++pos;
+    }
+    if (!nvc_expect_op(parser, stream, pos, NVC_OP_RPAREN)) goto error;
+    if (!type->n_members) {
+        nvc_report(diags, NVC_SEVERITY_ERROR, &node->buf_loc,
+                   "type '%s' has no members", type->type_name);
+        goto error;
+    }
+    *eaten = pos + 1;
+    return node;
+out_of_memory:
+    nvc_report(diags, NVC_SEVERITY_ERROR, &node->buf_loc, "out of memory");
+error:
+    nvc_free_nodes_recursive(parser->allocator, node);
+    *eaten = 0;
+    return NULL;
+}
+
+static nvc_ast_node_t* nvc_parse_recursive(nvc_parser_t* parser,
+                                           nvc_token_stream_t stream,
+                                           uint32_t* eaten,
+                                           int depth) {
+    nvc_diagnostics_t* diags = parser->diags;
+
+    // empty stream fail case
+    if (stream.size <= 0) {
+        nvc_report(diags, NVC_SEVERITY_ERROR, NULL,
+                   "recursive call on empty stream: depth=%d", depth);
+        goto error;
     }
 
     // resolve keywords first
     if (stream.tokens->kind == NVC_TOK_SYMBOL) {
         // TODO: maybe use strncmp but this should always be null terminated
         if (strncmp(stream.tokens->symbol, "let\0", 4) == 0) {
+            // note: errors at the end of input point at the last token
+            nvc_buffer_location_t* last_loc =
+                &stream.tokens[stream.size - 1].buf_loc;
             // check 1st token is a symbol (var name)
-            if (stream.size <= 1) goto kw_expect_var_name;
+            if (stream.size <= 1) {
+                nvc_report(diags, NVC_SEVERITY_ERROR, last_loc,
+                           "unexpected end of input");
+                goto kw_expect_var_name;
+            }
             nvc_tok_t* ptr = stream.tokens;
-            if (!(++ptr) || ptr->kind != NVC_TOK_SYMBOL) {
-                nvc_print_buffer_message("unexpected token", ptr->buf_loc);
+            if (!(++ptr) || ptr->kind != NVC_TOK_SYMBOL ||
+                nvc_is_keyword(ptr->symbol)) {
+                nvc_report(diags, NVC_SEVERITY_ERROR, &ptr->buf_loc,
+                           "unexpected token");
             kw_expect_var_name:
-                fprintf(stderr, "note: expected symbol(<var_name>).\n");
+                nvc_report(diags, NVC_SEVERITY_NOTE, NULL,
+                           "expected symbol(<var_name>)");
                 goto error;
             }
-            char* var_name = ptr->symbol;
+            nvc_tok_t* var_name_tok = ptr;
             // check 2nd token is '=' op
-            if (stream.size <= 2) goto kw_expect_op;
+            if (stream.size <= 2) {
+                nvc_report(diags, NVC_SEVERITY_ERROR, last_loc,
+                           "unexpected end of input");
+                goto kw_expect_op;
+            }
             if (!(++ptr) || ptr->kind != NVC_TOK_OP ||
                 ptr->op_kind != NVC_OP_EQ) {
-                nvc_print_buffer_message("unexpected token", ptr->buf_loc);
+                nvc_report(diags, NVC_SEVERITY_ERROR, &ptr->buf_loc,
+                           "unexpected token");
             kw_expect_op:
-                fprintf(stderr, "note: expected op(%s).\n",
-                        nvc_op_to_str(NVC_OP_EQ));
+                nvc_report(diags, NVC_SEVERITY_NOTE, NULL, "expected op(%s)",
+                           nvc_op_to_str(NVC_OP_EQ));
                 goto error;
             }
 
@@ -264,169 +1475,475 @@ static nvc_ast_node_t* nvc_parse_recursive(nvc_token_stream_t stream,
             };
 
             if (rem_tokens_stream.size <= 0) {
-                fprintf(stderr, "note: expected rhs token.\n");
+                nvc_report(diags, NVC_SEVERITY_ERROR, last_loc,
+                           "unexpected end of input");
+                nvc_report(diags, NVC_SEVERITY_NOTE, NULL,
+                           "expected rhs token");
                 goto error;
             }
 
             uint32_t recursive_eaten = 0;
-            nvc_ast_node_t* rhs = nvc_parse_recursive(
-                rem_tokens_stream, &recursive_eaten, depth + 1);
+            nvc_ast_node_t* rhs = nvc_parse_expr(parser, rem_tokens_stream,
+                                                 &recursive_eaten, depth + 1);
             if (!rhs)
                 // recursive call will emit error
                 goto error;
 
             *eaten = (ptr - stream.tokens) + recursive_eaten;
 
-            nvc_ast_node_t* let_decl = malloc(sizeof(nvc_ast_node_t));
+            nvc_ast_node_t* let_decl =
+                nvc_new_node(parser, NVC_AST_NODE_LET_DECL, var_name_tok);
             if (!let_decl) {
-                fprintf(stderr, "Out of memory!\n");
-                nvc_free_nodes_recursive(rhs);
+                nvc_free_nodes_recursive(parser->allocator, rhs);
                 goto error;
             }
-            let_decl->kind = NVC_AST_NODE_LET_DECL;
-            let_decl->let_decl.symbol = var_name;
+            let_decl->let_decl.symbol = var_name_tok->symbol;
             let_decl->let_decl.rhs = rhs;
+            let_decl->let_decl.decl = NVC_DECL_UNRESOLVED;
 
             return let_decl;
         } else if (strncmp(stream.tokens->symbol, "fun\0", 4) == 0) {
-            // TODO: fun keyword
+            return nvc_parse_fun(parser, stream, eaten, depth);
         } else if (strncmp(stream.tokens->symbol, "type\0", 5) == 0) {
-            // TODO: type keyword
+            return nvc_parse_type(parser, stream, eaten, depth);
+        } else if (strncmp(stream.tokens->symbol, "import\0", 7) == 0) {
+            return nvc_parse_import(parser, stream, eaten, depth);
         }
     }
 
-    // single token stream parsing for symbols
-    // note: this is done after keyword parsing and separate to other single
-    // token stream parsing to so that keywords are reserved and will error when
-    // cannot be parsed
-    if (stream.size == 1 && stream.tokens->kind == NVC_TOK_SYMBOL) {
-        fprintf(stderr, "not implemented token!\n");
-        // TODO: probably generate a reference of some kind here
-        goto error;
+    // anything else is an expression
+    return nvc_parse_expr(parser, stream, eaten, depth);
+error:
+    *eaten = 0;
+    return NULL;
+}
+
+// the innermost delimiter opened before stream.tokens[end] that is still
+// open there, NULL if there is none
+static const nvc_tok_t* nvc_open_delimiter(nvc_token_stream_t stream,
+                                           uint32_t end) {
+    int32_t closed = 0;
+    for (uint32_t i = end; i-- > 0;) {
+        const nvc_tok_t* tok = stream.tokens + i;
+        if (tok->kind != NVC_TOK_OP) continue;
+        if (tok->op_kind == NVC_OP_RPAREN || tok->op_kind == NVC_OP_RBRACKET)
+            ++closed;
+        else if ((tok->op_kind == NVC_OP_LPAREN ||
+                  tok->op_kind == NVC_OP_LBRACKET) &&
+                 closed-- == 0)
+            return tok;
     }
+    return NULL;
+}
 
-    // parse operator chain
-    switch (stream.tokens->kind) {
-        case NVC_TOK_SYMBOL:
-            // note: this is a reference
-            break;
-        case NVC_TOK_OP: {
-            // note: this must be a unary op
-            nvc_unary_op_kind_t unary_op =
-                nvc_map_unary_op(stream.tokens->op_kind);
-            if (unary_op != NVC_UN_OP_UNKNOWN) {
-                //                break;
+// error recovery: returns how many tokens to skip to get to the next
+// declaration boundary, or past a closing delimiter that has no opening one
+// in the skipped range. always skips at least one token so parsing progresses
+// note: inside a delimiter a let is only a boundary when it starts a line at
+// the column the failed declaration started at, and that declaration is not
+// a fun (whose body has lets of its own). the delimiters left open are then
+// the ones of the failed expression, the innermost one is reported
+static uint32_t nvc_sync_tokens(nvc_parser_t* parser,
+                                nvc_token_stream_t stream) {
+    const nvc_tok_t* first = stream.tokens;
+    bool in_fun = first->kind == NVC_TOK_SYMBOL &&
+                  strncmp(first->symbol, "fun\0", 4) == 0;
+    int32_t depth = 0;
+    for (uint32_t i = 0; i < stream.size; ++i) {
+        nvc_tok_t* tok = stream.tokens + i;
+        if (tok->kind == NVC_TOK_OP) {
+            switch (tok->op_kind) {
+                case NVC_OP_LPAREN:
+                case NVC_OP_LBRACKET: ++depth; break;
+                case NVC_OP_RPAREN:
+                case NVC_OP_RBRACKET:
+                    if (depth == 0) return i + 1;
+                    --depth;
+                    break;
+                default: break;
             }
-
-            nvc_print_buffer_message("illegal operator", stream.tokens->buf_loc);
-            fprintf(stderr, "syntax error: illegal operator: %s\n",
-                    nvc_op_to_str(stream.tokens->op_kind));
-            goto error;
+        } else if (i != 0 && nvc_is_decl_boundary(tok, depth)) {
+            return i;
+        } else if (i != 0 && !in_fun && nvc_is_decl_boundary(tok, 0) &&
+                   tok->buf_loc.l > tok[-1].buf_loc.l &&
+                   tok->buf_loc.c == first->buf_loc.c) {
+            const nvc_tok_t* open = nvc_open_delimiter(stream, i);
+            if (open)
+                nvc_report(parser->diags, NVC_SEVERITY_NOTE, &open->buf_loc,
+                           "this '%s' is never closed",
+                           nvc_op_to_str(open->op_kind));
+            return i;
         }
-        case NVC_TOK_INT_LIT:
-            // note: this must be followed by a binary op
-            break;
-        case NVC_TOK_FP_LIT:
-            // note: this must be followed by a binary op
-            break;
-        case NVC_TOK_STR_LIT:
-            // note: this must be followed by a binary op
-            break;
     }
-
-    fprintf(stderr, "Unreachable code!\n");
-error:
-    *eaten = 0;
-    return NULL;
-parse_int_token : {
-    *eaten = 1;
-    nvc_ast_node_t* node = malloc(sizeof(nvc_ast_node_t));
-    node->kind = NVC_AST_NODE_INT_LIT;
-    node->i = stream.tokens->int_lit;
-    return node;
+    return stream.size;
 }
-parse_fp_token : {
-    *eaten = 1;
-    nvc_ast_node_t* node = malloc(sizeof(nvc_ast_node_t));
-    node->kind = NVC_AST_NODE_FP_LIT;
-    node->fp = stream.tokens->fp_lit;
-    return node;
-};
-parse_str_token : {
-    *eaten = 1;
-    nvc_ast_node_t* node = malloc(sizeof(nvc_ast_node_t));
-    node->kind = NVC_AST_NODE_STRING_LIT;
-    node->str_lit = stream.tokens->str_lit;
-    return node;
+
+// parses the declaration at the start of stream into *node, on a syntax
+// error *node is NULL and the tokens up to the next declaration are skipped
+// returns the amount of tokens consumed (at least 1)
+static uint32_t nvc_parse_decl(nvc_parser_t* parser,
+                               nvc_token_stream_t stream,
+                               nvc_ast_node_t** node) {
+    uint32_t eaten = 0;
+    *node = nvc_parse_recursive(parser, stream, &eaten, 0);
+    if (*node) return eaten;
+    return nvc_sync_tokens(parser, stream);
 }
+
+// note: growable array of the top level nodes while parsing
+typedef struct {
+    nvc_ast_node_t** nodes;
+    uint32_t n_nodes, capacity;
+} nvc_node_list_t;
+
+static bool nvc_push_node(nvc_parser_t* parser,
+                          nvc_node_list_t* list,
+                          nvc_ast_node_t* node) {
+    // dynamic allocation
+    if (list->n_nodes >= list->capacity) {
+        // initially allocate spaces for 2^3 nodes then increase by 50%
+        uint32_t capacity = list->capacity ? (list->capacity / 2) * 3 : 1 << 3;
+        // note: keep the old buffer on failure so it can still be freed
+        nvc_ast_node_t** grown = nvc_realloc(
+            parser->allocator, list->nodes, capacity * sizeof(nvc_ast_node_t*));
+        if (!grown) {
+            nvc_free_nodes_recursive(parser->allocator, node);
+            return false;
+        }
+        list->nodes = grown;
+        list->capacity = capacity;
+    }
+    list->nodes[list->n_nodes++] = node;
+    return true;
 }
 
-nvc_ast_t* nvc_parse(nvc_token_stream_t* stream) {
-    // initially allocate spaces for 2^3 nodes
-    uint32_t capacity = 1 << 3;
-    nvc_ast_node_t** nodes = calloc(capacity, sizeof(nvc_ast_node_t*));
-    if (!nodes) {
-        fprintf(stderr, "Out of memory!\n");
+// moves the parsed nodes into a new nvc_ast_t, frees everything on failure
+static nvc_ast_t* nvc_finish_ast(nvc_parser_t* parser, nvc_node_list_t* list) {
+    nvc_allocator_t* allocator = parser->allocator;
+    nvc_free(allocator, parser->hash_cons.slots);
+    nvc_free(allocator, parser->hash_cons.hashes);
+    // shrink nodes to save memory
+    // note: a failed shrink is harmless, keep the original buffer
+    if (list->n_nodes) {
+        nvc_ast_node_t** shrunk = nvc_realloc(
+            allocator, list->nodes, list->n_nodes * sizeof(nvc_ast_node_t*));
+        if (shrunk) list->nodes = shrunk;
+    }
+    // allocate abstract syntax tree
+    nvc_ast_t* ast = nvc_calloc(allocator, 1, sizeof(nvc_ast_t));
+    if (!ast) {
+        nvc_report(parser->diags, NVC_SEVERITY_ERROR, NULL, "out of memory");
+        nvc_free_nodes(allocator, list->nodes, list->n_nodes);
         return NULL;
     }
-    uint32_t n_nodes = 0;
-    uint32_t ate = 0;
-
-    for (; ate < stream->size;) {
-        uint32_t eaten = 0;
-        nvc_ast_node_t* node = NULL;
+    ast->allocator = allocator;
+    ast->nodes = list->nodes;
+    ast->size = list->n_nodes;
+    ast->n_shared = parser->n_shared;
+    ast->n_imports = parser->n_imports;
+    return ast;
+}
 
-        if (ate == 0) {
-            node = nvc_parse_recursive(*stream, &eaten, 0);
-        } else {
-            nvc_token_stream_t sub_stream = {
-                .tokens = stream->tokens + ate,
-                .size = stream->size - ate,
-            };
+static void nvc_abort_parse(nvc_parser_t* parser, nvc_node_list_t* list) {
+    nvc_report(parser->diags, NVC_SEVERITY_ERROR, NULL, "out of memory");
+    nvc_free_nodes(parser->allocator, list->nodes, list->n_nodes);
+    nvc_free(parser->allocator, parser->hash_cons.slots);
+    nvc_free(parser->allocator, parser->hash_cons.hashes);
+}
 
-            node = nvc_parse_recursive(sub_stream, &eaten, 0);
+// parses every declaration of stream into list, stops early at the error
+// limit. returns false when out of memory
+static bool nvc_parse_decls(nvc_parser_t* parser,
+                            nvc_token_stream_t stream,
+                            nvc_node_list_t* list) {
+    for (uint32_t ate = 0; ate < stream.size;) {
+        nvc_token_stream_t rem_stream = {
+            .tokens = stream.tokens + ate,
+            .size = stream.size - ate,
+        };
+        nvc_ast_node_t* node;
+        ate += nvc_parse_decl(parser, rem_stream, &node);
+        if (node) {
+            if (!nvc_push_node(parser, list, node)) return false;
+        } else if (nvc_diagnostics_full(parser->diags)) {
+            // give up once the error limit is reached
+            break;
         }
+    }
+    return true;
+}
 
-        if (!node) {
-            nvc_free_nodes(nodes, n_nodes);
-            return NULL;
+// a range of top level declarations parsed on its own thread, into its own
+// arena and diagnostics so the threads share nothing but the tokens
+typedef struct {
+    nvc_token_stream_t stream;
+    nvc_arena_t arena;
+    nvc_diagnostics_t diags;
+    nvc_parser_t parser;
+    nvc_node_list_t list;
+    bool started;  // parsed on a thread of its own
+    bool out_of_memory;
+} nvc_parse_range_t;
+
+static void* nvc_parse_range_main(void* arg) {
+    nvc_parse_range_t* range = arg;
+    range->out_of_memory =
+        !nvc_parse_decls(&range->parser, range->stream, &range->list);
+    return NULL;
+}
+
+// cuts stream into at most n ranges of about the same amount of tokens, each
+// cut is at a token a sequential parse starts a declaration at. returns the
+// amount of ranges, ranges[i] ends where ranges[i + 1] starts
+// note: the depth is clamped at 0 like nvc_parse_incremental does. a token
+// at clamped depth 0 is at depth <= 0 relative to any earlier token, so
+// neither a declaration nor the error recovery of one (nvc_sync_tokens) that
+// started before it can run past it
+static uint32_t nvc_cut_ranges(nvc_token_stream_t stream,
+                               uint32_t* cuts,
+                               uint32_t n) {
+    uint32_t n_ranges = 1;
+    cuts[0] = 0;
+    int32_t depth = 0;
+    for (uint32_t i = 1; i < stream.size && n_ranges < n; ++i) {
+        nvc_tok_t* tok = stream.tokens + i - 1;
+        if (tok->kind == NVC_TOK_OP) {
+            if (tok->op_kind == NVC_OP_LPAREN ||
+                tok->op_kind == NVC_OP_LBRACKET)
+                ++depth;
+            else if ((tok->op_kind == NVC_OP_RPAREN ||
+                      tok->op_kind == NVC_OP_RBRACKET) &&
+                     depth > 0)
+                --depth;
         }
+        uint64_t target = (uint64_t)stream.size * n_ranges / n;
+        if (i >= target && nvc_is_decl_boundary(stream.tokens + i, depth))
+            cuts[n_ranges++] = i;
+    }
+    cuts[n_ranges] = stream.size;
+    return n_ranges;
+}
 
-        nodes[n_nodes] = node;
-        ++n_nodes;
-        ate += eaten;
+static nvc_ast_t* nvc_parse_parallel(nvc_allocator_t* allocator,
+                                     nvc_diagnostics_t* diags,
+                                     nvc_token_stream_t* stream,
+                                     const nvc_parse_options_t* options,
+                                     uint32_t n_jobs) {
+    nvc_ast_t* ast = NULL;
+    uint32_t* cuts = nvc_alloc(allocator, (n_jobs + 1) * sizeof(uint32_t));
+    nvc_parse_range_t* ranges =
+        nvc_calloc(allocator, n_jobs, sizeof(nvc_parse_range_t));
+    pthread_t* threads = nvc_alloc(allocator, n_jobs * sizeof(pthread_t));
+    uint32_t n_ranges = 0;
+    if (!cuts || !ranges || !threads) goto out_of_memory;
 
-        // dynamic allocation
-        if (n_nodes >= capacity) {
-            // increase by 50%
-            capacity = (n_nodes / 2) * 3;
-            // TODO: remove me
-            fprintf(stdout, "Dynamic allocation (nodes) %d -> %d.\n", n_nodes,
-                    capacity);
-            // reallocate with increased capacity
-            nodes = realloc(nodes, capacity * sizeof(nvc_ast_node_t*));
-            if (!nodes) {
-                fprintf(stderr, "Out of memory!\n");
-                nvc_free_nodes(nodes, n_nodes);
-                return NULL;
-            }
+    n_ranges = nvc_cut_ranges(*stream, cuts, n_jobs);
+    for (uint32_t i = 0; i < n_ranges; ++i) {
+        nvc_parse_range_t* range = ranges + i;
+        range->stream.tokens = stream->tokens + cuts[i];
+        range->stream.size = cuts[i + 1] - cuts[i];
+        nvc_arena_init(&range->arena, allocator, 0);
+        // note: the messages move to diags later so they must share its
+        // allocator, only the nodes go into the arena
+        nvc_diagnostics_init(&range->diags, diags->allocator);
+        range->diags.max_errors = diags->max_errors;
+        range->parser.allocator = nvc_arena_allocator(&range->arena);
+        range->parser.diags = &range->diags;
+        range->parser.options = *options;
+    }
+
+    // the first range is parsed on the calling thread, a range whose thread
+    // could not be started is parsed there too
+    for (uint32_t i = 1; i < n_ranges; ++i)
+        ranges[i].started = pthread_create(threads + i, NULL,
+                                           nvc_parse_range_main,
+                                           ranges + i) == 0;
+    nvc_parse_range_main(ranges);
+    for (uint32_t i = 1; i < n_ranges; ++i) {
+        if (ranges[i].started)
+            pthread_join(threads[i], NULL);
+        else
+            nvc_parse_range_main(ranges + i);
+    }
+
+    // concatenate the ranges in source order
+    uint64_t n_nodes = 0;
+    bool out_of_memory = false;
+    for (uint32_t i = 0; i < n_ranges; ++i) {
+        n_nodes += ranges[i].list.n_nodes;
+        out_of_memory |= ranges[i].out_of_memory;
+        nvc_diagnostics_merge(diags, &ranges[i].diags);
+    }
+    if (out_of_memory) goto out_of_memory;
+    ast = nvc_calloc(allocator, 1, sizeof(nvc_ast_t));
+    if (!ast) goto out_of_memory;
+    ast->allocator = allocator;
+    ast->nodes = nvc_alloc(allocator, n_nodes * sizeof(nvc_ast_node_t*));
+    ast->arenas = nvc_alloc(allocator, n_ranges * sizeof(nvc_arena_t));
+    if ((n_nodes && !ast->nodes) || !ast->arenas) goto out_of_memory;
+    for (uint32_t i = 0; i < n_ranges; ++i) {
+        nvc_parse_range_t* range = ranges + i;
+        // note: import indices count from the start of the tree
+        for (uint32_t j = 0; j < range->list.n_nodes; ++j) {
+            nvc_ast_node_t* node = range->list.nodes[j];
+            if (node->kind == NVC_AST_NODE_IMPORT_DECL)
+                node->import_decl.index += ast->n_imports;
+            ast->nodes[ast->size++] = node;
         }
+        ast->n_shared += range->parser.n_shared;
+        ast->n_imports += range->parser.n_imports;
+        // note: the allocator of a moved arena must point at its new home
+        nvc_arena_t* arena = ast->arenas + ast->n_arenas++;
+        *arena = range->arena;
+        arena->allocator.ctx = arena;
     }
+    goto out;
 
-    // shrink nodes to save memory
-    nodes = realloc(nodes, n_nodes * sizeof(nvc_ast_node_t*));
-    // allocate abstract syntax tree
-    nvc_ast_t* ast = calloc(1, sizeof(nvc_ast_t));
-    if (!ast) {
-        nvc_free_nodes(nodes, n_nodes);
-        fprintf(stderr, "Out of memory!\n");
-        return NULL;
+out_of_memory:
+    nvc_report(diags, NVC_SEVERITY_ERROR, NULL, "out of memory");
+    if (ast) {
+        nvc_free(allocator, ast->nodes);
+        nvc_free(allocator, ast->arenas);
+        nvc_free(allocator, ast);
+        ast = NULL;
     }
-    ast->nodes = nodes;
-    ast->size = n_nodes;
+    for (uint32_t i = 0; i < n_ranges; ++i)
+        nvc_arena_destroy(&ranges[i].arena);
+out:
+    for (uint32_t i = 0; i < n_ranges; ++i)
+        nvc_diagnostics_free(&ranges[i].diags);
+    nvc_free(allocator, threads);
+    nvc_free(allocator, ranges);
+    nvc_free(allocator, cuts);
     return ast;
 }
 
+nvc_ast_t* nvc_parse(nvc_allocator_t* allocator,
+                     nvc_diagnostics_t* diags,
+                     nvc_token_stream_t* stream,
+                     const nvc_parse_options_t* options) {
+    // note: a thread only pays off for a decent amount of tokens
+    uint32_t n_jobs = options ? options->n_jobs : 0;
+    if (n_jobs > stream->size / NVC_PARSE_MIN_TOKENS_PER_JOB)
+        n_jobs = stream->size / NVC_PARSE_MIN_TOKENS_PER_JOB;
+    if (n_jobs > 1 && diags)
+        return nvc_parse_parallel(allocator, diags, stream, options, n_jobs);
+
+    nvc_parser_t parser = {
+        .allocator = allocator,
+        .diags = diags,
+    };
+    if (options) parser.options = *options;
+    nvc_node_list_t list = {0};
+    if (!nvc_parse_decls(&parser, *stream, &list)) goto out_of_memory;
+    return nvc_finish_ast(&parser, &list);
+out_of_memory:
+    nvc_abort_parse(&parser, &list);
+    return NULL;
+}
+
+nvc_ast_t* nvc_parse_incremental(nvc_allocator_t* allocator,
+                                 nvc_diagnostics_t* diags,
+                                 nvc_token_source_t next,
+                                 void* source,
+                                 const nvc_parse_options_t* options) {
+    nvc_parser_t parser = {
+        .allocator = allocator,
+        .diags = diags,
+    };
+    if (options) parser.options = *options;
+    // note: the tokens of a declaration are dropped once it is parsed
+    parser.options.lazy_bodies = false;
+    nvc_node_list_t list = {0};
+
+    // window of tokens from the start of the current declaration up to and
+    // including the start of the next one, only this much is ever kept
+    nvc_tok_t* window = NULL;
+    uint32_t size = 0, capacity = 0;
+    bool end_of_input = false;
+
+    for (;;) {
+        // fill the window until it holds a whole declaration
+        uint32_t scanned = 0;
+        int32_t depth = 0;
+        for (;;) {
+            bool boundary = false;
+            for (; scanned < size; ++scanned) {
+                nvc_tok_t* tok = window + scanned;
+                if (scanned && nvc_is_decl_boundary(tok, depth)) {
+                    boundary = true;
+                    break;
+                }
+                if (tok->kind != NVC_TOK_OP) continue;
+                if (tok->op_kind == NVC_OP_LPAREN ||
+                    tok->op_kind == NVC_OP_LBRACKET)
+                    ++depth;
+                else if ((tok->op_kind == NVC_OP_RPAREN ||
+                          tok->op_kind == NVC_OP_RBRACKET) &&
+                         depth > 0)
+                    --depth;
+            }
+            if (boundary || end_of_input) break;
+            // dynamic allocation
+            if (size == capacity) {
+                uint32_t grown_capacity = capacity ? capacity * 2 : 64;
+                nvc_tok_t* grown = nvc_realloc(
+                    allocator, window, grown_capacity * sizeof(nvc_tok_t));
+                if (!grown) goto out_of_memory;
+                window = grown;
+                capacity = grown_capacity;
+            }
+            uint32_t n = next(source, window + size, capacity - size);
+            if (!n) end_of_input = true;
+            size += n;
+        }
+        if (!size) break;
+
+        nvc_token_stream_t stream = {
+            .tokens = window,
+            .size = size,
+        };
+        nvc_ast_node_t* node;
+        uint32_t ate = nvc_parse_decl(&parser, stream, &node);
+        // note: only the token structs are dropped, the strings they point
+        // to belong to the source
+        memmove(window, window + ate, (size - ate) * sizeof(nvc_tok_t));
+        size -= ate;
+        if (node) {
+            if (!nvc_push_node(&parser, &list, node)) goto out_of_memory;
+        } else if (nvc_diagnostics_full(diags)) {
+            break;
+        }
+    }
+    nvc_free(allocator, window);
+    return nvc_finish_ast(&parser, &list);
+out_of_memory:
+    nvc_free(allocator, window);
+    nvc_abort_parse(&parser, &list);
+    return NULL;
+}
+
+bool nvc_parse_fun_body(nvc_ast_t* ast,
+                        nvc_diagnostics_t* diags,
+                        nvc_ast_node_t* fun) {
+    nvc_ast_fun_decl_t* decl = &fun->fun_decl;
+    if (!decl->body_tokens) return true;
+    // note: nodes of a tree parsed in parallel all live in its arenas
+    nvc_parser_t parser = {
+        .allocator = ast->arenas ? nvc_arena_allocator(ast->arenas)
+                                 : ast->allocator,
+        .diags = diags,
+    };
+    nvc_token_stream_t stream = {
+        .tokens = decl->body_tokens,
+        .size = decl->n_body_tokens,
+    };
+    decl->body_tokens = NULL;
+    decl->n_body_tokens = 0;
+    uint32_t eaten = 0;
+    return nvc_parse_body(&parser, stream, decl, &eaten);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,738 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nvc_batch.h>
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <nvc_context.h>
+#include <nvc_utf8.h>
+
+#define NVC_BATCH_OUTPUT_TOKENS (1 << 0)
+#define NVC_BATCH_OUTPUT_AST (1 << 1)
+#define NVC_BATCH_OUTPUT_IR (1 << 2)
+
+// nesting limit of the values skipped in a request
+#define NVC_JSON_MAX_DEPTH 64
+
+// growable output line of a request, kept by its slot across requests
+typedef struct {
+    nvc_allocator_t* allocator;
+    char* data;
+    size_t size, capacity;
+    bool failed;  // out of memory, the result is replaced by an error
+} nvc_batch_buf_t;
+
+typedef enum {
+    NVC_SLOT_FREE = 0,
+    NVC_SLOT_QUEUED = 1,
+    NVC_SLOT_DONE = 2,
+} nvc_slot_state_t;
+
+typedef struct {
+    char* line;  // the request, owned by getline and reused by it
+    size_t line_capacity;
+    size_t line_len;
+    nvc_batch_buf_t result;
+    nvc_slot_state_t state;
+    bool ok;
+} nvc_batch_slot_t;
+
+// note: request n lives in slots[n % n_slots] from being read until its
+// result is written, so at most n_slots requests are in flight. the reader,
+// the workers and the writer only touch a slot in the state they own it in
+typedef struct {
+    nvc_allocator_t* allocator;
+    const nvc_compile_options_t* options;
+    nvc_perf_profile_t* profile;
+    FILE* out;
+    pthread_mutex_t lock;
+    pthread_cond_t work;   // a request was queued or the input ended
+    pthread_cond_t space;  // a result was written, its slot is free
+    nvc_batch_slot_t* slots;
+    uint32_t n_slots;
+    uint64_t n_read, n_taken, n_written;
+    bool eof;
+    bool writing;  // a thread is writing results, the others leave it be
+    bool failed;   // a request failed
+} nvc_batch_t;
+
+// what a worker reuses across requests
+typedef struct {
+    nvc_batch_t* batch;
+    nvc_context_t* ctx;
+    nvc_arena_t arena;  // the decoded strings of the current request
+} nvc_batch_worker_t;
+
+typedef struct {
+    const char* id;  // raw JSON of the id, echoed back
+    size_t id_len;
+    char* name;
+    char* source;
+    size_t source_len;
+    uint32_t outputs;
+} nvc_batch_request_t;
+
+typedef struct {
+    const char* p;
+    const char* end;
+    nvc_allocator_t* allocator;  // decoded strings are allocated with this
+    const char* error;
+} nvc_json_t;
+
+static void nvc_batch_append(nvc_batch_buf_t* buf, const char* str, size_t n) {
+    if (buf->failed) return;
+    // dynamic allocation
+    if (buf->size + n + 1 > buf->capacity) {
+        size_t capacity = buf->capacity ? buf->capacity * 2 : 256;
+        while (capacity < buf->size + n + 1) capacity *= 2;
+        char* grown = nvc_realloc(buf->allocator, buf->data, capacity);
+        if (!grown) {
+            buf->failed = true;
+            return;
+        }
+        buf->data = grown;
+        buf->capacity = capacity;
+    }
+    memcpy(buf->data + buf->size, str, n);
+    buf->size += n;
+    buf->data[buf->size] = '\0';
+}
+
+static void nvc_batch_puts(nvc_batch_buf_t* buf, const char* str) {
+    nvc_batch_append(buf, str, strlen(str));
+}
+
+static void nvc_batch_printf(nvc_batch_buf_t* buf, const char* fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+static void nvc_batch_printf(nvc_batch_buf_t* buf, const char* fmt, ...) {
+    char small[64];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(small, sizeof(small), fmt, args);
+    va_end(args);
+    if (n < 0) return;
+    // note: only short numbers are printed, longer output would be cut
+    nvc_batch_append(buf, small, (size_t)n < sizeof(small) ? (size_t)n
+                                                           : sizeof(small) - 1);
+}
+
+// appends str as a JSON string, bytes that are not valid UTF-8 become U+FFFD
+// so the result is always valid JSON
+static void nvc_batch_json_string(nvc_batch_buf_t* buf,
+                                  const char* str,
+                                  size_t n) {
+    const char* end = str + n;
+    const char* run = str;  // start of the bytes that need no escaping
+    nvc_batch_append(buf, "\"", 1);
+    for (const char* p = str; p < end;) {
+        unsigned char c = *p;
+        const char* escape = NULL;
+        char hex[8];
+        size_t len = 1;
+        if (c == '"') {
+            escape = "\\\"";
+        } else if (c == '\\') {
+            escape = "\\\\";
+        } else if (c == '\n') {
+            escape = "\\n";
+        } else if (c == '\t') {
+            escape = "\\t";
+        } else if (c == '\r') {
+            escape = "\\r";
+        } else if (c < 0x20) {
+            snprintf(hex, sizeof(hex), "\\u%04x", c);
+            escape = hex;
+        } else if (c >= 0x80) {
+            uint32_t cp;
+            len = nvc_utf8_decode(p, end, &cp);
+            if (!len) {
+                escape = "\\ufffd";
+                len = 1;
+            }
+        }
+        if (escape) {
+            nvc_batch_append(buf, run, p - run);
+            nvc_batch_puts(buf, escape);
+            run = p + len;
+        }
+        p += len;
+    }
+    nvc_batch_append(buf, run, end - run);
+    nvc_batch_append(buf, "\"", 1);
+}
+
+static void nvc_json_ws(nvc_json_t* j) {
+    while (j->p < j->end &&
+           (*j->p == ' ' || *j->p == '\t' || *j->p == '\r' || *j->p == '\n'))
+        ++j->p;
+}
+
+static bool nvc_json_fail(nvc_json_t* j, const char* error) {
+    if (!j->error) j->error = error;
+    return false;
+}
+
+static int nvc_json_hex4(const char* p, const char* end) {
+    if (end - p < 4) return -1;
+    int value = 0;
+    for (int i = 0; i < 4; ++i) {
+        char c = p[i];
+        int digit = c >= '0' && c <= '9'   ? c - '0'
+                    : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                    : c >= 'A' && c <= 'F' ? c - 'A' + 10
+                                           : -1;
+        if (digit < 0) return -1;
+        value = value * 16 + digit;
+    }
+    return value;
+}
+
+// decodes the string at j->p into a null terminated copy allocated from
+// j->allocator (out may be NULL to only skip it)
+// note: a decoded string is never longer than its escaped form
+static bool nvc_json_string(nvc_json_t* j, char** out, size_t* out_len) {
+    if (j->p >= j->end || *j->p != '"')
+        return nvc_json_fail(j, "expected a string");
+    const char* begin = ++j->p;
+    const char* close = begin;
+    while (close < j->end && *close != '"') close += *close == '\\' ? 2 : 1;
+    if (close >= j->end) return nvc_json_fail(j, "unterminated string");
+    char* dst = NULL;
+    if (out) {
+        dst = nvc_alloc(j->allocator, close - begin + 1);
+        if (!dst) return nvc_json_fail(j, "out of memory");
+    }
+
+    size_t len = 0;
+    const char* p = begin;
+    while (p < close) {
+        unsigned char c = *p;
+        if (c < 0x20) return nvc_json_fail(j, "control character in string");
+        if (c != '\\') {
+            if (dst) dst[len] = c;
+            ++len;
+            ++p;
+            continue;
+        }
+        char escaped = p[1];
+        p += 2;
+        char unescaped;
+        switch (escaped) {
+            case '"': unescaped = '"'; break;
+            case '\\': unescaped = '\\'; break;
+            case '/': unescaped = '/'; break;
+            case 'b': unescaped = '\b'; break;
+            case 'f': unescaped = '\f'; break;
+            case 'n': unescaped = '\n'; break;
+            case 'r': unescaped = '\r'; break;
+            case 't': unescaped = '\t'; break;
+            case 'u': {
+                int cp = nvc_json_hex4(p, close);
+                if (cp < 0) return nvc_json_fail(j, "malformed \\u escape");
+                p += 4;
+                // a surrogate pair encodes one code point above U+FFFF
+                if (cp >= 0xD800 && cp <= 0xDBFF && close - p >= 6 &&
+                    p[0] == '\\' && p[1] == 'u') {
+                    int low = nvc_json_hex4(p + 2, close);
+                    if (low >= 0xDC00 && low <= 0xDFFF) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        p += 6;
+                    }
+                }
+                // note: the lexer stops at a null character
+                if (cp == 0) return nvc_json_fail(j, "null character");
+                char utf8[NVC_UTF8_MAX_LEN];
+                size_t n = nvc_utf8_encode((uint32_t)cp, utf8);
+                if (!n) return nvc_json_fail(j, "unpaired surrogate");
+                if (dst) memcpy(dst + len, utf8, n);
+                len += n;
+                continue;
+            }
+            default: return nvc_json_fail(j, "unknown escape in string");
+        }
+        if (dst) dst[len] = unescaped;
+        ++len;
+    }
+    j->p = close + 1;
+    if (dst) {
+        dst[len] = '\0';
+        *out = dst;
+    }
+    if (out_len) *out_len = len;
+    return true;
+}
+
+static bool nvc_json_skip(nvc_json_t* j, uint32_t depth);
+
+// skips the elements of an object or array, j->p is after the bracket
+static bool nvc_json_skip_members(nvc_json_t* j,
+                                  char close,
+                                  uint32_t depth) {
+    nvc_json_ws(j);
+    if (j->p < j->end && *j->p == close) {
+        ++j->p;
+        return true;
+    }
+    for (;;) {
+        if (close == '}') {
+            nvc_json_ws(j);
+            if (!nvc_json_string(j, NULL, NULL)) return false;
+            nvc_json_ws(j);
+            if (j->p >= j->end || *j->p != ':')
+                return nvc_json_fail(j, "expected ':'");
+            ++j->p;
+        }
+        if (!nvc_json_skip(j, depth + 1)) return false;
+        nvc_json_ws(j);
+        if (j->p < j->end && *j->p == ',') {
+            ++j->p;
+            continue;
+        }
+        if (j->p < j->end && *j->p == close) {
+            ++j->p;
+            return true;
+        }
+        return nvc_json_fail(j, "expected ',' or a closing bracket");
+    }
+}
+
+static bool nvc_json_skip(nvc_json_t* j, uint32_t depth) {
+    if (depth > NVC_JSON_MAX_DEPTH) return nvc_json_fail(j, "nested too deep");
+    nvc_json_ws(j);
+    if (j->p >= j->end) return nvc_json_fail(j, "expected a value");
+    switch (*j->p) {
+        case '"': return nvc_json_string(j, NULL, NULL);
+        case '{': ++j->p; return nvc_json_skip_members(j, '}', depth);
+        case '[': ++j->p; return nvc_json_skip_members(j, ']', depth);
+    }
+    static const char* const literals[] = {"true", "false", "null"};
+    for (size_t i = 0; i < 3; ++i) {
+        size_t n = strlen(literals[i]);
+        if ((size_t)(j->end - j->p) >= n && memcmp(j->p, literals[i], n) == 0) {
+            j->p += n;
+            return true;
+        }
+    }
+    // note: numbers are only skipped, so any run of number chars will do
+    const char* begin = j->p;
+    while (j->p < j->end && (strchr("+-.eE", *j->p) ||
+                             (*j->p >= '0' && *j->p <= '9')))
+        ++j->p;
+    if (j->p == begin) return nvc_json_fail(j, "expected a value");
+    return true;
+}
+
+static bool nvc_batch_parse_outputs(nvc_json_t* j, uint32_t* outputs) {
+    nvc_json_ws(j);
+    if (j->p >= j->end || *j->p != '[')
+        return nvc_json_fail(j, "outputs must be an array");
+    ++j->p;
+    nvc_json_ws(j);
+    if (j->p < j->end && *j->p == ']') {
+        ++j->p;
+        return true;
+    }
+    for (;;) {
+        char* output;
+        nvc_json_ws(j);
+        if (!nvc_json_string(j, &output, NULL)) return false;
+        if (strcmp(output, "tokens") == 0)
+            *outputs |= NVC_BATCH_OUTPUT_TOKENS;
+        else if (strcmp(output, "ast") == 0)
+            *outputs |= NVC_BATCH_OUTPUT_AST;
+        else if (strcmp(output, "ir") == 0)
+            *outputs |= NVC_BATCH_OUTPUT_IR;
+        else
+            return nvc_json_fail(j, "unknown output");
+        nvc_json_ws(j);
+        if (j->p < j->end && *j->p == ',') {
+            ++j->p;
+            continue;
+        }
+        if (j->p < j->end && *j->p == ']') {
+            ++j->p;
+            return true;
+        }
+        return nvc_json_fail(j, "expected ',' or ']'");
+    }
+}
+
+static bool nvc_batch_parse_request(nvc_json_t* j, nvc_batch_request_t* req) {
+    nvc_json_ws(j);
+    if (j->p >= j->end || *j->p != '{')
+        return nvc_json_fail(j, "a request must be an object");
+    ++j->p;
+    nvc_json_ws(j);
+    bool empty = j->p < j->end && *j->p == '}';
+    if (empty) ++j->p;
+    while (!empty) {
+        char* key;
+        nvc_json_ws(j);
+        if (!nvc_json_string(j, &key, NULL)) return false;
+        nvc_json_ws(j);
+        if (j->p >= j->end || *j->p != ':')
+            return nvc_json_fail(j, "expected ':'");
+        ++j->p;
+        nvc_json_ws(j);
+        bool parsed;
+        if (strcmp(key, "id") == 0) {
+            req->id = j->p;
+            parsed = nvc_json_skip(j, 1);
+            req->id_len = j->p - req->id;
+        } else if (strcmp(key, "name") == 0) {
+            parsed = nvc_json_string(j, &req->name, NULL);
+        } else if (strcmp(key, "source") == 0) {
+            parsed = nvc_json_string(j, &req->source, &req->source_len);
+        } else if (strcmp(key, "outputs") == 0) {
+            parsed = nvc_batch_parse_outputs(j, &req->outputs);
+        } else {
+            // note: unknown members are ignored for forward compatibility
+            parsed = nvc_json_skip(j, 1);
+        }
+        if (!parsed) return false;
+        nvc_json_ws(j);
+        if (j->p < j->end && *j->p == ',') {
+            ++j->p;
+            continue;
+        }
+        if (j->p < j->end && *j->p == '}') {
+            ++j->p;
+            break;
+        }
+        return nvc_json_fail(j, "expected ',' or '}'");
+    }
+    nvc_json_ws(j);
+    if (j->p != j->end) return nvc_json_fail(j, "trailing characters");
+    if (!req->source) return nvc_json_fail(j, "missing source");
+    return true;
+}
+
+// appends "key":"<what print writes>" using a memory stream
+static void nvc_batch_print_output(nvc_batch_buf_t* buf,
+                                   const char* key,
+                                   void (*print)(FILE*, void*),
+                                   void* arg) {
+    char* text = NULL;
+    size_t len = 0;
+    FILE* stream = open_memstream(&text, &len);
+    if (!stream) {
+        buf->failed = true;
+        return;
+    }
+    print(stream, arg);
+    if (fclose(stream) != 0) buf->failed = true;
+    nvc_batch_printf(buf, ",\"%s\":", key);
+    if (text) nvc_batch_json_string(buf, text, len);
+    // note: open_memstream allocates with libc
+    free(text);
+}
+
+static void nvc_batch_print_tokens(FILE* out, void* arg) {
+    nvc_token_stream_t* stream = arg;
+    for (uint32_t i = 0; i < stream->size; ++i) {
+        char* tokstr = nvc_token_to_str(stream->allocator, stream->tokens + i);
+        if (!tokstr) break;
+        fprintf(out, i ? " %s" : "%s", tokstr);
+        nvc_free(stream->allocator, tokstr);
+    }
+}
+
+static void nvc_batch_print_ast(FILE* out, void* arg) {
+    nvc_print_ast(out, arg);
+}
+
+static void nvc_batch_print_ir(FILE* out, void* arg) { nvc_print_ir(out, arg); }
+
+static void nvc_batch_print_diagnostics(nvc_batch_buf_t* buf,
+                                        const nvc_diagnostics_t* diags) {
+    nvc_batch_printf(buf, ",\"errors\":%u,\"warnings\":%u", diags->n_errors,
+                     diags->n_warnings);
+    if (diags->n_suppressed)
+        nvc_batch_printf(buf, ",\"suppressed\":%u", diags->n_suppressed);
+    nvc_batch_puts(buf, ",\"diagnostics\":[");
+    for (uint32_t i = 0; i < diags->size; ++i) {
+        const nvc_diagnostic_t* diag = diags->diags + i;
+        nvc_batch_printf(buf, "%s{\"severity\":\"%s\"", i ? "," : "",
+                         nvc_severity_to_str(diag->severity));
+        // note: 1-indexed lines and the same columns as printed diagnostics
+        if (diag->has_loc)
+            nvc_batch_printf(buf, ",\"line\":%u,\"column\":%u",
+                             diag->loc.l + 1, diag->loc.c);
+        nvc_batch_puts(buf, ",\"message\":");
+        nvc_batch_json_string(buf, diag->msg, strlen(diag->msg));
+        nvc_batch_puts(buf, "}");
+    }
+    nvc_batch_puts(buf, "]");
+}
+
+// compiles the request in slot and renders its result line
+static void nvc_batch_process(nvc_batch_worker_t* worker,
+                              nvc_batch_slot_t* slot) {
+    nvc_batch_buf_t* buf = &slot->result;
+    buf->size = 0;
+    buf->failed = false;
+    nvc_arena_reset(&worker->arena);
+
+    nvc_batch_request_t req = {0};
+    nvc_json_t j = {
+        .p = slot->line,
+        .end = slot->line + slot->line_len,
+        .allocator = nvc_arena_allocator(&worker->arena),
+    };
+    if (!nvc_batch_parse_request(&j, &req)) {
+        nvc_batch_puts(buf, "{\"id\":");
+        if (req.id && req.id_len)
+            nvc_batch_append(buf, req.id, req.id_len);
+        else
+            nvc_batch_puts(buf, "null");
+        nvc_batch_puts(buf, ",\"ok\":false,\"error\":");
+        const char* error = j.error ? j.error : "invalid request";
+        char msg[128];
+        snprintf(msg, sizeof(msg), "invalid request: %s at offset %ld", error,
+                 (long)(j.p - slot->line));
+        nvc_batch_json_string(buf, msg, strlen(msg));
+        nvc_batch_puts(buf, "}\n");
+        slot->ok = false;
+        return;
+    }
+
+    nvc_context_t* ctx = worker->ctx;
+    nvc_perf_span_t span;
+    nvc_perf_begin(&span, ctx->profile, NVC_PHASE_READ);
+    nvc_perf_add_bytes(ctx->profile, req.source_len);
+    nvc_perf_end(&span);
+    char* name = req.name ? req.name : "<batch>";
+    int result = nvc_compile_buffer(ctx, name, req.source, req.source_len);
+    slot->ok = result == 0;
+
+    nvc_batch_puts(buf, "{\"id\":");
+    if (req.id)
+        nvc_batch_append(buf, req.id, req.id_len);
+    else
+        nvc_batch_puts(buf, "null");
+    nvc_batch_puts(buf, slot->ok ? ",\"ok\":true" : ",\"ok\":false");
+    nvc_batch_print_diagnostics(buf, &ctx->diagnostics);
+    if ((req.outputs & NVC_BATCH_OUTPUT_TOKENS) && ctx->tokens)
+        nvc_batch_print_output(buf, "tokens", nvc_batch_print_tokens,
+                               ctx->tokens);
+    if ((req.outputs & NVC_BATCH_OUTPUT_AST) && ctx->ast)
+        nvc_batch_print_output(buf, "ast", nvc_batch_print_ast, ctx->ast);
+    if ((req.outputs & NVC_BATCH_OUTPUT_IR) && ctx->ir)
+        nvc_batch_print_output(buf, "ir", nvc_batch_print_ir, ctx->ir);
+    nvc_batch_puts(buf, "}\n");
+}
+
+static nvc_batch_slot_t* nvc_batch_slot(nvc_batch_t* batch, uint64_t n) {
+    return batch->slots + n % batch->n_slots;
+}
+
+// writes every finished result that is next in order
+// note: lock must be held, it is released while writing. only one thread
+// writes at a time so the results can not overtake each other
+static void nvc_batch_flush(nvc_batch_t* batch) {
+    if (batch->writing) return;
+    batch->writing = true;
+    bool wrote = false;
+    for (;;) {
+        nvc_batch_slot_t* slot = nvc_batch_slot(batch, batch->n_written);
+        if (batch->n_written == batch->n_taken ||
+            slot->state != NVC_SLOT_DONE)
+            break;
+        pthread_mutex_unlock(&batch->lock);
+        if (slot->result.failed)
+            fputs("{\"id\":null,\"ok\":false,\"error\":\"out of memory\"}\n",
+                  batch->out);
+        else
+            fwrite(slot->result.data, 1, slot->result.size, batch->out);
+        pthread_mutex_lock(&batch->lock);
+        if (!slot->ok || slot->result.failed) batch->failed = true;
+        slot->state = NVC_SLOT_FREE;
+        ++batch->n_written;
+        wrote = true;
+        pthread_cond_signal(&batch->space);
+    }
+    batch->writing = false;
+    // note: flushed once per run of results so a consumer reading the
+    // output as a stream sees every result as soon as it can be written
+    if (wrote) {
+        pthread_mutex_unlock(&batch->lock);
+        fflush(batch->out);
+        pthread_mutex_lock(&batch->lock);
+        // a result may have finished while this thread was flushing
+        nvc_batch_flush(batch);
+    }
+}
+
+// takes the next queued request, compiles it and writes what is ready
+// note: lock must be held
+static void nvc_batch_run_next(nvc_batch_worker_t* worker) {
+    nvc_batch_t* batch = worker->batch;
+    nvc_batch_slot_t* slot = nvc_batch_slot(batch, batch->n_taken++);
+    pthread_mutex_unlock(&batch->lock);
+    nvc_batch_process(worker, slot);
+    pthread_mutex_lock(&batch->lock);
+    slot->state = NVC_SLOT_DONE;
+    nvc_batch_flush(batch);
+}
+
+static bool nvc_batch_worker_init(nvc_batch_worker_t* worker,
+                                  nvc_batch_t* batch) {
+    worker->batch = batch;
+    worker->ctx = nvc_context_create(batch->allocator);
+    if (!worker->ctx) return false;
+    const nvc_compile_options_t* options = batch->options;
+    if (options) {
+        worker->ctx->parse_options = options->parse;
+        worker->ctx->diagnostics.max_errors = options->max_errors;
+        worker->ctx->opt_level = options->opt_level;
+    }
+    worker->ctx->profile = batch->profile;
+    nvc_arena_init(&worker->arena, batch->allocator, 0);
+    return true;
+}
+
+static void nvc_batch_worker_free(nvc_batch_worker_t* worker) {
+    nvc_context_destroy(worker->ctx);
+    nvc_arena_destroy(&worker->arena);
+}
+
+static void* nvc_batch_worker_main(void* arg) {
+    nvc_batch_worker_t* worker = arg;
+    nvc_batch_t* batch = worker->batch;
+    pthread_mutex_lock(&batch->lock);
+    for (;;) {
+        while (batch->n_taken == batch->n_read && !batch->eof)
+            pthread_cond_wait(&batch->work, &batch->lock);
+        if (batch->n_taken == batch->n_read) break;
+        nvc_batch_run_next(worker);
+    }
+    pthread_mutex_unlock(&batch->lock);
+    return NULL;
+}
+
+int nvc_batch(nvc_allocator_t* allocator,
+              FILE* in,
+              FILE* out,
+              const nvc_compile_options_t* options) {
+    if (!allocator) allocator = nvc_default_allocator();
+    uint32_t n_jobs = options ? options->n_jobs : 0;
+    if (!n_jobs) {
+        long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        n_jobs = n_cpus > 0 ? (uint32_t)n_cpus : 1;
+    }
+
+    nvc_batch_t batch = {
+        .allocator = allocator,
+        .options = options,
+        .out = out,
+        .n_slots = n_jobs * NVC_BATCH_WINDOW_PER_JOB,
+    };
+    nvc_perf_profile_t profile;
+    if (options && options->perf_counters) {
+        nvc_perf_profile_init(&profile);
+        batch.profile = &profile;
+    }
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_cond_init(&batch.work, NULL);
+    pthread_cond_init(&batch.space, NULL);
+    int result = 1;
+    uint32_t n_workers = 0;
+    nvc_batch_worker_t* workers =
+        nvc_calloc(allocator, n_jobs, sizeof(nvc_batch_worker_t));
+    pthread_t* threads = nvc_calloc(allocator, n_jobs, sizeof(pthread_t));
+    batch.slots =
+        nvc_calloc(allocator, batch.n_slots, sizeof(nvc_batch_slot_t));
+    if (!workers || !threads || !batch.slots) goto out_of_memory;
+    for (uint32_t i = 0; i < batch.n_slots; ++i)
+        batch.slots[i].result.allocator = allocator;
+    // note: the first worker is always set up, the reader runs requests on
+    // it itself when no thread can be started
+    if (!nvc_batch_worker_init(workers, &batch)) goto out_of_memory;
+    uint32_t n_ready = 1;
+    for (uint32_t i = 0; i < n_jobs; ++i) {
+        if (i && !nvc_batch_worker_init(workers + i, &batch)) break;
+        n_ready = i + 1;
+        if (pthread_create(threads + i, NULL, nvc_batch_worker_main,
+                           workers + i) != 0)
+            break;
+        ++n_workers;
+    }
+
+    bool read_error = false;
+    for (;;) {
+        pthread_mutex_lock(&batch.lock);
+        while (batch.n_read - batch.n_written >= batch.n_slots)
+            pthread_cond_wait(&batch.space, &batch.lock);
+        pthread_mutex_unlock(&batch.lock);
+
+        // note: the slot is free so no other thread looks at it
+        nvc_batch_slot_t* slot = nvc_batch_slot(&batch, batch.n_read);
+        ssize_t len = getline(&slot->line, &slot->line_capacity, in);
+        if (len < 0) {
+            read_error = ferror(in);
+            break;
+        }
+        while (len && (slot->line[len - 1] == '\n' ||
+                       slot->line[len - 1] == '\r'))
+            --len;
+        size_t blank = 0;
+        while (blank < (size_t)len &&
+               (slot->line[blank] == ' ' || slot->line[blank] == '\t'))
+            ++blank;
+        if (blank == (size_t)len) continue;
+        slot->line_len = len;
+
+        pthread_mutex_lock(&batch.lock);
+        slot->state = NVC_SLOT_QUEUED;
+        ++batch.n_read;
+        if (n_workers)
+            pthread_cond_signal(&batch.work);
+        else
+            nvc_batch_run_next(workers);
+        pthread_mutex_unlock(&batch.lock);
+    }
+
+    pthread_mutex_lock(&batch.lock);
+    batch.eof = true;
+    pthread_cond_broadcast(&batch.work);
+    pthread_mutex_unlock(&batch.lock);
+    for (uint32_t i = 0; i < n_workers; ++i) pthread_join(threads[i], NULL);
+    for (uint32_t i = 0; i < n_ready; ++i) nvc_batch_worker_free(workers + i);
+    if (read_error) fprintf(stderr, "Unable to read the batch input.\n");
+    result = batch.failed || read_error;
+    if (batch.profile) nvc_perf_print(stderr, batch.profile);
+    goto out;
+
+out_of_memory:
+    fprintf(stderr, "Out of memory!\n");
+    if (workers && workers[0].ctx) nvc_batch_worker_free(workers);
+out:
+    if (batch.slots) {
+        for (uint32_t i = 0; i < batch.n_slots; ++i) {
+            // note: getline allocates with libc
+            free(batch.slots[i].line);
+            nvc_free(allocator, batch.slots[i].result.data);
+        }
+    }
+    nvc_free(allocator, batch.slots);
+    nvc_free(allocator, threads);
+    nvc_free(allocator, workers);
+    pthread_cond_destroy(&batch.space);
+    pthread_cond_destroy(&batch.work);
+    pthread_mutex_destroy(&batch.lock);
+    if (batch.profile) nvc_perf_profile_free(&profile);
+    return result;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,328 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nvc_bigint.h>
+
+#include <string.h>
+
+typedef unsigned __int128 nvc_u128;
+
+// limbs without the leading zero ones
+static uint32_t nvc_mag_length(const uint64_t* limbs, uint32_t n) {
+    while (n && !limbs[n - 1]) --n;
+    return n;
+}
+
+static int nvc_mag_compare(const uint64_t* lhs,
+                           uint32_t n_lhs,
+                           const uint64_t* rhs,
+                           uint32_t n_rhs) {
+    if (n_lhs != n_rhs) return n_lhs < n_rhs ? -1 : 1;
+    for (uint32_t i = n_lhs; i--;) {
+        if (lhs[i] != rhs[i]) return lhs[i] < rhs[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+// out = lhs + rhs with n_lhs >= n_rhs, out needs n_lhs + 1 limbs
+// note: every limb is read before out overwrites it so out may be either
+static uint32_t nvc_mag_add(uint64_t* out,
+                            const uint64_t* lhs,
+                            uint32_t n_lhs,
+                            const uint64_t* rhs,
+                            uint32_t n_rhs) {
+    uint64_t carry = 0;
+    for (uint32_t i = 0; i < n_lhs; ++i) {
+        uint64_t x = lhs[i], y = i < n_rhs ? rhs[i] : 0;
+        uint64_t sum = x + y;
+        uint64_t total = sum + carry;
+        carry = (sum < x) | (total < sum);
+        out[i] = total;
+    }
+    out[n_lhs] = carry;
+    return n_lhs + (uint32_t)carry;
+}
+
+// out = lhs - rhs with lhs >= rhs, out needs n_lhs limbs
+static uint32_t nvc_mag_sub(uint64_t* out,
+                            const uint64_t* lhs,
+                            uint32_t n_lhs,
+                            const uint64_t* rhs,
+                            uint32_t n_rhs) {
+    uint64_t borrow = 0;
+    for (uint32_t i = 0; i < n_lhs; ++i) {
+        uint64_t x = lhs[i], y = i < n_rhs ? rhs[i] : 0;
+        uint64_t diff = x - y;
+        uint64_t total = diff - borrow;
+        borrow = (x < y) | (diff < borrow);
+        out[i] = total;
+    }
+    return nvc_mag_length(out, n_lhs);
+}
+
+static void nvc_bigint_finish(nvc_bigint_t* out,
+                              uint32_t n_limbs,
+                              uint32_t negative) {
+    out->n_limbs = n_limbs;
+    out->negative = n_limbs ? negative : 0;
+}
+
+void nvc_bigint_set_i64(nvc_bigint_t* out, int64_t value) {
+    uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+    out->limbs[0] = magnitude;
+    nvc_bigint_finish(out, magnitude != 0, value < 0);
+}
+
+bool nvc_bigint_get_i64(const nvc_bigint_t* value, int64_t* out) {
+    if (value->n_limbs > 1) return false;
+    uint64_t magnitude = value->n_limbs ? value->limbs[0] : 0;
+    if (value->negative) {
+        if (magnitude > (uint64_t)1 << 63) return false;
+        *out = (int64_t)(0 - magnitude);
+    } else {
+        if (magnitude > INT64_MAX) return false;
+        *out = (int64_t)magnitude;
+    }
+    return true;
+}
+
+int nvc_bigint_compare(const nvc_bigint_t* lhs, const nvc_bigint_t* rhs) {
+    if (lhs->negative != rhs->negative) return lhs->negative ? -1 : 1;
+    int order = nvc_mag_compare(lhs->limbs, lhs->n_limbs, rhs->limbs,
+                                rhs->n_limbs);
+    return lhs->negative ? -order : order;
+}
+
+double nvc_bigint_to_fp(const nvc_bigint_t* value) {
+    double fp = 0;
+    for (uint32_t i = value->n_limbs; i--;) {
+        fp = fp * 18446744073709551616.0 + (double)value->limbs[i];
+    }
+    return value->negative ? -fp : fp;
+}
+
+// lhs + rhs with the sign of rhs replaced by rhs_negative
+static void nvc_bigint_add_signed(nvc_bigint_t* out,
+                                  const nvc_bigint_t* lhs,
+                                  const nvc_bigint_t* rhs,
+                                  uint32_t rhs_negative) {
+    uint32_t n_lhs = lhs->n_limbs, n_rhs = rhs->n_limbs;
+    uint32_t lhs_negative = lhs->negative;
+    if (lhs_negative == rhs_negative) {
+        uint32_t n = n_lhs >= n_rhs ? nvc_mag_add(out->limbs, lhs->limbs,
+                                                  n_lhs, rhs->limbs, n_rhs)
+                                    : nvc_mag_add(out->limbs, rhs->limbs,
+                                                  n_rhs, lhs->limbs, n_lhs);
+        nvc_bigint_finish(out, n, lhs_negative);
+    } else if (nvc_mag_compare(lhs->limbs, n_lhs, rhs->limbs, n_rhs) >= 0) {
+        uint32_t n =
+            nvc_mag_sub(out->limbs, lhs->limbs, n_lhs, rhs->limbs, n_rhs);
+        nvc_bigint_finish(out, n, lhs_negative);
+    } else {
+        uint32_t n =
+            nvc_mag_sub(out->limbs, rhs->limbs, n_rhs, lhs->limbs, n_lhs);
+        nvc_bigint_finish(out, n, rhs_negative);
+    }
+}
+
+void nvc_bigint_add(nvc_bigint_t* out,
+                    const nvc_bigint_t* lhs,
+                    const nvc_bigint_t* rhs) {
+    nvc_bigint_add_signed(out, lhs, rhs, rhs->negative);
+}
+
+void nvc_bigint_sub(nvc_bigint_t* out,
+                    const nvc_bigint_t* lhs,
+                    const nvc_bigint_t* rhs) {
+    nvc_bigint_add_signed(out, lhs, rhs, !rhs->negative);
+}
+
+void nvc_bigint_mul(nvc_bigint_t* out,
+                    const nvc_bigint_t* lhs,
+                    const nvc_bigint_t* rhs) {
+    uint32_t n_lhs = lhs->n_limbs, n_rhs = rhs->n_limbs;
+    memset(out->limbs, 0, ((size_t)n_lhs + n_rhs) * sizeof(uint64_t));
+    for (uint32_t i = 0; i < n_lhs; ++i) {
+        uint64_t carry = 0;
+        for (uint32_t j = 0; j < n_rhs; ++j) {
+            nvc_u128 t = (nvc_u128)lhs->limbs[i] * rhs->limbs[j] +
+                         out->limbs[i + j] + carry;
+            out->limbs[i + j] = (uint64_t)t;
+            carry = (uint64_t)(t >> 64);
+        }
+        out->limbs[i + n_rhs] = carry;
+    }
+    nvc_bigint_finish(out, nvc_mag_length(out->limbs, n_lhs + n_rhs),
+                      lhs->negative ^ rhs->negative);
+}
+
+void nvc_bigint_div(nvc_bigint_t* quotient,
+                    nvc_bigint_t* remainder,
+                    const nvc_bigint_t* lhs,
+                    const nvc_bigint_t* rhs) {
+    uint32_t n_lhs = lhs->n_limbs, n_rhs = rhs->n_limbs;
+    uint64_t* q = quotient->limbs;
+    uint64_t* r = remainder->limbs;
+    memset(q, 0, (size_t)n_lhs * sizeof(uint64_t));
+    uint32_t n_r = 0;
+    if (n_rhs == 1) {
+        // note: one limb divisors are the common case, a limb at a time
+        uint64_t divisor = rhs->limbs[0], rem = 0;
+        for (uint32_t i = n_lhs; i--;) {
+            nvc_u128 t = (nvc_u128)rem << 64 | lhs->limbs[i];
+            q[i] = (uint64_t)(t / divisor);
+            rem = (uint64_t)(t % divisor);
+        }
+        r[0] = rem;
+        n_r = rem != 0;
+    } else {
+        // shift and subtract a bit at a time
+        for (uint64_t bit = (uint64_t)n_lhs * 64; bit--;) {
+            uint64_t carry = (lhs->limbs[bit / 64] >> (bit % 64)) & 1;
+            for (uint32_t k = 0; k < n_r; ++k) {
+                uint64_t top = r[k] >> 63;
+                r[k] = r[k] << 1 | carry;
+                carry = top;
+            }
+            if (carry) r[n_r++] = carry;
+            if (nvc_mag_compare(r, n_r, rhs->limbs, n_rhs) >= 0) {
+                n_r = nvc_mag_sub(r, r, n_r, rhs->limbs, n_rhs);
+                q[bit / 64] |= (uint64_t)1 << (bit % 64);
+            }
+        }
+    }
+    nvc_bigint_finish(quotient, nvc_mag_length(q, n_lhs),
+                      lhs->negative ^ rhs->negative);
+    nvc_bigint_finish(remainder, n_r, lhs->negative);
+}
+
+void nvc_bigint_neg(nvc_bigint_t* out, const nvc_bigint_t* value) {
+    uint32_t n = value->n_limbs;
+    uint32_t negative = !value->negative;
+    memmove(out->limbs, value->limbs, (size_t)n * sizeof(uint64_t));
+    nvc_bigint_finish(out, n, negative);
+}
+
+void nvc_bigint_not(nvc_bigint_t* out, const nvc_bigint_t* value) {
+    static const uint64_t one = 1;
+    uint32_t n = value->n_limbs;
+    // ~x is -(x + 1) for x >= 0 and |x| - 1 otherwise
+    if (value->negative) {
+        uint32_t n_out = nvc_mag_sub(out->limbs, value->limbs, n, &one, 1);
+        nvc_bigint_finish(out, n_out, 0);
+    } else if (n) {
+        uint32_t n_out = nvc_mag_add(out->limbs, value->limbs, n, &one, 1);
+        nvc_bigint_finish(out, n_out, 1);
+    } else {
+        nvc_bigint_set_i64(out, -1);
+    }
+}
+
+uint64_t nvc_bigint_pow_limbs(const nvc_bigint_t* base, uint64_t exponent) {
+    uint32_t n = base->n_limbs;
+    uint64_t bits =
+        n ? (uint64_t)(n - 1) * 64 + 64 - __builtin_clzll(base->limbs[n - 1])
+          : 0;
+    if (bits && exponent > (UINT64_MAX - 128) / bits) return UINT64_MAX;
+    // note: + 2 covers the product of two partial results, see below
+    return bits * exponent / 64 + 2;
+}
+
+void nvc_bigint_pow(nvc_bigint_t* out,
+                    nvc_bigint_t* scratch,
+                    const nvc_bigint_t* base,
+                    uint64_t exponent) {
+    // note: squares from the top bit down, the partial result moves between
+    // out and scratch since a product can not be written over an operand
+    nvc_bigint_t* result = out;
+    nvc_bigint_t* other = scratch;
+    nvc_bigint_set_i64(result, 1);
+    bool started = false;
+    for (int bit = 63; bit >= 0; --bit) {
+        if (started) {
+            nvc_bigint_mul(other, result, result);
+            nvc_bigint_t* t = result;
+            result = other;
+            other = t;
+        }
+        if ((exponent >> bit) & 1) {
+            started = true;
+            nvc_bigint_mul(other, result, base);
+            nvc_bigint_t* t = result;
+            result = other;
+            other = t;
+        }
+    }
+    if (result != out) {
+        memcpy(out->limbs, result->limbs,
+               (size_t)result->n_limbs * sizeof(uint64_t));
+        nvc_bigint_finish(out, result->n_limbs, result->negative);
+    }
+}
+
+uint32_t nvc_bigint_parse_limbs(size_t n_digits, uint32_t radix) {
+    // note: a decimal digit takes less than 4 bits
+    uint64_t bits = (uint64_t)n_digits * (radix == 2 ? 1 : 4);
+    return (uint32_t)(bits / 64 + 1);
+}
+
+void nvc_bigint_parse(nvc_bigint_t* out,
+                      const char* digits,
+                      size_t n_digits,
+                      uint32_t radix) {
+    uint32_t n = 0;
+    for (size_t i = 0; i < n_digits; ++i) {
+        char c = digits[i];
+        uint64_t carry = c >= '0' && c <= '9'
+                             ? (uint64_t)(c - '0')
+                             : (uint64_t)((c | 0x20) - 'a' + 10);
+        for (uint32_t k = 0; k < n; ++k) {
+            nvc_u128 t = (nvc_u128)out->limbs[k] * radix + carry;
+            out->limbs[k] = (uint64_t)t;
+            carry = (uint64_t)(t >> 64);
+        }
+        if (carry) out->limbs[n++] = carry;
+    }
+    nvc_bigint_finish(out, n, 0);
+}
+
+size_t nvc_bigint_str_size(const nvc_bigint_t* value) {
+    // note: 2^64 has 20 decimal digits, the other 8 bytes per limb hold the
+    // limbs while they are divided, see below
+    return (size_t)value->n_limbs * 28 + 24;
+}
+
+void nvc_bigint_to_str(const nvc_bigint_t* value, char* str) {
+    static const uint64_t chunk = 10000000000000000000ULL;  // 10^19
+    char* end = str + nvc_bigint_str_size(value) - 1;
+    char* pos = end;
+    *pos = '\0';
+    // note: the limbs being divided live at the start of str and the digits
+    // are written backwards from its end, str has room for all of both
+    uint32_t n = value->n_limbs;
+    memcpy(str, value->limbs, (size_t)n * sizeof(uint64_t));
+    while (n) {
+        uint64_t rem = 0;
+        for (uint32_t i = n; i--;) {
+            uint64_t limb;
+            memcpy(&limb, str + i * sizeof(uint64_t), sizeof(limb));
+            nvc_u128 t = (nvc_u128)rem << 64 | limb;
+            limb = (uint64_t)(t / chunk);
+            rem = (uint64_t)(t % chunk);
+            memcpy(str + i * sizeof(uint64_t), &limb, sizeof(limb));
+            if (!limb && i + 1 == n) --n;
+        }
+        for (int d = 0; d < 19 && (n || rem); ++d) {
+            *--pos = (char)('0' + rem % 10);
+            rem /= 10;
+        }
+    }
+    if (pos == end) *--pos = '0';
+    if (value->negative) *--pos = '-';
+    memmove(str, pos, (size_t)(end - pos) + 1);
+}
+
+#ifdef __cplusplus
+}
+#endif
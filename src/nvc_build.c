@@ -0,0 +1,767 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nvc_build.h>
+
+#include <limits.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// note: a job is a module index, what is done with it depends on the phase.
+// the main thread runs jobs too while it waits so a build makes progress even
+// when no worker thread could be started
+typedef struct {
+    nvc_build_t* build;
+    nvc_build_options_t options;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;  // signalled when a job is queued, the last
+                          // outstanding job finishes or workers must stop
+    uint32_t* queue;
+    uint32_t queue_head, queue_size, queue_capacity;
+    uint32_t n_outstanding;  // queued and running jobs
+    bool resolving;          // false while parsing, true while resolving
+    bool stop;
+    nvc_symtab_t by_key;  // module key -> index into build->modules
+    nvc_reader_t reader;
+    bool reading;  // the reader runs, modules are parsed once it read them
+} nvc_scheduler_t;
+
+// note: lock must be held
+static bool nvc_schedule(nvc_scheduler_t* sched, uint32_t module) {
+    // dynamic allocation
+    if (sched->queue_size >= sched->queue_capacity) {
+        uint32_t capacity =
+            sched->queue_capacity ? sched->queue_capacity * 2 : 16;
+        uint32_t* grown = nvc_realloc(sched->build->allocator, sched->queue,
+                                      capacity * sizeof(uint32_t));
+        if (!grown) return false;
+        sched->queue = grown;
+        sched->queue_capacity = capacity;
+    }
+    sched->queue[sched->queue_size++] = module;
+    ++sched->n_outstanding;
+    pthread_cond_broadcast(&sched->cond);
+    return true;
+}
+
+// nanoseconds since the epoch of the last change of st
+static int64_t nvc_mtime_ns(const struct stat* st) {
+    return (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+}
+
+// the entry of key in cache, created when missing
+static nvc_cached_module_t* nvc_cache_entry(nvc_module_cache_t* cache,
+                                            const char* key) {
+    nvc_allocator_t* allocator = cache->allocator;
+    uint32_t index = nvc_symtab_lookup(&cache->by_key, key);
+    if (index != NVC_SYMTAB_NONE) return cache->modules[index];
+    // dynamic allocation
+    if (cache->n_modules >= cache->capacity) {
+        uint32_t capacity = cache->capacity ? cache->capacity * 2 : 16;
+        nvc_cached_module_t** grown =
+            nvc_realloc(allocator, cache->modules,
+                        capacity * sizeof(nvc_cached_module_t*));
+        if (!grown) return NULL;
+        cache->modules = grown;
+        cache->capacity = capacity;
+    }
+    nvc_cached_module_t* cached =
+        nvc_calloc(allocator, 1, sizeof(nvc_cached_module_t));
+    if (!cached) return NULL;
+    cached->key = nvc_strndup(allocator, key, strlen(key));
+    cached->ctx = nvc_context_create(allocator);
+    if (!cached->key || !cached->ctx ||
+        !nvc_symtab_bind(&cache->by_key, cached->key, cache->n_modules)) {
+        nvc_context_destroy(cached->ctx);
+        nvc_free(allocator, cached->key);
+        nvc_free(allocator, cached);
+        return NULL;
+    }
+    cache->modules[cache->n_modules++] = cached;
+    return cached;
+}
+
+// gives module the path, buf and ctx the cache keeps for key. the results
+// of a previous build are reused when the file did not change since, else
+// they are dropped and the module is read and parsed again
+// note: lock must be held, returns false when out of memory
+static bool nvc_use_cache(nvc_scheduler_t* sched,
+                          nvc_module_t* module,
+                          const char* path,
+                          const char* key) {
+    nvc_module_cache_t* cache = sched->options.cache;
+    nvc_cached_module_t* cached = nvc_cache_entry(cache, key);
+    if (!cached) return false;
+    struct stat st;
+    bool exists = stat(key, &st) == 0;
+    if (exists && cached->parsed && !cached->stale &&
+        cached->size == (uint64_t)st.st_size &&
+        cached->mtime_ns == nvc_mtime_ns(&st)) {
+        module->cached = cached;
+        module->path = cached->path;
+        module->ctx = cached->ctx;
+        module->buf = cached->buf;
+        module->bufsz = cached->bufsz;
+        module->status = NVC_SOURCE_OK;
+        module->loaded = true;
+        // note: resolving parses the lazy bodies it needs, a tree that was
+        // resolved has none left so only the source is reused then
+        module->reused = !sched->options.parse_options.lazy_bodies;
+        return true;
+    }
+
+    // note: the importers of this module that were resolved against the
+    // dropped sema are resolved again before they are used, see
+    // nvc_must_resolve
+    if (!cached->path || strcmp(cached->path, path) != 0) {
+        char* path_cpy = nvc_strndup(cache->allocator, path, strlen(path));
+        if (!path_cpy) return false;
+        nvc_free(cache->allocator, cached->path);
+        cached->path = path_cpy;
+    }
+    nvc_context_reset(cached->ctx);
+    nvc_free(cache->allocator, cached->buf);
+    cached->buf = NULL;
+    cached->bufsz = 0;
+    cached->parsed = false;
+    cached->stale = false;
+    // note: the times are taken before the read, a change during the read
+    // makes the next build read it again
+    cached->size = exists ? (uint64_t)st.st_size : 0;
+    cached->mtime_ns = exists ? nvc_mtime_ns(&st) : 0;
+    module->cached = cached;
+    module->path = cached->path;
+    module->ctx = cached->ctx;
+    return true;
+}
+
+// creates a module, key is owned by the module afterwards
+// note: lock must be held, returns NVC_MODULE_NONE when out of memory
+static uint32_t nvc_new_module(nvc_scheduler_t* sched,
+                               const char* path,
+                               char* key) {
+    nvc_build_t* build = sched->build;
+    nvc_allocator_t* allocator = build->allocator;
+    // dynamic allocation
+    if (build->n_modules >= build->capacity) {
+        uint32_t capacity = build->capacity ? build->capacity * 2 : 16;
+        nvc_module_t** grown = nvc_realloc(allocator, build->modules,
+                                           capacity * sizeof(nvc_module_t*));
+        if (!grown) goto out_of_memory;
+        build->modules = grown;
+        build->capacity = capacity;
+    }
+
+    nvc_module_t* module = nvc_calloc(allocator, 1, sizeof(nvc_module_t));
+    if (!module) goto out_of_memory;
+    if (sched->options.cache) {
+        if (!nvc_use_cache(sched, module, path, key)) {
+            nvc_free(allocator, module);
+            goto out_of_memory;
+        }
+    } else {
+        module->path = nvc_strndup(allocator, path, strlen(path));
+        module->ctx = nvc_context_create(allocator);
+    }
+    if (!module->path || !module->ctx) {
+        nvc_free(allocator, module->path);
+        nvc_context_destroy(module->ctx);
+        nvc_free(allocator, module);
+        goto out_of_memory;
+    }
+    module->key = key;
+    module->ctx->parse_options = sched->options.parse_options;
+    module->ctx->diagnostics.max_errors = sched->options.max_errors;
+    module->ctx->opt_level = sched->options.opt_level;
+    module->ctx->profile = sched->options.profile;
+
+    uint32_t index = build->n_modules;
+    // note: a module that can not be scheduled is still freed with the build,
+    // it is never parsed so importers see it as unavailable
+    build->modules[build->n_modules++] = module;
+    if (!nvc_symtab_bind(&sched->by_key, key, index)) return NVC_MODULE_NONE;
+    // note: a pending read counts as an outstanding job, its completion
+    // schedules the parse. without the reader the parse job reads the file
+    if (sched->reading && !module->loaded) {
+        ++sched->n_outstanding;
+        if (nvc_reader_submit(&sched->reader, module->path,
+                              (void*)(uintptr_t)index))
+            return index;
+        --sched->n_outstanding;
+    }
+    if (!nvc_schedule(sched, index)) return NVC_MODULE_NONE;
+    return index;
+out_of_memory:
+    nvc_free(allocator, key);
+    return NVC_MODULE_NONE;
+}
+
+// returns the canonical path of path allocated with allocator, NULL when the
+// file does not exist
+static char* nvc_module_key(nvc_allocator_t* allocator, const char* path) {
+    char* real = realpath(path, NULL);
+    if (!real) return NULL;
+    char* key = nvc_strndup(allocator, real, strlen(real));
+    free(real);
+    return key;
+}
+
+// finds or creates the module named by an import decl of importer
+static uint32_t nvc_discover_module(nvc_scheduler_t* sched,
+                                    nvc_module_t* importer,
+                                    nvc_ast_node_t* node) {
+    nvc_allocator_t* allocator = sched->build->allocator;
+    nvc_diagnostics_t* diags = &importer->ctx->diagnostics;
+    const char* module_name = node->import_decl.module;
+
+    // dir/ of the importer + a/b (for a.b) + .nv, archived modules may be
+    // compressed so .nv.gz and .nv.zst are tried next
+    static const char* const suffixes[] = {".nv", ".nv.gz", ".nv.zst"};
+    const char* slash = strrchr(importer->path, '/');
+    size_t dir_len = slash ? slash - importer->path + 1 : 0;
+    size_t name_len = strlen(module_name);
+    char* path = nvc_alloc(allocator, dir_len + name_len + 8);
+    if (!path) goto out_of_memory;
+    memcpy(path, importer->path, dir_len);
+    for (size_t i = 0; i < name_len; ++i)
+        path[dir_len + i] = module_name[i] == '.' ? '/' : module_name[i];
+
+    char* key = NULL;
+    for (size_t i = 0; !key && i < sizeof(suffixes) / sizeof(*suffixes);
+         ++i) {
+        strcpy(path + dir_len + name_len, suffixes[i]);
+        key = nvc_module_key(allocator, path);
+    }
+    if (!key) {
+        strcpy(path + dir_len + name_len, ".nv");
+        nvc_report(diags, NVC_SEVERITY_ERROR, &node->buf_loc,
+                   "module '%s' not found", module_name);
+        nvc_report(diags, NVC_SEVERITY_NOTE, NULL,
+                   "looked for '%s' and '%s.gz'/'%s.zst'", path, path, path);
+        nvc_free(allocator, path);
+        return NVC_MODULE_NONE;
+    }
+
+    pthread_mutex_lock(&sched->lock);
+    uint32_t index = nvc_symtab_lookup(&sched->by_key, key);
+    if (index == NVC_SYMTAB_NONE) {
+        index = nvc_new_module(sched, path, key);
+    } else {
+        nvc_free(allocator, key);
+    }
+    pthread_mutex_unlock(&sched->lock);
+    nvc_free(allocator, path);
+    if (index == NVC_MODULE_NONE) goto out_of_memory;
+    return index;
+out_of_memory:
+    nvc_report(diags, NVC_SEVERITY_ERROR, &node->buf_loc, "out of memory");
+    return NVC_MODULE_NONE;
+}
+
+// called by the reader when the source of a module is read, schedules its
+// parse
+static void nvc_module_loaded(void* ctx,
+                              void* file,
+                              char* buf,
+                              long bufsz,
+                              nvc_source_status_t status) {
+    nvc_scheduler_t* sched = ctx;
+    uint32_t index = (uint32_t)(uintptr_t)file;
+    nvc_perf_add_bytes(sched->options.profile, bufsz);
+    pthread_mutex_lock(&sched->lock);
+    nvc_module_t* module = sched->build->modules[index];
+    module->buf = buf;
+    module->bufsz = bufsz;
+    module->status = status;
+    module->loaded = true;
+    if (!nvc_schedule(sched, index))
+        nvc_report(&module->ctx->diagnostics, NVC_SEVERITY_ERROR, NULL,
+                   "out of memory");
+    // note: the read was outstanding, the parse is now if it was scheduled
+    if (--sched->n_outstanding == 0) pthread_cond_broadcast(&sched->cond);
+    pthread_mutex_unlock(&sched->lock);
+}
+
+static void nvc_discover_imports(nvc_scheduler_t* sched,
+                                 nvc_module_t* module);
+
+// lexes and parses a module and discovers the modules it imports
+static void nvc_parse_module(nvc_scheduler_t* sched, nvc_module_t* module) {
+    nvc_allocator_t* allocator = sched->build->allocator;
+    nvc_diagnostics_t* diags = &module->ctx->diagnostics;
+    nvc_source_status_t status = module->status;
+    if (module->reused) {
+        // note: what this build reports about the imports is added to what
+        // parsing reported, the diagnostics of the previous build are put
+        // back if it turns out the module does not have to be resolved
+        module->previous = *diags;
+        nvc_diagnostics_init(diags, allocator);
+        diags->max_errors = module->previous.max_errors;
+        if (!nvc_diagnostics_copy(diags, &module->ctx->parsed))
+            nvc_report(diags, NVC_SEVERITY_ERROR, NULL, "out of memory");
+        module->ctx->resolved = false;
+        nvc_discover_imports(sched, module);
+        return;
+    }
+    if (!module->loaded) {
+        nvc_perf_span_t span;
+        nvc_perf_begin(&span, sched->options.profile, NVC_PHASE_READ);
+        module->buf = nvc_read_source_file(allocator, module->path,
+                                           &module->bufsz, &status);
+        nvc_perf_end(&span);
+        nvc_perf_add_bytes(sched->options.profile, module->bufsz);
+    }
+    nvc_cached_module_t* cached = module->cached;
+    if (cached) {
+        cached->buf = module->buf;
+        cached->bufsz = module->bufsz;
+    }
+    if (!module->buf) {
+        nvc_report(diags, NVC_SEVERITY_ERROR, NULL,
+                   "unable to read file: %s (%s)", module->path,
+                   nvc_source_status_to_str(status));
+        return;
+    }
+    nvc_context_parse(module->ctx, module->path, module->buf, module->bufsz);
+    if (cached) cached->parsed = true;
+    nvc_discover_imports(sched, module);
+}
+
+// finds the modules the parsed module imports
+static void nvc_discover_imports(nvc_scheduler_t* sched,
+                                 nvc_module_t* module) {
+    nvc_allocator_t* allocator = sched->build->allocator;
+    nvc_diagnostics_t* diags = &module->ctx->diagnostics;
+    nvc_ast_t* ast = module->ctx->ast;
+    if (!ast || !ast->n_imports) return;
+    module->imports =
+        nvc_calloc(allocator, ast->n_imports, sizeof(nvc_module_import_t));
+    if (!module->imports) {
+        nvc_report(diags, NVC_SEVERITY_ERROR, NULL, "out of memory");
+        return;
+    }
+    module->n_imports = ast->n_imports;
+    for (uint32_t i = 0; i < ast->size; ++i) {
+        nvc_ast_node_t* node = ast->nodes[i];
+        if (node->kind != NVC_AST_NODE_IMPORT_DECL) continue;
+        nvc_module_import_t* import =
+            module->imports + node->import_decl.index;
+        import->node = node;
+        import->module = nvc_discover_module(sched, module, node);
+    }
+}
+
+// true when a reused module has to be resolved again: an import is not the
+// module it was resolved against, or was resolved again after it
+static bool nvc_must_resolve(const nvc_build_t* build,
+                             const nvc_module_t* module) {
+    const nvc_cached_module_t* cached = module->cached;
+    if (!cached->resolved || cached->n_imports != module->n_imports)
+        return true;
+    for (uint32_t i = 0; i < module->n_imports; ++i) {
+        uint32_t index = module->imports[i].module;
+        const nvc_cached_module_t* import =
+            index == NVC_MODULE_NONE ? NULL : build->modules[index]->cached;
+        if (import != cached->imports[i] ||
+            (import && import->resolved > cached->resolved))
+            return true;
+    }
+    return false;
+}
+
+// records what a cached module is resolved against by this build
+// note: returns false when out of memory
+static bool nvc_remember_imports(nvc_scheduler_t* sched,
+                                 nvc_module_t* module) {
+    nvc_build_t* build = sched->build;
+    nvc_cached_module_t* cached = module->cached;
+    cached->resolved = sched->options.cache->generation;
+    if (module->n_imports > cached->n_imports) {
+        nvc_cached_module_t** grown =
+            nvc_realloc(build->allocator, cached->imports,
+                        module->n_imports * sizeof(nvc_cached_module_t*));
+        if (!grown) {
+            cached->n_imports = 0;
+            return false;
+        }
+        cached->imports = grown;
+    }
+    cached->n_imports = module->n_imports;
+    for (uint32_t i = 0; i < module->n_imports; ++i) {
+        uint32_t index = module->imports[i].module;
+        cached->imports[i] =
+            index == NVC_MODULE_NONE ? NULL : build->modules[index]->cached;
+    }
+    return true;
+}
+
+// resolves a module against its imports, every import is resolved already
+static void nvc_resolve_module(nvc_scheduler_t* sched, nvc_module_t* module) {
+    nvc_build_t* build = sched->build;
+    nvc_cached_module_t* cached = module->cached;
+    if (module->reused) {
+        nvc_diagnostics_t* diags = &module->ctx->diagnostics;
+        if (!nvc_must_resolve(build, module)) {
+            nvc_diagnostics_free(diags);
+            *diags = module->previous;
+            nvc_diagnostics_init(&module->previous, build->allocator);
+            module->ctx->resolved = true;
+            return;
+        }
+        nvc_diagnostics_free(&module->previous);
+    }
+    if (cached && !nvc_remember_imports(sched, module)) {
+        nvc_report(&module->ctx->diagnostics, NVC_SEVERITY_ERROR, NULL,
+                   "out of memory");
+        nvc_diagnostics_finish(&module->ctx->diagnostics);
+        return;
+    }
+    const nvc_sema_t** imports = NULL;
+    if (module->n_imports) {
+        imports = nvc_alloc(build->allocator,
+                            module->n_imports * sizeof(nvc_sema_t*));
+        if (!imports) {
+            nvc_report(&module->ctx->diagnostics, NVC_SEVERITY_ERROR, NULL,
+                       "out of memory");
+            nvc_diagnostics_finish(&module->ctx->diagnostics);
+            return;
+        }
+    }
+    // note: the modules array no longer changes once resolving started
+    for (uint32_t i = 0; i < module->n_imports; ++i) {
+        uint32_t index = module->imports[i].module;
+        imports[i] =
+            index == NVC_MODULE_NONE ? NULL : build->modules[index]->ctx->sema;
+    }
+    nvc_context_resolve(module->ctx, imports, module->n_imports);
+    nvc_free(build->allocator, imports);
+}
+
+// pops and runs one job and then schedules the jobs it unblocked
+// note: lock must be held and the queue must not be empty, the lock is
+// released while the job runs
+static void nvc_run_job(nvc_scheduler_t* sched) {
+    uint32_t index = sched->queue[sched->queue_head++];
+    nvc_module_t* module = sched->build->modules[index];
+    bool resolving = sched->resolving;
+    pthread_mutex_unlock(&sched->lock);
+
+    if (resolving)
+        nvc_resolve_module(sched, module);
+    else
+        nvc_parse_module(sched, module);
+
+    pthread_mutex_lock(&sched->lock);
+    if (resolving) {
+        for (uint32_t i = 0; i < module->n_dependents; ++i) {
+            nvc_module_t* dependent =
+                sched->build->modules[module->dependents[i]];
+            // note: can not fail, the queue has room for every module
+            if (--dependent->n_pending == 0)
+                nvc_schedule(sched, module->dependents[i]);
+        }
+    }
+    if (--sched->n_outstanding == 0) pthread_cond_broadcast(&sched->cond);
+}
+
+static void* nvc_worker_main(void* arg) {
+    nvc_scheduler_t* sched = arg;
+    pthread_mutex_lock(&sched->lock);
+    for (;;) {
+        while (!sched->stop && sched->queue_head == sched->queue_size)
+            pthread_cond_wait(&sched->cond, &sched->lock);
+        if (sched->stop) break;
+        nvc_run_job(sched);
+    }
+    pthread_mutex_unlock(&sched->lock);
+    return NULL;
+}
+
+// runs jobs on the calling thread too until every job is done
+static void nvc_drain(nvc_scheduler_t* sched) {
+    pthread_mutex_lock(&sched->lock);
+    while (sched->n_outstanding) {
+        if (sched->queue_head < sched->queue_size)
+            nvc_run_job(sched);
+        else
+            pthread_cond_wait(&sched->cond, &sched->lock);
+    }
+    sched->queue_head = 0;
+    sched->queue_size = 0;
+    pthread_mutex_unlock(&sched->lock);
+}
+
+static void nvc_report_cycle(nvc_build_t* build,
+                             nvc_module_import_t* import,
+                             nvc_module_t* importer,
+                             const uint32_t* path,
+                             uint32_t path_len) {
+    // note: path holds the modules from the imported one to the importer
+    size_t len = 0;
+    for (uint32_t i = 0; i < path_len; ++i)
+        len += strlen(build->modules[path[i]]->path) + 4;
+    len += strlen(build->modules[path[0]]->path) + 1;
+    char* msg = nvc_alloc(build->allocator, len);
+    if (msg) {
+        char* dst = msg;
+        for (uint32_t i = 0; i < path_len; ++i)
+            dst += sprintf(dst, "%s -> ", build->modules[path[i]]->path);
+        strcpy(dst, build->modules[path[0]]->path);
+    }
+    nvc_report(&importer->ctx->diagnostics, NVC_SEVERITY_ERROR,
+               &import->node->buf_loc, "import cycle: %s",
+               msg ? msg : import->node->import_decl.module);
+    nvc_free(build->allocator, msg);
+}
+
+// orders the modules so every module comes after its imports, an import that
+// closes a cycle is reported and dropped
+// note: iterative depth first search, modules on the stack are grey
+static bool nvc_order_modules(nvc_build_t* build) {
+    uint32_t n = build->n_modules;
+    build->order = nvc_alloc(build->allocator, n * sizeof(uint32_t));
+    uint8_t* color = nvc_calloc(build->allocator, n, sizeof(uint8_t));
+    uint32_t* stack = nvc_alloc(build->allocator, n * sizeof(uint32_t));
+    uint32_t* next = nvc_alloc(build->allocator, n * sizeof(uint32_t));
+    if (!build->order || !color || !stack || !next) {
+        nvc_free(build->allocator, color);
+        nvc_free(build->allocator, stack);
+        nvc_free(build->allocator, next);
+        return false;
+    }
+
+    enum { WHITE = 0, GREY = 1, BLACK = 2 };
+    uint32_t n_order = 0;
+    for (uint32_t root = 0; root < n; ++root) {
+        if (color[root] != WHITE) continue;
+        uint32_t sp = 0;
+        stack[sp] = root;
+        next[sp++] = 0;
+        color[root] = GREY;
+        while (sp) {
+            nvc_module_t* module = build->modules[stack[sp - 1]];
+            if (next[sp - 1] == module->n_imports) {
+                color[stack[sp - 1]] = BLACK;
+                build->order[n_order++] = stack[--sp];
+                continue;
+            }
+            nvc_module_import_t* import = module->imports + next[sp - 1]++;
+            if (import->module == NVC_MODULE_NONE) continue;
+            if (color[import->module] == WHITE) {
+                stack[sp] = import->module;
+                next[sp++] = 0;
+                color[import->module] = GREY;
+            } else if (color[import->module] == GREY) {
+                uint32_t start = sp - 1;
+                while (stack[start] != import->module) --start;
+                nvc_report_cycle(build, import, module, stack + start,
+                                 sp - start);
+                import->module = NVC_MODULE_NONE;
+            }
+        }
+    }
+
+    nvc_free(build->allocator, color);
+    nvc_free(build->allocator, stack);
+    nvc_free(build->allocator, next);
+    return true;
+}
+
+// links every module to the modules importing it, an import that can not be
+// linked is dropped so its module is never read before it is resolved
+static void nvc_link_modules(nvc_build_t* build) {
+    for (uint32_t i = 0; i < build->n_modules; ++i) {
+        nvc_module_t* module = build->modules[i];
+        for (uint32_t j = 0; j < module->n_imports; ++j) {
+            nvc_module_import_t* import = module->imports + j;
+            if (import->module == NVC_MODULE_NONE) continue;
+            nvc_module_t* dep = build->modules[import->module];
+            // dynamic allocation
+            if (dep->n_dependents >= dep->dependents_capacity) {
+                uint32_t capacity = dep->dependents_capacity
+                                        ? dep->dependents_capacity * 2
+                                        : 4;
+                uint32_t* grown =
+                    nvc_realloc(build->allocator, dep->dependents,
+                                capacity * sizeof(uint32_t));
+                if (!grown) {
+                    nvc_report(&module->ctx->diagnostics, NVC_SEVERITY_ERROR,
+                               &import->node->buf_loc, "out of memory");
+                    import->module = NVC_MODULE_NONE;
+                    continue;
+                }
+                dep->dependents = grown;
+                dep->dependents_capacity = capacity;
+            }
+            dep->dependents[dep->n_dependents++] = i;
+            ++module->n_pending;
+        }
+    }
+}
+
+nvc_build_t* nvc_build(nvc_allocator_t* allocator,
+                       const char* root_path,
+                       const nvc_build_options_t* options) {
+    if (!allocator) allocator = nvc_default_allocator();
+    nvc_build_t* build = nvc_calloc(allocator, 1, sizeof(nvc_build_t));
+    if (!build) return NULL;
+    build->allocator = allocator;
+
+    nvc_scheduler_t sched = {.build = build};
+    if (options) sched.options = *options;
+    if (sched.options.cache) ++sched.options.cache->generation;
+    uint32_t n_jobs = sched.options.n_jobs;
+    if (!n_jobs) {
+        long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        n_jobs = n_cpus > 0 ? (uint32_t)n_cpus : 1;
+    }
+    if (!nvc_symtab_init(&sched.by_key, allocator, 0)) {
+        nvc_free(allocator, build);
+        return NULL;
+    }
+    pthread_mutex_init(&sched.lock, NULL);
+    pthread_cond_init(&sched.cond, NULL);
+    // note: without a reader (sync or none could be started) every parse
+    // job reads its file itself
+    sched.reading = nvc_reader_start(&sched.reader, allocator,
+                                     sched.options.reader, nvc_module_loaded,
+                                     &sched, sched.options.profile);
+
+    // note: the main thread is a worker too
+    pthread_t* workers = NULL;
+    uint32_t n_workers = 0;
+    if (n_jobs > 1)
+        workers = nvc_alloc(allocator, (n_jobs - 1) * sizeof(pthread_t));
+    for (uint32_t i = 0; workers && i < n_jobs - 1; ++i) {
+        if (pthread_create(workers + n_workers, NULL, nvc_worker_main,
+                           &sched) == 0)
+            ++n_workers;
+    }
+
+    // the root is found by the path it was given even if it does not exist,
+    // reading it reports the error
+    char* key = nvc_module_key(allocator, root_path);
+    if (!key) key = nvc_strndup(allocator, root_path, strlen(root_path));
+    bool ok = false;
+    if (key) {
+        pthread_mutex_lock(&sched.lock);
+        ok = nvc_new_module(&sched, root_path, key) != NVC_MODULE_NONE;
+        pthread_mutex_unlock(&sched.lock);
+    }
+    if (!ok) goto out_of_memory;
+
+    // lex and parse everything that is reachable
+    nvc_drain(&sched);
+    if (sched.reading) {
+        nvc_reader_stop(&sched.reader);
+        sched.reading = false;
+    }
+
+    if (!nvc_order_modules(build)) goto out_of_memory;
+    nvc_link_modules(build);
+
+    // resolve leaves first, each finished module unblocks its importers
+    // note: every module is scheduled exactly once, make room up front so
+    // scheduling can not fail halfway
+    if (sched.queue_capacity < build->n_modules) {
+        uint32_t* grown = nvc_realloc(allocator, sched.queue,
+                                      build->n_modules * sizeof(uint32_t));
+        if (!grown) goto out_of_memory;
+        sched.queue = grown;
+        sched.queue_capacity = build->n_modules;
+    }
+    pthread_mutex_lock(&sched.lock);
+    sched.resolving = true;
+    for (uint32_t i = 0; i < build->n_modules; ++i) {
+        uint32_t index = build->order[i];
+        if (build->modules[index]->n_pending == 0) nvc_schedule(&sched, index);
+    }
+    pthread_mutex_unlock(&sched.lock);
+    nvc_drain(&sched);
+
+    for (uint32_t i = 0; i < build->n_modules; ++i) {
+        nvc_diagnostics_t* diags = &build->modules[i]->ctx->diagnostics;
+        build->n_errors += diags->n_errors + diags->n_suppressed;
+    }
+
+cleanup:
+    pthread_mutex_lock(&sched.lock);
+    sched.stop = true;
+    pthread_cond_broadcast(&sched.cond);
+    pthread_mutex_unlock(&sched.lock);
+    for (uint32_t i = 0; i < n_workers; ++i) pthread_join(workers[i], NULL);
+    nvc_free(allocator, workers);
+    pthread_cond_destroy(&sched.cond);
+    pthread_mutex_destroy(&sched.lock);
+    nvc_symtab_free(&sched.by_key);
+    nvc_free(allocator, sched.queue);
+    return build;
+out_of_memory:
+    // note: wait for running jobs and reads before tearing the build down
+    nvc_drain(&sched);
+    if (sched.reading) nvc_reader_stop(&sched.reader);
+    sched.reading = false;
+    nvc_free_build(build);
+    build = NULL;
+    goto cleanup;
+}
+
+bool nvc_module_cache_init(nvc_module_cache_t* cache,
+                           nvc_allocator_t* allocator) {
+    memset(cache, 0, sizeof(nvc_module_cache_t));
+    cache->allocator = allocator ? allocator : nvc_default_allocator();
+    return nvc_symtab_init(&cache->by_key, cache->allocator, 0);
+}
+
+void nvc_module_cache_free(nvc_module_cache_t* cache) {
+    nvc_allocator_t* allocator = cache->allocator;
+    for (uint32_t i = 0; i < cache->n_modules; ++i) {
+        nvc_cached_module_t* cached = cache->modules[i];
+        nvc_context_destroy(cached->ctx);
+        nvc_free(allocator, cached->buf);
+        nvc_free(allocator, cached->path);
+        nvc_free(allocator, cached->key);
+        nvc_free(allocator, cached->imports);
+        nvc_free(allocator, cached);
+    }
+    nvc_free(allocator, cache->modules);
+    nvc_symtab_free(&cache->by_key);
+    memset(cache, 0, sizeof(nvc_module_cache_t));
+}
+
+void nvc_module_cache_invalidate(nvc_module_cache_t* cache, const char* key) {
+    uint32_t index = nvc_symtab_lookup(&cache->by_key, key);
+    if (index != NVC_SYMTAB_NONE) cache->modules[index]->stale = true;
+}
+
+void nvc_free_build(nvc_build_t* build) {
+    if (build) {
+        nvc_allocator_t* allocator = build->allocator;
+        for (uint32_t i = 0; i < build->n_modules; ++i) {
+            nvc_module_t* module = build->modules[i];
+            if (!module->cached) {
+                nvc_context_destroy(module->ctx);
+                nvc_free(allocator, module->buf);
+                nvc_free(allocator, module->path);
+            }
+            nvc_diagnostics_free(&module->previous);
+            nvc_free(allocator, module->key);
+            nvc_free(allocator, module->imports);
+            nvc_free(allocator, module->dependents);
+            nvc_free(allocator, module);
+        }
+        nvc_free(allocator, build->modules);
+        nvc_free(allocator, build->order);
+        nvc_free(allocator, build);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -4,105 +4,153 @@ extern "C" {
 
 #include <nvc_compiler.h>
 
-#include <nvc_ast.h>
+#include <nvc_alloc.h>
+#include <nvc_build.h>
+#include <nvc_layout.h>
+#include <nvc_x86_64.h>
 #include <string.h>
 
-static char* nvc_read_file(FILE* fp, long* fs) {
-    // TODO: this method of reading a file might be inefficient/unsafe
-    if (!fp) goto error;
-    if (fseek(fp, 0, SEEK_END) != 0) goto error;
-    *fs = ftell(fp);
-    if (*fs == -1) goto error;
-    if (fseek(fp, 0, SEEK_SET) != 0) goto error;
-    // allocate filesize + null terminate
-    char* buf = malloc((*fs + 1) * sizeof(char));
-    if (!buf)
-        // out of memory
-        goto error;
-    if (fread(buf, *fs, 1, fp) != 1) goto error;
-    // null terminate
-    buf[*fs] = '\0';
-    return buf;
-error:
-    return NULL;
-}
-
-static char* nvc_open_and_read_file(char* filename, long* filesize) {
-    if (!filename) goto error;
-    // open and read file to buffer
-    // use "r" so text files so newlines appear as a simple "\n"
-    FILE* fp = fopen(filename, "r");
-    long fs;
-    char* buf = nvc_read_file(fp, &fs);
-    if (!buf) {
-        fclose(fp);
-        goto error;
-    }
-    fclose(fp);
-    if (filesize) *filesize = fs;
-    return buf;
-error:
-    if (filesize) *filesize = 0;
-    return NULL;
-}
-
-int nvc_compile(char* filename) {
-    // open and read file
-    long bufsz;
-    char* buf = nvc_open_and_read_file(filename, &bufsz);
-    if (!buf) {
-        fprintf(stderr, "Unable to read file: %s.\n", filename);
-        return 1;
-    }
+static void nvc_print_module(nvc_allocator_t* allocator,
+                             nvc_module_t* module) {
+    nvc_context_t* ctx = module->ctx;
 
     // TODO: remove me
     // debug print buf
-    fprintf(stdout, "----- Source code:\n%s\n", buf);
+    if (module->buf) fprintf(stdout, "----- Source code:\n%s\n", module->buf);
 
-    nvc_token_stream_t* stream = nvc_lexical_analysis(filename, buf, bufsz);
+    // TODO: remove me
+    // debug print tokens
+    if (ctx->tokens) {
+        nvc_token_stream_t* stream = ctx->tokens;
+        fprintf(stdout, "----- Tokens (%d):\n", stream->size);
+        for (size_t i = 0; i < stream->size; ++i) {
+            char* tokstr = nvc_token_to_str(allocator, stream->tokens + i);
+            if (!tokstr) break;
+            fprintf(stdout, "%s ", tokstr);
+            nvc_free(allocator, tokstr);
+        }
+        fputc('\n', stdout);
+    }
 
-    if (!stream) {
-        free(buf);
-        return 1;
+    // TODO: remove me
+    // debug print ast
+    if (ctx->ast) {
+        fprintf(stdout, "----- AST (%d, %d shared):\n", ctx->ast->size,
+                ctx->ast->n_shared);
+        nvc_print_ast(stdout, ctx->ast);
     }
 
     // TODO: remove me
-    // debug print tokens
-    fprintf(stdout, "----- Tokens (%d):\n", stream->size);
-    for (size_t i = 0; i < stream->size; ++i) {
-        char* tokstr = nvc_token_to_str(stream->tokens + i);
-        if (!tokstr) {
-            nvc_free_token_stream(stream);
-            free(buf);
-            return 1;
+    // debug print type layouts
+    if (ctx->sema) {
+        bool has_types = false;
+        for (uint32_t i = 0; i < ctx->sema->n_decls && !has_types; ++i)
+            has_types = ctx->sema->decls[i].kind == NVC_DECL_TYPE;
+        if (has_types) {
+            fputs("----- Types:\n", stdout);
+            nvc_print_layouts(stdout, ctx->sema);
         }
-        fprintf(stdout, "%s ", tokstr);
-        free(tokstr);
     }
-    fputc('\n', stdout);
 
-    // operate on token stream here
+    // TODO: remove me
+    // debug print ir
+    if (ctx->ir) {
+        fputs("----- IR:\n", stdout);
+        nvc_print_ir(stdout, ctx->ir);
+    }
+}
+
+// the name a module defines its symbols under: its file name without the
+// directory and the extensions (.nv and any compression suffix)
+static char* nvc_module_name(nvc_allocator_t* allocator, const char* path) {
+    const char* base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    const char* dot = strchr(base, '.');
+    return nvc_strndup(allocator, base, dot ? (size_t)(dot - base)
+                                            : strlen(base));
+}
 
-    nvc_ast_t* ast = nvc_parse(stream);
+// compiles the root module of build to an object at path, the names of its
+// imports come from the import decls
+static void nvc_emit_root_object(nvc_allocator_t* allocator,
+                                 nvc_build_t* build,
+                                 const char* path) {
+    nvc_module_t* root = build->modules[0];
+    nvc_diagnostics_t* diags = &root->ctx->diagnostics;
+    nvc_object_import_t* imports = nvc_calloc(
+        allocator, root->n_imports + 1, sizeof(nvc_object_import_t));
+    char* name = nvc_module_name(allocator, root->path);
+    if (!imports || !name) {
+        nvc_report(diags, NVC_SEVERITY_ERROR, NULL, "out of memory");
+        goto out;
+    }
+    uint32_t n_imports = 0;
+    for (uint32_t i = 0; i < root->n_imports; ++i) {
+        nvc_module_import_t* import = root->imports + i;
+        if (import->module == NVC_MODULE_NONE) continue;
+        // note: a.b defines its symbols as b, like the file a/b.nv would
+        const char* module = import->node->import_decl.module;
+        const char* last = strrchr(module, '.');
+        imports[n_imports].sema = build->modules[import->module]->ctx->sema;
+        imports[n_imports++].name = last ? last + 1 : module;
+    }
+    if (!nvc_write_object(allocator, diags, path, root->ctx->ir, name,
+                          imports, n_imports))
+        ++build->n_errors;
+out:
+    nvc_free(allocator, name);
+    nvc_free(allocator, imports);
+}
 
-    if (!ast) {
-        nvc_free_token_stream(stream);
-        free(buf);
-        return 1;
+int nvc_compile(nvc_allocator_t* allocator,
+                char* filename,
+                const nvc_compile_options_t* options) {
+    nvc_build_options_t build_options = {0};
+    if (options) {
+        build_options.parse_options = options->parse;
+        build_options.max_errors = options->max_errors;
+        build_options.n_jobs = options->n_jobs;
+        build_options.opt_level = options->opt_level;
+        build_options.reader = options->reader;
+    }
+    nvc_perf_profile_t profile;
+    if (options && options->perf_counters) {
+        nvc_perf_profile_init(&profile);
+        build_options.profile = &profile;
     }
 
-    // TODO: remove me
-    // debug print ast
-    fprintf(stdout, "----- AST (%d):\n", ast->size);
-    nvc_print_ast(ast);
+    nvc_build_t* build = nvc_build(allocator, filename, &build_options);
+    if (!build) {
+        fprintf(stderr, "Out of memory!\n");
+        if (build_options.profile) nvc_perf_profile_free(&profile);
+        return 1;
+    }
 
-    // operate on ast here
+    // note: only an error free build has the IR of every module
+    const char* object_path = options ? options->object_path : NULL;
+    if (object_path && !build->n_errors)
+        nvc_emit_root_object(allocator, build, object_path);
+
+    // note: imports first, the root module last
+    for (uint32_t i = 0; i < build->n_modules; ++i) {
+        nvc_module_t* module = build->modules[build->order[i]];
+        if (!object_path) {
+            if (build->n_modules > 1)
+                fprintf(stdout, "----- Module: %s\n", module->path);
+            nvc_print_module(allocator, module);
+            fflush(stdout);
+        }
+        nvc_print_diagnostics(stderr, &module->ctx->diagnostics);
+    }
 
-    nvc_free_ast(ast);
-    nvc_free_token_stream(stream);
-    free(buf);
+    if (build_options.profile) {
+        nvc_perf_print(stdout, &profile);
+        nvc_perf_profile_free(&profile);
+    }
 
-    return 0;
+    int result = build->n_errors != 0;
+    nvc_free_build(build);
+    return result;
 }
 
 #ifdef __cplusplus
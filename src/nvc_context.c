@@ -0,0 +1,136 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nvc_context.h>
+#include <nvc_passes.h>
+#include <nvc_pipeline.h>
+
+nvc_context_t* nvc_context_create(nvc_allocator_t* allocator) {
+    if (!allocator) allocator = nvc_default_allocator();
+    nvc_context_t* ctx = nvc_calloc(allocator, 1, sizeof(nvc_context_t));
+    if (!ctx) return NULL;
+    ctx->allocator = allocator;
+    nvc_diagnostics_init(&ctx->diagnostics, allocator);
+    nvc_diagnostics_init(&ctx->parsed, allocator);
+    nvc_arena_init(&ctx->strings, allocator, 0);
+    return ctx;
+}
+
+void nvc_context_reset(nvc_context_t* ctx) {
+    nvc_free_ir(ctx->ir);
+    ctx->ir = NULL;
+    nvc_free_sema(ctx->sema);
+    ctx->sema = NULL;
+    nvc_free_ast(ctx->ast);
+    ctx->ast = NULL;
+    nvc_free_token_stream(ctx->tokens);
+    ctx->tokens = NULL;
+    nvc_arena_reset(&ctx->strings);
+    nvc_diagnostics_clear(&ctx->diagnostics);
+    nvc_diagnostics_clear(&ctx->parsed);
+    ctx->resolved = false;
+}
+
+void nvc_context_destroy(nvc_context_t* ctx) {
+    if (ctx) {
+        nvc_context_reset(ctx);
+        nvc_diagnostics_free(&ctx->diagnostics);
+        nvc_diagnostics_free(&ctx->parsed);
+        nvc_arena_destroy(&ctx->strings);
+        nvc_free(ctx->allocator, ctx);
+    }
+}
+
+int nvc_context_parse(nvc_context_t* ctx,
+                      char* bufname,
+                      char* buf,
+                      long bufsz) {
+    nvc_context_reset(ctx);
+
+    // note: every phase recovers from errors, only out of memory stops the
+    // pipeline early
+    if (ctx->parse_options.pipeline) {
+        ctx->ast = nvc_lex_and_parse_pipelined(
+            ctx->allocator, &ctx->diagnostics, &ctx->strings, bufname, buf,
+            bufsz, &ctx->parse_options, ctx->profile);
+    } else {
+        nvc_perf_span_t span;
+        nvc_perf_begin(&span, ctx->profile, NVC_PHASE_LEX);
+        ctx->tokens = nvc_lexical_analysis(ctx->allocator, &ctx->diagnostics,
+                                           bufname, buf, bufsz);
+        nvc_perf_end(&span);
+        if (ctx->tokens) {
+            nvc_perf_add_tokens(ctx->profile, ctx->tokens->size);
+            nvc_perf_begin(&span, ctx->profile, NVC_PHASE_PARSE);
+            ctx->ast = nvc_parse(ctx->allocator, &ctx->diagnostics,
+                                 ctx->tokens, &ctx->parse_options);
+            nvc_perf_end(&span);
+        }
+    }
+
+    // note: kept so that resolving again can start over from it
+    if (!nvc_diagnostics_copy(&ctx->parsed, &ctx->diagnostics))
+        nvc_report(&ctx->diagnostics, NVC_SEVERITY_ERROR, NULL,
+                   "out of memory");
+    return !ctx->ast || ctx->diagnostics.n_errors != 0 ||
+           ctx->diagnostics.n_suppressed != 0;
+}
+
+int nvc_context_resolve(nvc_context_t* ctx,
+                        const nvc_sema_t* const* imports,
+                        uint32_t n_imports) {
+    nvc_free_ir(ctx->ir);
+    ctx->ir = NULL;
+    nvc_free_sema(ctx->sema);
+    ctx->sema = NULL;
+    nvc_diagnostics_t* diags = &ctx->diagnostics;
+    // note: the next runs start over from what parsing reported
+    if (ctx->resolved) {
+        nvc_diagnostics_clear(diags);
+        if (!nvc_diagnostics_copy(diags, &ctx->parsed))
+            nvc_report(diags, NVC_SEVERITY_ERROR, NULL, "out of memory");
+    }
+    ctx->resolved = true;
+    nvc_perf_span_t span;
+    if (ctx->ast) {
+        nvc_perf_begin(&span, ctx->profile, NVC_PHASE_RESOLVE);
+        ctx->sema = nvc_resolve(ctx->allocator, diags, ctx->ast, imports,
+                                n_imports);
+        nvc_perf_end(&span);
+    }
+
+    // note: only a correct tree is lowered, the IR of a broken one would be
+    // incomplete
+    if (ctx->sema && !diags->n_errors && !diags->n_suppressed) {
+        nvc_perf_begin(&span, ctx->profile, NVC_PHASE_LOWER);
+        ctx->ir = nvc_lower_ast(ctx->allocator, diags, ctx->ast, ctx->sema);
+        nvc_perf_end(&span);
+        if (ctx->ir && ctx->opt_level && !diags->n_errors) {
+            nvc_perf_begin(&span, ctx->profile, NVC_PHASE_OPTIMIZE);
+            nvc_optimize_ir(ctx->allocator, diags, ctx->ir);
+            nvc_perf_end(&span);
+        }
+        if (diags->n_errors) {
+            nvc_free_ir(ctx->ir);
+            ctx->ir = NULL;
+        }
+    }
+
+    // note: diagnostics are sorted once everything has reported
+    nvc_diagnostics_finish(diags);
+
+    return !ctx->sema || diags->n_errors != 0 || diags->n_suppressed != 0;
+}
+
+int nvc_compile_buffer(nvc_context_t* ctx,
+                       char* bufname,
+                       char* buf,
+                       long bufsz) {
+    nvc_context_parse(ctx, bufname, buf, bufsz);
+    return nvc_context_resolve(ctx, NULL, 0);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,347 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nvc_elf.h>
+
+#include <elf.h>
+#include <string.h>
+
+// section header indices of the written object, the first three match
+// nvc_elf_section_t (plus one)
+enum {
+    NVC_SHDR_TEXT = 1,
+    NVC_SHDR_RODATA = 2,
+    NVC_SHDR_BSS = 3,
+    NVC_SHDR_RELA_TEXT = 4,
+    NVC_SHDR_SYMTAB = 5,
+    NVC_SHDR_STRTAB = 6,
+    NVC_SHDR_SHSTRTAB = 7,
+    NVC_SHDR_NOTE_STACK = 8,
+    NVC_SHDR_N = 9,
+};
+
+// the null symbol and one per section come first
+#define NVC_ELF_FIRST_GLOBAL (NVC_ELF_N_SECTIONS + 1)
+
+static const char nvc_shstrtab[] =
+    "\0.text\0.rodata\0.bss\0.rela.text\0.symtab\0.strtab\0.shstrtab\0"
+    ".note.GNU-stack";
+
+// offset of name in nvc_shstrtab
+static uint32_t nvc_shstr(const char* name) {
+    for (uint32_t i = 1; i < sizeof(nvc_shstrtab); ++i) {
+        if (strcmp(nvc_shstrtab + i, name) == 0) return i;
+        i += strlen(nvc_shstrtab + i);
+    }
+    return 0;
+}
+
+static bool nvc_elf_grow(nvc_elf_object_t* obj,
+                         void** array,
+                         uint32_t* capacity,
+                         uint32_t size,
+                         size_t elem_size) {
+    if (size < *capacity) return true;
+    // dynamic allocation
+    uint32_t grown_capacity = *capacity ? *capacity * 2 : 16;
+    void* grown = nvc_realloc(obj->allocator, *array,
+                              (size_t)grown_capacity * elem_size);
+    if (!grown) {
+        obj->out_of_memory = true;
+        return false;
+    }
+    *array = grown;
+    *capacity = grown_capacity;
+    return true;
+}
+
+void nvc_elf_init(nvc_elf_object_t* obj, nvc_allocator_t* allocator) {
+    if (!allocator) allocator = nvc_default_allocator();
+    memset(obj, 0, sizeof(*obj));
+    obj->allocator = allocator;
+    for (uint32_t i = 0; i < NVC_ELF_N_SECTIONS; ++i)
+        obj->sections[i].align = 1;
+    if (!nvc_symtab_init(&obj->names, allocator, 0)) obj->out_of_memory = true;
+}
+
+void nvc_elf_free(nvc_elf_object_t* obj) {
+    for (uint32_t i = 0; i < NVC_ELF_N_SECTIONS; ++i)
+        nvc_free(obj->allocator, obj->sections[i].data);
+    for (uint32_t i = 0; i < obj->n_symbols; ++i)
+        nvc_free(obj->allocator, obj->symbols[i].name);
+    nvc_free(obj->allocator, obj->symbols);
+    nvc_free(obj->allocator, obj->relocs);
+    nvc_symtab_free(&obj->names);
+}
+
+uint64_t nvc_elf_append(nvc_elf_object_t* obj,
+                        nvc_elf_section_t section,
+                        const void* data,
+                        uint64_t size,
+                        uint64_t align) {
+    nvc_elf_buf_t* buf = obj->sections + section;
+    if (align > buf->align) buf->align = align;
+    uint64_t offset = (buf->size + align - 1) & ~(align - 1);
+    // note: nothing to pad for, the section may not even have a buffer yet
+    if (size == 0) return offset;
+    if (section != NVC_ELF_BSS) {
+        // dynamic allocation
+        if (offset + size > buf->capacity) {
+            uint64_t capacity = buf->capacity ? buf->capacity : 256;
+            while (capacity < offset + size) capacity *= 2;
+            uint8_t* grown = nvc_realloc(obj->allocator, buf->data, capacity);
+            if (!grown) {
+                obj->out_of_memory = true;
+                return offset;
+            }
+            buf->data = grown;
+            buf->capacity = capacity;
+        }
+        memset(buf->data + buf->size, 0, offset - buf->size);
+        if (data)
+            memcpy(buf->data + offset, data, size);
+        else
+            memset(buf->data + offset, 0, size);
+    }
+    buf->size = offset + size;
+    return offset;
+}
+
+uint32_t nvc_elf_symbol(nvc_elf_object_t* obj, const char* name) {
+    uint32_t index = nvc_symtab_lookup(&obj->names, name);
+    if (index != NVC_SYMTAB_NONE) return index;
+    if (!nvc_elf_grow(obj, (void**)&obj->symbols, &obj->symbols_capacity,
+                      obj->n_symbols, sizeof(nvc_elf_symbol_t)))
+        return 0;
+    nvc_elf_symbol_t* symbol = obj->symbols + obj->n_symbols;
+    memset(symbol, 0, sizeof(*symbol));
+    symbol->section = NVC_ELF_UNDEFINED;
+    symbol->name = nvc_strndup(obj->allocator, name, strlen(name));
+    index = NVC_ELF_FIRST_GLOBAL + obj->n_symbols;
+    // note: the name is the key so it must outlive the table
+    if (!symbol->name || !nvc_symtab_bind(&obj->names, symbol->name, index)) {
+        nvc_free(obj->allocator, symbol->name);
+        obj->out_of_memory = true;
+        return 0;
+    }
+    ++obj->n_symbols;
+    return index;
+}
+
+void nvc_elf_define(nvc_elf_object_t* obj,
+                    uint32_t symbol,
+                    nvc_elf_section_t section,
+                    uint64_t value,
+                    uint64_t size,
+                    bool function) {
+    // note: symbol 0 comes from a failed nvc_elf_symbol
+    if (symbol < NVC_ELF_FIRST_GLOBAL) return;
+    nvc_elf_symbol_t* sym = obj->symbols + symbol - NVC_ELF_FIRST_GLOBAL;
+    sym->section = section;
+    sym->value = value;
+    sym->size = size;
+    sym->function = function;
+}
+
+void nvc_elf_reloc(nvc_elf_object_t* obj,
+                   uint64_t offset,
+                   uint32_t symbol,
+                   uint32_t type,
+                   int64_t addend) {
+    if (!nvc_elf_grow(obj, (void**)&obj->relocs, &obj->relocs_capacity,
+                      obj->n_relocs, sizeof(nvc_elf_reloc_t)))
+        return;
+    obj->relocs[obj->n_relocs++] = (nvc_elf_reloc_t){
+        .offset = offset,
+        .symbol = symbol,
+        .type = type,
+        .addend = addend,
+    };
+}
+
+static uint64_t nvc_elf_align(uint64_t offset, uint64_t align) {
+    return (offset + align - 1) & ~(align - 1);
+}
+
+// pads the file to offset
+static bool nvc_elf_pad(FILE* out, uint64_t* pos, uint64_t offset) {
+    for (; *pos < offset; ++*pos) {
+        if (fputc(0, out) == EOF) return false;
+    }
+    return true;
+}
+
+static bool nvc_elf_put(FILE* out, uint64_t* pos, const void* data, size_t n) {
+    if (n && fwrite(data, 1, n, out) != n) return false;
+    *pos += n;
+    return true;
+}
+
+bool nvc_elf_write(nvc_elf_object_t* obj, FILE* out) {
+    if (obj->out_of_memory) return false;
+    const nvc_elf_buf_t* text = obj->sections + NVC_ELF_TEXT;
+    const nvc_elf_buf_t* rodata = obj->sections + NVC_ELF_RODATA;
+    const nvc_elf_buf_t* bss = obj->sections + NVC_ELF_BSS;
+
+    // the string table holds the symbol names back to back
+    uint64_t strtab_size = 1;
+    for (uint32_t i = 0; i < obj->n_symbols; ++i)
+        strtab_size += strlen(obj->symbols[i].name) + 1;
+    uint32_t n_symbols = NVC_ELF_FIRST_GLOBAL + obj->n_symbols;
+
+    // layout: header, .text, .rodata, .rela.text, .symtab, .strtab,
+    // .shstrtab, section headers
+    uint64_t text_off = nvc_elf_align(sizeof(Elf64_Ehdr), text->align);
+    uint64_t rodata_off = nvc_elf_align(text_off + text->size, rodata->align);
+    uint64_t rela_off = nvc_elf_align(rodata_off + rodata->size, 8);
+    uint64_t rela_size = (uint64_t)obj->n_relocs * sizeof(Elf64_Rela);
+    uint64_t symtab_off = rela_off + rela_size;
+    uint64_t symtab_size = (uint64_t)n_symbols * sizeof(Elf64_Sym);
+    uint64_t strtab_off = symtab_off + symtab_size;
+    uint64_t shstrtab_off = strtab_off + strtab_size;
+    uint64_t shdr_off =
+        nvc_elf_align(shstrtab_off + sizeof(nvc_shstrtab), 8);
+
+    Elf64_Ehdr ehdr = {
+        .e_ident = {ELFMAG0, ELFMAG1, ELFMAG2, ELFMAG3, ELFCLASS64,
+                    ELFDATA2LSB, EV_CURRENT, ELFOSABI_SYSV},
+        .e_type = ET_REL,
+        .e_machine = EM_X86_64,
+        .e_version = EV_CURRENT,
+        .e_shoff = shdr_off,
+        .e_ehsize = sizeof(Elf64_Ehdr),
+        .e_shentsize = sizeof(Elf64_Shdr),
+        .e_shnum = NVC_SHDR_N,
+        .e_shstrndx = NVC_SHDR_SHSTRTAB,
+    };
+    uint64_t pos = 0;
+    if (!nvc_elf_put(out, &pos, &ehdr, sizeof(ehdr)) ||
+        !nvc_elf_pad(out, &pos, text_off) ||
+        !nvc_elf_put(out, &pos, text->data, text->size) ||
+        !nvc_elf_pad(out, &pos, rodata_off) ||
+        !nvc_elf_put(out, &pos, rodata->data, rodata->size) ||
+        !nvc_elf_pad(out, &pos, rela_off))
+        return false;
+
+    for (uint32_t i = 0; i < obj->n_relocs; ++i) {
+        const nvc_elf_reloc_t* reloc = obj->relocs + i;
+        Elf64_Rela rela = {
+            .r_offset = reloc->offset,
+            .r_info = ELF64_R_INFO(reloc->symbol, reloc->type),
+            .r_addend = reloc->addend,
+        };
+        if (!nvc_elf_put(out, &pos, &rela, sizeof(rela))) return false;
+    }
+
+    // null symbol, section symbols, then the globals
+    Elf64_Sym sym = {0};
+    if (!nvc_elf_put(out, &pos, &sym, sizeof(sym))) return false;
+    for (uint32_t i = 0; i < NVC_ELF_N_SECTIONS; ++i) {
+        sym = (Elf64_Sym){
+            .st_info = ELF64_ST_INFO(STB_LOCAL, STT_SECTION),
+            .st_shndx = NVC_SHDR_TEXT + i,
+        };
+        if (!nvc_elf_put(out, &pos, &sym, sizeof(sym))) return false;
+    }
+    uint32_t name = 1;
+    for (uint32_t i = 0; i < obj->n_symbols; ++i) {
+        const nvc_elf_symbol_t* symbol = obj->symbols + i;
+        bool defined = symbol->section != NVC_ELF_UNDEFINED;
+        int type = !defined ? STT_NOTYPE : symbol->function ? STT_FUNC
+                                                            : STT_OBJECT;
+        sym = (Elf64_Sym){
+            .st_name = name,
+            .st_info = ELF64_ST_INFO(STB_GLOBAL, type),
+            .st_shndx = defined ? NVC_SHDR_TEXT + symbol->section : SHN_UNDEF,
+            .st_value = symbol->value,
+            .st_size = symbol->size,
+        };
+        name += strlen(symbol->name) + 1;
+        if (!nvc_elf_put(out, &pos, &sym, sizeof(sym))) return false;
+    }
+
+    if (!nvc_elf_put(out, &pos, "", 1)) return false;
+    for (uint32_t i = 0; i < obj->n_symbols; ++i) {
+        const char* symbol_name = obj->symbols[i].name;
+        if (!nvc_elf_put(out, &pos, symbol_name, strlen(symbol_name) + 1))
+            return false;
+    }
+    if (!nvc_elf_put(out, &pos, nvc_shstrtab, sizeof(nvc_shstrtab)) ||
+        !nvc_elf_pad(out, &pos, shdr_off))
+        return false;
+
+    Elf64_Shdr shdrs[NVC_SHDR_N] = {
+        [NVC_SHDR_TEXT] = {
+            .sh_name = nvc_shstr(".text"),
+            .sh_type = SHT_PROGBITS,
+            .sh_flags = SHF_ALLOC | SHF_EXECINSTR,
+            .sh_offset = text_off,
+            .sh_size = text->size,
+            .sh_addralign = text->align,
+        },
+        [NVC_SHDR_RODATA] = {
+            .sh_name = nvc_shstr(".rodata"),
+            .sh_type = SHT_PROGBITS,
+            .sh_flags = SHF_ALLOC,
+            .sh_offset = rodata_off,
+            .sh_size = rodata->size,
+            .sh_addralign = rodata->align,
+        },
+        [NVC_SHDR_BSS] = {
+            .sh_name = nvc_shstr(".bss"),
+            .sh_type = SHT_NOBITS,
+            .sh_flags = SHF_ALLOC | SHF_WRITE,
+            .sh_offset = rodata_off + rodata->size,
+            .sh_size = bss->size,
+            .sh_addralign = bss->align,
+        },
+        [NVC_SHDR_RELA_TEXT] = {
+            .sh_name = nvc_shstr(".rela.text"),
+            .sh_type = SHT_RELA,
+            .sh_flags = SHF_INFO_LINK,
+            .sh_offset = rela_off,
+            .sh_size = rela_size,
+            .sh_link = NVC_SHDR_SYMTAB,
+            .sh_info = NVC_SHDR_TEXT,
+            .sh_addralign = 8,
+            .sh_entsize = sizeof(Elf64_Rela),
+        },
+        [NVC_SHDR_SYMTAB] = {
+            .sh_name = nvc_shstr(".symtab"),
+            .sh_type = SHT_SYMTAB,
+            .sh_offset = symtab_off,
+            .sh_size = symtab_size,
+            .sh_link = NVC_SHDR_STRTAB,
+            // note: index of the first global symbol
+            .sh_info = NVC_ELF_FIRST_GLOBAL,
+            .sh_addralign = 8,
+            .sh_entsize = sizeof(Elf64_Sym),
+        },
+        [NVC_SHDR_STRTAB] = {
+            .sh_name = nvc_shstr(".strtab"),
+            .sh_type = SHT_STRTAB,
+            .sh_offset = strtab_off,
+            .sh_size = strtab_size,
+            .sh_addralign = 1,
+        },
+        [NVC_SHDR_SHSTRTAB] = {
+            .sh_name = nvc_shstr(".shstrtab"),
+            .sh_type = SHT_STRTAB,
+            .sh_offset = shstrtab_off,
+            .sh_size = sizeof(nvc_shstrtab),
+            .sh_addralign = 1,
+        },
+        [NVC_SHDR_NOTE_STACK] = {
+            .sh_name = nvc_shstr(".note.GNU-stack"),
+            .sh_type = SHT_PROGBITS,
+            .sh_offset = shdr_off,
+            .sh_addralign = 1,
+        },
+    };
+    return nvc_elf_put(out, &pos, shdrs, sizeof(shdrs));
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,443 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nvc_fmt.h>
+
+#include <nvc_format.h>
+#include <nvc_hash.h>
+#include <nvc_output.h>
+#include <nvc_source.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// what the cache knows about a formatted file
+typedef struct {
+    char* path;  // owned, as it was named on the command line
+    uint64_t hash;  // of the contents
+    uint64_t size;
+    int64_t mtime_ns;
+} nvc_fmt_entry_t;
+
+typedef struct {
+    nvc_allocator_t* allocator;
+    const nvc_fmt_options_t* options;
+    nvc_fmt_entry_t* entries;
+    uint32_t n_entries, capacity;
+    uint32_t* buckets;  // open addressing by path, indices into entries
+    uint32_t mask;
+    bool cache_changed;
+    bool failed;       // a file could not be formatted
+    bool unformatted;  // with check, a file is not formatted
+} nvc_fmt_t;
+
+// where the formatted source goes while nvc_format runs
+typedef struct {
+    nvc_fmt_t* fmt;
+    const char* path;
+    const char* src;
+    size_t src_size;
+    size_t pos;    // bytes of output so far
+    bool differs;  // the output is not a prefix of the source
+    int fd;        // of the temporary file, -1 until the output differs
+    char* target;  // path with the symlinks resolved, the file rewritten
+    char* tmp_path;
+    uint64_t hash;  // of the output so far
+} nvc_fmt_output_t;
+
+static int64_t nvc_fmt_mtime_ns(const struct stat* st) {
+#ifdef __APPLE__
+    return (int64_t)st->st_mtimespec.tv_sec * 1000000000 +
+           st->st_mtimespec.tv_nsec;
+#else
+    return (int64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+#endif
+}
+
+static nvc_fmt_entry_t* nvc_fmt_find(nvc_fmt_t* fmt, const char* path) {
+    if (!fmt->buckets) return NULL;
+    uint32_t i = nvc_hash_str(path) & fmt->mask;
+    for (; fmt->buckets[i] != UINT32_MAX; i = (i + 1) & fmt->mask) {
+        nvc_fmt_entry_t* entry = fmt->entries + fmt->buckets[i];
+        if (strcmp(entry->path, path) == 0) return entry;
+    }
+    return NULL;
+}
+
+// the entry of path, a new one (with only the path set) when there is none
+static nvc_fmt_entry_t* nvc_fmt_entry(nvc_fmt_t* fmt, const char* path) {
+    nvc_fmt_entry_t* entry = nvc_fmt_find(fmt, path);
+    if (entry) return entry;
+    // dynamic allocation
+    if (fmt->n_entries >= fmt->capacity) {
+        uint32_t capacity = fmt->capacity ? fmt->capacity * 2 : 64;
+        nvc_fmt_entry_t* grown = nvc_realloc(
+            fmt->allocator, fmt->entries, capacity * sizeof(nvc_fmt_entry_t));
+        uint32_t* buckets =
+            nvc_alloc(fmt->allocator, 2 * capacity * sizeof(uint32_t));
+        if (grown) fmt->entries = grown;
+        if (!grown || !buckets) {
+            nvc_free(fmt->allocator, buckets);
+            return NULL;
+        }
+        // note: at most half of the buckets are used
+        nvc_free(fmt->allocator, fmt->buckets);
+        fmt->buckets = buckets;
+        fmt->mask = 2 * capacity - 1;
+        fmt->capacity = capacity;
+        memset(buckets, 0xff, 2 * capacity * sizeof(uint32_t));
+        for (uint32_t e = 0; e < fmt->n_entries; ++e) {
+            uint32_t i = nvc_hash_str(fmt->entries[e].path) & fmt->mask;
+            while (buckets[i] != UINT32_MAX) i = (i + 1) & fmt->mask;
+            buckets[i] = e;
+        }
+    }
+    char* path_cpy = nvc_strndup(fmt->allocator, path, strlen(path));
+    if (!path_cpy) return NULL;
+    uint32_t i = nvc_hash_str(path) & fmt->mask;
+    while (fmt->buckets[i] != UINT32_MAX) i = (i + 1) & fmt->mask;
+    fmt->buckets[i] = fmt->n_entries;
+    entry = fmt->entries + fmt->n_entries++;
+    memset(entry, 0, sizeof(nvc_fmt_entry_t));
+    entry->path = path_cpy;
+    return entry;
+}
+
+// records that path is formatted, a full cache is only a slower next run
+static void nvc_fmt_remember(nvc_fmt_t* fmt,
+                             const char* path,
+                             uint64_t hash,
+                             const struct stat* st) {
+    if (!fmt->options->cache_path) return;
+    nvc_fmt_entry_t* entry = nvc_fmt_entry(fmt, path);
+    if (!entry) return;
+    entry->hash = hash;
+    entry->size = (uint64_t)st->st_size;
+    entry->mtime_ns = nvc_fmt_mtime_ns(st);
+    fmt->cache_changed = true;
+}
+
+// one line per file: hash, size, modification time and path
+static bool nvc_fmt_load_cache(nvc_fmt_t* fmt) {
+    FILE* fp = fopen(fmt->options->cache_path, "r");
+    if (!fp) return errno == ENOENT;
+    char* line = NULL;
+    size_t capacity = 0;
+    ssize_t len;
+    bool ok = true;
+    while (ok && (len = getline(&line, &capacity, fp)) > 0) {
+        if (line[len - 1] == '\n') line[--len] = '\0';
+        uint64_t hash, size;
+        int64_t mtime_ns;
+        int path_start = 0;
+        // note: a damaged line only costs formatting its file again
+        if (sscanf(line, "%" SCNx64 " %" SCNu64 " %" SCNd64 " %n", &hash,
+                   &size, &mtime_ns, &path_start) != 3 ||
+            !path_start || !line[path_start])
+            continue;
+        nvc_fmt_entry_t* entry = nvc_fmt_entry(fmt, line + path_start);
+        if (!entry) {
+            ok = false;
+            break;
+        }
+        entry->hash = hash;
+        entry->size = size;
+        entry->mtime_ns = mtime_ns;
+    }
+    // note: getline allocates with libc
+    free(line);
+    fclose(fp);
+    return ok;
+}
+
+static bool nvc_fmt_save_cache(nvc_fmt_t* fmt) {
+    const char* path = fmt->options->cache_path;
+    size_t len = strlen(path);
+    char* tmp_path = nvc_alloc(fmt->allocator, len + 8);
+    if (!tmp_path) return false;
+    memcpy(tmp_path, path, len);
+    memcpy(tmp_path + len, ".XXXXXX", 8);
+    int fd = mkstemp(tmp_path);
+    FILE* fp = fd < 0 ? NULL : fdopen(fd, "w");
+    bool ok = fp != NULL;
+    for (uint32_t i = 0; ok && i < fmt->n_entries; ++i) {
+        nvc_fmt_entry_t* entry = fmt->entries + i;
+        ok = fprintf(fp, "%016" PRIx64 " %" PRIu64 " %" PRId64 " %s\n",
+                     entry->hash, entry->size, entry->mtime_ns,
+                     entry->path) > 0;
+    }
+    if (ok) ok = fflush(fp) == 0 && fsync(fd) == 0;
+    if (fp && fclose(fp) != 0) ok = false;
+    if (!fp && fd >= 0) close(fd);
+    if (ok) ok = rename(tmp_path, path) == 0;
+    if (!ok && fd >= 0) unlink(tmp_path);
+    nvc_free(fmt->allocator, tmp_path);
+    return ok;
+}
+
+static bool nvc_fmt_write_all(int fd, const char* data, size_t size) {
+    while (size) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+// the output differs from the source: opens the temporary file the source
+// is rewritten to and puts the part of the output that was the same there
+static bool nvc_fmt_differs(nvc_fmt_output_t* out) {
+    out->differs = true;
+    if (out->fmt->options->check) return true;
+    // note: a symlink is followed so the file it points to is formatted
+    // instead of being replaced by a regular file
+    char* real = realpath(out->path, NULL);
+    if (!real) {
+        fprintf(stderr, "Unable to write file: %s: %s.\n", out->path,
+                strerror(errno));
+        return false;
+    }
+    size_t len = strlen(real);
+    out->target = nvc_strndup(out->fmt->allocator, real, len);
+    free(real);
+    out->tmp_path = out->target ? nvc_alloc(out->fmt->allocator, len + 8)
+                                : NULL;
+    if (!out->tmp_path) {
+        fprintf(stderr, "Out of memory!\n");
+        return false;
+    }
+    memcpy(out->tmp_path, out->target, len);
+    memcpy(out->tmp_path + len, ".XXXXXX", 8);
+    out->fd = mkstemp(out->tmp_path);
+    if (out->fd < 0) {
+        fprintf(stderr, "Unable to write file: %s: %s.\n", out->tmp_path,
+                strerror(errno));
+        return false;
+    }
+    return nvc_fmt_write_all(out->fd, out->src, out->pos);
+}
+
+static bool nvc_fmt_write(void* ctx, const char* data, size_t size) {
+    nvc_fmt_output_t* out = ctx;
+    out->hash = nvc_hash_bytes(data, size, out->hash);
+    if (!out->differs) {
+        if (out->pos + size <= out->src_size &&
+            memcmp(out->src + out->pos, data, size) == 0) {
+            out->pos += size;
+            return true;
+        }
+        if (!nvc_fmt_differs(out)) return false;
+    }
+    if (out->fd < 0) return true;
+    if (nvc_fmt_write_all(out->fd, data, size)) return true;
+    fprintf(stderr, "Unable to write file: %s: %s.\n", out->tmp_path,
+            strerror(errno));
+    return false;
+}
+
+// bytes mapped for a file of size bytes, at least one more
+static size_t nvc_fmt_mapped_size(size_t size) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    return (size + page) / page * page;
+}
+
+// maps the file at fd read only instead of reading it, so formatting takes
+// the same memory for any size of file. the mapping is null terminated like
+// a read buffer: the file is mapped over zeroed pages one byte longer
+// note: returns NULL on failure, unmap with nvc_fmt_unmap
+static char* nvc_fmt_map(int fd, size_t size) {
+    size_t mapped = nvc_fmt_mapped_size(size);
+    char* buf = mmap(NULL, mapped, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS,
+                     -1, 0);
+    if (buf == MAP_FAILED) return NULL;
+    // note: the rest of the last page of the file reads as zeros too
+    if (size && mmap(buf, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) ==
+                    MAP_FAILED) {
+        munmap(buf, mapped);
+        return NULL;
+    }
+    return buf;
+}
+
+static void nvc_fmt_unmap(char* buf, size_t size) {
+    munmap(buf, nvc_fmt_mapped_size(size));
+}
+
+static bool nvc_fmt_file(nvc_fmt_t* fmt, const char* path) {
+    nvc_allocator_t* allocator = fmt->allocator;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "Unable to read file: %s.\n", path);
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    nvc_fmt_entry_t* entry = nvc_fmt_find(fmt, path);
+    if (entry && entry->size == (uint64_t)st.st_size &&
+        entry->mtime_ns == nvc_fmt_mtime_ns(&st)) {
+        close(fd);
+        return true;
+    }
+    size_t size = (size_t)st.st_size;
+    char* buf = nvc_fmt_map(fd, size);
+    close(fd);
+    if (!buf) {
+        fprintf(stderr, "Unable to read file: %s.\n", path);
+        return false;
+    }
+    if (nvc_source_detect((const unsigned char*)buf, size) !=
+        NVC_SOURCE_PLAIN) {
+        fprintf(stderr, "Unable to format compressed file: %s.\n", path);
+        nvc_fmt_unmap(buf, size);
+        return false;
+    }
+    uint64_t hash = nvc_hash_bytes(buf, size, NVC_HASH_SEED);
+    if (entry && entry->hash == hash) {
+        // note: touched but not changed
+        nvc_fmt_remember(fmt, path, hash, &st);
+        nvc_fmt_unmap(buf, size);
+        return true;
+    }
+
+    nvc_fmt_output_t out = {
+        .fmt = fmt,
+        .path = path,
+        .src = buf,
+        .src_size = size,
+        .fd = -1,
+        .hash = NVC_HASH_SEED,
+    };
+    nvc_diagnostics_t diags;
+    nvc_diagnostics_init(&diags, allocator);
+    bool ok = nvc_format(allocator, &diags, (char*)path, buf, (long)size,
+                         nvc_fmt_write, &out);
+    // note: a shorter output is only noticed at the end
+    if (ok && !out.differs && out.pos != size) ok = nvc_fmt_differs(&out);
+    nvc_diagnostics_finish(&diags);
+    nvc_print_diagnostics(stderr, &diags);
+    nvc_diagnostics_free(&diags);
+
+    if (ok && out.fd >= 0) {
+        // note: the rewritten file keeps the permissions of the source
+        if (fchmod(out.fd, st.st_mode & 07777) != 0 || fstat(out.fd, &st) != 0)
+            ok = false;
+        // note: synced before the rename so a crash leaves either the old
+        // or the new contents, never an empty file
+        if (ok && fsync(out.fd) != 0) ok = false;
+        if (close(out.fd) != 0) ok = false;
+        out.fd = -1;
+        if (ok) ok = rename(out.tmp_path, out.target) == 0;
+        if (!ok)
+            fprintf(stderr, "Unable to write file: %s: %s.\n", path,
+                    strerror(errno));
+    }
+    if (out.fd >= 0) close(out.fd);
+    if (!ok && out.tmp_path) unlink(out.tmp_path);
+    if (ok && out.differs) {
+        printf("%s\n", path);
+        if (fmt->options->check) fmt->unformatted = true;
+    }
+    if (ok && !(out.differs && fmt->options->check))
+        nvc_fmt_remember(fmt, path, out.hash, &st);
+    nvc_free(allocator, out.tmp_path);
+    nvc_free(allocator, out.target);
+    nvc_fmt_unmap(buf, size);
+    return ok;
+}
+
+static bool nvc_fmt_has_suffix(const char* name, const char* suffix) {
+    size_t len = strlen(name), suffix_len = strlen(suffix);
+    return len > suffix_len && strcmp(name + len - suffix_len, suffix) == 0;
+}
+
+static bool nvc_fmt_path(nvc_fmt_t* fmt, const char* path);
+
+static bool nvc_fmt_dir(nvc_fmt_t* fmt, const char* path) {
+    DIR* dp = opendir(path);
+    if (!dp) {
+        fprintf(stderr, "Unable to read directory: %s: %s.\n", path,
+                strerror(errno));
+        return false;
+    }
+    bool ok = true;
+    size_t dir_len = strlen(path);
+    bool slash = dir_len && path[dir_len - 1] != '/';
+    struct dirent* entry;
+    while ((entry = readdir(dp))) {
+        // note: skips . and .. as well as hidden files and directories
+        if (entry->d_name[0] == '.') continue;
+        size_t name_len = strlen(entry->d_name);
+        char* entry_path =
+            nvc_alloc(fmt->allocator, dir_len + slash + name_len + 1);
+        if (!entry_path) {
+            fprintf(stderr, "Out of memory!\n");
+            ok = false;
+            break;
+        }
+        memcpy(entry_path, path, dir_len);
+        if (slash) entry_path[dir_len] = '/';
+        memcpy(entry_path + dir_len + slash, entry->d_name, name_len + 1);
+        struct stat st;
+        if (stat(entry_path, &st) == 0 &&
+            (S_ISDIR(st.st_mode) ||
+             (S_ISREG(st.st_mode) && nvc_fmt_has_suffix(entry->d_name, ".nv"))))
+            ok &= nvc_fmt_path(fmt, entry_path);
+        nvc_free(fmt->allocator, entry_path);
+    }
+    closedir(dp);
+    return ok;
+}
+
+static bool nvc_fmt_path(nvc_fmt_t* fmt, const char* path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        fprintf(stderr, "Unable to read file: %s.\n", path);
+        return false;
+    }
+    return S_ISDIR(st.st_mode) ? nvc_fmt_dir(fmt, path)
+                               : nvc_fmt_file(fmt, path);
+}
+
+int nvc_fmt(nvc_allocator_t* allocator,
+            char** paths,
+            int n_paths,
+            const nvc_fmt_options_t* options) {
+    static const nvc_fmt_options_t defaults = {0};
+    nvc_fmt_t fmt = {
+        .allocator = allocator ? allocator : nvc_default_allocator(),
+        .options = options ? options : &defaults,
+    };
+    if (fmt.options->cache_path && !nvc_fmt_load_cache(&fmt)) {
+        fprintf(stderr, "Unable to read cache: %s.\n", fmt.options->cache_path);
+        fmt.failed = true;
+    }
+    // note: a file that can not be formatted does not stop the others
+    for (int i = 0; i < n_paths; ++i) {
+        if (!nvc_fmt_path(&fmt, paths[i])) fmt.failed = true;
+    }
+    if (fmt.cache_changed && !nvc_fmt_save_cache(&fmt)) {
+        fprintf(stderr, "Unable to write cache: %s.\n",
+                fmt.options->cache_path);
+        fmt.failed = true;
+    }
+    for (uint32_t i = 0; i < fmt.n_entries; ++i)
+        nvc_free(fmt.allocator, fmt.entries[i].path);
+    nvc_free(fmt.allocator, fmt.entries);
+    nvc_free(fmt.allocator, fmt.buckets);
+    return fmt.failed || fmt.unformatted;
+}
+
+#ifdef __cplusplus
+}
+#endif
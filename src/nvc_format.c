@@ -0,0 +1,280 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nvc_format.h>
+
+#include <nvc_ast.h>
+#include <nvc_lexer.h>
+#include <nvc_number.h>
+#include <nvc_utf8.h>
+
+#include <string.h>
+
+typedef struct {
+    nvc_format_write_t write;
+    void* ctx;
+    char* out;  // NVC_FORMAT_BUFFER_SIZE bytes
+    size_t n_out;
+    bool failed;  // write returned false, nothing more is written
+    bool ascii;   // columns of the source are byte offsets
+    const char* buf_end;
+
+    // what came before the token being formatted
+    bool first;         // nothing was written yet
+    uint32_t end_line;  // line the previous token (or comment) ends on
+    bool after_comment;
+    // note: the fields below describe the last token that is not a comment
+    nvc_tok_kind_t prev_kind;
+    nvc_operator_kind_t prev_op;  // when prev_kind is NVC_TOK_OP
+    bool prev_unary;    // a unary operator, its operand is not spaced
+    bool prev_operand;  // ends an operand, a '[' after it indexes it
+    bool prev_callee;   // a symbol a '(' after calls
+    bool unary_next;    // a '-', '+' or '~' now is a unary operator
+    bool type_header;   // between type and the '(' of its members
+    uint32_t open_loops;  // for and while waiting for their do
+    uint32_t depth;       // open brackets
+} nvc_formatter_t;
+
+static void nvc_format_flush(nvc_formatter_t* f) {
+    if (f->n_out && !f->failed && !f->write(f->ctx, f->out, f->n_out))
+        f->failed = true;
+    f->n_out = 0;
+}
+
+static void nvc_format_emit(nvc_formatter_t* f, const char* data, size_t size) {
+    if (f->failed) return;
+    if (f->n_out + size > NVC_FORMAT_BUFFER_SIZE) nvc_format_flush(f);
+    // note: what does not fit the buffer (a huge string literal or comment)
+    // goes straight to the writer
+    if (size >= NVC_FORMAT_BUFFER_SIZE) {
+        if (!f->failed && !f->write(f->ctx, data, size)) f->failed = true;
+        return;
+    }
+    memcpy(f->out + f->n_out, data, size);
+    f->n_out += size;
+}
+
+static void nvc_format_indent(nvc_formatter_t* f, uint32_t levels) {
+    static const char spaces[] = "                                ";
+    size_t n = (size_t)levels * NVC_FORMAT_INDENT;
+    while (n) {
+        size_t chunk = n < sizeof(spaces) - 1 ? n : sizeof(spaces) - 1;
+        nvc_format_emit(f, spaces, chunk);
+        n -= chunk;
+    }
+}
+
+static uint32_t nvc_format_count_lines(const char* text, size_t len) {
+    uint32_t n = 0;
+    for (const char* p = text; (p = memchr(p, '\n', text + len - p)); ++p)
+        ++n;
+    return n;
+}
+
+// the source of the token at loc, which points at its first char
+// note: only number literals are located at their start, see nvc_lexer_next
+static const char* nvc_format_source(nvc_formatter_t* f,
+                                     const nvc_buffer_location_t* loc) {
+    if (f->ascii) return loc->line + loc->c;
+    const char* p = loc->line;
+    for (uint32_t c = 0; c < loc->c && p < f->buf_end; ++c) {
+        uint32_t cp;
+        size_t len = nvc_utf8_decode(p, f->buf_end, &cp);
+        p += len ? len : 1;
+    }
+    return p;
+}
+
+static bool nvc_format_is_decl(const char* symbol) {
+    return strcmp(symbol, "let") == 0 || strcmp(symbol, "fun") == 0 ||
+           strcmp(symbol, "type") == 0 || strcmp(symbol, "import") == 0;
+}
+
+// the words of a loop header, in, to, with and do are only words there
+static bool nvc_format_is_loop_word(const char* symbol) {
+    return strcmp(symbol, "in") == 0 || strcmp(symbol, "to") == 0 ||
+           strcmp(symbol, "with") == 0 || strcmp(symbol, "do") == 0;
+}
+
+// true when the two operators written next to each other would be lexed as
+// one, e.g. < and = as <=
+static bool nvc_format_joins(nvc_operator_kind_t lhs, nvc_operator_kind_t rhs) {
+    if (lhs == NVC_OP_SUB && rhs == NVC_OP_GT) return true;
+    if (rhs != NVC_OP_EQ) return false;
+    return lhs == NVC_OP_LT || lhs == NVC_OP_GT || lhs == NVC_OP_ADD ||
+           lhs == NVC_OP_SUB || lhs == NVC_OP_MUL || lhs == NVC_OP_DIV ||
+           lhs == NVC_OP_POW;
+}
+
+// whether tok is separated from the token before it on the same line
+static bool nvc_format_spaced(nvc_formatter_t* f, const nvc_tok_t* tok) {
+    if (f->after_comment || tok->kind == NVC_TOK_COMMENT) return true;
+    bool number = tok->kind == NVC_TOK_INT_LIT ||
+                  tok->kind == NVC_TOK_BIG_LIT || tok->kind == NVC_TOK_FP_LIT;
+    bool prev_number = f->prev_kind == NVC_TOK_INT_LIT ||
+                       f->prev_kind == NVC_TOK_BIG_LIT ||
+                       f->prev_kind == NVC_TOK_FP_LIT;
+    if (f->prev_kind == NVC_TOK_OP) {
+        if (tok->kind == NVC_TOK_OP &&
+            nvc_format_joins(f->prev_op, tok->op_kind))
+            return true;
+        // note: .5 would be lexed as one number
+        if (f->prev_op == NVC_OP_DOT) return number;
+        if (f->prev_op == NVC_OP_LPAREN || f->prev_op == NVC_OP_LBRACKET ||
+            f->prev_unary)
+            return false;
+    }
+    if (tok->kind != NVC_TOK_OP) return true;
+    switch (tok->op_kind) {
+        case NVC_OP_COMMA:
+        case NVC_OP_RPAREN:
+        case NVC_OP_RBRACKET:
+        case NVC_OP_TYPE_ANNOTATION: return false;
+        // note: 1. would be lexed as one number
+        case NVC_OP_DOT: return prev_number;
+        case NVC_OP_LPAREN: return !f->prev_callee;
+        case NVC_OP_LBRACKET: return !f->prev_operand;
+        default: return true;
+    }
+}
+
+static void nvc_format_token(nvc_formatter_t* f, const nvc_tok_t* tok) {
+    const char* text = NULL;
+    size_t len = 0;
+    uint32_t start_line = tok->buf_loc.l, end_line = tok->buf_loc.l;
+    switch (tok->kind) {
+        case NVC_TOK_SYMBOL: text = tok->symbol; break;
+        case NVC_TOK_OP: text = nvc_op_to_str(tok->op_kind); break;
+        case NVC_TOK_INT_LIT:
+        case NVC_TOK_BIG_LIT:
+        case NVC_TOK_FP_LIT: {
+            nvc_number_t number;
+            text = nvc_format_source(f, &tok->buf_loc);
+            len = nvc_scan_number(text, f->buf_end, &number);
+            break;
+        }
+        case NVC_TOK_STR_LIT:
+            // note: located at the closing quote
+            text = tok->str_lit ? tok->str_lit : "";
+            start_line -= nvc_format_count_lines(text, strlen(text));
+            break;
+        case NVC_TOK_COMMENT: {
+            // note: located at the opening #
+            const char* end = strchr(tok->comment + 1, '#');
+            text = tok->comment;
+            len = end - text + 1;
+            end_line += nvc_format_count_lines(text, len);
+            break;
+        }
+    }
+    if (!len) len = strlen(text);
+    bool symbol = tok->kind == NVC_TOK_SYMBOL;
+    bool decl = symbol && nvc_format_is_decl(tok->symbol);
+    bool op = tok->kind == NVC_TOK_OP;
+    nvc_operator_kind_t op_kind = op ? tok->op_kind : NVC_OP_UNKNOWN;
+    bool opens = op_kind == NVC_OP_LPAREN || op_kind == NVC_OP_LBRACKET;
+    bool closes = op_kind == NVC_OP_RPAREN || op_kind == NVC_OP_RBRACKET;
+    if (closes && f->depth) --f->depth;
+
+    if (!f->first && (start_line > f->end_line || decl)) {
+        nvc_format_emit(f, "\n", 1);
+        if (start_line > f->end_line + 1) nvc_format_emit(f, "\n", 1);
+        // note: a line at the top level that is not a declaration continues
+        // the one before it
+        bool continues = !f->depth && !decl && !closes &&
+                         tok->kind != NVC_TOK_COMMENT;
+        nvc_format_indent(f, f->depth + continues);
+    } else if (!f->first && nvc_format_spaced(f, tok)) {
+        nvc_format_emit(f, " ", 1);
+    }
+    if (tok->kind == NVC_TOK_STR_LIT) nvc_format_emit(f, "'", 1);
+    nvc_format_emit(f, text, len);
+    if (tok->kind == NVC_TOK_STR_LIT) nvc_format_emit(f, "'", 1);
+    f->first = false;
+    f->end_line = end_line;
+    f->after_comment = tok->kind == NVC_TOK_COMMENT;
+    if (tok->kind == NVC_TOK_COMMENT) return;
+
+    bool keyword = symbol && nvc_is_keyword(tok->symbol);
+    bool word = symbol && f->open_loops && nvc_format_is_loop_word(tok->symbol);
+    if (word && strcmp(tok->symbol, "do") == 0) --f->open_loops;
+    if (symbol && (strcmp(tok->symbol, "for") == 0 ||
+                   strcmp(tok->symbol, "while") == 0))
+        ++f->open_loops;
+    bool unary = f->unary_next &&
+                 (op_kind == NVC_OP_SUB || op_kind == NVC_OP_ADD ||
+                  op_kind == NVC_OP_NEG);
+    bool name = symbol && !keyword && !word;
+    // note: the symbol before the '(' of a type decl or of a fun body after
+    // its return type names a type, it is not called
+    f->prev_callee = name && !f->type_header &&
+                     !(f->prev_kind == NVC_TOK_OP &&
+                       f->prev_op == NVC_OP_RET_DECL);
+    f->prev_operand = name || closes || tok->kind == NVC_TOK_INT_LIT ||
+                      tok->kind == NVC_TOK_BIG_LIT ||
+                      tok->kind == NVC_TOK_FP_LIT ||
+                      tok->kind == NVC_TOK_STR_LIT;
+    f->prev_unary = unary;
+    f->unary_next = (op && !closes) || keyword || word;
+    f->prev_kind = tok->kind;
+    if (op) f->prev_op = tok->op_kind;
+    if (symbol && strcmp(tok->symbol, "type") == 0) f->type_header = true;
+    if (op_kind == NVC_OP_LPAREN) f->type_header = false;
+    if (opens) ++f->depth;
+}
+
+bool nvc_format(nvc_allocator_t* allocator,
+                nvc_diagnostics_t* diags,
+                char* bufname,
+                char* buf,
+                long bufsz,
+                nvc_format_write_t write,
+                void* ctx) {
+    if (!allocator) allocator = nvc_default_allocator();
+    nvc_formatter_t f = {
+        .write = write,
+        .ctx = ctx,
+        .buf_end = buf + bufsz,
+        .first = true,
+        .unary_next = true,
+    };
+    f.out = nvc_alloc(allocator, NVC_FORMAT_BUFFER_SIZE);
+    nvc_tok_t* toks =
+        nvc_alloc(allocator, NVC_FORMAT_BATCH * sizeof(nvc_tok_t));
+    if (!f.out || !toks) {
+        nvc_report(diags, NVC_SEVERITY_ERROR, NULL, "out of memory");
+        nvc_free(allocator, f.out);
+        nvc_free(allocator, toks);
+        return false;
+    }
+
+    uint32_t n_errors = diags->n_errors + diags->n_suppressed;
+    nvc_lexer_t lexer;
+    nvc_lexer_init(&lexer, allocator, diags, bufname, buf, bufsz);
+    lexer.comments = true;
+    f.ascii = lexer.ascii;
+    bool ok = true;
+    while (!lexer.done && !lexer.failed) {
+        uint32_t n = nvc_lexer_next(&lexer, toks, NVC_FORMAT_BATCH);
+        if (diags->n_errors + diags->n_suppressed != n_errors) ok = false;
+        for (uint32_t i = 0; i < n; ++i) {
+            nvc_tok_t* tok = toks + i;
+            if (ok) nvc_format_token(&f, tok);
+            if (tok->kind == NVC_TOK_SYMBOL) nvc_free(allocator, tok->symbol);
+            if (tok->kind == NVC_TOK_STR_LIT) nvc_free(allocator, tok->str_lit);
+            if (tok->kind == NVC_TOK_BIG_LIT) nvc_free(allocator, tok->big_lit);
+        }
+        // note: the rest is lexed only to report its errors too
+    }
+    if (lexer.failed) ok = false;
+    if (ok && !f.first) nvc_format_emit(&f, "\n", 1);
+    if (ok) nvc_format_flush(&f);
+    nvc_free(allocator, f.out);
+    nvc_free(allocator, toks);
+    return ok && !f.failed;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,1930 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nvc_ir.h>
+
+#include <string.h>
+
+bool nvc_ir_is_pure(const nvc_ir_function_t* fun, const nvc_ir_inst_t* inst) {
+    switch (inst->op) {
+        case NVC_IR_CONST:
+        case NVC_IR_IMPORT:
+        case NVC_IR_COPY:
+        case NVC_IR_PHI:
+        case NVC_IR_PARAM:
+        case NVC_IR_BIG:
+        case NVC_IR_ADD:
+        case NVC_IR_SUB:
+        case NVC_IR_MUL:
+        case NVC_IR_NEG:
+        case NVC_IR_NOT:
+        case NVC_IR_LT:
+        case NVC_IR_LE:
+        case NVC_IR_GT:
+        case NVC_IR_GE:
+        case NVC_IR_ITOF:
+        case NVC_IR_CONVERT:
+        case NVC_IR_ARRAY:
+        case NVC_IR_SPLAT:
+        case NVC_IR_RECORD:
+        case NVC_IR_FIELD: return true;
+        case NVC_IR_DIV:
+        case NVC_IR_POW: {
+            if (!nvc_ir_is_integral(inst->type)) return true;
+            // note: int division and power only trap on some divisors and
+            // exponents, they are pure when those are known to be fine. a
+            // divisor that is not small is never zero
+            const nvc_ir_inst_t* rhs = fun->insts + inst->ops[1];
+            if (inst->op == NVC_IR_DIV && rhs->op == NVC_IR_BIG) return true;
+            if (rhs->op != NVC_IR_CONST) return false;
+            uint32_t n = rhs->length ? rhs->length : 1;
+            for (uint32_t k = 0; k < n; ++k) {
+                nvc_ir_inst_t r = *rhs;
+                if (rhs->length) nvc_ir_get_elem(rhs, k, &r);
+                if (inst->op == NVC_IR_POW ? r.i < 0 : r.i == 0)
+                    return false;
+            }
+            return true;
+        }
+        case NVC_IR_INDEX: {
+            // note: pure when the index is known to be in bounds
+            const nvc_ir_inst_t* index = fun->insts + inst->ops[1];
+            return index->op == NVC_IR_CONST && index->i >= 0 &&
+                   (uint64_t)index->i < fun->insts[inst->ops[0]].length;
+        }
+        default: return false;
+    }
+}
+
+// true for the ints whose size is known to be far below
+// NVC_BIGINT_MAX_LIMBS: small constants and conversions from i32 and i64
+static bool nvc_ir_is_bounded(const nvc_ir_function_t* fun,
+                              nvc_ir_value_t value) {
+    nvc_ir_op_t op = fun->insts[value].op;
+    return op == NVC_IR_CONST || op == NVC_IR_CONVERT;
+}
+
+bool nvc_ir_is_speculatable(const nvc_ir_function_t* fun,
+                            const nvc_ir_inst_t* inst) {
+    if (!nvc_ir_is_pure(fun, inst)) return false;
+    if (inst->type != NVC_IR_TYPE_INT) return true;
+    switch (inst->op) {
+        case NVC_IR_ADD:
+        case NVC_IR_SUB:
+        case NVC_IR_MUL:
+        case NVC_IR_NEG:
+        case NVC_IR_NOT:
+            // note: these grow the result by at most the size of the
+            // operands, so it only stays below the limit when they are small
+            for (uint32_t o = 0; o < inst->n_operands; ++o) {
+                if (!nvc_ir_is_bounded(fun, inst->ops[o])) return false;
+            }
+            return true;
+        case NVC_IR_POW: return false;
+        default: return true;
+    }
+}
+
+const char* nvc_ir_type_to_str(nvc_ir_type_t type) {
+    switch (type) {
+        case NVC_IR_TYPE_VOID: return "void";
+        case NVC_IR_TYPE_BOOL: return "bool";
+        case NVC_IR_TYPE_INT: return "int";
+        case NVC_IR_TYPE_FP: return "fp";
+        case NVC_IR_TYPE_STR: return "str";
+        case NVC_IR_TYPE_RECORD: return "record";
+        case NVC_IR_TYPE_I32: return "i32";
+        case NVC_IR_TYPE_I64: return "i64";
+        case NVC_IR_TYPE_F32: return "f32";
+    }
+    return "unknown";
+}
+
+const char* nvc_ir_op_to_str(nvc_ir_op_t op) {
+    switch (op) {
+        case NVC_IR_NOP: return "nop";
+        case NVC_IR_CONST: return "const";
+        case NVC_IR_IMPORT: return "import";
+        case NVC_IR_COPY: return "copy";
+        case NVC_IR_PHI: return "phi";
+        case NVC_IR_PARAM: return "param";
+        case NVC_IR_BIG: return "big";
+        case NVC_IR_ADD: return "add";
+        case NVC_IR_SUB: return "sub";
+        case NVC_IR_MUL: return "mul";
+        case NVC_IR_DIV: return "div";
+        case NVC_IR_POW: return "pow";
+        case NVC_IR_NEG: return "neg";
+        case NVC_IR_NOT: return "not";
+        case NVC_IR_LT: return "lt";
+        case NVC_IR_LE: return "le";
+        case NVC_IR_GT: return "gt";
+        case NVC_IR_GE: return "ge";
+        case NVC_IR_ITOF: return "itof";
+        case NVC_IR_CONVERT: return "convert";
+        case NVC_IR_ARRAY: return "array";
+        case NVC_IR_SPLAT: return "splat";
+        case NVC_IR_INDEX: return "index";
+        case NVC_IR_RECORD: return "record";
+        case NVC_IR_FIELD: return "field";
+        case NVC_IR_EXPORT: return "export";
+        case NVC_IR_CALL: return "call";
+        case NVC_IR_RET: return "ret";
+        case NVC_IR_BR: return "br";
+        case NVC_IR_COND_BR: return "cond_br";
+    }
+    return "unknown";
+}
+
+uint32_t nvc_ir_add_block(nvc_ir_function_t* fun) {
+    // dynamic allocation
+    if (fun->n_blocks >= fun->blocks_capacity) {
+        uint32_t capacity =
+            fun->blocks_capacity ? (fun->blocks_capacity / 2) * 3 : 4;
+        nvc_ir_block_t* grown = nvc_realloc(fun->allocator, fun->blocks,
+                                            capacity * sizeof(nvc_ir_block_t));
+        if (!grown) return NVC_IR_NONE;
+        fun->blocks = grown;
+        fun->blocks_capacity = capacity;
+    }
+    memset(fun->blocks + fun->n_blocks, 0, sizeof(nvc_ir_block_t));
+    return fun->n_blocks++;
+}
+
+// note: appends to a growable uint32_t array, used for block insts and preds
+static bool nvc_ir_push_index(nvc_allocator_t* allocator,
+                              uint32_t** items,
+                              uint32_t* n_items,
+                              uint32_t* capacity,
+                              uint32_t item) {
+    if (*n_items >= *capacity) {
+        uint32_t grown_capacity = *capacity ? (*capacity / 2) * 3 : 4;
+        uint32_t* grown =
+            nvc_realloc(allocator, *items, grown_capacity * sizeof(uint32_t));
+        if (!grown) return false;
+        *items = grown;
+        *capacity = grown_capacity;
+    }
+    (*items)[(*n_items)++] = item;
+    return true;
+}
+
+nvc_ir_value_t nvc_ir_append(nvc_ir_function_t* fun,
+                             uint32_t block,
+                             nvc_ir_op_t op,
+                             nvc_ir_type_t type,
+                             nvc_ir_value_t lhs,
+                             nvc_ir_value_t rhs) {
+    // dynamic allocation
+    if (fun->n_insts >= fun->insts_capacity) {
+        uint32_t capacity =
+            fun->insts_capacity ? (fun->insts_capacity / 2) * 3 : 16;
+        nvc_ir_inst_t* grown = nvc_realloc(fun->allocator, fun->insts,
+                                           capacity * sizeof(nvc_ir_inst_t));
+        if (!grown) return NVC_IR_NONE;
+        fun->insts = grown;
+        fun->insts_capacity = capacity;
+    }
+    nvc_ir_block_t* b = fun->blocks + block;
+    nvc_ir_value_t value = fun->n_insts;
+    if (!nvc_ir_push_index(fun->allocator, &b->insts, &b->n_insts,
+                           &b->capacity, value))
+        return NVC_IR_NONE;
+
+    nvc_ir_inst_t* inst = fun->insts + fun->n_insts++;
+    memset(inst, 0, sizeof(nvc_ir_inst_t));
+    inst->op = op;
+    inst->type = type;
+    inst->block = block;
+    inst->ops[0] = lhs;
+    inst->ops[1] = rhs;
+    inst->n_operands = (lhs != NVC_IR_NONE) + (rhs != NVC_IR_NONE);
+    return value;
+}
+
+bool nvc_ir_add_edge(nvc_ir_function_t* fun, uint32_t from, uint32_t to) {
+    nvc_ir_block_t* b = fun->blocks + to;
+    return nvc_ir_push_index(fun->allocator, &b->preds, &b->n_preds,
+                             &b->preds_capacity, from);
+}
+
+// size bytes freed with fun
+static void* nvc_ir_alloc_owned(nvc_ir_function_t* fun, size_t size) {
+    // dynamic allocation
+    if (fun->n_elems >= fun->elems_capacity) {
+        uint32_t capacity = fun->elems_capacity ? fun->elems_capacity * 2 : 4;
+        void** grown =
+            nvc_realloc(fun->allocator, fun->elems, capacity * sizeof(void*));
+        if (!grown) return NULL;
+        fun->elems = grown;
+        fun->elems_capacity = capacity;
+    }
+    void* elems = nvc_alloc(fun->allocator, size);
+    if (elems) fun->elems[fun->n_elems++] = elems;
+    return elems;
+}
+
+void* nvc_ir_alloc_elems(nvc_ir_function_t* fun,
+                         nvc_ir_type_t type,
+                         uint32_t length) {
+    return nvc_ir_alloc_owned(fun, length * nvc_ir_elem_size(type));
+}
+
+nvc_bigint_t* nvc_ir_alloc_big(nvc_ir_function_t* fun, uint32_t n_limbs) {
+    return nvc_ir_alloc_owned(fun, NVC_BIGINT_SIZE(n_limbs));
+}
+
+void nvc_ir_replace_with_copy(nvc_ir_function_t* fun,
+                              nvc_ir_value_t inst,
+                              nvc_ir_value_t value) {
+    nvc_ir_inst_t* i = fun->insts + inst;
+    if (i->n_operands > 2) nvc_free(fun->allocator, i->many);
+    i->op = NVC_IR_COPY;
+    i->n_operands = 1;
+    i->ops[0] = value;
+    i->ops[1] = NVC_IR_NONE;
+}
+
+static nvc_ir_function_t* nvc_ir_new_function(nvc_ir_module_t* module,
+                                              const char* name) {
+    // dynamic allocation
+    if (module->n_functions >= module->capacity) {
+        uint32_t capacity = module->capacity ? module->capacity * 2 : 4;
+        nvc_ir_function_t** grown =
+            nvc_realloc(module->allocator, module->functions,
+                        capacity * sizeof(nvc_ir_function_t*));
+        if (!grown) return NULL;
+        module->functions = grown;
+        module->capacity = capacity;
+    }
+    nvc_ir_function_t* fun =
+        nvc_calloc(module->allocator, 1, sizeof(nvc_ir_function_t));
+    if (!fun) return NULL;
+    fun->allocator = module->allocator;
+    fun->name = name;
+    module->functions[module->n_functions++] = fun;
+    return fun;
+}
+
+static void nvc_ir_free_function(nvc_ir_function_t* fun) {
+    nvc_allocator_t* allocator = fun->allocator;
+    for (uint32_t i = 0; i < fun->n_insts; ++i) {
+        if (fun->insts[i].n_operands > 2)
+            nvc_free(allocator, fun->insts[i].many);
+    }
+    for (uint32_t i = 0; i < fun->n_blocks; ++i) {
+        nvc_free(allocator, fun->blocks[i].insts);
+        nvc_free(allocator, fun->blocks[i].preds);
+    }
+    for (uint32_t i = 0; i < fun->n_elems; ++i) {
+        nvc_free(allocator, fun->elems[i]);
+    }
+    nvc_free(allocator, fun->elems);
+    nvc_free(allocator, fun->params);
+    nvc_free(allocator, fun->insts);
+    nvc_free(allocator, fun->blocks);
+    nvc_free(allocator, fun);
+}
+
+void nvc_free_ir(nvc_ir_module_t* module) {
+    if (module) {
+        for (uint32_t i = 0; i < module->n_functions; ++i) {
+            nvc_ir_free_function(module->functions[i]);
+        }
+        nvc_free(module->allocator, module->functions);
+        nvc_free(module->allocator, module);
+    }
+}
+
+// marks a fun decl with errors in its signature or body in
+// nvc_lowerer_t.functions, its calls are not reported again
+#define NVC_LOWER_FAILED (UINT32_MAX - 1)
+
+typedef struct {
+    nvc_ir_module_t* module;
+    nvc_ir_function_t* fun;  // being lowered, functions[0] of the module
+                             // unless a fun decl is
+    nvc_diagnostics_t* diags;
+    nvc_sema_t* sema;
+    nvc_ir_value_t* decl_values;  // indexed like sema->decls
+    uint32_t* functions;  // indexed like sema->decls, the index into
+                          // module->functions of a fun decl once it was
+                          // called, NVC_IR_NONE before
+    uint32_t block;       // where instructions are appended
+    const nvc_ast_node_t* use;  // innermost node being lowered that is not
+                                // hash consed, see nvc_node_loc
+    bool out_of_memory;
+} nvc_lowerer_t;
+
+// where to report a problem with node. a hash consed node keeps the
+// location of its first occurrence, so problems with it are reported at the
+// node that uses it instead, otherwise identical problems in later
+// occurrences would be reported at the same place and deduplicated
+static const nvc_buffer_location_t* nvc_node_loc(nvc_lowerer_t* lowerer,
+                                                 const nvc_ast_node_t* node) {
+    if (node->interned && lowerer->use) return &lowerer->use->buf_loc;
+    return &node->buf_loc;
+}
+
+static nvc_ir_value_t nvc_emit(nvc_lowerer_t* lowerer,
+                               nvc_ir_op_t op,
+                               nvc_ir_type_t type,
+                               nvc_ir_value_t lhs,
+                               nvc_ir_value_t rhs,
+                               const nvc_buffer_location_t* loc) {
+    nvc_ir_value_t value =
+        nvc_ir_append(lowerer->fun, lowerer->block, op, type, lhs, rhs);
+    if (value == NVC_IR_NONE) {
+        lowerer->out_of_memory = true;
+        return NVC_IR_NONE;
+    }
+    lowerer->fun->insts[value].buf_loc = *loc;
+    return value;
+}
+
+static nvc_ir_value_t nvc_emit_array(nvc_lowerer_t* lowerer,
+                                     nvc_ir_op_t op,
+                                     nvc_ir_type_t type,
+                                     uint32_t length,
+                                     nvc_ir_value_t lhs,
+                                     nvc_ir_value_t rhs,
+                                     const nvc_buffer_location_t* loc) {
+    nvc_ir_value_t value = nvc_emit(lowerer, op, type, lhs, rhs, loc);
+    if (value != NVC_IR_NONE) lowerer->fun->insts[value].length = length;
+    return value;
+}
+
+static inline nvc_ir_type_t nvc_value_type(nvc_lowerer_t* lowerer,
+                                           nvc_ir_value_t value) {
+    return lowerer->fun->insts[value].type;
+}
+
+static inline uint32_t nvc_value_length(nvc_lowerer_t* lowerer,
+                                        nvc_ir_value_t value) {
+    return lowerer->fun->insts[value].length;
+}
+
+// the type of value for messages, e.g. int, fp[3] or the name of a record
+// type
+static const char* nvc_value_type_str(nvc_lowerer_t* lowerer,
+                                      nvc_ir_value_t value,
+                                      char* buf,
+                                      size_t size) {
+    nvc_ir_inst_t* inst = lowerer->fun->insts + value;
+    if (inst->layout) return inst->layout->name;
+    if (!inst->length) return nvc_ir_type_to_str(inst->type);
+    snprintf(buf, size, "%s[%u]", nvc_ir_type_to_str(inst->type),
+             inst->length);
+    return buf;
+}
+
+static nvc_ir_value_t nvc_lower_expr(nvc_lowerer_t* lowerer,
+                                     nvc_ast_node_t* node);
+static void nvc_lower_let(nvc_lowerer_t* lowerer, nvc_ast_node_t* node);
+
+// value as a constant of the fixed width type when it is an int or fp
+// constant that fits, value itself otherwise. the lowering only makes such
+// constants from literals without a suffix (and lets of them), so they take
+// the width of what they are used with: int constants become any fixed
+// width number and fp constants f32s
+static nvc_ir_value_t nvc_lower_adopt(nvc_lowerer_t* lowerer,
+                                      nvc_ir_value_t value,
+                                      nvc_ir_type_t type,
+                                      const nvc_buffer_location_t* loc) {
+    const nvc_ir_inst_t* inst = lowerer->fun->insts + value;
+    if (!nvc_ir_is_fixed(type) || inst->length ||
+        (inst->op != NVC_IR_CONST && inst->op != NVC_IR_BIG))
+        return value;
+    nvc_int i = 0;
+    nvc_fp fp = 0;
+    if (inst->type == NVC_IR_TYPE_FP) {
+        if (type != NVC_IR_TYPE_F32) return value;
+        fp = nvc_round_f32(inst->fp);
+    } else if (inst->type != NVC_IR_TYPE_INT) {
+        return value;
+    } else if (type == NVC_IR_TYPE_F32) {
+        fp = inst->op == NVC_IR_BIG ? nvc_round_f32(nvc_bigint_to_fp(inst->big))
+                                    : nvc_int_to_f32(inst->i);
+    } else {
+        i = inst->i;
+        if (inst->op == NVC_IR_BIG && !nvc_bigint_get_i64(inst->big, &i))
+            return value;
+        if (type == NVC_IR_TYPE_I32 && i != nvc_wrap_i32(i)) return value;
+    }
+    nvc_ir_value_t adopted = nvc_emit(lowerer, NVC_IR_CONST, type,
+                                      NVC_IR_NONE, NVC_IR_NONE, loc);
+    if (adopted == NVC_IR_NONE) return NVC_IR_NONE;
+    if (nvc_ir_is_integral(type))
+        lowerer->fun->insts[adopted].i = i;
+    else
+        lowerer->fun->insts[adopted].fp = fp;
+    return adopted;
+}
+
+// value as an argument, field, loop body or return value of the given type,
+// ints are converted to fps and constants take fixed widths (see
+// nvc_lower_adopt). NVC_IR_NONE when the types do not match
+static nvc_ir_value_t nvc_lower_conversion(nvc_lowerer_t* lowerer,
+                                           nvc_ir_value_t value,
+                                           nvc_ir_type_t type,
+                                           uint32_t length,
+                                           const nvc_type_layout_t* layout,
+                                           const nvc_buffer_location_t* loc) {
+    nvc_ir_inst_t* inst = lowerer->fun->insts + value;
+    if (inst->length != length || inst->layout != layout) return NVC_IR_NONE;
+    if (inst->type == type) return value;
+    nvc_ir_value_t converted;
+    if (nvc_ir_is_fixed(type)) {
+        converted = nvc_lower_adopt(lowerer, value, type, loc);
+        if (converted == value) return NVC_IR_NONE;
+    } else if (inst->type == NVC_IR_TYPE_INT && type == NVC_IR_TYPE_FP) {
+        converted = nvc_emit_array(lowerer, NVC_IR_ITOF, type, length, value,
+                                   NVC_IR_NONE, loc);
+    } else {
+        return NVC_IR_NONE;
+    }
+    // note: out of memory is not a type error, it is checked by the caller
+    return converted == NVC_IR_NONE ? value : converted;
+}
+
+// after a type error between numbers of the types to and from, tells how
+// the conversions (see nvc_lower_convert) make one of the other
+static void nvc_note_conversion(nvc_lowerer_t* lowerer,
+                                nvc_ir_type_t to,
+                                nvc_ir_type_t from) {
+    if (!nvc_ir_is_numeric(to) || !nvc_ir_is_numeric(from) || to == from)
+        return;
+    if (to == NVC_IR_TYPE_INT && !nvc_ir_is_integral(from))
+        nvc_report(lowerer->diags, NVC_SEVERITY_NOTE, NULL,
+                   "fps become ints through i64, e.g. int(i64(<value>)), "
+                   "which truncates");
+    else if (nvc_ir_is_fixed(to) || nvc_ir_is_fixed(from))
+        nvc_report(lowerer->diags, NVC_SEVERITY_NOTE, NULL,
+                   "convert it with %s(<value>)", nvc_ir_type_to_str(to));
+}
+
+static nvc_ir_value_t nvc_lower_unary(nvc_lowerer_t* lowerer,
+                                      nvc_unary_op_kind_t op,
+                                      nvc_ir_value_t operand,
+                                      const nvc_buffer_location_t* loc) {
+    if (operand == NVC_IR_NONE) return NVC_IR_NONE;
+    nvc_ir_type_t type = nvc_value_type(lowerer, operand);
+    uint32_t length = nvc_value_length(lowerer, operand);
+    const nvc_ir_inst_t* inst = lowerer->fun->insts + operand;
+    switch (op) {
+        case NVC_UN_OP_ADD:
+            if (nvc_ir_is_numeric(type)) return operand;
+            break;
+        case NVC_UN_OP_SUB: {
+            if (!nvc_ir_is_numeric(type)) break;
+            // note: negated constants stay constants so they take fixed
+            // widths like the literals, see nvc_lower_adopt
+            bool fold = inst->op == NVC_IR_CONST && !length &&
+                        ((type == NVC_IR_TYPE_INT &&
+                          inst->i != NVC_SMALL_INT_MIN) ||
+                         type == NVC_IR_TYPE_FP);
+            if (!fold)
+                return nvc_emit_array(lowerer, NVC_IR_NEG, type, length,
+                                      operand, NVC_IR_NONE, loc);
+            nvc_ir_inst_t c = *inst;
+            nvc_ir_value_t value = nvc_emit(lowerer, NVC_IR_CONST, type,
+                                            NVC_IR_NONE, NVC_IR_NONE, loc);
+            if (value == NVC_IR_NONE) return NVC_IR_NONE;
+            if (type == NVC_IR_TYPE_INT)
+                lowerer->fun->insts[value].i = -c.i;
+            else
+                lowerer->fun->insts[value].fp = -c.fp;
+            return value;
+        }
+        case NVC_UN_OP_NEG:
+            if (nvc_ir_is_integral(type) || type == NVC_IR_TYPE_BOOL)
+                return nvc_emit_array(lowerer, NVC_IR_NOT, type, length,
+                                      operand, NVC_IR_NONE, loc);
+            break;
+        default: break;
+    }
+    // note: the indices match nvc_operator_kind_t
+    char buf[32];
+    nvc_report(lowerer->diags, NVC_SEVERITY_ERROR, loc,
+               "operator '%s' is not defined for %s",
+               nvc_op_to_str((nvc_operator_kind_t)op),
+               nvc_value_type_str(lowerer, operand, buf, sizeof(buf)));
+    return NVC_IR_NONE;
+}
+
+static nvc_ir_value_t nvc_lower_binary(nvc_lowerer_t* lowerer,
+                                       nvc_binary_op_kind_t op,
+                                       nvc_ir_value_t lhs,
+                                       nvc_ir_value_t rhs,
+                                       const nvc_buffer_location_t* loc) {
+    if (lhs == NVC_IR_NONE || rhs == NVC_IR_NONE) return NVC_IR_NONE;
+    // a constant takes the fixed width type of the other operand
+    if (nvc_ir_is_fixed(nvc_value_type(lowerer, lhs)))
+        rhs = nvc_lower_adopt(lowerer, rhs, nvc_value_type(lowerer, lhs), loc);
+    else if (nvc_ir_is_fixed(nvc_value_type(lowerer, rhs)))
+        lhs = nvc_lower_adopt(lowerer, lhs, nvc_value_type(lowerer, rhs), loc);
+    if (lhs == NVC_IR_NONE || rhs == NVC_IR_NONE) return NVC_IR_NONE;
+    nvc_ir_type_t lhs_type = nvc_value_type(lowerer, lhs);
+    nvc_ir_type_t rhs_type = nvc_value_type(lowerer, rhs);
+    uint32_t lhs_length = nvc_value_length(lowerer, lhs);
+    uint32_t rhs_length = nvc_value_length(lowerer, rhs);
+    bool numeric = nvc_ir_is_numeric(lhs_type) && nvc_ir_is_numeric(rhs_type);
+    bool fixed = nvc_ir_is_fixed(lhs_type) || nvc_ir_is_fixed(rhs_type);
+    if (!numeric || (lhs_length && rhs_length && lhs_length != rhs_length) ||
+        (fixed && lhs_type != rhs_type)) {
+        char lhs_buf[32], rhs_buf[32];
+        nvc_report(lowerer->diags, NVC_SEVERITY_ERROR, loc,
+                   "operator '%s' is not defined for %s and %s",
+                   nvc_op_to_str((nvc_operator_kind_t)op),
+                   nvc_value_type_str(lowerer, lhs, lhs_buf, sizeof(lhs_buf)),
+                   nvc_value_type_str(lowerer, rhs, rhs_buf, sizeof(rhs_buf)));
+        if (numeric && fixed && lhs_type != rhs_type)
+            nvc_report(lowerer->diags, NVC_SEVERITY_NOTE, NULL,
+                       "convert one of them, e.g. with %s(<value>)",
+                       nvc_ir_type_to_str(nvc_ir_is_fixed(lhs_type)
+                                              ? lhs_type
+                                              : rhs_type));
+        else if (numeric)
+            nvc_report(lowerer->diags, NVC_SEVERITY_NOTE, NULL,
+                       "element-wise operators need arrays of the same "
+                       "length");
+        return NVC_IR_NONE;
+    }
+
+    // mixed ints and fps are computed in fp
+    nvc_ir_type_t type = lhs_type;
+    if (lhs_type != rhs_type) {
+        type = NVC_IR_TYPE_FP;
+        if (lhs_type == NVC_IR_TYPE_INT)
+            lhs = nvc_emit_array(lowerer, NVC_IR_ITOF, type, lhs_length, lhs,
+                                 NVC_IR_NONE, loc);
+        else
+            rhs = nvc_emit_array(lowerer, NVC_IR_ITOF, type, rhs_length, rhs,
+                                 NVC_IR_NONE, loc);
+        if (lhs == NVC_IR_NONE || rhs == NVC_IR_NONE) return NVC_IR_NONE;
+    }
+
+    // a scalar operand of an array operation applies to every element
+    uint32_t length = lhs_length ? lhs_length : rhs_length;
+    if (length && !lhs_length)
+        lhs = nvc_emit_array(lowerer, NVC_IR_SPLAT, type, length, lhs,
+                             NVC_IR_NONE, loc);
+    if (length && !rhs_length)
+        rhs = nvc_emit_array(lowerer, NVC_IR_SPLAT, type, length, rhs,
+                             NVC_IR_NONE, loc);
+    if (lhs == NVC_IR_NONE || rhs == NVC_IR_NONE) return NVC_IR_NONE;
+
+    nvc_ir_op_t ir_op = NVC_IR_NOP;
+    switch (op) {
+        case NVC_BIN_OP_LT: ir_op = NVC_IR_LT; break;
+        case NVC_BIN_OP_LE: ir_op = NVC_IR_LE; break;
+        case NVC_BIN_OP_GT: ir_op = NVC_IR_GT; break;
+        case NVC_BIN_OP_GE: ir_op = NVC_IR_GE; break;
+        case NVC_BIN_OP_ADD: ir_op = NVC_IR_ADD; break;
+        case NVC_BIN_OP_SUB: ir_op = NVC_IR_SUB; break;
+        case NVC_BIN_OP_MUL: ir_op = NVC_IR_MUL; break;
+        case NVC_BIN_OP_DIV: ir_op = NVC_IR_DIV; break;
+        case NVC_BIN_OP_POW: ir_op = NVC_IR_POW; break;
+        default: return NVC_IR_NONE;
+    }
+    if (ir_op >= NVC_IR_LT && ir_op <= NVC_IR_GE) type = NVC_IR_TYPE_BOOL;
+    return nvc_emit_array(lowerer, ir_op, type, length, lhs, rhs, loc);
+}
+
+static int nvc_binary_precedence(nvc_binary_op_kind_t op) {
+    switch (op) {
+        case NVC_BIN_OP_LT:
+        case NVC_BIN_OP_LE:
+        case NVC_BIN_OP_GT:
+        case NVC_BIN_OP_GE: return 1;
+        case NVC_BIN_OP_ADD:
+        case NVC_BIN_OP_SUB: return 2;
+        case NVC_BIN_OP_MUL:
+        case NVC_BIN_OP_DIV: return 3;
+        case NVC_BIN_OP_POW: return 4;
+        default: return 0;
+    }
+}
+
+// [unary ops] operand at *pos, the unary ops apply right to left
+static nvc_ir_value_t nvc_lower_operand(nvc_lowerer_t* lowerer,
+                                        nvc_ast_node_t* chain,
+                                        uint32_t* pos) {
+    nvc_ast_chain_elem_t** elems = chain->op_chain.elems;
+    uint32_t first = *pos;
+    while (elems[*pos]->kind == NVC_CHAIN_ELEM_UNARY_OP) ++*pos;
+    nvc_ast_node_t* node = elems[(*pos)++]->node;
+    nvc_ir_value_t value = nvc_lower_expr(lowerer, node);
+    for (uint32_t i = *pos - 1; i-- > first;) {
+        value = nvc_lower_unary(lowerer, elems[i]->unary_op_kind, value,
+                                nvc_node_loc(lowerer, node));
+    }
+    return value;
+}
+
+// precedence climbing over the flat chain, only binary ops binding at least
+// as tight as min_precedence are consumed
+static nvc_ir_value_t nvc_lower_chain(nvc_lowerer_t* lowerer,
+                                      nvc_ast_node_t* chain,
+                                      uint32_t* pos,
+                                      int min_precedence) {
+    nvc_ast_op_chain_t* op_chain = &chain->op_chain;
+    nvc_ir_value_t lhs = nvc_lower_operand(lowerer, chain, pos);
+    while (*pos < op_chain->n_elems) {
+        nvc_binary_op_kind_t op = op_chain->elems[*pos]->binary_op_kind;
+        int precedence = nvc_binary_precedence(op);
+        if (precedence < min_precedence) break;
+        ++*pos;
+        nvc_ir_value_t rhs = nvc_lower_chain(
+            lowerer, chain, pos,
+            op == NVC_BIN_OP_POW ? precedence : precedence + 1);
+        lhs = nvc_lower_binary(lowerer, op, lhs, rhs,
+                               nvc_node_loc(lowerer, chain));
+    }
+    return lhs;
+}
+
+static nvc_ir_value_t nvc_lower_ref(nvc_lowerer_t* lowerer,
+                                    nvc_ast_node_t* node) {
+    uint32_t index = node->symbol_ref.decl;
+    // note: unresolved symbols were reported by nvc_resolve
+    if (index == NVC_DECL_UNRESOLVED) return NVC_IR_NONE;
+    nvc_decl_t* decl = lowerer->sema->decls + index;
+    switch (decl->kind) {
+        case NVC_DECL_LET:
+            if (decl->scope_depth == 0 &&
+                lowerer->fun != lowerer->module->functions[0]) {
+                nvc_report(lowerer->diags, NVC_SEVERITY_ERROR, &node->buf_loc,
+                           "function '%s' can not use the let '%s' of the "
+                           "module",
+                           lowerer->fun->name, decl->name);
+                nvc_report(lowerer->diags, NVC_SEVERITY_NOTE, NULL,
+                           "pass it as a parameter instead");
+                return NVC_IR_NONE;
+            }
+            return lowerer->decl_values[index];
+        case NVC_DECL_PARAM:
+        case NVC_DECL_LOOP: return lowerer->decl_values[index];
+        case NVC_DECL_TYPE: goto type;
+        case NVC_DECL_IMPORT: {
+            const nvc_decl_t* target = decl->module->decls + decl->module_decl;
+            if (target->kind == NVC_DECL_TYPE) goto type;
+            if (target->kind != NVC_DECL_LET) break;
+            // note: no type means the exporting module failed, it reported
+            // why already
+            if (target->value_type == NVC_IR_TYPE_VOID) return NVC_IR_NONE;
+            nvc_ir_value_t value = nvc_emit_array(
+                lowerer, NVC_IR_IMPORT, target->value_type,
+                target->value_length, NVC_IR_NONE, NVC_IR_NONE,
+                &node->buf_loc);
+            if (value == NVC_IR_NONE) return NVC_IR_NONE;
+            nvc_ir_inst_t* inst = lowerer->fun->insts + value;
+            inst->import.module = decl->module;
+            inst->import.decl = decl->module_decl;
+            inst->name = decl->name;
+            inst->layout = target->value_layout;
+            return value;
+        }
+        default: break;
+    }
+    nvc_report(lowerer->diags, NVC_SEVERITY_ERROR, &node->buf_loc,
+               "'%s' can not be used as a value yet", decl->name);
+    return NVC_IR_NONE;
+type:
+    nvc_report(lowerer->diags, NVC_SEVERITY_ERROR, &node->buf_loc,
+               "type '%s' can not be used as a value", decl->name);
+    nvc_report(lowerer->diags, NVC_SEVERITY_NOTE, NULL,
+               "a value of it is made with %s(<field values>)", decl->name);
+    return NVC_IR_NONE;
+}
+
+// the type of an int or fp literal, from its suffix
+static nvc_ir_type_t nvc_literal_type(const nvc_ast_node_t* node) {
+    switch (node->width) {
+        case NVC_WIDTH_I32: return NVC_IR_TYPE_I32;
+        case NVC_WIDTH_I64: return NVC_IR_TYPE_I64;
+        case NVC_WIDTH_F32: return NVC_IR_TYPE_F32;
+        default:
+            return node->kind == NVC_AST_NODE_FP_LIT ? NVC_IR_TYPE_FP
+                                                     : NVC_IR_TYPE_INT;
+    }
+}
+
+// the value of a small int or fp literal with any amount of unary + and - in
+// front, false for anything else. literals with a suffix have its type
+static bool nvc_literal_value(nvc_ast_node_t* node,
+                              nvc_ir_type_t* type,
+                              nvc_int* i,
+                              nvc_fp* fp) {
+    bool negate = false;
+    if (node->kind == NVC_AST_NODE_OP_CHAIN) {
+        nvc_ast_op_chain_t* chain = &node->op_chain;
+        for (uint32_t k = 0; k + 1 < chain->n_elems; ++k) {
+            nvc_ast_chain_elem_t* elem = chain->elems[k];
+            if (elem->kind != NVC_CHAIN_ELEM_UNARY_OP ||
+                elem->unary_op_kind == NVC_UN_OP_NEG)
+                return false;
+            if (elem->unary_op_kind == NVC_UN_OP_SUB) negate = !negate;
+        }
+        nvc_ast_chain_elem_t* last = chain->elems[chain->n_elems - 1];
+        if (last->kind != NVC_CHAIN_ELEM_NODE) return false;
+        node = last->node;
+    }
+    switch (node->kind) {
+        case NVC_AST_NODE_INT_LIT:
+            *type = nvc_literal_type(node);
+            // note: the literal is never negative so its negation is small
+            // (or fits its suffix) too
+            *i = negate ? -node->i : node->i;
+            return node->width || node->i <= NVC_SMALL_INT_MAX;
+        case NVC_AST_NODE_BIG_LIT: *type = NVC_IR_TYPE_INT; return false;
+        case NVC_AST_NODE_FP_LIT:
+            *type = nvc_literal_type(node);
+            *fp = negate ? -node->fp : node->fp;
+            return true;
+        default: return false;
+    }
+}
+
+// an array of literals only, it becomes one constant without an instruction
+// per element
+static nvc_ir_value_t nvc_lower_const_array(nvc_lowerer_t* lowerer,
+                                            nvc_ast_node_t* node,
+                                            nvc_ir_type_t type) {
+    nvc_ast_array_lit_t* lit = &node->array_lit;
+    void* elems = nvc_ir_alloc_elems(lowerer->fun, type, lit->n_elems);
+    if (!elems) {
+        lowerer->out_of_memory = true;
+        return NVC_IR_NONE;
+    }
+    for (uint32_t k = 0; k < lit->n_elems; ++k) {
+        nvc_ir_type_t elem_type;
+        nvc_int i = 0;
+        nvc_fp fp = 0;
+        nvc_literal_value(lit->elems[k], &elem_type, &i, &fp);
+        nvc_ir_inst_t c = {0};
+        if (nvc_ir_is_integral(type))
+            c.i = i;
+        else if (!nvc_ir_is_integral(elem_type))
+            c.fp = fp;
+        else
+            c.fp = type == NVC_IR_TYPE_F32 ? nvc_int_to_f32(i) : (nvc_fp)i;
+        nvc_ir_set_elem(elems, type, k, &c);
+    }
+    nvc_ir_value_t value =
+        nvc_emit_array(lowerer, NVC_IR_CONST, type, lit->n_elems, NVC_IR_NONE,
+                       NVC_IR_NONE, nvc_node_loc(lowerer, node));
+    if (value != NVC_IR_NONE) lowerer->fun->insts[value].ints = elems;
+    return value;
+}
+
+// the type of an array of literals only, like the one nvc_lower_array
+// gives arrays of values. void when not every element is a literal or when
+// they do not agree, nvc_lower_array reports why then
+static nvc_ir_type_t nvc_literal_array_type(nvc_ast_array_lit_t* lit) {
+    nvc_ir_type_t type = NVC_IR_TYPE_INT;
+    for (uint32_t k = 0; k < lit->n_elems; ++k) {
+        nvc_ir_type_t elem_type;
+        nvc_int i;
+        nvc_fp fp;
+        if (!nvc_literal_value(lit->elems[k], &elem_type, &i, &fp))
+            return NVC_IR_TYPE_VOID;
+        if (nvc_ir_is_fixed(elem_type)) {
+            if (nvc_ir_is_fixed(type) && type != elem_type)
+                return NVC_IR_TYPE_VOID;
+            type = elem_type;
+        } else if (elem_type == NVC_IR_TYPE_FP && !nvc_ir_is_fixed(type)) {
+            type = NVC_IR_TYPE_FP;
+        }
+    }
+    // note: the literals without a suffix take the fixed width, like
+    // nvc_lower_adopt they need to fit it
+    for (uint32_t k = 0; k < lit->n_elems && nvc_ir_is_fixed(type); ++k) {
+        nvc_ir_type_t elem_type;
+        nvc_int i = 0;
+        nvc_fp fp;
+        nvc_literal_value(lit->elems[k], &elem_type, &i, &fp);
+        if ((elem_type == NVC_IR_TYPE_FP && type != NVC_IR_TYPE_F32) ||
+            (elem_type == NVC_IR_TYPE_INT && type == NVC_IR_TYPE_I32 &&
+             i != nvc_wrap_i32(i)))
+            return NVC_IR_TYPE_VOID;
+    }
+    return type;
+}
+
+static nvc_ir_value_t nvc_lower_array(nvc_lowerer_t* lowerer,
+                                      nvc_ast_node_t* node) {
+    nvc_ast_array_lit_t* lit = &node->array_lit;
+    if (!lit->n_elems) {
+        nvc_report(lowerer->diags, NVC_SEVERITY_ERROR,
+                   nvc_node_loc(lowerer, node), "empty array literal");
+        nvc_report(lowerer->diags, NVC_SEVERITY_NOTE, NULL,
+                   "the element type is taken from the elements");
+        return NVC_IR_NONE;
+    }
+
+    nvc_ir_type_t type = nvc_literal_array_type(lit);
+    if (type != NVC_IR_TYPE_VOID)
+        return nvc_lower_const_array(lowerer, node, type);
+
+    nvc_allocator_t* allocator = lowerer->fun->allocator;
+    nvc_ir_value_t* values =
+        nvc_alloc(allocator, lit->n_elems * sizeof(nvc_ir_value_t));
+    if (!values) {
+        lowerer->out_of_memory = true;
+        return NVC_IR_NONE;
+    }
+    nvc_ir_value_t value = NVC_IR_NONE;
+    bool ok = true;
+    char buf[32];
+    // note: the first element with a fixed width gives it to the constants
+    // among the others, like a fixed width operand does
+    nvc_ir_type_t fixed = NVC_IR_TYPE_VOID;
+    for (uint32_t k = 0; k < lit->n_elems; ++k) {
+        values[k] = nvc_lower_expr(lowerer, lit->elems[k]);
+        if (values[k] == NVC_IR_NONE) {
+            ok = false;
+            continue;
+        }
+        nvc_ir_type_t elem_type = nvc_value_type(lowerer, values[k]);
+        if (nvc_ir_is_fixed(elem_type) && fixed == NVC_IR_TYPE_VOID)
+            fixed = elem_type;
+    }
+    if (!ok) goto out;
+    type = NVC_IR_TYPE_VOID;
+    for (uint32_t k = 0; k < lit->n_elems; ++k) {
+        if (fixed != NVC_IR_TYPE_VOID)
+            values[k] = nvc_lower_adopt(lowerer, values[k], fixed,
+                                        nvc_node_loc(lowerer, lit->elems[k]));
+        if (values[k] == NVC_IR_NONE) goto out;
+        nvc_ir_type_t elem_type = nvc_value_type(lowerer, values[k]);
+        if (nvc_value_length(lowerer, values[k]) ||
+            (!nvc_ir_is_numeric(elem_type) &&
+             elem_type != NVC_IR_TYPE_BOOL)) {
+            nvc_report(lowerer->diags, NVC_SEVERITY_ERROR,
+                       nvc_node_loc(lowerer, lit->elems[k]),
+                       "array elements must be numbers or bools, not %s",
+                       nvc_value_type_str(lowerer, values[k], buf,
+                                          sizeof(buf)));
+            ok = false;
+        } else if (type == NVC_IR_TYPE_VOID || type == elem_type) {
+            type = elem_type;
+        } else if (fixed == NVC_IR_TYPE_VOID && nvc_ir_is_numeric(type) &&
+                   nvc_ir_is_numeric(elem_type)) {
+            // mixed ints and fps are fps like mixed operands
+            type = NVC_IR_TYPE_FP;
+        } else {
+            nvc_report(lowerer->diags, NVC_SEVERITY_ERROR,
+                       nvc_node_loc(lowerer, lit->elems[k]),
+                       "array of %s can not hold a %s",
+                       nvc_ir_type_to_str(type),
+                       nvc_ir_type_to_str(elem_type));
+            nvc_note_conversion(lowerer, type, elem_type);
+            ok = false;
+        }
+    }
+    if (!ok) goto out;
+
+    for (uint32_t k = 0; k < lit->n_elems && type == NVC_IR_TYPE_FP; ++k) {
+        if (nvc_value_type(lowerer, values[k]) != NVC_IR_TYPE_INT) continue;
+        values[k] = nvc_emit(lowerer, NVC_IR_ITOF, type, values[k],
+                             NVC_IR_NONE, nvc_node_loc(lowerer, lit->elems[k]));
+        if (values[k] == NVC_IR_NONE) goto out;
+    }
+    value = nvc_emit_array(lowerer, NVC_IR_ARRAY, type, lit->n_elems,
+                           NVC_IR_NONE, NVC_IR_NONE,
+                           nvc_node_loc(lowerer, node));
+    if (value == NVC_IR_NONE) goto out;
+    nvc_ir_inst_t* inst = lowerer->fun->insts + value;
+    inst->n_operands = lit->n_elems;
+    if (lit->n_elems > 2) {
+        inst->many = values;
+        values = NULL;
+    } else {
+        memcpy(inst->ops, values, lit->n_elems * sizeof(nvc_ir_value_t));
+    }
+out:
+    nvc_free(allocator, values);
+    return value;
+}
+
+static nvc_ir_value_t nvc_lower_index(nvc_lowerer_t* lowerer,
+                                      nvc_ast_node_t* node) {
+    nvc_ir_value_t base = nvc_lower_expr(lowerer, node->index.base);
+    nvc_ir_value_t index = nvc_lower_expr(lowerer, node->index.index);
+    if (base == NVC_IR_NONE || index == NVC_IR_NONE) return NVC_IR_NONE;
+
+    char buf[32];
+    uint32_t length = nvc_value_length(lowerer, base);
+    if (!length) {
+        nvc_report(lowerer->diags, NVC_SEVERITY_ERROR,
+                   nvc_node_loc(lowerer, node),
+                   "only arrays can be indexed, not %s",
+                   nvc_value_type_str(lowerer, base, buf, sizeof(buf)));
+        return NVC_IR_NONE;
+    }
+    if (!nvc_ir_is_integral(nvc_value_type(lowerer, index)) ||
+        nvc_value_length(lowerer, index)) {
+        nvc_report(lowerer->diags, NVC_SEVERITY_ERROR,
+                   nvc_node_loc(lowerer, node->index.index),
+                   "array index must be an int, not %s",
+                   nvc_value_type_str(lowerer, index, buf, sizeof(buf)));
+        return NVC_IR_NONE;
+    }
+    // note: indices only known at run time trap there
+    nvc_ir_type_t type;
+    nvc_int i;
+    nvc_fp fp;
+    if (nvc_literal_value(node->index.index, &type, &i, &fp) &&
+        (i < 0 || (uint64_t)i >= length)) {
+        nvc_report(lowerer->diags, NVC_SEVERITY_ERROR,
+                   nvc_node_loc(lowerer, node->index.index),
+                   "index %ld is out of bounds for an array of %u elements",
+                   i, length);
+        return NVC_IR_NONE;
+    }
+    return nvc_emit(lowerer, NVC_IR_INDEX, nvc_value_type(lowerer, base), base,
+                    index, nvc_node_loc(lowerer, node));
+}
+
+// the type of field for messages, like nvc_value_type_str
+static const char* nvc_field_type_str(const nvc_field_layout_t* field,
+                                      char* buf,
+                                      size_t size) {
+    if (field->record) return field->record->name;
+    if (!field->length) return nvc_ir_type_to_str(field->type);
+    snprintf(buf, size, "%s[%u]", nvc_ir_type_to_str(field->type),
+             field->length);
+    return buf;
+}
+
+// the value of field k of a new record, converted like an argument
+static nvc_ir_value_t nvc_lower_field_value(nvc_lowerer_t* lowerer,
+                                            const nvc_type_layout_t* layout,
+                                            uint32_t k,
+                                            nvc_ast_node_t* arg) {
+    nvc_ir_value_t value = nvc_lower_expr(lowerer, arg);
+    if (value == NVC_IR_NONE) return NVC_IR_NONE;
+    const nvc_field_layout_t* field = layout->fields + k;
+    nvc_ir_value_t converted =
+        nvc_lower_conversion(lowerer, value, field->type, field->length,
+                             field->record, nvc_node_loc(lowerer, arg));
+    if (converted != NVC_IR_NONE) return converted;
+    char value_buf[32], field_buf[32];
+    nvc_report(lowerer->diags, NVC_SEVERITY_ERROR, nvc_node_loc(lowerer, arg),
+               "field '%s' of %s is %s, not %s", field->name, layout->name,
+               nvc_field_type_str(field, field_buf, sizeof(field_buf)),
+               nvc_value_type_str(lowerer, value, value_buf,
+                                  sizeof(value_buf)));
+    nvc_note_conversion(lowerer, field->type, nvc_value_type(lowerer, value));
+    return NVC_IR_NONE;
+}
+
+// a new record of type layout, the arguments are the fields in declaration
+// order
+static nvc_ir_value_t nvc_lower_record(nvc_lowerer_t* lowerer,
+                                       nvc_ast_node_t* node,
+                                       const nvc_type_layout_t* layout) {
+    nvc_ast_call_t* call = &node->call;
+    if (call->n_args != layout->n_fields) {
+        nvc_report(lowerer->diags, NVC_SEVERITY_ERROR, &node->buf_loc,
+                   "type '%s' has %u fields but %u values were given",
+                   layout->name, layout->n_fields, call->n_args);
+        return NVC_IR_NONE;
+    }
+    nvc_allocator_t* allocator = lowerer->fun->allocator;
+    nvc_ir_value_t* values =
+        nvc_alloc(allocator, call->n_args * sizeof(nvc_ir_value_t));
+    if (!values) {
+        lowerer->out_of_memory = true;
+        return NVC_IR_NONE;
+    }
+    nvc_ir_value_t value = NVC_IR_NONE;
+    bool ok = true;
+    for (uint32_t k = 0; k < call->n_args; ++k) {
+        values[k] = nvc_lower_field_value(lowerer, layout, k, call->args[k]);
+        if (values[k] == NVC_IR_NONE) ok = false;
+    }
+    if (!ok) goto out;
+
+    value = nvc_emit(lowerer, NVC_IR_RECORD, NVC_IR_TYPE_RECORD, NVC_IR_NONE,
+                     NVC_IR_NONE, &node->buf_loc);
+    if (value == NVC_IR_NONE) goto out;
+    nvc_ir_inst_t* inst = lowerer->fun->insts + value;
+    inst->layout = layout;
+    inst->n_operands = call->n_args;
+    if (call->n_args > 2) {
+        inst->many = values;
+        values = NULL;
+    } else {
+        memcpy(inst->ops, values, call->n_args * sizeof(nvc_ir_value_t));
+    }
+out:
+    nvc_free(allocator, values);
+    return value;
+}
+
+// the type a parameter or the return value is declared with, false when
+// the type is invalid (nvc_resolve reported why)
+static bool nvc_signature_type(nvc_lowerer_t* lowerer,
+                               const char* type_name,
+                               uint32_t type_decl,
+                               nvc_ir_type_t* type,
+                               const nvc_type_layout_t** layout) {
+    *layout = NULL;
+    if (type_decl == NVC_DECL_UNRESOLVED) {
+        uint32_t builtin;
+        if (!nvc_builtin_type(type_name, &builtin)) return false;
+        *type = (nvc_ir_type_t)builtin;
+        return true;
+    }
+    const nvc_decl_t* decl = lowerer->sema->decls + type_decl;
+    if (decl->kind == NVC_DECL_IMPORT)
+        decl = decl->module->decls + decl->module_decl;
+    *type = NVC_IR_TYPE_RECORD;
+    *layout = decl->layout;
+    return decl->layout != NULL;
+}
+
+// the type of a signature for messages, like nvc_value_type_str
+static const char* nvc_type_str(nvc_ir_type_t type,
+                                uint32_t length,
+                                const nvc_type_layout_t* layout,
+                                char* buf,
+                                size_t size) {
+    if (layout) return layout->name;
+    if (!length) return nvc_ir_type_to_str(type);
+    snprintf(buf, size, "%s[%u]", nvc_ir_type_to_str(type), length);
+    return buf;
+}
+
+// lowers the fun decl declared by sema->decls[index] into a new function of
+// the module, returns its index or NVC_IR_NONE after reporting its errors
+static uint32_t nvc_lower_fun(nvc_lowerer_t* lowerer, uint32_t index) {
+    nvc_ast_node_t* node = lowerer->sema->decls[index].node;
+    nvc_ast_fun_decl_t* decl = &node->fun_decl;
+    uint32_t f = lowerer->module->n_functions;
+    nvc_ir_function_t* fun = nvc_ir_new_function(lowerer->module,
+                                                 decl->fun_name);
+    if (!fun) {
+        lowerer->out_of_memory = true;
+        return NVC_IR_NONE;
+    }
+    if (decl->n_params) {
+        fun->params = nvc_calloc(fun->allocator, decl->n_params,
+                                 sizeof(nvc_ir_param_t));
+        if (!fun->params) {
+            lowerer->out_of_memory = true;
+            return NVC_IR_NONE;
+        }
+    }
+    fun->n_params = decl->n_params;
+    // note: set first so the body can call the function itself
+    lowerer->functions[index] = f;
+    bool ok = true;
+    if (decl->return_type_name)
+        ok = nvc_signature_type(lowerer, decl->return_type_name,
+                                decl->return_type_decl, &fun->ret_type,
+                                &fun->ret_layout);
+
+    nvc_ir_function_t* caller = lowerer->fun;
+    uint32_t caller_block = lowerer->block;
+    const nvc_ast_node_t* caller_use = lowerer->use;
+    lowerer->fun = fun;
+    lowerer->use = node;
+    lowerer->block = nvc_ir_add_block(fun);
+    if (lowerer->block == NVC_IR_NONE) {
+        lowerer->out_of_memory = true;
+        goto out;
+    }
+    for (uint32_t i = 0; i < decl->n_params; ++i) {
+        nvc_fun_param_decl_t* param = decl->params[i];
+        fun->params[i].value = NVC_IR_NONE;
+        nvc_ir_type_t type;
+        const nvc_type_layout_t* layout;
+        if (!nvc_signature_type(lowerer, param->type_name, param->type_decl,
+                                &type, &layout)) {
+            ok = false;
+            continue;
+        }
+        nvc_ir_value_t value = nvc_emit(lowerer, NVC_IR_PARAM, type,
+                                        NVC_IR_NONE, NVC_IR_NONE,
+                                        &node->buf_loc);
+        if (value == NVC_IR_NONE) goto out;
+        fun->params[i].type = type;
+        fun->params[i].layout = layout;
+        fun->params[i].value = value;
+        fun->insts[value].param = i;
+        fun->insts[value].name = param->param_name;
+        fun->insts[value].layout = layout;
+        if (param->decl != NVC_DECL_UNRESOLVED)
+            lowerer->decl_values[param->decl] = value;
+    }
+    if (!ok) goto out;
+    if (!decl->body_size) {
+        nvc_report(lowerer->diags, NVC_SEVERITY_ERROR, &node->buf_loc,
+                   "function '%s' has no body to evaluate", decl->fun_name);
+        ok = false;
+        goto out;
+    }
+
+    // the value of the body is the value of its last expression or let
+    nvc_ir_value_t value = NVC_IR_NONE;
+    for (uint32_t i = 0; i < decl->body_size; ++i) {
+        nvc_ast_node_t* stmt = decl->body[i];
+        if (stmt->kind != NVC_AST_NODE_LET_DECL) {
+            value = nvc_lower_expr(lowerer, stmt);
+            continue;
+        }
+        nvc_lower_let(lowerer, stmt);
+        value = stmt->let_decl.decl == NVC_DECL_UNRESOLVED
+                    ? NVC_IR_NONE
+                    : lowerer->decl_values[stmt->let_decl.decl];
+    }
+    if (value == NVC_IR_NONE) {
+        ok = false;
+        goto out;
+    }
+    nvc_ast_node_t* last = decl->body[decl->body_size - 1];
+    if (fun->ret_type == NVC_IR_TYPE_VOID) {
+        fun->ret_type = nvc_value_type(lowerer, value);
+        fun->ret_length = nvc_value_length(lowerer, value);
+        fun->ret_layout = fun->insts[value].layout;
+    } else {
+        nvc_ir_value_t ret = nvc_lower_conversion(
+            lowerer, value, fun->ret_type, fun->ret_length, fun->ret_layout,
+            nvc_node_loc(lowerer, last));
+        if (ret == NVC_IR_NONE) {
+            char value_buf[32], ret_buf[32];
+            nvc_report(lowerer->diags, NVC_SEVERITY_ERROR,
+                       nvc_node_loc(lowerer, last),
+                       "function '%s' evaluates to %s but returns %s",
+                       decl->fun_name,
+                       nvc_value_type_str(lowerer, value, value_buf,
+                                          sizeof(value_buf)),
+                       nvc_type_str(fun->ret_type, fun->ret_length,
+                                    fun->ret_layout, ret_buf,
+                                    sizeof(ret_buf)));
+            nvc_note_conversion(lowerer, fun->ret_type,
+                                nvc_value_type(lowerer, value));
+            ok = false;
+            goto out;
+        }
+        value = ret;
+    }
+    nvc_emit(lowerer, NVC_IR_RET, NVC_IR_TYPE_VOID, value, NVC_IR_NONE,
+             nvc_node_loc(lowerer, last));
+out:
+    lowerer->fun = caller;
+    lowerer->block = caller_block;
+    lowerer->use = caller_use;
+    if (ok && !lowerer->out_of_memory) return f;
+    lowerer->functions[index] = NVC_LOWER_FAILED;
+    return NVC_IR_NONE;
+}
+
+// a call of the fun decl declared by sema->decls[index], the function is
+// lowered on its first call
+static nvc_ir_value_t nvc_lower_fun_call(nvc_lowerer_t* lowerer,
+                                         nvc_ast_node_t* node,
+                                         uint32_t index) {
+    uint32_t f = lowerer->functions[index];
+    if (f == NVC_LOWER_FAILED) return NVC_IR_NONE;
+    if (f == NVC_IR_NONE) f = nvc_lower_fun(lowerer, index);
+    if (f == NVC_IR_NONE) return NVC_IR_NONE;
+    nvc_ast_fun_decl_t* decl = &lowerer->sema->decls[index].node->fun_decl;
+    nvc_ir_function_t* callee = lowerer->module->functions[f];
+    nvc_ast_call_t* call = &node->call;
+    if (call->n_args != decl->n_params) {
+        nvc_report(lowerer->diags, NVC_SEVERITY_ERROR, &node->buf_loc,
+                   "function '%s' takes %u arguments but %u were given",
+                   decl->fun_name, decl->n_params, call->n_args);
+        return NVC_IR_NONE;
+    }
+    if (callee->ret_type == NVC_IR_TYPE_VOID) {
+        nvc_report(lowerer->diags, NVC_SEVERITY_ERROR, &node->buf_loc,
+                   "function '%s' is called before its return type is known",
+                   decl->fun_name);
+        nvc_report(lowerer->diags, NVC_SEVERITY_NOTE, NULL,
+                   "a recursive function must declare it with -> <type>");
+        return NVC_IR_NONE;
+    }
+
+    nvc_allocator_t* allocator = lowerer->fun->allocator;
+    nvc_ir_value_t* values =
+        nvc_alloc(allocator, (call->n_args + 1) * sizeof(nvc_ir_value_t));
+    if (!values) {
+        lowerer->out_of_memory = true;
+        return NVC_IR_NONE;
+    }
+    nvc_ir_value_t value = NVC_IR_NONE;
+    bool ok = true;
+    for (uint32_t k = 0; k < call->n_args; ++k) {
+        nvc_ast_node_t* arg = call->args[k];
+        nvc_fun_param_decl_t* param = decl->params[k];
+        values[k] = nvc_lower_expr(lowerer, arg);
+        if (values[k] == NVC_IR_NONE) {
+            ok = false;
+            continue;
+        }
+        nvc_ir_type_t type = NVC_IR_TYPE_VOID;
+        const nvc_type_layout_t* layout = NULL;
+        // note: an invalid parameter type was reported by nvc_resolve
+        if (!nvc_signature_type(lowerer, param->type_name, param->type_decl,
+                                &type, &layout)) {
+            ok = false;
+            continue;
+        }
+        nvc_ir_value_t converted = nvc_lower_conversion(
+            lowerer, values[k], type, 0, layout, nvc_node_loc(lowerer, arg));
+        if (converted == NVC_IR_NONE) {
+            char arg_buf[32], param_buf[32];
+            nvc_report(lowerer->diags, NVC_SEVERITY_ERROR,
+                       nvc_node_loc(lowerer, arg),
+                       "parameter '%s' of function '%s' is %s, not %s",
+                       param->param_name, decl->fun_name,
+                       nvc_type_str(type, 0, layout, param_buf,
+                                    sizeof(param_buf)),
+                       nvc_value_type_str(lowerer, values[k], arg_buf,
+                                          sizeof(arg_buf)));
+            nvc_note_conversion(lowerer, type,
+                                nvc_value_type(lowerer, values[k]));
+            ok = false;
+            continue;
+        }
+        values[k] = converted;
+    }
+    if (!ok || lowerer->out_of_memory) goto out;
+
+    value = nvc_emit_array(lowerer, NVC_IR_CALL, callee->ret_type,
+                           callee->ret_length, NVC_IR_NONE, NVC_IR_NONE,
+                           &node->buf_loc);
+    if (value == NVC_IR_NONE) goto out;
+    nvc_ir_inst_t* inst = lowerer->fun->insts + value;
+    inst->callee = f;
+    inst->name = decl->fun_name;
+    inst->layout = callee->ret_layout;
+    inst->n_operands = call->n_args;
+    if (call->n_args > 2) {
+        inst->many = values;
+        values = NULL;
+    } else {
+        memcpy(inst->ops, values, call->n_args * sizeof(nvc_ir_value_t));
+    }
+out:
+    nvc_free(allocator, values);
+    return value;
+}
+
+// a call of the number type, it converts its argument (element by element
+// for arrays). ints wrap to i32s and i64s and fps truncate to them like
+// nvc_fp_to_i64, fps only become ints through i64 so that stays explicit
+static nvc_ir_value_t nvc_lower_convert(nvc_lowerer_t* lowerer,
+                                        nvc_ast_node_t* node,
+                                        nvc_ir_type_t type) {
+    nvc_ast_call_t* call = &node->call;
+    const char* name = call->callee->symbol_ref.symbol;
+    if (call->n_args != 1) {
+        nvc_report(lowerer->diags, NVC_SEVERITY_ERROR, &node->buf_loc,
+                   "conversion to %s takes 1 argument but %u were given",
+                   name, call->n_args);
+        return NVC_IR_NONE;
+    }
+    nvc_ir_value_t value = nvc_lower_expr(lowerer, call->args[0]);
+    if (value == NVC_IR_NONE) return NVC_IR_NONE;
+    const nvc_ir_inst_t* inst = lowerer->fun->insts + value;
+    nvc_ir_type_t from = inst->type;
+    if (inst->layout || !nvc_ir_is_numeric(from) ||
+        (type == NVC_IR_TYPE_INT && !nvc_ir_is_integral(from))) {
+        char buf[32];
+        nvc_report(lowerer->diags, NVC_SEVERITY_ERROR, &node->buf_loc,
+                   "%s can not be converted to %s",
+                   nvc_value_type_str(lowerer, value, buf, sizeof(buf)),
+                   name);
+        if (nvc_ir_is_numeric(from) && !inst->layout)
+            nvc_note_conversion(lowerer, type, from);
+        return NVC_IR_NONE;
+    }
+    if (from == type) return value;
+    return nvc_emit_array(lowerer,
+                          from == NVC_IR_TYPE_INT && type == NVC_IR_TYPE_FP
+                              ? NVC_IR_ITOF
+                              : NVC_IR_CONVERT,
+                          type, inst->length, value, NVC_IR_NONE,
+                          &node->buf_loc);
+}
+
+static nvc_ir_value_t nvc_lower_call(nvc_lowerer_t* lowerer,
+                                     nvc_ast_node_t* node) {
+    uint32_t index = node->call.callee->symbol_ref.decl;
+    // note: number types are left unresolved by nvc_resolve, any other
+    // unresolved symbol was reported there
+    if (index == NVC_DECL_UNRESOLVED) {
+        uint32_t builtin;
+        if (nvc_builtin_type(node->call.callee->symbol_ref.symbol,
+                             &builtin) &&
+            nvc_ir_is_numeric((nvc_ir_type_t)builtin))
+            return nvc_lower_convert(lowerer, node, (nvc_ir_type_t)builtin);
+        return NVC_IR_NONE;
+    }
+    const nvc_decl_t* decl = lowerer->sema->decls + index;
+    if (decl->kind == NVC_DECL_FUN)
+        return nvc_lower_fun_call(lowerer, node, index);
+    if (decl->kind == NVC_DECL_IMPORT)
+        decl = decl->module->decls + decl->module_decl;
+    if (decl->kind != NVC_DECL_TYPE) {
+        nvc_report(lowerer->diags, NVC_SEVERITY_ERROR, &node->buf_loc,
+                   decl->kind == NVC_DECL_FUN
+                       ? "function '%s' of another module can not be "
+                         "called yet"
+                       : "'%s' is neither a function nor a type",
+                   decl->name);
+        return NVC_IR_NONE;
+    }
+    // note: no layout means the type is invalid, nvc_resolve reported why
+    if (!decl->layout) return NVC_IR_NONE;
+    return nvc_lower_record(lowerer, node, decl->layout);
+}
+
+static nvc_ir_value_t nvc_lower_field(nvc_lowerer_t* lowerer,
+                                      nvc_ast_node_t* node) {
+    nvc_ir_value_t base = nvc_lower_expr(lowerer, node->field.base);
+    if (base == NVC_IR_NONE) return NVC_IR_NONE;
+    const nvc_type_layout_t* layout = lowerer->fun->insts[base].layout;
+    if (!layout) {
+        char buf[32];
+        nvc_report(lowerer->diags, NVC_SEVERITY_ERROR, &node->buf_loc,
+                   "only records have fields, not %s",
+                   nvc_value_type_str(lowerer, base, buf, sizeof(buf)));
+        return NVC_IR_NONE;
+    }
+    for (uint32_t k = 0; k < layout->n_fields; ++k) {
+        const nvc_field_layout_t* field = layout->fields + k;
+        if (strcmp(field->name, node->field.field) != 0) continue;
+        nvc_ir_value_t value =
+            nvc_emit_array(lowerer, NVC_IR_FIELD, field->type, field->length,
+                           base, NVC_IR_NONE, &node->buf_loc);
+        if (value == NVC_IR_NONE) return NVC_IR_NONE;
+        lowerer->fun->insts[value].field = k;
+        lowerer->fun->insts[value].layout = field->record;
+        return value;
+    }
+    nvc_report(lowerer->diags, NVC_SEVERITY_ERROR, &node->buf_loc,
+               "type '%s' has no field '%s'", layout->name, node->field.field);
+    return NVC_IR_NONE;
+}
+
+// ends the current block with a jump to target
+static void nvc_lower_jump(nvc_lowerer_t* lowerer,
+                           uint32_t target,
+                           const nvc_buffer_location_t* loc) {
+    nvc_ir_value_t br =
+        nvc_emit(lowerer, NVC_IR_BR, NVC_IR_TYPE_VOID, NVC_IR_NONE,
+                 NVC_IR_NONE, loc);
+    if (br == NVC_IR_NONE) return;
+    lowerer->fun->insts[br].targets[0] = target;
+    if (!nvc_ir_add_edge(lowerer->fun, lowerer->block, target))
+        lowerer->out_of_memory = true;
+}
+
+// ends the current block with a jump to then when cond is true and to
+// otherwise when it is not
+static void nvc_lower_branch(nvc_lowerer_t* lowerer,
+                             nvc_ir_value_t cond,
+                             uint32_t then,
+                             uint32_t otherwise,
+                             const nvc_buffer_location_t* loc) {
+    nvc_ir_value_t br = nvc_emit(lowerer, NVC_IR_COND_BR, NVC_IR_TYPE_VOID,
+                                 cond, NVC_IR_NONE, loc);
+    if (br == NVC_IR_NONE) return;
+    lowerer->fun->insts[br].targets[0] = then;
+    lowerer->fun->insts[br].targets[1] = otherwise;
+    if (!nvc_ir_add_edge(lowerer->fun, lowerer->block, then) ||
+        !nvc_ir_add_edge(lowerer->fun, lowerer->block, otherwise))
+        lowerer->out_of_memory = true;
+}
+
+// a bound of the counter of a for loop, it must be an int
+static nvc_ir_value_t nvc_lower_bound(nvc_lowerer_t* lowerer,
+                                      nvc_ast_node_t* node) {
+    nvc_ir_value_t value = nvc_lower_expr(lowerer, node);
+    if (value == NVC_IR_NONE) return NVC_IR_NONE;
+    nvc_ir_inst_t* inst = lowerer->fun->insts + value;
+    if (inst->type == NVC_IR_TYPE_INT && !inst->length) return value;
+    char buf[32];
+    nvc_report(lowerer->diags, NVC_SEVERITY_ERROR, nvc_node_loc(lowerer, node),
+               "the bounds of a for loop must be ints, not %s",
+               nvc_value_type_str(lowerer, value, buf, sizeof(buf)));
+    nvc_note_conversion(lowerer, NVC_IR_TYPE_INT, inst->type);
+    return NVC_IR_NONE;
+}
+
+// the value of the body of a loop, it must have the type of the accumulator
+// acc and is converted like an argument
+static nvc_ir_value_t nvc_lower_loop_body(nvc_lowerer_t* lowerer,
+                                          nvc_ir_value_t acc,
+                                          nvc_ast_node_t* node) {
+    nvc_ir_value_t value = nvc_lower_expr(lowerer, node);
+    if (value == NVC_IR_NONE) return NVC_IR_NONE;
+    nvc_ir_inst_t acc_inst = lowerer->fun->insts[acc];
+    nvc_ir_value_t converted =
+        nvc_lower_conversion(lowerer, value, acc_inst.type, acc_inst.length,
+                             acc_inst.layout, nvc_node_loc(lowerer, node));
+    if (converted != NVC_IR_NONE) return converted;
+    char value_buf[32], acc_buf[32];
+    nvc_report(lowerer->diags, NVC_SEVERITY_ERROR, nvc_node_loc(lowerer, node),
+               "the loop body is %s but its accumulator '%s' is %s",
+               nvc_value_type_str(lowerer, value, value_buf,
+                                  sizeof(value_buf)),
+               acc_inst.name,
+               nvc_value_type_str(lowerer, acc, acc_buf, sizeof(acc_buf)));
+    nvc_report(lowerer->diags, NVC_SEVERITY_NOTE, NULL,
+               "the accumulator has the type of its initial value");
+    return NVC_IR_NONE;
+}
+
+// a loop becomes a header block with a phi for the accumulator (and one for
+// the counter) that branches to the body or out of the loop, the body jumps
+// back to the header:
+//   pre:    start, end, init; br header
+//   header: counter = phi(start, next); acc = phi(init, value)
+//           cond_br counter < end (or the while condition), body, exit
+//   body:   value = the body; next = counter + 1; br header
+//   exit:   the loop evaluates to acc
+// note: the body may contain loops itself, the back edge starts from
+// whatever block it ends in
+static nvc_ir_value_t nvc_lower_loop(nvc_lowerer_t* lowerer,
+                                     nvc_ast_node_t* node) {
+    nvc_ast_loop_t* loop = &node->loop;
+    nvc_ir_function_t* fun = lowerer->fun;
+    const nvc_buffer_location_t* loc = &node->buf_loc;
+    bool is_for = node->kind == NVC_AST_NODE_FOR;
+    nvc_ir_value_t start = NVC_IR_NONE, end = NVC_IR_NONE;
+    if (is_for) {
+        start = nvc_lower_bound(lowerer, loop->start);
+        end = nvc_lower_bound(lowerer, loop->end);
+        if (start == NVC_IR_NONE || end == NVC_IR_NONE) return NVC_IR_NONE;
+    }
+    nvc_ir_value_t init = nvc_lower_expr(lowerer, loop->init);
+    if (init == NVC_IR_NONE) return NVC_IR_NONE;
+
+    uint32_t header = nvc_ir_add_block(fun);
+    uint32_t body = nvc_ir_add_block(fun);
+    uint32_t exit = nvc_ir_add_block(fun);
+    if (header == NVC_IR_NONE || body == NVC_IR_NONE || exit == NVC_IR_NONE) {
+        lowerer->out_of_memory = true;
+        return NVC_IR_NONE;
+    }
+    nvc_lower_jump(lowerer, header, loc);
+    lowerer->block = header;
+    nvc_ir_value_t counter = NVC_IR_NONE;
+    if (is_for) {
+        counter = nvc_emit(lowerer, NVC_IR_PHI, NVC_IR_TYPE_INT, start,
+                           NVC_IR_NONE, loc);
+        if (counter == NVC_IR_NONE) return NVC_IR_NONE;
+        fun->insts[counter].name = loop->counter;
+        lowerer->decl_values[loop->counter_decl] = counter;
+    }
+    nvc_ir_value_t acc =
+        nvc_emit_array(lowerer, NVC_IR_PHI, nvc_value_type(lowerer, init),
+                       nvc_value_length(lowerer, init), init, NVC_IR_NONE, loc);
+    if (acc == NVC_IR_NONE) return NVC_IR_NONE;
+    fun->insts[acc].layout = fun->insts[init].layout;
+    fun->insts[acc].name = loop->acc;
+    lowerer->decl_values[loop->acc_decl] = acc;
+
+    nvc_ir_value_t cond;
+    if (is_for) {
+        cond = nvc_emit(lowerer, NVC_IR_LT, NVC_IR_TYPE_BOOL, counter, end,
+                        loc);
+    } else {
+        cond = nvc_lower_expr(lowerer, loop->cond);
+        if (cond != NVC_IR_NONE &&
+            (nvc_value_type(lowerer, cond) != NVC_IR_TYPE_BOOL ||
+             nvc_value_length(lowerer, cond))) {
+            char buf[32];
+            nvc_report(lowerer->diags, NVC_SEVERITY_ERROR,
+                       nvc_node_loc(lowerer, loop->cond),
+                       "the condition of a while loop must be a bool, not %s",
+                       nvc_value_type_str(lowerer, cond, buf, sizeof(buf)));
+            return NVC_IR_NONE;
+        }
+    }
+    if (cond == NVC_IR_NONE) return NVC_IR_NONE;
+    nvc_lower_branch(lowerer, cond, body, exit, loc);
+
+    lowerer->block = body;
+    nvc_ir_value_t value = nvc_lower_loop_body(lowerer, acc, loop->body);
+    if (value == NVC_IR_NONE) return NVC_IR_NONE;
+    nvc_ir_value_t next = NVC_IR_NONE;
+    if (is_for) {
+        nvc_ir_value_t one = nvc_emit(lowerer, NVC_IR_CONST, NVC_IR_TYPE_INT,
+                                      NVC_IR_NONE, NVC_IR_NONE, loc);
+        if (one == NVC_IR_NONE) return NVC_IR_NONE;
+        fun->insts[one].i = 1;
+        next = nvc_emit(lowerer, NVC_IR_ADD, NVC_IR_TYPE_INT, counter, one,
+                        loc);
+        if (next == NVC_IR_NONE) return NVC_IR_NONE;
+    }
+    nvc_lower_jump(lowerer, header, loc);
+    if (lowerer->out_of_memory) return NVC_IR_NONE;
+    // note: the second operand is for the back edge, the header's second
+    // predecessor
+    if (is_for) {
+        fun->insts[counter].ops[1] = next;
+        fun->insts[counter].n_operands = 2;
+    }
+    fun->insts[acc].ops[1] = value;
+    fun->insts[acc].n_operands = 2;
+    lowerer->block = exit;
+    return acc;
+}
+
+static nvc_ir_value_t nvc_lower_node(nvc_lowerer_t* lowerer,
+                                     nvc_ast_node_t* node) {
+    nvc_ir_value_t value;
+    switch (node->kind) {
+        case NVC_AST_NODE_INT_LIT:
+            if (node->width) {
+                value = nvc_emit(lowerer, NVC_IR_CONST, nvc_literal_type(node),
+                                 NVC_IR_NONE, NVC_IR_NONE,
+                                 nvc_node_loc(lowerer, node));
+                if (value != NVC_IR_NONE)
+                    lowerer->fun->insts[value].i = node->i;
+                return value;
+            }
+            if (node->i > NVC_SMALL_INT_MAX) {
+                nvc_bigint_t* big = nvc_ir_alloc_big(lowerer->fun, 1);
+                if (!big) {
+                    lowerer->out_of_memory = true;
+                    return NVC_IR_NONE;
+                }
+                nvc_bigint_set_i64(big, node->i);
+                value = nvc_emit(lowerer, NVC_IR_BIG, NVC_IR_TYPE_INT,
+                                 NVC_IR_NONE, NVC_IR_NONE,
+                                 nvc_node_loc(lowerer, node));
+                if (value != NVC_IR_NONE) lowerer->fun->insts[value].big = big;
+                return value;
+            }
+            value = nvc_emit(lowerer, NVC_IR_CONST, NVC_IR_TYPE_INT,
+                             NVC_IR_NONE, NVC_IR_NONE,
+                             nvc_node_loc(lowerer, node));
+            if (value != NVC_IR_NONE) lowerer->fun->insts[value].i = node->i;
+            return value;
+        case NVC_AST_NODE_BIG_LIT:
+            value = nvc_emit(lowerer, NVC_IR_BIG, NVC_IR_TYPE_INT, NVC_IR_NONE,
+                             NVC_IR_NONE, nvc_node_loc(lowerer, node));
+            if (value != NVC_IR_NONE)
+                lowerer->fun->insts[value].big = node->big;
+            return value;
+        case NVC_AST_NODE_FP_LIT:
+            value = nvc_emit(lowerer, NVC_IR_CONST, nvc_literal_type(node),
+                             NVC_IR_NONE, NVC_IR_NONE,
+                             nvc_node_loc(lowerer, node));
+            if (value != NVC_IR_NONE) lowerer->fun->insts[value].fp = node->fp;
+            return value;
+        case NVC_AST_NODE_STRING_LIT:
+            value = nvc_emit(lowerer, NVC_IR_CONST, NVC_IR_TYPE_STR,
+                             NVC_IR_NONE, NVC_IR_NONE,
+                             nvc_node_loc(lowerer, node));
+            if (value != NVC_IR_NONE)
+                lowerer->fun->insts[value].str = node->str_lit;
+            return value;
+        case NVC_AST_NODE_ARRAY_LIT: return nvc_lower_array(lowerer, node);
+        case NVC_AST_NODE_INDEX: return nvc_lower_index(lowerer, node);
+        case NVC_AST_NODE_CALL: return nvc_lower_call(lowerer, node);
+        case NVC_AST_NODE_FIELD: return nvc_lower_field(lowerer, node);
+        case NVC_AST_NODE_FOR:
+        case NVC_AST_NODE_WHILE: return nvc_lower_loop(lowerer, node);
+        case NVC_AST_NODE_SYMBOL_REF: return nvc_lower_ref(lowerer, node);
+        case NVC_AST_NODE_OP_CHAIN: {
+            uint32_t pos = 0;
+            return nvc_lower_chain(lowerer, node, &pos, 0);
+        }
+        default:
+            nvc_report(lowerer->diags, NVC_SEVERITY_ERROR, &node->buf_loc,
+                       "declaration used as a value");
+            return NVC_IR_NONE;
+    }
+}
+
+static nvc_ir_value_t nvc_lower_expr(nvc_lowerer_t* lowerer,
+                                     nvc_ast_node_t* node) {
+    const nvc_ast_node_t* use = lowerer->use;
+    if (!node->interned) lowerer->use = node;
+    nvc_ir_value_t value = nvc_lower_node(lowerer, node);
+    lowerer->use = use;
+    return value;
+}
+
+static void nvc_lower_let(nvc_lowerer_t* lowerer, nvc_ast_node_t* node) {
+    nvc_ast_let_decl_t* let = &node->let_decl;
+    const nvc_ast_node_t* use = lowerer->use;
+    lowerer->use = node;
+    nvc_ir_value_t rhs = nvc_lower_expr(lowerer, let->rhs);
+    lowerer->use = use;
+    if (rhs == NVC_IR_NONE || let->decl == NVC_DECL_UNRESOLVED) return;
+
+    nvc_ir_type_t type = nvc_value_type(lowerer, rhs);
+    uint32_t length = nvc_value_length(lowerer, rhs);
+    const nvc_type_layout_t* layout = lowerer->fun->insts[rhs].layout;
+    nvc_ir_value_t value = nvc_emit_array(lowerer, NVC_IR_COPY, type, length,
+                                          rhs, NVC_IR_NONE, &node->buf_loc);
+    if (value == NVC_IR_NONE) return;
+    lowerer->fun->insts[value].name = let->symbol;
+    lowerer->fun->insts[value].layout = layout;
+    lowerer->decl_values[let->decl] = value;
+    lowerer->sema->decls[let->decl].value_type = type;
+    lowerer->sema->decls[let->decl].value_length = length;
+    lowerer->sema->decls[let->decl].value_layout = layout;
+
+    // note: only the last top level declaration of a name is exported, the
+    // ones it hides are dead unless used before
+    if (nvc_symtab_lookup(&lowerer->sema->exports, let->symbol) != let->decl)
+        return;
+    nvc_ir_value_t export = nvc_emit(lowerer, NVC_IR_EXPORT, NVC_IR_TYPE_VOID,
+                                     value, NVC_IR_NONE, &node->buf_loc);
+    if (export != NVC_IR_NONE) lowerer->fun->insts[export].name = let->symbol;
+}
+
+nvc_ir_module_t* nvc_lower_ast(nvc_allocator_t* allocator,
+                               nvc_diagnostics_t* diags,
+                               nvc_ast_t* ast,
+                               nvc_sema_t* sema) {
+    if (!allocator) allocator = nvc_default_allocator();
+    nvc_ir_module_t* module = nvc_calloc(allocator, 1, sizeof(nvc_ir_module_t));
+    if (!module) goto out_of_memory;
+    module->allocator = allocator;
+
+    nvc_lowerer_t lowerer = {
+        .module = module,
+        .diags = diags,
+        .sema = sema,
+    };
+    lowerer.fun = nvc_ir_new_function(module, "init");
+    if (!lowerer.fun) goto out_of_memory;
+    lowerer.block = nvc_ir_add_block(lowerer.fun);
+    if (lowerer.block == NVC_IR_NONE) goto out_of_memory;
+    lowerer.decl_values =
+        nvc_alloc(allocator, (sema->n_decls + 1) * sizeof(nvc_ir_value_t));
+    lowerer.functions =
+        nvc_alloc(allocator, (sema->n_decls + 1) * sizeof(uint32_t));
+    if (!lowerer.decl_values || !lowerer.functions) {
+        nvc_free(allocator, lowerer.decl_values);
+        nvc_free(allocator, lowerer.functions);
+        goto out_of_memory;
+    }
+    for (uint32_t i = 0; i < sema->n_decls; ++i) {
+        lowerer.decl_values[i] = NVC_IR_NONE;
+        lowerer.functions[i] = NVC_IR_NONE;
+    }
+
+    for (uint32_t i = 0; i < ast->size && !lowerer.out_of_memory; ++i) {
+        nvc_ast_node_t* node = ast->nodes[i];
+        switch (node->kind) {
+            case NVC_AST_NODE_LET_DECL: nvc_lower_let(&lowerer, node); break;
+            // note: functions are lowered when they are called, types only
+            // have a layout (see nvc_layout_types)
+            case NVC_AST_NODE_FUN_DECL:
+            case NVC_AST_NODE_TYPE_DECL:
+            case NVC_AST_NODE_IMPORT_DECL: break;
+            // note: top level expressions are evaluated for nothing, the
+            // passes remove them
+            default: nvc_lower_expr(&lowerer, node); break;
+        }
+    }
+    nvc_buffer_location_t end = {0};
+    if (ast->size) end = ast->nodes[ast->size - 1]->buf_loc;
+    nvc_emit(&lowerer, NVC_IR_RET, NVC_IR_TYPE_VOID, NVC_IR_NONE, NVC_IR_NONE,
+             &end);
+
+    nvc_free(allocator, lowerer.decl_values);
+    nvc_free(allocator, lowerer.functions);
+    if (lowerer.out_of_memory) goto out_of_memory;
+    return module;
+out_of_memory:
+    nvc_free_ir(module);
+    nvc_report(diags, NVC_SEVERITY_ERROR, NULL, "out of memory");
+    return NULL;
+}
+
+// fps and f32s with as many digits as it takes to read them back exactly
+static void nvc_print_fp(FILE* out, nvc_ir_type_t type, nvc_fp fp) {
+    fprintf(out, type == NVC_IR_TYPE_F32 ? "%.9g" : "%.17g", fp);
+}
+
+static void nvc_print_inst(FILE* out,
+                           nvc_ir_function_t* fun,
+                           nvc_ir_value_t value) {
+    nvc_ir_inst_t* inst = fun->insts + value;
+    fputs("  ", out);
+    if (inst->type != NVC_IR_TYPE_VOID) {
+        fprintf(out, "%%%u: %s", value,
+                inst->layout ? inst->layout->name
+                             : nvc_ir_type_to_str(inst->type));
+        if (inst->length) fprintf(out, "[%u]", inst->length);
+        fputs(" = ", out);
+    }
+    fputs(nvc_ir_op_to_str(inst->op), out);
+
+    switch (inst->op) {
+        case NVC_IR_CONST:
+            if (inst->length) {
+                fputs(" [", out);
+                for (uint32_t i = 0; i < inst->length; ++i) {
+                    if (i) fputs(", ", out);
+                    nvc_ir_inst_t c;
+                    nvc_ir_get_elem(inst, i, &c);
+                    if (inst->type == NVC_IR_TYPE_BOOL)
+                        fputs(c.b ? "true" : "false", out);
+                    else if (nvc_ir_is_integral(inst->type))
+                        fprintf(out, "%ld", c.i);
+                    else
+                        nvc_print_fp(out, inst->type, c.fp);
+                }
+                fputc(']', out);
+                break;
+            }
+            switch (inst->type) {
+                case NVC_IR_TYPE_BOOL:
+                    fputs(inst->b ? " true" : " false", out);
+                    break;
+                case NVC_IR_TYPE_INT:
+                case NVC_IR_TYPE_I32:
+                case NVC_IR_TYPE_I64: fprintf(out, " %ld", inst->i); break;
+                case NVC_IR_TYPE_FP:
+                case NVC_IR_TYPE_F32:
+                    fputc(' ', out);
+                    nvc_print_fp(out, inst->type, inst->fp);
+                    break;
+                case NVC_IR_TYPE_STR:
+                    fprintf(out, " '%s'", inst->str ? inst->str : "");
+                    break;
+                default: break;
+            }
+            break;
+        case NVC_IR_BIG: {
+            char* str =
+                nvc_alloc(fun->allocator, nvc_bigint_str_size(inst->big));
+            if (str) nvc_bigint_to_str(inst->big, str);
+            fprintf(out, " %s", str ? str : "?");
+            nvc_free(fun->allocator, str);
+            break;
+        }
+        case NVC_IR_IMPORT: fprintf(out, " %s", inst->name); break;
+        case NVC_IR_PARAM: fprintf(out, " %u", inst->param); break;
+        case NVC_IR_EXPORT:
+        case NVC_IR_CALL:
+            fprintf(out, " %s%s", inst->name, inst->n_operands ? "," : "");
+            break;
+        case NVC_IR_FIELD: {
+            const nvc_type_layout_t* layout = fun->insts[inst->ops[0]].layout;
+            fprintf(out, " %s,", layout->fields[inst->field].name);
+            break;
+        }
+        default: break;
+    }
+
+    nvc_ir_value_t* operands = nvc_ir_operands(inst);
+    for (uint32_t i = 0; i < inst->n_operands; ++i) {
+        fprintf(out, "%s %%%u", i ? "," : "", operands[i]);
+    }
+    if (inst->op == NVC_IR_BR) fprintf(out, " b%u", inst->targets[0]);
+    if (inst->op == NVC_IR_COND_BR)
+        fprintf(out, ", b%u, b%u", inst->targets[0], inst->targets[1]);
+    if (inst->name && inst->op == NVC_IR_COPY)
+        fprintf(out, "  # let %s", inst->name);
+    fputc('\n', out);
+}
+
+void nvc_print_ir(FILE* out, nvc_ir_module_t* module) {
+    for (uint32_t f = 0; f < module->n_functions; ++f) {
+        nvc_ir_function_t* fun = module->functions[f];
+        fprintf(out, "fun %s(", fun->name);
+        for (uint32_t i = 0; i < fun->n_params; ++i) {
+            const nvc_ir_param_t* param = fun->params + i;
+            if (i) fputs(", ", out);
+            // note: a param that is not used any more has no value left
+            if (param->value != NVC_IR_NONE &&
+                fun->insts[param->value].op == NVC_IR_PARAM)
+                fprintf(out, "%%%u", param->value);
+            else
+                fputc('_', out);
+            fprintf(out, ": %s",
+                    param->layout ? param->layout->name
+                                  : nvc_ir_type_to_str(param->type));
+        }
+        fputc(')', out);
+        if (fun->ret_type != NVC_IR_TYPE_VOID)
+            fprintf(out, " -> %s",
+                    fun->ret_layout ? fun->ret_layout->name
+                                    : nvc_ir_type_to_str(fun->ret_type));
+        if (fun->ret_length) fprintf(out, "[%u]", fun->ret_length);
+        fputs(" {\n", out);
+        for (uint32_t b = 0; b < fun->n_blocks; ++b) {
+            nvc_ir_block_t* block = fun->blocks + b;
+            if (block->removed) continue;
+            fprintf(out, "b%u:", b);
+            if (block->n_preds) fputs("  # preds:", out);
+            for (uint32_t i = 0; i < block->n_preds; ++i) {
+                fprintf(out, " b%u", block->preds[i]);
+            }
+            fputc('\n', out);
+            for (uint32_t i = 0; i < block->n_insts; ++i) {
+                nvc_print_inst(out, fun, block->insts[i]);
+            }
+        }
+        fputs("}\n", out);
+    }
+}
+
+static bool nvc_ir_has_pred(nvc_ir_block_t* block, uint32_t pred) {
+    for (uint32_t i = 0; i < block->n_preds; ++i) {
+        if (block->preds[i] == pred) return true;
+    }
+    return false;
+}
+
+bool nvc_ir_verify(nvc_ir_function_t* fun, nvc_diagnostics_t* diags) {
+    bool ok = true;
+    for (uint32_t b = 0; b < fun->n_blocks; ++b) {
+        nvc_ir_block_t* block = fun->blocks + b;
+        if (block->removed) continue;
+        if (!block->n_insts ||
+            !nvc_ir_is_terminator(
+                fun->insts[block->insts[block->n_insts - 1]].op)) {
+            nvc_report(diags, NVC_SEVERITY_ERROR, NULL,
+                       "ir: %s: b%u does not end with a terminator",
+                       fun->name, b);
+            ok = false;
+        }
+        for (uint32_t i = 0; i < block->n_insts; ++i) {
+            nvc_ir_value_t value = block->insts[i];
+            nvc_ir_inst_t* inst = fun->insts + value;
+            if (inst->block != b || inst->op == NVC_IR_NOP) {
+                nvc_report(diags, NVC_SEVERITY_ERROR, NULL,
+                           "ir: %s: %%%u is listed in b%u but not part of it",
+                           fun->name, value, b);
+                ok = false;
+            }
+            if (nvc_ir_is_terminator(inst->op) && i + 1 != block->n_insts) {
+                nvc_report(diags, NVC_SEVERITY_ERROR, NULL,
+                           "ir: %s: terminator %%%u in the middle of b%u",
+                           fun->name, value, b);
+                ok = false;
+            }
+            if (inst->op == NVC_IR_PHI && inst->n_operands != block->n_preds) {
+                nvc_report(diags, NVC_SEVERITY_ERROR, NULL,
+                           "ir: %s: phi %%%u has %u operands for %u preds",
+                           fun->name, value, inst->n_operands, block->n_preds);
+                ok = false;
+            }
+            if (inst->op == NVC_IR_ARRAY && inst->n_operands != inst->length) {
+                nvc_report(diags, NVC_SEVERITY_ERROR, NULL,
+                           "ir: %s: array %%%u has %u operands for %u elements",
+                           fun->name, value, inst->n_operands, inst->length);
+                ok = false;
+            }
+            bool record = inst->type == NVC_IR_TYPE_RECORD;
+            if (record != (inst->layout != NULL) ||
+                (inst->op == NVC_IR_RECORD &&
+                 (!record || inst->n_operands != inst->layout->n_fields))) {
+                nvc_report(diags, NVC_SEVERITY_ERROR, NULL,
+                           "ir: %s: record %%%u does not match its layout",
+                           fun->name, value);
+                ok = false;
+            }
+            nvc_ir_value_t* operands = nvc_ir_operands(inst);
+            for (uint32_t j = 0; j < inst->n_operands; ++j) {
+                nvc_ir_value_t operand = operands[j];
+                if (operand >= fun->n_insts ||
+                    fun->insts[operand].block == NVC_IR_NONE ||
+                    fun->insts[operand].type == NVC_IR_TYPE_VOID) {
+                    nvc_report(diags, NVC_SEVERITY_ERROR, NULL,
+                               "ir: %s: %%%u uses undefined value %%%u",
+                               fun->name, value, operand);
+                    ok = false;
+                }
+            }
+            uint32_t n_targets = inst->op == NVC_IR_BR        ? 1
+                                 : inst->op == NVC_IR_COND_BR ? 2
+                                                              : 0;
+            for (uint32_t j = 0; j < n_targets; ++j) {
+                uint32_t target = inst->targets[j];
+                if (target >= fun->n_blocks || fun->blocks[target].removed ||
+                    !nvc_ir_has_pred(fun->blocks + target, b)) {
+                    nvc_report(diags, NVC_SEVERITY_ERROR, NULL,
+                               "ir: %s: bad edge b%u -> b%u", fun->name, b,
+                               target);
+                    ok = false;
+                }
+            }
+        }
+    }
+    return ok;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,255 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nvc_layout.h>
+
+#include <nvc_ir.h>
+
+#include <string.h>
+
+bool nvc_builtin_type(const char* name, uint32_t* type) {
+    static const struct {
+        const char* name;
+        nvc_ir_type_t type;
+    } builtins[] = {
+        {"int", NVC_IR_TYPE_INT},
+        {"fp", NVC_IR_TYPE_FP},
+        {"bool", NVC_IR_TYPE_BOOL},
+        {"str", NVC_IR_TYPE_STR},
+        {"i32", NVC_IR_TYPE_I32},
+        {"i64", NVC_IR_TYPE_I64},
+        {"f32", NVC_IR_TYPE_F32},
+        {"f64", NVC_IR_TYPE_FP},
+    };
+    for (size_t i = 0; i < sizeof(builtins) / sizeof(builtins[0]); ++i) {
+        if (strcmp(name, builtins[i].name) == 0) {
+            *type = builtins[i].type;
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline uint64_t nvc_align_up(uint64_t offset, uint32_t align) {
+    return (offset + align - 1) & ~(uint64_t)(align - 1);
+}
+
+// gives the fields their offsets in the order of layout->order, returns the
+// end of the last one
+static uint64_t nvc_place_fields(nvc_type_layout_t* layout) {
+    uint64_t offset = 0;
+    for (uint32_t i = 0; i < layout->n_fields; ++i) {
+        nvc_field_layout_t* field = layout->fields + layout->order[i];
+        offset = nvc_align_up(offset, field->align);
+        field->offset = (uint32_t)offset;
+        offset += field->size;
+    }
+    return offset;
+}
+
+bool nvc_layout_fields(nvc_type_layout_t* layout) {
+    uint32_t align = 1;
+    uint64_t used = 0;
+    for (uint32_t i = 0; i < layout->n_fields; ++i) {
+        nvc_field_layout_t* field = layout->fields + i;
+        layout->order[i] = i;
+        if (field->align > align) align = field->align;
+        used += field->size;
+    }
+    if (used > NVC_LAYOUT_MAX_SIZE) return false;
+    layout->align = align;
+    uint64_t fixed_size = nvc_align_up(nvc_place_fields(layout), align);
+    if (fixed_size > NVC_LAYOUT_MAX_SIZE) return false;
+    layout->fixed_size = (uint32_t)fixed_size;
+
+    uint64_t size = fixed_size;
+    if (!layout->fixed) {
+        // note: alignments are powers of two, so going down from the
+        // largest one and taking the fields with exactly that alignment is
+        // a stable sort in a handful of passes
+        uint32_t n = 0;
+        for (uint32_t a = align; a; a >>= 1) {
+            for (uint32_t i = 0; i < layout->n_fields; ++i) {
+                if (layout->fields[i].align == a) layout->order[n++] = i;
+            }
+        }
+        size = nvc_align_up(nvc_place_fields(layout), align);
+    }
+    layout->size = (uint32_t)size;
+    layout->padding = (uint32_t)(size - used);
+    return true;
+}
+
+void nvc_free_layout(nvc_allocator_t* allocator, nvc_type_layout_t* layout) {
+    if (layout) {
+        nvc_free(allocator, layout->fields);
+        nvc_free(allocator, layout->order);
+        nvc_free(allocator, layout);
+    }
+}
+
+typedef struct {
+    nvc_sema_t* sema;
+    nvc_diagnostics_t* diags;
+    uint8_t* state;  // per decl: 0 not laid out, 1 being laid out, 2 done
+    bool out_of_memory;
+} nvc_layouter_t;
+
+static const nvc_type_layout_t* nvc_layout_type(nvc_layouter_t* layouter,
+                                                uint32_t index);
+
+// the layout of the type decl a member refers to, NULL when that type has
+// none (which was reported already)
+static const nvc_type_layout_t* nvc_member_layout(nvc_layouter_t* layouter,
+                                                  uint32_t index) {
+    const nvc_decl_t* decl = layouter->sema->decls + index;
+    if (decl->kind == NVC_DECL_IMPORT) {
+        const nvc_decl_t* target = decl->module->decls + decl->module_decl;
+        return target->kind == NVC_DECL_TYPE ? target->layout : NULL;
+    }
+    return nvc_layout_type(layouter, index);
+}
+
+// lays out the type decl at index after the types its members contain
+static const nvc_type_layout_t* nvc_layout_type(nvc_layouter_t* layouter,
+                                                uint32_t index) {
+    nvc_sema_t* sema = layouter->sema;
+    nvc_decl_t* decl = sema->decls + index;
+    if (decl->kind != NVC_DECL_TYPE) return NULL;
+    if (layouter->state[index] == 2) return decl->layout;
+    if (layouter->state[index] == 1) {
+        nvc_report(layouter->diags, NVC_SEVERITY_ERROR, &decl->buf_loc,
+                   "type '%s' contains itself", decl->name);
+        nvc_report(layouter->diags, NVC_SEVERITY_NOTE, NULL,
+                   "records hold their fields inline so it would never end");
+        return NULL;
+    }
+    layouter->state[index] = 1;
+
+    nvc_ast_type_decl_t* type = &decl->node->type_decl;
+    nvc_allocator_t* allocator = sema->allocator;
+    nvc_type_layout_t* layout = nvc_calloc(allocator, 1, sizeof(*layout));
+    if (!layout) goto out_of_memory;
+    layout->fields =
+        nvc_calloc(allocator, type->n_members, sizeof(nvc_field_layout_t));
+    layout->order = nvc_alloc(allocator, type->n_members * sizeof(uint32_t));
+    if (!layout->fields || !layout->order) goto out_of_memory;
+    layout->name = type->type_name;
+    layout->n_fields = type->n_members;
+    layout->fixed = type->fixed_layout;
+
+    bool valid = true;
+    for (uint32_t i = 0; i < type->n_members; ++i) {
+        nvc_type_member_decl_t* member = type->members[i];
+        nvc_field_layout_t* field = layout->fields + i;
+        field->name = member->member_name;
+        field->length = member->length;
+        if (nvc_builtin_type(member->type_name, &field->type)) {
+            // note: strs are pointers
+            uint32_t size = (uint32_t)nvc_ir_elem_size(field->type);
+            field->size = size ? size : 8;
+        } else if (member->decl != NVC_DECL_UNRESOLVED) {
+            field->type = NVC_IR_TYPE_RECORD;
+            field->record = nvc_member_layout(layouter, member->decl);
+            if (layouter->out_of_memory) goto out_of_memory;
+            if (!field->record) {
+                valid = false;
+                continue;
+            }
+            field->size = field->record->size;
+        } else {
+            // note: nvc_resolve reported the unknown type
+            valid = false;
+            continue;
+        }
+        field->align = field->record ? field->record->align : field->size;
+        if (!member->length) continue;
+        if (field->type == NVC_IR_TYPE_STR ||
+            field->type == NVC_IR_TYPE_RECORD) {
+            nvc_report(layouter->diags, NVC_SEVERITY_ERROR, &decl->buf_loc,
+                       "member '%s' of type '%s' is an array of %s",
+                       member->member_name, decl->name, member->type_name);
+            nvc_report(layouter->diags, NVC_SEVERITY_NOTE, NULL,
+                       "array elements must be numbers or bools");
+            valid = false;
+        } else if ((uint64_t)field->size * member->length >
+                   NVC_LAYOUT_MAX_SIZE) {
+            field->size = NVC_LAYOUT_MAX_SIZE + 1;
+        } else {
+            field->size *= member->length;
+        }
+    }
+    if (valid && !nvc_layout_fields(layout)) {
+        nvc_report(layouter->diags, NVC_SEVERITY_ERROR, &decl->buf_loc,
+                   "type '%s' is too large", decl->name);
+        nvc_report(layouter->diags, NVC_SEVERITY_NOTE, NULL,
+                   "records can take at most %u bytes", NVC_LAYOUT_MAX_SIZE);
+        valid = false;
+    }
+    layouter->state[index] = 2;
+    if (!valid) {
+        nvc_free_layout(allocator, layout);
+        layout = NULL;
+    }
+    decl->layout = layout;
+    return layout;
+out_of_memory:
+    nvc_free_layout(allocator, layout);
+    layouter->out_of_memory = true;
+    layouter->state[index] = 2;
+    return NULL;
+}
+
+bool nvc_layout_types(nvc_sema_t* sema, nvc_diagnostics_t* diags) {
+    nvc_layouter_t layouter = {
+        .sema = sema,
+        .diags = diags,
+    };
+    layouter.state = nvc_calloc(sema->allocator, sema->n_decls + 1, 1);
+    if (!layouter.state) return false;
+    for (uint32_t i = 0; i < sema->n_decls && !layouter.out_of_memory; ++i) {
+        nvc_layout_type(&layouter, i);
+    }
+    nvc_free(sema->allocator, layouter.state);
+    return !layouter.out_of_memory;
+}
+
+static void nvc_print_padding(FILE* out, uint32_t offset, uint32_t size) {
+    fprintf(out, "  %6u  <%u byte%s of padding>\n", offset, size,
+            size == 1 ? "" : "s");
+}
+
+void nvc_print_layout(FILE* out, const nvc_type_layout_t* layout) {
+    fprintf(out, "type %s%s: size %u, align %u, padding %u",
+            layout->fixed ? "[fixed] " : "", layout->name, layout->size,
+            layout->align, layout->padding);
+    if (layout->fixed_size != layout->size)
+        fprintf(out, " (%u in declaration order)", layout->fixed_size);
+    fputc('\n', out);
+    uint32_t end = 0;
+    for (uint32_t i = 0; i < layout->n_fields; ++i) {
+        const nvc_field_layout_t* field = layout->fields + layout->order[i];
+        if (field->offset > end)
+            nvc_print_padding(out, end, field->offset - end);
+        fprintf(out, "  %6u  %s: %s", field->offset, field->name,
+                field->record ? field->record->name
+                              : nvc_ir_type_to_str(field->type));
+        if (field->length) fprintf(out, "[%u]", field->length);
+        fputc('\n', out);
+        end = field->offset + field->size;
+    }
+    if (layout->size > end) nvc_print_padding(out, end, layout->size - end);
+}
+
+void nvc_print_layouts(FILE* out, const nvc_sema_t* sema) {
+    for (uint32_t i = 0; i < sema->n_decls; ++i) {
+        const nvc_decl_t* decl = sema->decls + i;
+        if (decl->kind == NVC_DECL_TYPE && decl->layout)
+            nvc_print_layout(out, decl->layout);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -4,12 +4,16 @@ extern "C" {
 
 #include <nvc_lexer.h>
 
+#include <nvc_alloc.h>
+#include <nvc_number.h>
+#include <nvc_utf8.h>
+
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-static inline bool nvc_is_word(char c) {
+static inline bool nvc_is_word_start(char c) {
     // is alpha or underscore
     return (c >= 'A' && c <= 'Z')     // alpha upper
            || (c >= 'a' && c <= 'z')  // alpha lower
@@ -17,6 +21,22 @@ static inline bool nvc_is_word(char c) {
         ;
 }
 
+static inline bool nvc_is_word(char c) {
+    // is alpha, underscore or digit
+    return nvc_is_word_start(c) || (c >= '0' && c <= '9');
+}
+
+// length of the identifier char at p or 0 if there is none, start selects the
+// chars an identifier can begin with. only non-ASCII chars are decoded and
+// looked up in the XID tables
+static inline size_t nvc_word_len(const char* p, const char* end, bool start) {
+    if (!(*p & 0x80)) return start ? nvc_is_word_start(*p) : nvc_is_word(*p);
+    uint32_t cp;
+    size_t len = nvc_utf8_decode(p, end, &cp);
+    if (!len) return 0;
+    return (start ? nvc_xid_start(cp) : nvc_xid_continue(cp)) ? len : 0;
+}
+
 static inline bool nvc_is_operator(char c) {
     // special reserved operator characters
     return (c > '&' && c < '0')     // ' ( ) * + , - . /
@@ -35,53 +55,6 @@ static inline bool nvc_is_number(char c) {
     return c == '.' || (c >= '0' && c <= '9');
 }
 
-static inline nvc_int nvc_parse_int(char* str, char** end) {
-    // note: this assumes str is not NULL and is null terminated
-    // note: I'm not sure how efficient this is maybe I could compile it with
-    // -O4 and replace with inline asm
-    nvc_int i = 0;
-    while (*str >= '0' && *str <= '9') {
-        i = i * 10 + (*str - '0');
-        ++str;
-    }
-    *end = str;
-    return i;
-}
-
-static inline nvc_fp nvc_parse_fp(char* str, char** end) {
-    // adapted from stb for readability and simplicity and my specific
-    // requirements see:
-    // https://github.com/nothings/stb/blob/master/stb_c_lexer.h
-    // note: this
-    // assumes str is not NULL and is null terminated note: see nvc_parse_int
-    // for optimization suggestion lhs of decimal point
-    *end = str;
-    nvc_fp fp = 0.0;
-    while (*str >= '0' && *str <= '9') {
-        fp = fp * 10 + (*str - '0');
-        ++str;
-    }
-
-    // early return without making *end -> str aka discard the value
-    if (*str != '.') return 0.0;
-
-    // rhs of decimal point
-    char* dp = str;
-    ++str;
-    nvc_fp pow = 1.0, dec = 0.0;
-    for (; *str >= '0' && *str <= '9'; pow *= 10.0) {
-        dec = dec * 10 + (*str - '0');
-        ++str;
-    }
-    fp += dec / pow;
-
-    if (*end == dp && dp + 1 == str) return 0.0;
-
-    *end = str;
-
-    return fp;
-}
-
 char* nvc_op_to_str(nvc_operator_kind_t op) {
     // TODO: this is probably a bad way of doing this
     switch (op) {
@@ -167,31 +140,82 @@ static nvc_operator_kind_t nvc_str_to_op(char* str, size_t* operator_len) {
     return NVC_OP_UNKNOWN;
 }
 
-static void nvc_free_tokens(nvc_tok_t* tokens, size_t len) {
+// column of pos on the line starting at line_start_ptr in code points
+static uint32_t nvc_lexer_column(nvc_lexer_t* lexer,
+                                 char* line_start_ptr,
+                                 char* pos) {
+    if (lexer->ascii) return pos - line_start_ptr;
+    // note: locations are asked for left to right, so counting continues
+    // from the last one instead of the start of the line
+    if (lexer->col_line != line_start_ptr || lexer->col_ptr > pos) {
+        lexer->col_line = line_start_ptr;
+        lexer->col_ptr = line_start_ptr;
+        lexer->col = 0;
+    }
+    lexer->col += nvc_utf8_length(lexer->col_ptr, pos);
+    lexer->col_ptr = pos;
+    return lexer->col;
+}
+
+static inline nvc_buffer_location_t nvc_lexer_loc(nvc_lexer_t* lexer,
+                                                  char* line_start_ptr,
+                                                  uint32_t line_num,
+                                                  char* buf_curr) {
+    nvc_buffer_location_t loc = {
+        .bufname = lexer->bufname,
+        .line = line_start_ptr,
+        .l = line_num,
+        .c = nvc_lexer_column(lexer, line_start_ptr, buf_curr),
+    };
+    return loc;
+}
+
+// the exact value of an int literal past INT64_MAX, NULL when out of memory
+static nvc_bigint_t* nvc_lex_big_int(nvc_allocator_t* allocator,
+                                     const char* str,
+                                     size_t len) {
+    uint32_t radix = 10;
+    char prefix = len > 2 && str[0] == '0' ? (char)(str[1] | 0x20) : 0;
+    if (prefix == 'x' || prefix == 'b') {
+        radix = prefix == 'x' ? 16 : 2;
+        str += 2;
+        len -= 2;
+    }
+    nvc_bigint_t* big = nvc_alloc(
+        allocator, NVC_BIGINT_SIZE(nvc_bigint_parse_limbs(len, radix)));
+    if (big) nvc_bigint_parse(big, str, len, radix);
+    return big;
+}
+
+static void nvc_free_tokens(nvc_allocator_t* allocator,
+                            nvc_tok_t* tokens,
+                            size_t len) {
     for (size_t i = 0; i < len; ++i) {
         switch (tokens[i].kind) {
-            case NVC_TOK_SYMBOL: free(tokens[i].symbol); break;
+            case NVC_TOK_SYMBOL: nvc_free(allocator, tokens[i].symbol); break;
             case NVC_TOK_STR_LIT:
                 // free if not NULL note: this can actually be NULL in the case
                 // of an empty literal
-                if (tokens[i].str_lit) free(tokens[i].str_lit);
+                if (tokens[i].str_lit) nvc_free(allocator, tokens[i].str_lit);
                 break;
+            case NVC_TOK_BIG_LIT: nvc_free(allocator, tokens[i].big_lit); break;
             default: break;
         }
     }
     // free buffer
-    free(tokens);
+    nvc_free(allocator, tokens);
 }
 
 void nvc_free_token_stream(nvc_token_stream_t* stream) {
     if (stream) {
-        nvc_free_tokens(stream->tokens, stream->size);
-        free(stream);
+        nvc_allocator_t* allocator = stream->allocator;
+        nvc_free_tokens(allocator, stream->tokens, stream->size);
+        nvc_free(allocator, stream);
     }
 }
 
 // note: return value of this MUST be freed
-char* nvc_token_to_str(nvc_tok_t* token) {
+char* nvc_token_to_str(nvc_allocator_t* allocator, nvc_tok_t* token) {
     switch (token->kind) {
         case NVC_TOK_SYMBOL: {
             // note: symbol is guaranteed non NULL unlike strlit
@@ -199,7 +223,7 @@ char* nvc_token_to_str(nvc_tok_t* token) {
             //      guaranteed
             size_t len = 6 + 1 + strlen(token->symbol) + 1;
             // can use malloc here because we know the exact size
-            char* symbolbuf = malloc(sizeof(char) * (len + 1));
+            char* symbolbuf = nvc_alloc(allocator, sizeof(char) * (len + 1));
             if (!symbolbuf) {
                 fprintf(stderr, "Out of memory!\n");
                 return NULL;
@@ -214,7 +238,8 @@ char* nvc_token_to_str(nvc_tok_t* token) {
                 //      is guaranteed
                 size_t len = 3 + 1 + strlen(token->str_lit) + 1;
                 // can use malloc here because we know the exact size
-                char* strstrbuf = malloc(sizeof(char) * (len + 1));
+                char* strstrbuf =
+                    nvc_alloc(allocator, sizeof(char) * (len + 1));
                 if (!strstrbuf) {
                     fprintf(stderr, "Out of memory!\n");
                     return NULL;
@@ -229,8 +254,7 @@ char* nvc_token_to_str(nvc_tok_t* token) {
                 // note: still allocate on heap to avoid confusion when freeing
                 // the return value of this function
                 const char* value = "str(NULL)";
-                // TODO: maybe use strndup although this should be totally safe
-                char* cpy = strdup(value);
+                char* cpy = nvc_strndup(allocator, value, strlen(value));
                 if (!cpy) {
                     fprintf(stderr, "Out of memory!\n");
                     return NULL;
@@ -248,7 +272,8 @@ char* nvc_token_to_str(nvc_tok_t* token) {
             do {
                 // note: calloc must be used here instead of malloc to act as
                 // null terminators
-                dblstr = calloc(max_allocation_size, sizeof(char));
+                dblstr =
+                    nvc_calloc(allocator, max_allocation_size, sizeof(char));
                 if (dblstr) break;
                 // * (2/3)
                 max_allocation_size = (max_allocation_size / 3) * 2;
@@ -262,33 +287,60 @@ char* nvc_token_to_str(nvc_tok_t* token) {
                         max_allocation_size);
                 return NULL;
             }
-            snprintf(dblstr, max_allocation_size, "fp(%.2Lf)", token->fp_lit);
+            snprintf(dblstr, max_allocation_size, "fp(%.2f%s)", token->fp_lit,
+                     nvc_width_to_str(token->width));
             // make SURE it's null terminated
             dblstr[max_allocation_size - 1] = '\0';
             return dblstr;
         }
         case NVC_TOK_INT_LIT: {
             // note: carefully chosen value, last + 1 is for null terminator
-            uint32_t max_allocation_size = 3 + 1 + 18 + 1 + 1;
+            uint32_t max_allocation_size = 3 + 1 + 19 + 3 + 1 + 1;
             // note: calloc must be used here instead of malloc to act as null
             // terminators
-            char* intstr = calloc(max_allocation_size, sizeof(char));
+            char* intstr =
+                nvc_calloc(allocator, max_allocation_size, sizeof(char));
             if (!intstr) {
                 fprintf(stderr, "Out of memory!\n");
                 return NULL;
             }
-            snprintf(intstr, max_allocation_size, "int(%ld)", token->int_lit);
+            snprintf(intstr, max_allocation_size, "int(%ld%s)",
+                     token->int_lit, nvc_width_to_str(token->width));
             // make SURE it's null terminated
             intstr[max_allocation_size - 1] = '\0';
             return intstr;
         }
+        case NVC_TOK_BIG_LIT: {
+            size_t len = 3 + 1 + nvc_bigint_str_size(token->big_lit) + 1;
+            char* bigstr = nvc_alloc(allocator, len);
+            if (!bigstr) {
+                fprintf(stderr, "Out of memory!\n");
+                return NULL;
+            }
+            memcpy(bigstr, "int(", 4);
+            nvc_bigint_to_str(token->big_lit, bigstr + 4);
+            strcat(bigstr, ")");
+            return bigstr;
+        }
+        case NVC_TOK_COMMENT: {
+            const char* end = strchr(token->comment + 1, '#');
+            int len = end ? (int)(end - token->comment) + 1 : 1;
+            char* commentstr = nvc_alloc(allocator, len + 10);
+            if (!commentstr) {
+                fprintf(stderr, "Out of memory!\n");
+                return NULL;
+            }
+            snprintf(commentstr, len + 10, "comment(%.*s)", len,
+                     token->comment);
+            return commentstr;
+        }
         case NVC_TOK_OP: {
             char* opstr = nvc_op_to_str(token->op_kind);
             // TODO: pretty sure opstr is guaranteed null terminated but maybe
             //      use strnlen just in case?
             size_t len = 2 + 1 + strlen(opstr) + 1;
             // can use malloc here because exact size is known
-            char* opstrcpy = malloc(sizeof(char) * (len + 1));
+            char* opstrcpy = nvc_alloc(allocator, sizeof(char) * (len + 1));
             if (!opstrcpy) {
                 fprintf(stderr, "Out of memory!\n");
                 return NULL;
@@ -303,29 +355,80 @@ char* nvc_token_to_str(nvc_tok_t* token) {
     return NULL;
 }
 
-nvc_token_stream_t* nvc_lexical_analysis(char* bufname, char* buf, long bufsz) {
-    // maximum amount of tokens, resize later
-    nvc_tok_t* toks = calloc(bufsz, sizeof(nvc_tok_t));
-    // out of memory
-    if (!toks) {
-        fprintf(stderr, "Out of memory!\n");
-        return NULL;
+void nvc_lexer_init(nvc_lexer_t* lexer,
+                    nvc_allocator_t* allocator,
+                    nvc_diagnostics_t* diags,
+                    char* bufname,
+                    char* buf,
+                    long bufsz) {
+    memset(lexer, 0, sizeof(nvc_lexer_t));
+    lexer->allocator = allocator;
+    lexer->diags = diags;
+    lexer->bufname = bufname;
+    lexer->buf = buf;
+    lexer->buf_curr = buf;
+    lexer->buf_end = buf + bufsz;
+    lexer->line_start_ptr = buf;
+
+    // note: the whole buffer is validated up front so the lexer can take the
+    // ASCII fast path for columns and only decodes identifier chars. the line
+    // of every invalid sequence is found by scanning on from the last one
+    bool ascii = true;
+    char* line_start_ptr = buf;
+    char* line_scan = buf;
+    uint32_t line_num = 0;
+    const char* p = buf;
+    while ((p = nvc_utf8_validate(p, lexer->buf_end, &ascii)) <
+           lexer->buf_end) {
+        for (; line_scan < p; ++line_scan) {
+            if (*line_scan == '\n') {
+                ++line_num;
+                line_start_ptr = line_scan + 1;
+            }
+        }
+        nvc_buffer_location_t loc = nvc_lexer_loc(lexer, line_start_ptr,
+                                                  line_num, (char*)p);
+        nvc_report(diags, NVC_SEVERITY_ERROR, &loc,
+                   "invalid UTF-8 byte '\\x%02x'", (unsigned char)*p);
+        if (nvc_diagnostics_full(diags)) break;
+        // note: one error per broken sequence, not per byte of it
+        ++p;
+        for (int i = 1; i < NVC_UTF8_MAX_LEN && p < lexer->buf_end &&
+                        ((unsigned char)*p & 0xC0) == 0x80;
+             ++i)
+            ++p;
     }
+    lexer->ascii = ascii;
+}
 
-    char* line_start_ptr = buf;
-    char* buf_curr = buf;
+#define NVC_LEXER_COMMENT_LF (1 << 1)
+#define NVC_LEXER_STRING_LITERAL_LF (1 << 2)
+
+uint32_t nvc_lexer_next(nvc_lexer_t* lexer, nvc_tok_t* toks, uint32_t max) {
+    if (lexer->done || lexer->failed) return 0;
+
+    // note: the state lives in locals while lexing and is stored back when
+    // the batch is full
+    nvc_allocator_t* allocator = lexer->allocator;
+    nvc_diagnostics_t* diags = lexer->diags;
+    char* buf = lexer->buf;
+    char* line_start_ptr = lexer->line_start_ptr;
+    char* buf_curr = lexer->buf_curr;
+    char* buf_end = lexer->buf_end;
     nvc_tok_t* toks_curr = toks;
-    size_t toks_size = 0;
+    uint32_t toks_size = 0;
 
-    const uint32_t COMMENT_LF = 1 << 1;
-    const uint32_t STRING_LITERAL_LF = 1 << 2;
-    uint32_t curr_flags = 0;
+    const uint32_t COMMENT_LF = NVC_LEXER_COMMENT_LF;
+    const uint32_t STRING_LITERAL_LF = NVC_LEXER_STRING_LITERAL_LF;
+    uint32_t curr_flags = lexer->flags;
+    // where the currently open comment or string literal started (errors)
+    nvc_buffer_location_t open_loc = lexer->open_loc;
 
     // note: here line is 0-indexed but will be 1-indexed when pretty
     // printed
-    uint32_t line_num = 0;
+    uint32_t line_num = lexer->line_num;
 
-    while (*buf_curr != '\0') {
+    while (toks_size < max && *buf_curr != '\0') {
         // handle special chars
         switch (*buf_curr) {
             case '\n': 
@@ -337,6 +440,17 @@ nvc_token_stream_t* nvc_lexical_analysis(char* bufname, char* buf, long bufsz) {
             case '#':
                 // don't toggle commenting if # is inside string literal
                 if (curr_flags & STRING_LITERAL_LF) break;
+                if (!(curr_flags & COMMENT_LF)) {
+                    open_loc = nvc_lexer_loc(lexer, line_start_ptr, line_num,
+                                             buf_curr);
+                    lexer->open_ptr = buf_curr;
+                } else if (lexer->comments) {
+                    toks_curr->kind = NVC_TOK_COMMENT;
+                    toks_curr->buf_loc = open_loc;
+                    toks_curr->comment = lexer->open_ptr;
+                    ++toks_curr;
+                    ++toks_size;
+                }
                 // toggle commenting
                 curr_flags ^= COMMENT_LF;
                 // eat curr and go to next
@@ -356,10 +470,12 @@ nvc_token_stream_t* nvc_lexical_analysis(char* bufname, char* buf, long bufsz) {
                         ;
                     // unable to find starting '
                     if (*str_lit_begin != '\'') {
-                        // TODO: report error
-                        fprintf(stderr, "syntax error: cant find previous '.");
-                        nvc_free_tokens(toks, toks_size);
-                        return NULL;
+                        nvc_buffer_location_t loc = nvc_lexer_loc(
+                            lexer, line_start_ptr, line_num, buf_curr);
+                        nvc_report(diags, NVC_SEVERITY_ERROR, &loc,
+                                   "cant find previous '");
+                        lexer->failed = true;
+                        goto out;
                     }
                     // advance + 1 so the starting ' is not included in the
                     // string literal
@@ -369,12 +485,13 @@ nvc_token_stream_t* nvc_lexical_analysis(char* bufname, char* buf, long bufsz) {
                     // non-empty string lit
                     if (strlitlen != 0) {
                         // allocate space
-                        char* strlitcpy =
-                            malloc((strlitlen + 1) * sizeof(char));
+                        char* strlitcpy = nvc_alloc(
+                            allocator, (strlitlen + 1) * sizeof(char));
                         if (!strlitcpy) {
-                            fprintf(stderr, "Out of memory!\n");
-                            nvc_free_tokens(toks, toks_size);
-                            return NULL;
+                            nvc_report(diags, NVC_SEVERITY_ERROR, NULL,
+                                       "out of memory");
+                            lexer->failed = true;
+                            goto out;
                         }
                         // copy string from buffer
                         strncpy(strlitcpy, str_lit_begin, strlitlen);
@@ -388,12 +505,13 @@ nvc_token_stream_t* nvc_lexical_analysis(char* bufname, char* buf, long bufsz) {
                     }
                     // insert token and advance pointer
                     toks_curr->kind = NVC_TOK_STR_LIT;
-                    toks_curr->buf_loc.bufname = bufname;
-                    toks_curr->buf_loc.l = line_num;
-                    toks_curr->buf_loc.c = buf_curr - line_start_ptr;
-                    toks_curr->buf_loc.line = line_start_ptr;
+                    toks_curr->buf_loc = nvc_lexer_loc(lexer, line_start_ptr,
+                                                       line_num, buf_curr);
                     ++toks_curr;
                     ++toks_size;
+                } else {
+                    open_loc = nvc_lexer_loc(lexer, line_start_ptr, line_num,
+                                             buf_curr);
                 }
                 // toggle string literal
                 curr_flags ^= STRING_LITERAL_LF;
@@ -410,27 +528,31 @@ nvc_token_stream_t* nvc_lexical_analysis(char* bufname, char* buf, long bufsz) {
         }
         // eat word characters and parse symbols
         char* buf_eat_start = buf_curr;
-        while (nvc_is_word(*buf_curr)) {
-            ++buf_curr;
+        size_t word_len = nvc_word_len(buf_curr, buf_end, true);
+        while (word_len) {
+            buf_curr += word_len;
+            word_len = nvc_word_len(buf_curr, buf_end, false);
         }
         // a symbol was eaten
         if (buf_eat_start != buf_curr) {
             // calculate str len
             size_t symbol_len = buf_curr - buf_eat_start;
             if (symbol_len < 1) {
-                // TODO: error reporting
-                fprintf(stderr,
-                        "illegal symbol: something went wrong while parsing "
-                        "symbol.\n");
-                nvc_free_tokens(toks, toks_size);
-                return NULL;
+                nvc_buffer_location_t loc = nvc_lexer_loc(
+                    lexer, line_start_ptr, line_num, buf_curr);
+                nvc_report(diags, NVC_SEVERITY_ERROR, &loc,
+                           "illegal symbol: something went wrong while parsing "
+                           "symbol");
+                lexer->failed = true;
+                goto out;
             }
             // allocate space note: this must be freed later
-            char* symbolcpy = malloc((symbol_len + 1) * sizeof(char));
+            char* symbolcpy =
+                nvc_alloc(allocator, (symbol_len + 1) * sizeof(char));
             if (!symbolcpy) {
-                fprintf(stderr, "Out of memory!\n");
-                nvc_free_tokens(toks, toks_size);
-                return NULL;
+                nvc_report(diags, NVC_SEVERITY_ERROR, NULL, "out of memory");
+                lexer->failed = true;
+                goto out;
             }
             // copy symbol
             strncpy(symbolcpy, buf_eat_start, symbol_len);
@@ -438,10 +560,8 @@ nvc_token_stream_t* nvc_lexical_analysis(char* bufname, char* buf, long bufsz) {
             symbolcpy[symbol_len] = '\0';
             // insert symbol token and advance pointer
             toks_curr->kind = NVC_TOK_SYMBOL;
-            toks_curr->buf_loc.bufname = bufname;
-            toks_curr->buf_loc.l = line_num;
-            toks_curr->buf_loc.c = buf_curr - line_start_ptr;
-            toks_curr->buf_loc.line = line_start_ptr;
+            toks_curr->buf_loc =
+                nvc_lexer_loc(lexer, line_start_ptr, line_num, buf_curr);
             toks_curr->symbol = symbolcpy;
             ++toks_curr;
             ++toks_size;
@@ -450,37 +570,60 @@ nvc_token_stream_t* nvc_lexical_analysis(char* bufname, char* buf, long bufsz) {
 
         // parsing numbers must be done before operators
         if (nvc_is_number(*buf_curr)) {
-            // try parse floating point first
-            char* end;
-            nvc_fp fp = nvc_parse_fp(buf_curr, &end);
-            // parsed decimal
-            if (buf_curr != end) {
-                toks_curr->kind = NVC_TOK_FP_LIT;
-                toks_curr->buf_loc.bufname = bufname;
-                toks_curr->buf_loc.l = line_num;
-                toks_curr->buf_loc.c = buf_curr - line_start_ptr;
-                toks_curr->buf_loc.line = line_start_ptr;
-                toks_curr->fp_lit = fp;
-                ++toks_curr;
-                ++toks_size;
-                // advance buf ptr
-                buf_curr = end;
-                continue;
-            }
-            // try parse int second
-            nvc_int i = nvc_parse_int(buf_curr, &end);
-            // parsed int
-            if (buf_curr != end) {
-                toks_curr->kind = NVC_TOK_INT_LIT;
-                toks_curr->buf_loc.bufname = bufname;
-                toks_curr->buf_loc.l = line_num;
-                toks_curr->buf_loc.c = buf_curr - line_start_ptr;
-                toks_curr->buf_loc.line = line_start_ptr;
-                toks_curr->int_lit = i;
+            // note: single pass, ints/decimals/exponents/hex/binary are all
+            // recognised by the scanner
+            nvc_number_t number;
+            size_t number_len = nvc_scan_number(buf_curr, buf_end, &number);
+            // parsed number
+            if (number_len) {
+                toks_curr->buf_loc =
+                    nvc_lexer_loc(lexer, line_start_ptr, line_num, buf_curr);
+                toks_curr->width = (uint8_t)number.width;
+                if (number.kind == NVC_NUMBER_FP) {
+                    toks_curr->kind = NVC_TOK_FP_LIT;
+                    toks_curr->fp_lit = number.fp;
+                } else {
+                    toks_curr->kind = NVC_TOK_INT_LIT;
+                    toks_curr->int_lit = number.i;
+                }
+                if (number.kind == NVC_NUMBER_INT && !number.width &&
+                    number.status == NVC_NUMBER_OVERFLOW) {
+                    // note: ints are exact, the scanner saturated it
+                    nvc_bigint_t* big =
+                        nvc_lex_big_int(allocator, buf_curr, number_len);
+                    if (!big) {
+                        nvc_report(diags, NVC_SEVERITY_ERROR, NULL,
+                                   "out of memory");
+                        lexer->failed = true;
+                        goto out;
+                    }
+                    toks_curr->kind = NVC_TOK_BIG_LIT;
+                    toks_curr->big_lit = big;
+                    number.status = NVC_NUMBER_OK;
+                }
+                switch (number.status) {
+                    case NVC_NUMBER_OK: break;
+                    case NVC_NUMBER_OVERFLOW:
+                        nvc_report(diags, NVC_SEVERITY_ERROR,
+                                   &toks_curr->buf_loc,
+                                   "number literal '%.*s' is too large",
+                                   (int)number_len, buf_curr);
+                        break;
+                    case NVC_NUMBER_MALFORMED:
+                        nvc_report(diags, NVC_SEVERITY_ERROR,
+                                   &toks_curr->buf_loc,
+                                   "malformed number literal '%.*s'",
+                                   (int)number_len, buf_curr);
+                        if (number.width)
+                            nvc_report(diags, NVC_SEVERITY_NOTE, NULL,
+                                       "i32 and i64 go after ints, f32 and "
+                                       "f64 after decimal numbers");
+                        break;
+                }
                 ++toks_curr;
                 ++toks_size;
                 // advance buf ptr
-                buf_curr = end;
+                buf_curr += number_len;
                 continue;
             }
         }
@@ -495,12 +638,13 @@ nvc_token_stream_t* nvc_lexical_analysis(char* bufname, char* buf, long bufsz) {
             size_t operator_len = buf_curr - buf_eat_start;
             // something went wrong here
             if (operator_len < 1) {
-                // TODO: error reporting
-                fprintf(stderr,
-                        "illegal operator: something went wrong while parsing "
-                        "operators.\n");
-                nvc_free_tokens(toks, toks_size);
-                return NULL;
+                nvc_buffer_location_t loc = nvc_lexer_loc(
+                    lexer, line_start_ptr, line_num, buf_curr);
+                nvc_report(diags, NVC_SEVERITY_ERROR, &loc,
+                           "illegal operator: something went wrong while "
+                           "parsing operators");
+                lexer->failed = true;
+                goto out;
             }
             // chained operator parsing
             else if (operator_len > 2) {
@@ -514,55 +658,131 @@ nvc_token_stream_t* nvc_lexical_analysis(char* bufname, char* buf, long bufsz) {
             buf_curr = buf_eat_start + operator_len;
 
             if (op == NVC_OP_UNKNOWN) {
-                // TODO: error reporting
-                char* errorstr = malloc((operator_len + 1) * sizeof(char));
-                if (!errorstr) {
-                    fprintf(stderr, "Out of memory!\n");
-                    nvc_free_tokens(toks, toks_size);
-                    return NULL;
-                }
-                strncpy(errorstr, buf_eat_start, operator_len);
-                errorstr[operator_len] = '\0';
-                fprintf(stderr, "unknown operator: '%s'.\n", errorstr);
-                free(errorstr);
-                // don't bother setting this to NULL as it immediately goes out
-                // of scope
-                //                errorstr = NULL;
-                nvc_free_tokens(toks, toks_size);
-                return NULL;
+                // note: print with a precision instead of copying the operator
+                nvc_buffer_location_t loc = nvc_lexer_loc(
+                    lexer, line_start_ptr, line_num, buf_eat_start);
+                nvc_report(diags, NVC_SEVERITY_ERROR, &loc,
+                           "unknown operator: '%c'", *buf_eat_start);
+                // recover by skipping the offending char
+                buf_curr = buf_eat_start + 1;
+                continue;
             }
 
             // insert operator token and advance pointer
             toks_curr->kind = NVC_TOK_OP;
-            toks_curr->buf_loc.bufname = bufname;
-            toks_curr->buf_loc.l = line_num;
-            toks_curr->buf_loc.c = buf_curr - line_start_ptr;
-            toks_curr->buf_loc.line = line_start_ptr;
+            toks_curr->buf_loc =
+                nvc_lexer_loc(lexer, line_start_ptr, line_num, buf_curr);
             toks_curr->op_kind = op;
             ++toks_size;
             ++toks_curr;
             continue;
         }
 
+        // a non-ASCII char that can not start an identifier, invalid
+        // sequences were already reported by nvc_lexer_init
+        if (*buf_curr & 0x80) {
+            uint32_t cp;
+            size_t len = nvc_utf8_decode(buf_curr, buf_end, &cp);
+            if (len) {
+                nvc_buffer_location_t loc = nvc_lexer_loc(
+                    lexer, line_start_ptr, line_num, buf_curr);
+                nvc_report(diags, NVC_SEVERITY_ERROR, &loc,
+                           "unexpected character U+%04X", cp);
+            }
+            buf_curr += len ? len : 1;
+            continue;
+        }
+
+        // anything else that is not whitespace can not start a token
+        if (*buf_curr != ' ' && *buf_curr != '\t' && *buf_curr != '\r') {
+            nvc_buffer_location_t loc =
+                nvc_lexer_loc(lexer, line_start_ptr, line_num, buf_curr);
+            if ((unsigned char)*buf_curr < 0x20 || *buf_curr == 0x7f)
+                nvc_report(diags, NVC_SEVERITY_ERROR, &loc,
+                           "unexpected character '\\x%02x'",
+                           (unsigned char)*buf_curr);
+            else
+                nvc_report(diags, NVC_SEVERITY_ERROR, &loc,
+                           "unexpected character '%c'", *buf_curr);
+        }
+
         // advance pointer
         ++buf_curr;
     }
 
-    // resize toks to save memory
-    toks = realloc(toks, sizeof(nvc_tok_t) * toks_size);
+    if (*buf_curr == '\0') {
+        lexer->done = true;
+        if (curr_flags & STRING_LITERAL_LF)
+            nvc_report(diags, NVC_SEVERITY_ERROR, &open_loc,
+                       "unterminated string literal");
+        else if (curr_flags & COMMENT_LF)
+            nvc_report(diags, NVC_SEVERITY_ERROR, &open_loc,
+                       "unterminated comment");
+    }
 
-    nvc_token_stream_t* token_stream = calloc(1, sizeof(nvc_token_stream_t));
+out:
+    lexer->line_start_ptr = line_start_ptr;
+    lexer->buf_curr = buf_curr;
+    lexer->flags = curr_flags;
+    lexer->open_loc = open_loc;
+    lexer->line_num = line_num;
+    return toks_size;
+}
+
+nvc_token_stream_t* nvc_lexical_analysis(nvc_allocator_t* allocator,
+                                         nvc_diagnostics_t* diags,
+                                         char* bufname,
+                                         char* buf,
+                                         long bufsz) {
+    nvc_lexer_t lexer;
+    nvc_lexer_init(&lexer, allocator, diags, bufname, buf, bufsz);
+
+    // note: guess roughly one token per 4 chars and grow as needed
+    uint32_t capacity = bufsz / 4 + 16;
+    uint32_t toks_size = 0;
+    nvc_tok_t* toks = nvc_alloc(allocator, capacity * sizeof(nvc_tok_t));
+    if (!toks) goto out_of_memory;
+
+    for (;;) {
+        // dynamic allocation
+        if (toks_size == capacity) {
+            capacity = (capacity / 2) * 3;
+            nvc_tok_t* grown =
+                nvc_realloc(allocator, toks, capacity * sizeof(nvc_tok_t));
+            if (!grown) goto out_of_memory;
+            toks = grown;
+        }
+        uint32_t n =
+            nvc_lexer_next(&lexer, toks + toks_size, capacity - toks_size);
+        toks_size += n;
+        if (lexer.failed) {
+            nvc_free_tokens(allocator, toks, toks_size);
+            return NULL;
+        }
+        if (lexer.done) break;
+    }
 
-    if (!token_stream) {
-        fprintf(stderr, "Out of memory!\n");
-        nvc_free_tokens(toks, toks_size);
-        return NULL;
+    // resize toks to save memory
+    // note: a failed shrink is harmless, keep the original buffer
+    if (toks_size) {
+        nvc_tok_t* shrunk =
+            nvc_realloc(allocator, toks, sizeof(nvc_tok_t) * toks_size);
+        if (shrunk) toks = shrunk;
     }
 
+    nvc_token_stream_t* token_stream =
+        nvc_calloc(allocator, 1, sizeof(nvc_token_stream_t));
+    if (!token_stream) goto out_of_memory;
+
+    token_stream->allocator = allocator;
     token_stream->tokens = toks;
     token_stream->size = toks_size;
 
     return token_stream;
+out_of_memory:
+    nvc_report(diags, NVC_SEVERITY_ERROR, NULL, "out of memory");
+    nvc_free_tokens(allocator, toks, toks_size);
+    return NULL;
 }
 
 #ifdef __cplusplus
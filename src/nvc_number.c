@@ -0,0 +1,314 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nvc_number.h>
+
+#include <errno.h>
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// note: the SWAR kernels below load 8 chars into a little endian word
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define NVC_NUMBER_SWAR 1
+#else
+#define NVC_NUMBER_SWAR 0
+#endif
+
+// largest power of ten that is exact in nvc_fp and largest mantissa that
+// converts to nvc_fp exactly, used by the exact fast path (Clinger)
+#define NVC_FP_MAX_EXACT_POW10 22
+#define NVC_FP_MAX_EXACT_MANTISSA ((uint64_t)1 << 53)
+
+static const nvc_fp nvc_fp_pow10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static inline bool nvc_is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+#if NVC_NUMBER_SWAR
+static inline uint64_t nvc_load_8(const char* str) {
+    uint64_t val;
+    memcpy(&val, str, sizeof(uint64_t));
+    return val;
+}
+
+// note: true when all 8 bytes are '0'..'9'
+static inline bool nvc_is_8_digits(uint64_t val) {
+    return (((val & 0xF0F0F0F0F0F0F0F0) |
+             (((val + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) ==
+            0x3333333333333333);
+}
+
+// note: converts 8 ascii digits to their value with 3 multiplications,
+// see http://govnokod.ru/13461 and Lemire's "fast_float"
+static inline uint32_t nvc_parse_8_digits(uint64_t val) {
+    const uint64_t mask = 0x000000FF000000FF;
+    const uint64_t mul1 = 0x000F424000000064;  // 100 + (1000000 << 32)
+    const uint64_t mul2 = 0x0000271000000001;  // 1 + (10000 << 32)
+    val -= 0x3030303030303030;
+    val = (val * 10) + (val >> 8);
+    val = (((val & mask) * mul1) + (((val >> 16) & mask) * mul2)) >> 32;
+    return (uint32_t)val;
+}
+#endif
+
+// accumulates decimal digits into *w, digits that no longer fit are counted
+// in *n_dropped and *nonzero_dropped is set when any of them was not 0.
+// *n_digits is incremented for every digit eaten
+static const char* nvc_scan_decimal_digits(const char* str,
+                                           const char* end,
+                                           uint64_t* w,
+                                           uint32_t* n_digits,
+                                           uint32_t* n_dropped,
+                                           bool* nonzero_dropped) {
+    uint64_t acc = *w;
+#if NVC_NUMBER_SWAR
+    // 8 digits at a time while the result can not overflow
+    // note: (2^64 - 1 - 99999999) / 10^8 * 10^8 + 99999999 < 2^64
+    while (end - str >= 8 &&
+           acc <= (UINT64_MAX - 99999999) / 100000000) {
+        uint64_t chunk = nvc_load_8(str);
+        if (!nvc_is_8_digits(chunk)) break;
+        acc = acc * 100000000 + nvc_parse_8_digits(chunk);
+        str += 8;
+        *n_digits += 8;
+    }
+#endif
+    for (; str < end && nvc_is_digit(*str); ++str) {
+        ++*n_digits;
+        uint64_t d = *str - '0';
+        if (acc <= (UINT64_MAX - 9) / 10) {
+            acc = acc * 10 + d;
+        } else {
+            ++*n_dropped;
+            if (d) *nonzero_dropped = true;
+        }
+    }
+    *w = acc;
+    return str;
+}
+
+static size_t nvc_scan_radix_int(const char* str,
+                                 const char* end,
+                                 uint32_t shift,
+                                 nvc_number_t* out) {
+    // note: str points after the 0x/0b prefix
+    const char* ptr = str;
+    uint64_t v = 0;
+    bool overflow = false;
+    for (; ptr < end; ++ptr) {
+        char c = *ptr;
+        uint64_t d;
+        if (c >= '0' && c <= '9')
+            d = c - '0';
+        else if (shift == 4 && (c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+            d = (c | 0x20) - 'a' + 10;
+        else
+            break;
+        if (d >> shift) break;  // e.g. 2 in a binary literal
+        if (v >> (64 - shift)) overflow = true;
+        v = (v << shift) | d;
+    }
+    out->kind = NVC_NUMBER_INT;
+    if (ptr == str) {
+        out->status = NVC_NUMBER_MALFORMED;
+        out->i = 0;
+    } else if (overflow || v > INT64_MAX) {
+        out->status = NVC_NUMBER_OVERFLOW;
+        out->i = INT64_MAX;
+    } else {
+        out->i = (nvc_int)v;
+    }
+    return ptr - str + 2;
+}
+
+// correctly rounded slow path, to a float for f32 literals
+static nvc_fp nvc_fp_fallback(const char* str,
+                              size_t len,
+                              bool f32,
+                              bool* overflow) {
+    char cpy[512];
+    const char* src = str;
+    // note: strtod needs a terminator, copy when possible otherwise rely on
+    // the lexer contract that the buffer is null terminated, the extent of
+    // the literal has already been validated so strtod stops at the same
+    // char either way (a suffix is not part of a number for it)
+    if (len < sizeof(cpy)) {
+        memcpy(cpy, str, len);
+        cpy[len] = '\0';
+        src = cpy;
+    }
+    errno = 0;
+    nvc_fp fp = f32 ? strtof(src, NULL) : strtod(src, NULL);
+    if (errno == ERANGE && isinf(fp)) *overflow = true;
+    return fp;
+}
+
+// the width of the suffix at str, NVC_WIDTH_NONE unless it is one of
+// i32/i64/f32/f64 not followed by more chars of a symbol
+static nvc_number_width_t nvc_scan_width(const char* str, const char* end) {
+    if (end - str < 3 || (str[0] != 'i' && str[0] != 'f'))
+        return NVC_WIDTH_NONE;
+    if (end - str > 3 && (nvc_is_digit(str[3]) || str[3] == '_' ||
+                          ((str[3] | 0x20) >= 'a' && (str[3] | 0x20) <= 'z')))
+        return NVC_WIDTH_NONE;
+    bool is_32 = str[1] == '3' && str[2] == '2';
+    bool is_64 = str[1] == '6' && str[2] == '4';
+    if (!is_32 && !is_64) return NVC_WIDTH_NONE;
+    if (str[0] == 'i') return is_32 ? NVC_WIDTH_I32 : NVC_WIDTH_I64;
+    return is_32 ? NVC_WIDTH_F32 : NVC_WIDTH_F64;
+}
+
+// checks an int against the range of an i suffix
+static void nvc_check_width(nvc_number_t* out) {
+    if (out->kind == NVC_NUMBER_FP) {
+        out->status = NVC_NUMBER_MALFORMED;
+        return;
+    }
+    if (out->width == NVC_WIDTH_I32 && out->i > INT32_MAX) {
+        out->status = NVC_NUMBER_OVERFLOW;
+        out->i = INT32_MAX;
+    }
+}
+
+const char* nvc_width_to_str(nvc_number_width_t width) {
+    switch (width) {
+        case NVC_WIDTH_NONE: return "";
+        case NVC_WIDTH_I32: return "i32";
+        case NVC_WIDTH_I64: return "i64";
+        case NVC_WIDTH_F32: return "f32";
+        case NVC_WIDTH_F64: return "f64";
+    }
+    return "";
+}
+
+size_t nvc_scan_number(const char* str, const char* end, nvc_number_t* out) {
+    out->kind = NVC_NUMBER_NONE;
+    out->status = NVC_NUMBER_OK;
+    out->width = NVC_WIDTH_NONE;
+    out->i = 0;
+    if (str >= end) return 0;
+
+    // hex and binary ints
+    if (str[0] == '0' && end - str >= 2) {
+        char prefix = str[1] | 0x20;
+        if (prefix == 'x' || prefix == 'b') {
+            size_t len =
+                nvc_scan_radix_int(str + 2, end, prefix == 'x' ? 4 : 1, out);
+            out->width = nvc_scan_width(str + len, end);
+            if (!out->width) return len;
+            // note: only decimal ints become fps with an f suffix (and hex
+            // digits would have eaten the f)
+            if (out->width >= NVC_WIDTH_F32)
+                out->status = NVC_NUMBER_MALFORMED;
+            else if (out->status == NVC_NUMBER_OK)
+                nvc_check_width(out);
+            return len + 3;
+        }
+    }
+
+    uint64_t w = 0;
+    uint32_t n_int_digits = 0, n_frac_digits = 0, n_dropped = 0;
+    bool truncated = false;
+    int64_t exp10 = 0;
+
+    // lhs of decimal point
+    const char* ptr = nvc_scan_decimal_digits(str, end, &w, &n_int_digits,
+                                              &n_dropped, &truncated);
+    // dropped integer digits still scale the value
+    exp10 += n_dropped;
+    bool is_fp = false;
+
+    // rhs of decimal point
+    if (ptr < end && *ptr == '.') {
+        const char* frac = ptr + 1;
+        uint32_t frac_dropped = 0;
+        const char* frac_end = nvc_scan_decimal_digits(
+            frac, end, &w, &n_frac_digits, &frac_dropped, &truncated);
+        // a lone . is not a number (it is the dot operator)
+        if (n_int_digits == 0 && n_frac_digits == 0) return 0;
+        exp10 -= (int64_t)n_frac_digits - frac_dropped;
+        ptr = frac_end;
+        is_fp = true;
+    }
+    if (n_int_digits == 0 && !is_fp) return 0;
+
+    // exponent
+    if (ptr < end && (*ptr | 0x20) == 'e') {
+        const char* exp_ptr = ptr + 1;
+        bool neg = false;
+        if (exp_ptr < end && (*exp_ptr == '+' || *exp_ptr == '-')) {
+            neg = *exp_ptr == '-';
+            ++exp_ptr;
+        }
+        if (exp_ptr < end && nvc_is_digit(*exp_ptr)) {
+            int64_t e = 0;
+            for (; exp_ptr < end && nvc_is_digit(*exp_ptr); ++exp_ptr) {
+                // note: saturate, anything this large is inf or 0 anyway
+                if (e < 100000) e = e * 10 + (*exp_ptr - '0');
+            }
+            exp10 += neg ? -e : e;
+            ptr = exp_ptr;
+            is_fp = true;
+        } else {
+            // 1e or 1e+ without exponent digits
+            out->kind = NVC_NUMBER_FP;
+            out->status = NVC_NUMBER_MALFORMED;
+            out->fp = 0.0;
+            return exp_ptr - str;
+        }
+    }
+
+    size_t len = ptr - str;
+    out->width = nvc_scan_width(ptr, end);
+    if (out->width) ptr += 3;
+    if (!is_fp && out->width < NVC_WIDTH_F32) {
+        out->kind = NVC_NUMBER_INT;
+        if (n_dropped || w > INT64_MAX) {
+            out->status = NVC_NUMBER_OVERFLOW;
+            out->i = INT64_MAX;
+        } else {
+            out->i = (nvc_int)w;
+            if (out->width) nvc_check_width(out);
+        }
+        return ptr - str;
+    }
+
+    out->kind = NVC_NUMBER_FP;
+    bool f32 = out->width == NVC_WIDTH_F32;
+    if (out->width == NVC_WIDTH_I32 || out->width == NVC_WIDTH_I64)
+        nvc_check_width(out);
+    // exact fast path: both w and 10^|exp10| are exact in nvc_fp so a single
+    // correctly rounded multiplication or division gives the exact result
+    if (w == 0) {
+        out->fp = 0.0;
+    } else if (!f32 && !truncated && w <= NVC_FP_MAX_EXACT_MANTISSA &&
+               exp10 >= -NVC_FP_MAX_EXACT_POW10 &&
+               exp10 <= NVC_FP_MAX_EXACT_POW10) {
+        nvc_fp fp = (nvc_fp)w;
+        if (exp10 < 0)
+            fp /= nvc_fp_pow10[-exp10];
+        else
+            fp *= nvc_fp_pow10[exp10];
+        out->fp = fp;
+    } else {
+        bool overflow = false;
+        out->fp = nvc_fp_fallback(str, len, f32, &overflow);
+        if (overflow) {
+            out->status = NVC_NUMBER_OVERFLOW;
+            out->fp = f32 ? FLT_MAX : DBL_MAX;
+        }
+    }
+    return ptr - str;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -8,42 +8,300 @@ extern "C" {
 #include <stdlib.h>
 #include <string.h>
 
-void nvc_print_buffer_message(const char* msg, nvc_buffer_location_t loc) {
+static void nvc_fprint_buffer_message(FILE* out,
+                                      const char* prefix,
+                                      const char* msg,
+                                      nvc_buffer_location_t loc) {
     // print location
-    fprintf(stderr, "%s: at: %s:%d:%d.\n", msg, loc.bufname, loc.l + 1, loc.c);
+    fprintf(out, "%s%s: at: %s:%d:%d.\n", prefix, msg, loc.bufname, loc.l + 1,
+            loc.c);
 
+    if (!loc.line) return;
     char* line_end_ptr = loc.line;
     // TODO: is newline function here in the future
-    while (++line_end_ptr && *line_end_ptr != '\0' && *line_end_ptr != '\n')
-        ;
-    if (!line_end_ptr || (*line_end_ptr != '\0' && *line_end_ptr != '\n')) {
-        fprintf(stderr, "error: unable to find end of line.\n");
-        return;
-    }
+    while (*line_end_ptr != '\0' && *line_end_ptr != '\n') ++line_end_ptr;
     size_t line_len = line_end_ptr - loc.line;
-    char* linecpy = malloc(sizeof(char) * (line_len + 1));
-    if (!linecpy) {
-        fprintf(stderr, "Out of memory!\n");
-        return;
-    }
-    // copy line
-    strncpy(linecpy, loc.line, line_len);
-    linecpy[line_len] = '\0';
-    fputs(linecpy, stderr);
-    fputc('\n', stderr);
+    // note: write the line straight from the buffer, no copy needed
+    fwrite(loc.line, sizeof(char), line_len, out);
+    fputc('\n', out);
     // print here
     // note len = strlen("^--- here")
     // print on left
     uint32_t here_msg_len = 1 + 3 + 1 + 4;
     if (loc.c >= here_msg_len) {
-        fprintf(stderr, "%*chere ---^\n", loc.c - here_msg_len, ' ');
+        fprintf(out, "%*chere ---^\n", loc.c - here_msg_len, ' ');
     }
     // print on right
-    else {
-        fprintf(stderr, "%*c^--- here\n", loc.c - 1, ' ');
+    else if (loc.c > 1) {
+        fprintf(out, "%*c^--- here\n", loc.c - 1, ' ');
+    } else {
+        fputs("^--- here\n", out);
+    }
+}
+
+void nvc_print_buffer_message(const char* msg, nvc_buffer_location_t loc) {
+    nvc_fprint_buffer_message(stderr, "", msg, loc);
+}
+
+void nvc_diagnostics_init(nvc_diagnostics_t* diags,
+                          nvc_allocator_t* allocator) {
+    memset(diags, 0, sizeof(nvc_diagnostics_t));
+    diags->allocator = allocator;
+}
+
+void nvc_diagnostics_clear(nvc_diagnostics_t* diags) {
+    for (uint32_t i = 0; i < diags->size; ++i) {
+        nvc_free(diags->allocator, diags->diags[i].msg);
+    }
+    diags->size = 0;
+    diags->n_errors = 0;
+    diags->n_warnings = 0;
+    diags->n_suppressed = 0;
+    diags->suppressing = false;
+}
+
+void nvc_diagnostics_free(nvc_diagnostics_t* diags) {
+    nvc_diagnostics_clear(diags);
+    nvc_free(diags->allocator, diags->diags);
+    diags->diags = NULL;
+    diags->capacity = 0;
+}
+
+const char* nvc_severity_to_str(nvc_severity_t severity) {
+    switch (severity) {
+        case NVC_SEVERITY_NOTE: return "note";
+        case NVC_SEVERITY_WARNING: return "warning";
+        case NVC_SEVERITY_ERROR: return "error";
+    }
+    return "unknown";
+}
+
+void nvc_print_diagnostic(FILE* out, const nvc_diagnostic_t* diag) {
+    char prefix[16];
+    snprintf(prefix, sizeof(prefix), "%s: ",
+             nvc_severity_to_str(diag->severity));
+    if (diag->has_loc) {
+        nvc_fprint_buffer_message(out, prefix, diag->msg, diag->loc);
+    } else {
+        fprintf(out, "%s%s.\n", prefix, diag->msg);
+    }
+}
+
+void nvc_print_diagnostics(FILE* out, const nvc_diagnostics_t* diags) {
+    for (uint32_t i = 0; i < diags->size; ++i) {
+        nvc_print_diagnostic(out, diags->diags + i);
+    }
+    if (diags->n_suppressed)
+        fprintf(out, "note: %u more errors were not reported (limit %u).\n",
+                diags->n_suppressed, diags->max_errors);
+    if (diags->n_errors || diags->n_warnings)
+        fprintf(out, "%u errors and %u warnings generated.\n",
+                diags->n_errors + diags->n_suppressed, diags->n_warnings);
+}
+
+bool nvc_diagnostics_full(const nvc_diagnostics_t* diags) {
+    return diags && diags->max_errors && diags->n_errors >= diags->max_errors;
+}
+
+// note: takes ownership of diag.msg
+static void nvc_diagnostics_add(nvc_diagnostics_t* diags,
+                                nvc_diagnostic_t diag) {
+    nvc_severity_t severity = diag.severity;
+    // error limit, notes follow the fate of their diagnostic
+    if (severity != NVC_SEVERITY_NOTE)
+        diags->suppressing = severity == NVC_SEVERITY_ERROR &&
+                             nvc_diagnostics_full(diags);
+    if (diags->suppressing) {
+        if (severity == NVC_SEVERITY_ERROR) ++diags->n_suppressed;
+        nvc_free(diags->allocator, diag.msg);
+        return;
     }
+
+    if (severity == NVC_SEVERITY_ERROR) ++diags->n_errors;
+    if (severity == NVC_SEVERITY_WARNING) ++diags->n_warnings;
+
+    // dynamic allocation
+    if (diags->size >= diags->capacity) {
+        uint32_t capacity = diags->capacity ? (diags->capacity / 2) * 3 : 8;
+        nvc_diagnostic_t* grown =
+            nvc_realloc(diags->allocator, diags->diags,
+                        capacity * sizeof(nvc_diagnostic_t));
+        if (!grown) {
+            fprintf(stderr, "Out of memory!\n");
+            nvc_free(diags->allocator, diag.msg);
+            return;
+        }
+        diags->diags = grown;
+        diags->capacity = capacity;
+    }
+    diags->diags[diags->size++] = diag;
+}
+
+void nvc_diagnostics_merge(nvc_diagnostics_t* dst, nvc_diagnostics_t* src) {
+    // note: the messages change owner so both sinks must share an allocator,
+    // the limit of dst applies as if they were reported to it directly
+    for (uint32_t i = 0; i < src->size; ++i)
+        nvc_diagnostics_add(dst, src->diags[i]);
+    dst->n_suppressed += src->n_suppressed;
+    src->size = 0;
+    nvc_diagnostics_clear(src);
+}
+
+bool nvc_diagnostics_copy(nvc_diagnostics_t* dst,
+                          const nvc_diagnostics_t* src) {
+    for (uint32_t i = 0; i < src->size; ++i) {
+        nvc_diagnostic_t diag = src->diags[i];
+        diag.msg = nvc_strndup(dst->allocator, diag.msg, strlen(diag.msg));
+        if (!diag.msg) return false;
+        nvc_diagnostics_add(dst, diag);
+    }
+    dst->n_suppressed += src->n_suppressed;
+    return true;
+}
+
+// note: sort key of a diagnostic, notes use the key of the diagnostic they
+// are attached to so groups stay together
+typedef struct {
+    const nvc_diagnostic_t* primary;
+    uint32_t group;  // report order of the primary
+    uint32_t index;  // report order of the diagnostic itself
+} nvc_diag_key_t;
+
+static int nvc_compare_locations(const nvc_diagnostic_t* lhs,
+                                 const nvc_diagnostic_t* rhs) {
+    // diagnostics without location go last
+    if (lhs->has_loc != rhs->has_loc) return lhs->has_loc ? -1 : 1;
+    if (!lhs->has_loc) return 0;
+    if (lhs->loc.bufname != rhs->loc.bufname) {
+        int cmp = strcmp(lhs->loc.bufname ? lhs->loc.bufname : "",
+                         rhs->loc.bufname ? rhs->loc.bufname : "");
+        if (cmp) return cmp;
+    }
+    if (lhs->loc.l != rhs->loc.l) return lhs->loc.l < rhs->loc.l ? -1 : 1;
+    if (lhs->loc.c != rhs->loc.c) return lhs->loc.c < rhs->loc.c ? -1 : 1;
+    return 0;
+}
+
+static int nvc_compare_diag_keys(const void* lhs_ptr, const void* rhs_ptr) {
+    const nvc_diag_key_t* lhs = lhs_ptr;
+    const nvc_diag_key_t* rhs = rhs_ptr;
+    if (lhs->group != rhs->group) {
+        int cmp = nvc_compare_locations(lhs->primary, rhs->primary);
+        if (cmp) return cmp;
+        return lhs->group < rhs->group ? -1 : 1;
+    }
+    return lhs->index < rhs->index ? -1 : lhs->index > rhs->index;
+}
+
+static bool nvc_diagnostics_equal(const nvc_diagnostic_t* lhs,
+                                  const nvc_diagnostic_t* rhs) {
+    return lhs->severity == rhs->severity &&
+           nvc_compare_locations(lhs, rhs) == 0 &&
+           strcmp(lhs->msg, rhs->msg) == 0;
+}
+
+void nvc_diagnostics_finish(nvc_diagnostics_t* diags) {
+    if (diags->size < 2) return;
+    nvc_diag_key_t* keys =
+        nvc_alloc(diags->allocator, diags->size * sizeof(nvc_diag_key_t));
+    nvc_diagnostic_t* sorted =
+        nvc_alloc(diags->allocator, diags->size * sizeof(nvc_diagnostic_t));
+    if (!keys || !sorted) {
+        // note: unsorted output is still correct output
+        nvc_free(diags->allocator, keys);
+        nvc_free(diags->allocator, sorted);
+        return;
+    }
+
+    uint32_t group = 0;
+    for (uint32_t i = 0; i < diags->size; ++i) {
+        if (diags->diags[i].severity != NVC_SEVERITY_NOTE || i == 0) group = i;
+        keys[i].primary = diags->diags + group;
+        keys[i].group = group;
+        keys[i].index = i;
+    }
+    qsort(keys, diags->size, sizeof(nvc_diag_key_t), nvc_compare_diag_keys);
+
+    // copy in sorted order dropping groups whose primary repeats the previous
+    // kept primary
+    uint32_t n_sorted = 0;
+    const nvc_diagnostic_t* last_primary = NULL;
+    bool dropping = false;
+    diags->n_errors = 0;
+    diags->n_warnings = 0;
+    for (uint32_t i = 0; i < diags->size; ++i) {
+        const nvc_diagnostic_t* diag = diags->diags + keys[i].index;
+        if (keys[i].index == keys[i].group) {
+            dropping =
+                last_primary && nvc_diagnostics_equal(last_primary, diag);
+            if (!dropping) last_primary = diag;
+        }
+        if (dropping) {
+            nvc_free(diags->allocator, diag->msg);
+            continue;
+        }
+        if (diag->severity == NVC_SEVERITY_ERROR) ++diags->n_errors;
+        if (diag->severity == NVC_SEVERITY_WARNING) ++diags->n_warnings;
+        sorted[n_sorted++] = *diag;
+    }
+
+    nvc_free(diags->allocator, keys);
+    nvc_free(diags->allocator, diags->diags);
+    diags->diags = sorted;
+    diags->capacity = diags->size;
+    diags->size = n_sorted;
+}
+
+void nvc_vreport(nvc_diagnostics_t* diags,
+                 nvc_severity_t severity,
+                 const nvc_buffer_location_t* loc,
+                 const char* fmt,
+                 va_list args) {
+    // format the message first, the length is needed for the allocation
+    va_list args_len;
+    va_copy(args_len, args);
+    int len = vsnprintf(NULL, 0, fmt, args_len);
+    va_end(args_len);
+    if (len < 0) return;
+
+    nvc_allocator_t* allocator = diags ? diags->allocator : NULL;
+    char* msg = nvc_alloc(allocator, len + 1);
+    if (!msg) {
+        // note: the message is lost but the error must still be counted
+        fprintf(stderr, "Out of memory!\n");
+        if (diags && severity == NVC_SEVERITY_ERROR) ++diags->n_errors;
+        return;
+    }
+    vsnprintf(msg, len + 1, fmt, args);
+
+    nvc_diagnostic_t diag = {
+        .severity = severity,
+        .has_loc = loc != NULL,
+        .msg = msg,
+    };
+    if (loc) diag.loc = *loc;
+
+    // no sink, print straight away
+    if (!diags) {
+        nvc_print_diagnostic(stderr, &diag);
+        nvc_free(NULL, msg);
+        return;
+    }
+
+    nvc_diagnostics_add(diags, diag);
+}
+
+void nvc_report(nvc_diagnostics_t* diags,
+                nvc_severity_t severity,
+                const nvc_buffer_location_t* loc,
+                const char* fmt,
+                ...) {
+    va_list args;
+    va_start(args, fmt);
+    nvc_vreport(diags, severity, loc, fmt, args);
+    va_end(args);
 }
 
 #ifdef __cplusplus
 }
-#endif
\ No newline at end of file
+#endif
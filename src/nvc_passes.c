@@ -0,0 +1,2208 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nvc_passes.h>
+
+#include <nvc_hash.h>
+#include <nvc_simd.h>
+
+#include <math.h>
+#include <string.h>
+
+void nvc_pass_manager_init(nvc_pass_manager_t* pm, nvc_allocator_t* allocator) {
+    memset(pm, 0, sizeof(nvc_pass_manager_t));
+    pm->allocator = allocator ? allocator : nvc_default_allocator();
+}
+
+void nvc_pass_manager_free(nvc_pass_manager_t* pm) {
+    nvc_free(pm->allocator, pm->passes);
+    pm->passes = NULL;
+    pm->n_passes = pm->capacity = 0;
+}
+
+bool nvc_pass_manager_add(nvc_pass_manager_t* pm,
+                          const char* name,
+                          nvc_pass_fn_t run) {
+    // dynamic allocation
+    if (pm->n_passes >= pm->capacity) {
+        uint32_t capacity = pm->capacity ? pm->capacity * 2 : 4;
+        nvc_pass_t* grown = nvc_realloc(pm->allocator, pm->passes,
+                                        capacity * sizeof(nvc_pass_t));
+        if (!grown) return false;
+        pm->passes = grown;
+        pm->capacity = capacity;
+    }
+    pm->passes[pm->n_passes++] = (nvc_pass_t){.name = name, .run = run};
+    return true;
+}
+
+bool nvc_pass_manager_add_defaults(nvc_pass_manager_t* pm) {
+    return nvc_pass_manager_add(pm, "simplify", nvc_pass_simplify) &&
+           nvc_pass_manager_add(pm, "copy-prop", nvc_pass_copy_propagation) &&
+           nvc_pass_manager_add(pm, "gvn", nvc_pass_gvn) &&
+           nvc_pass_manager_add(pm, "unroll", nvc_pass_unroll) &&
+           nvc_pass_manager_add(pm, "licm", nvc_pass_licm) &&
+           nvc_pass_manager_add(pm, "strength-reduce",
+                                nvc_pass_strength_reduction) &&
+           nvc_pass_manager_add(pm, "dce", nvc_pass_dce);
+}
+
+bool nvc_pass_manager_run(nvc_pass_manager_t* pm,
+                          nvc_diagnostics_t* diags,
+                          nvc_ir_module_t* module) {
+    for (uint32_t f = 0; f < module->n_functions; ++f) {
+        nvc_ir_function_t* fun = module->functions[f];
+        for (uint32_t round = 0; round < NVC_PASS_MAX_ROUNDS; ++round) {
+            bool changed = false;
+            for (uint32_t i = 0; i < pm->n_passes; ++i) {
+                nvc_pass_t* pass = pm->passes + i;
+                nvc_pass_result_t result = pass->run(fun);
+                if (result == NVC_PASS_OUT_OF_MEMORY) {
+                    nvc_report(diags, NVC_SEVERITY_ERROR, NULL,
+                               "out of memory");
+                    return false;
+                }
+                if (result == NVC_PASS_CHANGED) {
+                    changed = true;
+                    ++pass->n_changed;
+                }
+                if (pm->verify && !nvc_ir_verify(fun, diags)) {
+                    nvc_report(diags, NVC_SEVERITY_NOTE, NULL,
+                               "after pass '%s'", pass->name);
+                    return false;
+                }
+            }
+            if (!changed) break;
+        }
+    }
+    return true;
+}
+
+bool nvc_optimize_ir(nvc_allocator_t* allocator,
+                     nvc_diagnostics_t* diags,
+                     nvc_ir_module_t* module) {
+    nvc_pass_manager_t pm;
+    nvc_pass_manager_init(&pm, allocator);
+    bool ok = nvc_pass_manager_add_defaults(&pm);
+    if (!ok)
+        nvc_report(diags, NVC_SEVERITY_ERROR, NULL, "out of memory");
+    else
+        ok = nvc_pass_manager_run(&pm, diags, module);
+    // note: the functions are optimized before inlining so the cost model
+    // sees the size they end up with, the second run folds what the
+    // arguments make constant in the inlined bodies
+    nvc_pass_result_t result = ok ? nvc_pass_inline(module)
+                                  : NVC_PASS_UNCHANGED;
+    if (result == NVC_PASS_OUT_OF_MEMORY) {
+        nvc_report(diags, NVC_SEVERITY_ERROR, NULL, "out of memory");
+        ok = false;
+    } else if (result == NVC_PASS_CHANGED) {
+        ok = nvc_pass_manager_run(&pm, diags, module);
+    }
+    nvc_pass_manager_free(&pm);
+    return ok;
+}
+
+// the value a chain of copies ends at
+static nvc_ir_value_t nvc_ir_root(nvc_ir_function_t* fun,
+                                  nvc_ir_value_t value) {
+    while (fun->insts[value].op == NVC_IR_COPY)
+        value = fun->insts[value].ops[0];
+    return value;
+}
+
+static nvc_ir_inst_t* nvc_ir_const_of(nvc_ir_function_t* fun,
+                                      nvc_ir_value_t value) {
+    nvc_ir_inst_t* inst = fun->insts + nvc_ir_root(fun, value);
+    return inst->op == NVC_IR_CONST ? inst : NULL;
+}
+
+// nvc_ir_const_of that also finds the int constants that are not small
+static nvc_ir_inst_t* nvc_ir_int_const_of(nvc_ir_function_t* fun,
+                                          nvc_ir_value_t value) {
+    nvc_ir_inst_t* inst = fun->insts + nvc_ir_root(fun, value);
+    if (inst->type != NVC_IR_TYPE_INT || inst->length) return NULL;
+    return inst->op == NVC_IR_CONST || inst->op == NVC_IR_BIG ? inst : NULL;
+}
+
+static uint32_t nvc_ir_successors(nvc_ir_function_t* fun,
+                                  uint32_t block,
+                                  uint32_t succs[2]) {
+    nvc_ir_block_t* b = fun->blocks + block;
+    if (!b->n_insts) return 0;
+    nvc_ir_inst_t* last = fun->insts + b->insts[b->n_insts - 1];
+    succs[0] = last->targets[0];
+    succs[1] = last->targets[1];
+    return last->op == NVC_IR_BR ? 1 : last->op == NVC_IR_COND_BR ? 2 : 0;
+}
+
+static void nvc_ir_remove_pred(nvc_ir_function_t* fun,
+                               uint32_t block,
+                               uint32_t pred) {
+    nvc_ir_block_t* b = fun->blocks + block;
+    uint32_t index = 0;
+    while (index < b->n_preds && b->preds[index] != pred) ++index;
+    if (index == b->n_preds) return;
+    memmove(b->preds + index, b->preds + index + 1,
+            (b->n_preds - index - 1) * sizeof(uint32_t));
+    --b->n_preds;
+
+    // phis have one operand per predecessor
+    for (uint32_t i = 0; i < b->n_insts; ++i) {
+        nvc_ir_inst_t* inst = fun->insts + b->insts[i];
+        if (inst->op != NVC_IR_PHI) continue;
+        nvc_ir_value_t* operands = nvc_ir_operands(inst);
+        memmove(operands + index, operands + index + 1,
+                (inst->n_operands - index - 1) * sizeof(nvc_ir_value_t));
+        if (--inst->n_operands == 2) {
+            nvc_ir_value_t* many = inst->many;
+            inst->ops[0] = many[0];
+            inst->ops[1] = many[1];
+            nvc_free(fun->allocator, many);
+        }
+    }
+}
+
+static void nvc_ir_remove_inst(nvc_ir_function_t* fun, nvc_ir_value_t value) {
+    nvc_ir_inst_t* inst = fun->insts + value;
+    if (inst->n_operands > 2) nvc_free(fun->allocator, inst->many);
+    inst->op = NVC_IR_NOP;
+    inst->type = NVC_IR_TYPE_VOID;
+    inst->length = 0;
+    inst->n_operands = 0;
+    inst->block = NVC_IR_NONE;
+}
+
+// makes room for n more instructions in block
+static bool nvc_ir_reserve(nvc_ir_function_t* fun,
+                           nvc_ir_block_t* block,
+                           uint32_t n) {
+    if (block->n_insts + n <= block->capacity) return true;
+    // dynamic allocation
+    uint32_t capacity = (block->n_insts + n) / 2 * 3 + 4;
+    nvc_ir_value_t* grown = nvc_realloc(fun->allocator, block->insts,
+                                        capacity * sizeof(nvc_ir_value_t));
+    if (!grown) return false;
+    block->insts = grown;
+    block->capacity = capacity;
+    return true;
+}
+
+// nvc_ir_append but the instruction goes just before the terminator of block
+static nvc_ir_value_t nvc_ir_insert(nvc_ir_function_t* fun,
+                                    uint32_t block,
+                                    nvc_ir_op_t op,
+                                    nvc_ir_type_t type,
+                                    nvc_ir_value_t lhs,
+                                    nvc_ir_value_t rhs) {
+    nvc_ir_value_t value = nvc_ir_append(fun, block, op, type, lhs, rhs);
+    if (value == NVC_IR_NONE) return NVC_IR_NONE;
+    nvc_ir_block_t* b = fun->blocks + block;
+    b->insts[b->n_insts - 1] = b->insts[b->n_insts - 2];
+    b->insts[b->n_insts - 2] = value;
+    return value;
+}
+
+static void nvc_make_const(nvc_ir_inst_t* inst) {
+    inst->op = NVC_IR_CONST;
+    inst->n_operands = 0;
+    inst->ops[0] = inst->ops[1] = NVC_IR_NONE;
+}
+
+// op on the constants a and b of the fixed width type into c, like the
+// backends compute it: i32s and i64s wrap around and f32 results are
+// rounded to float. false when it traps
+static bool nvc_compute_fixed(nvc_ir_op_t op,
+                              nvc_ir_type_t type,
+                              const nvc_ir_inst_t* a,
+                              const nvc_ir_inst_t* b,
+                              nvc_ir_inst_t* c) {
+    if (type == NVC_IR_TYPE_F32) {
+        switch (op) {
+            case NVC_IR_NEG: c->fp = -a->fp; return true;
+            case NVC_IR_ADD: c->fp = nvc_round_f32(a->fp + b->fp); return true;
+            case NVC_IR_SUB: c->fp = nvc_round_f32(a->fp - b->fp); return true;
+            case NVC_IR_MUL: c->fp = nvc_round_f32(a->fp * b->fp); return true;
+            case NVC_IR_DIV: c->fp = nvc_round_f32(a->fp / b->fp); return true;
+            case NVC_IR_POW:
+                c->fp = nvc_round_f32(pow(a->fp, b->fp));
+                return true;
+            case NVC_IR_LT: c->b = a->fp < b->fp; return true;
+            case NVC_IR_LE: c->b = a->fp <= b->fp; return true;
+            case NVC_IR_GT: c->b = a->fp > b->fp; return true;
+            case NVC_IR_GE: c->b = a->fp >= b->fp; return true;
+            default: return false;
+        }
+    }
+    nvc_int i;
+    switch (op) {
+        case NVC_IR_NEG: i = nvc_wrap_sub(0, a->i); break;
+        case NVC_IR_NOT: i = ~a->i; break;
+        case NVC_IR_ADD: i = nvc_wrap_add(a->i, b->i); break;
+        case NVC_IR_SUB: i = nvc_wrap_sub(a->i, b->i); break;
+        case NVC_IR_MUL: i = nvc_wrap_mul(a->i, b->i); break;
+        case NVC_IR_DIV:
+            if (!b->i) return false;
+            i = nvc_wrap_div(a->i, b->i);
+            break;
+        case NVC_IR_POW:
+            if (b->i < 0) return false;
+            i = nvc_wrap_pow(a->i, b->i);
+            break;
+        case NVC_IR_LT: c->b = a->i < b->i; return true;
+        case NVC_IR_LE: c->b = a->i <= b->i; return true;
+        case NVC_IR_GT: c->b = a->i > b->i; return true;
+        case NVC_IR_GE: c->b = a->i >= b->i; return true;
+        default: return false;
+    }
+    c->i = type == NVC_IR_TYPE_I32 ? nvc_wrap_i32(i) : i;
+    return true;
+}
+
+// a, an int constant (small or not) or a number, converted to the type like
+// NVC_IR_CONVERT does into c. false for ints that are not small
+static bool nvc_compute_convert(nvc_ir_type_t type,
+                                const nvc_ir_inst_t* a,
+                                nvc_ir_inst_t* c) {
+    if (nvc_ir_is_integral(a->type)) {
+        nvc_int i = a->i;
+        if (a->op == NVC_IR_BIG) {
+            if (type == NVC_IR_TYPE_F32) {
+                c->fp = nvc_round_f32(nvc_bigint_to_fp(a->big));
+                return true;
+            }
+            i = nvc_bigint_wrap_i64(a->big);
+        }
+        switch (type) {
+            case NVC_IR_TYPE_INT: c->i = i; return nvc_is_small_int(i);
+            case NVC_IR_TYPE_I32: c->i = nvc_wrap_i32(i); return true;
+            case NVC_IR_TYPE_I64: c->i = i; return true;
+            case NVC_IR_TYPE_F32: c->fp = nvc_int_to_f32(i); return true;
+            case NVC_IR_TYPE_FP: c->fp = (nvc_fp)i; return true;
+            default: return false;
+        }
+    }
+    switch (type) {
+        case NVC_IR_TYPE_I32: c->i = nvc_fp_to_i32(a->fp); return true;
+        case NVC_IR_TYPE_I64: c->i = nvc_fp_to_i64(a->fp); return true;
+        case NVC_IR_TYPE_F32: c->fp = nvc_round_f32(a->fp); return true;
+        case NVC_IR_TYPE_FP: c->fp = a->fp; return true;
+        default: return false;
+    }
+}
+
+// computes inst from its constant operands, false when it can not be
+// computed at compile time (it would trap, or the int is not small)
+static bool nvc_fold(nvc_ir_inst_t* inst,
+                     const nvc_ir_inst_t* a,
+                     const nvc_ir_inst_t* b) {
+    if (inst->op == NVC_IR_CONVERT || nvc_ir_is_fixed(a->type)) {
+        nvc_ir_inst_t c;
+        if (inst->op == NVC_IR_CONVERT
+                ? !nvc_compute_convert(inst->type, a, &c)
+                : !nvc_compute_fixed(inst->op, a->type, a, b, &c))
+            return false;
+        nvc_make_const(inst);
+        if (inst->type == NVC_IR_TYPE_BOOL)
+            inst->b = c.b;
+        else if (nvc_ir_is_integral(inst->type))
+            inst->i = c.i;
+        else
+            inst->fp = c.fp;
+        return true;
+    }
+    bool is_int = a->type == NVC_IR_TYPE_INT;
+    nvc_int i = 0;
+    switch (inst->op) {
+        case NVC_IR_NEG:
+            if (!is_int) {
+                inst->fp = -a->fp;
+                break;
+            }
+            if (!nvc_small_sub(0, a->i, &i)) return false;
+            inst->i = i;
+            break;
+        case NVC_IR_NOT:
+            // note: the complement of a small int is small
+            if (is_int)
+                inst->i = ~a->i;
+            else
+                inst->b = !a->b;
+            break;
+        case NVC_IR_ITOF: inst->fp = (nvc_fp)a->i; break;
+        case NVC_IR_ADD:
+            if (!is_int) {
+                inst->fp = a->fp + b->fp;
+                break;
+            }
+            if (!nvc_small_add(a->i, b->i, &i)) return false;
+            inst->i = i;
+            break;
+        case NVC_IR_SUB:
+            if (!is_int) {
+                inst->fp = a->fp - b->fp;
+                break;
+            }
+            if (!nvc_small_sub(a->i, b->i, &i)) return false;
+            inst->i = i;
+            break;
+        case NVC_IR_MUL:
+            if (!is_int) {
+                inst->fp = a->fp * b->fp;
+                break;
+            }
+            if (!nvc_small_mul(a->i, b->i, &i)) return false;
+            inst->i = i;
+            break;
+        case NVC_IR_DIV:
+            if (!is_int) {
+                inst->fp = a->fp / b->fp;
+                break;
+            }
+            // note: only the smallest int divided by -1 is not small
+            if (b->i == 0 || !nvc_is_small_int(a->i / b->i)) return false;
+            inst->i = a->i / b->i;
+            break;
+        case NVC_IR_POW:
+            if (!is_int) {
+                inst->fp = pow(a->fp, b->fp);
+                break;
+            }
+            if (b->i < 0 || !nvc_small_pow(a->i, b->i, &i)) return false;
+            inst->i = i;
+            break;
+        case NVC_IR_LT:
+            inst->b = is_int ? a->i < b->i : a->fp < b->fp;
+            break;
+        case NVC_IR_LE:
+            inst->b = is_int ? a->i <= b->i : a->fp <= b->fp;
+            break;
+        case NVC_IR_GT:
+            inst->b = is_int ? a->i > b->i : a->fp > b->fp;
+            break;
+        case NVC_IR_GE:
+            inst->b = is_int ? a->i >= b->i : a->fp >= b->fp;
+            break;
+        default: return false;
+    }
+    nvc_make_const(inst);
+    return true;
+}
+
+// an int operand of nvc_fold_big, a small one is converted into storage
+static const nvc_bigint_t* nvc_fold_operand(const nvc_ir_inst_t* c,
+                                            nvc_bigint_i64_t* storage) {
+    if (c->op == NVC_IR_BIG) return c->big;
+    nvc_bigint_set_i64(&storage->value, c->i);
+    return &storage->value;
+}
+
+// nvc_fold for int operations whose operands or result are not small, a
+// result that is small becomes a constant again
+// note: running out of memory only costs the fold
+static bool nvc_fold_big(nvc_ir_function_t* fun,
+                         nvc_ir_inst_t* inst,
+                         const nvc_ir_inst_t* a,
+                         const nvc_ir_inst_t* b) {
+    nvc_bigint_i64_t lhs_storage, rhs_storage;
+    const nvc_bigint_t* lhs = nvc_fold_operand(a, &lhs_storage);
+    const nvc_bigint_t* rhs = b ? nvc_fold_operand(b, &rhs_storage) : NULL;
+    uint32_t n_lhs = lhs->n_limbs;
+    uint32_t n_rhs = rhs ? rhs->n_limbs : 0;
+    uint32_t n_max = n_lhs > n_rhs ? n_lhs : n_rhs;
+    switch (inst->op) {
+        case NVC_IR_ITOF:
+            inst->fp = nvc_bigint_to_fp(lhs);
+            nvc_make_const(inst);
+            return true;
+        case NVC_IR_CONVERT: {
+            nvc_ir_inst_t c;
+            if (!nvc_compute_convert(inst->type, a, &c)) return false;
+            nvc_make_const(inst);
+            if (inst->type == NVC_IR_TYPE_F32)
+                inst->fp = c.fp;
+            else
+                inst->i = c.i;
+            return true;
+        }
+        case NVC_IR_LT:
+        case NVC_IR_LE:
+        case NVC_IR_GT:
+        case NVC_IR_GE: {
+            int order = nvc_bigint_compare(lhs, rhs);
+            bool result = inst->op == NVC_IR_LT   ? order < 0
+                          : inst->op == NVC_IR_LE ? order <= 0
+                          : inst->op == NVC_IR_GT ? order > 0
+                                                  : order >= 0;
+            nvc_make_const(inst);
+            inst->b = result;
+            return true;
+        }
+        default: break;
+    }
+
+    nvc_allocator_t* allocator = fun->allocator;
+    nvc_bigint_t* result = NULL;
+    nvc_bigint_t* scratch = NULL;
+    bool folded = false;
+    switch (inst->op) {
+        case NVC_IR_NEG:
+            result = nvc_alloc(allocator, NVC_BIGINT_SIZE(n_lhs));
+            if (!result) goto out;
+            nvc_bigint_neg(result, lhs);
+            break;
+        case NVC_IR_NOT:
+            result = nvc_alloc(allocator, NVC_BIGINT_SIZE(n_lhs + 1));
+            if (!result) goto out;
+            nvc_bigint_not(result, lhs);
+            break;
+        case NVC_IR_ADD:
+        case NVC_IR_SUB:
+            result = nvc_alloc(allocator, NVC_BIGINT_SIZE(n_max + 1));
+            if (!result) goto out;
+            if (inst->op == NVC_IR_ADD)
+                nvc_bigint_add(result, lhs, rhs);
+            else
+                nvc_bigint_sub(result, lhs, rhs);
+            break;
+        case NVC_IR_MUL:
+            result = nvc_alloc(allocator, NVC_BIGINT_SIZE(n_lhs + n_rhs));
+            if (!result) goto out;
+            nvc_bigint_mul(result, lhs, rhs);
+            break;
+        case NVC_IR_DIV:
+            // note: division by zero traps at run time
+            if (!n_rhs) goto out;
+            result = nvc_alloc(allocator, NVC_BIGINT_SIZE(n_lhs));
+            scratch = nvc_alloc(allocator, NVC_BIGINT_SIZE(n_rhs + 1));
+            if (!result || !scratch) goto out;
+            nvc_bigint_div(result, scratch, lhs, rhs);
+            break;
+        case NVC_IR_POW: {
+            // note: negative exponents trap and huge powers are left to run
+            // time, where they trap too
+            int64_t exponent;
+            if (rhs->negative || !nvc_bigint_get_i64(rhs, &exponent)) goto out;
+            uint64_t n = nvc_bigint_pow_limbs(lhs, (uint64_t)exponent);
+            if (n > NVC_BIGINT_MAX_LIMBS) goto out;
+            result = nvc_alloc(allocator, NVC_BIGINT_SIZE(n));
+            scratch = nvc_alloc(allocator, NVC_BIGINT_SIZE(n));
+            if (!result || !scratch) goto out;
+            nvc_bigint_pow(result, scratch, lhs, (uint64_t)exponent);
+            break;
+        }
+        default: goto out;
+    }
+
+    int64_t i;
+    if (nvc_bigint_get_i64(result, &i) && nvc_is_small_int(i)) {
+        nvc_make_const(inst);
+        inst->i = i;
+        folded = true;
+        goto out;
+    }
+    nvc_bigint_t* big = nvc_ir_alloc_big(fun, result->n_limbs);
+    if (!big) goto out;
+    memcpy(big, result, NVC_BIGINT_SIZE(result->n_limbs));
+    nvc_make_const(inst);
+    inst->op = NVC_IR_BIG;
+    inst->big = big;
+    folded = true;
+out:
+    nvc_free(allocator, scratch);
+    nvc_free(allocator, result);
+    return folded;
+}
+
+static nvc_simd_op_t nvc_simd_op(nvc_ir_op_t op) {
+    switch (op) {
+        case NVC_IR_ADD: return NVC_SIMD_ADD;
+        case NVC_IR_SUB: return NVC_SIMD_SUB;
+        case NVC_IR_MUL: return NVC_SIMD_MUL;
+        case NVC_IR_DIV: return NVC_SIMD_DIV;
+        case NVC_IR_LT: return NVC_SIMD_LT;
+        case NVC_IR_LE: return NVC_SIMD_LE;
+        case NVC_IR_GT: return NVC_SIMD_GT;
+        default: return NVC_SIMD_GE;
+    }
+}
+
+// nvc_fold_array for conversions and the fixed width numbers, element by
+// element like nvc_fold
+static bool nvc_fold_array_fixed(nvc_ir_function_t* fun,
+                                 nvc_ir_inst_t* inst,
+                                 const nvc_ir_inst_t* a,
+                                 const nvc_ir_inst_t* b) {
+    uint32_t n = inst->length;
+    // the traps are looked for before anything is allocated
+    for (uint32_t pass = 0; pass < 2; ++pass) {
+        void* elems = NULL;
+        if (pass) {
+            elems = nvc_ir_alloc_elems(fun, inst->type, n);
+            if (!elems) return false;
+        }
+        for (uint32_t k = 0; k < n; ++k) {
+            nvc_ir_inst_t a_k = *a, b_k = *a, c;
+            nvc_ir_get_elem(a, k, &a_k);
+            if (b) nvc_ir_get_elem(b, k, &b_k);
+            if (inst->op == NVC_IR_CONVERT
+                    ? !nvc_compute_convert(inst->type, &a_k, &c)
+                    : !nvc_compute_fixed(inst->op, a->type, &a_k, &b_k, &c))
+                return false;
+            if (pass) nvc_ir_set_elem(elems, inst->type, k, &c);
+        }
+        if (pass) {
+            nvc_make_const(inst);
+            inst->ints = elems;
+        }
+    }
+    return true;
+}
+
+// nvc_fold for element-wise operations on constant arrays, the arithmetic
+// and comparisons run through the vector kernels. arrays are only folded
+// when every element of the result is small
+// note: running out of memory only costs the fold
+static bool nvc_fold_array(nvc_ir_function_t* fun,
+                           nvc_ir_inst_t* inst,
+                           const nvc_ir_inst_t* a,
+                           const nvc_ir_inst_t* b) {
+    uint32_t n = inst->length;
+    bool kernel = inst->op == NVC_IR_ADD || inst->op == NVC_IR_SUB ||
+                  inst->op == NVC_IR_MUL ||
+                  (inst->op >= NVC_IR_LT && inst->op <= NVC_IR_GE);
+    // note: the int kernels wrap around like i64s do, the other fixed width
+    // numbers and conversions go element by element
+    if (inst->op == NVC_IR_CONVERT ||
+        (nvc_ir_is_fixed(a->type) && !(a->type == NVC_IR_TYPE_I64 && kernel)))
+        return nvc_fold_array_fixed(fun, inst, a, b);
+    bool is_int = a->type == NVC_IR_TYPE_INT || a->type == NVC_IR_TYPE_I64;
+    // the traps and the results that are not small are looked for before
+    // anything is allocated, so the kernels below can not overflow
+    for (uint32_t k = 0; a->type == NVC_IR_TYPE_INT && k < n; ++k) {
+        nvc_int i;
+        bool small = true;
+        switch (inst->op) {
+            case NVC_IR_NEG: small = nvc_small_sub(0, a->ints[k], &i); break;
+            case NVC_IR_ADD:
+                small = nvc_small_add(a->ints[k], b->ints[k], &i);
+                break;
+            case NVC_IR_SUB:
+                small = nvc_small_sub(a->ints[k], b->ints[k], &i);
+                break;
+            case NVC_IR_MUL:
+                small = nvc_small_mul(a->ints[k], b->ints[k], &i);
+                break;
+            case NVC_IR_DIV:
+                small = b->ints[k] != 0 &&
+                        nvc_is_small_int(a->ints[k] / b->ints[k]);
+                break;
+            case NVC_IR_POW:
+                small = b->ints[k] >= 0 &&
+                        nvc_small_pow(a->ints[k], b->ints[k], &i);
+                break;
+            default: break;
+        }
+        if (!small) return false;
+    }
+
+    void* elems = nvc_ir_alloc_elems(fun, inst->type, n);
+    if (!elems) return false;
+    nvc_int* ints = elems;
+    nvc_fp* fps = elems;
+    uint8_t* bools = elems;
+    switch (inst->op) {
+        case NVC_IR_NEG:
+            for (uint32_t k = 0; k < n; ++k) {
+                if (is_int)
+                    ints[k] = -a->ints[k];
+                else
+                    fps[k] = -a->fps[k];
+            }
+            break;
+        case NVC_IR_NOT:
+            for (uint32_t k = 0; k < n; ++k) {
+                if (is_int)
+                    ints[k] = ~a->ints[k];
+                else
+                    bools[k] = !a->bools[k];
+            }
+            break;
+        case NVC_IR_ITOF:
+            for (uint32_t k = 0; k < n; ++k) fps[k] = (nvc_fp)a->ints[k];
+            break;
+        case NVC_IR_ADD:
+        case NVC_IR_SUB:
+        case NVC_IR_MUL:
+            if (is_int)
+                nvc_simd_i64(nvc_simd_op(inst->op), ints, a->ints, b->ints, n);
+            else
+                nvc_simd_f64(nvc_simd_op(inst->op), fps, a->fps, b->fps, n);
+            break;
+        case NVC_IR_DIV:
+            if (!is_int) {
+                nvc_simd_f64(NVC_SIMD_DIV, fps, a->fps, b->fps, n);
+                break;
+            }
+            for (uint32_t k = 0; k < n; ++k) ints[k] = a->ints[k] / b->ints[k];
+            break;
+        case NVC_IR_POW:
+            for (uint32_t k = 0; k < n; ++k) {
+                if (is_int)
+                    nvc_small_pow(a->ints[k], b->ints[k], ints + k);
+                else
+                    fps[k] = pow(a->fps[k], b->fps[k]);
+            }
+            break;
+        case NVC_IR_LT:
+        case NVC_IR_LE:
+        case NVC_IR_GT:
+        case NVC_IR_GE:
+            if (is_int)
+                nvc_simd_i64_compare(nvc_simd_op(inst->op), bools, a->ints,
+                                     b->ints, n);
+            else
+                nvc_simd_f64_compare(nvc_simd_op(inst->op), bools, a->fps,
+                                     b->fps, n);
+            break;
+        default: return false;
+    }
+    nvc_make_const(inst);
+    inst->ints = elems;
+    return true;
+}
+
+// folds array operations on constants, and indexing into arrays whose
+// element is known
+static bool nvc_simplify_array(nvc_ir_function_t* fun, nvc_ir_value_t value) {
+    nvc_ir_inst_t* inst = fun->insts + value;
+    nvc_ir_value_t* operands = nvc_ir_operands(inst);
+    switch (inst->op) {
+        case NVC_IR_INDEX: {
+            nvc_ir_inst_t* c = nvc_ir_const_of(fun, inst->ops[1]);
+            nvc_ir_inst_t* array = fun->insts + nvc_ir_root(fun, inst->ops[0]);
+            // note: out of bounds traps at run time
+            if (!c || c->i < 0 || (uint64_t)c->i >= array->length) return false;
+            if (array->op == NVC_IR_CONST) {
+                nvc_ir_get_elem(array, (uint32_t)c->i, inst);
+                nvc_make_const(inst);
+                return true;
+            }
+            if (array->op == NVC_IR_ARRAY) {
+                nvc_ir_replace_with_copy(fun, value,
+                                         nvc_ir_operands(array)[c->i]);
+                return true;
+            }
+            if (array->op == NVC_IR_SPLAT) {
+                nvc_ir_replace_with_copy(fun, value, array->ops[0]);
+                return true;
+            }
+            return false;
+        }
+        case NVC_IR_ARRAY:
+        case NVC_IR_SPLAT: {
+            for (uint32_t k = 0; k < inst->n_operands; ++k) {
+                if (!nvc_ir_const_of(fun, operands[k])) return false;
+            }
+            void* elems = nvc_ir_alloc_elems(fun, inst->type, inst->length);
+            if (!elems) return false;
+            for (uint32_t k = 0; k < inst->length; ++k) {
+                const nvc_ir_inst_t* c = nvc_ir_const_of(
+                    fun, operands[inst->op == NVC_IR_ARRAY ? k : 0]);
+                nvc_ir_set_elem(elems, inst->type, k, c);
+            }
+            if (inst->n_operands > 2) nvc_free(fun->allocator, inst->many);
+            nvc_make_const(inst);
+            inst->ints = elems;
+            return true;
+        }
+        default: {
+            nvc_ir_inst_t* a = nvc_ir_const_of(fun, inst->ops[0]);
+            nvc_ir_inst_t* b = inst->n_operands > 1
+                                   ? nvc_ir_const_of(fun, inst->ops[1])
+                                   : NULL;
+            if (!a || (inst->n_operands > 1 && !b)) return false;
+            return nvc_fold_array(fun, inst, a, b);
+        }
+    }
+}
+
+// note: fp constants only match when the rewrite is exact, e.g. x - 0.0 is
+// x for every x but x + 0.0 is not (-0.0 + 0.0 is 0.0)
+static bool nvc_is_const_value(const nvc_ir_inst_t* c, int value) {
+    if (!c) return false;
+    if (nvc_ir_is_integral(c->type)) return c->i == value;
+    if (c->type == NVC_IR_TYPE_FP || c->type == NVC_IR_TYPE_F32)
+        return c->fp == (nvc_fp)value && !signbit(c->fp);
+    return false;
+}
+
+static bool nvc_is_commutative(nvc_ir_op_t op) {
+    return op == NVC_IR_ADD || op == NVC_IR_MUL;
+}
+
+static bool nvc_simplify_inst(nvc_ir_function_t* fun, nvc_ir_value_t value) {
+    nvc_ir_inst_t* inst = fun->insts + value;
+    switch (inst->op) {
+        case NVC_IR_ADD:
+        case NVC_IR_SUB:
+        case NVC_IR_MUL:
+        case NVC_IR_DIV:
+        case NVC_IR_POW:
+        case NVC_IR_NEG:
+        case NVC_IR_NOT:
+        case NVC_IR_LT:
+        case NVC_IR_LE:
+        case NVC_IR_GT:
+        case NVC_IR_GE:
+        case NVC_IR_ITOF:
+        case NVC_IR_CONVERT:
+        case NVC_IR_ARRAY:
+        case NVC_IR_SPLAT:
+        case NVC_IR_INDEX: break;
+        case NVC_IR_FIELD: {
+            // note: a field of a record built in this function is the value
+            // it was built from
+            nvc_ir_inst_t* record = fun->insts + nvc_ir_root(fun, inst->ops[0]);
+            if (record->op != NVC_IR_RECORD) return false;
+            nvc_ir_replace_with_copy(fun, value,
+                                     nvc_ir_operands(record)[inst->field]);
+            return true;
+        }
+        default: return false;
+    }
+    // note: only folding applies to arrays, the identities below are written
+    // for scalars
+    if (inst->length || inst->op == NVC_IR_INDEX)
+        return nvc_simplify_array(fun, value);
+    bool changed = false;
+    nvc_ir_type_t type = fun->insts[inst->ops[0]].type;
+    bool is_int = nvc_ir_is_integral(type);
+
+    // constants go right so identities and value numbering see one form
+    if (nvc_is_commutative(inst->op) && nvc_ir_const_of(fun, inst->ops[0]) &&
+        !nvc_ir_const_of(fun, inst->ops[1])) {
+        nvc_ir_value_t lhs = inst->ops[0];
+        inst->ops[0] = inst->ops[1];
+        inst->ops[1] = lhs;
+        changed = true;
+    }
+
+    nvc_ir_value_t x = inst->ops[0];
+    nvc_ir_inst_t* a = nvc_ir_const_of(fun, x);
+    nvc_ir_inst_t* c =
+        inst->n_operands > 1 ? nvc_ir_const_of(fun, inst->ops[1]) : NULL;
+    if (a && (inst->n_operands == 1 || c)) {
+        if (nvc_fold(inst, a, c)) return true;
+    }
+    // note: the slow path for ints that are not small, as operands or as
+    // the result
+    if (type == NVC_IR_TYPE_INT) {
+        nvc_ir_inst_t* big_a = nvc_ir_int_const_of(fun, x);
+        nvc_ir_inst_t* big_c = inst->n_operands > 1
+                                   ? nvc_ir_int_const_of(fun, inst->ops[1])
+                                   : NULL;
+        if (big_a && (inst->n_operands == 1 || big_c) &&
+            nvc_fold_big(fun, inst, big_a, big_c))
+            return true;
+    }
+
+    bool same = inst->n_operands > 1 &&
+                nvc_ir_root(fun, x) == nvc_ir_root(fun, inst->ops[1]);
+    switch (inst->op) {
+        case NVC_IR_ADD:
+            if (is_int && nvc_is_const_value(c, 0)) goto copy_x;
+            break;
+        case NVC_IR_SUB:
+            if (nvc_is_const_value(c, 0)) goto copy_x;
+            if (is_int && same) {
+                nvc_make_const(inst);
+                inst->i = 0;
+                return true;
+            }
+            break;
+        case NVC_IR_MUL:
+            if (nvc_is_const_value(c, 1)) goto copy_x;
+            if (is_int && nvc_is_const_value(c, 0)) {
+                nvc_make_const(inst);
+                inst->i = 0;
+                return true;
+            }
+            if (c && (is_int ? c->i == -1 : c->fp == -1)) {
+                inst->op = NVC_IR_NEG;
+                inst->n_operands = 1;
+                inst->ops[1] = NVC_IR_NONE;
+                return true;
+            }
+            break;
+        case NVC_IR_DIV:
+            if (nvc_is_const_value(c, 1)) goto copy_x;
+            break;
+        case NVC_IR_POW:
+            // note: x^0 is 1 even for nan and infinities
+            if (c && (is_int ? c->i == 0 : c->fp == 0)) {
+                nvc_make_const(inst);
+                if (is_int)
+                    inst->i = 1;
+                else
+                    inst->fp = 1;
+                return true;
+            }
+            if (nvc_is_const_value(c, 1)) goto copy_x;
+            if (nvc_is_const_value(c, 2)) {
+                inst->op = NVC_IR_MUL;
+                inst->ops[1] = x;
+                return true;
+            }
+            break;
+        case NVC_IR_NEG:
+        case NVC_IR_NOT: {
+            // --x and ~~x
+            nvc_ir_inst_t* inner = fun->insts + nvc_ir_root(fun, x);
+            if (inner->op == inst->op) {
+                nvc_ir_replace_with_copy(fun, value, inner->ops[0]);
+                return true;
+            }
+            break;
+        }
+        case NVC_IR_LT:
+        case NVC_IR_GT:
+        case NVC_IR_LE:
+        case NVC_IR_GE:
+            // note: fp compares unequal to itself when nan
+            if (is_int && same) {
+                bool result = inst->op == NVC_IR_LE || inst->op == NVC_IR_GE;
+                nvc_make_const(inst);
+                inst->b = result;
+                return true;
+            }
+            break;
+        default: break;
+    }
+    return changed;
+copy_x:
+    nvc_ir_replace_with_copy(fun, value, x);
+    return true;
+}
+
+// a phi whose operands are all the same value, apart from the phi itself
+// (around a loop that does not change it), is that value
+static bool nvc_simplify_phi(nvc_ir_function_t* fun, nvc_ir_value_t value) {
+    nvc_ir_inst_t* inst = fun->insts + value;
+    nvc_ir_value_t* operands = nvc_ir_operands(inst);
+    nvc_ir_value_t same = NVC_IR_NONE;
+    for (uint32_t i = 0; i < inst->n_operands; ++i) {
+        nvc_ir_value_t root = nvc_ir_root(fun, operands[i]);
+        if (root == value || root == same) continue;
+        if (same != NVC_IR_NONE) return false;
+        same = root;
+    }
+    if (same == NVC_IR_NONE) return false;
+    nvc_ir_replace_with_copy(fun, value, same);
+    return true;
+}
+
+// a conditional branch on a constant becomes a jump to the target it takes
+static bool nvc_simplify_branch(nvc_ir_function_t* fun, uint32_t block) {
+    nvc_ir_block_t* b = fun->blocks + block;
+    if (!b->n_insts) return false;
+    nvc_ir_inst_t* inst = fun->insts + b->insts[b->n_insts - 1];
+    if (inst->op != NVC_IR_COND_BR) return false;
+    nvc_ir_inst_t* c = nvc_ir_const_of(fun, inst->ops[0]);
+    if (!c) return false;
+    uint32_t taken = inst->targets[c->b ? 0 : 1];
+    uint32_t dropped = inst->targets[c->b ? 1 : 0];
+    inst->op = NVC_IR_BR;
+    inst->n_operands = 0;
+    inst->ops[0] = NVC_IR_NONE;
+    inst->targets[0] = taken;
+    inst->targets[1] = 0;
+    nvc_ir_remove_pred(fun, dropped, block);
+    return true;
+}
+
+// merges a block into its only predecessor when that one jumps straight to
+// it, which straightens the chains of blocks folded branches and unrolled
+// loops leave behind
+static nvc_pass_result_t nvc_merge_blocks(nvc_ir_function_t* fun) {
+    bool changed = false;
+    for (uint32_t b = 0; b < fun->n_blocks; ++b) {
+        for (;;) {
+            nvc_ir_block_t* block = fun->blocks + b;
+            if (block->removed || !block->n_insts) break;
+            nvc_ir_inst_t* last = fun->insts + block->insts[block->n_insts - 1];
+            if (last->op != NVC_IR_BR) break;
+            uint32_t t = last->targets[0];
+            nvc_ir_block_t* target = fun->blocks + t;
+            if (t == b || t == 0 || target->n_preds != 1) break;
+            if (!nvc_ir_reserve(fun, block, target->n_insts))
+                return NVC_PASS_OUT_OF_MEMORY;
+
+            // note: the phis of a block with one predecessor are the value
+            // coming from it
+            nvc_ir_remove_inst(fun, block->insts[--block->n_insts]);
+            for (uint32_t i = 0; i < target->n_insts; ++i) {
+                nvc_ir_value_t value = target->insts[i];
+                nvc_ir_inst_t* inst = fun->insts + value;
+                if (inst->op == NVC_IR_PHI)
+                    nvc_ir_replace_with_copy(fun, value, inst->ops[0]);
+                inst->block = b;
+                block->insts[block->n_insts++] = value;
+            }
+            uint32_t succs[2];
+            uint32_t n_succs = nvc_ir_successors(fun, b, succs);
+            for (uint32_t i = 0; i < n_succs; ++i) {
+                nvc_ir_block_t* succ = fun->blocks + succs[i];
+                for (uint32_t p = 0; p < succ->n_preds; ++p) {
+                    if (succ->preds[p] == t) succ->preds[p] = b;
+                }
+            }
+            target->n_insts = 0;
+            target->n_preds = 0;
+            target->removed = true;
+            changed = true;
+        }
+    }
+    return changed ? NVC_PASS_CHANGED : NVC_PASS_UNCHANGED;
+}
+
+nvc_pass_result_t nvc_pass_simplify(nvc_ir_function_t* fun) {
+    bool changed = false;
+    for (uint32_t b = 0; b < fun->n_blocks; ++b) {
+        nvc_ir_block_t* block = fun->blocks + b;
+        for (uint32_t i = 0; i < block->n_insts; ++i) {
+            nvc_ir_value_t value = block->insts[i];
+            if (fun->insts[value].op != NVC_IR_PHI) {
+                changed |= nvc_simplify_inst(fun, value);
+                continue;
+            }
+            if (!nvc_simplify_phi(fun, value)) continue;
+            // note: phis stay first in their block, the copy goes after
+            // them and the phi that took its place is looked at next
+            uint32_t j = i;
+            while (j + 1 < block->n_insts &&
+                   fun->insts[block->insts[j + 1]].op == NVC_IR_PHI) {
+                block->insts[j] = block->insts[j + 1];
+                ++j;
+            }
+            block->insts[j] = value;
+            if (j != i) --i;
+            changed = true;
+        }
+        changed |= nvc_simplify_branch(fun, b);
+    }
+    nvc_pass_result_t merged = nvc_merge_blocks(fun);
+    if (merged == NVC_PASS_OUT_OF_MEMORY) return merged;
+    return changed || merged == NVC_PASS_CHANGED ? NVC_PASS_CHANGED
+                                                 : NVC_PASS_UNCHANGED;
+}
+
+nvc_pass_result_t nvc_pass_copy_propagation(nvc_ir_function_t* fun) {
+    bool changed = false;
+    for (uint32_t b = 0; b < fun->n_blocks; ++b) {
+        nvc_ir_block_t* block = fun->blocks + b;
+        for (uint32_t i = 0; i < block->n_insts; ++i) {
+            nvc_ir_inst_t* inst = fun->insts + block->insts[i];
+            nvc_ir_value_t* operands = nvc_ir_operands(inst);
+            for (uint32_t j = 0; j < inst->n_operands; ++j) {
+                nvc_ir_value_t root = nvc_ir_root(fun, operands[j]);
+                if (root == operands[j]) continue;
+                operands[j] = root;
+                changed = true;
+            }
+        }
+    }
+    return changed ? NVC_PASS_CHANGED : NVC_PASS_UNCHANGED;
+}
+
+// reverse post order of the blocks reachable from the entry, returns how
+// many there are. order must have room for every block
+static uint32_t nvc_ir_reverse_post_order(nvc_ir_function_t* fun,
+                                          uint32_t* order,
+                                          uint32_t* stack,
+                                          uint8_t* state) {
+    // note: state is 0 unvisited, 1 on the stack with its successors left
+    // to visit, 2 done
+    memset(state, 0, fun->n_blocks);
+    uint32_t n_stack = 0, n_done = 0;
+    stack[n_stack++] = 0;
+    state[0] = 1;
+    while (n_stack) {
+        uint32_t block = stack[n_stack - 1];
+        uint32_t succs[2];
+        uint32_t n_succs = nvc_ir_successors(fun, block, succs);
+        bool pushed = false;
+        for (uint32_t i = 0; i < n_succs && !pushed; ++i) {
+            if (state[succs[i]]) continue;
+            state[succs[i]] = 1;
+            stack[n_stack++] = succs[i];
+            pushed = true;
+        }
+        if (pushed) continue;
+        state[block] = 2;
+        order[n_done++] = block;
+        --n_stack;
+    }
+    for (uint32_t i = 0; i < n_done / 2; ++i) {
+        uint32_t tmp = order[i];
+        order[i] = order[n_done - 1 - i];
+        order[n_done - 1 - i] = tmp;
+    }
+    return n_done;
+}
+
+nvc_pass_result_t nvc_pass_dce(nvc_ir_function_t* fun) {
+    bool changed = false;
+    uint32_t n_scratch =
+        fun->n_blocks > fun->n_insts ? fun->n_blocks : fun->n_insts;
+    uint32_t* stack = nvc_alloc(fun->allocator, n_scratch * sizeof(uint32_t));
+    uint32_t* order = nvc_alloc(fun->allocator, n_scratch * sizeof(uint32_t));
+    uint8_t* marks = nvc_alloc(fun->allocator, n_scratch);
+    if (!stack || !order || !marks) {
+        nvc_free(fun->allocator, stack);
+        nvc_free(fun->allocator, order);
+        nvc_free(fun->allocator, marks);
+        return NVC_PASS_OUT_OF_MEMORY;
+    }
+
+    // unreachable blocks
+    uint32_t n_reachable = nvc_ir_reverse_post_order(fun, order, stack, marks);
+    if (n_reachable != fun->n_blocks) {
+        for (uint32_t b = 0; b < fun->n_blocks; ++b) {
+            nvc_ir_block_t* block = fun->blocks + b;
+            if (marks[b] || block->removed) continue;
+            uint32_t succs[2];
+            uint32_t n_succs = nvc_ir_successors(fun, b, succs);
+            for (uint32_t i = 0; i < n_succs; ++i) {
+                nvc_ir_remove_pred(fun, succs[i], b);
+            }
+            for (uint32_t i = 0; i < block->n_insts; ++i) {
+                nvc_ir_remove_inst(fun, block->insts[i]);
+            }
+            block->n_insts = 0;
+            block->removed = true;
+            changed = true;
+        }
+    }
+
+    // mark everything the effects depend on
+    memset(marks, 0, fun->n_insts);
+    uint32_t n_stack = 0;
+    for (uint32_t b = 0; b < fun->n_blocks; ++b) {
+        nvc_ir_block_t* block = fun->blocks + b;
+        for (uint32_t i = 0; i < block->n_insts; ++i) {
+            nvc_ir_value_t value = block->insts[i];
+            if (nvc_ir_is_pure(fun, fun->insts + value)) continue;
+            marks[value] = 1;
+            stack[n_stack++] = value;
+        }
+    }
+    while (n_stack) {
+        nvc_ir_inst_t* inst = fun->insts + stack[--n_stack];
+        nvc_ir_value_t* operands = nvc_ir_operands(inst);
+        for (uint32_t i = 0; i < inst->n_operands; ++i) {
+            if (marks[operands[i]]) continue;
+            marks[operands[i]] = 1;
+            stack[n_stack++] = operands[i];
+        }
+    }
+
+    // and sweep the rest
+    for (uint32_t b = 0; b < fun->n_blocks; ++b) {
+        nvc_ir_block_t* block = fun->blocks + b;
+        uint32_t kept = 0;
+        for (uint32_t i = 0; i < block->n_insts; ++i) {
+            nvc_ir_value_t value = block->insts[i];
+            if (marks[value]) {
+                block->insts[kept++] = value;
+            } else {
+                nvc_ir_remove_inst(fun, value);
+                changed = true;
+            }
+        }
+        block->n_insts = kept;
+    }
+
+    nvc_free(fun->allocator, stack);
+    nvc_free(fun->allocator, order);
+    nvc_free(fun->allocator, marks);
+    return changed ? NVC_PASS_CHANGED : NVC_PASS_UNCHANGED;
+}
+
+// value table of gvn, scoped along the dominator tree: entries are pushed
+// while walking down and popped when leaving a subtree so only values of
+// dominating blocks are ever found
+typedef struct {
+    uint64_t hash;
+    nvc_ir_value_t value;
+    uint32_t next;  // previous head of the bucket
+} nvc_gvn_entry_t;
+
+typedef struct {
+    nvc_ir_function_t* fun;
+    uint32_t* buckets;
+    uint32_t mask;
+    nvc_gvn_entry_t* entries;
+    uint32_t n_entries;
+} nvc_gvn_table_t;
+
+static uint64_t nvc_gvn_hash(nvc_ir_function_t* fun, nvc_ir_inst_t* inst) {
+    uint64_t hash = nvc_hash_combine(NVC_HASH_SEED, inst->op);
+    hash = nvc_hash_combine(hash, inst->type);
+    hash = nvc_hash_combine(hash, inst->length);
+    hash = nvc_hash_combine(hash, (uint64_t)(uintptr_t)inst->layout);
+    if (inst->op == NVC_IR_FIELD) hash = nvc_hash_combine(hash, inst->field);
+    if (inst->op == NVC_IR_PARAM) return nvc_hash_combine(hash, inst->param);
+    if (inst->op == NVC_IR_BIG) {
+        hash = nvc_hash_combine(hash, inst->big->negative);
+        return nvc_hash_bytes(inst->big->limbs,
+                              inst->big->n_limbs * sizeof(uint64_t), hash);
+    }
+    if (inst->op == NVC_IR_CONST && inst->length)
+        return nvc_hash_bytes(inst->ints,
+                              inst->length * nvc_ir_elem_size(inst->type),
+                              hash);
+    if (inst->op == NVC_IR_CONST) {
+        switch (inst->type) {
+            case NVC_IR_TYPE_BOOL: return nvc_hash_combine(hash, inst->b);
+            case NVC_IR_TYPE_INT:
+            case NVC_IR_TYPE_I32:
+            case NVC_IR_TYPE_I64:
+                return nvc_hash_combine(hash, (uint64_t)inst->i);
+            case NVC_IR_TYPE_FP:
+            case NVC_IR_TYPE_F32: {
+                uint64_t bits;
+                memcpy(&bits, &inst->fp, sizeof(bits));
+                return nvc_hash_combine(hash, bits);
+            }
+            case NVC_IR_TYPE_STR:
+                return nvc_hash_combine(
+                    hash, inst->str ? nvc_hash_str(inst->str) : 0);
+            default: return hash;
+        }
+    }
+    if (inst->op == NVC_IR_IMPORT) {
+        hash = nvc_hash_combine(hash, (uint64_t)(uintptr_t)inst->import.module);
+        return nvc_hash_combine(hash, inst->import.decl);
+    }
+    if (inst->n_operands > 2) {
+        for (uint32_t i = 0; i < inst->n_operands; ++i) {
+            hash = nvc_hash_combine(hash, nvc_ir_root(fun, inst->many[i]));
+        }
+        return hash;
+    }
+    nvc_ir_value_t lhs = nvc_ir_root(fun, inst->ops[0]);
+    nvc_ir_value_t rhs =
+        inst->n_operands > 1 ? nvc_ir_root(fun, inst->ops[1]) : NVC_IR_NONE;
+    if (nvc_is_commutative(inst->op) && rhs < lhs) {
+        nvc_ir_value_t tmp = lhs;
+        lhs = rhs;
+        rhs = tmp;
+    }
+    return nvc_hash_combine(nvc_hash_combine(hash, lhs), rhs);
+}
+
+static bool nvc_gvn_equal(nvc_ir_function_t* fun,
+                          nvc_ir_inst_t* a,
+                          nvc_ir_inst_t* b) {
+    if (a->op != b->op || a->type != b->type || a->length != b->length ||
+        a->layout != b->layout || a->n_operands != b->n_operands)
+        return false;
+    if (a->op == NVC_IR_FIELD && a->field != b->field) return false;
+    if (a->op == NVC_IR_PARAM) return a->param == b->param;
+    if (a->op == NVC_IR_BIG) return nvc_bigint_compare(a->big, b->big) == 0;
+    // note: the bytes of fp elements differ for -0.0 and 0.0 like their
+    // values, equal nan bytes are the same nan
+    if (a->op == NVC_IR_CONST && a->length)
+        return memcmp(a->ints, b->ints,
+                      a->length * nvc_ir_elem_size(a->type)) == 0;
+    if (a->op == NVC_IR_CONST) {
+        switch (a->type) {
+            case NVC_IR_TYPE_BOOL: return a->b == b->b;
+            case NVC_IR_TYPE_INT:
+            case NVC_IR_TYPE_I32:
+            case NVC_IR_TYPE_I64: return a->i == b->i;
+            // note: nan never equals itself so it is never merged, -0.0 and
+            // 0.0 compare equal but are different values
+            case NVC_IR_TYPE_FP:
+            case NVC_IR_TYPE_F32:
+                return a->fp == b->fp && signbit(a->fp) == signbit(b->fp);
+            case NVC_IR_TYPE_STR:
+                if (!a->str || !b->str) return a->str == b->str;
+                return strcmp(a->str, b->str) == 0;
+            default: return false;
+        }
+    }
+    if (a->op == NVC_IR_IMPORT)
+        return a->import.module == b->import.module &&
+               a->import.decl == b->import.decl;
+    if (a->n_operands > 2) {
+        for (uint32_t i = 0; i < a->n_operands; ++i) {
+            if (nvc_ir_root(fun, a->many[i]) != nvc_ir_root(fun, b->many[i]))
+                return false;
+        }
+        return true;
+    }
+    nvc_ir_value_t a0 = nvc_ir_root(fun, a->ops[0]);
+    nvc_ir_value_t b0 = nvc_ir_root(fun, b->ops[0]);
+    if (a->n_operands == 1) return a0 == b0;
+    nvc_ir_value_t a1 = nvc_ir_root(fun, a->ops[1]);
+    nvc_ir_value_t b1 = nvc_ir_root(fun, b->ops[1]);
+    if (a0 == b0 && a1 == b1) return true;
+    return nvc_is_commutative(a->op) && a0 == b1 && a1 == b0;
+}
+
+// returns the value inst was merged into, or NVC_IR_NONE when it is new
+static nvc_ir_value_t nvc_gvn_number(nvc_gvn_table_t* table,
+                                     nvc_ir_value_t value) {
+    nvc_ir_function_t* fun = table->fun;
+    nvc_ir_inst_t* inst = fun->insts + value;
+    uint64_t hash = nvc_gvn_hash(fun, inst);
+    uint32_t* bucket = table->buckets + (hash & table->mask);
+    for (uint32_t e = *bucket; e != NVC_IR_NONE; e = table->entries[e].next) {
+        nvc_gvn_entry_t* entry = table->entries + e;
+        if (entry->hash == hash &&
+            nvc_gvn_equal(fun, fun->insts + entry->value, inst))
+            return entry->value;
+    }
+    // note: every value is pushed at most once so entries never overflow
+    table->entries[table->n_entries] = (nvc_gvn_entry_t){
+        .hash = hash,
+        .value = value,
+        .next = *bucket,
+    };
+    *bucket = table->n_entries++;
+    return NVC_IR_NONE;
+}
+
+static void nvc_gvn_pop(nvc_gvn_table_t* table, uint32_t n_entries) {
+    // note: entries are popped in reverse so each is the head of its bucket
+    while (table->n_entries > n_entries) {
+        nvc_gvn_entry_t* entry = table->entries + --table->n_entries;
+        table->buckets[entry->hash & table->mask] = entry->next;
+    }
+}
+
+static bool nvc_gvn_block(nvc_gvn_table_t* table, uint32_t block) {
+    nvc_ir_function_t* fun = table->fun;
+    nvc_ir_block_t* b = fun->blocks + block;
+    bool changed = false;
+    for (uint32_t i = 0; i < b->n_insts; ++i) {
+        nvc_ir_value_t value = b->insts[i];
+        nvc_ir_inst_t* inst = fun->insts + value;
+        // note: copies are left to copy propagation, phis are only equal
+        // when their blocks are
+        if (inst->op == NVC_IR_COPY || inst->op == NVC_IR_PHI ||
+            !nvc_ir_is_pure(fun, inst))
+            continue;
+        nvc_ir_value_t same = nvc_gvn_number(table, value);
+        if (same == NVC_IR_NONE) continue;
+        nvc_ir_replace_with_copy(fun, value, same);
+        changed = true;
+    }
+    return changed;
+}
+
+// immediate dominators (Cooper, Harvey, Kennedy: "A Simple, Fast Dominance
+// Algorithm"), idom[b] is NVC_IR_NONE for unreachable blocks
+static void nvc_ir_dominators(nvc_ir_function_t* fun,
+                              const uint32_t* order,
+                              uint32_t n_order,
+                              uint32_t* rpo_index,
+                              uint32_t* idom) {
+    for (uint32_t b = 0; b < fun->n_blocks; ++b) {
+        rpo_index[b] = NVC_IR_NONE;
+        idom[b] = NVC_IR_NONE;
+    }
+    for (uint32_t i = 0; i < n_order; ++i) rpo_index[order[i]] = i;
+    idom[0] = 0;
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (uint32_t i = 1; i < n_order; ++i) {
+            nvc_ir_block_t* block = fun->blocks + order[i];
+            uint32_t new_idom = NVC_IR_NONE;
+            for (uint32_t p = 0; p < block->n_preds; ++p) {
+                uint32_t pred = block->preds[p];
+                if (idom[pred] == NVC_IR_NONE) continue;
+                if (new_idom == NVC_IR_NONE) {
+                    new_idom = pred;
+                    continue;
+                }
+                // intersect
+                uint32_t x = pred, y = new_idom;
+                while (x != y) {
+                    while (rpo_index[x] > rpo_index[y]) x = idom[x];
+                    while (rpo_index[y] > rpo_index[x]) y = idom[y];
+                }
+                new_idom = x;
+            }
+            if (idom[order[i]] != new_idom) {
+                idom[order[i]] = new_idom;
+                changed = true;
+            }
+        }
+    }
+}
+
+nvc_pass_result_t nvc_pass_gvn(nvc_ir_function_t* fun) {
+    nvc_allocator_t* allocator = fun->allocator;
+    nvc_pass_result_t result = NVC_PASS_OUT_OF_MEMORY;
+    uint32_t n_blocks = fun->n_blocks;
+    uint32_t n_buckets = 16;
+    while (n_buckets < fun->n_insts * 2) n_buckets <<= 1;
+
+    nvc_gvn_table_t table = {
+        .fun = fun,
+        .mask = n_buckets - 1,
+    };
+    // note: one allocation for the per block arrays: order, rpo_index,
+    // idom, first child, children and the walk stack
+    uint32_t* scratch = nvc_alloc(allocator, 6 * n_blocks * sizeof(uint32_t));
+    uint8_t* state = nvc_alloc(allocator, n_blocks);
+    table.buckets = nvc_alloc(allocator, n_buckets * sizeof(uint32_t));
+    table.entries =
+        nvc_alloc(allocator, (fun->n_insts + 1) * sizeof(nvc_gvn_entry_t));
+    if (!scratch || !state || !table.buckets || !table.entries) goto out;
+    memset(table.buckets, 0xff, n_buckets * sizeof(uint32_t));
+
+    uint32_t* order = scratch;
+    uint32_t* rpo_index = scratch + n_blocks;
+    uint32_t* idom = scratch + 2 * n_blocks;
+    uint32_t* first_child = scratch + 3 * n_blocks;
+    uint32_t* children = scratch + 4 * n_blocks;
+    uint32_t* stack = scratch + 5 * n_blocks;
+
+    uint32_t n_order = nvc_ir_reverse_post_order(fun, order, stack, state);
+    nvc_ir_dominators(fun, order, n_order, rpo_index, idom);
+
+    // dominator tree as children lists (counting sort by idom), children
+    // of b are children[first_child[b] .. first_child[b + 1])
+    memset(first_child, 0, n_blocks * sizeof(uint32_t));
+    for (uint32_t i = 1; i < n_order; ++i) ++first_child[idom[order[i]]];
+    uint32_t offset = 0;
+    for (uint32_t b = 0; b < n_blocks; ++b) {
+        uint32_t count = first_child[b];
+        first_child[b] = offset;
+        offset += count;
+    }
+    // note: first_child[b] is advanced while filling and restored after
+    for (uint32_t i = 1; i < n_order; ++i) {
+        children[first_child[idom[order[i]]]++] = order[i];
+    }
+    for (uint32_t b = n_blocks; b-- > 1;) first_child[b] = first_child[b - 1];
+    first_child[0] = 0;
+
+    // preorder walk of the dominator tree, stack holds the path from the
+    // entry. idom and rpo_index are not needed anymore and are reused as the
+    // next child to visit and the table size on arrival of each block
+    uint32_t* cursor = idom;
+    uint32_t* marks = rpo_index;
+    for (uint32_t b = 0; b < n_blocks; ++b) cursor[b] = first_child[b];
+    uint32_t n_stack = 0;
+    stack[n_stack++] = 0;
+    marks[0] = table.n_entries;
+    bool changed = nvc_gvn_block(&table, 0);
+    while (n_stack) {
+        uint32_t block = stack[n_stack - 1];
+        uint32_t end = block + 1 < n_blocks ? first_child[block + 1] : offset;
+        if (cursor[block] >= end) {
+            nvc_gvn_pop(&table, marks[block]);
+            --n_stack;
+            continue;
+        }
+        uint32_t child = children[cursor[block]++];
+        stack[n_stack++] = child;
+        marks[child] = table.n_entries;
+        changed |= nvc_gvn_block(&table, child);
+    }
+    result = changed ? NVC_PASS_CHANGED : NVC_PASS_UNCHANGED;
+out:
+    nvc_free(allocator, scratch);
+    nvc_free(allocator, state);
+    nvc_free(allocator, table.buckets);
+    nvc_free(allocator, table.entries);
+    return result;
+}
+
+// natural loops of a function for the loop passes. only loops of the shape
+// nvc_lower_ast gives them are handled: a header with a single back edge
+// from its latch and a single edge from outside, from a preheader that
+// jumps straight to it so code can be put there before the loop
+typedef struct {
+    nvc_ir_function_t* fun;
+    uint32_t* order;  // reverse post order of the reachable blocks
+    uint32_t n_order;
+    uint32_t* rpo_index;
+    uint32_t* idom;
+    uint32_t* stack;
+    uint32_t* blocks;  // of the loop found last, in reverse post order
+    uint32_t n_blocks;
+    uint8_t* state;    // scratch of nvc_ir_reverse_post_order
+    uint8_t* in_loop;  // per block, of the loop found last
+    uint32_t header, latch, preheader;
+} nvc_loops_t;
+
+static bool nvc_loops_init(nvc_loops_t* loops, nvc_ir_function_t* fun) {
+    uint32_t n_blocks = fun->n_blocks;
+    memset(loops, 0, sizeof(nvc_loops_t));
+    loops->fun = fun;
+    // note: one allocation for the per block arrays like gvn
+    uint32_t* scratch =
+        nvc_alloc(fun->allocator, 5 * n_blocks * sizeof(uint32_t));
+    uint8_t* bytes = nvc_alloc(fun->allocator, 2 * n_blocks);
+    if (!scratch || !bytes) {
+        nvc_free(fun->allocator, scratch);
+        nvc_free(fun->allocator, bytes);
+        return false;
+    }
+    loops->order = scratch;
+    loops->rpo_index = scratch + n_blocks;
+    loops->idom = scratch + 2 * n_blocks;
+    loops->stack = scratch + 3 * n_blocks;
+    loops->blocks = scratch + 4 * n_blocks;
+    loops->state = bytes;
+    loops->in_loop = bytes + n_blocks;
+    loops->n_order = nvc_ir_reverse_post_order(fun, loops->order,
+                                               loops->stack, loops->state);
+    nvc_ir_dominators(fun, loops->order, loops->n_order, loops->rpo_index,
+                      loops->idom);
+    return true;
+}
+
+static void nvc_loops_free(nvc_loops_t* loops) {
+    nvc_free(loops->fun->allocator, loops->order);
+    nvc_free(loops->fun->allocator, loops->state);
+}
+
+// true when every path from the entry to block b goes through block a
+static bool nvc_dominates(const nvc_loops_t* loops, uint32_t a, uint32_t b) {
+    if (loops->idom[b] == NVC_IR_NONE) return false;
+    while (b != a) {
+        if (b == 0) return false;
+        b = loops->idom[b];
+    }
+    return true;
+}
+
+// finds the loop of header, its blocks are marked in in_loop. returns false
+// when header does not start a loop of the handled shape
+static bool nvc_find_loop(nvc_loops_t* loops, uint32_t header) {
+    nvc_ir_function_t* fun = loops->fun;
+    nvc_ir_block_t* h = fun->blocks + header;
+    loops->latch = loops->preheader = NVC_IR_NONE;
+    if (header == 0 || loops->rpo_index[header] == NVC_IR_NONE) return false;
+    for (uint32_t p = 0; p < h->n_preds; ++p) {
+        uint32_t pred = h->preds[p];
+        uint32_t* slot = nvc_dominates(loops, header, pred) ? &loops->latch
+                                                           : &loops->preheader;
+        // note: unreachable predecessors are left to dce
+        if (*slot != NVC_IR_NONE || loops->rpo_index[pred] == NVC_IR_NONE)
+            return false;
+        *slot = pred;
+    }
+    if (loops->latch == NVC_IR_NONE || loops->preheader == NVC_IR_NONE)
+        return false;
+    nvc_ir_block_t* pre = fun->blocks + loops->preheader;
+    if (fun->insts[pre->insts[pre->n_insts - 1]].op != NVC_IR_BR)
+        return false;
+
+    // the loop is what reaches the latch without going through the header
+    memset(loops->in_loop, 0, fun->n_blocks);
+    loops->in_loop[header] = 1;
+    uint32_t n_stack = 0;
+    if (!loops->in_loop[loops->latch]) {
+        loops->in_loop[loops->latch] = 1;
+        loops->stack[n_stack++] = loops->latch;
+    }
+    while (n_stack) {
+        nvc_ir_block_t* block = fun->blocks + loops->stack[--n_stack];
+        for (uint32_t p = 0; p < block->n_preds; ++p) {
+            uint32_t pred = block->preds[p];
+            if (loops->in_loop[pred] ||
+                loops->rpo_index[pred] == NVC_IR_NONE)
+                continue;
+            loops->in_loop[pred] = 1;
+            loops->stack[n_stack++] = pred;
+        }
+    }
+    loops->n_blocks = 0;
+    for (uint32_t i = 0; i < loops->n_order; ++i) {
+        if (loops->in_loop[loops->order[i]])
+            loops->blocks[loops->n_blocks++] = loops->order[i];
+    }
+    loops->header = header;
+    return true;
+}
+
+// true when value is computed before the loop found last
+static bool nvc_is_invariant(const nvc_loops_t* loops, nvc_ir_value_t value) {
+    uint32_t block = loops->fun->insts[value].block;
+    return block != NVC_IR_NONE && !loops->in_loop[block];
+}
+
+// index of pred in the predecessors of block, the operand of its phis
+static uint32_t nvc_pred_index(nvc_ir_function_t* fun,
+                               uint32_t block,
+                               uint32_t pred) {
+    nvc_ir_block_t* b = fun->blocks + block;
+    uint32_t index = 0;
+    while (index < b->n_preds && b->preds[index] != pred) ++index;
+    return index;
+}
+
+nvc_pass_result_t nvc_pass_licm(nvc_ir_function_t* fun) {
+    nvc_loops_t loops;
+    if (!nvc_loops_init(&loops, fun)) return NVC_PASS_OUT_OF_MEMORY;
+    nvc_pass_result_t result = NVC_PASS_UNCHANGED;
+    // note: outer loops come first in reverse post order, what is hoisted
+    // out of an inner loop moves on out of the outer one in the next round
+    for (uint32_t i = 0; i < loops.n_order; ++i) {
+        if (!nvc_find_loop(&loops, loops.order[i])) continue;
+        nvc_ir_block_t* pre = fun->blocks + loops.preheader;
+        for (uint32_t j = 0; j < loops.n_blocks; ++j) {
+            nvc_ir_block_t* block = fun->blocks + loops.blocks[j];
+            uint32_t kept = 0;
+            for (uint32_t k = 0; k < block->n_insts; ++k) {
+                nvc_ir_value_t value = block->insts[k];
+                nvc_ir_inst_t* inst = fun->insts + value;
+                nvc_ir_value_t* operands = nvc_ir_operands(inst);
+                // note: the preheader runs even when the loop does not, so
+                // only what can not trap at all is hoisted
+                bool invariant = inst->op != NVC_IR_PHI &&
+                                 !nvc_ir_is_terminator(inst->op) &&
+                                 nvc_ir_is_speculatable(fun, inst);
+                for (uint32_t o = 0; o < inst->n_operands && invariant; ++o)
+                    invariant = nvc_is_invariant(&loops, operands[o]);
+                if (!invariant) {
+                    block->insts[kept++] = value;
+                    continue;
+                }
+                if (!nvc_ir_reserve(fun, pre, 1)) {
+                    // note: the instruction is still in the loop
+                    for (; k < block->n_insts; ++k)
+                        block->insts[kept++] = block->insts[k];
+                    block->n_insts = kept;
+                    result = NVC_PASS_OUT_OF_MEMORY;
+                    goto out;
+                }
+                pre->insts[pre->n_insts] = pre->insts[pre->n_insts - 1];
+                pre->insts[pre->n_insts - 1] = value;
+                ++pre->n_insts;
+                inst->block = loops.preheader;
+                result = NVC_PASS_CHANGED;
+            }
+            block->n_insts = kept;
+        }
+    }
+out:
+    nvc_loops_free(&loops);
+    return result;
+}
+
+// a basic induction variable: a header phi that the loop adds the same
+// invariant step to every iteration
+static bool nvc_induction_variable(nvc_loops_t* loops,
+                                   nvc_ir_value_t phi,
+                                   nvc_ir_value_t* step) {
+    nvc_ir_function_t* fun = loops->fun;
+    nvc_ir_inst_t* inst = fun->insts + phi;
+    if (inst->op != NVC_IR_PHI || inst->block != loops->header ||
+        inst->type != NVC_IR_TYPE_INT || inst->length ||
+        inst->n_operands != 2)
+        return false;
+    uint32_t latch = nvc_pred_index(fun, loops->header, loops->latch);
+    nvc_ir_inst_t* next = fun->insts + nvc_ir_root(fun, inst->ops[latch]);
+    if (next->op != NVC_IR_ADD || next->length) return false;
+    nvc_ir_value_t lhs = nvc_ir_root(fun, next->ops[0]);
+    nvc_ir_value_t rhs = nvc_ir_root(fun, next->ops[1]);
+    if (lhs != phi) {
+        nvc_ir_value_t tmp = lhs;
+        lhs = rhs;
+        rhs = tmp;
+    }
+    if (lhs != phi || !nvc_is_invariant(loops, rhs)) return false;
+    *step = rhs;
+    return true;
+}
+
+typedef struct {
+    nvc_ir_value_t mul, iv, step, factor;
+} nvc_reduction_t;
+
+nvc_pass_result_t nvc_pass_strength_reduction(nvc_ir_function_t* fun) {
+    nvc_loops_t loops;
+    if (!nvc_loops_init(&loops, fun)) return NVC_PASS_OUT_OF_MEMORY;
+    nvc_pass_result_t result = NVC_PASS_UNCHANGED;
+    nvc_reduction_t* reductions =
+        nvc_alloc(fun->allocator, fun->n_insts * sizeof(nvc_reduction_t));
+    if (!reductions) {
+        result = NVC_PASS_OUT_OF_MEMORY;
+        goto out;
+    }
+    for (uint32_t i = 0; i < loops.n_order; ++i) {
+        if (!nvc_find_loop(&loops, loops.order[i])) continue;
+
+        // iv * k with an invariant k, collected first since rewriting them
+        // adds instructions
+        uint32_t n_reductions = 0;
+        for (uint32_t j = 0; j < loops.n_blocks; ++j) {
+            nvc_ir_block_t* block = fun->blocks + loops.blocks[j];
+            for (uint32_t k = 0; k < block->n_insts; ++k) {
+                nvc_ir_value_t value = block->insts[k];
+                nvc_ir_inst_t* inst = fun->insts + value;
+                if (inst->op != NVC_IR_MUL || inst->type != NVC_IR_TYPE_INT ||
+                    inst->length)
+                    continue;
+                nvc_reduction_t r = {.mul = value};
+                for (uint32_t o = 0; o < 2; ++o) {
+                    r.iv = nvc_ir_root(fun, inst->ops[o]);
+                    r.factor = nvc_ir_root(fun, inst->ops[1 - o]);
+                    if (nvc_is_invariant(&loops, r.factor) &&
+                        nvc_induction_variable(&loops, r.iv, &r.step)) {
+                        reductions[n_reductions++] = r;
+                        break;
+                    }
+                }
+            }
+        }
+
+        // iv starts at init and grows by step so iv * k starts at init * k
+        // and grows by step * k
+        uint32_t pre = nvc_pred_index(fun, loops.header, loops.preheader);
+        uint32_t latch = nvc_pred_index(fun, loops.header, loops.latch);
+        for (uint32_t j = 0; j < n_reductions; ++j) {
+            nvc_reduction_t* r = reductions + j;
+            nvc_ir_value_t init = fun->insts[r->iv].ops[pre];
+            nvc_ir_value_t base =
+                nvc_ir_insert(fun, loops.preheader, NVC_IR_MUL,
+                              NVC_IR_TYPE_INT, init, r->factor);
+            if (base == NVC_IR_NONE) goto out_of_memory;
+            nvc_ir_value_t stride =
+                nvc_ir_insert(fun, loops.preheader, NVC_IR_MUL,
+                              NVC_IR_TYPE_INT, r->step, r->factor);
+            if (stride == NVC_IR_NONE) goto out_of_memory;
+            nvc_ir_value_t phi =
+                nvc_ir_append(fun, loops.header, NVC_IR_PHI, NVC_IR_TYPE_INT,
+                              NVC_IR_NONE, NVC_IR_NONE);
+            if (phi == NVC_IR_NONE) goto out_of_memory;
+            // note: phis go first
+            nvc_ir_block_t* header = fun->blocks + loops.header;
+            memmove(header->insts + 1, header->insts,
+                    (header->n_insts - 1) * sizeof(nvc_ir_value_t));
+            header->insts[0] = phi;
+            nvc_ir_value_t next =
+                nvc_ir_insert(fun, loops.latch, NVC_IR_ADD, NVC_IR_TYPE_INT,
+                              phi, stride);
+            if (next == NVC_IR_NONE) goto out_of_memory;
+            nvc_ir_inst_t* inst = fun->insts + phi;
+            inst->ops[pre] = base;
+            inst->ops[latch] = next;
+            inst->n_operands = 2;
+            nvc_ir_replace_with_copy(fun, r->mul, phi);
+            result = NVC_PASS_CHANGED;
+        }
+    }
+    goto out;
+out_of_memory:
+    result = NVC_PASS_OUT_OF_MEMORY;
+out:
+    nvc_free(fun->allocator, reductions);
+    nvc_loops_free(&loops);
+    return result;
+}
+
+// whether the loop found last keeps going for an induction variable value
+// of its header condition, NULL when it has no such condition
+static nvc_ir_inst_t* nvc_unroll_condition(nvc_loops_t* loops,
+                                           nvc_ir_value_t* iv,
+                                           nvc_int* bound,
+                                           bool* iv_on_left) {
+    nvc_ir_function_t* fun = loops->fun;
+    nvc_ir_block_t* header = fun->blocks + loops->header;
+    nvc_ir_inst_t* br = fun->insts + header->insts[header->n_insts - 1];
+    nvc_ir_inst_t* cond = fun->insts + nvc_ir_root(fun, br->ops[0]);
+    if (cond->op < NVC_IR_LT || cond->op > NVC_IR_GE || cond->length)
+        return NULL;
+    for (uint32_t o = 0; o < 2; ++o) {
+        *iv = nvc_ir_root(fun, cond->ops[o]);
+        nvc_ir_inst_t* c = nvc_ir_const_of(fun, cond->ops[1 - o]);
+        if (!c || c->type != NVC_IR_TYPE_INT || c->length) continue;
+        *bound = c->i;
+        *iv_on_left = o == 0;
+        return cond;
+    }
+    return NULL;
+}
+
+static bool nvc_compare(nvc_ir_op_t op, nvc_int lhs, nvc_int rhs) {
+    switch (op) {
+        case NVC_IR_LT: return lhs < rhs;
+        case NVC_IR_LE: return lhs <= rhs;
+        case NVC_IR_GT: return lhs > rhs;
+        default: return lhs >= rhs;
+    }
+}
+
+// iterations of the loop found last when it is small enough to unroll
+// completely, NVC_IR_NONE otherwise
+static uint32_t nvc_unroll_trips(nvc_loops_t* loops) {
+    nvc_ir_function_t* fun = loops->fun;
+    if (loops->n_blocks != 2 || loops->latch == loops->header)
+        return NVC_IR_NONE;
+    nvc_ir_block_t* header = fun->blocks + loops->header;
+    nvc_ir_block_t* latch = fun->blocks + loops->latch;
+    nvc_ir_inst_t* br = fun->insts + header->insts[header->n_insts - 1];
+    if (br->op != NVC_IR_COND_BR) return NVC_IR_NONE;
+
+    uint32_t n_insts = header->n_insts + latch->n_insts;
+    for (uint32_t b = 0; b < 2; ++b) {
+        nvc_ir_block_t* block = b ? latch : header;
+        for (uint32_t i = 0; i < block->n_insts; ++i) {
+            nvc_ir_op_t op = fun->insts[block->insts[i]].op;
+            if (op == NVC_IR_EXPORT || (b && op == NVC_IR_PHI))
+                return NVC_IR_NONE;
+        }
+    }
+
+    nvc_ir_value_t iv, step;
+    nvc_int bound;
+    bool iv_on_left;
+    nvc_ir_inst_t* cond = nvc_unroll_condition(loops, &iv, &bound, &iv_on_left);
+    if (!cond || !nvc_induction_variable(loops, iv, &step)) return NVC_IR_NONE;
+    uint32_t pre = nvc_pred_index(fun, loops->header, loops->preheader);
+    nvc_ir_inst_t* init = nvc_ir_const_of(fun, fun->insts[iv].ops[pre]);
+    nvc_ir_inst_t* delta = nvc_ir_const_of(fun, step);
+    if (!init || !delta) return NVC_IR_NONE;
+
+    // note: simulated rather than computed, a counter that stops being
+    // small is not unrolled
+    bool keep_going = br->targets[0] == loops->latch;
+    nvc_int value = init->i;
+    uint32_t trips = 0;
+    for (;;) {
+        bool taken = iv_on_left ? nvc_compare(cond->op, value, bound)
+                                : nvc_compare(cond->op, bound, value);
+        if (taken != keep_going) break;
+        if (++trips > NVC_UNROLL_MAX_TRIPS) return NVC_IR_NONE;
+        if (!nvc_small_add(value, delta->i, &value)) return NVC_IR_NONE;
+    }
+    if ((uint64_t)trips * n_insts > NVC_UNROLL_MAX_INSTS) return NVC_IR_NONE;
+    return trips;
+}
+
+// copies value in front of the terminator of the preheader with its
+// operands renamed through map
+static nvc_ir_value_t nvc_unroll_clone(nvc_loops_t* loops,
+                                       nvc_ir_value_t* map,
+                                       nvc_ir_value_t value) {
+    nvc_ir_function_t* fun = loops->fun;
+    nvc_ir_value_t clone = nvc_ir_insert(fun, loops->preheader, NVC_IR_NOP,
+                                         NVC_IR_TYPE_VOID, NVC_IR_NONE,
+                                         NVC_IR_NONE);
+    if (clone == NVC_IR_NONE) return NVC_IR_NONE;
+    nvc_ir_inst_t* inst = fun->insts + clone;
+    *inst = fun->insts[value];
+    inst->block = loops->preheader;
+    if (inst->n_operands > 2) {
+        // dynamic allocation
+        nvc_ir_value_t* many = nvc_alloc(
+            fun->allocator, inst->n_operands * sizeof(nvc_ir_value_t));
+        if (!many) {
+            inst->op = NVC_IR_NOP;
+            inst->n_operands = 0;
+            return NVC_IR_NONE;
+        }
+        memcpy(many, inst->many, inst->n_operands * sizeof(nvc_ir_value_t));
+        inst->many = many;
+    }
+    nvc_ir_value_t* operands = nvc_ir_operands(inst);
+    for (uint32_t i = 0; i < inst->n_operands; ++i) {
+        if (map[operands[i]] != NVC_IR_NONE) operands[i] = map[operands[i]];
+    }
+    return clone;
+}
+
+nvc_pass_result_t nvc_pass_unroll(nvc_ir_function_t* fun) {
+    nvc_loops_t loops;
+    if (!nvc_loops_init(&loops, fun)) return NVC_PASS_OUT_OF_MEMORY;
+    nvc_pass_result_t result = NVC_PASS_UNCHANGED;
+    // note: map renames the values of the loop to their copy in the
+    // iteration being unrolled, NVC_IR_NONE keeps a value as is. next holds
+    // the values the header phis get for the following iteration
+    uint32_t n_values = fun->n_insts;
+    nvc_ir_value_t* map =
+        nvc_alloc(fun->allocator, 2 * n_values * sizeof(nvc_ir_value_t));
+    if (!map) {
+        result = NVC_PASS_OUT_OF_MEMORY;
+        goto out;
+    }
+    nvc_ir_value_t* next = map + n_values;
+    // note: unrolling only removes the latch of the loop, which no other
+    // loop goes through
+    for (uint32_t i = 0; i < loops.n_order; ++i) {
+        if (!nvc_find_loop(&loops, loops.order[i])) continue;
+        uint32_t trips = nvc_unroll_trips(&loops);
+        if (trips == NVC_IR_NONE) continue;
+        memset(map, 0xff, n_values * sizeof(nvc_ir_value_t));
+        uint32_t pre = nvc_pred_index(fun, loops.header, loops.preheader);
+        uint32_t latch = nvc_pred_index(fun, loops.header, loops.latch);
+        nvc_ir_block_t* header = fun->blocks + loops.header;
+        uint32_t n_phis = 0;
+        while (fun->insts[header->insts[n_phis]].op == NVC_IR_PHI) {
+            nvc_ir_value_t phi = header->insts[n_phis++];
+            map[phi] = fun->insts[phi].ops[pre];
+        }
+
+        // every iteration runs the header and then the latch
+        for (uint32_t t = 0; t < trips; ++t) {
+            for (uint32_t b = 0; b < 2; ++b) {
+                nvc_ir_block_t* block =
+                    fun->blocks + (b ? loops.latch : loops.header);
+                for (uint32_t k = 0; k + 1 < block->n_insts; ++k) {
+                    nvc_ir_value_t value = block->insts[k];
+                    if (fun->insts[value].op == NVC_IR_PHI) continue;
+                    nvc_ir_value_t clone =
+                        nvc_unroll_clone(&loops, map, value);
+                    if (clone == NVC_IR_NONE) {
+                        result = NVC_PASS_OUT_OF_MEMORY;
+                        goto out;
+                    }
+                    map[value] = clone;
+                    // note: cloning may grow the blocks
+                    block = fun->blocks + (b ? loops.latch : loops.header);
+                }
+            }
+            header = fun->blocks + loops.header;
+            for (uint32_t k = 0; k < n_phis; ++k) {
+                nvc_ir_value_t value = fun->insts[header->insts[k]].ops[latch];
+                next[k] = map[value] != NVC_IR_NONE ? map[value] : value;
+            }
+            for (uint32_t k = 0; k < n_phis; ++k)
+                map[header->insts[k]] = next[k];
+        }
+
+        // the header runs once more with the final values and leaves, the
+        // latch is gone
+        nvc_ir_remove_pred(fun, loops.header, loops.latch);
+        header = fun->blocks + loops.header;
+        for (uint32_t k = 0; k < n_phis; ++k) {
+            nvc_ir_value_t phi = header->insts[k];
+            nvc_ir_replace_with_copy(fun, phi, map[phi]);
+        }
+        nvc_ir_inst_t* br = fun->insts + header->insts[header->n_insts - 1];
+        uint32_t exit =
+            br->targets[0] == loops.latch ? br->targets[1] : br->targets[0];
+        br->op = NVC_IR_BR;
+        br->n_operands = 0;
+        br->ops[0] = NVC_IR_NONE;
+        br->targets[0] = exit;
+        br->targets[1] = 0;
+        nvc_ir_remove_pred(fun, loops.latch, loops.header);
+        nvc_ir_block_t* block = fun->blocks + loops.latch;
+        for (uint32_t k = 0; k < block->n_insts; ++k)
+            nvc_ir_remove_inst(fun, block->insts[k]);
+        block->n_insts = 0;
+        block->removed = true;
+        result = NVC_PASS_CHANGED;
+    }
+out:
+    nvc_free(fun->allocator, map);
+    nvc_loops_free(&loops);
+    return result;
+}
+
+// instructions the body of fun adds to a caller it is inlined into: its
+// params become the arguments, copies are propagated away and its returns
+// become jumps. NVC_IR_NONE when it never returns
+static uint32_t nvc_inline_size(nvc_ir_function_t* fun) {
+    uint32_t size = 0;
+    bool returns = false;
+    for (uint32_t b = 0; b < fun->n_blocks; ++b) {
+        nvc_ir_block_t* block = fun->blocks + b;
+        if (block->removed) continue;
+        for (uint32_t i = 0; i < block->n_insts; ++i) {
+            nvc_ir_op_t op = fun->insts[block->insts[i]].op;
+            if (op == NVC_IR_RET) returns = true;
+            if (op != NVC_IR_PARAM && op != NVC_IR_COPY) ++size;
+        }
+    }
+    return returns ? size : NVC_IR_NONE;
+}
+
+// true when function f reaches function target through its calls, seen
+// marks the functions visited already
+static bool nvc_inline_reaches(nvc_ir_module_t* module,
+                               uint32_t f,
+                               uint32_t target,
+                               uint8_t* seen) {
+    nvc_ir_function_t* fun = module->functions[f];
+    for (nvc_ir_value_t v = 0; v < fun->n_insts; ++v) {
+        nvc_ir_inst_t* inst = fun->insts + v;
+        if (inst->op != NVC_IR_CALL) continue;
+        if (inst->callee == target) return true;
+        if (seen[inst->callee]) continue;
+        seen[inst->callee] = 1;
+        if (nvc_inline_reaches(module, inst->callee, target, seen))
+            return true;
+    }
+    return false;
+}
+
+// appends f to order after every function it calls (unless seen already)
+static void nvc_inline_order(nvc_ir_module_t* module,
+                             uint32_t f,
+                             uint8_t* seen,
+                             uint32_t* order,
+                             uint32_t* n_order) {
+    seen[f] = 1;
+    nvc_ir_function_t* fun = module->functions[f];
+    for (nvc_ir_value_t v = 0; v < fun->n_insts; ++v) {
+        nvc_ir_inst_t* inst = fun->insts + v;
+        if (inst->op == NVC_IR_CALL && !seen[inst->callee])
+            nvc_inline_order(module, inst->callee, seen, order, n_order);
+    }
+    order[(*n_order)++] = f;
+}
+
+// the cost model: inlining saves the call itself and costs the size of the
+// body, every constant argument is likely to fold some of it away
+static bool nvc_inline_worth(nvc_ir_module_t* module,
+                             nvc_ir_function_t* fun,
+                             nvc_ir_inst_t* call,
+                             const uint8_t* recursive) {
+    if (recursive[call->callee]) return false;
+    nvc_ir_function_t* callee = module->functions[call->callee];
+    // note: the entry of the callee becomes the target of a jump, it can
+    // not have predecessors of its own
+    if (!callee->n_blocks || callee->blocks[0].n_preds) return false;
+    uint32_t size = nvc_inline_size(callee);
+    if (size == NVC_IR_NONE || fun->n_insts + size > NVC_INLINE_MAX_INSTS)
+        return false;
+    nvc_ir_value_t* operands = nvc_ir_operands(call);
+    uint32_t n_consts = 0;
+    for (uint32_t i = 0; i < call->n_operands; ++i) {
+        if (nvc_ir_const_of(fun, operands[i])) ++n_consts;
+    }
+    uint32_t saved = NVC_INLINE_CALL_COST + call->n_operands;
+    return size <= saved + NVC_INLINE_THRESHOLD +
+                       n_consts * NVC_INLINE_CONST_ARG_BONUS;
+}
+
+// replaces call with a copy of the blocks of its callee: the block of the
+// call jumps to the copy of the entry, the instructions after the call move
+// to a new block the returns jump to and the call becomes a copy of the
+// returned value (a phi of them when there are several)
+// note: constant arrays keep pointing to the elements of the callee, which
+// lives as long as the module
+static bool nvc_inline_call(nvc_ir_module_t* module,
+                            nvc_ir_function_t* fun,
+                            nvc_ir_value_t call) {
+    nvc_allocator_t* allocator = fun->allocator;
+    nvc_ir_inst_t* inst = fun->insts + call;
+    nvc_ir_function_t* callee = module->functions[inst->callee];
+    uint32_t block = inst->block;
+    nvc_buffer_location_t loc = inst->buf_loc;
+    bool ok = false;
+    nvc_ir_value_t* args =
+        nvc_alloc(allocator, (inst->n_operands + 1) * sizeof(nvc_ir_value_t));
+    uint32_t* blocks =
+        nvc_alloc(allocator, callee->n_blocks * sizeof(uint32_t));
+    nvc_ir_value_t* map =
+        nvc_alloc(allocator, callee->n_insts * sizeof(nvc_ir_value_t));
+    nvc_ir_value_t* rets =
+        nvc_alloc(allocator, callee->n_blocks * sizeof(nvc_ir_value_t));
+    if (!args || !blocks || !map || !rets) goto out;
+    memcpy(args, nvc_ir_operands(inst),
+           inst->n_operands * sizeof(nvc_ir_value_t));
+
+    uint32_t cont = nvc_ir_add_block(fun);
+    if (cont == NVC_IR_NONE) goto out;
+    for (uint32_t b = 0; b < callee->n_blocks; ++b) {
+        blocks[b] = NVC_IR_NONE;
+        if (callee->blocks[b].removed) continue;
+        blocks[b] = nvc_ir_add_block(fun);
+        if (blocks[b] == NVC_IR_NONE) goto out;
+    }
+
+    // the instructions after the call go on in cont, which the successors
+    // see as their predecessor instead of block
+    nvc_ir_block_t* b = fun->blocks + block;
+    nvc_ir_block_t* next = fun->blocks + cont;
+    uint32_t pos = 0;
+    while (b->insts[pos] != call) ++pos;
+    if (!nvc_ir_reserve(fun, next, b->n_insts - pos)) goto out;
+    for (uint32_t k = pos + 1; k < b->n_insts; ++k) {
+        next->insts[next->n_insts++] = b->insts[k];
+        fun->insts[b->insts[k]].block = cont;
+    }
+    b->n_insts = pos;
+    uint32_t succs[2];
+    uint32_t n_succs = nvc_ir_successors(fun, cont, succs);
+    for (uint32_t i = 0; i < n_succs; ++i) {
+        nvc_ir_block_t* succ = fun->blocks + succs[i];
+        for (uint32_t p = 0; p < succ->n_preds; ++p) {
+            if (succ->preds[p] == block) succ->preds[p] = cont;
+        }
+    }
+
+    // copy the blocks, operands are renamed once every value has its copy
+    uint32_t n_rets = 0;
+    for (uint32_t cb = 0; cb < callee->n_blocks; ++cb) {
+        if (blocks[cb] == NVC_IR_NONE) continue;
+        nvc_ir_block_t* from = callee->blocks + cb;
+        for (uint32_t k = 0; k < from->n_insts; ++k) {
+            nvc_ir_value_t value = from->insts[k];
+            nvc_ir_inst_t* original = callee->insts + value;
+            if (original->op == NVC_IR_PARAM) {
+                map[value] = args[original->param];
+                continue;
+            }
+            bool ret = original->op == NVC_IR_RET;
+            if (ret) rets[n_rets++] = original->ops[0];
+            nvc_ir_value_t clone = nvc_ir_append(
+                fun, blocks[cb], ret ? NVC_IR_BR : NVC_IR_NOP,
+                NVC_IR_TYPE_VOID, NVC_IR_NONE, NVC_IR_NONE);
+            if (clone == NVC_IR_NONE) goto out;
+            nvc_ir_inst_t* copy = fun->insts + clone;
+            if (ret) {
+                copy->targets[0] = cont;
+                copy->buf_loc = original->buf_loc;
+                if (!nvc_ir_add_edge(fun, blocks[cb], cont)) goto out;
+                continue;
+            }
+            *copy = *original;
+            copy->block = blocks[cb];
+            if (copy->n_operands > 2) {
+                // dynamic allocation
+                copy->many = nvc_alloc(
+                    allocator, copy->n_operands * sizeof(nvc_ir_value_t));
+                if (!copy->many) {
+                    copy->op = NVC_IR_NOP;
+                    copy->n_operands = 0;
+                    goto out;
+                }
+                memcpy(copy->many, original->many,
+                       copy->n_operands * sizeof(nvc_ir_value_t));
+            }
+            if (copy->op == NVC_IR_BR || copy->op == NVC_IR_COND_BR) {
+                copy->targets[0] = blocks[copy->targets[0]];
+                if (copy->op == NVC_IR_COND_BR)
+                    copy->targets[1] = blocks[copy->targets[1]];
+            }
+            map[value] = clone;
+        }
+        for (uint32_t p = 0; p < from->n_preds; ++p) {
+            if (!nvc_ir_add_edge(fun, blocks[from->preds[p]], blocks[cb]))
+                goto out;
+        }
+    }
+    for (uint32_t cb = 0; cb < callee->n_blocks; ++cb) {
+        if (blocks[cb] == NVC_IR_NONE) continue;
+        nvc_ir_block_t* to = fun->blocks + blocks[cb];
+        for (uint32_t k = 0; k < to->n_insts; ++k) {
+            nvc_ir_inst_t* copy = fun->insts + to->insts[k];
+            nvc_ir_value_t* operands = nvc_ir_operands(copy);
+            for (uint32_t i = 0; i < copy->n_operands; ++i)
+                operands[i] = map[operands[i]];
+        }
+    }
+
+    nvc_ir_value_t br = nvc_ir_append(fun, block, NVC_IR_BR, NVC_IR_TYPE_VOID,
+                                      NVC_IR_NONE, NVC_IR_NONE);
+    if (br == NVC_IR_NONE) goto out;
+    fun->insts[br].targets[0] = blocks[0];
+    fun->insts[br].buf_loc = loc;
+    if (!nvc_ir_add_edge(fun, block, blocks[0])) goto out;
+
+    // the call becomes a copy of the result at the start of cont, after the
+    // phi of the results
+    nvc_ir_value_t result = map[rets[0]];
+    if (n_rets > 1) {
+        inst = fun->insts + call;
+        result = nvc_ir_append(fun, cont, NVC_IR_PHI, inst->type, NVC_IR_NONE,
+                               NVC_IR_NONE);
+        if (result == NVC_IR_NONE) goto out;
+        inst = fun->insts + call;
+        nvc_ir_inst_t* phi = fun->insts + result;
+        phi->length = inst->length;
+        phi->layout = inst->layout;
+        phi->buf_loc = loc;
+        if (n_rets > 2) {
+            // dynamic allocation
+            phi->many = nvc_alloc(allocator, n_rets * sizeof(nvc_ir_value_t));
+            if (!phi->many) goto out;
+        }
+        phi->n_operands = n_rets;
+        nvc_ir_value_t* operands = nvc_ir_operands(phi);
+        for (uint32_t k = 0; k < n_rets; ++k) operands[k] = map[rets[k]];
+        next = fun->blocks + cont;
+        memmove(next->insts + 1, next->insts,
+                (next->n_insts - 1) * sizeof(nvc_ir_value_t));
+        next->insts[0] = result;
+    }
+    next = fun->blocks + cont;
+    if (!nvc_ir_reserve(fun, next, 1)) goto out;
+    uint32_t at = n_rets > 1;
+    memmove(next->insts + at + 1, next->insts + at,
+            (next->n_insts - at) * sizeof(nvc_ir_value_t));
+    next->insts[at] = call;
+    ++next->n_insts;
+    nvc_ir_replace_with_copy(fun, call, result);
+    fun->insts[call].block = cont;
+    ok = true;
+out:
+    nvc_free(allocator, args);
+    nvc_free(allocator, blocks);
+    nvc_free(allocator, map);
+    nvc_free(allocator, rets);
+    return ok;
+}
+
+nvc_pass_result_t nvc_pass_inline(nvc_ir_module_t* module) {
+    nvc_allocator_t* allocator = module->allocator;
+    uint32_t n = module->n_functions;
+    nvc_pass_result_t result = NVC_PASS_OUT_OF_MEMORY;
+    uint8_t* seen = nvc_alloc(allocator, 2 * n);
+    uint32_t* order = nvc_alloc(allocator, n * sizeof(uint32_t));
+    if (!seen || !order) goto out;
+    uint8_t* recursive = seen + n;
+    for (uint32_t f = 0; f < n; ++f) {
+        memset(seen, 0, n);
+        recursive[f] = nvc_inline_reaches(module, f, f, seen);
+    }
+    // note: callees come first so what they call is inlined into them before
+    // they are inlined themselves
+    memset(seen, 0, n);
+    uint32_t n_order = 0;
+    for (uint32_t f = 0; f < n; ++f) {
+        if (!seen[f]) nvc_inline_order(module, f, seen, order, &n_order);
+    }
+
+    result = NVC_PASS_UNCHANGED;
+    for (uint32_t i = 0; i < n_order; ++i) {
+        nvc_ir_function_t* fun = module->functions[order[i]];
+        // note: the copied bodies are visited too, their calls were not
+        // worth it in the callee but may be here. only calls of callees
+        // further down the call graph are copied so this ends
+        for (nvc_ir_value_t v = 0; v < fun->n_insts; ++v) {
+            nvc_ir_inst_t* inst = fun->insts + v;
+            if (inst->op != NVC_IR_CALL ||
+                !nvc_inline_worth(module, fun, inst, recursive))
+                continue;
+            if (!nvc_inline_call(module, fun, v)) {
+                result = NVC_PASS_OUT_OF_MEMORY;
+                goto out;
+            }
+            result = NVC_PASS_CHANGED;
+        }
+    }
+out:
+    nvc_free(allocator, seen);
+    nvc_free(allocator, order);
+    return result;
+}
+
+#ifdef __cplusplus
+}
+#endif
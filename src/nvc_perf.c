@@ -0,0 +1,331 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nvc_perf.h>
+
+#include <nvc_alloc.h>
+
+#include <errno.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+// note: only the user space part of the counts, measuring the kernel needs
+// perf_event_paranoid <= 1 and the compiler rarely is in the kernel anyway
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} nvc_perf_events[NVC_PERF_N_COUNTERS] = {
+    [NVC_PERF_CYCLES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    [NVC_PERF_INSTRUCTIONS] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    [NVC_PERF_BRANCH_MISSES] = {PERF_TYPE_HARDWARE,
+                                PERF_COUNT_HW_BRANCH_MISSES},
+    [NVC_PERF_L1D_MISSES] = {PERF_TYPE_HW_CACHE,
+                             PERF_COUNT_HW_CACHE_L1D |
+                                 PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                                 PERF_COUNT_HW_CACHE_RESULT_MISS << 16},
+    [NVC_PERF_LLC_MISSES] = {PERF_TYPE_HW_CACHE,
+                             PERF_COUNT_HW_CACHE_LL |
+                                 PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                                 PERF_COUNT_HW_CACHE_RESULT_MISS << 16},
+    [NVC_PERF_PAGE_FAULTS] = {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+};
+#endif
+
+// the counters of one thread, -1 for the ones that could not be opened
+typedef struct {
+    int fds[NVC_PERF_N_COUNTERS];
+    int error;
+} nvc_perf_thread_t;
+
+static pthread_key_t nvc_perf_key;
+static pthread_once_t nvc_perf_once = PTHREAD_ONCE_INIT;
+static bool nvc_perf_key_created;
+
+static void nvc_perf_thread_free(void* arg) {
+    nvc_perf_thread_t* thread = arg;
+#ifdef __linux__
+    for (int i = 0; i < NVC_PERF_N_COUNTERS; ++i)
+        if (thread->fds[i] >= 0) close(thread->fds[i]);
+#endif
+    nvc_free(NULL, thread);
+}
+
+static void nvc_perf_key_init(void) {
+    // note: the destructor closes the counters of exiting threads, the ones
+    // of the main thread stay open until the process exits
+    nvc_perf_key_created =
+        pthread_key_create(&nvc_perf_key, nvc_perf_thread_free) == 0;
+}
+
+static nvc_perf_thread_t* nvc_perf_thread(void) {
+    pthread_once(&nvc_perf_once, nvc_perf_key_init);
+    if (!nvc_perf_key_created) return NULL;
+    nvc_perf_thread_t* thread = pthread_getspecific(nvc_perf_key);
+    if (thread) return thread;
+
+    thread = nvc_alloc(NULL, sizeof(nvc_perf_thread_t));
+    if (!thread) return NULL;
+    thread->error = 0;
+    for (int i = 0; i < NVC_PERF_N_COUNTERS; ++i) {
+        thread->fds[i] = -1;
+#ifdef __linux__
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = nvc_perf_events[i].type;
+        attr.config = nvc_perf_events[i].config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        // note: more events than the pmu has registers are multiplexed, the
+        // enabled and running times scale the counts back up
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                           PERF_FORMAT_TOTAL_TIME_RUNNING;
+        // pid 0 and cpu -1 count this thread on any cpu
+        thread->fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1,
+                                      PERF_FLAG_FD_CLOEXEC);
+        if (thread->fds[i] < 0 && !thread->error) thread->error = errno;
+#else
+        thread->error = ENOSYS;
+#endif
+    }
+    if (pthread_setspecific(nvc_perf_key, thread) != 0) {
+        nvc_perf_thread_free(thread);
+        return NULL;
+    }
+    return thread;
+}
+
+// value, enabled and running time of a counter
+static bool nvc_perf_read(int fd, uint64_t data[3]) {
+#ifdef __linux__
+    return fd >= 0 && read(fd, data, 3 * sizeof(uint64_t)) ==
+                          (ssize_t)(3 * sizeof(uint64_t));
+#else
+    (void)fd;
+    (void)data;
+    return false;
+#endif
+}
+
+static uint64_t nvc_perf_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void nvc_perf_profile_init(nvc_perf_profile_t* profile) {
+    memset(profile, 0, sizeof(nvc_perf_profile_t));
+    pthread_mutex_init(&profile->lock, NULL);
+}
+
+void nvc_perf_profile_free(nvc_perf_profile_t* profile) {
+    pthread_mutex_destroy(&profile->lock);
+}
+
+void nvc_perf_begin(nvc_perf_span_t* span,
+                    nvc_perf_profile_t* profile,
+                    nvc_phase_t phase) {
+    span->profile = profile;
+    if (!profile) return;
+    span->phase = phase;
+    span->missing = 0;
+    nvc_perf_thread_t* thread = nvc_perf_thread();
+    if (thread && thread->error) {
+        pthread_mutex_lock(&profile->lock);
+        if (!profile->error) profile->error = thread->error;
+        pthread_mutex_unlock(&profile->lock);
+    }
+    for (int i = 0; i < NVC_PERF_N_COUNTERS; ++i) {
+        uint64_t data[3];
+        if (!thread || !nvc_perf_read(thread->fds[i], data)) {
+            span->missing |= 1u << i;
+            continue;
+        }
+        span->start[i] = data[0];
+        span->start_enabled[i] = data[1];
+        span->start_running[i] = data[2];
+    }
+    // note: last so reading the counters is not part of the wall clock time
+    span->start_ns = nvc_perf_now_ns();
+}
+
+void nvc_perf_end(nvc_perf_span_t* span) {
+    nvc_perf_profile_t* profile = span->profile;
+    if (!profile) return;
+    uint64_t ns = nvc_perf_now_ns() - span->start_ns;
+    uint64_t counts[NVC_PERF_N_COUNTERS] = {0};
+    uint32_t missing = span->missing;
+    nvc_perf_thread_t* thread = nvc_perf_thread();
+    for (int i = 0; i < NVC_PERF_N_COUNTERS; ++i) {
+        uint64_t data[3];
+        if (missing & (1u << i)) continue;
+        if (!thread || !nvc_perf_read(thread->fds[i], data)) {
+            missing |= 1u << i;
+            continue;
+        }
+        uint64_t count = data[0] - span->start[i];
+        uint64_t enabled = data[1] - span->start_enabled[i];
+        uint64_t running = data[2] - span->start_running[i];
+        // never on the pmu while the span ran, nothing is known
+        if (enabled && !running) {
+            missing |= 1u << i;
+            continue;
+        }
+        if (running && running < enabled)
+            count = (uint64_t)((double)count * enabled / running);
+        counts[i] = count;
+    }
+
+    pthread_mutex_lock(&profile->lock);
+    nvc_perf_phase_t* phase = profile->phases + span->phase;
+    phase->ns += ns;
+    for (int i = 0; i < NVC_PERF_N_COUNTERS; ++i) phase->counts[i] += counts[i];
+    phase->missing |= missing;
+    ++phase->n_spans;
+    pthread_mutex_unlock(&profile->lock);
+}
+
+void nvc_perf_add_bytes(nvc_perf_profile_t* profile, uint64_t n) {
+    if (!profile) return;
+    pthread_mutex_lock(&profile->lock);
+    profile->n_bytes += n;
+    pthread_mutex_unlock(&profile->lock);
+}
+
+void nvc_perf_add_tokens(nvc_perf_profile_t* profile, uint64_t n) {
+    if (!profile) return;
+    pthread_mutex_lock(&profile->lock);
+    profile->n_tokens += n;
+    pthread_mutex_unlock(&profile->lock);
+}
+
+const char* nvc_phase_to_str(nvc_phase_t phase) {
+    switch (phase) {
+        case NVC_PHASE_READ: return "read";
+        case NVC_PHASE_LEX: return "lex";
+        case NVC_PHASE_PARSE: return "parse";
+        case NVC_PHASE_RESOLVE: return "resolve";
+        case NVC_PHASE_LOWER: return "lower";
+        case NVC_PHASE_OPTIMIZE: return "optimize";
+        case NVC_PHASE_N: break;
+    }
+    return "unknown";
+}
+
+const char* nvc_perf_counter_to_str(nvc_perf_counter_t counter) {
+    switch (counter) {
+        case NVC_PERF_CYCLES: return "cycles";
+        case NVC_PERF_INSTRUCTIONS: return "instructions";
+        case NVC_PERF_BRANCH_MISSES: return "branch-misses";
+        case NVC_PERF_L1D_MISSES: return "l1d-misses";
+        case NVC_PERF_LLC_MISSES: return "llc-misses";
+        case NVC_PERF_PAGE_FAULTS: return "page-faults";
+        case NVC_PERF_N_COUNTERS: break;
+    }
+    return "unknown";
+}
+
+// prints one column, n/a for a counter that was not available
+static void nvc_perf_print_count(FILE* fp,
+                                 const nvc_perf_phase_t* phase,
+                                 nvc_perf_counter_t counter,
+                                 int width) {
+    if (phase->missing & (1u << counter))
+        fprintf(fp, " %*s", width, "n/a");
+    else
+        fprintf(fp, " %*llu", width,
+                (unsigned long long)phase->counts[counter]);
+}
+
+static void nvc_perf_print_ratio(FILE* fp,
+                                 bool valid,
+                                 uint64_t a,
+                                 uint64_t b,
+                                 int width) {
+    if (!valid || !b)
+        fprintf(fp, " %*s", width, "n/a");
+    else
+        fprintf(fp, " %*.2f", width, (double)a / b);
+}
+
+// note: per byte and per token costs are in cycles, or in ns when cycles are
+// not counted in every phase
+static void nvc_perf_print_phase(FILE* fp,
+                                 const nvc_perf_profile_t* profile,
+                                 const char* name,
+                                 const nvc_perf_phase_t* phase,
+                                 bool per_cycle) {
+    bool cycles = !(phase->missing & (1u << NVC_PERF_CYCLES));
+    bool instructions = !(phase->missing & (1u << NVC_PERF_INSTRUCTIONS));
+    fprintf(fp, "%-9s %10.3f", name, phase->ns / 1e6);
+    nvc_perf_print_count(fp, phase, NVC_PERF_CYCLES, 13);
+    nvc_perf_print_count(fp, phase, NVC_PERF_INSTRUCTIONS, 13);
+    nvc_perf_print_ratio(fp, cycles && instructions,
+                         phase->counts[NVC_PERF_INSTRUCTIONS],
+                         phase->counts[NVC_PERF_CYCLES], 5);
+    nvc_perf_print_count(fp, phase, NVC_PERF_BRANCH_MISSES, 10);
+    nvc_perf_print_count(fp, phase, NVC_PERF_L1D_MISSES, 10);
+    nvc_perf_print_count(fp, phase, NVC_PERF_LLC_MISSES, 10);
+    nvc_perf_print_count(fp, phase, NVC_PERF_PAGE_FAULTS, 8);
+    uint64_t cost = per_cycle ? phase->counts[NVC_PERF_CYCLES] : phase->ns;
+    nvc_perf_print_ratio(fp, true, cost, profile->n_bytes, 8);
+    nvc_perf_print_ratio(fp, true, cost, profile->n_tokens, 8);
+    fputc('\n', fp);
+}
+
+void nvc_perf_print(FILE* fp, const nvc_perf_profile_t* profile) {
+    nvc_perf_phase_t total = {0};
+    for (int i = 0; i < NVC_PHASE_N; ++i) {
+        const nvc_perf_phase_t* phase = profile->phases + i;
+        total.ns += phase->ns;
+        for (int j = 0; j < NVC_PERF_N_COUNTERS; ++j)
+            total.counts[j] += phase->counts[j];
+        total.missing |= phase->missing;
+        total.n_spans += phase->n_spans;
+    }
+    bool per_cycle = !(total.missing & (1u << NVC_PERF_CYCLES));
+
+    fprintf(fp, "----- Perf counters (%llu bytes, %llu tokens):\n",
+            (unsigned long long)profile->n_bytes,
+            (unsigned long long)profile->n_tokens);
+    fprintf(fp, "%-9s %10s %13s %13s %5s %10s %10s %10s %8s %8s %8s\n",
+            "phase", "ms", "cycles", "instructions", "IPC", "br-miss",
+            "l1d-miss", "llc-miss", "faults",
+            per_cycle ? "cyc/byte" : "ns/byte",
+            per_cycle ? "cyc/tok" : "ns/tok");
+    for (int i = 0; i < NVC_PHASE_N; ++i) {
+        const nvc_perf_phase_t* phase = profile->phases + i;
+        if (phase->n_spans)
+            nvc_perf_print_phase(fp, profile, nvc_phase_to_str(i), phase,
+                                 per_cycle);
+    }
+    if (total.n_spans)
+        nvc_perf_print_phase(fp, profile, "total", &total, per_cycle);
+
+    if (profile->error) {
+        fprintf(fp, "note: some counters are unavailable: %s",
+                strerror(profile->error));
+#ifdef __linux__
+        // note: the usual reason in containers and on hardened systems
+        FILE* paranoid = fopen("/proc/sys/kernel/perf_event_paranoid", "r");
+        int level;
+        if (paranoid && fscanf(paranoid, "%d", &level) == 1)
+            fprintf(fp, " (perf_event_paranoid is %d)", level);
+        if (paranoid) fclose(paranoid);
+#endif
+        fputs(".\n", fp);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,215 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+#include <nvc_pipeline.h>
+
+// how often an empty/full ring is polled before giving up the cpu
+#define NVC_TOKEN_RING_SPINS 128
+
+static void nvc_token_ring_wait(uint32_t* spins) {
+    // note: yielding instead of sleeping keeps the latency low, and lets the
+    // other side run at all when both threads share a cpu
+    if (++*spins >= NVC_TOKEN_RING_SPINS) {
+        *spins = 0;
+        sched_yield();
+    }
+}
+
+bool nvc_token_ring_init(nvc_token_ring_t* ring,
+                         nvc_allocator_t* allocator,
+                         uint32_t capacity) {
+    uint32_t rounded = 1;
+    while (rounded < capacity) rounded <<= 1;
+    ring->allocator = allocator;
+    ring->capacity = rounded;
+    ring->slots = nvc_alloc(allocator, rounded * sizeof(nvc_tok_t));
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->closed, false);
+    atomic_init(&ring->cancelled, false);
+    return ring->slots != NULL;
+}
+
+void nvc_token_ring_free(nvc_token_ring_t* ring) {
+    nvc_free(ring->allocator, ring->slots);
+    ring->slots = NULL;
+}
+
+nvc_tok_t* nvc_token_ring_reserve(nvc_token_ring_t* ring,
+                                  uint32_t max,
+                                  uint32_t* n) {
+    // note: only the producer writes tail so it can be read relaxed, head is
+    // read with acquire so the consumer is done with the slots it freed
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t available;
+    uint32_t spins = 0;
+    for (;;) {
+        if (atomic_load_explicit(&ring->cancelled, memory_order_acquire))
+            return NULL;
+        uint32_t head =
+            atomic_load_explicit(&ring->head, memory_order_acquire);
+        available = ring->capacity - (tail - head);
+        if (available) break;
+        nvc_token_ring_wait(&spins);
+    }
+    // only the run up to the end of the slots is contiguous
+    uint32_t index = tail & (ring->capacity - 1);
+    uint32_t contiguous = ring->capacity - index;
+    if (available > contiguous) available = contiguous;
+    *n = available < max ? available : max;
+    return ring->slots + index;
+}
+
+void nvc_token_ring_commit(nvc_token_ring_t* ring, uint32_t n) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    // release: the tokens are written before the consumer can see them
+    atomic_store_explicit(&ring->tail, tail + n, memory_order_release);
+}
+
+void nvc_token_ring_close(nvc_token_ring_t* ring) {
+    atomic_store_explicit(&ring->closed, true, memory_order_release);
+}
+
+uint32_t nvc_token_ring_pop(nvc_token_ring_t* ring,
+                            nvc_tok_t* toks,
+                            uint32_t max) {
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail;
+    uint32_t spins = 0;
+    for (;;) {
+        tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (tail != head) break;
+        if (atomic_load_explicit(&ring->closed, memory_order_acquire)) {
+            // note: the last commit happens before closing, look again
+            tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+            if (tail == head) return 0;
+            break;
+        }
+        nvc_token_ring_wait(&spins);
+    }
+
+    uint32_t n = tail - head;
+    if (n > max) n = max;
+    uint32_t index = head & (ring->capacity - 1);
+    uint32_t first = ring->capacity - index;
+    if (first > n) first = n;
+    memcpy(toks, ring->slots + index, first * sizeof(nvc_tok_t));
+    memcpy(toks + first, ring->slots, (n - first) * sizeof(nvc_tok_t));
+    // release: the slots are read before the producer can reuse them
+    atomic_store_explicit(&ring->head, head + n, memory_order_release);
+    return n;
+}
+
+void nvc_token_ring_cancel(nvc_token_ring_t* ring) {
+    atomic_store_explicit(&ring->cancelled, true, memory_order_release);
+}
+
+typedef struct {
+    nvc_lexer_t lexer;
+    nvc_token_ring_t* ring;
+    nvc_diagnostics_t diags;  // only touched by the lexer thread until joined
+    nvc_perf_profile_t* profile;
+    uint64_t n_tokens;
+} nvc_lex_job_t;
+
+static void* nvc_lex_main(void* arg) {
+    nvc_lex_job_t* job = arg;
+    nvc_lexer_t* lexer = &job->lexer;
+    nvc_perf_span_t span;
+    nvc_perf_begin(&span, job->profile, NVC_PHASE_LEX);
+    while (!lexer->done && !lexer->failed) {
+        uint32_t n;
+        nvc_tok_t* slots =
+            nvc_token_ring_reserve(job->ring, NVC_TOKEN_RING_BATCH, &n);
+        // note: tokens lexed but never committed only leak into the string
+        // arena, which is released as a whole
+        if (!slots) break;
+        n = nvc_lexer_next(lexer, slots, n);
+        job->n_tokens += n;
+        nvc_token_ring_commit(job->ring, n);
+    }
+    nvc_token_ring_close(job->ring);
+    nvc_perf_end(&span);
+    return NULL;
+}
+
+static uint32_t nvc_ring_source(void* source, nvc_tok_t* toks, uint32_t max) {
+    return nvc_token_ring_pop(source, toks, max);
+}
+
+static uint32_t nvc_lexer_source(void* source,
+                                 nvc_tok_t* toks,
+                                 uint32_t max) {
+    nvc_lex_job_t* job = source;
+    uint32_t n = nvc_lexer_next(&job->lexer, toks, max);
+    job->n_tokens += n;
+    return n;
+}
+
+nvc_ast_t* nvc_lex_and_parse_pipelined(nvc_allocator_t* allocator,
+                                       nvc_diagnostics_t* diags,
+                                       nvc_arena_t* strings,
+                                       char* bufname,
+                                       char* buf,
+                                       long bufsz,
+                                       const nvc_parse_options_t* options,
+                                       nvc_perf_profile_t* profile) {
+    if (!allocator) allocator = nvc_default_allocator();
+
+    nvc_token_ring_t ring;
+    if (!nvc_token_ring_init(&ring, allocator, NVC_TOKEN_RING_CAPACITY)) {
+        fprintf(stderr, "Out of memory!\n");
+        return NULL;
+    }
+
+    // note: each thread reports into its own sink so neither has to lock,
+    // the reports are moved to diags in phase order once the lexer is joined
+    nvc_lex_job_t job = {.ring = &ring, .profile = profile};
+    nvc_diagnostics_init(&job.diags, diags->allocator);
+    job.diags.max_errors = diags->max_errors;
+    nvc_diagnostics_t parse_diags;
+    nvc_diagnostics_init(&parse_diags, diags->allocator);
+    parse_diags.max_errors = diags->max_errors;
+    // note: the up front part of lexing (validating the input) runs here
+    nvc_perf_span_t span;
+    nvc_perf_begin(&span, profile, NVC_PHASE_LEX);
+    nvc_lexer_init(&job.lexer, nvc_arena_allocator(strings), &job.diags,
+                   bufname, buf, bufsz);
+    nvc_perf_end(&span);
+
+    nvc_ast_t* ast;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, nvc_lex_main, &job) == 0) {
+        nvc_perf_begin(&span, profile, NVC_PHASE_PARSE);
+        ast = nvc_parse_incremental(allocator, &parse_diags, nvc_ring_source,
+                                    &ring, options);
+        nvc_perf_end(&span);
+        // the parser may stop before the end of input (error limit, out of
+        // memory), the lexer must not wait for it forever
+        nvc_token_ring_cancel(&ring);
+        pthread_join(thread, NULL);
+    } else {
+        // no thread, lex on demand on this one
+        nvc_perf_begin(&span, profile, NVC_PHASE_PARSE);
+        ast = nvc_parse_incremental(allocator, &parse_diags,
+                                    nvc_lexer_source, &job, options);
+        nvc_perf_end(&span);
+    }
+    nvc_perf_add_tokens(profile, job.n_tokens);
+
+    nvc_diagnostics_merge(diags, &job.diags);
+    nvc_diagnostics_merge(diags, &parse_diags);
+    nvc_diagnostics_free(&job.diags);
+    nvc_diagnostics_free(&parse_diags);
+    nvc_token_ring_free(&ring);
+    return ast;
+}
+
+#ifdef __cplusplus
+}
+#endif
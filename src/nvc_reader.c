@@ -0,0 +1,517 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nvc_reader.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#if defined(__linux__) && defined(SYS_io_uring_setup)
+#define NVC_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <linux/stat.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#endif
+
+// a submitted file, owned by the reader until its callback ran
+struct nvc_read_s {
+    nvc_read_t* next;
+    const char* path;
+    void* file;
+    nvc_perf_span_t span;  // NVC_PHASE_READ, begun when the file is started
+    // io_uring state
+    int fd;
+    int error;           // first failed operation, 0 if none
+    uint32_t n_waiting;  // operations in flight
+    uint64_t size, offset;
+    char* buf;
+#ifdef NVC_HAVE_IO_URING
+    struct statx stx;
+#endif
+};
+
+const char* nvc_reader_backend_to_str(nvc_reader_backend_t backend) {
+    switch (backend) {
+        case NVC_READER_AUTO: return "auto";
+        case NVC_READER_URING: return "io_uring";
+        case NVC_READER_THREADS: return "threads";
+        case NVC_READER_SYNC: return "sync";
+    }
+    return "unknown";
+}
+
+// hands a file that was read (or failed to) to the callback and frees it
+// note: buf holds size raw bytes with room for one more, status is only
+// looked at when there is no buffer
+static void nvc_read_finish(nvc_reader_t* reader,
+                            nvc_read_t* read,
+                            char* buf,
+                            uint64_t size,
+                            nvc_source_status_t status) {
+    long bufsz = 0;
+    if (buf) buf = nvc_decode_source(reader->allocator, buf, size, &bufsz,
+                                     &status);
+    nvc_perf_end(&read->span);
+    reader->done(reader->ctx, read->file, buf, bufsz, status);
+    nvc_free(reader->allocator, read);
+}
+
+// reads a file with plain blocking calls on the calling thread
+static void nvc_read_blocking(nvc_reader_t* reader, nvc_read_t* read) {
+    nvc_source_status_t status = NVC_SOURCE_UNREADABLE;
+    char* buf = NULL;
+    uint64_t size = 0;
+    nvc_perf_begin(&read->span, reader->profile, NVC_PHASE_READ);
+    int fd = open(read->path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size >= LONG_MAX) goto out;
+    buf = nvc_alloc(reader->allocator, (size_t)st.st_size + 1);
+    if (!buf) {
+        status = NVC_SOURCE_OUT_OF_MEMORY;
+        goto out;
+    }
+    // note: a file that shrank since the stat is read up to its end
+    while (size < (uint64_t)st.st_size) {
+        ssize_t n = pread(fd, buf + size, (size_t)st.st_size - size,
+                          (off_t)size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            nvc_free(reader->allocator, buf);
+            buf = NULL;
+            goto out;
+        }
+        if (n == 0) break;
+        size += (uint64_t)n;
+    }
+out:
+    if (fd >= 0) close(fd);
+    nvc_read_finish(reader, read, buf, size, status);
+}
+
+// note: lock must be held
+static nvc_read_t* nvc_reader_pop(nvc_reader_t* reader) {
+    nvc_read_t* read = reader->queue;
+    if (read) {
+        reader->queue = read->next;
+        if (!reader->queue) reader->queue_tail = NULL;
+    }
+    return read;
+}
+
+static void* nvc_reader_thread_main(void* arg) {
+    nvc_reader_t* reader = arg;
+    pthread_mutex_lock(&reader->lock);
+    for (;;) {
+        while (!reader->stop && !reader->queue)
+            pthread_cond_wait(&reader->cond, &reader->lock);
+        nvc_read_t* read = nvc_reader_pop(reader);
+        if (!read) break;
+        pthread_mutex_unlock(&reader->lock);
+        nvc_read_blocking(reader, read);
+        pthread_mutex_lock(&reader->lock);
+    }
+    pthread_mutex_unlock(&reader->lock);
+    return NULL;
+}
+
+#ifdef NVC_HAVE_IO_URING
+// what a completion belongs to, stored in the low bits of its user data
+// next to the nvc_read_t (allocations are aligned to at least 8)
+enum {
+    NVC_URING_EVENT = 0,  // the read of the wake up event, no file
+    NVC_URING_OPEN = 1,
+    NVC_URING_STATX = 2,
+    NVC_URING_READ = 3,
+    NVC_URING_TAGS = 7,
+};
+
+// state of the ring thread
+typedef struct {
+    nvc_reader_t* reader;
+    uint32_t n_files;        // files with operations in flight
+    uint32_t n_unsubmitted;  // queued entries the kernel has not taken yet
+    bool event_armed;
+    uint64_t event_value;
+} nvc_uring_t;
+
+static int nvc_uring_enter(int fd, uint32_t to_submit, uint32_t min_complete) {
+    return (int)syscall(SYS_io_uring_enter, fd, to_submit, min_complete,
+                        IORING_ENTER_GETEVENTS, NULL, 0);
+}
+
+// fills in the next submission queue entry, nvc_uring_publish hands it over
+// note: there always is one, every file needs at most two at a time, the
+// event one and the queue has room for all of them
+static struct io_uring_sqe* nvc_uring_sqe(nvc_reader_t* reader,
+                                          uint8_t opcode,
+                                          int fd,
+                                          uint64_t user_data) {
+    uint32_t tail = *reader->sq_tail;
+    uint32_t index = tail & reader->sq_mask;
+    struct io_uring_sqe* sqe = (struct io_uring_sqe*)reader->sqes + index;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->user_data = user_data;
+    reader->sq_array[index] = index;
+    return sqe;
+}
+
+// makes the entry returned by the last nvc_uring_sqe visible to the kernel
+static void nvc_uring_publish(nvc_reader_t* reader) {
+    __atomic_store_n(reader->sq_tail, *reader->sq_tail + 1, __ATOMIC_RELEASE);
+}
+
+static void nvc_uring_read(nvc_uring_t* uring, nvc_read_t* read) {
+    struct io_uring_sqe* sqe =
+        nvc_uring_sqe(uring->reader, IORING_OP_READ, read->fd,
+                      (uint64_t)(uintptr_t)read | NVC_URING_READ);
+    uint64_t left = read->size - read->offset;
+    sqe->addr = (uint64_t)(uintptr_t)(read->buf + read->offset);
+    sqe->len = left > INT_MAX ? INT_MAX : (uint32_t)left;
+    sqe->off = read->offset;
+    nvc_uring_publish(uring->reader);
+    ++uring->n_unsubmitted;
+    read->n_waiting = 1;
+}
+
+// the open and the stat of a file go out together, both only need the path
+static void nvc_uring_open(nvc_uring_t* uring, nvc_read_t* read) {
+    uint64_t user_data = (uint64_t)(uintptr_t)read;
+    read->fd = -1;
+    nvc_perf_begin(&read->span, uring->reader->profile, NVC_PHASE_READ);
+    struct io_uring_sqe* sqe =
+        nvc_uring_sqe(uring->reader, IORING_OP_OPENAT, AT_FDCWD,
+                      user_data | NVC_URING_OPEN);
+    sqe->addr = (uint64_t)(uintptr_t)read->path;
+    sqe->open_flags = O_RDONLY | O_CLOEXEC;
+    nvc_uring_publish(uring->reader);
+
+    sqe = nvc_uring_sqe(uring->reader, IORING_OP_STATX, AT_FDCWD,
+                        user_data | NVC_URING_STATX);
+    sqe->addr = (uint64_t)(uintptr_t)read->path;
+    sqe->len = STATX_SIZE;
+    sqe->off = (uint64_t)(uintptr_t)&read->stx;
+    nvc_uring_publish(uring->reader);
+
+    uring->n_unsubmitted += 2;
+    read->n_waiting = 2;
+    ++uring->n_files;
+}
+
+static void nvc_uring_finish(nvc_uring_t* uring,
+                             nvc_read_t* read,
+                             nvc_source_status_t status) {
+    nvc_reader_t* reader = uring->reader;
+    if (read->fd >= 0) close(read->fd);
+    char* buf = read->buf;
+    if (status != NVC_SOURCE_OK) {
+        nvc_free(reader->allocator, buf);
+        buf = NULL;
+    }
+    --uring->n_files;
+    nvc_read_finish(reader, read, buf, read->offset, status);
+}
+
+// advances a file by one completion: once open and stat are both done the
+// whole file is read, a short read reads the rest
+static void nvc_uring_complete(nvc_uring_t* uring,
+                               nvc_read_t* read,
+                               uint32_t tag,
+                               int32_t res) {
+    if (tag == NVC_URING_READ && (res == -EINTR || res == -EAGAIN)) {
+        nvc_uring_read(uring, read);
+        return;
+    }
+    if (res < 0 && !read->error) read->error = -res;
+    if (tag == NVC_URING_OPEN && res >= 0) read->fd = res;
+    if (--read->n_waiting) return;
+    if (read->error) {
+        nvc_uring_finish(uring, read, NVC_SOURCE_UNREADABLE);
+        return;
+    }
+
+    if (tag != NVC_URING_READ) {
+        read->size = read->stx.stx_size;
+        if (read->size >= LONG_MAX) {
+            nvc_uring_finish(uring, read, NVC_SOURCE_UNREADABLE);
+            return;
+        }
+        read->buf = nvc_alloc(uring->reader->allocator, read->size + 1);
+        if (!read->buf) {
+            nvc_uring_finish(uring, read, NVC_SOURCE_OUT_OF_MEMORY);
+            return;
+        }
+    } else if (res == 0) {
+        // note: the file shrank since the stat, it ends here
+        read->size = read->offset;
+    } else {
+        read->offset += (uint64_t)res;
+    }
+    if (read->offset < read->size)
+        nvc_uring_read(uring, read);
+    else
+        nvc_uring_finish(uring, read, NVC_SOURCE_OK);
+}
+
+static void nvc_uring_arm_event(nvc_uring_t* uring) {
+    nvc_reader_t* reader = uring->reader;
+    struct io_uring_sqe* sqe =
+        nvc_uring_sqe(reader, IORING_OP_READ, reader->event_fd,
+                      NVC_URING_EVENT);
+    sqe->addr = (uint64_t)(uintptr_t)&uring->event_value;
+    sqe->len = sizeof(uring->event_value);
+    nvc_uring_publish(reader);
+    ++uring->n_unsubmitted;
+    uring->event_armed = true;
+}
+
+static void nvc_uring_reap(nvc_uring_t* uring) {
+    nvc_reader_t* reader = uring->reader;
+    uint32_t head = *reader->cq_head;
+    uint32_t tail = __atomic_load_n(reader->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+        struct io_uring_cqe* cqe =
+            (struct io_uring_cqe*)reader->cqes + (head & reader->cq_mask);
+        uint64_t user_data = cqe->user_data;
+        int32_t res = cqe->res;
+        // note: the entry is free for the kernel once head moves past it
+        __atomic_store_n(reader->cq_head, head + 1, __ATOMIC_RELEASE);
+        uint32_t tag = (uint32_t)(user_data & NVC_URING_TAGS);
+        if (tag == NVC_URING_EVENT) {
+            uring->event_armed = false;
+            continue;
+        }
+        nvc_read_t* read =
+            (nvc_read_t*)(uintptr_t)(user_data & ~(uint64_t)NVC_URING_TAGS);
+        nvc_uring_complete(uring, read, tag, res);
+    }
+}
+
+// submits what accumulated, then sleeps until something completes. new
+// files are taken from the queue in batches, as many as fit in the ring
+static void* nvc_uring_main(void* arg) {
+    nvc_uring_t uring = {.reader = arg};
+    nvc_reader_t* reader = arg;
+    for (;;) {
+        pthread_mutex_lock(&reader->lock);
+        bool stop = reader->stop;
+        while (uring.n_files < NVC_READER_URING_FILES && reader->queue)
+            nvc_uring_open(&uring, nvc_reader_pop(reader));
+        bool idle = !reader->queue && !uring.n_files;
+        pthread_mutex_unlock(&reader->lock);
+        if (stop && idle) break;
+
+        if (!uring.event_armed) nvc_uring_arm_event(&uring);
+        // note: errors are transient here (interrupted, a full completion
+        // queue), nvc_uring_setup made sure the ring works
+        int n = nvc_uring_enter(reader->ring_fd, uring.n_unsubmitted, 1);
+        if (n > 0) uring.n_unsubmitted -= (uint32_t)n;
+        nvc_uring_reap(&uring);
+    }
+    // note: the event read is still pending, closing the ring cancels it
+    return NULL;
+}
+
+static void nvc_uring_free(nvc_reader_t* reader) {
+    if (reader->sqes) munmap(reader->sqes, reader->sqes_size);
+    if (reader->cq_ring && reader->cq_ring != reader->sq_ring)
+        munmap(reader->cq_ring, reader->cq_ring_size);
+    if (reader->sq_ring) munmap(reader->sq_ring, reader->sq_ring_size);
+    if (reader->ring_fd >= 0) close(reader->ring_fd);
+    if (reader->event_fd >= 0) close(reader->event_fd);
+    reader->sqes = reader->cq_ring = reader->sq_ring = NULL;
+    reader->ring_fd = reader->event_fd = -1;
+}
+
+static void* nvc_uring_map(nvc_reader_t* reader, size_t size, off_t offset) {
+    void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, reader->ring_fd, offset);
+    return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+// sets up the ring and checks that it works with the operations used, a
+// kernel without them or a sandbox denying the calls makes it fail
+static bool nvc_uring_setup(nvc_reader_t* reader) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    reader->ring_fd = (int)syscall(SYS_io_uring_setup,
+                                   NVC_READER_URING_FILES * 2 + 1, &p);
+    if (reader->ring_fd < 0) goto error;
+    reader->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+    reader->cq_ring_size =
+        p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single) {
+        if (reader->cq_ring_size > reader->sq_ring_size)
+            reader->sq_ring_size = reader->cq_ring_size;
+        reader->cq_ring_size = reader->sq_ring_size;
+    }
+    reader->sq_ring =
+        nvc_uring_map(reader, reader->sq_ring_size, IORING_OFF_SQ_RING);
+    if (!reader->sq_ring) goto error;
+    reader->cq_ring =
+        single ? reader->sq_ring
+               : nvc_uring_map(reader, reader->cq_ring_size,
+                               IORING_OFF_CQ_RING);
+    if (!reader->cq_ring) goto error;
+    reader->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    reader->sqes = nvc_uring_map(reader, reader->sqes_size, IORING_OFF_SQES);
+    if (!reader->sqes) goto error;
+
+    char* sq = reader->sq_ring;
+    char* cq = reader->cq_ring;
+    reader->sq_tail = (uint32_t*)(sq + p.sq_off.tail);
+    reader->sq_array = (uint32_t*)(sq + p.sq_off.array);
+    reader->sq_mask = *(uint32_t*)(sq + p.sq_off.ring_mask);
+    reader->cq_head = (uint32_t*)(cq + p.cq_off.head);
+    reader->cq_tail = (uint32_t*)(cq + p.cq_off.tail);
+    reader->cq_mask = *(uint32_t*)(cq + p.cq_off.ring_mask);
+    reader->cqes = cq + p.cq_off.cqes;
+
+    // note: the operations are there since 5.6, older kernels set up rings
+    // that fail every one of them
+    static const uint8_t ops[] = {IORING_OP_OPENAT, IORING_OP_STATX,
+                                  IORING_OP_READ};
+    enum { N_PROBE_OPS = 256 };
+    struct io_uring_probe* probe = nvc_calloc(
+        reader->allocator, 1,
+        sizeof(*probe) + N_PROBE_OPS * sizeof(struct io_uring_probe_op));
+    if (!probe) goto error;
+    bool supported = syscall(SYS_io_uring_register, reader->ring_fd,
+                             IORING_REGISTER_PROBE, probe, N_PROBE_OPS) == 0;
+    for (size_t i = 0; supported && i < sizeof(ops); ++i)
+        supported = ops[i] <= probe->last_op &&
+                    (probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED);
+    nvc_free(reader->allocator, probe);
+    if (!supported) goto error;
+
+    reader->event_fd = eventfd(0, EFD_CLOEXEC);
+    if (reader->event_fd < 0) goto error;
+
+    // one round trip, the rings can be set up where entering is denied
+    nvc_uring_sqe(reader, IORING_OP_NOP, -1, NVC_URING_EVENT);
+    nvc_uring_publish(reader);
+    int n;
+    do {
+        n = nvc_uring_enter(reader->ring_fd, 1, 1);
+    } while (n < 0 && errno == EINTR);
+    if (n != 1) goto error;
+    uint32_t head = *reader->cq_head;
+    if (__atomic_load_n(reader->cq_tail, __ATOMIC_ACQUIRE) == head)
+        goto error;
+    __atomic_store_n(reader->cq_head, head + 1, __ATOMIC_RELEASE);
+    return true;
+error:
+    nvc_uring_free(reader);
+    return false;
+}
+#endif
+
+bool nvc_reader_start(nvc_reader_t* reader,
+                      nvc_allocator_t* allocator,
+                      nvc_reader_backend_t backend,
+                      nvc_reader_done_t done,
+                      void* ctx,
+                      nvc_perf_profile_t* profile) {
+    memset(reader, 0, sizeof(*reader));
+    reader->allocator = allocator ? allocator : nvc_default_allocator();
+    reader->done = done;
+    reader->ctx = ctx;
+    reader->profile = profile;
+    reader->ring_fd = reader->event_fd = -1;
+    if (backend == NVC_READER_SYNC) return false;
+    pthread_mutex_init(&reader->lock, NULL);
+    pthread_cond_init(&reader->cond, NULL);
+    reader->threads = nvc_alloc(reader->allocator,
+                                NVC_READER_N_THREADS * sizeof(pthread_t));
+    if (!reader->threads) goto error;
+
+#ifdef NVC_HAVE_IO_URING
+    if (backend != NVC_READER_THREADS && nvc_uring_setup(reader)) {
+        if (pthread_create(reader->threads, NULL, nvc_uring_main, reader) ==
+            0) {
+            reader->backend = NVC_READER_URING;
+            reader->n_threads = 1;
+            return true;
+        }
+        nvc_uring_free(reader);
+    }
+#endif
+    if (backend == NVC_READER_URING) goto error;
+
+    reader->backend = NVC_READER_THREADS;
+    for (uint32_t i = 0; i < NVC_READER_N_THREADS; ++i) {
+        if (pthread_create(reader->threads + reader->n_threads, NULL,
+                           nvc_reader_thread_main, reader) == 0)
+            ++reader->n_threads;
+    }
+    if (reader->n_threads) return true;
+error:
+    nvc_free(reader->allocator, reader->threads);
+    reader->threads = NULL;
+    pthread_cond_destroy(&reader->cond);
+    pthread_mutex_destroy(&reader->lock);
+    return false;
+}
+
+// wakes whoever takes files from the queue
+static void nvc_reader_wake(nvc_reader_t* reader) {
+#ifdef NVC_HAVE_IO_URING
+    if (reader->backend == NVC_READER_URING) {
+        uint64_t one = 1;
+        // note: can only fail when the counter would overflow, then the
+        // ring thread is woken already
+        ssize_t n = write(reader->event_fd, &one, sizeof(one));
+        (void)n;
+        return;
+    }
+#endif
+    pthread_cond_broadcast(&reader->cond);
+}
+
+bool nvc_reader_submit(nvc_reader_t* reader, const char* path, void* file) {
+    nvc_read_t* read = nvc_calloc(reader->allocator, 1, sizeof(nvc_read_t));
+    if (!read) return false;
+    read->path = path;
+    read->file = file;
+    pthread_mutex_lock(&reader->lock);
+    if (reader->queue_tail)
+        reader->queue_tail->next = read;
+    else
+        reader->queue = read;
+    reader->queue_tail = read;
+    nvc_reader_wake(reader);
+    pthread_mutex_unlock(&reader->lock);
+    return true;
+}
+
+void nvc_reader_stop(nvc_reader_t* reader) {
+    if (!reader->threads) return;
+    pthread_mutex_lock(&reader->lock);
+    reader->stop = true;
+    nvc_reader_wake(reader);
+    pthread_mutex_unlock(&reader->lock);
+    for (uint32_t i = 0; i < reader->n_threads; ++i)
+        pthread_join(reader->threads[i], NULL);
+    nvc_free(reader->allocator, reader->threads);
+    reader->threads = NULL;
+#ifdef NVC_HAVE_IO_URING
+    nvc_uring_free(reader);
+#endif
+    pthread_cond_destroy(&reader->cond);
+    pthread_mutex_destroy(&reader->lock);
+}
+
+#ifdef __cplusplus
+}
+#endif
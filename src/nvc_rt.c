@@ -0,0 +1,582 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nvc_rt.h>
+
+#include <nvc_bigint.h>
+#include <nvc_number.h>
+#include <nvc_simd.h>
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+_Noreturn void nvc_rt_trap(uint32_t trap) {
+    const char* why;
+    switch (trap) {
+        case NVC_RT_TRAP_DIV_BY_ZERO: why = "division by zero"; break;
+        case NVC_RT_TRAP_OVERFLOW: why = "integer too large"; break;
+        case NVC_RT_TRAP_NEGATIVE_EXPONENT: why = "negative exponent"; break;
+        case NVC_RT_TRAP_OUT_OF_BOUNDS: why = "index out of bounds"; break;
+        case NVC_RT_TRAP_OUT_OF_MEMORY: why = "out of memory"; break;
+        default: why = "unknown trap"; break;
+    }
+    fprintf(stderr, "nvc: trap: %s\n", why);
+    exit(1);
+}
+
+// note: the tags, see nvc_rt.h
+static inline bool nvc_rt_is_small(nvc_rt_int_t value) {
+    return !(value & 1);
+}
+
+static inline nvc_rt_int_t nvc_rt_small(int64_t value) {
+    return (uint64_t)value << 1;
+}
+
+static inline int64_t nvc_rt_small_value(nvc_rt_int_t value) {
+    return (int64_t)value >> 1;
+}
+
+// the nvc_bigint_t of value, a small one is converted into storage
+static const nvc_bigint_t* nvc_rt_big(nvc_rt_int_t value,
+                                      nvc_bigint_i64_t* storage) {
+    if (!nvc_rt_is_small(value))
+        return (const nvc_bigint_t*)(uintptr_t)(value - 1);
+    nvc_bigint_set_i64(&storage->value, nvc_rt_small_value(value));
+    return &storage->value;
+}
+
+static nvc_bigint_t* nvc_rt_alloc_big(uint64_t n_limbs) {
+    if (n_limbs > NVC_BIGINT_MAX_LIMBS) nvc_rt_trap(NVC_RT_TRAP_OVERFLOW);
+    nvc_bigint_t* big = malloc(NVC_BIGINT_SIZE(n_limbs));
+    if (!big) nvc_rt_trap(NVC_RT_TRAP_OUT_OF_MEMORY);
+    return big;
+}
+
+// the tagged word of big, which nvc_rt_alloc_big allocated
+static nvc_rt_int_t nvc_rt_tag(nvc_bigint_t* big) {
+    int64_t value;
+    if (nvc_bigint_get_i64(big, &value) && nvc_is_small_int(value)) {
+        free(big);
+        return nvc_rt_small(value);
+    }
+    return (nvc_rt_int_t)(uintptr_t)big | 1;
+}
+
+// the operations of the helpers on ints, only the slow path is called from
+// the objects
+static nvc_rt_int_t nvc_rt_int_binary(uint32_t op,
+                                      nvc_rt_int_t lhs,
+                                      nvc_rt_int_t rhs) {
+    if (nvc_rt_is_small(lhs | rhs)) {
+        int64_t a = nvc_rt_small_value(lhs), b = nvc_rt_small_value(rhs), i;
+        switch (op) {
+            case NVC_RT_ADD:
+                if (nvc_small_add(a, b, &i)) return nvc_rt_small(i);
+                break;
+            case NVC_RT_SUB:
+                if (nvc_small_sub(a, b, &i)) return nvc_rt_small(i);
+                break;
+            case NVC_RT_MUL:
+                if (nvc_small_mul(a, b, &i)) return nvc_rt_small(i);
+                break;
+            case NVC_RT_DIV:
+                if (b == 0) nvc_rt_trap(NVC_RT_TRAP_DIV_BY_ZERO);
+                // note: only the smallest int divided by -1 is not small
+                if (nvc_is_small_int(a / b)) return nvc_rt_small(a / b);
+                break;
+            default:
+                if (b < 0) nvc_rt_trap(NVC_RT_TRAP_NEGATIVE_EXPONENT);
+                if (nvc_small_pow(a, b, &i)) return nvc_rt_small(i);
+                break;
+        }
+    }
+
+    nvc_bigint_i64_t lhs_storage, rhs_storage;
+    const nvc_bigint_t* a = nvc_rt_big(lhs, &lhs_storage);
+    const nvc_bigint_t* b = nvc_rt_big(rhs, &rhs_storage);
+    uint64_t n_max = a->n_limbs > b->n_limbs ? a->n_limbs : b->n_limbs;
+    nvc_bigint_t* result;
+    switch (op) {
+        case NVC_RT_ADD:
+            result = nvc_rt_alloc_big(n_max + 1);
+            nvc_bigint_add(result, a, b);
+            break;
+        case NVC_RT_SUB:
+            result = nvc_rt_alloc_big(n_max + 1);
+            nvc_bigint_sub(result, a, b);
+            break;
+        case NVC_RT_MUL:
+            result = nvc_rt_alloc_big((uint64_t)a->n_limbs + b->n_limbs);
+            nvc_bigint_mul(result, a, b);
+            break;
+        case NVC_RT_DIV: {
+            if (!b->n_limbs) nvc_rt_trap(NVC_RT_TRAP_DIV_BY_ZERO);
+            result = nvc_rt_alloc_big(a->n_limbs);
+            nvc_bigint_t* remainder = nvc_rt_alloc_big(b->n_limbs + 1);
+            nvc_bigint_div(result, remainder, a, b);
+            free(remainder);
+            break;
+        }
+        default: {
+            if (b->negative) nvc_rt_trap(NVC_RT_TRAP_NEGATIVE_EXPONENT);
+            int64_t exponent;
+            if (!nvc_bigint_get_i64(b, &exponent)) {
+                // note: only 0, 1 and -1 have a power that big, the parity
+                // of the exponent is enough for them
+                if (a->n_limbs > 1 || (a->n_limbs && a->limbs[0] > 1))
+                    nvc_rt_trap(NVC_RT_TRAP_OVERFLOW);
+                exponent = 2 + (int64_t)(b->limbs[0] & 1);
+            }
+            uint64_t n = nvc_bigint_pow_limbs(a, (uint64_t)exponent);
+            result = nvc_rt_alloc_big(n);
+            nvc_bigint_t* scratch = nvc_rt_alloc_big(n);
+            nvc_bigint_pow(result, scratch, a, (uint64_t)exponent);
+            free(scratch);
+            break;
+        }
+    }
+    return nvc_rt_tag(result);
+}
+
+nvc_rt_int_t nvc_rt_int_add(nvc_rt_int_t lhs, nvc_rt_int_t rhs) {
+    return nvc_rt_int_binary(NVC_RT_ADD, lhs, rhs);
+}
+
+nvc_rt_int_t nvc_rt_int_sub(nvc_rt_int_t lhs, nvc_rt_int_t rhs) {
+    return nvc_rt_int_binary(NVC_RT_SUB, lhs, rhs);
+}
+
+nvc_rt_int_t nvc_rt_int_mul(nvc_rt_int_t lhs, nvc_rt_int_t rhs) {
+    return nvc_rt_int_binary(NVC_RT_MUL, lhs, rhs);
+}
+
+nvc_rt_int_t nvc_rt_int_div(nvc_rt_int_t lhs, nvc_rt_int_t rhs) {
+    return nvc_rt_int_binary(NVC_RT_DIV, lhs, rhs);
+}
+
+nvc_rt_int_t nvc_rt_int_pow(nvc_rt_int_t base, nvc_rt_int_t exponent) {
+    return nvc_rt_int_binary(NVC_RT_POW, base, exponent);
+}
+
+nvc_rt_int_t nvc_rt_int_neg(nvc_rt_int_t value) {
+    int64_t i;
+    if (nvc_rt_is_small(value) &&
+        nvc_small_sub(0, nvc_rt_small_value(value), &i))
+        return nvc_rt_small(i);
+    nvc_bigint_i64_t storage;
+    const nvc_bigint_t* big = nvc_rt_big(value, &storage);
+    nvc_bigint_t* result = nvc_rt_alloc_big(big->n_limbs);
+    nvc_bigint_neg(result, big);
+    return nvc_rt_tag(result);
+}
+
+nvc_rt_int_t nvc_rt_int_not(nvc_rt_int_t value) {
+    // note: the complement of a small int is small
+    if (nvc_rt_is_small(value)) return ~value & ~(nvc_rt_int_t)1;
+    nvc_bigint_i64_t storage;
+    const nvc_bigint_t* big = nvc_rt_big(value, &storage);
+    nvc_bigint_t* result = nvc_rt_alloc_big((uint64_t)big->n_limbs + 1);
+    nvc_bigint_not(result, big);
+    return nvc_rt_tag(result);
+}
+
+int nvc_rt_int_compare(nvc_rt_int_t lhs, nvc_rt_int_t rhs) {
+    // note: shifting keeps the order of small ints
+    if (nvc_rt_is_small(lhs | rhs))
+        return (int64_t)lhs < (int64_t)rhs ? -1 : lhs != rhs;
+    nvc_bigint_i64_t lhs_storage, rhs_storage;
+    int order = nvc_bigint_compare(nvc_rt_big(lhs, &lhs_storage),
+                                   nvc_rt_big(rhs, &rhs_storage));
+    return order < 0 ? -1 : order > 0;
+}
+
+double nvc_rt_int_to_fp(nvc_rt_int_t value) {
+    if (nvc_rt_is_small(value)) return (double)nvc_rt_small_value(value);
+    nvc_bigint_i64_t storage;
+    return nvc_bigint_to_fp(nvc_rt_big(value, &storage));
+}
+
+nvc_rt_int_t nvc_rt_int_from_i64(int64_t value) {
+    if (nvc_is_small_int(value)) return nvc_rt_small(value);
+    nvc_bigint_t* big = nvc_rt_alloc_big(1);
+    nvc_bigint_set_i64(big, value);
+    return nvc_rt_tag(big);
+}
+
+bool nvc_rt_int_to_i64(nvc_rt_int_t value, int64_t* out) {
+    if (nvc_rt_is_small(value)) {
+        *out = nvc_rt_small_value(value);
+        return true;
+    }
+    nvc_bigint_i64_t storage;
+    return nvc_bigint_get_i64(nvc_rt_big(value, &storage), out);
+}
+
+char* nvc_rt_int_to_str(nvc_rt_int_t value) {
+    nvc_bigint_i64_t storage;
+    const nvc_bigint_t* big = nvc_rt_big(value, &storage);
+    char* str = malloc(nvc_bigint_str_size(big));
+    if (str) nvc_bigint_to_str(big, str);
+    return str;
+}
+
+int64_t nvc_rt_int_wrap_i64(nvc_rt_int_t value) {
+    if (nvc_rt_is_small(value)) return nvc_rt_small_value(value);
+    nvc_bigint_i64_t storage;
+    return nvc_bigint_wrap_i64(nvc_rt_big(value, &storage));
+}
+
+double nvc_rt_pow_fp(double base, double exponent) {
+    return pow(base, exponent);
+}
+
+int64_t nvc_rt_div_i64(int64_t lhs, int64_t rhs) {
+    if (rhs == 0) nvc_rt_trap(NVC_RT_TRAP_DIV_BY_ZERO);
+    return nvc_wrap_div(lhs, rhs);
+}
+
+int64_t nvc_rt_pow_i64(int64_t base, int64_t exponent) {
+    if (exponent < 0) nvc_rt_trap(NVC_RT_TRAP_NEGATIVE_EXPONENT);
+    return nvc_wrap_pow(base, exponent);
+}
+
+float nvc_rt_pow_f32(float base, float exponent) {
+    return (float)pow(base, exponent);
+}
+
+// element k of an array of a fixed width type or of fps, as an int64_t for
+// the ints and a double for the others
+static inline int64_t nvc_rt_elem_i64(uint32_t type,
+                                      const void* p,
+                                      uint64_t k) {
+    return type == NVC_RT_I32 ? ((const int32_t*)p)[k]
+                              : ((const int64_t*)p)[k];
+}
+
+static inline double nvc_rt_elem_fp(uint32_t type,
+                                     const void* p,
+                                     uint64_t k) {
+    return type == NVC_RT_F32 ? ((const float*)p)[k] : ((const double*)p)[k];
+}
+
+// the arithmetic of the array helpers on the fixed width numbers that
+// nvc_simd.h has no kernels for, the switches are outside the loops so the
+// compiler vectorizes them. i64s only need division and power here
+static void nvc_rt_vec_i64(uint32_t op,
+                           int64_t* out,
+                           const int64_t* a,
+                           const int64_t* b,
+                           uint64_t n) {
+    if (op == NVC_RT_DIV) {
+        for (uint64_t k = 0; k < n; ++k) out[k] = nvc_rt_div_i64(a[k], b[k]);
+        return;
+    }
+    for (uint64_t k = 0; k < n; ++k) out[k] = nvc_rt_pow_i64(a[k], b[k]);
+}
+
+static void nvc_rt_vec_i32(uint32_t op,
+                           int32_t* out,
+                           const int32_t* a,
+                           const int32_t* b,
+                           uint64_t n) {
+    switch (op) {
+        case NVC_RT_ADD:
+            for (uint64_t k = 0; k < n; ++k)
+                out[k] = (int32_t)nvc_wrap_i32((int64_t)a[k] + b[k]);
+            break;
+        case NVC_RT_SUB:
+            for (uint64_t k = 0; k < n; ++k)
+                out[k] = (int32_t)nvc_wrap_i32((int64_t)a[k] - b[k]);
+            break;
+        case NVC_RT_MUL:
+            for (uint64_t k = 0; k < n; ++k)
+                out[k] = (int32_t)nvc_wrap_i32((int64_t)a[k] * b[k]);
+            break;
+        case NVC_RT_DIV:
+            for (uint64_t k = 0; k < n; ++k)
+                out[k] = (int32_t)nvc_wrap_i32(nvc_rt_div_i64(a[k], b[k]));
+            break;
+        default:
+            for (uint64_t k = 0; k < n; ++k)
+                out[k] = (int32_t)nvc_wrap_i32(nvc_rt_pow_i64(a[k], b[k]));
+            break;
+    }
+}
+
+static void nvc_rt_vec_f32(uint32_t op,
+                           float* out,
+                           const float* a,
+                           const float* b,
+                           uint64_t n) {
+    switch (op) {
+        case NVC_RT_ADD:
+            for (uint64_t k = 0; k < n; ++k) out[k] = a[k] + b[k];
+            break;
+        case NVC_RT_SUB:
+            for (uint64_t k = 0; k < n; ++k) out[k] = a[k] - b[k];
+            break;
+        case NVC_RT_MUL:
+            for (uint64_t k = 0; k < n; ++k) out[k] = a[k] * b[k];
+            break;
+        case NVC_RT_DIV:
+            for (uint64_t k = 0; k < n; ++k) out[k] = a[k] / b[k];
+            break;
+        default:
+            for (uint64_t k = 0; k < n; ++k)
+                out[k] = nvc_rt_pow_f32(a[k], b[k]);
+            break;
+    }
+}
+
+// the comparisons of i32s and f32s, like the arithmetic above
+static void nvc_rt_compare_i32(uint32_t op,
+                               uint8_t* out,
+                               const int32_t* a,
+                               const int32_t* b,
+                               uint64_t n) {
+    switch (op) {
+        case NVC_RT_LT:
+            for (uint64_t k = 0; k < n; ++k) out[k] = a[k] < b[k];
+            break;
+        case NVC_RT_LE:
+            for (uint64_t k = 0; k < n; ++k) out[k] = a[k] <= b[k];
+            break;
+        case NVC_RT_GT:
+            for (uint64_t k = 0; k < n; ++k) out[k] = a[k] > b[k];
+            break;
+        default:
+            for (uint64_t k = 0; k < n; ++k) out[k] = a[k] >= b[k];
+            break;
+    }
+}
+
+static void nvc_rt_compare_f32(uint32_t op,
+                               uint8_t* out,
+                               const float* a,
+                               const float* b,
+                               uint64_t n) {
+    switch (op) {
+        case NVC_RT_LT:
+            for (uint64_t k = 0; k < n; ++k) out[k] = a[k] < b[k];
+            break;
+        case NVC_RT_LE:
+            for (uint64_t k = 0; k < n; ++k) out[k] = a[k] <= b[k];
+            break;
+        case NVC_RT_GT:
+            for (uint64_t k = 0; k < n; ++k) out[k] = a[k] > b[k];
+            break;
+        default:
+            for (uint64_t k = 0; k < n; ++k) out[k] = a[k] >= b[k];
+            break;
+    }
+}
+
+// whether op holds for operands of the order of nvc_rt_int_compare
+static bool nvc_rt_compare_order(uint32_t op, int order) {
+    switch (op) {
+        case NVC_RT_LT: return order < 0;
+        case NVC_RT_LE: return order <= 0;
+        case NVC_RT_GT: return order > 0;
+        default: return order >= 0;
+    }
+}
+
+// the nvc_simd.h kernel of op, the arithmetic ops have the same values and
+// the comparisons follow pow in nvc_rt_op_t
+static nvc_simd_op_t nvc_rt_simd_op(uint32_t op) {
+    return op >= NVC_RT_LT ? (nvc_simd_op_t)(op - 1) : (nvc_simd_op_t)op;
+}
+
+void nvc_rt_vec_binary(uint32_t op,
+                       uint32_t type,
+                       void* dst,
+                       const void* lhs,
+                       const void* rhs,
+                       uint64_t n) {
+    // note: i64s and fps run the kernels of nvc_simd.h picked for the cpu,
+    // ints are tagged (and may be big) so they go one at a time
+    if (op >= NVC_RT_LT && op <= NVC_RT_GE) {
+        switch (type) {
+            case NVC_RT_I64:
+                nvc_simd_i64_compare(nvc_rt_simd_op(op), dst, lhs, rhs, n);
+                return;
+            case NVC_RT_FP:
+                nvc_simd_f64_compare(nvc_rt_simd_op(op), dst, lhs, rhs, n);
+                return;
+            case NVC_RT_I32: nvc_rt_compare_i32(op, dst, lhs, rhs, n); return;
+            case NVC_RT_F32: nvc_rt_compare_f32(op, dst, lhs, rhs, n); return;
+            default: break;
+        }
+        uint8_t* out = dst;
+        const nvc_rt_int_t* a = lhs;
+        const nvc_rt_int_t* b = rhs;
+        for (uint64_t k = 0; k < n; ++k)
+            out[k] = nvc_rt_compare_order(op, nvc_rt_int_compare(a[k], b[k]));
+        return;
+    }
+    switch (type) {
+        case NVC_RT_I64:
+            // note: division traps on 0 and power on negative exponents
+            if (op <= NVC_RT_MUL)
+                nvc_simd_i64(nvc_rt_simd_op(op), dst, lhs, rhs, n);
+            else
+                nvc_rt_vec_i64(op, dst, lhs, rhs, n);
+            return;
+        case NVC_RT_I32: nvc_rt_vec_i32(op, dst, lhs, rhs, n); return;
+        case NVC_RT_F32: nvc_rt_vec_f32(op, dst, lhs, rhs, n); return;
+        default: break;
+    }
+    if (type == NVC_RT_INT) {
+        nvc_rt_int_t* out = dst;
+        const nvc_rt_int_t* a = lhs;
+        const nvc_rt_int_t* b = rhs;
+        for (uint64_t k = 0; k < n; ++k)
+            out[k] = nvc_rt_int_binary(op, a[k], b[k]);
+        return;
+    }
+    if (op != NVC_RT_POW) {
+        nvc_simd_f64(nvc_rt_simd_op(op), dst, lhs, rhs, n);
+        return;
+    }
+    double* out = dst;
+    const double* a = lhs;
+    const double* b = rhs;
+    for (uint64_t k = 0; k < n; ++k) out[k] = pow(a[k], b[k]);
+}
+
+void nvc_rt_vec_unary(uint32_t op,
+                      uint32_t type,
+                      void* dst,
+                      const void* src,
+                      uint64_t n) {
+    switch (type) {
+        case NVC_RT_INT: {
+            const nvc_rt_int_t* a = src;
+            if (op == NVC_RT_ITOF) {
+                double* out = dst;
+                for (uint64_t k = 0; k < n; ++k)
+                    out[k] = nvc_rt_int_to_fp(a[k]);
+                break;
+            }
+            nvc_rt_int_t* out = dst;
+            if (op == NVC_RT_NEG) {
+                for (uint64_t k = 0; k < n; ++k) out[k] = nvc_rt_int_neg(a[k]);
+            } else {
+                for (uint64_t k = 0; k < n; ++k) out[k] = nvc_rt_int_not(a[k]);
+            }
+            break;
+        }
+        case NVC_RT_FP: {
+            double* out = dst;
+            const double* a = src;
+            for (uint64_t k = 0; k < n; ++k) out[k] = -a[k];
+            break;
+        }
+        case NVC_RT_F32: {
+            float* out = dst;
+            const float* a = src;
+            for (uint64_t k = 0; k < n; ++k) out[k] = -a[k];
+            break;
+        }
+        case NVC_RT_I32: {
+            int32_t* out = dst;
+            const int32_t* a = src;
+            if (op == NVC_RT_NEG) {
+                for (uint64_t k = 0; k < n; ++k)
+                    out[k] = (int32_t)nvc_wrap_i32(-(int64_t)a[k]);
+            } else {
+                for (uint64_t k = 0; k < n; ++k) out[k] = ~a[k];
+            }
+            break;
+        }
+        case NVC_RT_I64: {
+            int64_t* out = dst;
+            const int64_t* a = src;
+            if (op == NVC_RT_NEG) {
+                for (uint64_t k = 0; k < n; ++k) out[k] = nvc_wrap_sub(0, a[k]);
+            } else {
+                for (uint64_t k = 0; k < n; ++k) out[k] = ~a[k];
+            }
+            break;
+        }
+        default: {
+            uint8_t* out = dst;
+            const uint8_t* a = src;
+            for (uint64_t k = 0; k < n; ++k) out[k] = !a[k];
+            break;
+        }
+    }
+}
+
+void nvc_rt_vec_splat(uint32_t type, void* dst, uint64_t value, uint64_t n) {
+    if (type == NVC_RT_BOOL) {
+        memset(dst, value != 0, n);
+        return;
+    }
+    if (type == NVC_RT_I32 || type == NVC_RT_F32) {
+        uint32_t* out = dst;
+        for (uint64_t k = 0; k < n; ++k) out[k] = (uint32_t)value;
+        return;
+    }
+    uint64_t* out = dst;
+    for (uint64_t k = 0; k < n; ++k) out[k] = value;
+}
+
+void nvc_rt_vec_convert(uint32_t to,
+                        uint32_t from,
+                        void* dst,
+                        const void* src,
+                        uint64_t n) {
+    for (uint64_t k = 0; k < n; ++k) {
+        int64_t i = 0;
+        double fp = 0;
+        bool integral = true;
+        switch (from) {
+            case NVC_RT_INT: {
+                nvc_rt_int_t value = ((const nvc_rt_int_t*)src)[k];
+                // note: ints that are not small round once to double, like
+                // the folding does
+                if (to == NVC_RT_F32 && !nvc_rt_is_small(value)) {
+                    fp = nvc_rt_int_to_fp(value);
+                    integral = false;
+                } else {
+                    i = nvc_rt_int_wrap_i64(value);
+                }
+                break;
+            }
+            case NVC_RT_I32:
+            case NVC_RT_I64: i = nvc_rt_elem_i64(from, src, k); break;
+            default:
+                fp = nvc_rt_elem_fp(from, src, k);
+                integral = false;
+                break;
+        }
+        switch (to) {
+            case NVC_RT_INT:
+                ((nvc_rt_int_t*)dst)[k] = nvc_rt_int_from_i64(i);
+                break;
+            case NVC_RT_I32:
+                ((int32_t*)dst)[k] =
+                    (int32_t)(integral ? nvc_wrap_i32(i) : nvc_fp_to_i32(fp));
+                break;
+            case NVC_RT_I64:
+                ((int64_t*)dst)[k] = integral ? i : nvc_fp_to_i64(fp);
+                break;
+            case NVC_RT_F32:
+                ((float*)dst)[k] = (float)(integral ? nvc_int_to_f32(i) : fp);
+                break;
+            default:
+                ((double*)dst)[k] = integral ? (double)i : fp;
+                break;
+        }
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
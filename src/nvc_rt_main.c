@@ -0,0 +1,19 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nvc_rt.h>
+
+// note: kept apart from the helpers so a program with a main of its own can
+// still link libnvcrt.a, this file is only pulled in when main is missing
+// note: quoted, the assembler does not take a colon in a bare symbol name
+extern void nvc_rt_main_init(void) __asm__("\"main:init\"");
+
+int main(void) {
+    nvc_rt_main_init();
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,450 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nvc_sema.h>
+
+#include <nvc_ir.h>
+#include <nvc_layout.h>
+#include <nvc_symtab.h>
+
+#include <string.h>
+
+typedef struct {
+    nvc_sema_t* sema;
+    nvc_diagnostics_t* diags;
+    nvc_symtab_t table;
+    const nvc_sema_t* const* imports;
+    uint32_t n_imports;
+    nvc_ast_node_t** visible;  // import decls seen so far, in order
+    uint32_t n_visible;
+    bool unavailable_visible;  // true once an unavailable import was seen
+    bool out_of_memory;
+} nvc_resolver_t;
+
+static uint32_t nvc_add_decl(nvc_resolver_t* resolver,
+                             nvc_decl_kind_t kind,
+                             char* name,
+                             nvc_ast_node_t* node,
+                             uint32_t param_index) {
+    nvc_sema_t* sema = resolver->sema;
+    nvc_symtab_t* table = &resolver->table;
+
+    // warn about hiding a visible declaration
+    uint32_t prev = nvc_symtab_lookup(table, name);
+    if (prev != NVC_SYMTAB_NONE) {
+        nvc_decl_t* prev_decl = sema->decls + prev;
+        nvc_report(resolver->diags, NVC_SEVERITY_WARNING, &node->buf_loc,
+                   prev_decl->scope_depth == table->depth
+                       ? "redeclaration of '%s' shadows the previous "
+                         "declaration"
+                       : "declaration of '%s' shadows an outer declaration",
+                   name);
+        nvc_report(resolver->diags, NVC_SEVERITY_NOTE, &prev_decl->buf_loc,
+                   "previous declaration of '%s'", name);
+    }
+
+    // dynamic allocation
+    if (sema->n_decls >= sema->capacity) {
+        uint32_t capacity = sema->capacity ? (sema->capacity / 2) * 3 : 16;
+        nvc_decl_t* grown = nvc_realloc(sema->allocator, sema->decls,
+                                        capacity * sizeof(nvc_decl_t));
+        if (!grown) goto out_of_memory;
+        sema->decls = grown;
+        sema->capacity = capacity;
+    }
+    uint32_t index = sema->n_decls;
+    if (!nvc_symtab_bind(table, name, index)) goto out_of_memory;
+    nvc_decl_t* decl = sema->decls + sema->n_decls++;
+    decl->kind = kind;
+    decl->name = name;
+    decl->node = node;
+    decl->param_index = param_index;
+    decl->module = NULL;
+    decl->module_decl = 0;
+    decl->scope_depth = table->depth;
+    decl->n_refs = 0;
+    decl->value_type = 0;
+    decl->value_length = 0;
+    decl->value_layout = NULL;
+    decl->layout = NULL;
+    decl->buf_loc = node->buf_loc;
+    return index;
+out_of_memory:
+    resolver->out_of_memory = true;
+    return NVC_DECL_UNRESOLVED;
+}
+
+static void nvc_resolve_node(nvc_resolver_t* resolver, nvc_ast_node_t* node);
+
+static const nvc_sema_t* nvc_import_sema(nvc_resolver_t* resolver,
+                                         nvc_ast_node_t* import) {
+    uint32_t index = import->import_decl.index;
+    if (!resolver->imports || index >= resolver->n_imports) return NULL;
+    return resolver->imports[index];
+}
+
+// looks name up in the exports of the visible imports, the latest import
+// wins. a hit is declared in the current scope so later references find it
+// directly
+static uint32_t nvc_resolve_import(nvc_resolver_t* resolver, char* name) {
+    for (uint32_t i = resolver->n_visible; i-- > 0;) {
+        nvc_ast_node_t* import = resolver->visible[i];
+        const nvc_sema_t* module = nvc_import_sema(resolver, import);
+        if (!module) continue;
+        uint32_t module_decl = nvc_symtab_lookup(&module->exports, name);
+        if (module_decl == NVC_SYMTAB_NONE) continue;
+        uint32_t decl =
+            nvc_add_decl(resolver, NVC_DECL_IMPORT, name, import, 0);
+        if (decl == NVC_DECL_UNRESOLVED) return NVC_SYMTAB_NONE;
+        resolver->sema->decls[decl].module = module;
+        resolver->sema->decls[decl].module_decl = module_decl;
+        return decl;
+    }
+    return NVC_SYMTAB_NONE;
+}
+
+// the type decl a parameter or the return value of fun is declared with,
+// NVC_DECL_UNRESOLVED for builtin types and after reporting a bad one
+static uint32_t nvc_resolve_signature_type(nvc_resolver_t* resolver,
+                                           nvc_ast_node_t* node,
+                                           char* type_name) {
+    uint32_t builtin;
+    if (nvc_builtin_type(type_name, &builtin)) return NVC_DECL_UNRESOLVED;
+    uint32_t decl = nvc_symtab_lookup(&resolver->table, type_name);
+    if (decl == NVC_SYMTAB_NONE) decl = nvc_resolve_import(resolver, type_name);
+    if (decl == NVC_SYMTAB_NONE) {
+        if (!resolver->unavailable_visible && !resolver->out_of_memory)
+            nvc_report(resolver->diags, NVC_SEVERITY_ERROR, &node->buf_loc,
+                       "function '%s' uses the unknown type '%s'",
+                       node->fun_decl.fun_name, type_name);
+        return NVC_DECL_UNRESOLVED;
+    }
+    nvc_decl_t* target = resolver->sema->decls + decl;
+    if (target->kind == NVC_DECL_IMPORT)
+        target = target->module->decls + target->module_decl;
+    if (target->kind != NVC_DECL_TYPE) {
+        nvc_report(resolver->diags, NVC_SEVERITY_ERROR, &node->buf_loc,
+                   "function '%s' uses '%s' as a type but it is not one",
+                   node->fun_decl.fun_name, type_name);
+        nvc_report(resolver->diags, NVC_SEVERITY_NOTE, &target->buf_loc,
+                   "'%s' is declared here", type_name);
+        return NVC_DECL_UNRESOLVED;
+    }
+    ++resolver->sema->decls[decl].n_refs;
+    return decl;
+}
+
+static void nvc_resolve_fun(nvc_resolver_t* resolver, nvc_ast_node_t* node) {
+    nvc_ast_fun_decl_t* fun = &node->fun_decl;
+    for (uint32_t i = 0; i < fun->n_params; ++i) {
+        fun->params[i]->type_decl = nvc_resolve_signature_type(
+            resolver, node, fun->params[i]->type_name);
+    }
+    if (fun->return_type_name)
+        fun->return_type_decl = nvc_resolve_signature_type(
+            resolver, node, fun->return_type_name);
+    if (!nvc_symtab_push_scope(&resolver->table)) {
+        resolver->out_of_memory = true;
+        return;
+    }
+    for (uint32_t i = 0; i < fun->n_params; ++i) {
+        nvc_fun_param_decl_t* param = fun->params[i];
+        param->decl = nvc_add_decl(resolver, NVC_DECL_PARAM, param->param_name,
+                                   node, i);
+    }
+    for (uint32_t i = 0; i < fun->body_size; ++i) {
+        nvc_resolve_node(resolver, fun->body[i]);
+    }
+    nvc_symtab_pop_scope(&resolver->table);
+}
+
+// resolves the member types of a type decl, builtin types need no decl
+static void nvc_resolve_type(nvc_resolver_t* resolver, nvc_ast_node_t* node) {
+    nvc_ast_type_decl_t* type = &node->type_decl;
+    uint32_t builtin;
+    if (nvc_builtin_type(type->type_name, &builtin))
+        nvc_report(resolver->diags, NVC_SEVERITY_ERROR, &node->buf_loc,
+                   "type '%s' hides the builtin type", type->type_name);
+    for (uint32_t i = 0; i < type->n_members; ++i) {
+        nvc_type_member_decl_t* member = type->members[i];
+        member->decl = NVC_DECL_UNRESOLVED;
+        if (nvc_builtin_type(member->type_name, &builtin)) continue;
+        uint32_t decl =
+            nvc_symtab_lookup(&resolver->table, member->type_name);
+        if (decl == NVC_SYMTAB_NONE)
+            decl = nvc_resolve_import(resolver, member->type_name);
+        if (decl == NVC_SYMTAB_NONE) {
+            if (!resolver->unavailable_visible && !resolver->out_of_memory)
+                nvc_report(resolver->diags, NVC_SEVERITY_ERROR, &node->buf_loc,
+                           "member '%s' of type '%s' has the unknown type '%s'",
+                           member->member_name, type->type_name,
+                           member->type_name);
+            continue;
+        }
+        nvc_decl_t* target = resolver->sema->decls + decl;
+        if (target->kind == NVC_DECL_IMPORT)
+            target = target->module->decls + target->module_decl;
+        if (target->kind != NVC_DECL_TYPE) {
+            nvc_report(resolver->diags, NVC_SEVERITY_ERROR, &node->buf_loc,
+                       "member '%s' of type '%s' has the type '%s' which is "
+                       "not a type",
+                       member->member_name, type->type_name,
+                       member->type_name);
+            nvc_report(resolver->diags, NVC_SEVERITY_NOTE, &target->buf_loc,
+                       "'%s' is declared here", member->type_name);
+            continue;
+        }
+        member->decl = decl;
+        ++resolver->sema->decls[decl].n_refs;
+    }
+}
+
+static void nvc_resolve_node(nvc_resolver_t* resolver, nvc_ast_node_t* node) {
+    if (!node || resolver->out_of_memory) return;
+    switch (node->kind) {
+        case NVC_AST_NODE_SYMBOL_REF: {
+            uint32_t decl =
+                nvc_symtab_lookup(&resolver->table, node->symbol_ref.symbol);
+            if (decl == NVC_SYMTAB_NONE)
+                decl = nvc_resolve_import(resolver, node->symbol_ref.symbol);
+            if (decl == NVC_SYMTAB_NONE) {
+                if (!resolver->unavailable_visible && !resolver->out_of_memory)
+                    nvc_report(resolver->diags, NVC_SEVERITY_ERROR,
+                               &node->buf_loc, "use of undeclared symbol '%s'",
+                               node->symbol_ref.symbol);
+                node->symbol_ref.decl = NVC_DECL_UNRESOLVED;
+                break;
+            }
+            node->symbol_ref.decl = decl;
+            ++resolver->sema->decls[decl].n_refs;
+            break;
+        }
+        case NVC_AST_NODE_OP_CHAIN:
+            for (uint32_t i = 0; i < node->op_chain.n_elems; ++i) {
+                nvc_ast_chain_elem_t* elem = node->op_chain.elems[i];
+                if (elem->kind == NVC_CHAIN_ELEM_NODE)
+                    nvc_resolve_node(resolver, elem->node);
+            }
+            break;
+        case NVC_AST_NODE_ARRAY_LIT:
+            for (uint32_t i = 0; i < node->array_lit.n_elems; ++i) {
+                nvc_resolve_node(resolver, node->array_lit.elems[i]);
+            }
+            break;
+        case NVC_AST_NODE_INDEX:
+            nvc_resolve_node(resolver, node->index.base);
+            nvc_resolve_node(resolver, node->index.index);
+            break;
+        case NVC_AST_NODE_CALL: {
+            // note: a number type converts its argument, like in signatures
+            // and members the builtin type wins over any decl of its name
+            nvc_ast_node_t* callee = node->call.callee;
+            uint32_t builtin;
+            if (callee->kind == NVC_AST_NODE_SYMBOL_REF &&
+                nvc_builtin_type(callee->symbol_ref.symbol, &builtin) &&
+                nvc_ir_is_numeric((nvc_ir_type_t)builtin))
+                callee->symbol_ref.decl = NVC_DECL_UNRESOLVED;
+            else
+                nvc_resolve_node(resolver, callee);
+            for (uint32_t i = 0; i < node->call.n_args; ++i) {
+                nvc_resolve_node(resolver, node->call.args[i]);
+            }
+            break;
+        }
+        case NVC_AST_NODE_FIELD:
+            // note: the field is looked up in the type of the base once it
+            // is known, see nvc_lower_ast
+            nvc_resolve_node(resolver, node->field.base);
+            break;
+        case NVC_AST_NODE_FOR:
+        case NVC_AST_NODE_WHILE: {
+            // note: the bounds and the initial value are evaluated before
+            // the loop so they do not see its names
+            nvc_ast_loop_t* loop = &node->loop;
+            nvc_resolve_node(resolver, loop->start);
+            nvc_resolve_node(resolver, loop->end);
+            nvc_resolve_node(resolver, loop->init);
+            if (!nvc_symtab_push_scope(&resolver->table)) {
+                resolver->out_of_memory = true;
+                break;
+            }
+            if (loop->counter)
+                loop->counter_decl = nvc_add_decl(resolver, NVC_DECL_LOOP,
+                                                  loop->counter, node, 0);
+            loop->acc_decl =
+                nvc_add_decl(resolver, NVC_DECL_LOOP, loop->acc, node, 1);
+            nvc_resolve_node(resolver, loop->cond);
+            nvc_resolve_node(resolver, loop->body);
+            nvc_symtab_pop_scope(&resolver->table);
+            break;
+        }
+        case NVC_AST_NODE_LET_DECL:
+            // note: the rhs is resolved first so `let a = a + 1` refers to
+            // the previous a
+            nvc_resolve_node(resolver, node->let_decl.rhs);
+            node->let_decl.decl = nvc_add_decl(resolver, NVC_DECL_LET,
+                                               node->let_decl.symbol, node, 0);
+            break;
+        case NVC_AST_NODE_FUN_DECL:
+            // note: top level functions are declared up front
+            if (resolver->table.depth != 0) {
+                node->fun_decl.decl = nvc_add_decl(
+                    resolver, NVC_DECL_FUN, node->fun_decl.fun_name, node, 0);
+            }
+            // note: a lazy body waits until the function is referenced, see
+            // nvc_resolve_lazy_funs
+            node->fun_decl.scope = resolver->sema->n_decls;
+            if (!node->fun_decl.body_tokens) nvc_resolve_fun(resolver, node);
+            break;
+        case NVC_AST_NODE_TYPE_DECL: nvc_resolve_type(resolver, node); break;
+        case NVC_AST_NODE_IMPORT_DECL:
+            // note: the parser only accepts imports at the top level so
+            // visible has room for every one of them
+            resolver->visible[resolver->n_visible++] = node;
+            if (!nvc_import_sema(resolver, node))
+                resolver->unavailable_visible = true;
+            break;
+        default: break;
+    }
+}
+
+// parses and resolves the lazy bodies of the referenced functions. a body
+// sees what it would have seen where it is declared: the scope is rebuilt
+// from the top level decls up to fun_decl.scope (the functions come first,
+// they are declared up front) and the imports before it. a body can
+// reference more functions, even earlier ones, so this repeats until every
+// referenced body is resolved
+static void nvc_resolve_lazy_funs(nvc_resolver_t* outer, nvc_ast_t* ast) {
+    nvc_sema_t* sema = outer->sema;
+    for (bool again = true; again && !outer->out_of_memory;) {
+        again = false;
+        nvc_resolver_t resolver = {
+            .sema = sema,
+            .diags = outer->diags,
+            .imports = outer->imports,
+            .n_imports = outer->n_imports,
+            .visible = outer->visible,
+        };
+        if (!nvc_symtab_init(&resolver.table, sema->allocator, ast->size)) {
+            outer->out_of_memory = true;
+            return;
+        }
+        uint32_t n_bound = 0;
+        for (uint32_t i = 0; i < ast->size && !resolver.out_of_memory; ++i) {
+            nvc_ast_node_t* node = ast->nodes[i];
+            if (node->kind == NVC_AST_NODE_IMPORT_DECL) {
+                nvc_resolve_node(&resolver, node);
+                continue;
+            }
+            if (node->kind != NVC_AST_NODE_FUN_DECL ||
+                !node->fun_decl.body_tokens ||
+                node->fun_decl.decl == NVC_DECL_UNRESOLVED ||
+                !sema->decls[node->fun_decl.decl].n_refs)
+                continue;
+            for (; n_bound < node->fun_decl.scope; ++n_bound) {
+                nvc_decl_t* decl = sema->decls + n_bound;
+                if (decl->scope_depth == 0 &&
+                    !nvc_symtab_bind(&resolver.table, decl->name, n_bound))
+                    resolver.out_of_memory = true;
+            }
+            // note: a body with a syntax error stays empty, the error is
+            // reported and it is not parsed again
+            nvc_parse_fun_body(ast, resolver.diags, node);
+            nvc_resolve_fun(&resolver, node);
+            again = true;
+        }
+        nvc_symtab_free(&resolver.table);
+        outer->out_of_memory |= resolver.out_of_memory;
+    }
+}
+
+nvc_sema_t* nvc_resolve(nvc_allocator_t* allocator,
+                        nvc_diagnostics_t* diags,
+                        nvc_ast_t* ast,
+                        const nvc_sema_t* const* imports,
+                        uint32_t n_imports) {
+    nvc_sema_t* sema = nvc_calloc(allocator, 1, sizeof(nvc_sema_t));
+    if (!sema) goto out_of_memory;
+    sema->allocator = allocator;
+
+    nvc_resolver_t resolver = {
+        .sema = sema,
+        .diags = diags,
+        .imports = imports,
+        .n_imports = n_imports,
+    };
+    resolver.visible =
+        nvc_alloc(allocator, ast->n_imports * sizeof(nvc_ast_node_t*));
+    if (!resolver.visible) {
+        nvc_free_sema(sema);
+        goto out_of_memory;
+    }
+    if (!nvc_symtab_init(&resolver.table, allocator, ast->size)) {
+        nvc_free(allocator, resolver.visible);
+        nvc_free_sema(sema);
+        goto out_of_memory;
+    }
+
+    // functions and types are visible in the whole module so they can be
+    // used before their declaration and recursively
+    for (uint32_t i = 0; i < ast->size; ++i) {
+        nvc_ast_node_t* node = ast->nodes[i];
+        if (node->kind == NVC_AST_NODE_FUN_DECL) {
+            node->fun_decl.decl = nvc_add_decl(
+                &resolver, NVC_DECL_FUN, node->fun_decl.fun_name, node, 0);
+        } else if (node->kind == NVC_AST_NODE_TYPE_DECL) {
+            node->type_decl.decl = nvc_add_decl(
+                &resolver, NVC_DECL_TYPE, node->type_decl.type_name, node, 0);
+        }
+    }
+    for (uint32_t i = 0; i < ast->size; ++i) {
+        nvc_resolve_node(&resolver, ast->nodes[i]);
+    }
+    nvc_resolve_lazy_funs(&resolver, ast);
+
+    nvc_symtab_free(&resolver.table);
+    nvc_free(allocator, resolver.visible);
+    if (resolver.out_of_memory || !nvc_layout_types(sema, diags)) {
+        nvc_free_sema(sema);
+        goto out_of_memory;
+    }
+
+    // publish the top level declarations, later ones hide earlier ones with
+    // the same name like they do inside the module
+    if (!nvc_symtab_init(&sema->exports, allocator, sema->n_decls)) {
+        nvc_free_sema(sema);
+        goto out_of_memory;
+    }
+    for (uint32_t i = 0; i < sema->n_decls; ++i) {
+        nvc_decl_t* decl = sema->decls + i;
+        if (decl->scope_depth != 0 ||
+            (decl->kind != NVC_DECL_LET && decl->kind != NVC_DECL_FUN &&
+             decl->kind != NVC_DECL_TYPE))
+            continue;
+        if (!nvc_symtab_bind(&sema->exports, decl->name, i)) {
+            nvc_free_sema(sema);
+            goto out_of_memory;
+        }
+    }
+    return sema;
+out_of_memory:
+    nvc_report(diags, NVC_SEVERITY_ERROR, NULL, "out of memory");
+    return NULL;
+}
+
+void nvc_free_sema(nvc_sema_t* sema) {
+    if (sema) {
+        for (uint32_t i = 0; i < sema->n_decls; ++i) {
+            if (sema->decls[i].kind == NVC_DECL_TYPE)
+                nvc_free_layout(sema->allocator, sema->decls[i].layout);
+        }
+        nvc_symtab_free(&sema->exports);
+        nvc_free(sema->allocator, sema->decls);
+        nvc_free(sema->allocator, sema);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
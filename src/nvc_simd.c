@@ -0,0 +1,400 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nvc_simd.h>
+
+#include <stdatomic.h>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define NVC_SIMD_X86 1
+#include <immintrin.h>
+#else
+#define NVC_SIMD_X86 0
+#endif
+
+typedef void (*nvc_f64_kernel_t)(double*, const double*, const double*, size_t);
+typedef void (*nvc_i64_kernel_t)(int64_t*,
+                                 const int64_t*,
+                                 const int64_t*,
+                                 size_t);
+typedef void (*nvc_f64_compare_kernel_t)(uint8_t*,
+                                         const double*,
+                                         const double*,
+                                         size_t);
+typedef void (*nvc_i64_compare_kernel_t)(uint8_t*,
+                                         const int64_t*,
+                                         const int64_t*,
+                                         size_t);
+typedef size_t (*nvc_ascii_kernel_t)(const char*, size_t);
+
+// scalar kernels, the vector ones use them for the elements left over after
+// the last whole vector
+#define NVC_SCALAR_KERNEL(name, dst_type, type, expr)  \
+    static void name(dst_type* dst, const type* a,     \
+                     const type* b, size_t n) {        \
+        for (size_t i = 0; i < n; ++i) dst[i] = expr;  \
+    }
+
+// note: ints wrap around, computed unsigned to avoid signed overflow
+NVC_SCALAR_KERNEL(nvc_f64_add_scalar, double, double, a[i] + b[i])
+NVC_SCALAR_KERNEL(nvc_f64_sub_scalar, double, double, a[i] - b[i])
+NVC_SCALAR_KERNEL(nvc_f64_mul_scalar, double, double, a[i] * b[i])
+NVC_SCALAR_KERNEL(nvc_f64_div_scalar, double, double, a[i] / b[i])
+NVC_SCALAR_KERNEL(nvc_i64_add_scalar, int64_t, int64_t,
+                  (int64_t)((uint64_t)a[i] + (uint64_t)b[i]))
+NVC_SCALAR_KERNEL(nvc_i64_sub_scalar, int64_t, int64_t,
+                  (int64_t)((uint64_t)a[i] - (uint64_t)b[i]))
+NVC_SCALAR_KERNEL(nvc_i64_mul_scalar, int64_t, int64_t,
+                  (int64_t)((uint64_t)a[i] * (uint64_t)b[i]))
+NVC_SCALAR_KERNEL(nvc_f64_lt_scalar, uint8_t, double, a[i] < b[i])
+NVC_SCALAR_KERNEL(nvc_f64_le_scalar, uint8_t, double, a[i] <= b[i])
+NVC_SCALAR_KERNEL(nvc_f64_gt_scalar, uint8_t, double, a[i] > b[i])
+NVC_SCALAR_KERNEL(nvc_f64_ge_scalar, uint8_t, double, a[i] >= b[i])
+NVC_SCALAR_KERNEL(nvc_i64_lt_scalar, uint8_t, int64_t, a[i] < b[i])
+NVC_SCALAR_KERNEL(nvc_i64_le_scalar, uint8_t, int64_t, a[i] <= b[i])
+NVC_SCALAR_KERNEL(nvc_i64_gt_scalar, uint8_t, int64_t, a[i] > b[i])
+NVC_SCALAR_KERNEL(nvc_i64_ge_scalar, uint8_t, int64_t, a[i] >= b[i])
+
+// note: eight bytes at a time, the high bit of every byte is set in the mask
+static size_t nvc_ascii_prefix_scalar(const char* s, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t word;
+        memcpy(&word, s + i, sizeof(word));
+        if (word & 0x8080808080808080ull) break;
+    }
+    while (i < n && !(s[i] & 0x80)) ++i;
+    return i;
+}
+
+#if NVC_SIMD_X86
+
+// note: the vector kernels are compiled for their instruction set through
+// target attributes, the rest of the compiler keeps the baseline one so it
+// runs on any cpu. only the dispatch below decides which ones are called
+
+#define NVC_VECTOR_KERNEL(name, isa, type, vec, width, load, store, op, tail) \
+    __attribute__((target(isa))) static void name(                          \
+        type* dst, const type* a, const type* b, size_t n) {                 \
+        size_t i = 0;                                                         \
+        for (; i + (width) <= n; i += (width)) {                              \
+            vec va = load(a + i);                                             \
+            vec vb = load(b + i);                                             \
+            store(dst + i, op(va, vb));                                       \
+        }                                                                     \
+        tail(dst + i, a + i, b + i, n - i);                                   \
+    }
+
+// comparisons produce all ones lanes, movemask packs them into the low bits
+// of an int which are spread to one byte per element
+#define NVC_COMPARE_KERNEL(name, isa, type, vec, width, load, cmp, movemask, \
+                           tail)                                             \
+    __attribute__((target(isa))) static void name(                         \
+        uint8_t* dst, const type* a, const type* b, size_t n) {             \
+        size_t i = 0;                                                        \
+        for (; i + (width) <= n; i += (width)) {                             \
+            vec va = load(a + i);                                            \
+            vec vb = load(b + i);                                            \
+            int mask = movemask(cmp(va, vb));                                \
+            for (int j = 0; j < (width); ++j) dst[i + j] = (mask >> j) & 1;  \
+        }                                                                    \
+        tail(dst + i, a + i, b + i, n - i);                                  \
+    }
+
+#define NVC_LOAD_PD128(p) _mm_loadu_pd(p)
+#define NVC_STORE_PD128(p, v) _mm_storeu_pd(p, v)
+#define NVC_LOAD_PD256(p) _mm256_loadu_pd(p)
+#define NVC_STORE_PD256(p, v) _mm256_storeu_pd(p, v)
+#define NVC_LOAD_SI128(p) _mm_loadu_si128((const __m128i*)(p))
+#define NVC_STORE_SI128(p, v) _mm_storeu_si128((__m128i*)(p), v)
+#define NVC_LOAD_SI256(p) _mm256_loadu_si256((const __m256i*)(p))
+#define NVC_STORE_SI256(p, v) _mm256_storeu_si256((__m256i*)(p), v)
+
+// there is no 64 bit multiply before AVX-512, the low 64 bits of the product
+// are lo(a) * lo(b) + ((hi(a) * lo(b) + lo(a) * hi(b)) << 32)
+__attribute__((target("sse2"))) static inline __m128i nvc_mullo_epi64_sse2(
+    __m128i a,
+    __m128i b) {
+    __m128i cross = _mm_add_epi64(_mm_mul_epu32(_mm_srli_epi64(a, 32), b),
+                                  _mm_mul_epu32(a, _mm_srli_epi64(b, 32)));
+    return _mm_add_epi64(_mm_mul_epu32(a, b), _mm_slli_epi64(cross, 32));
+}
+
+__attribute__((target("avx2"))) static inline __m256i nvc_mullo_epi64_avx2(
+    __m256i a,
+    __m256i b) {
+    __m256i cross =
+        _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+                         _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+    return _mm256_add_epi64(_mm256_mul_epu32(a, b),
+                            _mm256_slli_epi64(cross, 32));
+}
+
+#define NVC_CMP_LT_PD256(a, b) _mm256_cmp_pd(a, b, _CMP_LT_OQ)
+#define NVC_CMP_LE_PD256(a, b) _mm256_cmp_pd(a, b, _CMP_LE_OQ)
+#define NVC_CMP_GT_PD256(a, b) _mm256_cmp_pd(a, b, _CMP_GT_OQ)
+#define NVC_CMP_GE_PD256(a, b) _mm256_cmp_pd(a, b, _CMP_GE_OQ)
+// note: AVX2 only has a signed greater than for 64 bit lanes
+#define NVC_CMP_LT_EPI64(a, b) _mm256_cmpgt_epi64(b, a)
+#define NVC_CMP_GT_EPI64(a, b) _mm256_cmpgt_epi64(a, b)
+#define NVC_CMP_LE_EPI64(a, b) \
+    _mm256_xor_si256(_mm256_cmpgt_epi64(a, b), _mm256_set1_epi64x(-1))
+#define NVC_CMP_GE_EPI64(a, b) \
+    _mm256_xor_si256(_mm256_cmpgt_epi64(b, a), _mm256_set1_epi64x(-1))
+#define NVC_MOVEMASK_EPI64(v) _mm256_movemask_pd(_mm256_castsi256_pd(v))
+
+// SSE2, two lanes
+NVC_VECTOR_KERNEL(nvc_f64_add_sse2, "sse2", double, __m128d, 2,
+                  NVC_LOAD_PD128, NVC_STORE_PD128, _mm_add_pd,
+                  nvc_f64_add_scalar)
+NVC_VECTOR_KERNEL(nvc_f64_sub_sse2, "sse2", double, __m128d, 2,
+                  NVC_LOAD_PD128, NVC_STORE_PD128, _mm_sub_pd,
+                  nvc_f64_sub_scalar)
+NVC_VECTOR_KERNEL(nvc_f64_mul_sse2, "sse2", double, __m128d, 2,
+                  NVC_LOAD_PD128, NVC_STORE_PD128, _mm_mul_pd,
+                  nvc_f64_mul_scalar)
+NVC_VECTOR_KERNEL(nvc_f64_div_sse2, "sse2", double, __m128d, 2,
+                  NVC_LOAD_PD128, NVC_STORE_PD128, _mm_div_pd,
+                  nvc_f64_div_scalar)
+NVC_VECTOR_KERNEL(nvc_i64_add_sse2, "sse2", int64_t, __m128i, 2,
+                  NVC_LOAD_SI128, NVC_STORE_SI128, _mm_add_epi64,
+                  nvc_i64_add_scalar)
+NVC_VECTOR_KERNEL(nvc_i64_sub_sse2, "sse2", int64_t, __m128i, 2,
+                  NVC_LOAD_SI128, NVC_STORE_SI128, _mm_sub_epi64,
+                  nvc_i64_sub_scalar)
+NVC_VECTOR_KERNEL(nvc_i64_mul_sse2, "sse2", int64_t, __m128i, 2,
+                  NVC_LOAD_SI128, NVC_STORE_SI128, nvc_mullo_epi64_sse2,
+                  nvc_i64_mul_scalar)
+NVC_COMPARE_KERNEL(nvc_f64_lt_sse2, "sse2", double, __m128d, 2,
+                   NVC_LOAD_PD128, _mm_cmplt_pd, _mm_movemask_pd,
+                   nvc_f64_lt_scalar)
+NVC_COMPARE_KERNEL(nvc_f64_le_sse2, "sse2", double, __m128d, 2,
+                   NVC_LOAD_PD128, _mm_cmple_pd, _mm_movemask_pd,
+                   nvc_f64_le_scalar)
+NVC_COMPARE_KERNEL(nvc_f64_gt_sse2, "sse2", double, __m128d, 2,
+                   NVC_LOAD_PD128, _mm_cmpgt_pd, _mm_movemask_pd,
+                   nvc_f64_gt_scalar)
+NVC_COMPARE_KERNEL(nvc_f64_ge_sse2, "sse2", double, __m128d, 2,
+                   NVC_LOAD_PD128, _mm_cmpge_pd, _mm_movemask_pd,
+                   nvc_f64_ge_scalar)
+
+// AVX, four fp lanes (the int ones need AVX2)
+NVC_VECTOR_KERNEL(nvc_f64_add_avx, "avx", double, __m256d, 4,
+                  NVC_LOAD_PD256, NVC_STORE_PD256, _mm256_add_pd,
+                  nvc_f64_add_scalar)
+NVC_VECTOR_KERNEL(nvc_f64_sub_avx, "avx", double, __m256d, 4,
+                  NVC_LOAD_PD256, NVC_STORE_PD256, _mm256_sub_pd,
+                  nvc_f64_sub_scalar)
+NVC_VECTOR_KERNEL(nvc_f64_mul_avx, "avx", double, __m256d, 4,
+                  NVC_LOAD_PD256, NVC_STORE_PD256, _mm256_mul_pd,
+                  nvc_f64_mul_scalar)
+NVC_VECTOR_KERNEL(nvc_f64_div_avx, "avx", double, __m256d, 4,
+                  NVC_LOAD_PD256, NVC_STORE_PD256, _mm256_div_pd,
+                  nvc_f64_div_scalar)
+NVC_COMPARE_KERNEL(nvc_f64_lt_avx, "avx", double, __m256d, 4,
+                   NVC_LOAD_PD256, NVC_CMP_LT_PD256, _mm256_movemask_pd,
+                   nvc_f64_lt_scalar)
+NVC_COMPARE_KERNEL(nvc_f64_le_avx, "avx", double, __m256d, 4,
+                   NVC_LOAD_PD256, NVC_CMP_LE_PD256, _mm256_movemask_pd,
+                   nvc_f64_le_scalar)
+NVC_COMPARE_KERNEL(nvc_f64_gt_avx, "avx", double, __m256d, 4,
+                   NVC_LOAD_PD256, NVC_CMP_GT_PD256, _mm256_movemask_pd,
+                   nvc_f64_gt_scalar)
+NVC_COMPARE_KERNEL(nvc_f64_ge_avx, "avx", double, __m256d, 4,
+                   NVC_LOAD_PD256, NVC_CMP_GE_PD256, _mm256_movemask_pd,
+                   nvc_f64_ge_scalar)
+
+// AVX2, four int lanes
+NVC_VECTOR_KERNEL(nvc_i64_add_avx2, "avx2", int64_t, __m256i, 4,
+                  NVC_LOAD_SI256, NVC_STORE_SI256, _mm256_add_epi64,
+                  nvc_i64_add_scalar)
+NVC_VECTOR_KERNEL(nvc_i64_sub_avx2, "avx2", int64_t, __m256i, 4,
+                  NVC_LOAD_SI256, NVC_STORE_SI256, _mm256_sub_epi64,
+                  nvc_i64_sub_scalar)
+NVC_VECTOR_KERNEL(nvc_i64_mul_avx2, "avx2", int64_t, __m256i, 4,
+                  NVC_LOAD_SI256, NVC_STORE_SI256, nvc_mullo_epi64_avx2,
+                  nvc_i64_mul_scalar)
+NVC_COMPARE_KERNEL(nvc_i64_lt_avx2, "avx2", int64_t, __m256i, 4,
+                   NVC_LOAD_SI256, NVC_CMP_LT_EPI64, NVC_MOVEMASK_EPI64,
+                   nvc_i64_lt_scalar)
+NVC_COMPARE_KERNEL(nvc_i64_le_avx2, "avx2", int64_t, __m256i, 4,
+                   NVC_LOAD_SI256, NVC_CMP_LE_EPI64, NVC_MOVEMASK_EPI64,
+                   nvc_i64_le_scalar)
+NVC_COMPARE_KERNEL(nvc_i64_gt_avx2, "avx2", int64_t, __m256i, 4,
+                   NVC_LOAD_SI256, NVC_CMP_GT_EPI64, NVC_MOVEMASK_EPI64,
+                   nvc_i64_gt_scalar)
+NVC_COMPARE_KERNEL(nvc_i64_ge_avx2, "avx2", int64_t, __m256i, 4,
+                   NVC_LOAD_SI256, NVC_CMP_GE_EPI64, NVC_MOVEMASK_EPI64,
+                   nvc_i64_ge_scalar)
+
+// movemask gathers the high bit of every byte, the first set one is the first
+// non-ASCII byte
+__attribute__((target("sse2"))) static size_t nvc_ascii_prefix_sse2(
+    const char* s,
+    size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        int mask = _mm_movemask_epi8(NVC_LOAD_SI128(s + i));
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    return i + nvc_ascii_prefix_scalar(s + i, n - i);
+}
+
+__attribute__((target("avx2"))) static size_t nvc_ascii_prefix_avx2(
+    const char* s,
+    size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        unsigned mask = _mm256_movemask_epi8(NVC_LOAD_SI256(s + i));
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    return i + nvc_ascii_prefix_sse2(s + i, n - i);
+}
+
+#endif  // NVC_SIMD_X86
+
+typedef struct {
+    nvc_f64_kernel_t f64[4];  // indexed by nvc_simd_op_t
+    nvc_i64_kernel_t i64[3];
+    nvc_f64_compare_kernel_t f64_compare[4];  // indexed by op - NVC_SIMD_LT
+    nvc_i64_compare_kernel_t i64_compare[4];
+    nvc_ascii_kernel_t ascii_prefix;
+} nvc_simd_kernels_t;
+
+// note: a level without a kernel for something uses the one of the level
+// below, e.g. SSE2 has no 64 bit compare (pcmpgtq is SSE4.2)
+static const nvc_simd_kernels_t nvc_simd_tables[] = {
+    [NVC_SIMD_SCALAR] =
+        {
+            .f64 = {nvc_f64_add_scalar, nvc_f64_sub_scalar,
+                    nvc_f64_mul_scalar, nvc_f64_div_scalar},
+            .i64 = {nvc_i64_add_scalar, nvc_i64_sub_scalar,
+                    nvc_i64_mul_scalar},
+            .f64_compare = {nvc_f64_lt_scalar, nvc_f64_le_scalar,
+                            nvc_f64_gt_scalar, nvc_f64_ge_scalar},
+            .i64_compare = {nvc_i64_lt_scalar, nvc_i64_le_scalar,
+                            nvc_i64_gt_scalar, nvc_i64_ge_scalar},
+            .ascii_prefix = nvc_ascii_prefix_scalar,
+        },
+#if NVC_SIMD_X86
+    [NVC_SIMD_SSE2] =
+        {
+            .f64 = {nvc_f64_add_sse2, nvc_f64_sub_sse2, nvc_f64_mul_sse2,
+                    nvc_f64_div_sse2},
+            .i64 = {nvc_i64_add_sse2, nvc_i64_sub_sse2, nvc_i64_mul_sse2},
+            .f64_compare = {nvc_f64_lt_sse2, nvc_f64_le_sse2, nvc_f64_gt_sse2,
+                            nvc_f64_ge_sse2},
+            .i64_compare = {nvc_i64_lt_scalar, nvc_i64_le_scalar,
+                            nvc_i64_gt_scalar, nvc_i64_ge_scalar},
+            .ascii_prefix = nvc_ascii_prefix_sse2,
+        },
+    [NVC_SIMD_AVX] =
+        {
+            .f64 = {nvc_f64_add_avx, nvc_f64_sub_avx, nvc_f64_mul_avx,
+                    nvc_f64_div_avx},
+            .i64 = {nvc_i64_add_sse2, nvc_i64_sub_sse2, nvc_i64_mul_sse2},
+            .f64_compare = {nvc_f64_lt_avx, nvc_f64_le_avx, nvc_f64_gt_avx,
+                            nvc_f64_ge_avx},
+            .i64_compare = {nvc_i64_lt_scalar, nvc_i64_le_scalar,
+                            nvc_i64_gt_scalar, nvc_i64_ge_scalar},
+            .ascii_prefix = nvc_ascii_prefix_sse2,
+        },
+    [NVC_SIMD_AVX2] =
+        {
+            .f64 = {nvc_f64_add_avx, nvc_f64_sub_avx, nvc_f64_mul_avx,
+                    nvc_f64_div_avx},
+            .i64 = {nvc_i64_add_avx2, nvc_i64_sub_avx2, nvc_i64_mul_avx2},
+            .f64_compare = {nvc_f64_lt_avx, nvc_f64_le_avx, nvc_f64_gt_avx,
+                            nvc_f64_ge_avx},
+            .i64_compare = {nvc_i64_lt_avx2, nvc_i64_le_avx2,
+                            nvc_i64_gt_avx2, nvc_i64_ge_avx2},
+            .ascii_prefix = nvc_ascii_prefix_avx2,
+        },
+#endif
+};
+
+// note: -1 until the first kernel runs. every thread detects the same level
+// so two threads racing here only detect it twice
+static atomic_int nvc_simd_active = -1;
+
+static nvc_simd_level_t nvc_simd_detect(void) {
+#if NVC_SIMD_X86
+    __builtin_cpu_init();
+    // note: these also check that the os saves the ymm registers
+    if (__builtin_cpu_supports("avx2")) return NVC_SIMD_AVX2;
+    if (__builtin_cpu_supports("avx")) return NVC_SIMD_AVX;
+    if (__builtin_cpu_supports("sse2")) return NVC_SIMD_SSE2;
+#endif
+    return NVC_SIMD_SCALAR;
+}
+
+nvc_simd_level_t nvc_simd_level(void) {
+    int level = atomic_load_explicit(&nvc_simd_active, memory_order_relaxed);
+    if (level < 0) {
+        level = nvc_simd_detect();
+        atomic_store_explicit(&nvc_simd_active, level, memory_order_relaxed);
+    }
+    return (nvc_simd_level_t)level;
+}
+
+nvc_simd_level_t nvc_simd_limit(nvc_simd_level_t level) {
+    nvc_simd_level_t supported = nvc_simd_detect();
+    if (level > supported) level = supported;
+    atomic_store_explicit(&nvc_simd_active, level, memory_order_relaxed);
+    return level;
+}
+
+const char* nvc_simd_level_to_str(nvc_simd_level_t level) {
+    switch (level) {
+        case NVC_SIMD_SCALAR: return "scalar";
+        case NVC_SIMD_SSE2: return "sse2";
+        case NVC_SIMD_AVX: return "avx";
+        case NVC_SIMD_AVX2: return "avx2";
+    }
+    return "unknown";
+}
+
+void nvc_simd_f64(nvc_simd_op_t op,
+                  double* dst,
+                  const double* a,
+                  const double* b,
+                  size_t n) {
+    nvc_simd_tables[nvc_simd_level()].f64[op](dst, a, b, n);
+}
+
+void nvc_simd_i64(nvc_simd_op_t op,
+                  int64_t* dst,
+                  const int64_t* a,
+                  const int64_t* b,
+                  size_t n) {
+    nvc_simd_tables[nvc_simd_level()].i64[op](dst, a, b, n);
+}
+
+void nvc_simd_f64_compare(nvc_simd_op_t op,
+                          uint8_t* dst,
+                          const double* a,
+                          const double* b,
+                          size_t n) {
+    nvc_simd_tables[nvc_simd_level()].f64_compare[op - NVC_SIMD_LT](dst, a, b,
+                                                                     n);
+}
+
+void nvc_simd_i64_compare(nvc_simd_op_t op,
+                          uint8_t* dst,
+                          const int64_t* a,
+                          const int64_t* b,
+                          size_t n) {
+    nvc_simd_tables[nvc_simd_level()].i64_compare[op - NVC_SIMD_LT](dst, a, b,
+                                                                     n);
+}
+
+size_t nvc_simd_ascii_prefix(const char* s, size_t n) {
+    return nvc_simd_tables[nvc_simd_level()].ascii_prefix(s, n);
+}
+
+#ifdef __cplusplus
+}
+#endif
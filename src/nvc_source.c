@@ -0,0 +1,309 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nvc_source.h>
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef NVC_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef NVC_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+nvc_source_format_t nvc_source_detect(const unsigned char* head, size_t n) {
+    if (n >= 2 && head[0] == 0x1f && head[1] == 0x8b) return NVC_SOURCE_GZIP;
+    if (n >= 4 && head[0] == 0x28 && head[1] == 0xb5 && head[2] == 0x2f &&
+        head[3] == 0xfd)
+        return NVC_SOURCE_ZSTD;
+    return NVC_SOURCE_PLAIN;
+}
+
+const char* nvc_source_format_to_str(nvc_source_format_t format) {
+    switch (format) {
+        case NVC_SOURCE_PLAIN: return "plain";
+        case NVC_SOURCE_GZIP: return "gzip";
+        case NVC_SOURCE_ZSTD: return "zstd";
+    }
+    return "unknown";
+}
+
+const char* nvc_source_status_to_str(nvc_source_status_t status) {
+    switch (status) {
+        case NVC_SOURCE_OK: return "ok";
+        case NVC_SOURCE_UNREADABLE: return "can not be read";
+        case NVC_SOURCE_OUT_OF_MEMORY: return "out of memory";
+        case NVC_SOURCE_CORRUPT: return "corrupt compressed data";
+        case NVC_SOURCE_UNSUPPORTED:
+            return "compressed in a format this build can not read";
+    }
+    return "unknown";
+}
+
+// the decompressed source, grown while decompressing
+typedef struct {
+    nvc_allocator_t* allocator;
+    char* buf;
+    size_t size;
+    size_t capacity;  // not counting the null terminator
+} nvc_source_buf_t;
+
+static bool nvc_source_reserve(nvc_source_buf_t* out) {
+    if (out->size < out->capacity) return true;
+    // dynamic allocation
+    size_t capacity = out->capacity ? out->capacity * 2 : NVC_SOURCE_CHUNK;
+    char* grown = nvc_realloc(out->allocator, out->buf, capacity + 1);
+    if (!grown) return false;
+    out->buf = grown;
+    out->capacity = capacity;
+    return true;
+}
+
+// note: the decompressors inflate one chunk of compressed input at a time
+// directly into the source buffer, there is no second copy of either side
+#ifdef NVC_HAVE_ZLIB
+static nvc_source_status_t nvc_inflate_gzip(FILE* fp,
+                                            nvc_source_buf_t* out,
+                                            unsigned char* in) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    // note: 16 selects the gzip wrapper
+    if (inflateInit2(&zs, 15 + 16) != Z_OK) return NVC_SOURCE_OUT_OF_MEMORY;
+
+    nvc_source_status_t status = NVC_SOURCE_OK;
+    int ret = Z_OK;
+    for (;;) {
+        if (zs.avail_in == 0) {
+            size_t n = fread(in, 1, NVC_SOURCE_CHUNK, fp);
+            if (ferror(fp)) {
+                status = NVC_SOURCE_UNREADABLE;
+                break;
+            }
+            if (n == 0) {
+                // cut off in the middle of a member
+                if (ret != Z_STREAM_END) status = NVC_SOURCE_CORRUPT;
+                break;
+            }
+            zs.next_in = in;
+            zs.avail_in = (uInt)n;
+        }
+        // concatenated gzip files decompress to the concatenated sources
+        if (ret == Z_STREAM_END && inflateReset(&zs) != Z_OK) {
+            status = NVC_SOURCE_CORRUPT;
+            break;
+        }
+        if (!nvc_source_reserve(out)) {
+            status = NVC_SOURCE_OUT_OF_MEMORY;
+            break;
+        }
+        size_t avail = out->capacity - out->size;
+        zs.next_out = (Bytef*)out->buf + out->size;
+        zs.avail_out = avail > UINT_MAX ? UINT_MAX : (uInt)avail;
+        ret = inflate(&zs, Z_NO_FLUSH);
+        out->size = (char*)zs.next_out - out->buf;
+        if (ret == Z_MEM_ERROR) {
+            status = NVC_SOURCE_OUT_OF_MEMORY;
+            break;
+        }
+        if (ret == Z_DATA_ERROR || ret == Z_NEED_DICT ||
+            ret == Z_STREAM_ERROR) {
+            status = NVC_SOURCE_CORRUPT;
+            break;
+        }
+    }
+    inflateEnd(&zs);
+    return status;
+}
+#endif
+
+#ifdef NVC_HAVE_ZSTD
+static nvc_source_status_t nvc_inflate_zstd(FILE* fp,
+                                            nvc_source_buf_t* out,
+                                            unsigned char* in) {
+    ZSTD_DStream* ds = ZSTD_createDStream();
+    if (!ds) return NVC_SOURCE_OUT_OF_MEMORY;
+    ZSTD_initDStream(ds);
+
+    nvc_source_status_t status = NVC_SOURCE_OK;
+    ZSTD_inBuffer zin = {in, 0, 0};
+    // 0 once a frame is complete, the next one starts on its own
+    size_t ret = 0;
+    for (;;) {
+        if (zin.pos == zin.size) {
+            size_t n = fread(in, 1, NVC_SOURCE_CHUNK, fp);
+            if (ferror(fp)) {
+                status = NVC_SOURCE_UNREADABLE;
+                break;
+            }
+            if (n == 0) {
+                if (ret != 0) status = NVC_SOURCE_CORRUPT;
+                break;
+            }
+            zin.size = n;
+            zin.pos = 0;
+        }
+        if (!nvc_source_reserve(out)) {
+            status = NVC_SOURCE_OUT_OF_MEMORY;
+            break;
+        }
+        ZSTD_outBuffer zout = {out->buf + out->size,
+                               out->capacity - out->size, 0};
+        ret = ZSTD_decompressStream(ds, &zout, &zin);
+        out->size += zout.pos;
+        if (ZSTD_isError(ret)) {
+            status = ZSTD_getErrorCode(ret) == ZSTD_error_memory_allocation
+                         ? NVC_SOURCE_OUT_OF_MEMORY
+                         : NVC_SOURCE_CORRUPT;
+            break;
+        }
+    }
+    ZSTD_freeDStream(ds);
+    return status;
+}
+#endif
+
+static nvc_source_status_t nvc_read_plain(FILE* fp,
+                                          long fs,
+                                          nvc_source_buf_t* out) {
+    // allocate filesize + null terminate
+    out->buf = nvc_alloc(out->allocator, (fs + 1) * sizeof(char));
+    if (!out->buf) return NVC_SOURCE_OUT_OF_MEMORY;
+    out->capacity = fs;
+    // note: empty files are valid sources
+    if (fs && fread(out->buf, fs, 1, fp) != 1) return NVC_SOURCE_UNREADABLE;
+    out->size = fs;
+    return NVC_SOURCE_OK;
+}
+
+static nvc_source_status_t nvc_read_compressed(FILE* fp,
+                                               nvc_source_format_t format,
+                                               long fs,
+                                               nvc_source_buf_t* out) {
+    nvc_source_status_t status = NVC_SOURCE_UNSUPPORTED;
+    // note: a guess, the buffer grows when the source is larger. a single
+    // member gzip file stores the size (mod 2^32) in its last four bytes
+    size_t hint = (size_t)fs * 4;
+    unsigned char isize[4];
+    if (format == NVC_SOURCE_GZIP && fs >= 18 &&
+        fseek(fp, -4, SEEK_END) == 0 && fread(isize, 4, 1, fp) == 1) {
+        size_t size = (size_t)isize[0] | (size_t)isize[1] << 8 |
+                      (size_t)isize[2] << 16 | (size_t)isize[3] << 24;
+        // note: deflate can not compress better than about 1032:1, a larger
+        // size is a damaged trailer and not worth allocating for
+        if (size / 1032 <= (size_t)fs) hint = size;
+    }
+    if (fseek(fp, 0, SEEK_SET) != 0) return NVC_SOURCE_UNREADABLE;
+    // note: one byte more than the hint so a correct hint never grows the
+    // buffer just to find out the stream ended
+    out->buf = nvc_alloc(out->allocator, hint + 2);
+    if (!out->buf) return NVC_SOURCE_OUT_OF_MEMORY;
+    out->capacity = hint + 1;
+
+    unsigned char* in = nvc_alloc(out->allocator, NVC_SOURCE_CHUNK);
+    if (!in) return NVC_SOURCE_OUT_OF_MEMORY;
+    switch (format) {
+        case NVC_SOURCE_GZIP:
+#ifdef NVC_HAVE_ZLIB
+            status = nvc_inflate_gzip(fp, out, in);
+#endif
+            break;
+        case NVC_SOURCE_ZSTD:
+#ifdef NVC_HAVE_ZSTD
+            status = nvc_inflate_zstd(fp, out, in);
+#endif
+            break;
+        case NVC_SOURCE_PLAIN: break;
+    }
+    nvc_free(out->allocator, in);
+    // note: the size is a long like the size of plain sources
+    if (status == NVC_SOURCE_OK && out->size > LONG_MAX)
+        status = NVC_SOURCE_OUT_OF_MEMORY;
+    return status;
+}
+
+char* nvc_read_source_file(nvc_allocator_t* allocator,
+                           const char* filename,
+                           long* filesize,
+                           nvc_source_status_t* status) {
+    nvc_source_buf_t out = {.allocator = allocator};
+    nvc_source_status_t result = NVC_SOURCE_UNREADABLE;
+    FILE* fp = NULL;
+    if (!filename) goto error;
+    // note: binary mode since the file may be compressed, the lexer skips
+    // the \r of \r\n line endings like any other whitespace
+    fp = fopen(filename, "rb");
+    if (!fp) goto error;
+    if (fseek(fp, 0, SEEK_END) != 0) goto error;
+    long fs = ftell(fp);
+    if (fs == -1) goto error;
+    if (fseek(fp, 0, SEEK_SET) != 0) goto error;
+
+    unsigned char head[4];
+    size_t n_head = fread(head, 1, sizeof(head), fp);
+    if (ferror(fp) || fseek(fp, 0, SEEK_SET) != 0) goto error;
+    nvc_source_format_t format = nvc_source_detect(head, n_head);
+    result = format == NVC_SOURCE_PLAIN
+                 ? nvc_read_plain(fp, fs, &out)
+                 : nvc_read_compressed(fp, format, fs, &out);
+    if (result != NVC_SOURCE_OK) goto error;
+    fclose(fp);
+    // null terminate
+    out.buf[out.size] = '\0';
+    if (filesize) *filesize = (long)out.size;
+    if (status) *status = NVC_SOURCE_OK;
+    return out.buf;
+error:
+    if (fp) fclose(fp);
+    nvc_free(allocator, out.buf);
+    if (filesize) *filesize = 0;
+    if (status) *status = result;
+    return NULL;
+}
+
+char* nvc_decode_source(nvc_allocator_t* allocator,
+                        char* raw,
+                        size_t size,
+                        long* filesize,
+                        nvc_source_status_t* status) {
+    nvc_source_buf_t out = {.allocator = allocator};
+    nvc_source_status_t result = NVC_SOURCE_OUT_OF_MEMORY;
+    FILE* fp = NULL;
+    if (size > LONG_MAX) goto error;
+    nvc_source_format_t format =
+        nvc_source_detect((const unsigned char*)raw, size);
+    if (format == NVC_SOURCE_PLAIN) {
+        raw[size] = '\0';
+        if (filesize) *filesize = (long)size;
+        if (status) *status = NVC_SOURCE_OK;
+        return raw;
+    }
+    // note: the decompressors read from a stream, compressed sources are
+    // rare enough to not need a second path
+    fp = fmemopen(raw, size, "rb");
+    if (!fp) goto error;
+    result = nvc_read_compressed(fp, format, (long)size, &out);
+    if (result != NVC_SOURCE_OK) goto error;
+    fclose(fp);
+    nvc_free(allocator, raw);
+    out.buf[out.size] = '\0';
+    if (filesize) *filesize = (long)out.size;
+    if (status) *status = NVC_SOURCE_OK;
+    return out.buf;
+error:
+    if (fp) fclose(fp);
+    nvc_free(allocator, raw);
+    nvc_free(allocator, out.buf);
+    if (filesize) *filesize = 0;
+    if (status) *status = result;
+    return NULL;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,136 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nvc_symtab.h>
+
+#include <nvc_hash.h>
+
+#include <string.h>
+
+static inline uint32_t nvc_symtab_hash(const char* key) {
+    uint64_t hash = nvc_hash_str(key);
+    return (uint32_t)(hash ^ (hash >> 32));
+}
+
+// returns the slot holding key or the empty slot where it would go
+static uint32_t nvc_symtab_find(const nvc_symtab_slot_t* slots,
+                                uint32_t capacity,
+                                const char* key,
+                                uint32_t hash) {
+    uint32_t mask = capacity - 1;
+    uint32_t i = hash & mask;
+    while (slots[i].key) {
+        if (slots[i].hash == hash && strcmp(slots[i].key, key) == 0) break;
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+static bool nvc_symtab_grow(nvc_symtab_t* table) {
+    uint32_t capacity = table->capacity * 2;
+    nvc_symtab_slot_t* slots =
+        nvc_calloc(table->allocator, capacity, sizeof(nvc_symtab_slot_t));
+    if (!slots) return false;
+    for (uint32_t i = 0; i < table->capacity; ++i) {
+        nvc_symtab_slot_t* slot = table->slots + i;
+        if (!slot->key) continue;
+        slots[nvc_symtab_find(slots, capacity, slot->key, slot->hash)] = *slot;
+    }
+    nvc_free(table->allocator, table->slots);
+    table->slots = slots;
+    table->capacity = capacity;
+    return true;
+}
+
+bool nvc_symtab_init(nvc_symtab_t* table,
+                     nvc_allocator_t* allocator,
+                     uint32_t expected_keys) {
+    memset(table, 0, sizeof(nvc_symtab_t));
+    table->allocator = allocator;
+    // keep the load factor at or below 1/2
+    uint32_t capacity = 16;
+    while (capacity < expected_keys * 2) capacity *= 2;
+    table->slots = nvc_calloc(allocator, capacity, sizeof(nvc_symtab_slot_t));
+    if (!table->slots) return false;
+    table->capacity = capacity;
+    return true;
+}
+
+void nvc_symtab_free(nvc_symtab_t* table) {
+    nvc_free(table->allocator, table->slots);
+    nvc_free(table->allocator, table->undo);
+    nvc_free(table->allocator, table->scope_marks);
+    memset(table, 0, sizeof(nvc_symtab_t));
+}
+
+uint32_t nvc_symtab_lookup(const nvc_symtab_t* table, const char* key) {
+    uint32_t i = nvc_symtab_find(table->slots, table->capacity, key,
+                                 nvc_symtab_hash(key));
+    return table->slots[i].key ? table->slots[i].value : NVC_SYMTAB_NONE;
+}
+
+bool nvc_symtab_bind(nvc_symtab_t* table, const char* key, uint32_t value) {
+    if ((table->n_keys + 1) * 2 > table->capacity && !nvc_symtab_grow(table))
+        return false;
+    // dynamic allocation
+    if (table->undo_size >= table->undo_capacity) {
+        uint32_t capacity =
+            table->undo_capacity ? table->undo_capacity * 2 : 16;
+        nvc_symtab_undo_t* grown =
+            nvc_realloc(table->allocator, table->undo,
+                        capacity * sizeof(nvc_symtab_undo_t));
+        if (!grown) return false;
+        table->undo = grown;
+        table->undo_capacity = capacity;
+    }
+
+    uint32_t hash = nvc_symtab_hash(key);
+    uint32_t i = nvc_symtab_find(table->slots, table->capacity, key, hash);
+    nvc_symtab_slot_t* slot = table->slots + i;
+    if (!slot->key) {
+        slot->key = key;
+        slot->hash = hash;
+        slot->value = NVC_SYMTAB_NONE;
+        ++table->n_keys;
+    }
+    nvc_symtab_undo_t undo = {
+        .key = slot->key,
+        .hash = hash,
+        .prev_value = slot->value,
+    };
+    table->undo[table->undo_size++] = undo;
+    slot->value = value;
+    return true;
+}
+
+bool nvc_symtab_push_scope(nvc_symtab_t* table) {
+    // dynamic allocation
+    if (table->depth >= table->marks_capacity) {
+        uint32_t capacity =
+            table->marks_capacity ? table->marks_capacity * 2 : 8;
+        uint32_t* grown = nvc_realloc(table->allocator, table->scope_marks,
+                                      capacity * sizeof(uint32_t));
+        if (!grown) return false;
+        table->scope_marks = grown;
+        table->marks_capacity = capacity;
+    }
+    table->scope_marks[table->depth++] = table->undo_size;
+    return true;
+}
+
+void nvc_symtab_pop_scope(nvc_symtab_t* table) {
+    if (!table->depth) return;
+    uint32_t mark = table->scope_marks[--table->depth];
+    // restore hidden bindings in reverse order
+    while (table->undo_size > mark) {
+        nvc_symtab_undo_t* undo = table->undo + --table->undo_size;
+        uint32_t i = nvc_symtab_find(table->slots, table->capacity, undo->key,
+                                     undo->hash);
+        table->slots[i].value = undo->prev_value;
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
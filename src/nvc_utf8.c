@@ -0,0 +1,193 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nvc_utf8.h>
+
+#include <nvc_simd.h>
+
+typedef struct {
+    uint32_t first, last;
+} nvc_code_point_range_t;
+
+// note: both tables are sorted and do not overlap, a code point continues an
+// identifier if it is in either of them
+static const nvc_code_point_range_t nvc_xid_start_ranges[] = {
+    // latin-1, latin extended and modifier letters
+    {0x00AA, 0x00AA}, {0x00B5, 0x00B5}, {0x00BA, 0x00BA}, {0x00C0, 0x00D6},
+    {0x00D8, 0x00F6}, {0x00F8, 0x02C1}, {0x02C6, 0x02D1}, {0x02E0, 0x02E4},
+    {0x02EC, 0x02EC}, {0x02EE, 0x02EE},
+    // greek and coptic, cyrillic
+    {0x0370, 0x0374}, {0x0376, 0x0377}, {0x037B, 0x037D}, {0x037F, 0x037F},
+    {0x0386, 0x0386}, {0x0388, 0x038A}, {0x038C, 0x038C}, {0x038E, 0x03A1},
+    {0x03A3, 0x03F5}, {0x03F7, 0x0481}, {0x048A, 0x052F},
+    // armenian, hebrew, arabic
+    {0x0531, 0x0556}, {0x0559, 0x0559}, {0x0560, 0x0588}, {0x05D0, 0x05EA},
+    {0x05EF, 0x05F2}, {0x0620, 0x064A}, {0x066E, 0x066F}, {0x0671, 0x06D3},
+    {0x06D5, 0x06D5},
+    // devanagari, thai
+    {0x0904, 0x0939}, {0x093D, 0x093D}, {0x0950, 0x0950}, {0x0958, 0x0961},
+    {0x0E01, 0x0E30}, {0x0E32, 0x0E32}, {0x0E40, 0x0E46},
+    // georgian, hangul jamo
+    {0x10A0, 0x10C5}, {0x10D0, 0x10FA}, {0x1100, 0x11FF},
+    // latin extended additional, greek extended
+    {0x1E00, 0x1F15}, {0x1F18, 0x1F1D}, {0x1F20, 0x1F45}, {0x1F48, 0x1F4D},
+    {0x1F50, 0x1F57}, {0x1F59, 0x1F59}, {0x1F5B, 0x1F5B}, {0x1F5D, 0x1F5D},
+    {0x1F5F, 0x1F7D}, {0x1F80, 0x1FB4}, {0x1FB6, 0x1FBC}, {0x1FBE, 0x1FBE},
+    {0x1FC2, 0x1FC4}, {0x1FC6, 0x1FCC}, {0x1FD0, 0x1FD3}, {0x1FD6, 0x1FDB},
+    {0x1FE0, 0x1FEC}, {0x1FF2, 0x1FF4}, {0x1FF6, 0x1FFC},
+    // super and subscript letters, letterlike symbols
+    {0x2071, 0x2071}, {0x207F, 0x207F}, {0x2090, 0x209C}, {0x2102, 0x2102},
+    {0x2107, 0x2107}, {0x210A, 0x2113}, {0x2115, 0x2115}, {0x2118, 0x211D},
+    {0x2124, 0x2124}, {0x2126, 0x2126}, {0x2128, 0x2128}, {0x212A, 0x2139},
+    // glagolitic, coptic
+    {0x2C00, 0x2CE4},
+    // cjk, kana, bopomofo, hangul, yi
+    {0x3005, 0x3007}, {0x3021, 0x3029}, {0x3031, 0x3035}, {0x3038, 0x303C},
+    {0x3041, 0x3096}, {0x309D, 0x309F}, {0x30A1, 0x30FA}, {0x30FC, 0x30FF},
+    {0x3105, 0x312F}, {0x3131, 0x318E}, {0x3400, 0x4DBF}, {0x4E00, 0x9FFF},
+    {0xA000, 0xA48C}, {0xAC00, 0xD7A3}, {0xF900, 0xFA6D}, {0xFA70, 0xFAD9},
+    // fullwidth latin, halfwidth kana and hangul
+    {0xFF21, 0xFF3A}, {0xFF41, 0xFF5A}, {0xFF66, 0xFF9D}, {0xFFA0, 0xFFBE},
+    // cjk extensions
+    {0x20000, 0x2A6DF}, {0x2A700, 0x2EBE0}, {0x2F800, 0x2FA1D},
+    {0x30000, 0x3134A},
+};
+
+// combining marks, digits and connector punctuation
+static const nvc_code_point_range_t nvc_xid_continue_ranges[] = {
+    {0x00B7, 0x00B7}, {0x0300, 0x036F}, {0x0387, 0x0387}, {0x0483, 0x0487},
+    {0x0591, 0x05BD}, {0x05BF, 0x05BF}, {0x05C1, 0x05C2}, {0x05C4, 0x05C5},
+    {0x05C7, 0x05C7}, {0x0610, 0x061A}, {0x064B, 0x0669}, {0x0670, 0x0670},
+    {0x06D6, 0x06DC}, {0x06DF, 0x06E8}, {0x06EA, 0x06F9}, {0x0900, 0x0903},
+    {0x093A, 0x093C}, {0x093E, 0x094F}, {0x0951, 0x0957}, {0x0962, 0x0963},
+    {0x0966, 0x096F}, {0x0E31, 0x0E31}, {0x0E33, 0x0E3A}, {0x0E47, 0x0E4E},
+    {0x0E50, 0x0E59}, {0x200C, 0x200D}, {0x203F, 0x2040}, {0x2054, 0x2054},
+    {0x20D0, 0x20DC}, {0x20E1, 0x20E1}, {0x20E5, 0x20F0}, {0x302A, 0x302F},
+    {0x3099, 0x309A}, {0xFE00, 0xFE0F}, {0xFE20, 0xFE2F}, {0xFE33, 0xFE34},
+    {0xFE4D, 0xFE4F}, {0xFF10, 0xFF19}, {0xFF3F, 0xFF3F}, {0xFF9E, 0xFF9F},
+    {0xE0100, 0xE01EF},
+};
+
+#define NVC_ARRAY_LEN(a) (sizeof(a) / sizeof((a)[0]))
+
+static bool nvc_in_ranges(const nvc_code_point_range_t* ranges,
+                          size_t n,
+                          uint32_t cp) {
+    size_t lo = 0, hi = n;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (cp < ranges[mid].first)
+            hi = mid;
+        else if (cp > ranges[mid].last)
+            lo = mid + 1;
+        else
+            return true;
+    }
+    return false;
+}
+
+bool nvc_xid_start(uint32_t cp) {
+    return nvc_in_ranges(nvc_xid_start_ranges,
+                         NVC_ARRAY_LEN(nvc_xid_start_ranges), cp);
+}
+
+bool nvc_xid_continue(uint32_t cp) {
+    return nvc_xid_start(cp) ||
+           nvc_in_ranges(nvc_xid_continue_ranges,
+                         NVC_ARRAY_LEN(nvc_xid_continue_ranges), cp);
+}
+
+size_t nvc_utf8_decode(const char* s, const char* end, uint32_t* cp) {
+    const unsigned char* p = (const unsigned char*)s;
+    if (s >= end) return 0;
+    if (p[0] < 0x80) {
+        *cp = p[0];
+        return 1;
+    }
+    // note: C0 and C1 could only start overlong two byte sequences and F5 and
+    // up only ones above U+10FFFF, they are rejected up front
+    size_t len;
+    uint32_t value, min;
+    if (p[0] >= 0xC2 && p[0] <= 0xDF) {
+        len = 2;
+        value = p[0] & 0x1F;
+        min = 0x80;
+    } else if ((p[0] & 0xF0) == 0xE0) {
+        len = 3;
+        value = p[0] & 0x0F;
+        min = 0x800;
+    } else if (p[0] >= 0xF0 && p[0] <= 0xF4) {
+        len = 4;
+        value = p[0] & 0x07;
+        min = 0x10000;
+    } else {
+        return 0;
+    }
+    if ((size_t)(end - s) < len) return 0;
+    for (size_t i = 1; i < len; ++i) {
+        if ((p[i] & 0xC0) != 0x80) return 0;
+        value = (value << 6) | (p[i] & 0x3F);
+    }
+    if (value < min || value > 0x10FFFF ||
+        (value >= 0xD800 && value <= 0xDFFF))
+        return 0;
+    *cp = value;
+    return len;
+}
+
+size_t nvc_utf8_encode(uint32_t cp, char* dst) {
+    unsigned char* p = (unsigned char*)dst;
+    if (cp < 0x80) {
+        p[0] = (unsigned char)cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        p[0] = 0xC0 | (cp >> 6);
+        p[1] = 0x80 | (cp & 0x3F);
+        return 2;
+    }
+    if (cp >= 0xD800 && cp <= 0xDFFF) return 0;
+    if (cp < 0x10000) {
+        p[0] = 0xE0 | (cp >> 12);
+        p[1] = 0x80 | ((cp >> 6) & 0x3F);
+        p[2] = 0x80 | (cp & 0x3F);
+        return 3;
+    }
+    if (cp > 0x10FFFF) return 0;
+    p[0] = 0xF0 | (cp >> 18);
+    p[1] = 0x80 | ((cp >> 12) & 0x3F);
+    p[2] = 0x80 | ((cp >> 6) & 0x3F);
+    p[3] = 0x80 | (cp & 0x3F);
+    return 4;
+}
+
+const char* nvc_utf8_validate(const char* begin, const char* end, bool* ascii) {
+    const char* p = begin;
+    while (p < end) {
+        p += nvc_simd_ascii_prefix(p, end - p);
+        if (p == end) break;
+        *ascii = false;
+        // note: decode whole runs of non-ASCII text before going back to the
+        // vector loop, which would stop at the very next byte again
+        do {
+            uint32_t cp;
+            size_t len = nvc_utf8_decode(p, end, &cp);
+            if (!len) return p;
+            p += len;
+        } while (p < end && (*p & 0x80));
+    }
+    return end;
+}
+
+uint32_t nvc_utf8_length(const char* begin, const char* end) {
+    // every code point has exactly one byte that is not a continuation byte
+    uint32_t length = 0;
+    for (const char* p = begin; p < end; ++p)
+        length += ((unsigned char)*p & 0xC0) != 0x80;
+    return length;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,551 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nvc_watch.h>
+
+#include <stdio.h>
+
+#ifdef __linux__
+
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <nvc_build.h>
+#include <nvc_hash.h>
+
+#define NVC_WATCH_DIR_MASK                                                 \
+    (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | \
+     IN_DELETE_SELF)
+
+typedef struct {
+    int wd;
+    char* path;      // owned
+    bool recursive;  // false when only watched for explicitly named files
+} nvc_watch_dir_t;
+
+typedef struct {
+    char* path;        // owned, also the bufname of every diagnostic
+    const char* name;  // points into path, matched against inotify events
+    int wd;            // watch of the containing directory
+    char* key;  // canonical path like nvc_build keys modules, NULL before
+                // the first compile
+    char* buf;  // contents of the last compile, NULL before the first
+    long bufsz;
+    uint64_t hash;  // hash of buf, a save without changes skips the compile
+    nvc_build_t* build;  // last compile, the file is its root. its modules
+                         // belong to the cache, only keys and imports are
+                         // read once another file was compiled
+    bool dirty;
+    bool stale;  // a module it imports changed, compiled even if buf did not
+} nvc_watch_file_t;
+
+typedef struct {
+    nvc_allocator_t* allocator;
+    nvc_build_options_t options;
+    nvc_module_cache_t cache;  // modules of every build, an import shared by
+                               // many files is read and parsed once
+    bool scanned;  // the files named on the command line were compiled
+    int fd;
+    nvc_watch_dir_t* dirs;
+    uint32_t n_dirs, dirs_capacity;
+    nvc_watch_file_t* files;
+    uint32_t n_files, files_capacity;
+    uint32_t n_dirty;
+} nvc_watcher_t;
+
+static uint64_t nvc_watch_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static bool nvc_watch_has_suffix(const char* name, const char* suffix) {
+    size_t len = strlen(name), suffix_len = strlen(suffix);
+    return len > suffix_len && strcmp(name + len - suffix_len, suffix) == 0;
+}
+
+// note: compressed sources are read like plain ones
+static bool nvc_watch_is_source(const char* name) {
+    return nvc_watch_has_suffix(name, ".nv") ||
+           nvc_watch_has_suffix(name, ".nv.gz") ||
+           nvc_watch_has_suffix(name, ".nv.zst");
+}
+
+static char* nvc_watch_join(nvc_allocator_t* allocator,
+                            const char* dir,
+                            const char* name) {
+    size_t dir_len = strlen(dir);
+    size_t name_len = strlen(name);
+    bool slash = dir_len && dir[dir_len - 1] != '/';
+    char* path = nvc_alloc(allocator, dir_len + slash + name_len + 1);
+    if (!path) return NULL;
+    memcpy(path, dir, dir_len);
+    if (slash) path[dir_len] = '/';
+    memcpy(path + dir_len + slash, name, name_len + 1);
+    return path;
+}
+
+static nvc_watch_dir_t* nvc_watch_find_dir(nvc_watcher_t* w, int wd) {
+    for (uint32_t i = 0; i < w->n_dirs; ++i) {
+        if (w->dirs[i].wd == wd) return w->dirs + i;
+    }
+    return NULL;
+}
+
+static nvc_watch_file_t* nvc_watch_find_file(nvc_watcher_t* w,
+                                             int wd,
+                                             const char* name) {
+    for (uint32_t i = 0; i < w->n_files; ++i) {
+        nvc_watch_file_t* file = w->files + i;
+        if (file->wd == wd && strcmp(file->name, name) == 0) return file;
+    }
+    return NULL;
+}
+
+static void nvc_watch_mark_dirty(nvc_watcher_t* w, nvc_watch_file_t* file) {
+    if (file->dirty) return;
+    file->dirty = true;
+    ++w->n_dirty;
+}
+
+// note: takes ownership of path
+static bool nvc_watch_add_file(nvc_watcher_t* w, int wd, char* path) {
+    const char* slash = strrchr(path, '/');
+    const char* name = slash ? slash + 1 : path;
+    nvc_watch_file_t* file = nvc_watch_find_file(w, wd, name);
+    if (file) {
+        nvc_free(w->allocator, path);
+        nvc_watch_mark_dirty(w, file);
+        return true;
+    }
+
+    if (w->n_files >= w->files_capacity) {
+        uint32_t capacity = w->files_capacity ? w->files_capacity * 2 : 16;
+        nvc_watch_file_t* grown = nvc_realloc(
+            w->allocator, w->files, capacity * sizeof(nvc_watch_file_t));
+        if (!grown) goto out_of_memory;
+        w->files = grown;
+        w->files_capacity = capacity;
+    }
+
+    file = w->files + w->n_files++;
+    memset(file, 0, sizeof(nvc_watch_file_t));
+    file->path = path;
+    file->name = name;
+    file->wd = wd;
+    nvc_watch_mark_dirty(w, file);
+    return true;
+out_of_memory:
+    fprintf(stderr, "Out of memory!\n");
+    nvc_free(w->allocator, path);
+    return false;
+}
+
+static void nvc_watch_remove_file(nvc_watcher_t* w, nvc_watch_file_t* file) {
+    if (file->dirty) --w->n_dirty;
+    if (file->build) nvc_free_build(file->build);
+    nvc_free(w->allocator, file->buf);
+    nvc_free(w->allocator, file->key);
+    nvc_free(w->allocator, file->path);
+    // note: order of files does not matter, fill the hole with the last one
+    *file = w->files[--w->n_files];
+}
+
+// returns the watch descriptor or -1
+static int nvc_watch_add_dir(nvc_watcher_t* w,
+                             const char* path,
+                             bool recursive) {
+    int wd = inotify_add_watch(w->fd, path, NVC_WATCH_DIR_MASK);
+    if (wd < 0) {
+        fprintf(stderr, "Unable to watch: %s: %s.\n", path, strerror(errno));
+        return -1;
+    }
+
+    nvc_watch_dir_t* dir = nvc_watch_find_dir(w, wd);
+    if (dir) {
+        // note: already watched, scanning it again only if it was not
+        // scanned before
+        if (dir->recursive || !recursive) return wd;
+        dir->recursive = true;
+    } else {
+        if (w->n_dirs >= w->dirs_capacity) {
+            uint32_t capacity = w->dirs_capacity ? w->dirs_capacity * 2 : 8;
+            nvc_watch_dir_t* grown = nvc_realloc(
+                w->allocator, w->dirs, capacity * sizeof(nvc_watch_dir_t));
+            if (!grown) goto out_of_memory;
+            w->dirs = grown;
+            w->dirs_capacity = capacity;
+        }
+        char* path_cpy = nvc_strndup(w->allocator, path, strlen(path));
+        if (!path_cpy) goto out_of_memory;
+        dir = w->dirs + w->n_dirs++;
+        dir->wd = wd;
+        dir->path = path_cpy;
+        dir->recursive = recursive;
+    }
+    if (!recursive) return wd;
+
+    DIR* dp = opendir(path);
+    if (!dp) {
+        fprintf(stderr, "Unable to read directory: %s: %s.\n", path,
+                strerror(errno));
+        return wd;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dp))) {
+        // note: skips . and .. as well as hidden files and directories
+        if (entry->d_name[0] == '.') continue;
+        char* entry_path = nvc_watch_join(w->allocator, path, entry->d_name);
+        if (!entry_path) {
+            closedir(dp);
+            goto out_of_memory;
+        }
+        struct stat st;
+        if (stat(entry_path, &st) != 0) {
+            nvc_free(w->allocator, entry_path);
+            continue;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            nvc_watch_add_dir(w, entry_path, true);
+            nvc_free(w->allocator, entry_path);
+        } else if (S_ISREG(st.st_mode) && nvc_watch_is_source(entry->d_name)) {
+            nvc_watch_add_file(w, wd, entry_path);
+        } else {
+            nvc_free(w->allocator, entry_path);
+        }
+    }
+    closedir(dp);
+    return wd;
+out_of_memory:
+    fprintf(stderr, "Out of memory!\n");
+    return -1;
+}
+
+static bool nvc_watch_add_path(nvc_watcher_t* w, const char* path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        fprintf(stderr, "Unable to read file: %s.\n", path);
+        return false;
+    }
+    if (S_ISDIR(st.st_mode)) return nvc_watch_add_dir(w, path, true) >= 0;
+
+    // note: watch the containing directory rather than the file, editors
+    // often save by writing a new file and renaming it over the old one
+    // which would silently end a watch on the file itself
+    char* path_cpy = nvc_strndup(w->allocator, path, strlen(path));
+    if (!path_cpy) {
+        fprintf(stderr, "Out of memory!\n");
+        return false;
+    }
+    char* slash = strrchr(path_cpy, '/');
+    int wd;
+    if (!slash) {
+        wd = nvc_watch_add_dir(w, ".", false);
+    } else if (slash == path_cpy) {
+        wd = nvc_watch_add_dir(w, "/", false);
+    } else {
+        *slash = '\0';
+        wd = nvc_watch_add_dir(w, path_cpy, false);
+        *slash = '/';
+    }
+    if (wd < 0) {
+        nvc_free(w->allocator, path_cpy);
+        return false;
+    }
+    return nvc_watch_add_file(w, wd, path_cpy);
+}
+
+static void nvc_watch_handle_event(nvc_watcher_t* w,
+                                   const struct inotify_event* event) {
+    if (event->mask & IN_Q_OVERFLOW) {
+        // note: events were lost, recompile everything (unchanged files are
+        // still skipped by their hash)
+        for (uint32_t i = 0; i < w->n_files; ++i)
+            nvc_watch_mark_dirty(w, w->files + i);
+        return;
+    }
+    nvc_watch_dir_t* dir = nvc_watch_find_dir(w, event->wd);
+    if (!dir) return;
+    if (event->mask & (IN_IGNORED | IN_DELETE_SELF)) {
+        // the directory is gone, its files are dropped on the next compile
+        for (uint32_t i = 0; i < w->n_files; ++i) {
+            if (w->files[i].wd == event->wd)
+                nvc_watch_mark_dirty(w, w->files + i);
+        }
+        if (event->mask & IN_IGNORED) {
+            nvc_free(w->allocator, dir->path);
+            *dir = w->dirs[--w->n_dirs];
+        }
+        return;
+    }
+    if (!event->len) return;
+
+    nvc_watch_file_t* file = nvc_watch_find_file(w, event->wd, event->name);
+    if (file) {
+        nvc_watch_mark_dirty(w, file);
+        return;
+    }
+    // new files are only picked up in directories named on the command line
+    if (!dir->recursive || event->name[0] == '.') return;
+    if (!(event->mask & (IN_CREATE | IN_MOVED_TO | IN_CLOSE_WRITE))) return;
+    bool is_dir = event->mask & IN_ISDIR;
+    if (!is_dir && !nvc_watch_is_source(event->name)) return;
+
+    char* path = nvc_watch_join(w->allocator, dir->path, event->name);
+    if (!path) {
+        fprintf(stderr, "Out of memory!\n");
+        return;
+    }
+    if (is_dir) {
+        // note: invalidates dir when the dirs array grows
+        nvc_watch_add_dir(w, path, true);
+        nvc_free(w->allocator, path);
+    } else {
+        nvc_watch_add_file(w, event->wd, path);
+    }
+}
+
+// true when a module of build has an import that was not found
+static bool nvc_watch_misses_import(const nvc_build_t* build) {
+    for (uint32_t i = 0; i < build->n_modules; ++i) {
+        const nvc_module_t* module = build->modules[i];
+        for (uint32_t j = 0; j < module->n_imports; ++j) {
+            if (module->imports[j].module == NVC_MODULE_NONE) return true;
+        }
+    }
+    return false;
+}
+
+// recompiles the files other than from whose last build read the module
+// key, or every one whose last build missed an import when key is NULL (a
+// new file may be the module it did not find)
+static void nvc_watch_mark_stale(nvc_watcher_t* w,
+                                 const nvc_watch_file_t* from,
+                                 const char* key) {
+    for (uint32_t i = 0; i < w->n_files; ++i) {
+        nvc_watch_file_t* file = w->files + i;
+        if (file == from || !file->build) continue;
+        bool stale = !key && nvc_watch_misses_import(file->build);
+        for (uint32_t j = 1; key && !stale && j < file->build->n_modules;
+             ++j) {
+            const char* import = file->build->modules[j]->key;
+            stale = import && strcmp(import, key) == 0;
+        }
+        if (!stale) continue;
+        file->stale = true;
+        nvc_watch_mark_dirty(w, file);
+    }
+}
+
+// returns false if the file is gone and was removed
+static bool nvc_watch_compile_file(nvc_watcher_t* w, nvc_watch_file_t* file) {
+    file->dirty = false;
+    --w->n_dirty;
+
+    uint64_t start_ms = nvc_watch_now_ms();
+    long bufsz;
+    nvc_source_status_t status;
+    char* buf =
+        nvc_read_source_file(w->allocator, file->path, &bufsz, &status);
+    if (!buf && status != NVC_SOURCE_UNREADABLE) {
+        // note: e.g. a compressed file caught half written, it is compiled
+        // again once it changes
+        fprintf(stderr, "Unable to read file: %s: %s.\n", file->path,
+                nvc_source_status_to_str(status));
+        return true;
+    }
+    if (!buf) {
+        // deleted or renamed away
+        if (file->buf) {
+            fprintf(stdout, "----- %s: removed\n", file->path);
+            fflush(stdout);
+        }
+        // note: the key is freed with the file
+        char* key = file->key;
+        file->key = NULL;
+        if (key) nvc_module_cache_invalidate(&w->cache, key);
+        nvc_watch_remove_file(w, file);
+        if (key) nvc_watch_mark_stale(w, NULL, key);
+        nvc_free(w->allocator, key);
+        return false;
+    }
+    uint64_t hash = nvc_hash_bytes(buf, bufsz, NVC_HASH_SEED);
+    bool first = !file->buf;
+    bool changed = !file->buf || file->bufsz != bufsz || file->hash != hash ||
+                   memcmp(file->buf, buf, bufsz) != 0;
+    nvc_free(w->allocator, file->buf);
+    file->buf = buf;
+    file->bufsz = bufsz;
+    file->hash = hash;
+    // note: saved without changes, the previous results still hold unless
+    // an import changed
+    if (!changed && !file->stale) return true;
+    file->stale = false;
+
+    if (!file->key) {
+        char* real = realpath(file->path, NULL);
+        if (real) file->key = nvc_strndup(w->allocator, real, strlen(real));
+        free(real);
+    }
+    // note: the build reads and parses the file again along with the
+    // imports that changed since they were cached, and resolves the
+    // modules that depend on them. the mtime may not have moved on a quick
+    // edit so the cache is told
+    if (changed && file->key) nvc_module_cache_invalidate(&w->cache, file->key);
+    nvc_build_t* build = nvc_build(w->allocator, file->path, &w->options);
+    if (!build) {
+        fprintf(stderr, "Out of memory!\n");
+        return true;
+    }
+    if (file->build) nvc_free_build(file->build);
+    file->build = build;
+
+    // note: imports first, the file last
+    for (uint32_t i = 0; i < build->n_modules; ++i) {
+        nvc_print_diagnostics(
+            stderr, &build->modules[build->order[i]]->ctx->diagnostics);
+    }
+    fflush(stderr);
+    fprintf(stdout, "----- %s: %s (%llu ms)\n", file->path,
+            build->n_errors ? "failed" : "ok",
+            (unsigned long long)(nvc_watch_now_ms() - start_ms));
+    fflush(stdout);
+
+    // the files importing this one are out of date, a file that appeared
+    // after the first compile may be an import another file did not find
+    // note: the builds of the first compile all read the same sources
+    if (!first && changed && file->key)
+        nvc_watch_mark_stale(w, file, file->key);
+    if (first && w->scanned) nvc_watch_mark_stale(w, file, NULL);
+    return true;
+}
+
+static void nvc_watch_compile_dirty(nvc_watcher_t* w) {
+    // note: removing a file moves the last one into its slot, which then
+    // still has to be visited. compiling a file can make files before it
+    // dirty again, so this repeats until none are left
+    while (w->n_dirty) {
+        for (uint32_t i = 0; i < w->n_files;) {
+            if (!w->files[i].dirty || nvc_watch_compile_file(w, w->files + i))
+                ++i;
+        }
+    }
+}
+
+static int nvc_watch_loop(nvc_watcher_t* w) {
+    // note: large enough for many events, aligned for struct inotify_event
+    char events[4096]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+    uint64_t deadline_ms = 0;
+
+    nvc_watch_compile_dirty(w);
+    w->scanned = true;
+    fprintf(stdout, "----- watching %u files\n", w->n_files);
+    fflush(stdout);
+
+    for (;;) {
+        int timeout = -1;
+        if (w->n_dirty) {
+            uint64_t now_ms = nvc_watch_now_ms();
+            timeout = deadline_ms > now_ms ? (int)(deadline_ms - now_ms) : 0;
+        }
+        struct pollfd pfd = {.fd = w->fd, .events = POLLIN};
+        int ready = poll(&pfd, 1, timeout);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "Unable to wait for changes: %s.\n",
+                    strerror(errno));
+            return 1;
+        }
+        if (ready == 0) {
+            // quiet for a whole debounce period
+            nvc_watch_compile_dirty(w);
+            continue;
+        }
+
+        ssize_t len = read(w->fd, events, sizeof(events));
+        if (len < 0) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            fprintf(stderr, "Unable to read changes: %s.\n", strerror(errno));
+            return 1;
+        }
+        for (char* ptr = events; ptr < events + len;) {
+            const struct inotify_event* event = (void*)ptr;
+            nvc_watch_handle_event(w, event);
+            ptr += sizeof(struct inotify_event) + event->len;
+        }
+        // every change restarts the quiet period
+        deadline_ms = nvc_watch_now_ms() + NVC_WATCH_DEBOUNCE_MS;
+    }
+}
+
+int nvc_watch(nvc_allocator_t* allocator,
+              char** paths,
+              int n_paths,
+              const nvc_compile_options_t* options) {
+    nvc_watcher_t w = {
+        .allocator = allocator ? allocator : nvc_default_allocator(),
+    };
+    if (options) {
+        w.options.parse_options = options->parse;
+        w.options.max_errors = options->max_errors;
+        w.options.n_jobs = options->n_jobs;
+        w.options.opt_level = options->opt_level;
+        w.options.reader = options->reader;
+    }
+    int result = 1;
+    if (!nvc_module_cache_init(&w.cache, w.allocator)) {
+        fprintf(stderr, "Out of memory!\n");
+        return 1;
+    }
+    w.options.cache = &w.cache;
+    w.fd = inotify_init1(IN_CLOEXEC);
+    if (w.fd < 0) {
+        fprintf(stderr, "Unable to start watching: %s.\n", strerror(errno));
+        nvc_module_cache_free(&w.cache);
+        return 1;
+    }
+
+    for (int i = 0; i < n_paths; ++i) {
+        if (!nvc_watch_add_path(&w, paths[i])) goto cleanup;
+    }
+    result = nvc_watch_loop(&w);
+
+cleanup:
+    while (w.n_files) nvc_watch_remove_file(&w, w.files + w.n_files - 1);
+    for (uint32_t i = 0; i < w.n_dirs; ++i)
+        nvc_free(w.allocator, w.dirs[i].path);
+    nvc_free(w.allocator, w.files);
+    nvc_free(w.allocator, w.dirs);
+    nvc_module_cache_free(&w.cache);
+    close(w.fd);
+    return result;
+}
+
+#else  // __linux__
+
+int nvc_watch(nvc_allocator_t* allocator,
+              char** paths,
+              int n_paths,
+              const nvc_compile_options_t* options) {
+    (void)allocator;
+    (void)paths;
+    (void)n_paths;
+    (void)options;
+    fprintf(stderr, "Watch mode is only supported on linux.\n");
+    return 1;
+}
+
+#endif  // __linux__
+
+#ifdef __cplusplus
+}
+#endif
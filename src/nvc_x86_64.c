@@ -0,0 +1,1211 @@
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <nvc_x86_64.h>
+
+#include <elf.h>
+#include <errno.h>
+#include <string.h>
+
+#include <nvc_rt.h>
+
+// register numbers as encoded in ModRM and REX
+enum {
+    NVC_RAX = 0,
+    NVC_RCX = 1,
+    NVC_RDX = 2,
+    NVC_RSI = 6,
+    NVC_RDI = 7,
+    NVC_R8 = 8,
+};
+
+// opcodes of the reg, r/m forms
+#define NVC_X86_STORE 0x89
+#define NVC_X86_LOAD 0x8b
+#define NVC_X86_LEA 0x8d
+
+// note: where a value lives, offsets are relative to rbp (so negative) and 0
+// means none
+typedef struct {
+    int32_t slot;      // the value, array values hold a pointer to elements
+    int32_t elems;     // the elements an array operation writes
+    int32_t incoming;  // phis: written by the predecessor that jumps here
+    int32_t args;      // calls: the arguments passed to the callee
+} nvc_value_home_t;
+
+// a function other than the initialiser keeps the pointers it was called
+// with at the top of its frame, see nvc_rt.h
+#define NVC_FRAME_ARGS (-8)
+#define NVC_FRAME_RESULT (-16)
+
+typedef struct {
+    uint64_t offset;  // of a rel32 in .text
+    uint32_t block;   // it jumps to
+} nvc_jump_fixup_t;
+
+typedef struct {
+    nvc_elf_object_t* obj;
+    nvc_diagnostics_t* diags;
+    const char* name;
+    const nvc_object_import_t* imports;
+    uint32_t n_imports;
+    nvc_ir_module_t* module;
+    nvc_ir_function_t* fun;
+    nvc_value_home_t* homes;  // indexed by value
+    uint64_t* block_offsets;  // where each block starts in .text
+    nvc_jump_fixup_t* fixups;
+    uint32_t n_fixups, fixups_capacity;
+    bool failed;
+} nvc_gen_t;
+
+static void nvc_gen_out_of_memory(nvc_gen_t* gen) {
+    if (!gen->failed)
+        nvc_report(gen->diags, NVC_SEVERITY_ERROR, NULL, "out of memory");
+    gen->failed = true;
+}
+
+static uint64_t nvc_here(nvc_gen_t* gen) {
+    return gen->obj->sections[NVC_ELF_TEXT].size;
+}
+
+static void nvc_emit(nvc_gen_t* gen, const void* bytes, size_t n) {
+    nvc_elf_append(gen->obj, NVC_ELF_TEXT, bytes, n, 1);
+}
+
+#define NVC_X86(gen, ...)                           \
+    nvc_emit(gen, (const uint8_t[]){__VA_ARGS__}, \
+             sizeof((const uint8_t[]){__VA_ARGS__}))
+
+static void nvc_emit_u32(nvc_gen_t* gen, uint32_t value) {
+    uint8_t bytes[4];
+    for (int i = 0; i < 4; ++i) bytes[i] = value >> (8 * i);
+    nvc_emit(gen, bytes, sizeof(bytes));
+}
+
+static void nvc_emit_u64(nvc_gen_t* gen, uint64_t value) {
+    uint8_t bytes[8];
+    for (int i = 0; i < 8; ++i) bytes[i] = value >> (8 * i);
+    nvc_emit(gen, bytes, sizeof(bytes));
+}
+
+// <opcode> reg, [rbp + disp] with a 64 bit operand
+static void nvc_x86_frame(nvc_gen_t* gen,
+                          uint8_t opcode,
+                          int reg,
+                          int32_t disp) {
+    NVC_X86(gen, 0x48 | (reg >= 8 ? 4 : 0), opcode, 0x85 | (reg & 7) << 3);
+    nvc_emit_u32(gen, (uint32_t)disp);
+}
+
+// <opcode> reg, [rip + symbol + addend] with a 64 bit operand
+static void nvc_x86_rip(nvc_gen_t* gen,
+                        uint8_t opcode,
+                        int reg,
+                        uint32_t symbol,
+                        int64_t addend) {
+    NVC_X86(gen, 0x48 | (reg >= 8 ? 4 : 0), opcode, 0x05 | (reg & 7) << 3);
+    // note: rip is the end of the instruction, 4 bytes past the field
+    nvc_elf_reloc(gen->obj, nvc_here(gen), symbol, R_X86_64_PC32, addend - 4);
+    nvc_emit_u32(gen, 0);
+}
+
+// mov reg, imm (sign extended)
+static void nvc_x86_mov_imm(nvc_gen_t* gen, int reg, int32_t imm) {
+    NVC_X86(gen, 0x48 | (reg >= 8 ? 1 : 0), 0xc7, 0xc0 | (reg & 7));
+    nvc_emit_u32(gen, (uint32_t)imm);
+}
+
+static void nvc_x86_call_symbol(nvc_gen_t* gen, uint32_t symbol) {
+    NVC_X86(gen, 0xe8);
+    nvc_elf_reloc(gen->obj, nvc_here(gen), symbol, R_X86_64_PLT32, -4);
+    nvc_emit_u32(gen, 0);
+}
+
+static void nvc_x86_call(nvc_gen_t* gen, const char* name) {
+    nvc_x86_call_symbol(gen, nvc_elf_symbol(gen->obj, name));
+}
+
+// jmp/jcc rel32 to the start of block, patched once every block is placed
+static void nvc_x86_jump(nvc_gen_t* gen, uint32_t block) {
+    // dynamic allocation
+    if (gen->n_fixups == gen->fixups_capacity) {
+        uint32_t capacity = gen->fixups_capacity ? gen->fixups_capacity * 2 : 8;
+        nvc_jump_fixup_t* grown =
+            nvc_realloc(gen->obj->allocator, gen->fixups,
+                        capacity * sizeof(nvc_jump_fixup_t));
+        if (!grown) {
+            nvc_gen_out_of_memory(gen);
+            return;
+        }
+        gen->fixups = grown;
+        gen->fixups_capacity = capacity;
+    }
+    gen->fixups[gen->n_fixups++] = (nvc_jump_fixup_t){
+        .offset = nvc_here(gen),
+        .block = block,
+    };
+    nvc_emit_u32(gen, 0);
+}
+
+// jcc/jmp rel8 to a point later in the same instruction, returns where the
+// rel8 ends for nvc_x86_land
+static uint64_t nvc_x86_short_jump(nvc_gen_t* gen, uint8_t opcode) {
+    NVC_X86(gen, opcode, 0x00);
+    return nvc_here(gen);
+}
+
+// points the short jump ending at from to here
+static void nvc_x86_land(nvc_gen_t* gen, uint64_t from) {
+    if (gen->obj->out_of_memory) return;
+    gen->obj->sections[NVC_ELF_TEXT].data[from - 1] =
+        (uint8_t)(nvc_here(gen) - from);
+}
+
+// the symbol <module><sep><name>, see nvc_rt.h
+static uint32_t nvc_gen_symbol(nvc_gen_t* gen,
+                               const char* module,
+                               char sep,
+                               const char* name) {
+    size_t len = strlen(module) + 1 + strlen(name) + 1;
+    char* mangled = nvc_alloc(gen->obj->allocator, len);
+    if (!mangled) {
+        nvc_gen_out_of_memory(gen);
+        return 0;
+    }
+    snprintf(mangled, len, "%s%c%s", module, sep, name);
+    uint32_t symbol = nvc_elf_symbol(gen->obj, mangled);
+    nvc_free(gen->obj->allocator, mangled);
+    return symbol;
+}
+
+static nvc_ir_inst_t* nvc_gen_inst(nvc_gen_t* gen, nvc_ir_value_t value) {
+    return gen->fun->insts + value;
+}
+
+static void nvc_load(nvc_gen_t* gen, int reg, nvc_ir_value_t value) {
+    nvc_x86_frame(gen, NVC_X86_LOAD, reg, gen->homes[value].slot);
+}
+
+static void nvc_store_rax(nvc_gen_t* gen, nvc_ir_value_t value) {
+    nvc_x86_frame(gen, NVC_X86_STORE, NVC_RAX, gen->homes[value].slot);
+}
+
+// stores the low size bytes of rax at rbp + disp, for the elements of
+// arrays and the fields of records
+static void nvc_store_narrow(nvc_gen_t* gen, uint64_t size, int32_t disp) {
+    if (size == 8) {
+        nvc_x86_frame(gen, NVC_X86_STORE, NVC_RAX, disp);
+        return;
+    }
+    // mov [rbp + disp], al or eax
+    NVC_X86(gen, size == 1 ? 0x88 : 0x89, 0x85);
+    nvc_emit_u32(gen, (uint32_t)disp);
+}
+
+// the opcode of a load of a scalar element or field of type into rax, its
+// ModRM follows. like nvc_rt.h says bools and f32s are zero extended and
+// i32s sign extended
+static void nvc_x86_load_elem(nvc_gen_t* gen, nvc_ir_type_t type) {
+    switch (type) {
+        case NVC_IR_TYPE_BOOL: NVC_X86(gen, 0x0f, 0xb6); break;  // movzx eax
+        case NVC_IR_TYPE_I32: NVC_X86(gen, 0x48, 0x63); break;   // movsxd rax
+        case NVC_IR_TYPE_F32: NVC_X86(gen, 0x8b); break;         // mov eax
+        default: NVC_X86(gen, 0x48, 0x8b); break;                // mov rax
+    }
+}
+
+static uint32_t nvc_rt_type(nvc_ir_type_t type) {
+    switch (type) {
+        case NVC_IR_TYPE_INT: return NVC_RT_INT;
+        case NVC_IR_TYPE_FP: return NVC_RT_FP;
+        case NVC_IR_TYPE_I32: return NVC_RT_I32;
+        case NVC_IR_TYPE_I64: return NVC_RT_I64;
+        case NVC_IR_TYPE_F32: return NVC_RT_F32;
+        default: return NVC_RT_BOOL;
+    }
+}
+
+static uint32_t nvc_rt_op(nvc_ir_op_t op) {
+    switch (op) {
+        case NVC_IR_ADD: return NVC_RT_ADD;
+        case NVC_IR_SUB: return NVC_RT_SUB;
+        case NVC_IR_MUL: return NVC_RT_MUL;
+        case NVC_IR_DIV: return NVC_RT_DIV;
+        case NVC_IR_POW: return NVC_RT_POW;
+        case NVC_IR_LT: return NVC_RT_LT;
+        case NVC_IR_LE: return NVC_RT_LE;
+        case NVC_IR_GT: return NVC_RT_GT;
+        case NVC_IR_GE: return NVC_RT_GE;
+        case NVC_IR_NEG: return NVC_RT_NEG;
+        case NVC_IR_NOT: return NVC_RT_NOT;
+        default: return NVC_RT_ITOF;
+    }
+}
+
+// true for values held in memory, their slot holds a pointer to it
+static bool nvc_is_aggregate(const nvc_ir_inst_t* inst) {
+    return inst->length || inst->type == NVC_IR_TYPE_RECORD;
+}
+
+// bytes of the elements of an array or the fields of a record
+static uint64_t nvc_aggregate_size(const nvc_ir_inst_t* inst) {
+    if (inst->layout) return inst->layout->size;
+    return (uint64_t)inst->length * nvc_ir_elem_size(inst->type);
+}
+
+// true for instructions that write the elements of a new array or the
+// fields of a new record, aggregate phis copy their incoming value
+static bool nvc_writes_elems(const nvc_ir_inst_t* inst) {
+    if (inst->op == NVC_IR_RECORD) return true;
+    // note: a callee copies the array or record it returns there
+    if (inst->op == NVC_IR_PHI || inst->op == NVC_IR_CALL)
+        return nvc_is_aggregate(inst);
+    if (!inst->length) return false;
+    switch (inst->op) {
+        case NVC_IR_ARRAY:
+        case NVC_IR_SPLAT:
+        case NVC_IR_ADD:
+        case NVC_IR_SUB:
+        case NVC_IR_MUL:
+        case NVC_IR_DIV:
+        case NVC_IR_POW:
+        case NVC_IR_NEG:
+        case NVC_IR_NOT:
+        case NVC_IR_LT:
+        case NVC_IR_LE:
+        case NVC_IR_GT:
+        case NVC_IR_GE:
+        case NVC_IR_ITOF:
+        case NVC_IR_CONVERT: return true;
+        default: return false;
+    }
+}
+
+// gives every value a stack slot below the reserved bytes, returns the
+// frame size
+static uint32_t nvc_gen_frame(nvc_gen_t* gen, uint32_t reserved) {
+    uint64_t size = reserved;
+    for (nvc_ir_value_t v = 0; v < gen->fun->n_insts; ++v) {
+        nvc_ir_inst_t* inst = nvc_gen_inst(gen, v);
+        nvc_value_home_t* home = gen->homes + v;
+        if (inst->op == NVC_IR_NOP || inst->type == NVC_IR_TYPE_VOID) continue;
+        size += 8;
+        home->slot = -(int32_t)size;
+        if (inst->op == NVC_IR_PHI) {
+            size += 8;
+            home->incoming = -(int32_t)size;
+        }
+        if (inst->op == NVC_IR_CALL && inst->n_operands) {
+            size += (uint64_t)inst->n_operands * 8;
+            home->args = -(int32_t)size;
+        }
+        if (nvc_writes_elems(inst)) {
+            size += (nvc_aggregate_size(inst) + 7) & ~(uint64_t)7;
+            home->elems = -(int32_t)size;
+        }
+        if (size > INT32_MAX / 2) {
+            nvc_report(gen->diags, NVC_SEVERITY_ERROR, &inst->buf_loc,
+                       "the values of the module do not fit on the stack");
+            gen->failed = true;
+            return 0;
+        }
+    }
+    return (uint32_t)((size + 15) & ~(uint64_t)15);
+}
+
+// ints are tagged and the fixed width numbers are not, see nvc_rt.h
+static void nvc_gen_const(nvc_gen_t* gen, nvc_ir_value_t value) {
+    nvc_ir_inst_t* inst = nvc_gen_inst(gen, value);
+    uint32_t rodata = NVC_ELF_SECTION_SYMBOL(NVC_ELF_RODATA);
+    if (inst->op == NVC_IR_BIG) {
+        uint64_t offset =
+            nvc_elf_append(gen->obj, NVC_ELF_RODATA, inst->big,
+                           NVC_BIGINT_SIZE(inst->big->n_limbs), 8);
+        nvc_x86_rip(gen, NVC_X86_LEA, NVC_RAX, rodata, (int64_t)offset + 1);
+        nvc_store_rax(gen, value);
+        return;
+    }
+    if (inst->length) {
+        uint64_t size = (uint64_t)inst->length * nvc_ir_elem_size(inst->type);
+        const void* elems = inst->ints;
+        uint64_t* tagged = NULL;
+        if (inst->type == NVC_IR_TYPE_INT) {
+            tagged = nvc_alloc(gen->obj->allocator, size);
+            if (!tagged) {
+                nvc_gen_out_of_memory(gen);
+                return;
+            }
+            for (uint32_t k = 0; k < inst->length; ++k)
+                tagged[k] = (uint64_t)inst->ints[k] << 1;
+            elems = tagged;
+        }
+        uint64_t offset =
+            nvc_elf_append(gen->obj, NVC_ELF_RODATA, elems, size, 8);
+        nvc_free(gen->obj->allocator, tagged);
+        nvc_x86_rip(gen, NVC_X86_LEA, NVC_RAX, rodata, offset);
+        nvc_store_rax(gen, value);
+        return;
+    }
+    switch (inst->type) {
+        case NVC_IR_TYPE_INT:
+        case NVC_IR_TYPE_I64:
+            // movabs rax, imm64
+            NVC_X86(gen, 0x48, 0xb8);
+            nvc_emit_u64(gen, inst->type == NVC_IR_TYPE_INT
+                                  ? (uint64_t)inst->i << 1
+                                  : (uint64_t)inst->i);
+            break;
+        case NVC_IR_TYPE_I32:
+            nvc_x86_mov_imm(gen, NVC_RAX, (int32_t)inst->i);
+            break;
+        case NVC_IR_TYPE_F32: {
+            float f32 = (float)inst->fp;
+            uint32_t bits;
+            memcpy(&bits, &f32, sizeof(bits));
+            // mov eax, imm32
+            NVC_X86(gen, 0xb8);
+            nvc_emit_u32(gen, bits);
+            break;
+        }
+        case NVC_IR_TYPE_BOOL:
+            // mov eax, imm32
+            NVC_X86(gen, 0xb8);
+            nvc_emit_u32(gen, inst->b);
+            break;
+        case NVC_IR_TYPE_FP: {
+            uint64_t offset = nvc_elf_append(gen->obj, NVC_ELF_RODATA,
+                                             &inst->fp, sizeof(inst->fp), 8);
+            nvc_x86_rip(gen, NVC_X86_LOAD, NVC_RAX, rodata, offset);
+            break;
+        }
+        default: {
+            uint64_t offset = nvc_elf_append(gen->obj, NVC_ELF_RODATA,
+                                             inst->str, strlen(inst->str) + 1,
+                                             1);
+            nvc_x86_rip(gen, NVC_X86_LEA, NVC_RAX, rodata, offset);
+            break;
+        }
+    }
+    nvc_store_rax(gen, value);
+}
+
+static void nvc_gen_import(nvc_gen_t* gen, nvc_ir_value_t value) {
+    nvc_ir_inst_t* inst = nvc_gen_inst(gen, value);
+    const char* module = NULL;
+    for (uint32_t i = 0; i < gen->n_imports; ++i) {
+        if (gen->imports[i].sema == inst->import.module)
+            module = gen->imports[i].name;
+    }
+    if (!module) {
+        nvc_report(gen->diags, NVC_SEVERITY_ERROR, &inst->buf_loc,
+                   "'%s' comes from a module that is not imported",
+                   inst->name);
+        gen->failed = true;
+        return;
+    }
+    const nvc_decl_t* decl = inst->import.module->decls + inst->import.decl;
+    uint32_t symbol = nvc_gen_symbol(gen, module, '.', decl->name);
+    nvc_x86_rip(gen, nvc_is_aggregate(inst) ? NVC_X86_LEA : NVC_X86_LOAD,
+                NVC_RAX, symbol, 0);
+    nvc_store_rax(gen, value);
+}
+
+static void nvc_gen_export(nvc_gen_t* gen, nvc_ir_value_t value) {
+    nvc_ir_inst_t* inst = nvc_gen_inst(gen, value);
+    nvc_ir_inst_t* exported = nvc_gen_inst(gen, inst->ops[0]);
+    bool aggregate = nvc_is_aggregate(exported);
+    uint64_t size = aggregate ? nvc_aggregate_size(exported) : 8;
+    uint32_t symbol = nvc_gen_symbol(gen, gen->name, '.', inst->name);
+    uint64_t offset = nvc_elf_append(gen->obj, NVC_ELF_BSS, NULL, size, 8);
+    nvc_elf_define(gen->obj, symbol, NVC_ELF_BSS, offset, size, false);
+    if (!aggregate) {
+        nvc_load(gen, NVC_RAX, inst->ops[0]);
+        nvc_x86_rip(gen, NVC_X86_STORE, NVC_RAX, symbol, 0);
+        return;
+    }
+    // memcpy(m.<name>, elements, size)
+    nvc_x86_rip(gen, NVC_X86_LEA, NVC_RDI, symbol, 0);
+    nvc_load(gen, NVC_RSI, inst->ops[0]);
+    nvc_x86_mov_imm(gen, NVC_RDX, (int32_t)size);
+    nvc_x86_call(gen, "memcpy");
+}
+
+// the tagged int operation op on rax and rcx into rax: small ints take the
+// inline path, a set tag or an overflow calls the runtime (see nvc_rt.h).
+// comparisons leave 0 or 1
+static void nvc_gen_int_binary(nvc_gen_t* gen, nvc_ir_op_t op) {
+    if (op == NVC_IR_DIV || op == NVC_IR_POW) {
+        // mov rdi, rax; mov rsi, rcx
+        NVC_X86(gen, 0x48, 0x89, 0xc7, 0x48, 0x89, 0xce);
+        nvc_x86_call(gen, op == NVC_IR_DIV ? "nvc_rt_int_div"
+                                           : "nvc_rt_int_pow");
+        return;
+    }
+    // mov rdx, rax; or rdx, rcx; test dl, 1; jnz slow
+    NVC_X86(gen, 0x48, 0x89, 0xc2, 0x48, 0x09, 0xca, 0xf6, 0xc2, 0x01);
+    uint64_t tagged = nvc_x86_short_jump(gen, 0x75);
+    uint64_t overflow = 0;
+    const char* slow;
+    switch (op) {
+        case NVC_IR_ADD:
+        case NVC_IR_SUB:
+        case NVC_IR_MUL:
+            // note: (a << 1) + (b << 1) and a * (b << 1) overflow exactly
+            // when the result is not small
+            // mov rdx, rax
+            NVC_X86(gen, 0x48, 0x89, 0xc2);
+            if (op == NVC_IR_ADD) {
+                NVC_X86(gen, 0x48, 0x01, 0xca);  // add rdx, rcx
+                slow = "nvc_rt_int_add";
+            } else if (op == NVC_IR_SUB) {
+                NVC_X86(gen, 0x48, 0x29, 0xca);  // sub rdx, rcx
+                slow = "nvc_rt_int_sub";
+            } else {
+                // sar rdx, 1; imul rdx, rcx
+                NVC_X86(gen, 0x48, 0xd1, 0xfa, 0x48, 0x0f, 0xaf, 0xd1);
+                slow = "nvc_rt_int_mul";
+            }
+            overflow = nvc_x86_short_jump(gen, 0x70);  // jo slow
+            NVC_X86(gen, 0x48, 0x89, 0xd0);           // mov rax, rdx
+            break;
+        default:
+            // note: small ints compare like their tagged words
+            NVC_X86(gen, 0x48, 0x39, 0xc8);  // cmp rax, rcx
+            slow = "nvc_rt_int_compare";
+            break;
+    }
+    uint64_t done = nvc_x86_short_jump(gen, 0xeb);
+    nvc_x86_land(gen, tagged);
+    if (overflow) nvc_x86_land(gen, overflow);
+    // mov rdi, rax; mov rsi, rcx
+    NVC_X86(gen, 0x48, 0x89, 0xc7, 0x48, 0x89, 0xce);
+    nvc_x86_call(gen, slow);
+    bool compare = op >= NVC_IR_LT && op <= NVC_IR_GE;
+    if (compare) NVC_X86(gen, 0x85, 0xc0);  // test eax, eax
+    nvc_x86_land(gen, done);
+    if (!compare) return;
+    // setcc al; movzx eax, al
+    uint8_t setcc = op == NVC_IR_LT   ? 0x9c
+                    : op == NVC_IR_LE ? 0x9e
+                    : op == NVC_IR_GT ? 0x9f
+                                      : 0x9d;
+    NVC_X86(gen, 0x0f, setcc, 0xc0, 0x0f, 0xb6, 0xc0);
+}
+
+// the tagged int operation op on rax into rax, like nvc_gen_int_binary
+static void nvc_gen_int_unary(nvc_gen_t* gen, nvc_ir_op_t op) {
+    NVC_X86(gen, 0xa8, 0x01);  // test al, 1
+    uint64_t tagged = nvc_x86_short_jump(gen, 0x75);
+    uint64_t overflow = 0;
+    const char* slow;
+    switch (op) {
+        case NVC_IR_NEG:
+            // mov rdx, rax; neg rdx; jo slow; mov rax, rdx
+            NVC_X86(gen, 0x48, 0x89, 0xc2, 0x48, 0xf7, 0xda);
+            overflow = nvc_x86_short_jump(gen, 0x70);
+            NVC_X86(gen, 0x48, 0x89, 0xd0);
+            slow = "nvc_rt_int_neg";
+            break;
+        case NVC_IR_NOT:
+            // not rax; and rax, -2
+            NVC_X86(gen, 0x48, 0xf7, 0xd0, 0x48, 0x83, 0xe0, 0xfe);
+            slow = "nvc_rt_int_not";
+            break;
+        default:
+            // sar rax, 1; cvtsi2sd xmm0, rax
+            NVC_X86(gen, 0x48, 0xd1, 0xf8, 0xf2, 0x48, 0x0f, 0x2a, 0xc0);
+            slow = "nvc_rt_int_to_fp";
+            break;
+    }
+    uint64_t done = nvc_x86_short_jump(gen, 0xeb);
+    nvc_x86_land(gen, tagged);
+    if (overflow) nvc_x86_land(gen, overflow);
+    NVC_X86(gen, 0x48, 0x89, 0xc7);  // mov rdi, rax
+    nvc_x86_call(gen, slow);
+    nvc_x86_land(gen, done);
+    // note: the result of nvc_rt_int_to_fp is in xmm0 on both paths
+    // movq rax, xmm0
+    if (op == NVC_IR_ITOF) NVC_X86(gen, 0x66, 0x48, 0x0f, 0x7e, 0xc0);
+}
+
+// the i32 or i64 operation op on rax and rcx into rax. they wrap, so only
+// division and power call the runtime, and i32 results are sign extended
+// again from their low 32 bits. comparisons leave 0 or 1
+static void nvc_gen_fixed_binary(nvc_gen_t* gen,
+                                 nvc_ir_op_t op,
+                                 nvc_ir_type_t type) {
+    switch (op) {
+        case NVC_IR_ADD: NVC_X86(gen, 0x48, 0x01, 0xc8); break;  // add
+        case NVC_IR_SUB: NVC_X86(gen, 0x48, 0x29, 0xc8); break;  // sub
+        case NVC_IR_MUL: NVC_X86(gen, 0x48, 0x0f, 0xaf, 0xc1); break;
+        case NVC_IR_DIV:
+        case NVC_IR_POW:
+            // mov rdi, rax; mov rsi, rcx
+            NVC_X86(gen, 0x48, 0x89, 0xc7, 0x48, 0x89, 0xce);
+            nvc_x86_call(gen, op == NVC_IR_DIV ? "nvc_rt_div_i64"
+                                               : "nvc_rt_pow_i64");
+            break;
+        default: {
+            // cmp rax, rcx; setcc al; movzx eax, al
+            uint8_t setcc = op == NVC_IR_LT   ? 0x9c
+                            : op == NVC_IR_LE ? 0x9e
+                            : op == NVC_IR_GT ? 0x9f
+                                              : 0x9d;
+            NVC_X86(gen, 0x48, 0x39, 0xc8, 0x0f, setcc, 0xc0, 0x0f, 0xb6,
+                    0xc0);
+            return;
+        }
+    }
+    // movsxd rax, eax
+    if (type == NVC_IR_TYPE_I32) NVC_X86(gen, 0x48, 0x63, 0xc0);
+}
+
+// scalar arithmetic and comparisons, operand 0 in rax and 1 in rcx. fps
+// and f32s use the sd and ss forms of the same instructions
+static void nvc_gen_scalar_binary(nvc_gen_t* gen, nvc_ir_value_t value) {
+    nvc_ir_inst_t* inst = nvc_gen_inst(gen, value);
+    nvc_ir_type_t type = nvc_gen_inst(gen, inst->ops[0])->type;
+    nvc_load(gen, NVC_RAX, inst->ops[0]);
+    nvc_load(gen, NVC_RCX, inst->ops[1]);
+    if (type == NVC_IR_TYPE_INT) {
+        nvc_gen_int_binary(gen, inst->op);
+        nvc_store_rax(gen, value);
+        return;
+    }
+    if (type == NVC_IR_TYPE_I32 || type == NVC_IR_TYPE_I64) {
+        nvc_gen_fixed_binary(gen, inst->op, type);
+        nvc_store_rax(gen, value);
+        return;
+    }
+
+    bool f32 = type == NVC_IR_TYPE_F32;
+    if (f32)
+        // movd xmm0, eax; movd xmm1, ecx
+        NVC_X86(gen, 0x66, 0x0f, 0x6e, 0xc0, 0x66, 0x0f, 0x6e, 0xc9);
+    else
+        // movq xmm0, rax; movq xmm1, rcx
+        NVC_X86(gen, 0x66, 0x48, 0x0f, 0x6e, 0xc0, 0x66, 0x48, 0x0f, 0x6e,
+                0xc9);
+    uint8_t prefix = f32 ? 0xf3 : 0xf2;
+    switch (inst->op) {
+        case NVC_IR_ADD: NVC_X86(gen, prefix, 0x0f, 0x58, 0xc1); break;
+        case NVC_IR_SUB: NVC_X86(gen, prefix, 0x0f, 0x5c, 0xc1); break;
+        case NVC_IR_MUL: NVC_X86(gen, prefix, 0x0f, 0x59, 0xc1); break;
+        case NVC_IR_DIV: NVC_X86(gen, prefix, 0x0f, 0x5e, 0xc1); break;
+        case NVC_IR_POW:
+            nvc_x86_call(gen, f32 ? "nvc_rt_pow_f32" : "nvc_rt_pow_fp");
+            break;
+        default: {
+            // ucomisd sets CF and ZF when unordered so seta/setae are false
+            // for NaN, lt and le compare the swapped operands
+            bool swap = inst->op == NVC_IR_LT || inst->op == NVC_IR_LE;
+            bool equal = inst->op == NVC_IR_LE || inst->op == NVC_IR_GE;
+            // ucomiss has no operand size prefix
+            if (!f32) NVC_X86(gen, 0x66);
+            NVC_X86(gen, 0x0f, 0x2e, swap ? 0xc8 : 0xc1, 0x0f,
+                    equal ? 0x93 : 0x97, 0xc0, 0x0f, 0xb6, 0xc0);
+            nvc_store_rax(gen, value);
+            return;
+        }
+    }
+    if (f32)
+        // movd eax, xmm0
+        NVC_X86(gen, 0x66, 0x0f, 0x7e, 0xc0);
+    else
+        // movq rax, xmm0
+        NVC_X86(gen, 0x66, 0x48, 0x0f, 0x7e, 0xc0);
+    nvc_store_rax(gen, value);
+}
+
+static void nvc_gen_scalar_unary(nvc_gen_t* gen, nvc_ir_value_t value) {
+    nvc_ir_inst_t* inst = nvc_gen_inst(gen, value);
+    nvc_ir_type_t type = nvc_gen_inst(gen, inst->ops[0])->type;
+    nvc_load(gen, NVC_RAX, inst->ops[0]);
+    if (type == NVC_IR_TYPE_INT) {
+        nvc_gen_int_unary(gen, inst->op);
+        nvc_store_rax(gen, value);
+        return;
+    }
+    if (type == NVC_IR_TYPE_I32 || type == NVC_IR_TYPE_I64) {
+        // neg rax or not rax, they wrap
+        NVC_X86(gen, 0x48, 0xf7, inst->op == NVC_IR_NEG ? 0xd8 : 0xd0);
+        // movsxd rax, eax
+        if (type == NVC_IR_TYPE_I32) NVC_X86(gen, 0x48, 0x63, 0xc0);
+    } else if (type == NVC_IR_TYPE_F32) {
+        // flip the sign bit: xor eax, 1 << 31
+        NVC_X86(gen, 0x35);
+        nvc_emit_u32(gen, (uint32_t)1 << 31);
+    } else if (inst->op == NVC_IR_NEG) {
+        // flip the sign bit: movabs rcx, 1 << 63; xor rax, rcx
+        NVC_X86(gen, 0x48, 0xb9);
+        nvc_emit_u64(gen, (uint64_t)1 << 63);
+        NVC_X86(gen, 0x48, 0x31, 0xc8);
+    } else {
+        // bools are 0 or 1: xor rax, 1
+        NVC_X86(gen, 0x48, 0x83, 0xf0, 0x01);
+    }
+    nvc_store_rax(gen, value);
+}
+
+// a scalar NVC_IR_CONVERT, with the same results as nvc_rt_vec_convert:
+// ints wrap to i32s and i64s and round once to f32s, fps and f32s truncate
+// to i32s and i64s (cvtt gives the minimum when out of range or NaN)
+static void nvc_gen_convert(nvc_gen_t* gen, nvc_ir_value_t value) {
+    nvc_ir_inst_t* inst = nvc_gen_inst(gen, value);
+    nvc_ir_type_t from = nvc_gen_inst(gen, inst->ops[0])->type;
+    nvc_ir_type_t to = inst->type;
+    nvc_load(gen, NVC_RAX, inst->ops[0]);
+    if (from == NVC_IR_TYPE_INT) {
+        NVC_X86(gen, 0xa8, 0x01);  // test al, 1
+        uint64_t tagged = nvc_x86_short_jump(gen, 0x75);
+        NVC_X86(gen, 0x48, 0xd1, 0xf8);  // sar rax, 1
+        // cvtsi2ss xmm0, rax
+        if (to == NVC_IR_TYPE_F32)
+            NVC_X86(gen, 0xf3, 0x48, 0x0f, 0x2a, 0xc0);
+        uint64_t done = nvc_x86_short_jump(gen, 0xeb);
+        nvc_x86_land(gen, tagged);
+        NVC_X86(gen, 0x48, 0x89, 0xc7);  // mov rdi, rax
+        if (to == NVC_IR_TYPE_F32) {
+            // note: an int that is not small is past 2^62, where rounding
+            // to a double first can not change the nearest float
+            nvc_x86_call(gen, "nvc_rt_int_to_fp");
+            NVC_X86(gen, 0xf2, 0x0f, 0x5a, 0xc0);  // cvtsd2ss xmm0, xmm0
+        } else {
+            nvc_x86_call(gen, "nvc_rt_int_wrap_i64");
+        }
+        nvc_x86_land(gen, done);
+        if (to == NVC_IR_TYPE_F32)
+            NVC_X86(gen, 0x66, 0x0f, 0x7e, 0xc0);  // movd eax, xmm0
+        else if (to == NVC_IR_TYPE_I32)
+            NVC_X86(gen, 0x48, 0x63, 0xc0);  // movsxd rax, eax
+        nvc_store_rax(gen, value);
+        return;
+    }
+
+    if (to == NVC_IR_TYPE_INT) {
+        if (from == NVC_IR_TYPE_I32) {
+            // i32s are always small: add rax, rax
+            NVC_X86(gen, 0x48, 0x01, 0xc0);
+        } else {
+            // mov rdx, rax; add rdx, rdx; jo slow; mov rax, rdx
+            NVC_X86(gen, 0x48, 0x89, 0xc2, 0x48, 0x01, 0xd2);
+            uint64_t overflow = nvc_x86_short_jump(gen, 0x70);
+            NVC_X86(gen, 0x48, 0x89, 0xd0);
+            uint64_t done = nvc_x86_short_jump(gen, 0xeb);
+            nvc_x86_land(gen, overflow);
+            NVC_X86(gen, 0x48, 0x89, 0xc7);  // mov rdi, rax
+            nvc_x86_call(gen, "nvc_rt_int_from_i64");
+            nvc_x86_land(gen, done);
+        }
+        nvc_store_rax(gen, value);
+        return;
+    }
+
+    bool from_fp = from == NVC_IR_TYPE_FP || from == NVC_IR_TYPE_F32;
+    if (from == NVC_IR_TYPE_FP)
+        NVC_X86(gen, 0x66, 0x48, 0x0f, 0x6e, 0xc0);  // movq xmm0, rax
+    else if (from == NVC_IR_TYPE_F32)
+        NVC_X86(gen, 0x66, 0x0f, 0x6e, 0xc0);  // movd xmm0, eax
+    uint8_t prefix = from == NVC_IR_TYPE_F32 ? 0xf3 : 0xf2;
+    switch (to) {
+        case NVC_IR_TYPE_I64:
+            // cvttsd2si or cvttss2si rax, xmm0 (an i32 already is one)
+            if (from_fp) NVC_X86(gen, prefix, 0x48, 0x0f, 0x2c, 0xc0);
+            break;
+        case NVC_IR_TYPE_I32:
+            // cvttsd2si or cvttss2si eax, xmm0
+            if (from_fp) NVC_X86(gen, prefix, 0x0f, 0x2c, 0xc0);
+            NVC_X86(gen, 0x48, 0x63, 0xc0);  // movsxd rax, eax
+            break;
+        case NVC_IR_TYPE_F32:
+            if (from_fp)
+                NVC_X86(gen, 0xf2, 0x0f, 0x5a, 0xc0);  // cvtsd2ss xmm0, xmm0
+            else
+                // cvtsi2ss xmm0, rax
+                NVC_X86(gen, 0xf3, 0x48, 0x0f, 0x2a, 0xc0);
+            NVC_X86(gen, 0x66, 0x0f, 0x7e, 0xc0);  // movd eax, xmm0
+            break;
+        default:
+            if (from_fp)
+                NVC_X86(gen, 0xf3, 0x0f, 0x5a, 0xc0);  // cvtss2sd xmm0, xmm0
+            else
+                // cvtsi2sd xmm0, rax
+                NVC_X86(gen, 0xf2, 0x48, 0x0f, 0x2a, 0xc0);
+            // movq rax, xmm0
+            NVC_X86(gen, 0x66, 0x48, 0x0f, 0x7e, 0xc0);
+            break;
+    }
+    nvc_store_rax(gen, value);
+}
+
+// element-wise operations call into the runtime, the result is a pointer to
+// the elements in the frame
+static void nvc_gen_elementwise(nvc_gen_t* gen, nvc_ir_value_t value) {
+    nvc_ir_inst_t* inst = nvc_gen_inst(gen, value);
+    nvc_value_home_t* home = gen->homes + value;
+    nvc_ir_type_t type = nvc_gen_inst(gen, inst->ops[0])->type;
+    // note: nvc_rt_vec_convert takes the result type where the others take
+    // the operation
+    nvc_x86_mov_imm(gen, NVC_RDI,
+                    (int32_t)(inst->op == NVC_IR_CONVERT
+                                  ? nvc_rt_type(inst->type)
+                                  : nvc_rt_op(inst->op)));
+    nvc_x86_mov_imm(gen, NVC_RSI, (int32_t)nvc_rt_type(type));
+    nvc_x86_frame(gen, NVC_X86_LEA, NVC_RDX, home->elems);
+    nvc_load(gen, NVC_RCX, inst->ops[0]);
+    if (inst->op == NVC_IR_CONVERT) {
+        nvc_x86_mov_imm(gen, NVC_R8, (int32_t)inst->length);
+        nvc_x86_call(gen, "nvc_rt_vec_convert");
+    } else if (inst->n_operands == 2) {
+        nvc_load(gen, NVC_R8, inst->ops[1]);
+        nvc_x86_mov_imm(gen, NVC_R8 + 1, (int32_t)inst->length);
+        nvc_x86_call(gen, "nvc_rt_vec_binary");
+    } else {
+        nvc_x86_mov_imm(gen, NVC_R8, (int32_t)inst->length);
+        nvc_x86_call(gen, "nvc_rt_vec_unary");
+    }
+    nvc_x86_frame(gen, NVC_X86_LEA, NVC_RAX, home->elems);
+    nvc_store_rax(gen, value);
+}
+
+static void nvc_gen_array(nvc_gen_t* gen, nvc_ir_value_t value) {
+    nvc_ir_inst_t* inst = nvc_gen_inst(gen, value);
+    nvc_value_home_t* home = gen->homes + value;
+    nvc_ir_value_t* operands = nvc_ir_operands(inst);
+    size_t elem_size = nvc_ir_elem_size(inst->type);
+    for (uint32_t k = 0; k < inst->n_operands; ++k) {
+        nvc_load(gen, NVC_RAX, operands[k]);
+        nvc_store_narrow(gen, elem_size,
+                         home->elems + (int32_t)(k * elem_size));
+    }
+    nvc_x86_frame(gen, NVC_X86_LEA, NVC_RAX, home->elems);
+    nvc_store_rax(gen, value);
+}
+
+static void nvc_gen_splat(nvc_gen_t* gen, nvc_ir_value_t value) {
+    nvc_ir_inst_t* inst = nvc_gen_inst(gen, value);
+    nvc_value_home_t* home = gen->homes + value;
+    nvc_x86_mov_imm(gen, NVC_RDI, (int32_t)nvc_rt_type(inst->type));
+    nvc_x86_frame(gen, NVC_X86_LEA, NVC_RSI, home->elems);
+    nvc_load(gen, NVC_RDX, inst->ops[0]);
+    nvc_x86_mov_imm(gen, NVC_RCX, (int32_t)inst->length);
+    nvc_x86_call(gen, "nvc_rt_vec_splat");
+    nvc_x86_frame(gen, NVC_X86_LEA, NVC_RAX, home->elems);
+    nvc_store_rax(gen, value);
+}
+
+static void nvc_gen_index(nvc_gen_t* gen, nvc_ir_value_t value) {
+    nvc_ir_inst_t* inst = nvc_gen_inst(gen, value);
+    uint32_t length = nvc_gen_inst(gen, inst->ops[0])->length;
+    // note: an int index that is not small is out of bounds, the unsigned
+    // compare also catches negative indices. i32 and i64 indices are not
+    // tagged
+    nvc_load(gen, NVC_RAX, inst->ops[1]);
+    bool tagged_index = nvc_gen_inst(gen, inst->ops[1])->type ==
+                        NVC_IR_TYPE_INT;
+    uint64_t tagged = 0;
+    if (tagged_index) {
+        NVC_X86(gen, 0xa8, 0x01);  // test al, 1
+        tagged = nvc_x86_short_jump(gen, 0x75);
+        NVC_X86(gen, 0x48, 0xd1, 0xf8);  // sar rax, 1
+    }
+    nvc_x86_mov_imm(gen, NVC_RCX, (int32_t)length);
+    // cmp rax, rcx; jb over the trap
+    NVC_X86(gen, 0x48, 0x39, 0xc8, 0x72, 0x0c);
+    if (tagged_index) nvc_x86_land(gen, tagged);
+    nvc_x86_mov_imm(gen, NVC_RDI, NVC_RT_TRAP_OUT_OF_BOUNDS);
+    nvc_x86_call(gen, "nvc_rt_trap");
+    nvc_load(gen, NVC_RDX, inst->ops[0]);
+    // [rdx + rax * elem size]
+    size_t elem_size = nvc_ir_elem_size(inst->type);
+    nvc_x86_load_elem(gen, inst->type);
+    NVC_X86(gen, 0x04, elem_size == 1 ? 0x02 : elem_size == 4 ? 0x82 : 0xc2);
+    nvc_store_rax(gen, value);
+}
+
+// memcpy(rbp + disp, value, size) for an array or record value
+static void nvc_gen_copy_to_frame(nvc_gen_t* gen,
+                                  int32_t disp,
+                                  nvc_ir_value_t value,
+                                  uint64_t size) {
+    nvc_x86_frame(gen, NVC_X86_LEA, NVC_RDI, disp);
+    nvc_load(gen, NVC_RSI, value);
+    nvc_x86_mov_imm(gen, NVC_RDX, (int32_t)size);
+    nvc_x86_call(gen, "memcpy");
+}
+
+// stores every field at its offset in the layout, arrays and records are
+// copied in since records hold them inline
+static void nvc_gen_record(nvc_gen_t* gen, nvc_ir_value_t value) {
+    nvc_ir_inst_t* inst = nvc_gen_inst(gen, value);
+    nvc_value_home_t* home = gen->homes + value;
+    const nvc_type_layout_t* layout = inst->layout;
+    nvc_ir_value_t* operands = nvc_ir_operands(inst);
+    for (uint32_t k = 0; k < layout->n_fields; ++k) {
+        const nvc_field_layout_t* field = layout->fields + k;
+        int32_t disp = home->elems + (int32_t)field->offset;
+        if (field->length || field->record) {
+            nvc_gen_copy_to_frame(gen, disp, operands[k], field->size);
+            continue;
+        }
+        nvc_load(gen, NVC_RAX, operands[k]);
+        nvc_store_narrow(gen, field->size, disp);
+    }
+    nvc_x86_frame(gen, NVC_X86_LEA, NVC_RAX, home->elems);
+    nvc_store_rax(gen, value);
+}
+
+// a scalar field is loaded, an array or record field is a pointer into the
+// record
+static void nvc_gen_field(nvc_gen_t* gen, nvc_ir_value_t value) {
+    nvc_ir_inst_t* inst = nvc_gen_inst(gen, value);
+    const nvc_type_layout_t* layout = nvc_gen_inst(gen, inst->ops[0])->layout;
+    const nvc_field_layout_t* field = layout->fields + inst->field;
+    nvc_load(gen, NVC_RDX, inst->ops[0]);
+    if (field->length || field->record)
+        // lea rax, [rdx + offset]
+        NVC_X86(gen, 0x48, 0x8d);
+    else
+        nvc_x86_load_elem(gen, (nvc_ir_type_t)field->type);
+    // [rdx + offset]
+    NVC_X86(gen, 0x82);
+    nvc_emit_u32(gen, field->offset);
+    nvc_store_rax(gen, value);
+}
+
+// sets the incoming value of every phi of block to for the edge from
+// block from
+static void nvc_gen_edge(nvc_gen_t* gen, uint32_t from, uint32_t to) {
+    nvc_ir_block_t* target = gen->fun->blocks + to;
+    uint32_t pred = 0;
+    while (pred < target->n_preds && target->preds[pred] != from) ++pred;
+    if (pred == target->n_preds) return;
+    for (uint32_t i = 0; i < target->n_insts; ++i) {
+        nvc_ir_value_t phi = target->insts[i];
+        nvc_ir_inst_t* inst = nvc_gen_inst(gen, phi);
+        if (inst->op != NVC_IR_PHI) break;
+        nvc_load(gen, NVC_RAX, nvc_ir_operands(inst)[pred]);
+        nvc_x86_frame(gen, NVC_X86_STORE, NVC_RAX, gen->homes[phi].incoming);
+    }
+}
+
+// the symbol of a function of the module, see nvc_rt.h
+static uint32_t nvc_gen_fun_symbol(nvc_gen_t* gen, const char* name) {
+    size_t len = strlen("fun.") + strlen(name) + 1;
+    char* fun_name = nvc_alloc(gen->obj->allocator, len);
+    if (!fun_name) {
+        nvc_gen_out_of_memory(gen);
+        return 0;
+    }
+    snprintf(fun_name, len, "fun.%s", name);
+    uint32_t symbol = nvc_gen_symbol(gen, gen->name, ':', fun_name);
+    nvc_free(gen->obj->allocator, fun_name);
+    return symbol;
+}
+
+// the arguments are stored next to each other in the frame and passed by a
+// pointer to them in rdi, rsi points to where an array or record result is
+// copied to
+static void nvc_gen_call(nvc_gen_t* gen, nvc_ir_value_t value) {
+    nvc_ir_inst_t* inst = nvc_gen_inst(gen, value);
+    nvc_value_home_t* home = gen->homes + value;
+    nvc_ir_value_t* operands = nvc_ir_operands(inst);
+    for (uint32_t k = 0; k < inst->n_operands; ++k) {
+        nvc_load(gen, NVC_RAX, operands[k]);
+        nvc_x86_frame(gen, NVC_X86_STORE, NVC_RAX,
+                      home->args + (int32_t)(k * 8));
+    }
+    nvc_x86_frame(gen, NVC_X86_LEA, NVC_RDI, home->args);
+    if (nvc_is_aggregate(inst))
+        nvc_x86_frame(gen, NVC_X86_LEA, NVC_RSI, home->elems);
+    const char* callee = gen->module->functions[inst->callee]->name;
+    nvc_x86_call_symbol(gen, nvc_gen_fun_symbol(gen, callee));
+    nvc_store_rax(gen, value);
+}
+
+static void nvc_gen_ret(nvc_gen_t* gen, nvc_ir_value_t value) {
+    nvc_ir_inst_t* inst = nvc_gen_inst(gen, value);
+    if (inst->ops[0] != NVC_IR_NONE) {
+        nvc_ir_inst_t* result = nvc_gen_inst(gen, inst->ops[0]);
+        if (nvc_is_aggregate(result)) {
+            // memcpy(result pointer, value, size), which returns it
+            nvc_x86_frame(gen, NVC_X86_LOAD, NVC_RDI, NVC_FRAME_RESULT);
+            nvc_load(gen, NVC_RSI, inst->ops[0]);
+            nvc_x86_mov_imm(gen, NVC_RDX,
+                            (int32_t)nvc_aggregate_size(result));
+            nvc_x86_call(gen, "memcpy");
+        } else {
+            nvc_load(gen, NVC_RAX, inst->ops[0]);
+        }
+    }
+    // leave; ret
+    NVC_X86(gen, 0xc9, 0xc3);
+}
+
+static void nvc_gen_value(nvc_gen_t* gen,
+                          uint32_t block,
+                          uint32_t next_block,
+                          nvc_ir_value_t value) {
+    nvc_ir_inst_t* inst = nvc_gen_inst(gen, value);
+    switch (inst->op) {
+        case NVC_IR_NOP: break;
+        case NVC_IR_CONST:
+        case NVC_IR_BIG: nvc_gen_const(gen, value); break;
+        case NVC_IR_IMPORT: nvc_gen_import(gen, value); break;
+        case NVC_IR_PARAM:
+            // mov rax, [rbp - 8]; mov rax, [rax + 8 * param]
+            nvc_x86_frame(gen, NVC_X86_LOAD, NVC_RAX, NVC_FRAME_ARGS);
+            NVC_X86(gen, 0x48, 0x8b, 0x80);
+            nvc_emit_u32(gen, inst->param * 8);
+            nvc_store_rax(gen, value);
+            break;
+        case NVC_IR_COPY:
+            nvc_load(gen, NVC_RAX, inst->ops[0]);
+            nvc_store_rax(gen, value);
+            break;
+        case NVC_IR_PHI:
+            // note: phis read what their predecessor left in incoming, so
+            // phis that read each other see the values from before the jump
+            nvc_x86_frame(gen, NVC_X86_LOAD, NVC_RAX,
+                          gen->homes[value].incoming);
+            if (nvc_is_aggregate(inst)) {
+                // note: a loop body writes its value where the previous
+                // iteration left it, so the phi keeps its own copy
+                // memcpy(elems, incoming, size)
+                nvc_x86_frame(gen, NVC_X86_LEA, NVC_RDI,
+                              gen->homes[value].elems);
+                // mov rsi, rax
+                NVC_X86(gen, 0x48, 0x89, 0xc6);
+                nvc_x86_mov_imm(gen, NVC_RDX,
+                                (int32_t)nvc_aggregate_size(inst));
+                nvc_x86_call(gen, "memcpy");
+                nvc_x86_frame(gen, NVC_X86_LEA, NVC_RAX,
+                              gen->homes[value].elems);
+            }
+            nvc_store_rax(gen, value);
+            break;
+        case NVC_IR_ADD:
+        case NVC_IR_SUB:
+        case NVC_IR_MUL:
+        case NVC_IR_DIV:
+        case NVC_IR_POW:
+        case NVC_IR_LT:
+        case NVC_IR_LE:
+        case NVC_IR_GT:
+        case NVC_IR_GE:
+            if (inst->length)
+                nvc_gen_elementwise(gen, value);
+            else
+                nvc_gen_scalar_binary(gen, value);
+            break;
+        case NVC_IR_NEG:
+        case NVC_IR_NOT:
+        case NVC_IR_ITOF:
+            if (inst->length)
+                nvc_gen_elementwise(gen, value);
+            else
+                nvc_gen_scalar_unary(gen, value);
+            break;
+        case NVC_IR_CONVERT:
+            if (inst->length)
+                nvc_gen_elementwise(gen, value);
+            else
+                nvc_gen_convert(gen, value);
+            break;
+        case NVC_IR_ARRAY: nvc_gen_array(gen, value); break;
+        case NVC_IR_SPLAT: nvc_gen_splat(gen, value); break;
+        case NVC_IR_INDEX: nvc_gen_index(gen, value); break;
+        case NVC_IR_RECORD: nvc_gen_record(gen, value); break;
+        case NVC_IR_FIELD: nvc_gen_field(gen, value); break;
+        case NVC_IR_EXPORT: nvc_gen_export(gen, value); break;
+        case NVC_IR_CALL: nvc_gen_call(gen, value); break;
+        case NVC_IR_RET: nvc_gen_ret(gen, value); break;
+        case NVC_IR_BR:
+            nvc_gen_edge(gen, block, inst->targets[0]);
+            if (inst->targets[0] == next_block) break;
+            NVC_X86(gen, 0xe9);
+            nvc_x86_jump(gen, inst->targets[0]);
+            break;
+        case NVC_IR_COND_BR:
+            nvc_gen_edge(gen, block, inst->targets[0]);
+            nvc_gen_edge(gen, block, inst->targets[1]);
+            // test rax, rax; jz targets[1]
+            nvc_load(gen, NVC_RAX, inst->ops[0]);
+            NVC_X86(gen, 0x48, 0x85, 0xc0, 0x0f, 0x84);
+            nvc_x86_jump(gen, inst->targets[1]);
+            if (inst->targets[0] == next_block) break;
+            NVC_X86(gen, 0xe9);
+            nvc_x86_jump(gen, inst->targets[0]);
+            break;
+    }
+}
+
+// the module initialiser: runs once, after the initialisers of the imports
+static void nvc_gen_init_prologue(nvc_gen_t* gen) {
+    nvc_elf_object_t* obj = gen->obj;
+    uint32_t bss = NVC_ELF_SECTION_SYMBOL(NVC_ELF_BSS);
+    uint64_t guard = nvc_elf_append(obj, NVC_ELF_BSS, NULL, 1, 1);
+    // cmp byte [rip + guard], 0; je +2; leave; ret
+    NVC_X86(gen, 0x80, 0x3d);
+    nvc_elf_reloc(obj, nvc_here(gen), bss, R_X86_64_PC32, guard - 5);
+    nvc_emit_u32(gen, 0);
+    NVC_X86(gen, 0x00, 0x74, 0x02, 0xc9, 0xc3);
+    // mov byte [rip + guard], 1
+    NVC_X86(gen, 0xc6, 0x05);
+    nvc_elf_reloc(obj, nvc_here(gen), bss, R_X86_64_PC32, guard - 5);
+    nvc_emit_u32(gen, 0);
+    NVC_X86(gen, 0x01);
+    for (uint32_t i = 0; i < gen->n_imports; ++i) {
+        nvc_x86_call_symbol(
+            gen, nvc_gen_symbol(gen, gen->imports[i].name, ':', "init"));
+    }
+}
+
+// the code of gen->fun, functions[0] of the module is its initialiser
+static void nvc_gen_function(nvc_gen_t* gen, bool init) {
+    nvc_ir_function_t* fun = gen->fun;
+    uint32_t frame = nvc_gen_frame(gen, init ? 0 : -NVC_FRAME_RESULT);
+    if (gen->failed) return;
+    nvc_elf_object_t* obj = gen->obj;
+
+    nvc_elf_append(obj, NVC_ELF_TEXT, NULL, 0, 16);
+    uint64_t start = nvc_here(gen);
+    // push rbp; mov rbp, rsp; sub rsp, frame
+    NVC_X86(gen, 0x55, 0x48, 0x89, 0xe5, 0x48, 0x81, 0xec);
+    nvc_emit_u32(gen, frame);
+    if (init) {
+        nvc_gen_init_prologue(gen);
+    } else {
+        nvc_x86_frame(gen, NVC_X86_STORE, NVC_RDI, NVC_FRAME_ARGS);
+        nvc_x86_frame(gen, NVC_X86_STORE, NVC_RSI, NVC_FRAME_RESULT);
+    }
+
+    // note: removed blocks are skipped, nothing jumps to them
+    uint32_t n_blocks = fun->n_blocks;
+    for (uint32_t b = 0; b < n_blocks; ++b) {
+        if (fun->blocks[b].removed) continue;
+        uint32_t next = b + 1;
+        while (next < n_blocks && fun->blocks[next].removed) ++next;
+        gen->block_offsets[b] = nvc_here(gen);
+        nvc_ir_block_t* block = fun->blocks + b;
+        for (uint32_t i = 0; i < block->n_insts; ++i)
+            nvc_gen_value(gen, b, next, block->insts[i]);
+    }
+
+    nvc_elf_buf_t* text = obj->sections + NVC_ELF_TEXT;
+    if (!obj->out_of_memory) {
+        for (uint32_t i = 0; i < gen->n_fixups; ++i) {
+            nvc_jump_fixup_t* fixup = gen->fixups + i;
+            uint32_t rel = (uint32_t)(gen->block_offsets[fixup->block] -
+                                      (fixup->offset + 4));
+            for (int k = 0; k < 4; ++k)
+                text->data[fixup->offset + k] = rel >> (8 * k);
+        }
+    }
+    uint32_t symbol = init ? nvc_gen_symbol(gen, gen->name, ':', "init")
+                           : nvc_gen_fun_symbol(gen, fun->name);
+    nvc_elf_define(obj, symbol, NVC_ELF_TEXT, start, nvc_here(gen) - start,
+                   true);
+}
+
+// marks the functions the initialiser reaches through calls, only those are
+// compiled (the others were inlined everywhere or are never called)
+static void nvc_gen_reachable(nvc_ir_module_t* module,
+                              uint8_t* reached,
+                              uint32_t* stack) {
+    uint32_t n_stack = 0;
+    reached[0] = 1;
+    stack[n_stack++] = 0;
+    while (n_stack) {
+        nvc_ir_function_t* fun = module->functions[stack[--n_stack]];
+        for (nvc_ir_value_t v = 0; v < fun->n_insts; ++v) {
+            nvc_ir_inst_t* inst = fun->insts + v;
+            if (inst->op != NVC_IR_CALL || reached[inst->callee]) continue;
+            reached[inst->callee] = 1;
+            stack[n_stack++] = inst->callee;
+        }
+    }
+}
+
+bool nvc_gen_x86_64(nvc_elf_object_t* obj,
+                    nvc_diagnostics_t* diags,
+                    nvc_ir_module_t* module,
+                    const char* name,
+                    const nvc_object_import_t* imports,
+                    uint32_t n_imports) {
+    nvc_gen_t gen = {
+        .obj = obj,
+        .diags = diags,
+        .name = name,
+        .imports = imports,
+        .n_imports = n_imports,
+        .module = module,
+    };
+    if (!module->n_functions) return false;
+    uint32_t n = module->n_functions;
+    uint8_t* reached = nvc_calloc(obj->allocator, n, 1);
+    uint32_t* stack = nvc_alloc(obj->allocator, n * sizeof(uint32_t));
+    if (!reached || !stack) {
+        nvc_gen_out_of_memory(&gen);
+        goto out;
+    }
+    nvc_gen_reachable(module, reached, stack);
+
+    for (uint32_t f = 0; f < n && !gen.failed; ++f) {
+        if (!reached[f]) continue;
+        gen.fun = module->functions[f];
+        gen.n_fixups = 0;
+        gen.homes = nvc_calloc(obj->allocator, gen.fun->n_insts + 1,
+                               sizeof(nvc_value_home_t));
+        gen.block_offsets = nvc_calloc(obj->allocator, gen.fun->n_blocks + 1,
+                                       sizeof(uint64_t));
+        if (!gen.homes || !gen.block_offsets)
+            nvc_gen_out_of_memory(&gen);
+        else
+            nvc_gen_function(&gen, f == 0);
+        nvc_free(obj->allocator, gen.block_offsets);
+        nvc_free(obj->allocator, gen.homes);
+    }
+    if (obj->out_of_memory) nvc_gen_out_of_memory(&gen);
+out:
+    nvc_free(obj->allocator, gen.fixups);
+    nvc_free(obj->allocator, reached);
+    nvc_free(obj->allocator, stack);
+    return !gen.failed;
+}
+
+bool nvc_write_object(nvc_allocator_t* allocator,
+                      nvc_diagnostics_t* diags,
+                      const char* path,
+                      nvc_ir_module_t* module,
+                      const char* name,
+                      const nvc_object_import_t* imports,
+                      uint32_t n_imports) {
+    nvc_elf_object_t obj;
+    nvc_elf_init(&obj, allocator);
+    bool ok = nvc_gen_x86_64(&obj, diags, module, name, imports, n_imports);
+    if (ok) {
+        FILE* out = fopen(path, "wb");
+        if (!out) {
+            nvc_report(diags, NVC_SEVERITY_ERROR, NULL,
+                       "unable to write file: %s (%s)", path, strerror(errno));
+            ok = false;
+        } else {
+            bool written = nvc_elf_write(&obj, out);
+            if (fclose(out) != 0) written = false;
+            if (!written) {
+                nvc_report(diags, NVC_SEVERITY_ERROR, NULL,
+                           "unable to write file: %s", path);
+                remove(path);
+                ok = false;
+            }
+        }
+    }
+    nvc_elf_free(&obj);
+    return ok;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,79 @@
+#include <nvc_bigint.h>
+#include <nvc_lexer.h>
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int n_failed = 0;
+
+static void nvc_check(bool ok, const char* what, const char* str) {
+    if (ok) return;
+    fprintf(stderr, "FAILED: %s: %s\n", what, str);
+    ++n_failed;
+}
+
+// an int literal lexes to an int or a big int with exactly its value,
+// never to one that wrapped around
+static void nvc_check_int_lit(const char* digits) {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%s", digits);
+    const char* value = digits;
+    while (value[0] == '0' && value[1]) ++value;
+    nvc_token_stream_t* stream =
+        nvc_lexical_analysis(NULL, NULL, "test", buf, (long)strlen(buf));
+    if (!stream || stream->size != 1) {
+        nvc_check(false, "one token", digits);
+        if (stream) nvc_free_token_stream(stream);
+        return;
+    }
+    nvc_tok_t* tok = stream->tokens;
+    char str[128];
+    if (tok->kind == NVC_TOK_INT_LIT) {
+        snprintf(str, sizeof(str), "%" PRId64, tok->int_lit);
+        nvc_check(strcmp(str, value) == 0, "int value", digits);
+    } else if (tok->kind == NVC_TOK_BIG_LIT) {
+        nvc_check(nvc_bigint_str_size(tok->big_lit) <= sizeof(str),
+                  "big size", digits);
+        nvc_bigint_to_str(tok->big_lit, str);
+        nvc_check(strcmp(str, value) == 0, "big value", digits);
+    } else {
+        nvc_check(false, "int kind", digits);
+    }
+    nvc_free_token_stream(stream);
+}
+
+int main(void) {
+    static const char* const values[] = {
+        "9223372036854775807",  "9223372036854775808",
+        "18446744073699999999", "18446744073709551615",
+        "18446744073709551616", "18446744073799999999",
+        "18446744073999999999", "99999999999999999999",
+    };
+    char digits[64];
+    for (uint32_t k = 0; k < sizeof(values) / sizeof(values[0]); ++k) {
+        // note: leading zeros move where the 8 digit chunks split
+        for (uint32_t zeros = 0; zeros < 16; ++zeros) {
+            snprintf(digits, sizeof(digits), "%0*d%s", (int)zeros, 0,
+                     values[k]);
+            nvc_check_int_lit(zeros ? digits : values[k]);
+        }
+    }
+    // every length with 9s, the largest value of each
+    for (uint32_t n = 1; n < 40; ++n) {
+        memset(digits, '9', n);
+        digits[n] = '\0';
+        nvc_check_int_lit(digits);
+    }
+    srand(42);
+    for (uint32_t k = 0; k < 10000; ++k) {
+        uint32_t n = 1 + (uint32_t)rand() % 32;
+        for (uint32_t i = 0; i < n; ++i) digits[i] = '0' + rand() % 10;
+        digits[n] = '\0';
+        nvc_check_int_lit(digits);
+    }
+    if (n_failed) fprintf(stderr, "%d checks failed\n", n_failed);
+    return n_failed != 0;
+}
@@ -0,0 +1,55 @@
+#include <nvc_number.h>
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int n_failed = 0;
+
+static void nvc_check(bool ok, const char* what, const char* str) {
+    if (ok) return;
+    fprintf(stderr, "FAILED: %s: %s\n", what, str);
+    ++n_failed;
+}
+
+// str is scanned whole to an fp equal to what strtod makes of it
+static void nvc_check_fp(const char* str) {
+    nvc_number_t number;
+    size_t len = nvc_scan_number(str, str + strlen(str), &number);
+    nvc_check(len == strlen(str), "length", str);
+    nvc_check(number.kind == NVC_NUMBER_FP, "kind", str);
+    nvc_check(number.status == NVC_NUMBER_OK, "status", str);
+    nvc_check(number.fp == strtod(str, NULL), "value", str);
+}
+
+// str is scanned whole to an int, saturated when it does not fit
+static void nvc_check_int(const char* str, bool overflow, nvc_int value) {
+    nvc_number_t number;
+    size_t len = nvc_scan_number(str, str + strlen(str), &number);
+    nvc_check(len == strlen(str), "length", str);
+    nvc_check(number.kind == NVC_NUMBER_INT, "kind", str);
+    nvc_check(number.status ==
+                  (overflow ? NVC_NUMBER_OVERFLOW : NVC_NUMBER_OK),
+              "status", str);
+    nvc_check(number.i == value, "value", str);
+}
+
+int main(void) {
+    // the 8 digits at a time scan stops where the next 8 could overflow:
+    // (2^64 - 1 - 99999999) / 10^8 = 184467440736
+    nvc_check_fp("184467440736.99999999");
+    nvc_check_fp("184467440737.99999999");
+    nvc_check_fp("184467440738.00000000");
+    nvc_check_fp("0000184467440737.99999999");
+    nvc_check_fp("18446744073799999999.5");
+    nvc_check_int("18446744073699999999", true, INT64_MAX);
+    nvc_check_int("18446744073799999999", true, INT64_MAX);
+    nvc_check_int("000018446744073799999999", true, INT64_MAX);
+    nvc_check_int("0000000000000000000000009223372036854775807", false,
+                  INT64_MAX);
+    nvc_check_int("9223372036854775808", true, INT64_MAX);
+    nvc_check_int("1844674407369999999", false, 1844674407369999999);
+    if (n_failed) fprintf(stderr, "%d checks failed\n", n_failed);
+    return n_failed != 0;
+}